@@ -0,0 +1,97 @@
+#include "access_fsm.h"
+
+#define T(n, a) { (uint8_t)(n), (uint8_t)(a) }
+#define GO(s)   T(s, 0)   // Transición sin acciones
+
+#define LOCK_ALL    (ACCESS_ACT_LOCK | ACCESS_ACT_CANCEL_RELOCK | ACCESS_ACT_CANCEL_UNLOCK_MAX)
+#define UNLOCK_ALL  (ACCESS_ACT_UNLOCK | ACCESS_ACT_ARM_UNLOCK_MAX)
+
+const access_transition_t access_fsm_table[ACCESS_STATE_COUNT][ACCESS_EV_COUNT] = {
+    [ACCESS_LOCKED_CLOSED] = {
+        [ACCESS_EV_GRANT]          = T(ACCESS_UNLOCKED_CLOSED, UNLOCK_ALL),
+        [ACCESS_EV_DOOR_OPEN]      = GO(ACCESS_LOCKED_OPEN),
+        [ACCESS_EV_DOOR_CLOSED]    = GO(ACCESS_LOCKED_CLOSED),
+        [ACCESS_EV_RELOCK_DUE]     = GO(ACCESS_LOCKED_CLOSED),
+        [ACCESS_EV_UNLOCK_MAX_DUE] = GO(ACCESS_LOCKED_CLOSED),
+    },
+    [ACCESS_LOCKED_OPEN] = {
+        [ACCESS_EV_GRANT]          = T(ACCESS_GRANTED_WAIT_CLOSE, ACCESS_ACT_WAIT_CLOSE),
+        [ACCESS_EV_DOOR_OPEN]      = GO(ACCESS_LOCKED_OPEN),
+        [ACCESS_EV_DOOR_CLOSED]    = GO(ACCESS_LOCKED_CLOSED),
+        [ACCESS_EV_RELOCK_DUE]     = GO(ACCESS_LOCKED_OPEN),
+        [ACCESS_EV_UNLOCK_MAX_DUE] = GO(ACCESS_LOCKED_OPEN),
+    },
+    [ACCESS_GRANTED_WAIT_CLOSE] = {
+        [ACCESS_EV_GRANT]          = GO(ACCESS_GRANTED_WAIT_CLOSE),
+        [ACCESS_EV_DOOR_OPEN]      = GO(ACCESS_GRANTED_WAIT_CLOSE),
+        [ACCESS_EV_DOOR_CLOSED]    = T(ACCESS_UNLOCKED_CLOSED, UNLOCK_ALL),
+        [ACCESS_EV_RELOCK_DUE]     = GO(ACCESS_GRANTED_WAIT_CLOSE),
+        [ACCESS_EV_UNLOCK_MAX_DUE] = GO(ACCESS_GRANTED_WAIT_CLOSE),
+    },
+    [ACCESS_UNLOCKED_CLOSED] = {
+        // Nueva credencial: re-energiza y reinicia el plazo máximo
+        [ACCESS_EV_GRANT]          = T(ACCESS_UNLOCKED_CLOSED, UNLOCK_ALL),
+        [ACCESS_EV_DOOR_OPEN]      = GO(ACCESS_UNLOCKED_OPEN),
+        [ACCESS_EV_DOOR_CLOSED]    = GO(ACCESS_UNLOCKED_CLOSED),
+        [ACCESS_EV_RELOCK_DUE]     = GO(ACCESS_UNLOCKED_CLOSED),
+        [ACCESS_EV_UNLOCK_MAX_DUE] = T(ACCESS_LOCKED_CLOSED, LOCK_ALL),
+    },
+    [ACCESS_UNLOCKED_OPEN] = {
+        [ACCESS_EV_GRANT]          = GO(ACCESS_UNLOCKED_OPEN),
+        [ACCESS_EV_DOOR_OPEN]      = GO(ACCESS_UNLOCKED_OPEN),
+        [ACCESS_EV_DOOR_CLOSED]    = T(ACCESS_RELOCK_PENDING, ACCESS_ACT_ARM_RELOCK),
+        [ACCESS_EV_RELOCK_DUE]     = GO(ACCESS_UNLOCKED_OPEN),
+        // Puerta abierta: no se puede bloquear; avisar y volver a esperar
+        [ACCESS_EV_UNLOCK_MAX_DUE] = T(ACCESS_UNLOCKED_OPEN, ACCESS_ACT_WARN_OPEN | ACCESS_ACT_ARM_UNLOCK_MAX),
+    },
+    [ACCESS_RELOCK_PENDING] = {
+        [ACCESS_EV_GRANT]          = T(ACCESS_UNLOCKED_CLOSED, UNLOCK_ALL | ACCESS_ACT_CANCEL_RELOCK),
+        [ACCESS_EV_DOOR_OPEN]      = T(ACCESS_UNLOCKED_OPEN, ACCESS_ACT_CANCEL_RELOCK),
+        [ACCESS_EV_DOOR_CLOSED]    = GO(ACCESS_RELOCK_PENDING),
+        [ACCESS_EV_RELOCK_DUE]     = T(ACCESS_LOCKED_CLOSED, LOCK_ALL),
+        [ACCESS_EV_UNLOCK_MAX_DUE] = T(ACCESS_LOCKED_CLOSED, LOCK_ALL),
+    },
+};
+
+uint8_t access_fsm_init(access_fsm_t *f, bool door_closed)
+{
+    f->state = door_closed ? ACCESS_LOCKED_CLOSED : ACCESS_LOCKED_OPEN;
+    f->steps = 0;
+    return LOCK_ALL;
+}
+
+uint8_t access_fsm_step(access_fsm_t *f, access_event_t ev)
+{
+    if ((unsigned)ev >= ACCESS_EV_COUNT || (unsigned)f->state >= ACCESS_STATE_COUNT) return 0;
+    const access_transition_t *t = &access_fsm_table[f->state][ev];
+    f->state = (access_state_t)t->next;
+    f->steps++;
+    return t->actions;
+}
+
+bool access_state_is_locked(access_state_t s)
+{
+    return s == ACCESS_LOCKED_CLOSED || s == ACCESS_LOCKED_OPEN || s == ACCESS_GRANTED_WAIT_CLOSE;
+}
+
+bool access_state_door_closed(access_state_t s)
+{
+    return s == ACCESS_LOCKED_CLOSED || s == ACCESS_UNLOCKED_CLOSED || s == ACCESS_RELOCK_PENDING;
+}
+
+const char *access_state_name(access_state_t s)
+{
+    static const char *names[ACCESS_STATE_COUNT] = {
+        "LOCKED_CLOSED", "LOCKED_OPEN", "GRANTED_WAIT_CLOSE",
+        "UNLOCKED_CLOSED", "UNLOCKED_OPEN", "RELOCK_PENDING",
+    };
+    return ((unsigned)s < ACCESS_STATE_COUNT) ? names[s] : "?";
+}
+
+const char *access_event_name(access_event_t e)
+{
+    static const char *names[ACCESS_EV_COUNT] = {
+        "GRANT", "DOOR_OPEN", "DOOR_CLOSED", "RELOCK_DUE", "UNLOCK_MAX_DUE",
+    };
+    return ((unsigned)e < ACCESS_EV_COUNT) ? names[e] : "?";
+}
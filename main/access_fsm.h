@@ -0,0 +1,75 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Máquina de estados de puerta + cerradura, dirigida por tabla. control_task
+// es su único dueño: recibe eventos tipados de una cola, llama a
+// access_fsm_step() y ejecuta las acciones devueltas (relay/servo, plazos de
+// sched, LCD, logs). Los sensores solo producen eventos.
+//
+// Cada estado combina cerradura y puerta, así que no hace falta ningún flag
+// auxiliar (el antiguo g_pending_relock es el estado ACCESS_UNLOCKED_OPEN /
+// ACCESS_RELOCK_PENDING). Los plazos que llegan a un estado donde no aplican
+// (carrera con una cancelación) son no-ops.
+//
+// Módulo sin dependencias de ESP-IDF: tools/access_fsm_check recorre todas
+// las secuencias de eventos hasta cierta profundidad en host.
+
+typedef enum {
+    ACCESS_LOCKED_CLOSED = 0,   // Reposo: bloqueada, puerta cerrada
+    ACCESS_LOCKED_OPEN,         // Bloqueada con la puerta abierta (arranque/forzada)
+    ACCESS_GRANTED_WAIT_CLOSE,  // Acceso concedido con la puerta abierta: desbloquear al cerrar
+    ACCESS_UNLOCKED_CLOSED,     // Desbloqueada esperando apertura (DL_UNLOCK_MAX armado)
+    ACCESS_UNLOCKED_OPEN,       // Desbloqueada y abierta: re-bloquear al cerrar
+    ACCESS_RELOCK_PENDING,      // Cerrada tras abrir: DL_RELOCK armado
+    ACCESS_STATE_COUNT
+} access_state_t;
+
+typedef enum {
+    ACCESS_EV_GRANT = 0,        // Credencial/orden remota que concede acceso
+    ACCESS_EV_DOOR_OPEN,
+    ACCESS_EV_DOOR_CLOSED,
+    ACCESS_EV_RELOCK_DUE,       // Venció DL_RELOCK
+    ACCESS_EV_UNLOCK_MAX_DUE,   // Venció DL_UNLOCK_MAX
+    ACCESS_EV_COUNT
+} access_event_t;
+
+// Acciones (máscara de bits) que el dueño ejecuta tras cada transición
+#define ACCESS_ACT_LOCK              (1u<<0)  // Bobina OFF, LEDs, "LOCKING...", reset de combinación
+#define ACCESS_ACT_UNLOCK            (1u<<1)  // Bobina ON, LED verde
+#define ACCESS_ACT_ARM_RELOCK        (1u<<2)
+#define ACCESS_ACT_CANCEL_RELOCK     (1u<<3)
+#define ACCESS_ACT_ARM_UNLOCK_MAX    (1u<<4)
+#define ACCESS_ACT_CANCEL_UNLOCK_MAX (1u<<5)
+#define ACCESS_ACT_WAIT_CLOSE        (1u<<6)  // Aviso: acceso pendiente del cierre
+#define ACCESS_ACT_WARN_OPEN         (1u<<7)  // Aviso: tiempo máximo con la puerta abierta
+
+typedef struct {
+    uint8_t next;
+    uint8_t actions;
+} access_transition_t;
+
+extern const access_transition_t access_fsm_table[ACCESS_STATE_COUNT][ACCESS_EV_COUNT];
+
+typedef struct {
+    access_state_t state;
+    uint32_t steps;
+} access_fsm_t;
+
+// Estado inicial según la puerta; devuelve las acciones de arranque (siempre LOCK)
+uint8_t access_fsm_init(access_fsm_t *f, bool door_closed);
+// Aplica un evento; devuelve las acciones a ejecutar
+uint8_t access_fsm_step(access_fsm_t *f, access_event_t ev);
+
+bool access_state_is_locked(access_state_t s);
+bool access_state_door_closed(access_state_t s);
+const char *access_state_name(access_state_t s);
+const char *access_event_name(access_event_t e);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,449 @@
+#include "access_policy.h"
+#include "cred_fusion.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Máscara de tipos de día (bit 0 = lunes ... bit 6 = domingo, bit 7 = festivo)
+#define DAYS_ALL 0xFFu
+
+typedef struct {
+    policy_t *p;
+    char *err;
+    size_t err_len;
+    uint16_t sched_cap;
+} compiler_t;
+
+static bool fail(compiler_t *c, const char *fmt, const char *what)
+{
+    if (c->err && c->err_len) snprintf(c->err, c->err_len, fmt, what ? what : "");
+    return false;
+}
+
+static void bit_set(uint32_t *w, int i) { w[i >> 5] |= 1u << (i & 31); }
+static bool bit_get(const uint32_t *w, int i) { return (w[i >> 5] >> (i & 31)) & 1u; }
+
+static int day_index(const char *s, size_t n)
+{
+    static const char *k_days[] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun", "hol" };
+    for (int i = 0; i < POLICY_DAY_TYPES; ++i) {
+        if (n == 3 && strncmp(s, k_days[i], 3) == 0) return i;
+    }
+    return -1;
+}
+
+// "mon-fri,sat" / "all" / "hol" -> máscara de tipos de día; 0 si no es válido
+static uint8_t parse_days(const char *s)
+{
+    if (!s || strcmp(s, "all") == 0) return DAYS_ALL;
+    uint8_t mask = 0;
+    while (*s) {
+        const char *end = strchr(s, ',');
+        size_t n = end ? (size_t)(end - s) : strlen(s);
+        const char *dash = memchr(s, '-', n);
+        if (dash) {
+            int a = day_index(s, (size_t)(dash - s));
+            int b = day_index(dash + 1, n - (size_t)(dash - s) - 1);
+            if (a < 0 || b < 0 || a == POLICY_DAY_HOL || b == POLICY_DAY_HOL) return 0;
+            for (int d = a; ; d = (d + 1) % 7) {
+                mask |= (uint8_t)(1u << d);
+                if (d == b) break;
+            }
+        } else {
+            int d = day_index(s, n);
+            if (d < 0) return 0;
+            mask |= (uint8_t)(1u << d);
+        }
+        s += n;
+        if (*s == ',') s++;
+    }
+    return mask;
+}
+
+// "HH:MM" -> minuto del día (0..1440); -1 si no es válido
+static int parse_hhmm(const char *s)
+{
+    int h, m;
+    if (!s || sscanf(s, "%d:%d", &h, &m) != 2 || h < 0 || m < 0 || m > 59 || h * 60 + m > 1440) return -1;
+    return h * 60 + m;
+}
+
+static int group_index(const policy_t *p, const char *name)
+{
+    for (int i = 0; i < p->n_groups; ++i) {
+        if (strncmp(p->group_name[i], name, sizeof(p->group_name[i]) - 1) == 0) return i;
+    }
+    return -1;
+}
+
+// Lista de nombres de grupo -> máscara
+static bool parse_groups(compiler_t *c, const cJSON *arr, uint32_t *mask)
+{
+    *mask = 0;
+    if (!arr) return true;
+    if (!cJSON_IsArray(arr)) return fail(c, "\"groups\" debe ser una lista%s", NULL);
+    const cJSON *g;
+    cJSON_ArrayForEach(g, arr) {
+        int gi = cJSON_IsString(g) ? group_index(c->p, g->valuestring) : -1;
+        if (gi < 0) return fail(c, "grupo desconocido: %s", cJSON_IsString(g) ? g->valuestring : "?");
+        *mask |= 1u << gi;
+    }
+    return true;
+}
+
+static bool parse_doors(compiler_t *c, const cJSON *arr, uint8_t *mask)
+{
+    *mask = (1u << POLICY_MAX_DOORS) - 1;
+    if (!arr) return true;
+    *mask = 0;
+    const cJSON *d;
+    cJSON_ArrayForEach(d, arr) {
+        if (!cJSON_IsNumber(d) || d->valueint < 0 || d->valueint >= POLICY_MAX_DOORS) {
+            return fail(c, "puerta fuera de rango%s", NULL);
+        }
+        *mask |= (uint8_t)(1u << d->valueint);
+    }
+    return true;
+}
+
+// Llama a fn(slot) para cada franja cubierta por días/horario. Los tramos
+// que cruzan la medianoche siguen en el día siguiente (el festivo en sí mismo).
+typedef void (*slot_fn_t)(void *ctx, int slot);
+
+static bool for_each_slot(compiler_t *c, const cJSON *rule, slot_fn_t fn, void *ctx)
+{
+    const cJSON *jd = cJSON_GetObjectItem(rule, "days");
+    uint8_t days = parse_days(cJSON_IsString(jd) ? jd->valuestring : NULL);
+    if (!days) return fail(c, "días no válidos: %s", cJSON_IsString(jd) ? jd->valuestring : "?");
+    const cJSON *jf = cJSON_GetObjectItem(rule, "from");
+    const cJSON *jt = cJSON_GetObjectItem(rule, "to");
+    int from = jf ? parse_hhmm(cJSON_IsString(jf) ? jf->valuestring : NULL) : 0;
+    int to = jt ? parse_hhmm(cJSON_IsString(jt) ? jt->valuestring : NULL) : 1440;
+    if (from < 0 || to < 0) return fail(c, "hora no válida (HH:MM)%s", NULL);
+    // Franjas que tocan el tramo: inicio por defecto, fin por exceso
+    int s0 = from / POLICY_SLOT_MIN;
+    int s1 = (to + POLICY_SLOT_MIN - 1) / POLICY_SLOT_MIN;
+    for (int d = 0; d < POLICY_DAY_TYPES; ++d) {
+        if (!(days & (1u << d))) continue;
+        int base = d * POLICY_SLOTS_PER_DAY;
+        if (s0 < s1) {
+            for (int s = s0; s < s1; ++s) fn(ctx, base + s);
+        } else if (s0 > s1) {
+            int next = (d == POLICY_DAY_HOL) ? d : (d + 1) % 7;
+            for (int s = s0; s < POLICY_SLOTS_PER_DAY; ++s) fn(ctx, base + s);
+            for (int s = 0; s < s1; ++s) fn(ctx, next * POLICY_SLOTS_PER_DAY + s);
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    policy_t *p;
+    uint8_t doors;
+    uint32_t groups;
+    bool deny;
+} group_rule_ctx_t;
+
+static void apply_group_rule(void *vctx, int slot)
+{
+    group_rule_ctx_t *x = vctx;
+    for (int d = 0; d < POLICY_MAX_DOORS; ++d) {
+        if (!(x->doors & (1u << d))) continue;
+        if (x->deny) x->p->allow[d][slot] &= ~x->groups;
+        else x->p->allow[d][slot] |= x->groups;
+    }
+}
+
+typedef struct {
+    policy_sched_t *s;
+    uint8_t doors;
+} sched_rule_ctx_t;
+
+static void apply_sched_rule(void *vctx, int slot)
+{
+    sched_rule_ctx_t *x = vctx;
+    for (int d = 0; d < POLICY_MAX_DOORS; ++d) {
+        if (x->doors & (1u << d)) bit_set(x->s->bits[d], slot);
+    }
+}
+
+static bool parse_uid(const char *s, uint32_t *uid)
+{
+    // Admite "EAE8D284" y "EA:E8:D2:84"; solo cuentan los 4 primeros bytes
+    uint32_t v = 0;
+    int nib = 0;
+    for (; *s && nib < 8; ++s) {
+        if (*s == ':' || *s == ' ') continue;
+        int h;
+        if (*s >= '0' && *s <= '9') h = *s - '0';
+        else if (*s >= 'a' && *s <= 'f') h = *s - 'a' + 10;
+        else if (*s >= 'A' && *s <= 'F') h = *s - 'A' + 10;
+        else return false;
+        v = (v << 4) | (uint32_t)h;
+        nib++;
+    }
+    if (nib != 8) return false;
+    *uid = v;
+    return true;
+}
+
+// Horario personal deduplicado: devuelve su índice o POLICY_NO_SCHED si no cabe
+static uint16_t sched_intern(compiler_t *c, const policy_sched_t *s)
+{
+    policy_t *p = c->p;
+    for (uint16_t i = 0; i < p->n_sched; ++i) {
+        if (memcmp(&p->sched[i], s, sizeof(*s)) == 0) return i;
+    }
+    if (p->n_sched >= POLICY_MAX_SCHED) return POLICY_NO_SCHED;
+    if (p->n_sched == c->sched_cap) {
+        uint16_t cap = c->sched_cap ? (uint16_t)(c->sched_cap * 2) : 4;
+        policy_sched_t *ns = realloc(p->sched, sizeof(*ns) * cap);
+        if (!ns) return POLICY_NO_SCHED;
+        p->sched = ns;
+        c->sched_cap = cap;
+    }
+    p->sched[p->n_sched] = *s;
+    return p->n_sched++;
+}
+
+static int cmp_cred(const void *a, const void *b)
+{
+    uint32_t x = ((const policy_cred_t *)a)->uid, y = ((const policy_cred_t *)b)->uid;
+    return (x > y) - (x < y);
+}
+
+static int cmp_i32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int32_t policy_epoch_day(int year, int month, int day)
+{
+    // Días desde 1970-01-01 (calendario gregoriano proléptico)
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    int32_t yoe = year - era * 400;
+    int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static bool compile_rules(compiler_t *c, const cJSON *rules)
+{
+    if (!rules) return true;
+    if (!cJSON_IsArray(rules)) return fail(c, "\"rules\" debe ser una lista%s", NULL);
+    // Dos pasadas: allow y después deny, para que las excepciones siempre ganen
+    for (int pass = 0; pass < 2; ++pass) {
+        const cJSON *r;
+        cJSON_ArrayForEach(r, rules) {
+            const cJSON *je = cJSON_GetObjectItem(r, "effect");
+            bool deny = cJSON_IsString(je) && strcmp(je->valuestring, "deny") == 0;
+            if (cJSON_IsString(je) && !deny && strcmp(je->valuestring, "allow") != 0) {
+                return fail(c, "efecto desconocido: %s", je->valuestring);
+            }
+            if (deny != (pass == 1)) continue;
+            group_rule_ctx_t x = { .p = c->p, .deny = deny };
+            if (!parse_groups(c, cJSON_GetObjectItem(r, "groups"), &x.groups)) return false;
+            if (!parse_doors(c, cJSON_GetObjectItem(r, "doors"), &x.doors)) return false;
+            if (!for_each_slot(c, r, apply_group_rule, &x)) return false;
+            c->p->n_rules++;
+        }
+    }
+    return true;
+}
+
+static bool compile_creds(compiler_t *c, const cJSON *creds)
+{
+    policy_t *p = c->p;
+    if (!creds) return true;
+    if (!cJSON_IsArray(creds)) return fail(c, "\"credentials\" debe ser una lista%s", NULL);
+    int n = cJSON_GetArraySize(creds);
+    p->creds = calloc((size_t)(n ? n : 1), sizeof(policy_cred_t));
+    if (!p->creds) return fail(c, "sin memoria%s", NULL);
+    const cJSON *jc;
+    cJSON_ArrayForEach(jc, creds) {
+        const cJSON *ju = cJSON_GetObjectItem(jc, "uid");
+        policy_cred_t *pc = &p->creds[p->n_creds];
+        if (!cJSON_IsString(ju) || !parse_uid(ju->valuestring, &pc->uid)) {
+            return fail(c, "uid no válido: %s", cJSON_IsString(ju) ? ju->valuestring : "?");
+        }
+        if (!parse_groups(c, cJSON_GetObjectItem(jc, "groups"), &pc->groups)) return false;
+        pc->sched = POLICY_NO_SCHED;
+        const cJSON *jr = cJSON_GetObjectItem(jc, "rules");
+        if (cJSON_IsArray(jr) && cJSON_GetArraySize(jr) > 0) {
+            policy_sched_t s;
+            memset(&s, 0, sizeof(s));
+            const cJSON *r;
+            cJSON_ArrayForEach(r, jr) {
+                sched_rule_ctx_t x = { .s = &s };
+                if (!parse_doors(c, cJSON_GetObjectItem(r, "doors"), &x.doors)) return false;
+                if (!for_each_slot(c, r, apply_sched_rule, &x)) return false;
+                p->n_rules++;
+            }
+            pc->sched = sched_intern(c, &s);
+            if (pc->sched == POLICY_NO_SCHED) return fail(c, "demasiados horarios personales%s", NULL);
+        }
+        p->n_creds++;
+    }
+    qsort(p->creds, p->n_creds, sizeof(policy_cred_t), cmp_cred);
+    for (uint32_t i = 1; i < p->n_creds; ++i) {
+        if (p->creds[i].uid == p->creds[i - 1].uid) return fail(c, "uid duplicado%s", NULL);
+    }
+    return true;
+}
+
+static bool compile_top(compiler_t *c, const cJSON *root)
+{
+    policy_t *p = c->p;
+    if (!cJSON_IsObject(root)) return fail(c, "la política debe ser un objeto JSON%s", NULL);
+
+    const cJSON *jv = cJSON_GetObjectItem(root, "version");
+    p->version = cJSON_IsNumber(jv) ? (uint32_t)jv->valuedouble : 0;
+
+    p->rule = -1;
+    const cJSON *jm = cJSON_GetObjectItem(root, "mode");
+    if (cJSON_IsString(jm)) {
+        static const char *k_modes[FUSION_RULE_COUNT] = { "or", "and", "2of3", "dual" };
+        for (int i = 0; i < FUSION_RULE_COUNT; ++i) {
+            if (strcmp(jm->valuestring, k_modes[i]) == 0) p->rule = (int8_t)i;
+        }
+        if (p->rule < 0) return fail(c, "modo desconocido: %s", jm->valuestring);
+    }
+    const cJSON *jw = cJSON_GetObjectItem(root, "window_ms");
+    p->window_ms = cJSON_IsNumber(jw) && jw->valueint > 0 ? jw->valueint : -1;
+
+    const cJSON *jg = cJSON_GetObjectItem(root, "groups");
+    if (!cJSON_IsArray(jg)) return fail(c, "falta la lista \"groups\"%s", NULL);
+    const cJSON *g;
+    cJSON_ArrayForEach(g, jg) {
+        if (!cJSON_IsString(g)) return fail(c, "nombre de grupo no válido%s", NULL);
+        if (p->n_groups >= POLICY_MAX_GROUPS) return fail(c, "más de 32 grupos%s", NULL);
+        if (group_index(p, g->valuestring) >= 0) return fail(c, "grupo duplicado: %s", g->valuestring);
+        snprintf(p->group_name[p->n_groups++], sizeof(p->group_name[0]), "%s", g->valuestring);
+    }
+
+    if (!parse_groups(c, cJSON_GetObjectItem(root, "combo"), &p->method_groups[CRED_COMBO])) return false;
+    if (!parse_groups(c, cJSON_GetObjectItem(root, "remote"), &p->method_groups[CRED_REMOTE])) return false;
+
+    const cJSON *jh = cJSON_GetObjectItem(root, "holidays");
+    const cJSON *h;
+    cJSON_ArrayForEach(h, jh) {
+        int y, m, d;
+        if (!cJSON_IsString(h) || sscanf(h->valuestring, "%d-%d-%d", &y, &m, &d) != 3 ||
+            m < 1 || m > 12 || d < 1 || d > 31) {
+            return fail(c, "festivo no válido: %s", cJSON_IsString(h) ? h->valuestring : "?");
+        }
+        if (p->n_holidays >= POLICY_MAX_HOLIDAYS) return fail(c, "demasiados festivos%s", NULL);
+        p->holidays[p->n_holidays++] = policy_epoch_day(y, m, d);
+    }
+    qsort(p->holidays, p->n_holidays, sizeof(int32_t), cmp_i32);
+
+    if (!compile_rules(c, cJSON_GetObjectItem(root, "rules"))) return false;
+    if (!compile_creds(c, cJSON_GetObjectItem(root, "credentials"))) return false;
+
+    for (int d = 0; d < POLICY_MAX_DOORS; ++d) {
+        uint32_t all = ~0u;
+        for (int s = 0; s < POLICY_SLOTS; ++s) all &= p->allow[d][s];
+        p->always[d] = all;
+    }
+    return true;
+}
+
+policy_t *policy_compile(const char *json, size_t len, char *err, size_t err_len)
+{
+    if (err && err_len) err[0] = '\0';
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!root) {
+        if (err && err_len) snprintf(err, err_len, "JSON no válido");
+        return NULL;
+    }
+    policy_t *p = calloc(1, sizeof(policy_t));
+    compiler_t c = { .p = p, .err = err, .err_len = err_len };
+    bool ok = p && compile_top(&c, root);
+    cJSON_Delete(root);
+    if (!ok) {
+        if (!p && err && err_len) snprintf(err, err_len, "sin memoria");
+        policy_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void policy_free(policy_t *p)
+{
+    if (!p) return;
+    free(p->creds);
+    free(p->sched);
+    free(p);
+}
+
+size_t policy_size(const policy_t *p)
+{
+    return sizeof(*p) + p->n_creds * sizeof(policy_cred_t) + p->n_sched * sizeof(policy_sched_t);
+}
+
+int policy_slot(const policy_t *p, int wday, int minute, int32_t epoch_day)
+{
+    if (wday < 0 || wday > 6 || minute < 0 || minute >= 1440) return POLICY_NO_CLOCK;
+    int dtype = (wday + 6) % 7;  // struct tm: 0 = domingo -> 0 = lunes
+    // Festivos: búsqueda binaria en la lista ordenada
+    int lo = 0, hi = p->n_holidays;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (p->holidays[mid] < epoch_day) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < p->n_holidays && p->holidays[lo] == epoch_day) dtype = POLICY_DAY_HOL;
+    return dtype * POLICY_SLOTS_PER_DAY + minute / POLICY_SLOT_MIN;
+}
+
+static const policy_cred_t *policy_find(const policy_t *p, uint32_t uid)
+{
+    uint32_t lo = 0, hi = p->n_creds;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (p->creds[mid].uid < uid) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < p->n_creds && p->creds[lo].uid == uid) ? &p->creds[lo] : NULL;
+}
+
+policy_decision_t policy_decide(const policy_t *p, int door, cred_method_t m,
+                                const uint8_t *id, uint8_t id_len, int slot)
+{
+    if (!p || door < 0 || door >= POLICY_MAX_DOORS) return POLICY_DENY_UNKNOWN;
+    uint32_t groups;
+    uint16_t sched = POLICY_NO_SCHED;
+    if (m == CRED_RFID) {
+        if (id_len < 4) return POLICY_DENY_UNKNOWN;
+        uint32_t uid = ((uint32_t)id[0] << 24) | ((uint32_t)id[1] << 16) | ((uint32_t)id[2] << 8) | id[3];
+        const policy_cred_t *c = policy_find(p, uid);
+        if (!c) return POLICY_DENY_UNKNOWN;
+        groups = c->groups;
+        sched = c->sched;
+    } else if ((unsigned)m < CRED_METHOD_COUNT) {
+        groups = p->method_groups[m];
+    } else {
+        return POLICY_DENY_UNKNOWN;
+    }
+    if (slot == POLICY_NO_CLOCK) {
+        // Sin hora válida solo entra quien tiene acceso a todas horas
+        return (p->always[door] & groups) ? POLICY_ALLOW : POLICY_DENY_SCHEDULE;
+    }
+    if (slot < 0 || slot >= POLICY_SLOTS) return POLICY_DENY_SCHEDULE;
+    if (p->allow[door][slot] & groups) return POLICY_ALLOW;
+    if (sched != POLICY_NO_SCHED && bit_get(p->sched[sched].bits[door], slot)) return POLICY_ALLOW;
+    return POLICY_DENY_SCHEDULE;
+}
+
+const char *policy_decision_name(policy_decision_t d)
+{
+    switch (d) {
+    case POLICY_ALLOW:         return "allow";
+    case POLICY_DENY_UNKNOWN:  return "unknown";
+    case POLICY_DENY_SCHEDULE: return "schedule";
+    default:                   return "?";
+    }
+}
@@ -0,0 +1,263 @@
+#include "app_config.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CFG_KEY_SCHEMA "schema"
+
+#define I32_SINCE(k, f, lo, hi, fl, v) \
+    { k, CFG_T_I32, v, fl, offsetof(app_cfg_t, f), sizeof(int32_t), lo, hi }
+#define I32(k, f, lo, hi, fl) I32_SINCE(k, f, lo, hi, fl, 1)
+#define STR(k, f, lo, fl) \
+    { k, CFG_T_STR, 1, fl, offsetof(app_cfg_t, f), sizeof(((app_cfg_t *)0)->f), lo, sizeof(((app_cfg_t *)0)->f) - 1 }
+#define PIN(k, f) I32(k, pins.f, -1, 39, CFG_F_REBOOT)
+
+// Esquema: añadir campos solo al final y con since = CFG_SCHEMA_VERSION nuevo
+const cfg_field_t cfg_fields[] = {
+    STR("wifi_ssid",     wifi_ssid, 1, 0),
+    STR("wifi_pass",     wifi_pass, 0, CFG_F_SECRET),
+    STR("mqtt_uri",      mqtt_uri, 8, 0),
+    STR("combo",         combo, 3, CFG_F_SECRET | CFG_F_DIGITS),
+    I32("unlock_max_ms", unlock_max_ms, 1000, 120000, 0),
+    I32("relock_ms",     relock_ms, 100, 30000, 0),
+    I32("pot_settle_ms", pot_settle_ms, 1000, 10000, 0),  // >= POT_SETTLE_MIN_MS
+    I32("lcd_idle_ms",   lcd_idle_ms, 1000, 600000, 0),
+    PIN("pin_lock",      lock),
+    PIN("pin_door",      door),
+    PIN("pin_buzzer",    buzzer),
+    PIN("pin_led_st",    led_status),
+    PIN("pin_led_ok",    led_green),
+    PIN("pin_led_err",   led_red),
+    PIN("pin_pot",       pot),
+    PIN("pin_i2c_sda",   i2c_sda),
+    PIN("pin_i2c_scl",   i2c_scl),
+    PIN("pin_rfid_cs",   rfid_cs),
+    PIN("pin_rfid_sck",  rfid_sck),
+    PIN("pin_rfid_mosi", rfid_mosi),
+    PIN("pin_rfid_miso", rfid_miso),
+    PIN("pin_rfid_rst",  rfid_rst),
+    I32_SINCE("twin_min_ms", twin_min_ms, 20, 60000, 0, 2),
+    I32_SINCE("power",       power, 0, 2, 0, 3),        // perf, balanced, battery
+};
+const size_t cfg_field_count = sizeof(cfg_fields) / sizeof(cfg_fields[0]);
+
+static void *field_ptr(app_cfg_t *c, const cfg_field_t *f) { return (uint8_t *)c + f->offset; }
+static const void *field_cptr(const app_cfg_t *c, const cfg_field_t *f) { return (const uint8_t *)c + f->offset; }
+
+static bool valid_i32(const cfg_field_t *f, int32_t v)
+{
+    return v >= f->min && v <= f->max;
+}
+
+static bool valid_str(const cfg_field_t *f, const char *v)
+{
+    size_t n = strlen(v);
+    if (n < (size_t)f->min || n > (size_t)f->max) return false;
+    if (f->flags & CFG_F_DIGITS) {
+        for (size_t i = 0; i < n; ++i) {
+            if (v[i] < '0' || v[i] > '9') return false;
+        }
+    }
+    return true;
+}
+
+static bool field_equal(const app_cfg_t *a, const app_cfg_t *b, const cfg_field_t *f)
+{
+    if (f->type == CFG_T_STR) return strcmp(field_cptr(a, f), field_cptr(b, f)) == 0;
+    return memcmp(field_cptr(a, f), field_cptr(b, f), f->size) == 0;
+}
+
+int cfg_field_index(const char *key)
+{
+    for (size_t i = 0; i < cfg_field_count; ++i) {
+        if (strcmp(cfg_fields[i].key, key) == 0) return (int)i;
+    }
+    return -1;
+}
+
+bool cfg_changed_with_flag(uint64_t changed, uint8_t flag)
+{
+    for (size_t i = 0; i < cfg_field_count; ++i) {
+        if ((changed >> i & 1u) && (cfg_fields[i].flags & flag)) return true;
+    }
+    return false;
+}
+
+// Solo el escritor lee la vigente sin fijarla: nadie más la reutiliza
+static const app_cfg_t *latest(cfg_store_t *s)
+{
+    return atomic_load(&s->cur);
+}
+
+const app_cfg_t *cfg_acquire(cfg_store_t *s)
+{
+    for (;;) {
+        const app_cfg_t *c = atomic_load(&s->cur);
+        _Atomic uint32_t *n = &s->readers[c - s->pool];
+        atomic_fetch_add(n, 1);
+        // Si sigue vigente tras fijarla, el escritor ya no puede reutilizarla;
+        // si no, pudo empezar a reescribirla: soltar y repetir con la nueva
+        if (atomic_load(&s->cur) == c) return c;
+        atomic_fetch_sub(n, 1);
+    }
+}
+
+void cfg_release(cfg_store_t *s, const app_cfg_t *c)
+{
+    atomic_fetch_sub(&s->readers[c - s->pool], 1);
+}
+
+// Instantánea libre: ni vigente ni fijada por un lector
+static app_cfg_t *snapshot_free(cfg_store_t *s)
+{
+    const app_cfg_t *cur = latest(s);
+    for (int i = 0; i < CFG_SNAPSHOTS; ++i) {
+        if (&s->pool[i] != cur && atomic_load(&s->readers[i]) == 0) return &s->pool[i];
+    }
+    return NULL;
+}
+
+cfg_err_t cfg_publish(cfg_store_t *s, const app_cfg_t *next)
+{
+    app_cfg_t *slot = snapshot_free(s);
+    if (!slot) {
+        s->busy++;
+        return CFG_ERR_BUSY;
+    }
+    *slot = *next;
+    slot->gen = ++s->next_gen;
+    slot->published_us = s->now_us();
+    atomic_store(&s->cur, slot);
+    return CFG_OK;
+}
+
+void cfg_boot(cfg_store_t *s, const app_cfg_t *defaults, const cfg_backend_t *be,
+              int64_t (*now_us)(void), cfg_load_report_t *rep)
+{
+    memset(s, 0, sizeof(*s));
+    atomic_init(&s->cur, NULL);
+    for (int i = 0; i < CFG_SNAPSHOTS; ++i) atomic_init(&s->readers[i], 0);
+    s->be = be;
+    s->now_us = now_us;
+    cfg_load_report_t r = { 0 };
+    app_cfg_t c = *defaults;
+
+    int32_t schema = 0;
+    if (be && be->get_i32(be->ctx, CFG_KEY_SCHEMA, &schema)) r.stored_schema = (uint32_t)schema;
+    for (size_t i = 0; be && r.stored_schema && i < cfg_field_count; ++i) {
+        const cfg_field_t *f = &cfg_fields[i];
+        if (f->since > r.stored_schema) {
+            r.defaulted++;
+            continue;
+        }
+        bool ok;
+        if (f->type == CFG_T_I32) {
+            int32_t v;
+            ok = be->get_i32(be->ctx, f->key, &v);
+            if (ok && !valid_i32(f, v)) { r.rejected++; continue; }
+            if (ok) *(int32_t *)field_ptr(&c, f) = v;
+        } else {
+            char v[128];
+            ok = be->get_str(be->ctx, f->key, v, sizeof(v));
+            if (ok && !valid_str(f, v)) { r.rejected++; continue; }
+            if (ok) strcpy(field_ptr(&c, f), v);
+        }
+        if (ok) r.loaded++;
+        else r.defaulted++;
+    }
+    if (!r.stored_schema) r.defaulted = (uint16_t)cfg_field_count;
+    // Esquema anterior: los campos nuevos quedan con su valor de fábrica
+    if (be && r.stored_schema && r.stored_schema < CFG_SCHEMA_VERSION) {
+        be->set_i32(be->ctx, CFG_KEY_SCHEMA, CFG_SCHEMA_VERSION);
+        if (be->commit) be->commit(be->ctx);
+    }
+    cfg_publish(s, &c);
+    if (rep) *rep = r;
+}
+
+static bool patch_field(app_cfg_t *c, const cfg_field_t *f, const cJSON *v, char *err, size_t err_len)
+{
+    if (f->type == CFG_T_I32) {
+        double d = cJSON_IsNumber(v) ? v->valuedouble : (double)f->min - 1;
+        if (d < f->min || d > f->max || d != (double)(int32_t)d) {
+            snprintf(err, err_len, "%s: entero en [%ld, %ld]", f->key, (long)f->min, (long)f->max);
+            return false;
+        }
+        *(int32_t *)field_ptr(c, f) = (int32_t)d;
+    } else {
+        if (!cJSON_IsString(v) || !valid_str(f, v->valuestring)) {
+            snprintf(err, err_len, "%s: texto de %ld..%ld caracteres", f->key, (long)f->min, (long)f->max);
+            return false;
+        }
+        strcpy(field_ptr(c, f), v->valuestring);
+    }
+    return true;
+}
+
+static bool store_field(const cfg_backend_t *be, const app_cfg_t *c, const cfg_field_t *f)
+{
+    if (f->type == CFG_T_I32) return be->set_i32(be->ctx, f->key, *(const int32_t *)field_cptr(c, f));
+    return be->set_str(be->ctx, f->key, field_cptr(c, f));
+}
+
+cfg_err_t cfg_update_json(cfg_store_t *s, const char *json, size_t len,
+                          uint64_t *changed, char *err, size_t err_len)
+{
+    char dummy[1];
+    if (!err || !err_len) { err = dummy; err_len = sizeof(dummy); }
+    err[0] = '\0';
+    if (changed) *changed = 0;
+
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    if (!cJSON_IsObject(root)) {
+        snprintf(err, err_len, "JSON inválido");
+        cJSON_Delete(root);
+        return CFG_ERR_PARSE;
+    }
+    const app_cfg_t *cur = latest(s);
+    app_cfg_t next = *cur;
+    for (const cJSON *it = root->child; it; it = it->next) {
+        int i = cfg_field_index(it->string);
+        if (i < 0) {
+            snprintf(err, err_len, "%s: clave desconocida", it->string);
+            cJSON_Delete(root);
+            return CFG_ERR_PARSE;
+        }
+        if (!patch_field(&next, &cfg_fields[i], it, err, err_len)) {
+            cJSON_Delete(root);
+            return CFG_ERR_PARSE;
+        }
+    }
+    cJSON_Delete(root);
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < cfg_field_count; ++i) {
+        if (!field_equal(cur, &next, &cfg_fields[i])) mask |= 1ull << i;
+    }
+    if (changed) *changed = mask;
+    if (!mask) return CFG_OK;
+    // Sin instantánea libre no se toca NVS: el cambio se rechaza entero
+    if (!snapshot_free(s)) {
+        s->busy++;
+        return CFG_ERR_BUSY;
+    }
+
+    if (s->be) {
+        bool ok = s->be->set_i32(s->be->ctx, CFG_KEY_SCHEMA, CFG_SCHEMA_VERSION);
+        for (size_t i = 0; ok && i < cfg_field_count; ++i) {
+            if (mask >> i & 1u) ok = store_field(s->be, &next, &cfg_fields[i]);
+        }
+        if (ok && s->be->commit) ok = s->be->commit(s->be->ctx);
+        if (!ok) {
+            snprintf(err, err_len, "error de escritura");
+            return CFG_ERR_STORE;
+        }
+    }
+    return cfg_publish(s, &next);
+}
+
+const char *cfg_err_name(cfg_err_t e)
+{
+    static const char *names[] = { "ok", "parse", "store", "busy" };
+    return ((unsigned)e < sizeof(names) / sizeof(names[0])) ? names[e] : "?";
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configuración de ejecución: red, broker, combinación, tiempos y mapa de
+// pines. Los #define de main.c pasan a ser solo los valores de fábrica; lo
+// vigente vive en NVS (un valor tipado por clave) y se edita por MQTT
+// (iot/config) sin recompilar.
+//
+// Esquema versionado: cada campo declara la versión de esquema que lo
+// introdujo (since). Al cargar una configuración guardada con un esquema
+// anterior, los campos nuevos toman su valor de fábrica y se reescribe la
+// versión; los valores fuera de rango se descartan (también de fábrica).
+//
+// Instantáneas inmutables (estilo RCU): un cambio se prepara en una
+// instantánea libre del pool y se publica con un intercambio atómico del
+// puntero vigente. Los lectores no toman cerrojos: cfg_acquire() fija la
+// vigente con un contador atómico por instantánea y cfg_release() la
+// suelta; el escritor solo reutiliza instantáneas sin lectores, así que el
+// periodo de gracia termina cuando el último lector suelta la anterior (no
+// depende de cuánto tarde en planificarse una tarea).
+// Regla para lectores: fijar al empezar la iteración y soltar al acabarla.
+// Un solo escritor (el manejador MQTT; app_main durante el arranque).
+//
+// Módulo sin dependencias de ESP-IDF (usa cJSON): el almacenamiento llega
+// como cfg_backend_t (NVS en main.c, memoria en tools/cfg_reload).
+
+#define CFG_SCHEMA_VERSION  3
+#define CFG_SNAPSHOTS       3
+#define CFG_COMBO_MAX       8
+#define CFG_NVS_NAMESPACE   "appcfg"
+
+typedef struct {
+    int32_t lock;            // Relay del electroimán
+    int32_t door;            // Reed (pull-up interno)
+    int32_t buzzer;
+    int32_t led_status;
+    int32_t led_green;
+    int32_t led_red;
+    int32_t pot;             // Entrada ADC1 del potenciómetro
+    int32_t i2c_sda;
+    int32_t i2c_scl;
+    int32_t rfid_cs;
+    int32_t rfid_sck;
+    int32_t rfid_mosi;
+    int32_t rfid_miso;
+    int32_t rfid_rst;
+} cfg_pins_t;
+
+typedef struct {
+    uint32_t gen;            // Generación: cambia con cada publicación
+    int64_t published_us;    // Instante de publicación (latencia de recarga)
+    char wifi_ssid[33];
+    char wifi_pass[65];
+    char mqtt_uri[96];
+    char combo[CFG_COMBO_MAX + 1];   // Dígitos de la combinación ("364")
+    int32_t unlock_max_ms;
+    int32_t relock_ms;
+    int32_t pot_settle_ms;
+    int32_t lcd_idle_ms;
+    int32_t twin_min_ms;     // Intervalo mínimo entre mensajes al gemelo (esquema 2)
+    int32_t power;           // Perfil de energía, power_prof_id_t (esquema 3)
+    cfg_pins_t pins;
+} app_cfg_t;
+
+typedef enum {
+    CFG_T_I32 = 0,
+    CFG_T_STR,
+} cfg_type_t;
+
+#define CFG_F_SECRET  (1u << 0)  // No se publica en los informes
+#define CFG_F_REBOOT  (1u << 1)  // Se guarda, pero solo se aplica al reiniciar
+#define CFG_F_DIGITS  (1u << 2)  // STR: solo dígitos 0-9
+
+typedef struct {
+    const char *key;         // Clave NVS y JSON (máx. 15 caracteres)
+    uint8_t type;            // cfg_type_t
+    uint8_t since;           // Versión de esquema que introdujo el campo
+    uint8_t flags;           // CFG_F_*
+    uint16_t offset;
+    uint16_t size;           // STR: capacidad con terminador
+    int32_t min, max;        // I32: rango; STR: longitud
+} cfg_field_t;
+
+extern const cfg_field_t cfg_fields[];
+extern const size_t cfg_field_count;
+
+// Almacenamiento por clave; get_* devuelve false si la clave no existe
+typedef struct {
+    void *ctx;
+    bool (*get_i32)(void *ctx, const char *key, int32_t *out);
+    bool (*set_i32)(void *ctx, const char *key, int32_t v);
+    bool (*get_str)(void *ctx, const char *key, char *out, size_t cap);
+    bool (*set_str)(void *ctx, const char *key, const char *v);
+    bool (*commit)(void *ctx);
+} cfg_backend_t;
+
+typedef struct {
+    app_cfg_t pool[CFG_SNAPSHOTS];
+    _Atomic uint32_t readers[CFG_SNAPSHOTS];  // Lectores que la tienen fijada
+    _Atomic(const app_cfg_t *) cur;
+    const cfg_backend_t *be;
+    int64_t (*now_us)(void);                 // Reloj (esp_timer_get_time en el firmware)
+    uint32_t next_gen;
+    uint32_t busy;                           // Cambios rechazados sin instantánea libre
+} cfg_store_t;
+
+typedef struct {
+    uint32_t stored_schema;  // 0 = NVS vacía
+    uint16_t loaded;         // Campos leídos de NVS
+    uint16_t defaulted;      // Ausentes o de un esquema posterior
+    uint16_t rejected;       // Fuera de rango
+} cfg_load_report_t;
+
+typedef enum {
+    CFG_OK = 0,
+    CFG_ERR_PARSE,           // JSON inválido o campo con tipo/rango incorrecto
+    CFG_ERR_STORE,           // Falló la escritura en NVS
+    CFG_ERR_BUSY,            // Todas las instantáneas anteriores siguen fijadas
+} cfg_err_t;
+
+// Carga desde el backend (o solo valores de fábrica si be == NULL) y
+// publica la primera instantánea
+void cfg_boot(cfg_store_t *s, const app_cfg_t *defaults, const cfg_backend_t *be,
+              int64_t (*now_us)(void), cfg_load_report_t *rep);
+
+// Lectura sin cerrojos: la instantánea no cambia hasta cfg_release()
+const app_cfg_t *cfg_acquire(cfg_store_t *s);
+void cfg_release(cfg_store_t *s, const app_cfg_t *c);
+
+// Aplica un parche JSON ({"combo":"123","unlock_max_ms":8000,...}): valida,
+// guarda en el backend solo lo cambiado y publica una instantánea nueva.
+// changed: bit i = cfg_fields[i] cambió. Sin cambios no publica nada.
+cfg_err_t cfg_update_json(cfg_store_t *s, const char *json, size_t len,
+                          uint64_t *changed, char *err, size_t err_len);
+// Publica una configuración completa ya validada (sin tocar el backend)
+cfg_err_t cfg_publish(cfg_store_t *s, const app_cfg_t *next);
+
+// ¿Algún campo marcado cambió? (p. ej. CFG_F_REBOOT)
+bool cfg_changed_with_flag(uint64_t changed, uint8_t flag);
+int cfg_field_index(const char *key);
+const char *cfg_err_name(cfg_err_t e);
+
+#ifdef __cplusplus
+}
+#endif
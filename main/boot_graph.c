@@ -0,0 +1,112 @@
+#include "boot_graph.h"
+#include <stdio.h>
+#include <string.h>
+
+bool boot_graph_init(boot_graph_t *g, const boot_step_t *steps, size_t count, int64_t t0_us)
+{
+    memset(g, 0, sizeof(*g));
+    if (count > BOOT_STEPS_MAX) return false;
+    uint32_t all = (1u << count) - 1;
+    for (size_t i = 0; i < count; ++i) {
+        if (steps[i].deps & ~all) return false;
+        if (steps[i].flags & BOOT_F_CRITICAL) {
+            for (size_t d = 0; d < count; ++d) {
+                if ((steps[i].deps & BOOT_DEP(d)) && !(steps[d].flags & BOOT_F_CRITICAL)) return false;
+            }
+        }
+    }
+    // Orden topológico por capas: si una vuelta no resuelve nada, hay ciclo
+    uint32_t resolved = 0;
+    while (resolved != all) {
+        uint32_t layer = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!(resolved & BOOT_DEP(i)) && (steps[i].deps & ~resolved) == 0) layer |= BOOT_DEP(i);
+        }
+        if (!layer) return false;
+        resolved |= layer;
+    }
+    g->steps = steps;
+    g->count = (uint8_t)count;
+    g->t0_us = t0_us;
+    return true;
+}
+
+int boot_graph_claim(boot_graph_t *g, uint8_t flags)
+{
+    for (int i = 0; i < g->count; ++i) {
+        const boot_step_t *s = &g->steps[i];
+        if (g->claimed & BOOT_DEP(i)) continue;
+        if ((s->flags & flags) != flags) continue;
+        if ((s->deps & ~g->done) != 0) continue;
+        g->claimed |= BOOT_DEP(i);
+        return i;
+    }
+    return -1;
+}
+
+void boot_graph_done(boot_graph_t *g, int i)
+{
+    g->done |= BOOT_DEP(i);
+}
+
+void boot_graph_run(boot_graph_t *g, int i, uint8_t worker, int64_t (*now_us)(void))
+{
+    boot_mark_t *m = &g->marks[i];
+    m->worker = worker;
+    m->start_us = now_us();
+    if (g->steps[i].run) g->steps[i].run();
+    m->end_us = now_us();
+}
+
+bool boot_graph_pending(const boot_graph_t *g)
+{
+    return g->claimed != ((1u << g->count) - 1);
+}
+
+bool boot_graph_finished(const boot_graph_t *g)
+{
+    return g->done == ((1u << g->count) - 1);
+}
+
+int64_t boot_graph_span_us(const boot_graph_t *g, uint8_t flags)
+{
+    int64_t end = g->t0_us;
+    for (int i = 0; i < g->count; ++i) {
+        if (!(g->done & BOOT_DEP(i)) || (g->steps[i].flags & flags) != flags) continue;
+        if (g->marks[i].end_us > end) end = g->marks[i].end_us;
+    }
+    return end - g->t0_us;
+}
+
+int64_t boot_graph_serial_us(const boot_graph_t *g)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < g->count; ++i) {
+        if (g->done & BOOT_DEP(i)) sum += g->marks[i].end_us - g->marks[i].start_us;
+    }
+    return sum;
+}
+
+int boot_graph_report(const boot_graph_t *g, char *buf, size_t cap)
+{
+    size_t n = 0;
+    int w = snprintf(buf, cap, "{\"t0_us\":%lld,\"critical_us\":%lld,\"total_us\":%lld,\"serial_us\":%lld,\"steps\":[",
+                     (long long)g->t0_us, (long long)boot_graph_span_us(g, BOOT_F_CRITICAL),
+                     (long long)boot_graph_span_us(g, 0), (long long)boot_graph_serial_us(g));
+    if (w < 0) return w;
+    n += (size_t)w;
+    for (int i = 0; i < g->count; ++i) {
+        const boot_mark_t *m = &g->marks[i];
+        bool ok = g->done & BOOT_DEP(i);
+        w = snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0,
+                     "%s{\"name\":\"%s\",\"start_us\":%lld,\"end_us\":%lld,\"worker\":%u}",
+                     i ? "," : "", g->steps[i].name,
+                     ok ? (long long)(m->start_us - g->t0_us) : -1LL,
+                     ok ? (long long)(m->end_us - g->t0_us) : -1LL, (unsigned)m->worker);
+        if (w < 0) return w;
+        n += (size_t)w;
+    }
+    w = snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, "]}");
+    if (w < 0) return w;
+    return (int)(n + (size_t)w);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Arranque como grafo de dependencias. Cada paso declara de qué pasos
+// depende; los marcados BOOT_F_CRITICAL (cerradura, puerta, controlador) los
+// ejecuta app_main en orden y antes que nada, y el resto (red, SPIFFS, LCD,
+// RFID...) lo reparten tareas de arranque en cuanto sus dependencias están
+// listas, en paralelo y sin retrasar la puerta.
+//
+// El grafo no sincroniza: quien lo use serializa claim/done (sección
+// crítica en el firmware, mutex en tools/boot_sim). boot_graph_run() sí va
+// fuera del cerrojo: anota inicio/fin del paso con el reloj dado y lo ejecuta.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/boot_sim).
+
+#define BOOT_STEPS_MAX   24
+#define BOOT_DEP(i)      (1u << (i))
+#define BOOT_F_CRITICAL  (1u << 0)  // Antes de ceder el arranque a las tareas
+
+typedef struct {
+    const char *name;
+    uint32_t deps;           // BOOT_DEP(...) | BOOT_DEP(...)
+    uint8_t flags;           // BOOT_F_*
+    void (*run)(void);
+} boot_step_t;
+
+typedef struct {
+    int64_t start_us, end_us;
+    uint8_t worker;          // 0 = app_main; 1.. = tarea de arranque
+} boot_mark_t;
+
+typedef struct {
+    const boot_step_t *steps;
+    uint8_t count;
+    uint32_t claimed;        // Asignados (en curso o terminados)
+    uint32_t done;
+    int64_t t0_us;           // Entrada en app_main
+    boot_mark_t marks[BOOT_STEPS_MAX];
+} boot_graph_t;
+
+// false si hay más de BOOT_STEPS_MAX pasos, dependencias inexistentes,
+// ciclos o un paso crítico que depende de uno que no lo es
+bool boot_graph_init(boot_graph_t *g, const boot_step_t *steps, size_t count, int64_t t0_us);
+
+// Siguiente paso listo (dependencias hechas) con todos los flags pedidos, en
+// orden de declaración; -1 si no hay ninguno ahora mismo
+int boot_graph_claim(boot_graph_t *g, uint8_t flags);
+void boot_graph_done(boot_graph_t *g, int i);
+// Ejecuta el paso i anotando sus tiempos
+void boot_graph_run(boot_graph_t *g, int i, uint8_t worker, int64_t (*now_us)(void));
+
+// ¿Quedan pasos sin asignar? (las tareas de arranque terminan cuando no)
+bool boot_graph_pending(const boot_graph_t *g);
+bool boot_graph_finished(const boot_graph_t *g);
+// Fin del último paso con esos flags (0 = todos), relativo a t0_us
+int64_t boot_graph_span_us(const boot_graph_t *g, uint8_t flags);
+// Suma de duraciones: lo que costaría el arranque en serie
+int64_t boot_graph_serial_us(const boot_graph_t *g);
+
+// Informe JSON: {"t0_us":..,"critical_us":..,"total_us":..,"serial_us":..,
+// "steps":[{"name":"nvs","start_us":..,"end_us":..,"worker":0},...]} con
+// tiempos relativos a t0_us. Devuelve la longitud (como snprintf).
+int boot_graph_report(const boot_graph_t *g, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
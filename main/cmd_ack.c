@@ -0,0 +1,165 @@
+#include "cmd_ack.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const k_names[CMD_ST_COUNT] = {
+    [CMD_ST_NONE] = "none",
+    [CMD_ST_RECEIVED] = "received",
+    [CMD_ST_PENDING] = "pending",
+    [CMD_ST_AUTHORIZED] = "authorized",
+    [CMD_ST_WAITING_DOOR] = "waiting_door",
+    [CMD_ST_ACTUATED] = "actuated",
+    [CMD_ST_RELOCKED] = "relocked",
+    [CMD_ST_DENIED] = "denied",
+    [CMD_ST_DROPPED] = "dropped",
+    [CMD_ST_REJECTED] = "rejected",
+    [CMD_ST_EXPIRED] = "expired",
+    [CMD_ST_DUPLICATE] = "duplicate",
+};
+
+// Manejador: generación del hueco * 16 + índice + 1
+_Static_assert(CMD_TRACK_MAX < 16, "el índice del hueco no cabe en el manejador");
+
+void cmd_init(cmd_tracker_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+bool cmd_is_terminal(cmd_stage_t s)
+{
+    return s >= CMD_ST_RELOCKED;
+}
+
+static void ack_push(cmd_tracker_t *t, const cmd_slot_t *c, cmd_stage_t s, cmd_stage_t of,
+                     int64_t now_us, bool *kick)
+{
+    if (t->count == CMD_ACK_RING) {
+        // Lleno: el más antiguo deja sitio (el cliente verá el hueco en seq)
+        t->head = (uint8_t)((t->head + 1) % CMD_ACK_RING);
+        t->count--;
+        t->st.acks_lost++;
+    }
+    if (t->count == 0 && kick) *kick = true;
+    cmd_ack_t *a = &t->ring[(t->head + t->count) % CMD_ACK_RING];
+    t->count++;
+    if (t->count > t->st.ring_high_water) t->st.ring_high_water = t->count;
+    memcpy(a->id, c->id, sizeof(a->id));
+    a->door = c->door;
+    a->stage = (uint8_t)s;
+    a->of = (uint8_t)of;
+    a->seq = ++t->seq;
+    a->t_us = now_us;
+    a->dt_us = now_us - c->rx_us;
+    t->st.acks++;
+}
+
+static bool id_valid(const char *id)
+{
+    size_t n = 0;
+    for (; id[n]; ++n) {
+        unsigned char ch = (unsigned char)id[n];
+        if (n >= CMD_ID_MAX || ch < 0x20 || ch == '"' || ch == '\\') return false;
+    }
+    return n > 0;
+}
+
+int cmd_receive(cmd_tracker_t *t, const char *id, uint16_t door, int64_t now_us, bool *kick)
+{
+    if (!id || !id_valid(id)) return -1;
+    int victim = 0;
+    for (int i = 0; i < CMD_TRACK_MAX; ++i) {
+        cmd_slot_t *c = &t->slot[i];
+        if (c->stage != CMD_ST_NONE && strcmp(c->id, id) == 0) {
+            t->st.duplicates++;
+            ack_push(t, c, CMD_ST_DUPLICATE, (cmd_stage_t)c->stage, now_us, kick);
+            return 0;
+        }
+        // Víctima: un hueco libre; si no, la terminada más antigua; si no, la más antigua
+        cmd_slot_t *v = &t->slot[victim];
+        if (v->stage == CMD_ST_NONE) continue;
+        bool vt = cmd_is_terminal((cmd_stage_t)v->stage), ct = cmd_is_terminal((cmd_stage_t)c->stage);
+        if (c->stage == CMD_ST_NONE || (ct && !vt) || (ct == vt && c->rx_us < v->rx_us)) victim = i;
+    }
+    cmd_slot_t *c = &t->slot[victim];
+    if (c->stage != CMD_ST_NONE && !cmd_is_terminal((cmd_stage_t)c->stage)) {
+        t->st.expired++;
+        ack_push(t, c, CMD_ST_EXPIRED, CMD_ST_NONE, now_us, kick);
+    }
+    memset(c->id, 0, sizeof(c->id));
+    strcpy(c->id, id);
+    c->door = door;
+    c->rx_us = now_us;
+    c->stage = CMD_ST_RECEIVED;
+    c->gen++;
+    t->st.received++;
+    ack_push(t, c, CMD_ST_RECEIVED, CMD_ST_NONE, now_us, kick);
+    return c->gen * 16 + victim + 1;
+}
+
+static void slot_stage(cmd_tracker_t *t, cmd_slot_t *c, cmd_stage_t s, int64_t now_us, bool *kick)
+{
+    c->stage = (uint8_t)s;
+    ack_push(t, c, s, CMD_ST_NONE, now_us, kick);
+}
+
+void cmd_stage(cmd_tracker_t *t, int h, cmd_stage_t s, int64_t now_us, bool *kick)
+{
+    int idx = h % 16 - 1;
+    if (h < 1 || idx < 0 || idx >= CMD_TRACK_MAX) return;
+    cmd_slot_t *c = &t->slot[idx];
+    if (c->gen != h / 16 || c->stage == CMD_ST_NONE || cmd_is_terminal((cmd_stage_t)c->stage) || c->stage == s) return;
+    slot_stage(t, c, s, now_us, kick);
+}
+
+void cmd_advance(cmd_tracker_t *t, uint16_t door, uint32_t from_mask, cmd_stage_t s, int64_t now_us, bool *kick)
+{
+    // En orden de llegada, para que los acuses de una ráfaga salgan ordenados
+    bool done[CMD_TRACK_MAX] = { false };
+    for (;;) {
+        int pick = -1;
+        for (int i = 0; i < CMD_TRACK_MAX; ++i) {
+            cmd_slot_t *c = &t->slot[i];
+            if (done[i] || c->door != door || !(from_mask & CMD_ST_BIT(c->stage)) || c->stage == CMD_ST_NONE) continue;
+            if (pick < 0 || c->rx_us < t->slot[pick].rx_us) pick = i;
+        }
+        if (pick < 0) return;
+        done[pick] = true;
+        slot_stage(t, &t->slot[pick], s, now_us, kick);
+    }
+}
+
+bool cmd_ack_pop(cmd_tracker_t *t, cmd_ack_t *out)
+{
+    if (t->count == 0) return false;
+    *out = t->ring[t->head];
+    t->head = (uint8_t)((t->head + 1) % CMD_ACK_RING);
+    t->count--;
+    return true;
+}
+
+size_t cmd_ack_format(const cmd_ack_t *a, char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "{\"id\":\"%s\",\"door\":%u,\"stage\":\"%s\"", a->id, (unsigned)a->door,
+                     cmd_stage_name((cmd_stage_t)a->stage));
+    if (n > 0 && (size_t)n < cap && a->stage == CMD_ST_DUPLICATE) {
+        n += snprintf(buf + n, cap - (size_t)n, ",\"of\":\"%s\"", cmd_stage_name((cmd_stage_t)a->of));
+    }
+    if (n > 0 && (size_t)n < cap) {
+        n += snprintf(buf + n, cap - (size_t)n, ",\"seq\":%u,\"t_us\":%lld,\"dt_us\":%lld}",
+                      (unsigned)a->seq, (long long)a->t_us, (long long)a->dt_us);
+    }
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+const char *cmd_stage_name(cmd_stage_t s)
+{
+    return (unsigned)s < CMD_ST_COUNT ? k_names[s] : "?";
+}
+
+int cmd_stage_index(const char *name)
+{
+    for (int i = 0; i < CMD_ST_COUNT; ++i) {
+        if (strcmp(k_names[i], name) == 0) return i;
+    }
+    return -1;
+}
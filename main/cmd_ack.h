@@ -0,0 +1,122 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Acuses por etapas de las órdenes remotas (iot/commands). Una orden con
+// "id" (identificador de correlación elegido por el cliente) se sigue
+// hasta que termina y cada avance sale en el topic de acuses:
+//   {"id":"a17","door":0,"stage":"actuated","seq":42,"t_us":81234567,"dt_us":48211}
+// t_us: reloj del dispositivo (esp_timer); dt_us: desde "received", que
+// no depende de sincronizar relojes con el cliente.
+//
+// Etapas: received -> authorized (o pending: factor guardado a la espera
+// de otro, regla 2 de 3) -> [waiting_door: puerta abierta, se desbloquea
+// al cerrar] -> actuated (relé desenergizado) -> relocked. Terminan antes:
+// denied (política), dropped (cola de credenciales llena), rejected (JSON
+// sin orden de apertura) y expired (desalojada de la tabla sin terminar).
+// Un id ya visto no se vuelve a ejecutar: se contesta "duplicate" con la
+// etapa en que está (redelivery de QoS 1, reintentos del cliente).
+//
+// "actuated" se anuncia a todas las órdenes autorizadas y aún no actuadas
+// de una puerta cuando su cerradura queda abierta, y "relocked" a todas las
+// actuadas cuando vuelve a bloquearse: una ráfaga de aperturas comparte
+// cierre. door es el id de la puerta en la política; las órdenes de otras
+// puertas no avanzan.
+//
+// Los acuses esperan en un anillo; quien lo vacía los serializa fuera del
+// cerrojo con cmd_ack_format(). Desbordado, se pierde el más antiguo.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/cmd_rtt).
+// Sin sincronización: en el firmware va bajo g_cmd_mux.
+
+#define CMD_ID_MAX      24   // Caracteres del id de correlación
+#define CMD_TRACK_MAX   8    // Órdenes recordadas (en curso o terminadas)
+#define CMD_ACK_RING    16
+#define CMD_ACK_MSG_MAX 160
+
+typedef enum {
+    CMD_ST_NONE = 0,
+    CMD_ST_RECEIVED,
+    CMD_ST_PENDING,
+    CMD_ST_AUTHORIZED,
+    CMD_ST_WAITING_DOOR,
+    CMD_ST_ACTUATED,
+    CMD_ST_RELOCKED,         // Terminal desde aquí
+    CMD_ST_DENIED,
+    CMD_ST_DROPPED,
+    CMD_ST_REJECTED,
+    CMD_ST_EXPIRED,
+    CMD_ST_DUPLICATE,        // Solo en acuses: repetición de un id conocido
+    CMD_ST_COUNT
+} cmd_stage_t;
+
+#define CMD_ST_BIT(s) (1u << (s))
+
+typedef struct {
+    char id[CMD_ID_MAX + 1];
+    uint8_t stage;           // cmd_stage_t; CMD_ST_NONE: libre
+    uint8_t gen;             // Cambia al reutilizar el hueco
+    uint16_t door;           // Puerta de la orden (id en la política)
+    int64_t rx_us;
+} cmd_slot_t;
+
+typedef struct {
+    char id[CMD_ID_MAX + 1];
+    uint8_t stage;           // Etapa anunciada
+    uint8_t of;              // CMD_ST_DUPLICATE: etapa actual de la orden
+    uint16_t door;
+    uint32_t seq;
+    int64_t t_us;
+    int64_t dt_us;
+} cmd_ack_t;
+
+typedef struct {
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t expired;
+    uint32_t acks;
+    uint32_t acks_lost;      // Anillo desbordado
+    uint8_t ring_high_water;
+} cmd_stats_t;
+
+typedef struct {
+    cmd_slot_t slot[CMD_TRACK_MAX];
+    cmd_ack_t ring[CMD_ACK_RING];
+    uint8_t head;
+    uint8_t count;
+    uint32_t seq;
+    cmd_stats_t st;
+} cmd_tracker_t;
+
+void cmd_init(cmd_tracker_t *t);
+
+// En todas las funciones que encolan acuses, *kick pasa a true si el
+// anillo estaba vacío: hay que programar el vaciado.
+
+// Orden nueva para la puerta door. Devuelve el manejador (> 0) que viaja con la credencial;
+// lleva la generación del hueco, así que el de una orden desalojada ya no
+// toca a la que ocupa su lugar. 0 si el id ya se conocía (acuse "duplicate", no ejecutar);
+// -1 si el id no es válido (vacío, largo, comillas o controles; sin acuse)
+int cmd_receive(cmd_tracker_t *t, const char *id, uint16_t door, int64_t now_us, bool *kick);
+// Avance de una orden concreta; se ignora si ya terminó o h no es vigente
+void cmd_stage(cmd_tracker_t *t, int h, cmd_stage_t s, int64_t now_us, bool *kick);
+// Avanza a s todas las órdenes de la puerta door cuya etapa está en from_mask (CMD_ST_BIT)
+void cmd_advance(cmd_tracker_t *t, uint16_t door, uint32_t from_mask, cmd_stage_t s, int64_t now_us, bool *kick);
+bool cmd_is_terminal(cmd_stage_t s);
+
+// Saca el acuse más antiguo
+bool cmd_ack_pop(cmd_tracker_t *t, cmd_ack_t *out);
+// JSON compacto; devuelve la longitud (0 si no cabe)
+size_t cmd_ack_format(const cmd_ack_t *a, char *buf, size_t cap);
+
+const char *cmd_stage_name(cmd_stage_t s);
+int cmd_stage_index(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,109 @@
+#include "cred_fusion.h"
+#include <string.h>
+
+void fusion_init(fusion_t *f, const fusion_cfg_t *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    f->last_t_us = INT64_MIN;
+}
+
+static void fusion_drop_head(fusion_t *f)
+{
+    fusion_entry_t *h = &f->e[f->head];
+    f->n_method[h->method]--;
+    f->head = (uint8_t)((f->head + 1) % FUSION_MAX);
+    f->count--;
+}
+
+int fusion_evict(fusion_t *f, int64_t now_us)
+{
+    int n = 0;
+    while (f->count && f->e[f->head].t_us + f->cfg.window_us <= now_us) {
+        fusion_drop_head(f);
+        n++;
+    }
+    f->st.expired += (uint32_t)n;
+    return n;
+}
+
+void fusion_clear(fusion_t *f)
+{
+    f->head = 0;
+    f->count = 0;
+    memset(f->n_method, 0, sizeof(f->n_method));
+}
+
+// ¿Hay una tarjeta vigente con UID distinto de la recién añadida (la última)?
+static bool fusion_two_cards(const fusion_t *f)
+{
+    if (f->n_method[CRED_RFID] < 2) return false;
+    const fusion_entry_t *last = &f->e[(f->head + f->count - 1) % FUSION_MAX];
+    if (last->method != CRED_RFID) return false;
+    for (int i = 0; i + 1 < f->count; ++i) {
+        const fusion_entry_t *x = &f->e[(f->head + i) % FUSION_MAX];
+        if (x->method != CRED_RFID) continue;
+        if (x->id_len != last->id_len || memcmp(x->id, last->id, x->id_len) != 0) return true;
+    }
+    return false;
+}
+
+static bool fusion_rule_met(const fusion_t *f)
+{
+    const uint8_t *n = f->n_method;
+    switch (f->cfg.rule) {
+    case FUSION_RULE_ANY:
+        return f->count > 0;
+    case FUSION_RULE_RFID_PIN:
+        return n[CRED_RFID] && n[CRED_COMBO];
+    case FUSION_RULE_2_OF_3:
+        return (n[CRED_RFID] > 0) + (n[CRED_COMBO] > 0) + (n[CRED_REMOTE] > 0) >= 2;
+    case FUSION_RULE_DUAL_PERSON:
+        return fusion_two_cards(f);
+    default:
+        return false;
+    }
+}
+
+fusion_result_t fusion_offer(fusion_t *f, const cred_rec_t *rec, int64_t now_us)
+{
+    if (rec->method >= CRED_METHOD_COUNT) return FUSION_PENDING;
+    f->st.offered++;
+    if (f->cfg.bypass_mask & (1u << rec->method)) {
+        f->st.granted++;
+        return FUSION_GRANT;
+    }
+    // Orden de llegada = orden de caducidad: el instante nunca retrocede
+    int64_t t = (now_us > f->last_t_us) ? now_us : f->last_t_us;
+    f->last_t_us = t;
+    fusion_evict(f, t);
+    if (f->count == FUSION_MAX) {
+        fusion_drop_head(f);
+        f->st.displaced++;
+    }
+    fusion_entry_t *e = &f->e[(f->head + f->count) % FUSION_MAX];
+    e->t_us = t;
+    e->seq = rec->seq;
+    e->method = rec->method;
+    e->id_len = (rec->id_len < CRED_ID_MAX) ? rec->id_len : CRED_ID_MAX;
+    memcpy(e->id, rec->id, e->id_len);
+    f->count++;
+    f->n_method[e->method]++;
+
+    if (!fusion_rule_met(f)) return FUSION_PENDING;
+    f->st.consumed += f->count;
+    f->st.granted++;
+    fusion_clear(f);
+    return FUSION_GRANT;
+}
+
+uint8_t fusion_pending(const fusion_t *f)
+{
+    return f->count;
+}
+
+const char *fusion_rule_name(fusion_rule_t r)
+{
+    static const char *names[FUSION_RULE_COUNT] = { "any", "rfid+pin", "2-of-3", "dual-person" };
+    return ((unsigned)r < FUSION_RULE_COUNT) ? names[r] : "?";
+}
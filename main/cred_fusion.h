@@ -0,0 +1,87 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "cred_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Motor de fusión de credenciales: cada credencial válida se conserva
+// window_us desde su llegada y la regla multifactor se evalúa sobre las que
+// siguen vigentes. Una tarjeta seguida del código dentro de la ventana
+// concede acceso aunque lleguen en despertares distintos de control_task.
+//
+// Las vigentes se guardan en un anillo FIFO en orden de llegada (instantes
+// forzados a no decrecer), así que las caducadas siempre están en la cabeza:
+// expulsar cada una es O(1) y mantiene contadores por método, con los que
+// las reglas por método se evalúan en O(1). Solo la regla de dos personas
+// compara identificadores (como mucho FUSION_MAX).
+//
+// Al conceder se consumen todas las vigentes (un factor no sirve para dos
+// aperturas). Los métodos de bypass_mask conceden solos, sin pasar por la
+// regla (por defecto el remoto, como siempre ha hecho el firmware).
+//
+// Módulo sin dependencias de ESP-IDF: tools/fusion_check lo prueba en host
+// con flujos sintéticos.
+
+#define FUSION_MAX 16
+
+typedef enum {
+    FUSION_RULE_ANY = 0,      // Cualquier credencial (ACCESS_MODE_OR)
+    FUSION_RULE_RFID_PIN,     // RFID + combinación (ACCESS_MODE_AND)
+    FUSION_RULE_2_OF_3,       // Dos métodos distintos de RFID / combinación / remoto
+    FUSION_RULE_DUAL_PERSON,  // Dos tarjetas RFID distintas
+    FUSION_RULE_COUNT
+} fusion_rule_t;
+
+typedef struct {
+    fusion_rule_t rule;
+    int64_t window_us;
+    uint8_t bypass_mask;      // Bits (1 << cred_method_t) que conceden solos
+} fusion_cfg_t;
+
+typedef struct {
+    int64_t t_us;
+    uint32_t seq;
+    uint8_t method;
+    uint8_t id_len;
+    uint8_t id[CRED_ID_MAX];
+} fusion_entry_t;
+
+typedef struct {
+    uint32_t offered;
+    uint32_t granted;
+    uint32_t expired;         // Expulsadas por ventana vencida
+    uint32_t displaced;       // Expulsadas por anillo lleno
+    uint32_t consumed;        // Gastadas en una concesión
+} fusion_stats_t;
+
+typedef struct {
+    fusion_cfg_t cfg;
+    fusion_entry_t e[FUSION_MAX];
+    uint8_t head;
+    uint8_t count;
+    uint8_t n_method[CRED_METHOD_COUNT];
+    int64_t last_t_us;
+    fusion_stats_t st;
+} fusion_t;
+
+typedef enum {
+    FUSION_PENDING = 0,       // Guardada; la regla aún no se cumple
+    FUSION_GRANT,
+} fusion_result_t;
+
+void fusion_init(fusion_t *f, const fusion_cfg_t *cfg);
+// Expulsa las credenciales con t + window <= now_us; devuelve cuántas
+int fusion_evict(fusion_t *f, int64_t now_us);
+// Añade una credencial (en now_us) y evalúa la regla
+fusion_result_t fusion_offer(fusion_t *f, const cred_rec_t *rec, int64_t now_us);
+// Descarta todas las vigentes
+void fusion_clear(fusion_t *f);
+uint8_t fusion_pending(const fusion_t *f);
+const char *fusion_rule_name(fusion_rule_t r);
+
+#ifdef __cplusplus
+}
+#endif
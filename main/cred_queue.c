@@ -0,0 +1,69 @@
+#include "cred_queue.h"
+#include <string.h>
+
+void cred_queue_init(cred_queue_t *q)
+{
+    memset(q, 0, sizeof(*q));
+    q->lane[CRED_LANE_PRIO].cap = CRED_QUEUE_PRIO_LEN;
+    q->lane[CRED_LANE_NORMAL].cap = CRED_QUEUE_LEN;
+}
+
+cred_lane_t cred_lane_for(cred_method_t m)
+{
+    return (m == CRED_REMOTE) ? CRED_LANE_PRIO : CRED_LANE_NORMAL;
+}
+
+cred_push_t cred_queue_push(cred_queue_t *q, const cred_rec_t *rec, uint32_t *seq_out)
+{
+    cred_lane_t l = cred_lane_for((cred_method_t)rec->method);
+    cred_ring_t *r = &q->lane[l];
+    uint32_t seq = ++q->next_seq;
+    if (seq_out) *seq_out = seq;
+    if (r->count >= r->cap) {
+        q->st.overflow[l]++;
+        q->st.last_overflow_seq = seq;
+        return CRED_PUSH_DROPPED;
+    }
+    cred_rec_t *dst = &r->buf[(r->head + r->count) % r->cap];
+    *dst = *rec;
+    dst->seq = seq;
+    if (dst->id_len > CRED_ID_MAX) dst->id_len = CRED_ID_MAX;
+    r->count++;
+    q->st.pushed[l]++;
+    if (r->count > q->st.high_water[l]) q->st.high_water[l] = r->count;
+    if (q->bell) return CRED_PUSH_QUEUED;
+    q->bell = true;
+    return CRED_PUSH_QUEUED_BELL;
+}
+
+bool cred_queue_pop(cred_queue_t *q, cred_rec_t *out)
+{
+    for (int l = 0; l < CRED_LANE_COUNT; ++l) {
+        cred_ring_t *r = &q->lane[l];
+        if (r->count == 0) continue;
+        *out = r->buf[r->head];
+        r->head = (uint8_t)((r->head + 1) % r->cap);
+        r->count--;
+        q->st.popped[l]++;
+        return true;
+    }
+    // Vacía: el siguiente push debe volver a avisar
+    q->bell = false;
+    return false;
+}
+
+void cred_queue_bell_lost(cred_queue_t *q)
+{
+    q->bell = false;
+}
+
+uint32_t cred_queue_pending(const cred_queue_t *q)
+{
+    return (uint32_t)q->lane[CRED_LANE_PRIO].count + q->lane[CRED_LANE_NORMAL].count;
+}
+
+const char *cred_method_name(cred_method_t m)
+{
+    static const char *names[CRED_METHOD_COUNT] = { "rfid", "password", "remote" };
+    return ((unsigned)m < CRED_METHOD_COUNT) ? names[m] : "?";
+}
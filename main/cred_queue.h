@@ -0,0 +1,94 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cola acotada de credenciales hacia control_task. Cada registro lleva
+// método, identificador (UID RFID / usuario remoto), instante de origen y
+// número de secuencia, así que dos pasadas seguidas son dos registros y no
+// un bit que se colapsa. Dos carriles FIFO: las órdenes remotas van al
+// carril prioritario, que se vacía antes que el normal.
+//
+// Desbordamiento: el registro nuevo se rechaza y se cuenta por carril. La
+// secuencia se asigna a todo intento, de modo que los huecos en lo consumido
+// identifican exactamente lo perdido.
+//
+// Aviso al consumidor ("timbre"): solo el push que encuentra la cola sin
+// timbre pendiente devuelve CRED_PUSH_QUEUED_BELL; el consumidor vacía la
+// cola hasta que cred_queue_pop() devuelve false, lo que rearma el timbre.
+// Así basta un evento en g_ctrl_q por ráfaga.
+//
+// Módulo sin dependencias de ESP-IDF y sin bloqueo propio: el llamador
+// serializa (portMUX en main.c, mutex en tools/cred_stress).
+
+#define CRED_QUEUE_LEN       8   // Carril normal (RFID, combinación)
+#define CRED_QUEUE_PRIO_LEN  4   // Carril prioritario (remoto)
+#define CRED_ID_MAX          10  // UID ISO14443 de hasta 10 bytes
+
+typedef enum {
+    CRED_RFID = 0,
+    CRED_COMBO,
+    CRED_REMOTE,
+    CRED_METHOD_COUNT
+} cred_method_t;
+
+typedef enum {
+    CRED_LANE_PRIO = 0,
+    CRED_LANE_NORMAL,
+    CRED_LANE_COUNT
+} cred_lane_t;
+
+typedef enum {
+    CRED_PUSH_DROPPED = 0,   // Carril lleno: contado en overflow
+    CRED_PUSH_QUEUED,
+    CRED_PUSH_QUEUED_BELL,   // Encolado y hay que avisar al consumidor
+} cred_push_t;
+
+typedef struct {
+    uint8_t method;          // cred_method_t
+    uint8_t id_len;
+    uint8_t id[CRED_ID_MAX]; // UID RFID o usuario remoto (sin terminador)
+    uint16_t cmd;            // Orden remota con acuses (cmd_ack.h); 0: ninguna
+    uint32_t seq;            // Asignada por cred_queue_push
+    int64_t ts_us;           // Instante en el productor
+} cred_rec_t;
+
+typedef struct {
+    uint32_t pushed[CRED_LANE_COUNT];
+    uint32_t popped[CRED_LANE_COUNT];
+    uint32_t overflow[CRED_LANE_COUNT];
+    uint8_t high_water[CRED_LANE_COUNT];
+    uint32_t last_overflow_seq;
+} cred_queue_stats_t;
+
+typedef struct {
+    cred_rec_t buf[CRED_QUEUE_LEN];
+    uint8_t cap;
+    uint8_t head;
+    uint8_t count;
+} cred_ring_t;
+
+typedef struct {
+    cred_ring_t lane[CRED_LANE_COUNT];
+    uint32_t next_seq;
+    bool bell;               // Hay un aviso en vuelo hacia el consumidor
+    cred_queue_stats_t st;
+} cred_queue_t;
+
+void cred_queue_init(cred_queue_t *q);
+cred_lane_t cred_lane_for(cred_method_t m);
+// Encola una copia de *rec con secuencia nueva (también en *seq_out si no es NULL)
+cred_push_t cred_queue_push(cred_queue_t *q, const cred_rec_t *rec, uint32_t *seq_out);
+// Extrae el siguiente registro (carril prioritario primero); false si vacía
+bool cred_queue_pop(cred_queue_t *q, cred_rec_t *out);
+// El aviso no pudo entregarse: el próximo push volverá a pedirlo
+void cred_queue_bell_lost(cred_queue_t *q);
+uint32_t cred_queue_pending(const cred_queue_t *q);
+const char *cred_method_name(cred_method_t m);
+
+#ifdef __cplusplus
+}
+#endif
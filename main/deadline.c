@@ -0,0 +1,60 @@
+#include "deadline.h"
+#include <string.h>
+
+void deadline_set_init(deadline_set_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+void deadline_arm(deadline_set_t *s, int id, int64_t at_us)
+{
+    if (id < 0 || id >= DEADLINE_MAX) return;
+    deadline_slot_t *d = &s->slot[id];
+    d->at_us = at_us;
+    d->seq = ++s->seq;
+    d->armed = true;
+}
+
+void deadline_cancel(deadline_set_t *s, int id)
+{
+    if (id < 0 || id >= DEADLINE_MAX) return;
+    s->slot[id].armed = false;
+}
+
+bool deadline_is_armed(const deadline_set_t *s, int id)
+{
+    return id >= 0 && id < DEADLINE_MAX && s->slot[id].armed;
+}
+
+// Índice del plazo armado más temprano (a igualdad, menor secuencia)
+static int deadline_first(const deadline_set_t *s)
+{
+    int best = -1;
+    for (int i = 0; i < DEADLINE_MAX; ++i) {
+        const deadline_slot_t *d = &s->slot[i];
+        if (!d->armed) continue;
+        if (best < 0) { best = i; continue; }
+        const deadline_slot_t *b = &s->slot[best];
+        // Comparación de secuencia tolerante al desbordamiento de 32 bits
+        if (d->at_us < b->at_us || (d->at_us == b->at_us && (int32_t)(d->seq - b->seq) < 0)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool deadline_next(const deadline_set_t *s, int64_t *at_us)
+{
+    int i = deadline_first(s);
+    if (i < 0) return false;
+    if (at_us) *at_us = s->slot[i].at_us;
+    return true;
+}
+
+int deadline_pop_expired(deadline_set_t *s, int64_t now_us)
+{
+    int i = deadline_first(s);
+    if (i < 0 || s->slot[i].at_us > now_us) return -1;
+    s->slot[i].armed = false;
+    return i;
+}
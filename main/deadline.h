@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Conjunto de plazos con identificador fijo (re-bloqueo, desbloqueo máximo,
+// timeouts del LCD...). Cada id tiene su ranura, así que armar y cancelar son
+// O(1); rearmar un id reemplaza su plazo anterior. Los vencidos se extraen en
+// orden determinista: primero el plazo más temprano y, a igualdad, el armado
+// antes (secuencia monótona).
+//
+// Módulo sin dependencias de ESP-IDF: sched.c lo respalda con un único
+// esp_timer one-shot programado al próximo plazo; tools/sched_sim lo usa en
+// host con tiempo simulado.
+
+#define DEADLINE_MAX 14   // Seis globales + dos por puerta (DOOR_MAX en main.c)
+
+typedef struct {
+    int64_t at_us;
+    uint32_t seq;            // Orden de armado (desempate)
+    bool armed;
+} deadline_slot_t;
+
+typedef struct {
+    deadline_slot_t slot[DEADLINE_MAX];
+    uint32_t seq;
+} deadline_set_t;
+
+void deadline_set_init(deadline_set_t *s);
+// Arma (o rearma) el id para vencer en at_us
+void deadline_arm(deadline_set_t *s, int id, int64_t at_us);
+void deadline_cancel(deadline_set_t *s, int id);
+bool deadline_is_armed(const deadline_set_t *s, int id);
+// Plazo armado más temprano; false si no hay ninguno
+bool deadline_next(const deadline_set_t *s, int64_t *at_us);
+// Desarma y devuelve el primer id vencido en now_us (-1 si ninguno)
+int deadline_pop_expired(deadline_set_t *s, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+#include "door_debounce.h"
+#include <string.h>
+
+void door_debounce_init(door_debounce_t *d, int debounce_ms, int level)
+{
+    memset(d, 0, sizeof(*d));
+    d->debounce_us = (int64_t)debounce_ms * 1000;
+    d->stable_level = level ? 1 : 0;
+}
+
+int64_t door_debounce_edge(door_debounce_t *d, int64_t now_us)
+{
+    d->edges++;
+    if (d->burst_start_us == 0) {
+        d->burst_start_us = now_us ? now_us : 1;
+    }
+    return now_us + d->debounce_us;
+}
+
+bool door_debounce_expire(door_debounce_t *d, int level, int64_t now_us)
+{
+    level = level ? 1 : 0;
+    int64_t start = d->burst_start_us;
+    d->burst_start_us = 0;
+    d->bursts++;
+    if (level == d->stable_level) {
+        d->glitches++;
+        return false;
+    }
+    d->stable_level = level;
+    d->changes++;
+    if (start > 0) {
+        d->last_latency_us = now_us - start;
+        if (d->last_latency_us > d->max_latency_us) d->max_latency_us = d->last_latency_us;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Anti-rebote del sensor reed por ventana de silencio: cada flanco (ISR
+// any-edge) reinicia una ventana de debounce_us; al vencer sin más flancos
+// se lee el nivel y, si difiere del estado estable, se confirma el cambio.
+// Una ráfaga de rebotes que vuelve al nivel de partida se cuenta como
+// glitch y no produce evento.
+//
+// Módulo sin dependencias de ESP-IDF: el firmware lo alimenta desde la ISR
+// y el callback de esp_timer; tools/door_bounce lo reutiliza en host.
+
+// Ventana de fábrica: DEBOUNCE_MS del firmware y valor por defecto de door_bounce
+#define DOOR_DEBOUNCE_MS 20
+
+typedef struct {
+    int64_t debounce_us;
+    int stable_level;        // Último nivel confirmado (0/1)
+    int64_t burst_start_us;  // Primer flanco de la ráfaga en curso (0 = ninguna)
+    // Estadísticas
+    uint32_t edges;          // Flancos recibidos
+    uint32_t bursts;         // Ventanas vencidas
+    uint32_t changes;        // Cambios de estado confirmados
+    uint32_t glitches;       // Ráfagas descartadas (sin cambio neto)
+    int64_t last_latency_us; // Primer flanco -> confirmación del último cambio
+    int64_t max_latency_us;
+} door_debounce_t;
+
+void door_debounce_init(door_debounce_t *d, int debounce_ms, int level);
+// Registra un flanco en now_us; devuelve el instante en que vence la ventana
+int64_t door_debounce_edge(door_debounce_t *d, int64_t now_us);
+// Ventana vencida con el nivel leído: true si cambia el estado estable
+bool door_debounce_expire(door_debounce_t *d, int level, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+#include "feedback.h"
+#include <stddef.h>
+
+#define BEEP_DUTY   300
+#define ERROR_DUTY  500
+
+static const fb_step_t k_tick[]  = { { 30, BEEP_DUTY, 0 } };
+static const fb_step_t k_probe[] = { { 60, BEEP_DUTY, 0 } };
+static const fb_step_t k_ok[]    = { { 80, BEEP_DUTY, 0 }, { 40, 0, 0 }, { 80, BEEP_DUTY, 0 } };
+static const fb_step_t k_bad[]   = {
+    { 30, BEEP_DUTY, 0 }, { 40, 0, 0 }, { 30, BEEP_DUTY, 0 }, { 40, 0, 0 }, { 30, BEEP_DUTY, 0 },
+    { 300, 0, FB_LED_RED },
+};
+static const fb_step_t k_denied[] = { { 300, 0, FB_LED_RED } };
+static const fb_step_t k_error[]  = { { 300, ERROR_DUTY, 0 } };
+
+#define PAT(n, p, t) { n, p, (uint8_t)(sizeof(t) / sizeof(t[0])), t }
+
+const fb_pattern_def_t fb_patterns[FB_COUNT] = {
+    [FB_TICK]      = PAT("tick",      1, k_tick),
+    [FB_PROBE]     = PAT("probe",     1, k_probe),
+    [FB_OK]        = PAT("ok",        2, k_ok),
+    [FB_BAD_COMBO] = PAT("bad_combo", 3, k_bad),
+    [FB_DENIED]    = PAT("denied",    3, k_denied),
+    [FB_ERROR]     = PAT("error",     4, k_error),
+};
+
+void fb_init(fb_seq_t *s)
+{
+    atomic_init(&s->pending, 0);
+    atomic_init(&s->coalesced, 0);
+    s->cur = -1;
+    s->step = 0;
+    for (int i = 0; i < FB_COUNT; ++i) s->played[i] = 0;
+    s->completed = s->preempted = s->dropped = 0;
+}
+
+bool fb_request(fb_seq_t *s, fb_pattern_t id)
+{
+    if ((unsigned)id >= FB_COUNT) return false;
+    uint32_t bit = 1u << id;
+    if (atomic_fetch_or(&s->pending, bit) & bit) {
+        atomic_fetch_add(&s->coalesced, 1);
+        return false;
+    }
+    return true;
+}
+
+static void step_out(const fb_seq_t *s, fb_out_t *out)
+{
+    const fb_step_t *st = &fb_patterns[s->cur].step[s->step];
+    out->duty = st->duty;
+    out->leds = st->leds;
+    out->hold_ms = st->ms ? st->ms : 1;
+}
+
+static void rest_out(fb_out_t *out)
+{
+    out->duty = 0;
+    out->leds = 0;
+    out->hold_ms = 0;
+}
+
+bool fb_service(fb_seq_t *s, fb_out_t *out)
+{
+    uint32_t req = atomic_exchange(&s->pending, 0);
+    if (!req) return false;
+    int best = -1;
+    for (int i = 0; i < FB_COUNT; ++i) {
+        if (!(req >> i & 1u)) continue;
+        if (best < 0 || fb_patterns[i].prio > fb_patterns[best].prio) {
+            if (best >= 0) s->dropped++;
+            best = i;
+        } else {
+            s->dropped++;
+        }
+    }
+    if (s->cur >= 0 && fb_patterns[best].prio < fb_patterns[s->cur].prio) {
+        s->dropped++;
+        return false;
+    }
+    if (s->cur >= 0) s->preempted++;
+    s->cur = (int8_t)best;
+    s->step = 0;
+    s->played[best]++;
+    step_out(s, out);
+    return true;
+}
+
+void fb_step_expired(fb_seq_t *s, fb_out_t *out)
+{
+    if (s->cur < 0) {
+        rest_out(out);
+        return;
+    }
+    if (++s->step < fb_patterns[s->cur].steps) {
+        step_out(s, out);
+        return;
+    }
+    s->cur = -1;
+    s->step = 0;
+    s->completed++;
+    rest_out(out);
+}
+
+const char *fb_pattern_name(fb_pattern_t id)
+{
+    return ((unsigned)id < FB_COUNT) ? fb_patterns[id].name : "?";
+}
+
+uint32_t fb_pattern_ms(fb_pattern_t id)
+{
+    if ((unsigned)id >= FB_COUNT) return 0;
+    uint32_t ms = 0;
+    for (int i = 0; i < fb_patterns[id].steps; ++i) ms += fb_patterns[id].step[i].ms;
+    return ms;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Secuenciador de patrones de buzzer y LED rojo. Quien da feedback (RFID,
+// potenciómetro, controlador) solo pide un patrón con fb_request(): un OR
+// atómico de un bit, sin esperas ni cerrojos. Los patrones son tablas de
+// pasos (duración, duty del buzzer, LEDs) que reproduce un único consumidor
+// al ritmo de un esp_timer; la tarea que pide nunca duerme.
+//
+// Prioridades: un pedido con prioridad >= la del patrón en curso lo
+// interrumpe (el mismo patrón vuelve a empezar); uno de prioridad menor se
+// descarta, no se encola: el feedback tardío confunde más que su ausencia.
+// Entre varios pedidos atendidos a la vez gana el de mayor prioridad.
+//
+// Pedidos repetidos del mismo patrón antes de atenderse se funden en uno.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/fb_sim). El
+// consumidor es uno solo (tarea de esp_timer en el firmware): fb_service y
+// fb_step_expired no son reentrantes entre sí.
+
+#define FB_LED_RED  (1u << 0)
+
+typedef enum {
+    FB_TICK = 0,      // Pip: dígito capturado, tarjeta leída
+    FB_PROBE,         // Pip largo del auto-probe del LCD
+    FB_OK,            // Doble pip: combinación correcta
+    FB_BAD_COMBO,     // Triple pip + LED rojo: combinación incorrecta
+    FB_DENIED,        // LED rojo: credencial rechazada por la política
+    FB_ERROR,         // Tono largo y fuerte
+    FB_COUNT
+} fb_pattern_t;
+
+typedef struct {
+    uint16_t ms;
+    uint16_t duty;           // Duty del buzzer (0 = silencio, escala LEDC de 10 bits)
+    uint8_t leds;            // FB_LED_*
+} fb_step_t;
+
+typedef struct {
+    const char *name;
+    uint8_t prio;
+    uint8_t steps;
+    const fb_step_t *step;
+} fb_pattern_def_t;
+
+extern const fb_pattern_def_t fb_patterns[FB_COUNT];
+
+// Salida a aplicar; hold_ms = 0: reposo (buzzer y LEDs apagados, sin plazo)
+typedef struct {
+    uint16_t duty;
+    uint8_t leds;
+    uint32_t hold_ms;
+} fb_out_t;
+
+typedef struct {
+    _Atomic uint32_t pending;    // Bit i = fb_patterns[i] pedido (productores)
+    _Atomic uint32_t coalesced;  // Pedidos que ya estaban pendientes
+    // Solo el consumidor
+    int8_t cur;                  // Patrón en curso (-1 = reposo)
+    uint8_t step;
+    uint32_t played[FB_COUNT];   // Patrones iniciados
+    uint32_t completed;          // Terminados sin interrupción
+    uint32_t preempted;          // Interrumpidos por otro de prioridad >=
+    uint32_t dropped;            // Descartados por prioridad
+} fb_seq_t;
+
+void fb_init(fb_seq_t *s);
+
+// Productor (cualquier tarea): no bloquea. Devuelve true si el pedido
+// es nuevo; el llamador debe entonces despertar al consumidor
+bool fb_request(fb_seq_t *s, fb_pattern_t id);
+
+// Consumidor: atiende lo pendiente. true si empieza un patrón; *out es la
+// salida de su primer paso (aplicarla y armar el plazo a hold_ms)
+bool fb_service(fb_seq_t *s, fb_out_t *out);
+// Consumidor: venció el paso en curso; *out es la salida siguiente
+void fb_step_expired(fb_seq_t *s, fb_out_t *out);
+
+const char *fb_pattern_name(fb_pattern_t id);
+// Duración total de un patrón (lo que antes bloqueaba al llamador)
+uint32_t fb_pattern_ms(fb_pattern_t id);
+
+#ifdef __cplusplus
+}
+#endif
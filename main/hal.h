@@ -0,0 +1,166 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Capa de abstracción del hardware: lo que main.c, sched.c, mfrc522_min.c y
+// pot_trace.c piden a la placa pasa por aquí, sin tipos de drivers en la
+// interfaz. Dos implementaciones, elegidas en main/CMakeLists.txt por IDF_TARGET:
+//  - hal_esp.c: drivers de ESP-IDF (gpio, adc_oneshot, ledc, i2c_master,
+//    spi_master, uart, esp_timer, nvs_flash, spiffs, esp_wifi, esp-mqtt).
+//  - hal_linux.c: target "linux" de ESP-IDF (FreeRTOS sobre POSIX). Entradas
+//    (pines, ADC, tarjeta RFID, mensajes MQTT) desde un guion de sensores
+//    virtuales (hal_vdev.h); las salidas se registran en la salida estándar.
+// Los pines son números de GPIO del ESP32; -1: sin conectar.
+
+// ---- Tiempo y temporizadores ----
+int64_t hal_time_us(void);               // Monótono desde el arranque
+
+typedef struct hal_timer hal_timer_t;
+typedef void (*hal_timer_cb_t)(void *arg);
+// Disparo único; los callbacks corren en la tarea de temporizadores
+// (esp_timer en la placa): breves y sin bloquear. NULL si no hay memoria
+hal_timer_t *hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg);
+// false si ya estaba armado (no se rearma). Admite contexto ISR
+bool hal_timer_start_once(hal_timer_t *t, uint64_t delay_us);
+void hal_timer_stop(hal_timer_t *t);     // Admite contexto ISR
+
+// ---- GPIO ----
+typedef enum {
+    HAL_GPIO_OUTPUT = 0,
+    HAL_GPIO_INPUT,
+    HAL_GPIO_INPUT_PULLUP,
+} hal_gpio_mode_t;
+
+typedef void (*hal_gpio_isr_t)(void *arg);
+bool hal_gpio_config(int pin, hal_gpio_mode_t mode);
+void hal_gpio_set(int pin, int level);
+int hal_gpio_get(int pin);                // Admite contexto ISR
+// Interrupción en ambos flancos; isr en contexto ISR (IRAM_ATTR)
+bool hal_gpio_on_edge(int pin, hal_gpio_isr_t isr, void *arg);
+// Tras hal_gpio_on_edge: los flancos del pin despiertan también del sueño
+// ligero (en la placa, interrupción por nivel que la ISR invierte)
+bool hal_gpio_wake(int pin);
+
+// ---- Energía ----
+// Escalado de frecuencia entre min y max MHz y, con light_sleep, sueño ligero
+// automático cuando FreeRTOS no tiene trabajo (tickless idle). Los esp_timer,
+// las esperas de FreeRTOS, la radio y los pines de hal_gpio_wake despiertan.
+// false si el firmware no tiene gestión de energía (CONFIG_PM_ENABLE)
+bool hal_pm_config(int max_mhz, int min_mhz, bool light_sleep);
+// Mientras haya algún busy(true) sin su busy(false), CPU a la frecuencia
+// máxima y sin dormir. Anidable; solo desde tareas
+void hal_pm_busy(bool on);
+// Acumulados desde el arranque: tiempo en sueño ligero y despertares
+void hal_pm_stats(int64_t *slept_us, uint32_t *wakeups);
+// Tiempo de las tareas IDLE sumado en todos los núcleos (incluye el sueño
+// ligero), en us. Cuenta de 32 bits que da la vuelta: usar diferencias de
+// ventanas cortas. false si el destino no lo mide
+bool hal_pm_idle_us(uint32_t *idle_us);
+
+// ---- Perfilado ----
+// Muestreo del PC: un temporizador por núcleo a hz; fn corre en la ISR de
+// ese núcleo (breve, sin bloquear) con el PC en que se interrumpió la tarea.
+// La ISR no es IRAM-safe: calla durante las escrituras en flash. Mientras
+// muestrea, la CPU no duerme. false si el destino no lo admite
+typedef void (*hal_pc_sample_t)(int core, uint32_t pc, void *arg);
+bool hal_prof_start(uint32_t hz, hal_pc_sample_t fn, void *arg);
+void hal_prof_stop(void);
+// Montículo interno (8 bits): libre, mínimo libre desde el arranque y mayor
+// bloque asignable, en bytes
+void hal_heap_stats(size_t *free_b, size_t *min_free_b, size_t *largest_b);
+
+// ---- ADC (ADC1, 12 bits: 0..4095) ----
+bool hal_adc_init(int pin);              // false si el pin no es de ADC1
+int hal_adc_read(int pin);               // -1 si falla
+
+// ---- PWM: cada canal con su propio timer ----
+#define HAL_PWM_CHANNELS 4
+bool hal_pwm_init(int ch, int pin, uint32_t freq_hz, uint8_t bits);
+void hal_pwm_set(int ch, uint32_t duty);
+
+// ---- I2C (maestro, un bus) ----
+bool hal_i2c_init(int sda, int scl);
+// Dispositivo fijo en el bus; las direcciones no añadidas usan uno temporal
+bool hal_i2c_add(uint8_t addr, uint32_t hz);
+// Escritura completa; la tarea duerme hasta el fin de la transferencia.
+// false si el esclavo no responde o vence el plazo
+bool hal_i2c_write(uint8_t addr, uint32_t hz, const uint8_t *buf, size_t len);
+
+// ---- SPI (maestro, modo 0, CS por hardware) ----
+typedef struct hal_spi hal_spi_t;
+hal_spi_t *hal_spi_open(int sck, int mosi, int miso, int cs, uint32_t hz);
+// Transacción full-duplex de len bytes; rx puede ser NULL
+bool hal_spi_xfer(hal_spi_t *s, const uint8_t *tx, uint8_t *rx, size_t len);
+
+// ---- UART (salida binaria) ----
+bool hal_uart_open(int port);
+void hal_uart_write(int port, const void *buf, size_t len);
+
+// ---- Almacenamiento ----
+// Raíz del sistema de archivos: SPIFFS en la placa, directorio en el host
+#if CONFIG_IDF_TARGET_LINUX
+#define HAL_FS_ROOT "./spiffs"
+#else
+#define HAL_FS_ROOT "/spiffs"
+#endif
+bool hal_fs_mount(size_t *total, size_t *used);
+
+// Clave-valor persistente (NVS en la placa); un espacio de nombres abierto
+bool hal_kv_init(void);                  // Borra y reintenta si está corrupto
+bool hal_kv_open(const char *ns);
+bool hal_kv_get_i32(const char *key, int32_t *out);
+bool hal_kv_set_i32(const char *key, int32_t v);
+bool hal_kv_get_str(const char *key, char *out, size_t cap);
+bool hal_kv_set_str(const char *key, const char *v);
+bool hal_kv_commit(void);
+
+// ---- Red y MQTT ----
+const char *hal_chip_model(void);
+// Estación WiFi con reconexión automática (en el host, la red del sistema)
+void hal_net_start(const char *ssid, const char *pass);
+void hal_net_reconfigure(const char *ssid, const char *pass);
+// Ahorro de la radio: -1 siempre encendida; 0 modem sleep (despierta en cada
+// DTIM); n > 0 despierta cada n beacons. El intervalo de escucha se negocia
+// al asociarse: un cambio de n se aplica en la siguiente conexión
+void hal_net_power_save(int listen_interval);
+
+typedef enum {
+    HAL_MQTT_CONNECTED = 0,
+    HAL_MQTT_DISCONNECTED,
+    HAL_MQTT_DATA,
+} hal_mqtt_kind_t;
+
+// Los mensajes grandes llegan en trozos; solo el primero trae el topic
+typedef struct {
+    hal_mqtt_kind_t kind;
+    const char *topic;
+    int topic_len;
+    const char *data;
+    int data_len;
+    int offset;                          // Del trozo dentro del mensaje
+    int total_len;
+} hal_mqtt_event_t;
+
+typedef void (*hal_mqtt_cb_t)(const hal_mqtt_event_t *ev);
+// Cliente con reconexión automática; cb corre en la tarea del cliente
+bool hal_mqtt_start(const char *uri, hal_mqtt_cb_t cb);
+bool hal_mqtt_ready(void);               // Cliente creado (hay cola de salida)
+// len 0: strlen(data). Devuelven el id del mensaje o -1.
+// publish espera al envío (QoS 0) o a tenerlo en la cola de salida
+int hal_mqtt_publish(const char *topic, const char *data, int len, int qos, int retain);
+// Nunca bloquea en la red: sale desde la tarea del cliente
+int hal_mqtt_enqueue(const char *topic, const char *data, int len, int qos, int retain);
+int hal_mqtt_subscribe(const char *topic, int qos);
+// Cambia de broker: desconecta y la reconexión usa la URI nueva
+void hal_mqtt_set_uri(const char *uri);
+
+#ifdef __cplusplus
+}
+#endif
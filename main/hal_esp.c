@@ -0,0 +1,736 @@
+#include "hal.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_chip_info.h"
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "driver/gptimer.h"
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include "xtensa_context.h"
+#endif
+#include "driver/ledc.h"
+#include "driver/i2c_master.h"
+#include "driver/spi_master.h"
+#include "driver/uart.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_spiffs.h"
+#include "nvs_flash.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "mqtt_client.h"
+
+#define TAG "HAL"
+
+// Backend de la placa: envoltorios finos sobre los drivers de ESP-IDF
+
+// ---- Tiempo y temporizadores ----
+
+int64_t hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+hal_timer_t *hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg)
+{
+    const esp_timer_create_args_t targs = { .callback = cb, .arg = arg, .name = name };
+    esp_timer_handle_t h = NULL;
+    if (esp_timer_create(&targs, &h) != ESP_OK) return NULL;
+    return (hal_timer_t *)h;
+}
+
+bool IRAM_ATTR hal_timer_start_once(hal_timer_t *t, uint64_t delay_us)
+{
+    return esp_timer_start_once((esp_timer_handle_t)t, delay_us) == ESP_OK;
+}
+
+void IRAM_ATTR hal_timer_stop(hal_timer_t *t)
+{
+    esp_timer_stop((esp_timer_handle_t)t); // ESP_ERR_INVALID_STATE: no estaba armado
+}
+
+// ---- GPIO ----
+
+bool hal_gpio_config(int pin, hal_gpio_mode_t mode)
+{
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = mode == HAL_GPIO_OUTPUT ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT,
+        .pull_up_en = mode == HAL_GPIO_INPUT_PULLUP ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    return gpio_config(&io) == ESP_OK;
+}
+
+void hal_gpio_set(int pin, int level)
+{
+    gpio_set_level((gpio_num_t)pin, level);
+}
+
+// En IRAM y con el registro directo (gpio_get_level está en flash): la leen
+// ISR como la de la línea IRQ del MFRC522
+int IRAM_ATTR hal_gpio_get(int pin)
+{
+    return gpio_ll_get_level(&GPIO, pin);
+}
+
+static struct {
+    hal_gpio_isr_t isr;
+    void *arg;
+} s_edge[GPIO_NUM_MAX];
+
+bool hal_gpio_on_edge(int pin, hal_gpio_isr_t isr, void *arg)
+{
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) { // INVALID_STATE: ya instalado
+        ESP_LOGE(TAG, "gpio_install_isr_service falló (%s)", esp_err_to_name(err));
+        return false;
+    }
+    s_edge[pin].isr = isr;
+    s_edge[pin].arg = arg;
+    gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_ANYEDGE);
+    return gpio_isr_handler_add((gpio_num_t)pin, isr, arg) == ESP_OK;
+}
+
+// El sueño ligero solo despierta por nivel: el pin pasa a interrupción por
+// el nivel contrario al actual y cada disparo lo invierte (la interrupción
+// y el despertar comparten el tipo), lo que equivale a ambos flancos
+static void IRAM_ATTR wake_isr(void *arg)
+{
+    int pin = (int)(intptr_t)arg;
+    int level = gpio_ll_get_level(&GPIO, pin);
+    gpio_ll_set_intr_type(&GPIO, pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    s_edge[pin].isr(s_edge[pin].arg);
+}
+
+bool hal_gpio_wake(int pin)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX || !s_edge[pin].isr) return false;
+    gpio_isr_handler_remove((gpio_num_t)pin);
+    int level = gpio_get_level((gpio_num_t)pin);
+    if (gpio_wakeup_enable((gpio_num_t)pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL) != ESP_OK) return false;
+    if (gpio_isr_handler_add((gpio_num_t)pin, wake_isr, (void *)(intptr_t)pin) != ESP_OK) return false;
+    return esp_sleep_enable_gpio_wakeup() == ESP_OK;
+}
+
+// ---- Energía ----
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_pm_busy;
+#endif
+static portMUX_TYPE s_pm_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_slept_us;
+static uint32_t s_wakeups;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Dentro de la entrada/salida del sueño: breve y en IRAM
+static esp_err_t IRAM_ATTR pm_exit_cb(int64_t slept_us, void *arg)
+{
+    portENTER_CRITICAL_SAFE(&s_pm_mux);
+    s_slept_us += slept_us;
+    s_wakeups++;
+    portEXIT_CRITICAL_SAFE(&s_pm_mux);
+    return ESP_OK;
+}
+#endif
+
+bool hal_pm_config(int max_mhz, int min_mhz, bool light_sleep)
+{
+#if CONFIG_PM_ENABLE
+    if (!s_pm_busy) {
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "hal_busy", &s_pm_busy);
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+        esp_pm_sleep_cbs_register_config_t cbs = { .exit_cb = pm_exit_cb };
+        esp_pm_light_sleep_register_cbs(&cbs);
+#endif
+    }
+    esp_pm_config_t pm = {
+        .max_freq_mhz = max_mhz,
+        .min_freq_mhz = min_mhz,
+        .light_sleep_enable = light_sleep,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure(%d-%d MHz, sueño %d) falló (%s)", min_mhz, max_mhz, light_sleep,
+                 esp_err_to_name(err));
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void hal_pm_busy(bool on)
+{
+#if CONFIG_PM_ENABLE
+    if (!s_pm_busy) return;
+    if (on) esp_pm_lock_acquire(s_pm_busy);
+    else esp_pm_lock_release(s_pm_busy);
+#endif
+}
+
+void hal_pm_stats(int64_t *slept_us, uint32_t *wakeups)
+{
+    portENTER_CRITICAL(&s_pm_mux);
+    *slept_us = s_slept_us;
+    *wakeups = s_wakeups;
+    portEXIT_CRITICAL(&s_pm_mux);
+}
+
+bool hal_pm_idle_us(uint32_t *idle_us)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t sum = 0;
+    for (int c = 0; c < portNUM_PROCESSORS; ++c) sum += (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(c));
+    *idle_us = sum;
+    return true;
+#else
+    *idle_us = 0;
+    return false;
+#endif
+}
+
+// ---- Perfilado (un gptimer por núcleo) ----
+
+static gptimer_handle_t s_prof_timer[portNUM_PROCESSORS];
+static hal_pc_sample_t s_prof_fn;
+static void *s_prof_arg;
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+// Al entrar en una interrupción de nivel 1 el puerto Xtensa de FreeRTOS deja
+// el marco de la tarea interrumpida (XtExcFrame) en su pila y su dirección en
+// pxTopOfStack, el primer campo del TCB. Las secciones críticas retrasan la
+// muestra hasta su salida, y durante las escrituras en flash no hay muestras
+static bool IRAM_ATTR prof_alarm_isr(gptimer_handle_t timer, const gptimer_alarm_event_data_t *ev, void *arg)
+{
+    TaskHandle_t cur = xTaskGetCurrentTaskHandle();
+    const XtExcFrame *f = cur ? *(XtExcFrame *const *)cur : NULL;
+    s_prof_fn(esp_cpu_get_core_id(), f ? f->pc : 0, s_prof_arg);
+    return false;
+}
+#endif
+
+static void prof_timer_free(gptimer_handle_t t)
+{
+    gptimer_stop(t);       // Pueden fallar si no llegó a arrancar: da igual
+    gptimer_disable(t);
+    gptimer_del_timer(t);
+}
+
+typedef struct {
+    uint32_t hz;           // 0: parar
+    SemaphoreHandle_t done;
+    bool ok;
+} prof_core_req_t;
+
+// La interrupción del gptimer se reserva (y se libera) en el núcleo que
+// registra el callback: una tarea fijada a cada núcleo hace el trabajo
+static void prof_core_task(void *arg)
+{
+    prof_core_req_t *r = arg;
+    int core = esp_cpu_get_core_id();
+    if (s_prof_timer[core]) {
+        prof_timer_free(s_prof_timer[core]);
+        s_prof_timer[core] = NULL;
+    }
+    r->ok = true;
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+    if (r->hz) {
+        gptimer_config_t cfg = {
+            .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+            .direction = GPTIMER_COUNT_UP,
+            .resolution_hz = 1000000,
+        };
+        gptimer_alarm_config_t alarm = {
+            .alarm_count = 1000000 / r->hz,
+            .flags.auto_reload_on_alarm = true,
+        };
+        gptimer_event_callbacks_t cbs = { .on_alarm = prof_alarm_isr };
+        gptimer_handle_t t = NULL;
+        r->ok = gptimer_new_timer(&cfg, &t) == ESP_OK && gptimer_register_event_callbacks(t, &cbs, NULL) == ESP_OK &&
+                gptimer_set_alarm_action(t, &alarm) == ESP_OK && gptimer_enable(t) == ESP_OK &&
+                gptimer_start(t) == ESP_OK;
+        if (r->ok) s_prof_timer[core] = t;
+        else if (t) prof_timer_free(t);
+    }
+#else
+    r->ok = !r->hz;
+#endif
+    xSemaphoreGive(r->done);
+    vTaskDelete(NULL);
+}
+
+static bool prof_on_cores(uint32_t hz)
+{
+    bool ok = true;
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+        prof_core_req_t r = { .hz = hz, .done = xSemaphoreCreateBinary() };
+        if (!r.done) return false;
+        if (xTaskCreatePinnedToCore(prof_core_task, "prof_setup", 3072, &r, configMAX_PRIORITIES - 1, NULL, core) ==
+            pdPASS) {
+            xSemaphoreTake(r.done, portMAX_DELAY);
+        } else {
+            r.ok = false;
+        }
+        vSemaphoreDelete(r.done);
+        ok = ok && r.ok;
+    }
+    return ok;
+}
+
+bool hal_prof_start(uint32_t hz, hal_pc_sample_t fn, void *arg)
+{
+    if (!hz || hz > 10000 || !fn) return false;
+    prof_on_cores(0);
+    s_prof_fn = fn;
+    s_prof_arg = arg;
+    if (prof_on_cores(hz)) return true;
+    ESP_LOGE(TAG, "Muestreo de PC a %u Hz no disponible", (unsigned)hz);
+    prof_on_cores(0);
+    return false;
+}
+
+void hal_prof_stop(void)
+{
+    prof_on_cores(0);
+}
+
+void hal_heap_stats(size_t *free_b, size_t *min_free_b, size_t *largest_b)
+{
+    *free_b = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    *min_free_b = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    *largest_b = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+// ---- ADC ----
+
+static adc_oneshot_unit_handle_t s_adc;
+static adc_channel_t s_adc_chan[GPIO_NUM_MAX];
+
+bool hal_adc_init(int pin)
+{
+    // Solo ADC1: ADC2 lo ocupa el WiFi
+    adc_unit_t unit;
+    adc_channel_t chan;
+    if (pin < 0 || pin >= GPIO_NUM_MAX || adc_oneshot_io_to_channel(pin, &unit, &chan) != ESP_OK || unit != ADC_UNIT_1) {
+        return false;
+    }
+    if (!s_adc) {
+        adc_oneshot_unit_init_cfg_t unit_cfg = { .unit_id = ADC_UNIT_1 };
+        if (adc_oneshot_new_unit(&unit_cfg, &s_adc) != ESP_OK) return false;
+    }
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTEN_DB_11, // Mayor rango de entrada (~0-3.3V)
+    };
+    s_adc_chan[pin] = chan;
+    return adc_oneshot_config_channel(s_adc, chan, &chan_cfg) == ESP_OK;
+}
+
+int hal_adc_read(int pin)
+{
+    int raw = 0;
+    if (!s_adc || pin < 0 || pin >= GPIO_NUM_MAX) return -1;
+    return adc_oneshot_read(s_adc, s_adc_chan[pin], &raw) == ESP_OK ? raw : -1;
+}
+
+// ---- PWM (LEDC, canal y timer con el mismo número) ----
+
+bool hal_pwm_init(int ch, int pin, uint32_t freq_hz, uint8_t bits)
+{
+    if (ch < 0 || ch >= HAL_PWM_CHANNELS) return false;
+    ledc_timer_config_t tcfg = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = (ledc_timer_bit_t)bits,
+        .timer_num = (ledc_timer_t)ch,
+        .freq_hz = freq_hz,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    if (ledc_timer_config(&tcfg) != ESP_OK) return false;
+    ledc_channel_config_t cc = {
+        .gpio_num = pin,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = (ledc_channel_t)ch,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = (ledc_timer_t)ch,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    return ledc_channel_config(&cc) == ESP_OK;
+}
+
+void hal_pwm_set(int ch, uint32_t duty)
+{
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)ch, duty);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t)ch);
+}
+
+// ---- I2C (i2c_master en modo asíncrono) ----
+// La transferencia se encola y la tarea espera al callback de fin sin
+// consumir CPU. Un solo usuario a la vez (el LCD)
+
+#define HAL_I2C_DEVS 2
+
+static i2c_master_bus_handle_t s_i2c_bus;
+static SemaphoreHandle_t s_i2c_done;      // Lo da el callback de fin de transferencia
+static StaticSemaphore_t s_i2c_done_buf;
+static volatile bool s_i2c_nack;
+static struct {
+    uint8_t addr;
+    i2c_master_dev_handle_t dev;
+} s_i2c_dev[HAL_I2C_DEVS];
+
+// ISR del driver: la transferencia terminó (o el esclavo no respondió)
+static bool i2c_done_cb(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *evt, void *arg)
+{
+    BaseType_t hpw = pdFALSE;
+    s_i2c_nack = evt->event != I2C_EVENT_DONE;
+    xSemaphoreGiveFromISR(s_i2c_done, &hpw);
+    return hpw == pdTRUE;
+}
+
+bool hal_i2c_init(int sda, int scl)
+{
+    if (s_i2c_bus) return true;
+    s_i2c_done = xSemaphoreCreateBinaryStatic(&s_i2c_done_buf);
+    i2c_master_bus_config_t conf = {
+        .i2c_port = I2C_NUM_0,
+        .sda_io_num = sda,
+        .scl_io_num = scl,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = 2,   // > 0: i2c_master_transmit vuelve sin esperar
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&conf, &s_i2c_bus);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Bus I2C no disponible (%s)", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+static esp_err_t i2c_dev_new(uint8_t addr, uint32_t hz, i2c_master_dev_handle_t *dev)
+{
+    i2c_device_config_t dc = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = hz,
+    };
+    esp_err_t err = i2c_master_bus_add_device(s_i2c_bus, &dc, dev);
+    if (err != ESP_OK) return err;
+    i2c_master_event_callbacks_t cbs = { .on_trans_done = i2c_done_cb };
+    return i2c_master_register_event_callbacks(*dev, &cbs, NULL);
+}
+
+bool hal_i2c_add(uint8_t addr, uint32_t hz)
+{
+    if (!s_i2c_bus) return false;
+    for (int i = 0; i < HAL_I2C_DEVS; ++i) {
+        if (s_i2c_dev[i].dev && s_i2c_dev[i].addr == addr) return true;
+        if (s_i2c_dev[i].dev) continue;
+        if (i2c_dev_new(addr, hz, &s_i2c_dev[i].dev) != ESP_OK) return false;
+        s_i2c_dev[i].addr = addr;
+        return true;
+    }
+    return false;
+}
+
+bool hal_i2c_write(uint8_t addr, uint32_t hz, const uint8_t *buf, size_t len)
+{
+    if (!s_i2c_bus) return false;
+    i2c_master_dev_handle_t dev = NULL;
+    for (int i = 0; i < HAL_I2C_DEVS; ++i) {
+        if (s_i2c_dev[i].dev && s_i2c_dev[i].addr == addr) dev = s_i2c_dev[i].dev;
+    }
+    bool temp = !dev;
+    if (temp && i2c_dev_new(addr, hz, &dev) != ESP_OK) return false;
+    uint32_t bus_ms = (uint32_t)((len + 1) * 9ull * 1000 / hz);
+    esp_err_t err = i2c_master_transmit(dev, buf, len, -1);
+    if (err == ESP_OK && xSemaphoreTake(s_i2c_done, pdMS_TO_TICKS(50 + bus_ms)) != pdTRUE) {
+        // El buffer sigue en uso por el driver hasta que se vacíe la cola
+        i2c_master_bus_wait_all_done(s_i2c_bus, 100);
+        xSemaphoreTake(s_i2c_done, 0);
+        err = ESP_ERR_TIMEOUT;
+    } else if (err == ESP_OK && s_i2c_nack) {
+        err = ESP_FAIL;
+    }
+    if (temp) i2c_master_bus_rm_device(dev);
+    if (err != ESP_OK) ESP_LOGW(TAG, "I2C: escritura de %u bytes a 0x%02X falló: %s", (unsigned)len, addr, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+// ---- SPI (VSPI) ----
+
+hal_spi_t *hal_spi_open(int sck, int mosi, int miso, int cs, uint32_t hz)
+{
+    spi_bus_config_t buscfg = {
+        .sclk_io_num = sck,
+        .mosi_io_num = mosi,
+        .miso_io_num = miso,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = 0,
+    };
+    esp_err_t err = spi_bus_initialize(SPI3_HOST, &buscfg, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "spi_bus_initialize falló (%s)", esp_err_to_name(err));
+        return NULL;
+    }
+    spi_device_interface_config_t devcfg = {
+        .clock_speed_hz = (int)hz,
+        .mode = 0,
+        .spics_io_num = cs,
+        .queue_size = 3,
+        .flags = 0,
+    };
+    spi_device_handle_t dev = NULL;
+    err = spi_bus_add_device(SPI3_HOST, &devcfg, &dev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "spi_bus_add_device falló (%s)", esp_err_to_name(err));
+        return NULL;
+    }
+    return (hal_spi_t *)dev;
+}
+
+bool hal_spi_xfer(hal_spi_t *s, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+    if (!s) return false;
+    spi_transaction_t t = { 0 };
+    t.length = len * 8; // bits
+    t.tx_buffer = tx;
+    t.rx_buffer = rx;
+    return spi_device_transmit((spi_device_handle_t)s, &t) == ESP_OK;
+}
+
+// ---- UART ----
+
+bool hal_uart_open(int port)
+{
+    if (uart_is_driver_installed(port)) return true;
+    esp_err_t err = uart_driver_install(port, 256, 1024, 0, NULL, 0);
+    if (err != ESP_OK) ESP_LOGE(TAG, "uart_driver_install falló (%s)", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+void hal_uart_write(int port, const void *buf, size_t len)
+{
+    uart_write_bytes(port, buf, len);
+}
+
+// ---- Almacenamiento ----
+
+bool hal_fs_mount(size_t *total, size_t *used)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = HAL_FS_ROOT,
+        .partition_label = "storage", // etiqueta explícita según partitions.csv
+        .max_files = 5,
+        .format_if_mount_failed = true
+    };
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error montando SPIFFS (%s)", esp_err_to_name(ret));
+        return false;
+    }
+    esp_spiffs_info("storage", total, used);
+    return true;
+}
+
+static nvs_handle_t s_nvs;
+
+bool hal_kv_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        if (nvs_flash_erase() == ESP_OK) ret = nvs_flash_init();
+    }
+    if (ret != ESP_OK) ESP_LOGE(TAG, "nvs_flash_init falló (%s)", esp_err_to_name(ret));
+    return ret == ESP_OK;
+}
+
+bool hal_kv_open(const char *ns)
+{
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, &s_nvs);
+    if (err != ESP_OK) ESP_LOGE(TAG, "NVS '%s' no disponible (%s)", ns, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+bool hal_kv_get_i32(const char *key, int32_t *out)
+{
+    return nvs_get_i32(s_nvs, key, out) == ESP_OK;
+}
+
+bool hal_kv_set_i32(const char *key, int32_t v)
+{
+    return nvs_set_i32(s_nvs, key, v) == ESP_OK;
+}
+
+bool hal_kv_get_str(const char *key, char *out, size_t cap)
+{
+    size_t len = cap;
+    return nvs_get_str(s_nvs, key, out, &len) == ESP_OK;
+}
+
+bool hal_kv_set_str(const char *key, const char *v)
+{
+    return nvs_set_str(s_nvs, key, v) == ESP_OK;
+}
+
+bool hal_kv_commit(void)
+{
+    return nvs_commit(s_nvs) == ESP_OK;
+}
+
+// ---- Red ----
+
+const char *hal_chip_model(void)
+{
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    switch (chip_info.model) {
+    case CHIP_ESP32:   return "ESP32_Classic";
+    case CHIP_ESP32S3: return "ESP32_S3";
+    case CHIP_ESP32C3: return "ESP32_C3";
+    default:           return "ESP_Unknown";
+    }
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        esp_wifi_connect();
+        ESP_LOGW(TAG, "Retrying WiFi...");
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGI(TAG, "WiFi Connected! IP: " IPSTR, IP2STR(&event->ip_info.ip));
+    }
+}
+
+static int s_listen = -1;             // hal_net_power_save
+static bool s_wifi_started;
+
+static void wifi_apply_config(const char *ssid, const char *pass)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {.capable = true, .required = false}
+        },
+    };
+    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, pass, sizeof(wifi_config.sta.password) - 1);
+    wifi_config.sta.listen_interval = (uint16_t)(s_listen > 0 ? s_listen : 0); // 0: el de fábrica (3)
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+}
+
+static wifi_ps_type_t wifi_ps_type(int listen)
+{
+    return listen < 0 ? WIFI_PS_NONE : listen == 0 ? WIFI_PS_MIN_MODEM : WIFI_PS_MAX_MODEM;
+}
+
+void hal_net_start(const char *ssid, const char *pass)
+{
+    esp_netif_init();
+    esp_event_loop_create_default();
+    esp_netif_create_default_wifi_sta();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_wifi_init(&cfg);
+
+    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL);
+
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    wifi_apply_config(ssid, pass);
+    esp_wifi_start();
+    esp_wifi_set_ps(wifi_ps_type(s_listen));
+    s_wifi_started = true;
+}
+
+void hal_net_reconfigure(const char *ssid, const char *pass)
+{
+    wifi_apply_config(ssid, pass);
+    esp_wifi_disconnect(); // wifi_event_handler reconecta con la red nueva
+}
+
+void hal_net_power_save(int listen_interval)
+{
+    s_listen = listen_interval;
+    if (s_wifi_started) esp_wifi_set_ps(wifi_ps_type(listen_interval));
+}
+
+// ---- MQTT (esp-mqtt) ----
+
+static esp_mqtt_client_handle_t s_mqtt;
+static hal_mqtt_cb_t s_mqtt_cb;
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+    hal_mqtt_event_t ev = { 0 };
+    switch (event_id) {
+    case MQTT_EVENT_CONNECTED:    ev.kind = HAL_MQTT_CONNECTED; break;
+    case MQTT_EVENT_DISCONNECTED: ev.kind = HAL_MQTT_DISCONNECTED; break;
+    case MQTT_EVENT_DATA:
+        ev.kind = HAL_MQTT_DATA;
+        ev.topic = event->topic;
+        ev.topic_len = event->topic_len;
+        ev.data = event->data;
+        ev.data_len = event->data_len;
+        ev.offset = event->current_data_offset;
+        ev.total_len = event->total_data_len;
+        break;
+    default:
+        return;
+    }
+    s_mqtt_cb(&ev);
+}
+
+bool hal_mqtt_start(const char *uri, hal_mqtt_cb_t cb)
+{
+    // El cliente copia la URI
+    esp_mqtt_client_config_t mqtt_cfg = { .broker.address.uri = uri };
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    if (!client) return false;
+    s_mqtt_cb = cb;
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    esp_mqtt_client_start(client);
+    s_mqtt = client;
+    return true;
+}
+
+bool hal_mqtt_ready(void)
+{
+    return s_mqtt != NULL;
+}
+
+int hal_mqtt_publish(const char *topic, const char *data, int len, int qos, int retain)
+{
+    return s_mqtt ? esp_mqtt_client_publish(s_mqtt, topic, data, len, qos, retain) : -1;
+}
+
+int hal_mqtt_enqueue(const char *topic, const char *data, int len, int qos, int retain)
+{
+    return s_mqtt ? esp_mqtt_client_enqueue(s_mqtt, topic, data, len, qos, retain, true) : -1;
+}
+
+int hal_mqtt_subscribe(const char *topic, int qos)
+{
+    return s_mqtt ? esp_mqtt_client_subscribe(s_mqtt, topic, qos) : -1;
+}
+
+void hal_mqtt_set_uri(const char *uri)
+{
+    if (!s_mqtt) return;
+    esp_mqtt_client_set_uri(s_mqtt, uri);
+    esp_mqtt_client_disconnect(s_mqtt); // La reconexión automática usa la URI nueva
+}
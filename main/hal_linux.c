@@ -0,0 +1,997 @@
+#include "hal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "hal_vdev.h"
+
+#define TAG "HAL"
+
+// Backend del target "linux" de ESP-IDF: el firmware entero corre como un
+// proceso, con FreeRTOS sobre hilos POSIX. Variables de entorno:
+//   HAL_SCRIPT      guion de sensores virtuales (hal_vdev.h); sin él, entradas en reposo
+//   HAL_MQTT_URI    mqtt://host:puerto de un broker real; sin él, MQTT en bucle local:
+//                   lo publicado se registra y los "mqtt" del guion llegan como mensajes
+//   HAL_TRACE_I2C   1: registrar cada escritura I2C (LCD)
+// Las salidas (GPIO, PWM, MQTT) salen por stdout como "SIM <ms> <qué> ...",
+// fáciles de filtrar con grep en una prueba.
+
+#define SIM_PINS          40
+#define SIM_TIMER_PRIO    22           // Como la tarea de esp_timer
+#define SIM_SCRIPT_PRIO   (configMAX_PRIORITIES - 2)   // Las entradas hacen de ISR
+#define SIM_MQTT_PRIO     5
+#define SIM_MQTT_QUEUE    32
+#define SIM_MQTT_CHUNK    1024         // Trozos de mensaje, como el buffer de esp-mqtt
+#define SIM_MQTT_RX_MAX   (128 * 1024)
+#define SIM_MQTT_KEEPALIVE_S 30
+#define SIM_MQTT_RETRY_MS 2000
+
+static int64_t s_t0_us;
+static volatile bool s_started;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sim_start(void);
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t hal_time_us(void)
+{
+    if (!s_started) sim_start();
+    return mono_us() - s_t0_us;
+}
+
+#define SIM_OUT(fmt, ...) \
+    do { printf("SIM %lld " fmt "\n", (long long)(hal_time_us() / 1000), ##__VA_ARGS__); fflush(stdout); } while (0)
+
+// ---- Temporizadores: una tarea que duerme hasta el vencimiento más próximo ----
+
+struct hal_timer {
+    const char *name;
+    hal_timer_cb_t cb;
+    void *arg;
+    int64_t due_us;
+    bool armed;
+    struct hal_timer *next;
+};
+
+static struct hal_timer *s_timers;
+static TaskHandle_t s_timer_task;
+
+static void timer_task(void *arg)
+{
+    for (;;) {
+        int64_t now = hal_time_us();
+        int64_t next = INT64_MAX;
+        struct hal_timer *fire = NULL;
+        portENTER_CRITICAL(&s_mux);
+        for (struct hal_timer *t = s_timers; t; t = t->next) {
+            if (!t->armed) continue;
+            if (t->due_us <= now) {
+                if (!fire || t->due_us < fire->due_us) fire = t;
+            } else if (t->due_us < next) {
+                next = t->due_us;
+            }
+        }
+        if (fire) fire->armed = false;
+        portEXIT_CRITICAL(&s_mux);
+        if (fire) {
+            fire->cb(fire->arg);
+            continue;
+        }
+        TickType_t wait = portMAX_DELAY;
+        if (next != INT64_MAX) {
+            int64_t ms = (next - now + 999) / 1000;
+            wait = pdMS_TO_TICKS(ms) > 0 ? pdMS_TO_TICKS(ms) : 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+hal_timer_t *hal_timer_create(const char *name, hal_timer_cb_t cb, void *arg)
+{
+    if (!s_started) sim_start();
+    struct hal_timer *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->name = name;
+    t->cb = cb;
+    t->arg = arg;
+    portENTER_CRITICAL(&s_mux);
+    t->next = s_timers;
+    s_timers = t;
+    portEXIT_CRITICAL(&s_mux);
+    return t;
+}
+
+bool hal_timer_start_once(hal_timer_t *t, uint64_t delay_us)
+{
+    int64_t due = hal_time_us() + (int64_t)delay_us;
+    portENTER_CRITICAL(&s_mux);
+    bool ok = !t->armed;
+    if (ok) {
+        t->due_us = due;
+        t->armed = true;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (ok) xTaskNotifyGive(s_timer_task);
+    return ok;
+}
+
+void hal_timer_stop(hal_timer_t *t)
+{
+    portENTER_CRITICAL(&s_mux);
+    t->armed = false;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// ---- GPIO y ADC: niveles en memoria; las entradas las mueve el guion ----
+
+static struct {
+    int8_t mode;             // hal_gpio_mode_t
+    int8_t level;
+    bool driven;             // El guion ya fijó el nivel
+    hal_gpio_isr_t isr;
+    void *arg;
+} s_pin[SIM_PINS];
+static int s_adc[SIM_PINS];
+
+static bool pin_ok(int pin)
+{
+    return pin >= 0 && pin < SIM_PINS;
+}
+
+bool hal_gpio_config(int pin, hal_gpio_mode_t mode)
+{
+    if (!s_started) sim_start();
+    if (!pin_ok(pin)) return false;
+    portENTER_CRITICAL(&s_mux);
+    s_pin[pin].mode = (int8_t)mode;
+    if (mode == HAL_GPIO_OUTPUT) s_pin[pin].level = 0;
+    else if (!s_pin[pin].driven) s_pin[pin].level = mode == HAL_GPIO_INPUT_PULLUP;
+    portEXIT_CRITICAL(&s_mux);
+    return true;
+}
+
+void hal_gpio_set(int pin, int level)
+{
+    if (!pin_ok(pin)) return;
+    portENTER_CRITICAL(&s_mux);
+    bool changed = s_pin[pin].level != (level != 0);
+    s_pin[pin].level = (int8_t)(level != 0);
+    portEXIT_CRITICAL(&s_mux);
+    if (changed) SIM_OUT("gpio %d %d", pin, level != 0);
+}
+
+int hal_gpio_get(int pin)
+{
+    if (!pin_ok(pin)) return 0;
+    portENTER_CRITICAL(&s_mux);
+    int level = s_pin[pin].level;
+    portEXIT_CRITICAL(&s_mux);
+    return level;
+}
+
+bool hal_gpio_on_edge(int pin, hal_gpio_isr_t isr, void *arg)
+{
+    if (!pin_ok(pin)) return false;
+    portENTER_CRITICAL(&s_mux);
+    s_pin[pin].isr = isr;
+    s_pin[pin].arg = arg;
+    portEXIT_CRITICAL(&s_mux);
+    return true;
+}
+
+bool hal_gpio_wake(int pin)
+{
+    return pin_ok(pin); // Sin sueño en el host: los flancos ya llegan
+}
+
+// Flanco desde el guion: la "ISR" corre en la tarea del guion
+static void sim_drive_pin(int pin, int level)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool edge = s_pin[pin].level != level;
+    s_pin[pin].level = (int8_t)level;
+    s_pin[pin].driven = true;
+    hal_gpio_isr_t isr = s_pin[pin].isr;
+    void *arg = s_pin[pin].arg;
+    portEXIT_CRITICAL(&s_mux);
+    if (edge && isr) isr(arg);
+}
+
+// ---- Energía: el host no duerme ni escala frecuencia ----
+
+bool hal_pm_config(int max_mhz, int min_mhz, bool light_sleep)
+{
+    SIM_OUT("pm %d-%d MHz sueño %d", min_mhz, max_mhz, light_sleep);
+    return false;
+}
+
+void hal_pm_busy(bool on)
+{
+}
+
+void hal_pm_stats(int64_t *slept_us, uint32_t *wakeups)
+{
+    *slept_us = 0;
+    *wakeups = 0;
+}
+
+bool hal_pm_idle_us(uint32_t *idle_us)
+{
+    *idle_us = 0;
+    return false;
+}
+
+// ---- Perfilado: FreeRTOS sobre POSIX no expone el PC interrumpido ----
+
+bool hal_prof_start(uint32_t hz, hal_pc_sample_t fn, void *arg)
+{
+    SIM_OUT("prof %u Hz (sin muestreo de PC)", (unsigned)hz);
+    return false;
+}
+
+void hal_prof_stop(void)
+{
+}
+
+void hal_heap_stats(size_t *free_b, size_t *min_free_b, size_t *largest_b)
+{
+    // Montículo del proceso: sin cifras comparables con las de la placa
+    *free_b = *min_free_b = *largest_b = 0;
+}
+
+bool hal_adc_init(int pin)
+{
+    if (!s_started) sim_start();
+    return pin >= 32 && pin <= 39; // ADC1 del ESP32
+}
+
+int hal_adc_read(int pin)
+{
+    if (!pin_ok(pin)) return -1;
+    portENTER_CRITICAL(&s_mux);
+    int v = s_adc[pin];
+    portEXIT_CRITICAL(&s_mux);
+    return v;
+}
+
+// ---- PWM ----
+
+static uint8_t s_pwm_bits[HAL_PWM_CHANNELS];
+static uint32_t s_pwm_duty[HAL_PWM_CHANNELS];
+
+bool hal_pwm_init(int ch, int pin, uint32_t freq_hz, uint8_t bits)
+{
+    if (ch < 0 || ch >= HAL_PWM_CHANNELS) return false;
+    s_pwm_bits[ch] = bits;
+    s_pwm_duty[ch] = 0;
+    SIM_OUT("pwm %d gpio %d %u Hz %u bits", ch, pin, (unsigned)freq_hz, bits);
+    return true;
+}
+
+void hal_pwm_set(int ch, uint32_t duty)
+{
+    if (ch < 0 || ch >= HAL_PWM_CHANNELS || s_pwm_duty[ch] == duty) return;
+    s_pwm_duty[ch] = duty;
+    SIM_OUT("pwm %d %u/%u", ch, (unsigned)duty, (1u << s_pwm_bits[ch]) - 1);
+}
+
+// ---- I2C: sin esclavos reales; la transferencia dura lo que duraría en el bus ----
+
+static bool s_i2c_ready;
+static bool s_i2c_trace;
+static uint32_t s_i2c_bytes;
+
+bool hal_i2c_init(int sda, int scl)
+{
+    s_i2c_ready = true;
+    s_i2c_trace = getenv("HAL_TRACE_I2C") != NULL;
+    return true;
+}
+
+bool hal_i2c_add(uint8_t addr, uint32_t hz)
+{
+    return s_i2c_ready;
+}
+
+bool hal_i2c_write(uint8_t addr, uint32_t hz, const uint8_t *buf, size_t len)
+{
+    if (!s_i2c_ready) return false;
+    uint32_t bus_ms = (uint32_t)((len + 1) * 9ull * 1000 / hz);
+    vTaskDelay(pdMS_TO_TICKS(bus_ms) > 0 ? pdMS_TO_TICKS(bus_ms) : 1);
+    s_i2c_bytes += (uint32_t)len;
+    if (s_i2c_trace) SIM_OUT("i2c 0x%02X %u bytes (%u en total)", addr, (unsigned)len, (unsigned)s_i2c_bytes);
+    return true;
+}
+
+// ---- SPI: un MFRC522 virtual por CS (un lector por puerta) ----
+
+#define SIM_SPI_MAX 4
+
+struct hal_spi {
+    int cs;                  // -1: hueco libre
+    vdev_rc522_t chip;
+};
+
+static struct hal_spi s_spi[SIM_SPI_MAX] = { [0 ... SIM_SPI_MAX - 1] = { .cs = -1 } };
+
+// Bajo s_mux. cs < 0: el primer lector. Las tarjetas del guion pueden
+// llegar antes de abrir el lector: el hueco se reserva entonces
+static struct hal_spi *spi_slot(int cs)
+{
+    for (int i = 0; i < SIM_SPI_MAX; ++i) {
+        if (s_spi[i].cs == cs || (cs < 0 && i == 0)) return &s_spi[i];
+        if (s_spi[i].cs < 0) {
+            s_spi[i].cs = cs;
+            return &s_spi[i];
+        }
+    }
+    return NULL;
+}
+
+hal_spi_t *hal_spi_open(int sck, int mosi, int miso, int cs, uint32_t hz)
+{
+    if (!s_started) sim_start();
+    portENTER_CRITICAL(&s_mux);
+    struct hal_spi *d = spi_slot(cs);
+    if (d) vdev_rc522_init(&d->chip);
+    portEXIT_CRITICAL(&s_mux);
+    if (!d) ESP_LOGE(TAG, "Más de %d lectores SPI virtuales", SIM_SPI_MAX);
+    return d;
+}
+
+bool hal_spi_xfer(hal_spi_t *s, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+    if (!s) return false;
+    portENTER_CRITICAL(&s_mux);
+    vdev_rc522_xfer(&s->chip, tx, rx, len);
+    portEXIT_CRITICAL(&s_mux);
+    return true;
+}
+
+// ---- UART: archivo uart<N>.bin en el directorio de trabajo ----
+
+static FILE *s_uart[3];
+
+bool hal_uart_open(int port)
+{
+    if (port < 0 || port >= 3) return false;
+    if (s_uart[port]) return true;
+    char path[16];
+    snprintf(path, sizeof(path), "uart%d.bin", port);
+    s_uart[port] = fopen(path, "ab");
+    return s_uart[port] != NULL;
+}
+
+void hal_uart_write(int port, const void *buf, size_t len)
+{
+    if (port < 0 || port >= 3 || !s_uart[port]) return;
+    fwrite(buf, 1, len, s_uart[port]);
+    fflush(s_uart[port]);
+}
+
+// ---- Almacenamiento: HAL_FS_ROOT y nvs_<ns>.txt en el directorio de trabajo ----
+
+bool hal_fs_mount(size_t *total, size_t *used)
+{
+    if (mkdir(HAL_FS_ROOT, 0755) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "No se pudo crear %s (%s)", HAL_FS_ROOT, strerror(errno));
+        return false;
+    }
+    struct statvfs st;
+    if (statvfs(HAL_FS_ROOT, &st) == 0) {
+        *total = (size_t)(st.f_blocks * st.f_frsize);
+        *used = (size_t)((st.f_blocks - st.f_bfree) * st.f_frsize);
+    }
+    return true;
+}
+
+static vdev_kv_t s_kv;
+static char s_kv_path[48];
+static SemaphoreHandle_t s_kv_lock;
+
+bool hal_kv_init(void)
+{
+    if (!s_started) sim_start();
+    return true;
+}
+
+bool hal_kv_open(const char *ns)
+{
+    snprintf(s_kv_path, sizeof(s_kv_path), "nvs_%s.txt", ns);
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    FILE *f = fopen(s_kv_path, "r");
+    int n = 0;
+    if (f) {
+        n = vdev_kv_load(&s_kv, f);
+        fclose(f);
+    }
+    xSemaphoreGive(s_kv_lock);
+    ESP_LOGI(TAG, "NVS '%s' en %s (%d claves)", ns, s_kv_path, n);
+    return true;
+}
+
+bool hal_kv_get_i32(const char *key, int32_t *out)
+{
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    bool ok = vdev_kv_get_i32(&s_kv, key, out);
+    xSemaphoreGive(s_kv_lock);
+    return ok;
+}
+
+bool hal_kv_set_i32(const char *key, int32_t v)
+{
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    bool ok = vdev_kv_set_i32(&s_kv, key, v);
+    xSemaphoreGive(s_kv_lock);
+    return ok;
+}
+
+bool hal_kv_get_str(const char *key, char *out, size_t cap)
+{
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    bool ok = vdev_kv_get_str(&s_kv, key, out, cap);
+    xSemaphoreGive(s_kv_lock);
+    return ok;
+}
+
+bool hal_kv_set_str(const char *key, const char *v)
+{
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    bool ok = vdev_kv_set_str(&s_kv, key, v);
+    xSemaphoreGive(s_kv_lock);
+    return ok;
+}
+
+bool hal_kv_commit(void)
+{
+    // Archivo nuevo y rename: un corte a medias deja el anterior intacto
+    char tmp[sizeof(s_kv_path) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.new", s_kv_path);
+    xSemaphoreTake(s_kv_lock, portMAX_DELAY);
+    FILE *f = fopen(tmp, "w");
+    bool ok = f && vdev_kv_save(&s_kv, f);
+    if (f) fclose(f);
+    ok = ok && rename(tmp, s_kv_path) == 0;
+    xSemaphoreGive(s_kv_lock);
+    return ok;
+}
+
+// ---- Red ----
+
+const char *hal_chip_model(void)
+{
+    return "Linux_Host";
+}
+
+void hal_net_start(const char *ssid, const char *pass)
+{
+    ESP_LOGI(TAG, "Red del host (WiFi \"%s\" sin efecto)", ssid);
+}
+
+void hal_net_reconfigure(const char *ssid, const char *pass)
+{
+    ESP_LOGI(TAG, "WiFi \"%s\" sin efecto en el host", ssid);
+}
+
+void hal_net_power_save(int listen_interval)
+{
+    SIM_OUT("wifi ps %d", listen_interval);
+}
+
+// ---- MQTT: bucle local o cliente 3.1.1 mínimo sobre sockets POSIX ----
+// Todo el tráfico lo mueve mqtt_task (como la tarea de esp-mqtt): colas de
+// salida y de mensajes inyectados por el guion, y el socket sin bloqueo
+
+typedef struct {
+    int qos;
+    int retain;
+    int len;
+    char *topic;
+    char *data;              // Tras el topic en el mismo bloque
+} sim_msg_t;
+
+static QueueHandle_t s_mqtt_out;
+static QueueHandle_t s_mqtt_in;
+static hal_mqtt_cb_t s_mqtt_cb;
+static const char *s_broker;           // HAL_MQTT_URI; NULL: bucle local
+static volatile bool s_mqtt_reconnect;
+static int s_sock = -1;
+static int s_msg_id;                   // Devuelto por publish/enqueue
+static uint16_t s_pkt_id;              // Identificador de paquete en el cable (tarea mqtt)
+static uint8_t *s_rx;
+static size_t s_rx_n;
+static size_t s_rx_cap;
+static SemaphoreHandle_t s_tx_lock;
+
+static sim_msg_t *msg_new(const char *topic, const char *data, int len, int qos, int retain)
+{
+    if (len <= 0) len = (int)strlen(data);
+    size_t tl = strlen(topic);
+    sim_msg_t *m = malloc(sizeof(*m) + tl + 1 + (size_t)len + 1);
+    if (!m) return NULL;
+    m->topic = (char *)(m + 1);
+    m->data = m->topic + tl + 1;
+    memcpy(m->topic, topic, tl + 1);
+    memcpy(m->data, data, (size_t)len);
+    m->data[len] = '\0';
+    m->len = len;
+    m->qos = qos;
+    m->retain = retain;
+    return m;
+}
+
+static bool sock_send(const uint8_t *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = send(s_sock, p, n, MSG_NOSIGNAL);
+        if (w > 0) {
+            p += w;
+            n -= (size_t)w;
+        } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            vTaskDelay(1);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Cabecera fija + longitud restante (varint) + cuerpo
+static bool mqtt_packet(uint8_t type, const uint8_t *body, size_t len)
+{
+    uint8_t hdr[5] = { type };
+    size_t h = 1, rem = len;
+    do {
+        hdr[h] = rem % 128;
+        rem /= 128;
+        if (rem) hdr[h] |= 0x80;
+        h++;
+    } while (rem);
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    bool ok = s_sock >= 0 && sock_send(hdr, h) && sock_send(body, len);
+    xSemaphoreGive(s_tx_lock);
+    return ok;
+}
+
+static size_t put_str(uint8_t *p, const char *s, size_t n)
+{
+    p[0] = (uint8_t)(n >> 8);
+    p[1] = (uint8_t)n;
+    memcpy(p + 2, s, n);
+    return n + 2;
+}
+
+static bool mqtt_send_publish(const sim_msg_t *m)
+{
+    size_t tl = strlen(m->topic);
+    uint8_t *body = malloc(tl + 4 + (size_t)m->len);
+    if (!body) return false;
+    size_t n = put_str(body, m->topic, tl);
+    if (m->qos > 0) {
+        uint16_t id = ++s_pkt_id ? s_pkt_id : ++s_pkt_id;
+        body[n++] = (uint8_t)(id >> 8);
+        body[n++] = (uint8_t)id;
+    }
+    memcpy(body + n, m->data, (size_t)m->len);
+    n += (size_t)m->len;
+    bool ok = mqtt_packet((uint8_t)(0x30 | (m->qos > 0 ? 2 : 0) | (m->retain ? 1 : 0)), body, n);
+    free(body);
+    return ok;
+}
+
+static void mqtt_close(void)
+{
+    if (s_sock < 0) return;
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    close(s_sock);
+    s_sock = -1;
+    xSemaphoreGive(s_tx_lock);
+    s_rx_n = 0;
+}
+
+static bool mqtt_connect(const char *uri)
+{
+    char host[64];
+    int port = 1883;
+    if (sscanf(uri, "mqtt://%63[^:/]:%d", host, &port) < 1) {
+        ESP_LOGE(TAG, "URI no soportada: %s", uri);
+        return false;
+    }
+    char portstr[8];
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *ai = NULL;
+    if (getaddrinfo(host, portstr, &hints, &ai) != 0 || !ai) return false;
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    bool ok = fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+    freeaddrinfo(ai);
+    if (!ok) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    s_sock = fd;
+    s_rx_n = 0;
+
+    char cid[32];
+    int cl = snprintf(cid, sizeof(cid), "access_linux_%d", (int)getpid());
+    uint8_t body[64];
+    size_t n = put_str(body, "MQTT", 4);
+    body[n++] = 4;                       // Protocolo 3.1.1
+    body[n++] = 0x02;                    // Sesión limpia
+    body[n++] = 0;
+    body[n++] = SIM_MQTT_KEEPALIVE_S;
+    n += put_str(body + n, cid, (size_t)cl);
+    if (!mqtt_packet(0x10, body, n)) {
+        mqtt_close();
+        return false;
+    }
+    // CONNACK (4 bytes) en menos de 3 s
+    uint8_t ack[4];
+    size_t got = 0;
+    for (int i = 0; i < 3000 && got < sizeof(ack); ++i) {
+        ssize_t r = recv(s_sock, ack + got, sizeof(ack) - got, 0);
+        if (r > 0) got += (size_t)r;
+        else if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) break;
+        else vTaskDelay(pdMS_TO_TICKS(1) > 0 ? pdMS_TO_TICKS(1) : 1);
+    }
+    if (got < sizeof(ack) || ack[0] != 0x20 || ack[3] != 0) {
+        ESP_LOGW(TAG, "Broker %s rechazó la conexión", uri);
+        mqtt_close();
+        return false;
+    }
+    return true;
+}
+
+// Entrega un mensaje completo en trozos de SIM_MQTT_CHUNK
+static void mqtt_deliver(const char *topic, int topic_len, const char *data, int len)
+{
+    for (int off = 0; off == 0 || off < len; off += SIM_MQTT_CHUNK) {
+        int n = len - off < SIM_MQTT_CHUNK ? len - off : SIM_MQTT_CHUNK;
+        hal_mqtt_event_t ev = {
+            .kind = HAL_MQTT_DATA,
+            .topic = off == 0 ? topic : NULL,
+            .topic_len = off == 0 ? topic_len : 0,
+            .data = data + off,
+            .data_len = n,
+            .offset = off,
+            .total_len = len,
+        };
+        s_mqtt_cb(&ev);
+    }
+}
+
+// Procesa los paquetes completos del buffer de entrada
+static bool mqtt_rx_packets(void)
+{
+    for (;;) {
+        size_t rem = 0, h = 1;
+        int shift = 0;
+        for (;; ++h) {
+            if (h >= s_rx_n) return true;
+            rem |= (size_t)(s_rx[h] & 0x7F) << shift;
+            shift += 7;
+            if (!(s_rx[h] & 0x80)) break;
+            if (h == 4) return false;
+        }
+        h++;
+        if (s_rx_n < h + rem) {
+            if (h + rem > SIM_MQTT_RX_MAX) return false;
+            return true;
+        }
+        uint8_t type = s_rx[0];
+        const uint8_t *b = s_rx + h;
+        if ((type & 0xF0) == 0x30 && rem >= 2) {
+            int qos = (type >> 1) & 3;
+            size_t tl = (size_t)b[0] << 8 | b[1];
+            size_t at = 2 + tl + (qos ? 2 : 0);
+            if (at > rem) return false;
+            if (qos == 1) {
+                uint8_t ack[2] = { b[2 + tl], b[3 + tl] };
+                mqtt_packet(0x40, ack, sizeof(ack));
+            }
+            mqtt_deliver((const char *)b + 2, (int)tl, (const char *)b + at, (int)(rem - at));
+        }
+        // CONNACK, PUBACK, SUBACK y PINGRESP no piden nada más
+        memmove(s_rx, s_rx + h + rem, s_rx_n - h - rem);
+        s_rx_n -= h + rem;
+    }
+}
+
+static bool mqtt_rx(void)
+{
+    for (;;) {
+        if (s_rx_cap - s_rx_n < 1024) {
+            size_t cap = s_rx_cap ? s_rx_cap * 2 : 4096;
+            if (cap > SIM_MQTT_RX_MAX + 1024) return false;
+            uint8_t *p = realloc(s_rx, cap);
+            if (!p) return false;
+            s_rx = p;
+            s_rx_cap = cap;
+        }
+        ssize_t r = recv(s_sock, s_rx + s_rx_n, s_rx_cap - s_rx_n, 0);
+        if (r > 0) {
+            s_rx_n += (size_t)r;
+            if (!mqtt_rx_packets()) return false;
+        } else if (r == 0) {
+            return false;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+static void mqtt_event(hal_mqtt_kind_t kind)
+{
+    hal_mqtt_event_t ev = { .kind = kind };
+    s_mqtt_cb(&ev);
+}
+
+static void mqtt_task(void *arg)
+{
+    bool connected = false;
+    int64_t retry_us = 0, ping_us = 0;
+    for (;;) {
+        int64_t now = hal_time_us();
+        if (s_mqtt_reconnect) {
+            s_mqtt_reconnect = false;
+            if (connected) {
+                mqtt_close();
+                connected = false;
+                mqtt_event(HAL_MQTT_DISCONNECTED);
+            }
+        }
+        if (!connected && now >= retry_us) {
+            connected = !s_broker || mqtt_connect(s_broker);
+            if (connected) {
+                ping_us = now + SIM_MQTT_KEEPALIVE_S * 1000000LL / 2;
+                mqtt_event(HAL_MQTT_CONNECTED);
+            } else {
+                ESP_LOGW(TAG, "Sin broker en %s; reintento en %d ms", s_broker, SIM_MQTT_RETRY_MS);
+                retry_us = now + SIM_MQTT_RETRY_MS * 1000LL;
+            }
+        }
+        sim_msg_t *m;
+        while (xQueueReceive(s_mqtt_in, &m, 0) == pdTRUE) {
+            mqtt_deliver(m->topic, (int)strlen(m->topic), m->data, m->len);
+            free(m);
+        }
+        // Desconectado, lo pendiente espera en la cola (como el outbox de esp-mqtt)
+        while (connected && xQueueReceive(s_mqtt_out, &m, 0) == pdTRUE) {
+            SIM_OUT("mqtt> %s%s %s", m->topic, m->retain ? " (retenido)" : "", m->data);
+            bool ok = !s_broker || mqtt_send_publish(m);
+            free(m);
+            if (!ok) s_mqtt_reconnect = true;
+        }
+        if (connected && s_broker) {
+            if (!mqtt_rx()) s_mqtt_reconnect = true;
+            if (now >= ping_us) {
+                mqtt_packet(0xC0, NULL, 0);
+                ping_us = now + SIM_MQTT_KEEPALIVE_S * 1000000LL / 2;
+            }
+        }
+        vTaskDelay(1);
+    }
+}
+
+bool hal_mqtt_start(const char *uri, hal_mqtt_cb_t cb)
+{
+    s_broker = getenv("HAL_MQTT_URI");
+    s_mqtt_cb = cb;
+    ESP_LOGI(TAG, "MQTT: %s%s", s_broker ? "broker " : "bucle local", s_broker ? s_broker : "");
+    return xTaskCreate(mqtt_task, "mqtt", 6144, NULL, SIM_MQTT_PRIO, NULL) == pdPASS;
+}
+
+bool hal_mqtt_ready(void)
+{
+    return s_mqtt_cb != NULL;
+}
+
+static int mqtt_queue(const char *topic, const char *data, int len, int qos, int retain, TickType_t wait)
+{
+    if (!s_mqtt_cb) return -1;
+    sim_msg_t *m = msg_new(topic, data, len, qos, retain);
+    if (!m) return -1;
+    if (xQueueSend(s_mqtt_out, &m, wait) != pdTRUE) {
+        free(m);
+        return -1;
+    }
+    portENTER_CRITICAL(&s_mux);
+    int id = ++s_msg_id;
+    portEXIT_CRITICAL(&s_mux);
+    return id;
+}
+
+int hal_mqtt_publish(const char *topic, const char *data, int len, int qos, int retain)
+{
+    return mqtt_queue(topic, data, len, qos, retain, pdMS_TO_TICKS(1000));
+}
+
+int hal_mqtt_enqueue(const char *topic, const char *data, int len, int qos, int retain)
+{
+    return mqtt_queue(topic, data, len, qos, retain, 0);
+}
+
+int hal_mqtt_subscribe(const char *topic, int qos)
+{
+    if (!s_broker) return 0; // Bucle local: el guion decide qué llega
+    size_t tl = strlen(topic);
+    uint8_t *body = malloc(tl + 5);
+    if (!body) return -1;
+    uint16_t id = ++s_pkt_id ? s_pkt_id : ++s_pkt_id;
+    body[0] = (uint8_t)(id >> 8);
+    body[1] = (uint8_t)id;
+    size_t n = 2 + put_str(body + 2, topic, tl);
+    body[n++] = (uint8_t)qos;
+    bool ok = mqtt_packet(0x82, body, n);
+    free(body);
+    return ok ? id : -1;
+}
+
+void hal_mqtt_set_uri(const char *uri)
+{
+    // En el host manda HAL_MQTT_URI; solo se simula la reconexión
+    ESP_LOGI(TAG, "MQTT: URI %s ignorada en el host; reconectando", uri);
+    s_mqtt_reconnect = true;
+}
+
+// ---- Guion de sensores virtuales ----
+
+typedef struct {
+    vdev_cmd_t cmd;
+    char *line;              // Dueña de topic y payload
+} sim_step_t;
+
+static sim_step_t *s_steps;
+static int s_n_steps;
+
+static bool script_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "No se pudo abrir el guion %s", path);
+        return false;
+    }
+    char line[VDEV_LINE_MAX];
+    char err[96];
+    int64_t prev = 0;
+    bool ok = true;
+    for (int ln = 1; fgets(line, sizeof(line), f); ++ln) {
+        char *copy = strdup(line);
+        vdev_cmd_t cmd;
+        int r = copy ? vdev_parse_line(copy, prev, &cmd, err, sizeof(err)) : -1;
+        if (r <= 0) {
+            if (r < 0) {
+                ESP_LOGE(TAG, "%s:%d: %s", path, ln, copy ? err : "sin memoria");
+                ok = false;
+            }
+            free(copy);
+            continue;
+        }
+        sim_step_t *p = realloc(s_steps, sizeof(*p) * (size_t)(s_n_steps + 1));
+        if (!p) {
+            free(copy);
+            ok = false;
+            break;
+        }
+        s_steps = p;
+        s_steps[s_n_steps++] = (sim_step_t){ .cmd = cmd, .line = copy };
+        prev = cmd.at_ms;
+    }
+    fclose(f);
+    return ok;
+}
+
+static void script_apply(const vdev_cmd_t *c)
+{
+    switch (c->op) {
+    case VDEV_OP_GPIO:
+        SIM_OUT("< gpio %d %d", c->pin, c->value);
+        sim_drive_pin(c->pin, c->value);
+        break;
+    case VDEV_OP_ADC:
+        portENTER_CRITICAL(&s_mux);
+        s_adc[c->pin] = c->value;
+        portEXIT_CRITICAL(&s_mux);
+        break;
+    case VDEV_OP_CARD: {
+        if (c->pin >= 0) SIM_OUT("< card@%d %s", c->pin, c->card_on ? "presente" : "retirada");
+        else SIM_OUT("< card %s", c->card_on ? "presente" : "retirada");
+        portENTER_CRITICAL(&s_mux);
+        struct hal_spi *d = spi_slot(c->pin);
+        if (d) vdev_rc522_card(&d->chip, c->card_on ? c->uid : NULL);
+        portEXIT_CRITICAL(&s_mux);
+        break;
+    }
+    case VDEV_OP_MQTT: {
+        SIM_OUT("< mqtt %s %s", c->topic, c->payload);
+        sim_msg_t *m = msg_new(c->topic, c->payload, (int)strlen(c->payload), 0, 0);
+        if (m && xQueueSend(s_mqtt_in, &m, 0) != pdTRUE) free(m);
+        break;
+    }
+    case VDEV_OP_EXIT:
+        SIM_OUT("exit %d", c->value);
+        exit(c->value);
+    }
+}
+
+static void script_task(void *arg)
+{
+    int64_t card_off_ms = -1;
+    for (int i = 0; i < s_n_steps || card_off_ms >= 0; ) {
+        int64_t now = hal_time_us() / 1000;
+        int64_t at = i < s_n_steps ? s_steps[i].cmd.at_ms : INT64_MAX;
+        if (card_off_ms >= 0 && card_off_ms <= now && card_off_ms <= at) {
+            card_off_ms = -1;
+            script_apply(&(vdev_cmd_t){ .op = VDEV_OP_CARD, .card_on = false });
+            continue;
+        }
+        if (at <= now) {
+            const vdev_cmd_t *c = &s_steps[i++].cmd;
+            script_apply(c);
+            if (c->op == VDEV_OP_CARD) card_off_ms = c->card_on && c->value ? c->at_ms + c->value : -1;
+            continue;
+        }
+        int64_t wake = card_off_ms >= 0 && card_off_ms < at ? card_off_ms : at;
+        vTaskDelay(pdMS_TO_TICKS(wake - now) > 0 ? pdMS_TO_TICKS(wake - now) : 1);
+    }
+    ESP_LOGI(TAG, "Guion terminado");
+    vTaskDelete(NULL);
+}
+
+// Primera llamada a la HAL (app_main): reloj, tareas del simulador y guion
+static void sim_start(void)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool first = !s_started;
+    s_started = true;
+    portEXIT_CRITICAL(&s_mux);
+    if (!first) return;
+    s_t0_us = mono_us();
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    s_kv_lock = xSemaphoreCreateMutex();
+    s_tx_lock = xSemaphoreCreateMutex();
+    s_mqtt_out = xQueueCreate(SIM_MQTT_QUEUE, sizeof(sim_msg_t *));
+    s_mqtt_in = xQueueCreate(SIM_MQTT_QUEUE, sizeof(sim_msg_t *));
+    for (int i = 0; i < SIM_SPI_MAX; ++i) vdev_rc522_init(&s_spi[i].chip);
+    xTaskCreate(timer_task, "hal_timer", 4096, NULL, SIM_TIMER_PRIO, &s_timer_task);
+
+    const char *path = getenv("HAL_SCRIPT");
+    if (!path) {
+        ESP_LOGI(TAG, "Sin HAL_SCRIPT: entradas en reposo");
+        return;
+    }
+    if (!script_load(path)) abort();
+    // Lo de t = 0 fija el estado inicial antes de que el firmware lea nada
+    int i = 0;
+    for (; i < s_n_steps && s_steps[i].cmd.at_ms == 0 && s_steps[i].cmd.op <= VDEV_OP_ADC; ++i) {
+        const vdev_cmd_t *c = &s_steps[i].cmd;
+        if (c->op == VDEV_OP_GPIO) {
+            s_pin[c->pin].level = (int8_t)c->value;
+            s_pin[c->pin].driven = true;
+        } else {
+            s_adc[c->pin] = c->value;
+        }
+    }
+    memmove(s_steps, s_steps + i, sizeof(*s_steps) * (size_t)(s_n_steps - i));
+    s_n_steps -= i;
+    ESP_LOGI(TAG, "Guion %s: %d órdenes", path, s_n_steps + i);
+    xTaskCreate(script_task, "hal_script", 4096, NULL, SIM_SCRIPT_PRIO, NULL);
+}
@@ -0,0 +1,329 @@
+#include "hal_vdev.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---- Guion ----
+
+static char *next_word(char **p)
+{
+    char *s = *p;
+    while (*s == ' ' || *s == '\t') s++;
+    if (!*s) return NULL;
+    char *w = s;
+    while (*s && *s != ' ' && *s != '\t') s++;
+    if (*s) *s++ = '\0';
+    *p = s;
+    return w;
+}
+
+static bool parse_int(const char *w, long lo, long hi, int *out)
+{
+    char *end;
+    if (!w) return false;
+    long v = strtol(w, &end, 10);
+    if (*end || end == w || v < lo || v > hi) return false;
+    *out = (int)v;
+    return true;
+}
+
+static int fail(char *err, size_t cap, const char *msg, const char *w)
+{
+    snprintf(err, cap, "%s%s%s", msg, w ? ": " : "", w ? w : "");
+    return -1;
+}
+
+int vdev_parse_line(char *line, int64_t prev_ms, vdev_cmd_t *out, char *err, size_t cap)
+{
+    memset(out, 0, sizeof(*out));
+    line[strcspn(line, "\r\n")] = '\0';
+    char *p = line;
+    char *w = next_word(&p);
+    if (!w || w[0] == '#') return 0;
+
+    // Instante: absoluto o relativo a la orden anterior
+    bool rel = w[0] == '+';
+    char *end;
+    long long t = strtoll(rel ? w + 1 : w, &end, 10);
+    if (*end || end == (rel ? w + 1 : w) || t < 0) return fail(err, cap, "instante no válido", w);
+    out->at_ms = rel ? prev_ms + t : t;
+
+    char *op = next_word(&p);
+    if (!op) return fail(err, cap, "falta la orden", NULL);
+    if (strcmp(op, "mqtt") == 0) {
+        out->op = VDEV_OP_MQTT;
+        out->topic = next_word(&p);
+        if (!out->topic) return fail(err, cap, "mqtt sin topic", NULL);
+        while (*p == ' ' || *p == '\t') p++;
+        out->payload = p; // Hasta fin de línea, con espacios y '#'
+        return 1;
+    }
+    // En el resto, '#' abre un comentario
+    char *hash = strchr(p, '#');
+    if (hash) *hash = '\0';
+    char *a1 = next_word(&p);
+    char *a2 = next_word(&p);
+    if (next_word(&p)) return fail(err, cap, "sobran argumentos", op);
+
+    if (strcmp(op, "gpio") == 0 || strcmp(op, "adc") == 0) {
+        bool gpio = op[0] == 'g';
+        out->op = gpio ? VDEV_OP_GPIO : VDEV_OP_ADC;
+        if (!parse_int(a1, 0, 39, &out->pin)) return fail(err, cap, "pin no válido", a1);
+        if (!parse_int(a2, 0, gpio ? 1 : VDEV_ADC_MAX, &out->value)) return fail(err, cap, "valor no válido", a2);
+        return 1;
+    }
+    if (strcmp(op, "card") == 0 || strncmp(op, "card@", 5) == 0) {
+        out->op = VDEV_OP_CARD;
+        out->pin = -1;
+        if (op[4] && !parse_int(op + 5, 0, 39, &out->pin)) return fail(err, cap, "CS del lector no válido", op);
+        if (a1 && strcmp(a1, "-") == 0 && !a2) return 1;
+        if (!a1 || strlen(a1) != 8) return fail(err, cap, "UID de 4 bytes en hex", a1);
+        for (int i = 0; i < 4; ++i) {
+            char hex[3] = { a1[2 * i], a1[2 * i + 1], '\0' };
+            if (!isxdigit((unsigned char)hex[0]) || !isxdigit((unsigned char)hex[1])) {
+                return fail(err, cap, "UID de 4 bytes en hex", a1);
+            }
+            out->uid[i] = (uint8_t)strtoul(hex, NULL, 16);
+        }
+        if (a2 && !parse_int(a2, 1, 3600000, &out->value)) return fail(err, cap, "duración no válida", a2);
+        out->card_on = true;
+        return 1;
+    }
+    if (strcmp(op, "exit") == 0) {
+        out->op = VDEV_OP_EXIT;
+        if (a2 || (a1 && !parse_int(a1, 0, 255, &out->value))) return fail(err, cap, "código de salida no válido", a1);
+        return 1;
+    }
+    return fail(err, cap, "orden desconocida", op);
+}
+
+// ---- MFRC522 ----
+
+#define R_COMMAND      0x01
+#define R_COMIRQ       0x04
+#define R_ERROR        0x06
+#define R_FIFODATA     0x09
+#define R_FIFOLEVEL    0x0A
+#define R_BITFRAMING   0x0D
+#define R_TXCONTROL    0x14
+#define R_VERSION      0x37
+
+#define CMD_IDLE       0x00
+#define CMD_TRANSCEIVE 0x0C
+#define CMD_SOFTRESET  0x0F
+
+#define IRQ_RX         0x20
+#define IRQ_TIMER      0x01
+
+void vdev_rc522_init(vdev_rc522_t *d)
+{
+    bool card = d->card;
+    uint8_t uid[4];
+    memcpy(uid, d->uid, sizeof(uid));
+    memset(d, 0, sizeof(*d));
+    d->reg[R_TXCONTROL] = 0x80;
+    d->reg[R_VERSION] = VDEV_RC522_VERSION;
+    // El reset del lector no saca la tarjeta del campo
+    d->card = card;
+    memcpy(d->uid, uid, sizeof(uid));
+}
+
+void vdev_rc522_card(vdev_rc522_t *d, const uint8_t *uid4)
+{
+    d->card = uid4 != NULL;
+    if (uid4) memcpy(d->uid, uid4, 4);
+}
+
+static void fifo_put(vdev_rc522_t *d, const uint8_t *p, size_t n)
+{
+    for (size_t i = 0; i < n && d->fifo_n < sizeof(d->fifo); ++i) d->fifo[d->fifo_n++] = p[i];
+}
+
+// StartSend con Transceive: la trama del FIFO sale a la antena
+static void transceive(vdev_rc522_t *d)
+{
+    uint8_t frame[sizeof(d->fifo)];
+    size_t n = d->fifo_n;
+    memcpy(frame, d->fifo, n);
+    d->fifo_n = 0;
+    d->frames++;
+    if (!d->card) {
+        d->reg[R_COMIRQ] |= IRQ_TIMER;
+        return;
+    }
+    if (n == 1 && (frame[0] == 0x26 || frame[0] == 0x52)) {
+        static const uint8_t atqa[2] = { 0x04, 0x00 };
+        fifo_put(d, atqa, sizeof(atqa));
+    } else if (n == 2 && frame[0] == 0x93 && frame[1] == 0x20) {
+        uint8_t r[5] = { d->uid[0], d->uid[1], d->uid[2], d->uid[3],
+                         (uint8_t)(d->uid[0] ^ d->uid[1] ^ d->uid[2] ^ d->uid[3]) };
+        fifo_put(d, r, sizeof(r));
+    } else {
+        d->reg[R_COMIRQ] |= IRQ_TIMER; // Orden no emulada: la tarjeta calla
+        return;
+    }
+    d->answers++;
+    d->reg[R_COMIRQ] |= IRQ_RX;
+}
+
+static uint8_t reg_read(vdev_rc522_t *d, uint8_t r)
+{
+    switch (r) {
+    case R_FIFODATA: {
+        if (d->fifo_n == 0) return 0;
+        uint8_t v = d->fifo[0];
+        memmove(d->fifo, d->fifo + 1, --d->fifo_n);
+        return v;
+    }
+    case R_FIFOLEVEL:
+        return d->fifo_n;
+    case R_ERROR:
+        return 0;
+    default:
+        return d->reg[r];
+    }
+}
+
+static void reg_write(vdev_rc522_t *d, uint8_t r, uint8_t v)
+{
+    switch (r) {
+    case R_FIFODATA:
+        fifo_put(d, &v, 1);
+        break;
+    case R_FIFOLEVEL:
+        if (v & 0x80) d->fifo_n = 0; // FlushBuffer
+        break;
+    case R_COMIRQ:
+        // Set1 (bit 7) decide si los bits marcados se activan o se borran
+        if (v & 0x80) d->reg[r] |= v & 0x7F;
+        else d->reg[r] &= (uint8_t)~v;
+        break;
+    case R_COMMAND:
+        if ((v & 0x0F) == CMD_SOFTRESET) {
+            uint32_t frames = d->frames, answers = d->answers; // Contadores del host, no del chip
+            vdev_rc522_init(d);
+            d->frames = frames;
+            d->answers = answers;
+        } else {
+            d->reg[r] = v & 0x1F; // PowerDown (bit 4): despierta al instante
+        }
+        break;
+    case R_BITFRAMING:
+        d->reg[r] = v & 0x7F; // StartSend se lee a 0 tras arrancar
+        if ((v & 0x80) && d->reg[R_COMMAND] == CMD_TRANSCEIVE) transceive(d);
+        break;
+    case R_VERSION:
+        break;
+    default:
+        d->reg[r] = v;
+        break;
+    }
+}
+
+void vdev_rc522_xfer(vdev_rc522_t *d, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+    if (len == 0) return;
+    // Primer byte: bit 7 lectura, bits 6..1 registro
+    bool read = tx[0] & 0x80;
+    uint8_t r = (tx[0] >> 1) & 0x3F;
+    if (rx) rx[0] = 0;
+    for (size_t i = 1; i < len; ++i) {
+        if (read) {
+            uint8_t v = reg_read(d, r);
+            if (rx) rx[i] = v;
+            r = (tx[i] >> 1) & 0x3F; // En lecturas, cada byte trae la dirección siguiente
+        } else {
+            reg_write(d, r, tx[i]); // En escrituras, ráfaga al mismo registro
+        }
+    }
+}
+
+// ---- Clave-valor ----
+
+static vdev_kv_entry_t *kv_find(const vdev_kv_t *kv, const char *key)
+{
+    for (int i = 0; i < kv->n; ++i) {
+        if (strcmp(kv->e[i].key, key) == 0) return (vdev_kv_entry_t *)&kv->e[i];
+    }
+    return NULL;
+}
+
+static vdev_kv_entry_t *kv_slot(vdev_kv_t *kv, const char *key)
+{
+    if (!key || !key[0] || strlen(key) > VDEV_KV_KEY_MAX || strpbrk(key, " \t\r\n")) return NULL;
+    vdev_kv_entry_t *e = kv_find(kv, key);
+    if (e || kv->n == VDEV_KV_MAX) return e;
+    e = &kv->e[kv->n++];
+    memset(e, 0, sizeof(*e));
+    strcpy(e->key, key);
+    return e;
+}
+
+bool vdev_kv_get_i32(const vdev_kv_t *kv, const char *key, int32_t *out)
+{
+    const vdev_kv_entry_t *e = kv_find(kv, key);
+    if (!e || e->is_str) return false;
+    *out = e->i32;
+    return true;
+}
+
+bool vdev_kv_set_i32(vdev_kv_t *kv, const char *key, int32_t v)
+{
+    vdev_kv_entry_t *e = kv_slot(kv, key);
+    if (!e) return false;
+    e->is_str = false;
+    e->i32 = v;
+    return true;
+}
+
+bool vdev_kv_get_str(const vdev_kv_t *kv, const char *key, char *out, size_t cap)
+{
+    const vdev_kv_entry_t *e = kv_find(kv, key);
+    if (!e || !e->is_str || strlen(e->str) >= cap) return false;
+    strcpy(out, e->str);
+    return true;
+}
+
+bool vdev_kv_set_str(vdev_kv_t *kv, const char *key, const char *v)
+{
+    // Una línea por clave: sin saltos de línea en el valor
+    if (strlen(v) > VDEV_KV_STR_MAX || strpbrk(v, "\r\n")) return false;
+    vdev_kv_entry_t *e = kv_slot(kv, key);
+    if (!e) return false;
+    e->is_str = true;
+    strcpy(e->str, v);
+    return true;
+}
+
+int vdev_kv_load(vdev_kv_t *kv, FILE *f)
+{
+    char line[VDEV_KV_KEY_MAX + VDEV_KV_STR_MAX + 8];
+    int loaded = 0;
+    kv->n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line + 2;
+        char *key = next_word(&p);
+        if (!key || line[1] != ' ') continue;
+        bool ok = false;
+        if (line[0] == 'i') {
+            char *end;
+            long v = strtol(p, &end, 10);
+            ok = end != p && !*end && vdev_kv_set_i32(kv, key, (int32_t)v);
+        } else if (line[0] == 's') {
+            ok = vdev_kv_set_str(kv, key, p);
+        }
+        if (ok) loaded++;
+    }
+    return loaded;
+}
+
+bool vdev_kv_save(const vdev_kv_t *kv, FILE *f)
+{
+    for (int i = 0; i < kv->n; ++i) {
+        const vdev_kv_entry_t *e = &kv->e[i];
+        int n = e->is_str ? fprintf(f, "s %s %s\n", e->key, e->str) : fprintf(f, "i %s %ld\n", e->key, (long)e->i32);
+        if (n < 0) return false;
+    }
+    return fflush(f) == 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Dispositivos virtuales del backend Linux de la HAL (hal_linux.c): el
+// guion de sensores, un MFRC522 a nivel de registros y el almacén
+// clave-valor en un archivo de texto.
+//
+// Guion (HAL_SCRIPT), una orden por línea; '#' comenta hasta el final:
+//   <t> gpio <pin> <0|1>          nivel de una entrada (reed: 0 cerrada)
+//   <t> adc <pin> <0..4095>       lectura del ADC (potenciómetro)
+//   <t> card <UID> [ms]           tarjeta de 4 bytes en hex (EAE8D284);
+//                                 con ms se retira sola; "card -" la retira
+//   <t> card@<cs> ...             igual, en el lector con ese CS (varias puertas);
+//                                 sin @, en el primero
+//   <t> mqtt <topic> <payload>    mensaje entrante (payload hasta fin de línea)
+//   <t> exit [código]             termina el proceso
+// t: ms desde el arranque, o "+ms" tras la orden anterior.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/hal_check).
+
+#define VDEV_LINE_MAX    1024
+#define VDEV_ADC_MAX     4095
+
+typedef enum {
+    VDEV_OP_GPIO = 0,
+    VDEV_OP_ADC,
+    VDEV_OP_CARD,
+    VDEV_OP_MQTT,
+    VDEV_OP_EXIT,
+} vdev_op_t;
+
+typedef struct {
+    int64_t at_ms;
+    vdev_op_t op;
+    int pin;                 // VDEV_OP_CARD: CS del lector (-1: el primero)
+    int value;               // Nivel, cuentas ADC, ms de la tarjeta (0: sin límite) o código de salida
+    bool card_on;            // VDEV_OP_CARD: false retira la tarjeta
+    uint8_t uid[4];
+    const char *topic;       // VDEV_OP_MQTT: apuntan dentro de la línea
+    const char *payload;
+} vdev_cmd_t;
+
+// Interpreta una línea (la modifica: termina topic y payload). prev_ms es el
+// instante de la orden anterior. 1: orden en *out; 0: vacía o comentario;
+// -1: error, descrito en err
+int vdev_parse_line(char *line, int64_t prev_ms, vdev_cmd_t *out, char *err, size_t cap);
+
+// ---- MFRC522 virtual ----
+// Registros, FIFO e interrupciones lo justo para mfrc522_min.c: REQA/WUPA
+// contesta ATQA y la anticolisión de nivel 1 devuelve UID + BCC. Sin
+// tarjeta no hay respuesta (RxIRq nunca llega, como con el chip real)
+
+#define VDEV_RC522_VERSION 0x92
+
+typedef struct {
+    uint8_t reg[64];
+    uint8_t fifo[64];
+    uint8_t fifo_n;
+    bool card;
+    uint8_t uid[4];
+    uint32_t frames;         // Tramas enviadas a la antena
+    uint32_t answers;        // Respondidas por la tarjeta
+} vdev_rc522_t;
+
+void vdev_rc522_init(vdev_rc522_t *d);
+void vdev_rc522_card(vdev_rc522_t *d, const uint8_t *uid4);   // NULL: retirar
+// Transacción SPI tal y como la ve el chip (dirección y datos)
+void vdev_rc522_xfer(vdev_rc522_t *d, const uint8_t *tx, uint8_t *rx, size_t len);
+
+// ---- Almacén clave-valor (sustituto de NVS) ----
+// Archivo de texto, una clave por línea: "i <clave> <entero>" o "s <clave> <texto>"
+
+#define VDEV_KV_MAX      32
+#define VDEV_KV_KEY_MAX  15   // Como NVS
+#define VDEV_KV_STR_MAX  127
+
+typedef struct {
+    char key[VDEV_KV_KEY_MAX + 1];
+    bool is_str;
+    int32_t i32;
+    char str[VDEV_KV_STR_MAX + 1];
+} vdev_kv_entry_t;
+
+typedef struct {
+    vdev_kv_entry_t e[VDEV_KV_MAX];
+    int n;
+} vdev_kv_t;
+
+// Cargar ignora líneas mal formadas; devuelve las claves leídas
+int vdev_kv_load(vdev_kv_t *kv, FILE *f);
+bool vdev_kv_save(const vdev_kv_t *kv, FILE *f);
+// Las lecturas fallan si la clave no existe o es de otro tipo
+bool vdev_kv_get_i32(const vdev_kv_t *kv, const char *key, int32_t *out);
+bool vdev_kv_set_i32(vdev_kv_t *kv, const char *key, int32_t v);
+bool vdev_kv_get_str(const vdev_kv_t *kv, const char *key, char *out, size_t cap);
+bool vdev_kv_set_str(vdev_kv_t *kv, const char *key, const char *v);
+
+#ifdef __cplusplus
+}
+#endif
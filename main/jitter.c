@@ -0,0 +1,53 @@
+#include "jitter.h"
+#include <stdio.h>
+#include <string.h>
+
+// Límite superior (exclusivo) de cada cubo; el último recoge el resto
+static const int64_t BOUND_US[JITTER_BUCKETS - 1] = { 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000 };
+
+void jitter_init(jitter_t *j)
+{
+    memset(j, 0, sizeof(*j));
+}
+
+void jitter_add(jitter_t *j, int64_t late_us)
+{
+    if (late_us < 0) late_us = 0;
+    int b = 0;
+    while (b < JITTER_BUCKETS - 1 && late_us >= BOUND_US[b]) b++;
+    j->hist[b]++;
+    j->n++;
+    j->sum_us += late_us;
+    if (late_us > j->max_us) j->max_us = late_us;
+}
+
+void jitter_wake(jitter_t *j, int64_t now_us, uint32_t wake_tick, uint32_t tick_us)
+{
+    int64_t off = now_us - (int64_t)wake_tick * tick_us;
+    if (!j->anchored || off < j->offset_us) {
+        j->offset_us = off;
+        j->anchored = true;
+    }
+    jitter_add(j, off - j->offset_us);
+}
+
+int64_t jitter_pct_us(const jitter_t *j, double p)
+{
+    if (!j->n) return 0;
+    uint32_t want = (uint32_t)(p * j->n + 0.999999);
+    if (want < 1) want = 1;
+    uint32_t acc = 0;
+    for (int b = 0; b < JITTER_BUCKETS - 1; ++b) {
+        acc += j->hist[b];
+        if (acc >= want) return BOUND_US[b] < j->max_us ? BOUND_US[b] : j->max_us;
+    }
+    return j->max_us;
+}
+
+size_t jitter_json(const jitter_t *j, char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "{\"n\":%u,\"p50_us\":%lld,\"p99_us\":%lld,\"max_us\":%lld,\"mean_us\":%lld}",
+                     (unsigned)j->n, (long long)jitter_pct_us(j, 0.50), (long long)jitter_pct_us(j, 0.99),
+                     (long long)j->max_us, (long long)(j->n ? j->sum_us / j->n : 0));
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
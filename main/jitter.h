@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Retraso de despertar de una tarea: cuánto tarda en ejecutarse desde que
+// debía hacerlo. Periódicas: desde el tick en que vence su espera; por
+// eventos: desde que se publicó el evento. Histograma por órdenes de
+// magnitud (percentiles con la resolución de un cubo), máximo y media.
+//
+// El instante de un tick no se conoce en microsegundos: jitter_wake() toma
+// como origen el despertar más temprano observado respecto a la cuenta de
+// ticks (el desfase del tick de ese núcleo), así que los primeros despertares
+// pueden sobrestimarse hasta que aparece uno puntual.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/jitter_sim).
+
+#define JITTER_BUCKETS 12
+
+typedef struct {
+    uint32_t n;
+    uint32_t hist[JITTER_BUCKETS];
+    int64_t sum_us, max_us;
+    int64_t offset_us;       // Despertar más temprano menos su tick en us
+    bool anchored;
+} jitter_t;
+
+void jitter_init(jitter_t *j);
+// Despertar en now_us de una espera que vencía en el tick wake_tick
+void jitter_wake(jitter_t *j, int64_t now_us, uint32_t wake_tick, uint32_t tick_us);
+// Retraso medido directamente (evento publicado en t, atendido en t + late_us)
+void jitter_add(jitter_t *j, int64_t late_us);
+// Cota superior del cubo que contiene el percentil p (0..1); 0 sin muestras
+int64_t jitter_pct_us(const jitter_t *j, double p);
+// {"n":..,"p50_us":..,"p99_us":..,"max_us":..,"mean_us":..}; bytes escritos (0 si no cabe)
+size_t jitter_json(const jitter_t *j, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
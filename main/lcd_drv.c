@@ -0,0 +1,85 @@
+#include "lcd_drv.h"
+#include <stdio.h>
+
+void lcd_drv_setup(lcd_drv_t *d, const lcd_port_t *port, uint8_t addr, int variant, uint32_t i2c_hz)
+{
+    d->port = *port;
+    d->addr = addr;
+    lcd_xfer_init(&d->x, &lcd_pinmaps[variant], i2c_hz);
+    lcd_shadow_invalidate(&d->shadow);
+    d->txns = d->bytes = d->errors = 0;
+}
+
+bool lcd_drv_flush(lcd_drv_t *d)
+{
+    if (d->x.len == 0) return true;
+    bool ok = d->port.write(d->port.ctx, d->addr, d->x.buf, d->x.len);
+    d->txns++;
+    d->bytes += d->x.len;
+    if (!ok) d->errors++;
+    lcd_xfer_reset(&d->x);
+    return ok;
+}
+
+// Encolan en d->x; si no cabe, sale lo acumulado primero
+static bool put_cmd(lcd_drv_t *d, uint8_t cmd)
+{
+    if (lcd_xfer_cmd(&d->x, cmd)) return true;
+    return lcd_drv_flush(d) && lcd_xfer_cmd(&d->x, cmd);
+}
+
+static bool put_line(lcd_drv_t *d, uint8_t row, const char *s)
+{
+    if (!put_cmd(d, LCD_CMD_SET_DDRAM | lcd_ddram_addr(0, row))) return false;
+    size_t n = 0;
+    while (n < LCD_COLS && s[n]) ++n;
+    for (size_t done = 0; done < n; ) {
+        done += lcd_xfer_text(&d->x, s + done, n - done);
+        if (done < n && !lcd_drv_flush(d)) return false;
+    }
+    return true;
+}
+
+bool lcd_drv_init(lcd_drv_t *d)
+{
+    lcd_xfer_reset(&d->x);
+    lcd_xfer_hd44780_init(&d->x);
+    bool ok = lcd_drv_flush(d);
+    if (ok) lcd_shadow_reset(&d->shadow);
+    return ok;
+}
+
+bool lcd_drv_show_raw(lcd_drv_t *d, const char *l1, const char *l2)
+{
+    bool ok = put_cmd(d, LCD_CMD_CLEAR) && put_cmd(d, LCD_CMD_HOME)  // HOME para garantizar cursor en 0
+           && put_line(d, 0, l1 ? l1 : "") && put_line(d, 1, l2 ? l2 : "")
+           && lcd_drv_flush(d);
+    lcd_shadow_invalidate(&d->shadow); // Escrito sin sombra: el siguiente render va entero
+    return ok;
+}
+
+size_t lcd_drv_render(lcd_drv_t *d, const char *l1, const char *l2)
+{
+    char frame[LCD_ROWS][LCD_COLS];
+    lcd_op_t ops[LCD_OPS_MAX];
+    lcd_frame_from_lines(frame, l1, l2);
+    size_t n = lcd_frame_diff(&d->shadow, frame, ops, LCD_OPS_MAX);
+    // Un cuadro completo cabe en LCD_XFER_MAX: una sola escritura I2C
+    for (size_t done = 0; done < n; ) {
+        done += lcd_xfer_ops(&d->x, ops + done, n - done);
+        if (!lcd_drv_flush(d)) {
+            // Lo que muestre la pantalla ya no es seguro
+            lcd_shadow_invalidate(&d->shadow);
+            break;
+        }
+    }
+    return n;
+}
+
+bool lcd_drv_probe_show(lcd_drv_t *d, const lcd_port_t *port, uint8_t addr, int variant, uint32_t i2c_hz)
+{
+    lcd_drv_setup(d, port, addr, variant, i2c_hz);
+    char l1[LCD_COLS + 1];
+    snprintf(l1, sizeof(l1), "ADDR %02X VAR %d", addr, variant);
+    return lcd_drv_init(d) && lcd_drv_show_raw(d, l1, "HELLO 1602");
+}
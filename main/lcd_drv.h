@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lcd_frame.h"
+#include "lcd_xfer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Driver del LCD1602 sobre un PCF8574, independiente del bus: todo lo que
+// hace main.c con la pantalla (inicialización, patrón de diagnóstico,
+// render diferencial, auto-probe) pasa por aquí y acaba en port.write, una
+// escritura I2C completa por llamada. En el firmware port.write es el
+// driver i2c_master asíncrono; en host, el emulador de tools/lcd_emu.
+//
+// Sin esperas propias: las del HD44780 van como relleno en el bus
+// (lcd_xfer.h). Solo el encendido (>= 40 ms de alimentación antes del
+// primer byte) queda a cargo del llamador.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/lcd_emu).
+
+typedef struct {
+    // Una transacción: START, addr, len bytes, STOP. true si el PCF8574
+    // respondió y terminó
+    bool (*write)(void *ctx, uint8_t addr, const uint8_t *buf, size_t len);
+    void *ctx;
+} lcd_port_t;
+
+typedef struct {
+    lcd_port_t port;
+    uint8_t addr;
+    lcd_xfer_t x;
+    lcd_shadow_t shadow;
+    // Estadística
+    uint32_t txns;           // Transacciones I2C
+    uint32_t bytes;          // Bytes de datos (sin dirección)
+    uint32_t errors;         // Transacciones fallidas
+} lcd_drv_t;
+
+// Sin E/S: fija bus, dirección y mapeo de pines (0..LCD_PINMAP_VARIANTS-1)
+void lcd_drv_setup(lcd_drv_t *d, const lcd_port_t *port, uint8_t addr, int variant, uint32_t i2c_hz);
+// Envía lo acumulado en d->x (si hay algo)
+bool lcd_drv_flush(lcd_drv_t *d);
+
+// Inicialización en 4 bits; deja la pantalla en blanco y la sombra al día
+bool lcd_drv_init(lcd_drv_t *d);
+// Borra y escribe dos líneas sin pasar por la sombra (diagnóstico, probe)
+bool lcd_drv_show_raw(lcd_drv_t *d, const char *l1, const char *l2);
+// Render diferencial (lcd_frame.h); devuelve las operaciones HD44780
+// enviadas (0 = nada cambió)
+size_t lcd_drv_render(lcd_drv_t *d, const char *l1, const char *l2);
+
+// Un paso del auto-probe: init y "ADDR xx VAR v" / "HELLO 1602" con el
+// mapeo de la variante, sobre un lcd_drv_t de trabajo
+bool lcd_drv_probe_show(lcd_drv_t *d, const lcd_port_t *port, uint8_t addr, int variant, uint32_t i2c_hz);
+
+#ifdef __cplusplus
+}
+#endif
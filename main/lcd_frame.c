@@ -0,0 +1,64 @@
+#include "lcd_frame.h"
+#include <string.h>
+
+void lcd_shadow_reset(lcd_shadow_t *sh)
+{
+    memset(sh->cell, ' ', sizeof(sh->cell));
+    sh->valid = true;
+    sh->cursor = 0;
+}
+
+void lcd_shadow_invalidate(lcd_shadow_t *sh)
+{
+    sh->valid = false;
+    sh->cursor = -1;
+}
+
+void lcd_frame_from_lines(char frame[LCD_ROWS][LCD_COLS], const char *l1, const char *l2)
+{
+    const char *src[LCD_ROWS] = { l1 ? l1 : "", l2 ? l2 : "" };
+    for (int r = 0; r < LCD_ROWS; ++r) {
+        size_t n = 0;
+        while (n < LCD_COLS && src[r][n]) ++n;
+        memcpy(frame[r], src[r], n);
+        memset(frame[r] + n, ' ', LCD_COLS - n);
+    }
+}
+
+static bool differs(const lcd_shadow_t *sh, const char frame[LCD_ROWS][LCD_COLS], int r, int c)
+{
+    return !sh->valid || sh->cell[r][c] != frame[r][c];
+}
+
+size_t lcd_frame_diff(lcd_shadow_t *sh, const char frame[LCD_ROWS][LCD_COLS], lcd_op_t *ops, size_t cap)
+{
+    size_t n = 0;
+    for (int r = 0; r < LCD_ROWS; ++r) {
+        int c = 0;
+        while (c < LCD_COLS) {
+            if (!differs(sh, frame, r, c)) { ++c; continue; }
+            // Tramo [c, end]: absorbe huecos de un solo carácter igual
+            int end = c;
+            for (int j = c + 1; j < LCD_COLS; ++j) {
+                if (differs(sh, frame, r, j)) end = j;
+                else if (j + 1 < LCD_COLS && differs(sh, frame, r, j + 1)) continue;
+                else break;
+            }
+            uint8_t addr = lcd_ddram_addr((uint8_t)c, (uint8_t)r);
+            if (sh->cursor != addr) {
+                if (n >= cap) return n;
+                ops[n++] = (lcd_op_t){ LCD_OP_CMD, (uint8_t)(LCD_CMD_SET_DDRAM | addr) };
+            }
+            for (int j = c; j <= end; ++j) {
+                if (n >= cap) return n;
+                ops[n++] = (lcd_op_t){ LCD_OP_DATA, (uint8_t)frame[r][j] };
+                sh->cell[r][j] = frame[r][j];
+            }
+            sh->cursor = (int16_t)(addr + (end - c + 1));
+            c = end + 1;
+        }
+    }
+    // Sin contenido previo fiable se escribió todo: la sombra ya es exacta
+    sh->valid = true;
+    return n;
+}
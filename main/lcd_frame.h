@@ -0,0 +1,68 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Render diferencial del LCD1602: una sombra de 2x16 guarda lo que muestra
+// la pantalla y cada cuadro nuevo se compara con ella. Solo salen los
+// caracteres distintos y los movimientos de cursor imprescindibles (el
+// HD44780 avanza solo tras cada dato, modo 0x06); nunca 0x01 (clear, 1,5 ms
+// de ejecución y reescritura de los 32 caracteres).
+//
+// Huecos: entre dos tramos cambiados separados por un solo carácter igual
+// se reescribe ese carácter; cuesta lo mismo que un 0x80|dir y deja el
+// cursor donde hace falta.
+//
+// Módulo sin dependencias de ESP-IDF: las operaciones las ejecuta el driver
+// de main.c (lcd_cmd/lcd_data) y las mide tools/lcd_bench en host.
+
+#define LCD_COLS      16
+#define LCD_ROWS      2
+#define LCD_OPS_MAX   (LCD_ROWS * (LCD_COLS + 1))   // Peor caso: todo, un cursor por fila
+
+#define LCD_CMD_CLEAR     0x01
+#define LCD_CMD_HOME      0x02
+#define LCD_CMD_SET_DDRAM 0x80
+
+typedef enum {
+    LCD_OP_CMD = 0,          // Instrucción (RS=0)
+    LCD_OP_DATA,             // Carácter (RS=1)
+} lcd_op_kind_t;
+
+typedef struct {
+    uint8_t kind;            // lcd_op_kind_t
+    uint8_t val;
+} lcd_op_t;
+
+typedef struct {
+    char cell[LCD_ROWS][LCD_COLS];
+    bool valid;              // false: contenido desconocido (tras un patrón directo)
+    int16_t cursor;          // Dirección DDRAM del cursor; -1 = desconocida
+} lcd_shadow_t;
+
+// Estado tras lcd_init()/lcd_clear(): pantalla en blanco, cursor en 0
+void lcd_shadow_reset(lcd_shadow_t *sh);
+// Alguien escribió sin pasar por la sombra: el siguiente cuadro va entero
+void lcd_shadow_invalidate(lcd_shadow_t *sh);
+
+// Cuadro a partir de dos líneas (se rellenan con espacios o se recortan)
+void lcd_frame_from_lines(char frame[LCD_ROWS][LCD_COLS], const char *l1, const char *l2);
+
+// Operaciones que llevan la pantalla de la sombra al cuadro (cap >=
+// LCD_OPS_MAX); actualiza la sombra como si se hubieran ejecutado. Devuelve
+// cuántas hay (0 = nada que hacer)
+size_t lcd_frame_diff(lcd_shadow_t *sh, const char frame[LCD_ROWS][LCD_COLS], lcd_op_t *ops, size_t cap);
+
+// Dirección DDRAM de (col, fila) en un 1602
+static inline uint8_t lcd_ddram_addr(uint8_t col, uint8_t row)
+{
+    return (uint8_t)((row ? 0x40 : 0x00) + col);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,124 @@
+#include "lcd_queue.h"
+#include <stdio.h>
+#include <string.h>
+
+void lcd_queue_init(lcd_queue_t *q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+static lcd_req_t *find_key(lcd_queue_t *q, uint8_t key)
+{
+    for (int i = 0; i < LCD_QUEUE_MAX; ++i) {
+        if (q->req[i].used && q->req[i].key == key) return &q->req[i];
+    }
+    return NULL;
+}
+
+static lcd_req_t *find_shown(lcd_queue_t *q)
+{
+    if (q->shown_seq == 0) return NULL;
+    for (int i = 0; i < LCD_QUEUE_MAX; ++i) {
+        if (q->req[i].used && q->req[i].seq == q->shown_seq) return &q->req[i];
+    }
+    return NULL;
+}
+
+// a precede a b en la cola (mayor prioridad; a igualdad, más reciente)
+static bool before(const lcd_req_t *a, const lcd_req_t *b)
+{
+    if (a->prio != b->prio) return a->prio > b->prio;
+    return a->seq > b->seq;
+}
+
+static bool in_min(const lcd_req_t *r, int64_t now_us)
+{
+    return r->shown_us >= 0 && now_us < r->shown_us + (int64_t)r->min_ms * 1000;
+}
+
+bool lcd_queue_post(lcd_queue_t *q, uint8_t key, uint8_t prio, uint32_t min_ms, uint32_t ttl_ms,
+                    const char *l1, const char *l2, int64_t now_us)
+{
+    lcd_req_t *r = find_key(q, key);
+    if (r) {
+        q->replaced++;
+    } else {
+        for (int i = 0; i < LCD_QUEUE_MAX && !r; ++i) {
+            if (!q->req[i].used) r = &q->req[i];
+        }
+    }
+    if (!r) {
+        // Llena: la peor (la última en orden) deja sitio si la nueva es
+        // mejor; lo que no caduca (el fondo) no se expulsa
+        lcd_req_t *worst = NULL;
+        for (int i = 0; i < LCD_QUEUE_MAX; ++i) {
+            if (q->req[i].expires_us == LCD_QUEUE_NEVER) continue;
+            if (!worst || before(worst, &q->req[i])) worst = &q->req[i];
+        }
+        if (!worst || worst->prio >= prio) return false;
+        q->evicted++;
+        r = worst;
+    }
+    r->used = true;
+    r->key = key;
+    r->prio = prio;
+    r->min_ms = min_ms;
+    r->seq = ++q->seq;
+    r->expires_us = ttl_ms ? now_us + (int64_t)ttl_ms * 1000 : LCD_QUEUE_NEVER;
+    r->shown_us = -1;
+    snprintf(r->l1, sizeof(r->l1), "%s", l1 ? l1 : "");
+    snprintf(r->l2, sizeof(r->l2), "%s", l2 ? l2 : "");
+    q->posted++;
+
+    // Solo una de menor prioridad que la cima no la mueve (ni arma plazos)
+    const lcd_req_t *top = find_shown(q);
+    return !top || top == r || prio >= top->prio;
+}
+
+bool lcd_queue_cancel(lcd_queue_t *q, uint8_t key)
+{
+    lcd_req_t *r = find_key(q, key);
+    if (!r) return false;
+    bool shown = r->seq == q->shown_seq;
+    r->used = false;
+    return shown;
+}
+
+const lcd_req_t *lcd_queue_compose(lcd_queue_t *q, int64_t now_us, int64_t *next_us)
+{
+    q->composed++;
+    lcd_req_t *best = NULL;
+    for (int i = 0; i < LCD_QUEUE_MAX; ++i) {
+        lcd_req_t *r = &q->req[i];
+        if (!r->used) continue;
+        if (r->expires_us <= now_us) {
+            r->used = false;
+            q->expired++;
+            continue;
+        }
+        if (!best || before(r, best)) best = r;
+    }
+
+    *next_us = LCD_QUEUE_NEVER;
+    lcd_req_t *cur = find_shown(q);
+    lcd_req_t *top = best;
+    if (cur && best && cur != best && in_min(cur, now_us)) {
+        if (best->prio <= cur->prio) {
+            // Espera a que la actual cumpla su mínimo
+            top = cur;
+            *next_us = cur->shown_us + (int64_t)cur->min_ms * 1000;
+        } else {
+            q->preempted++;
+        }
+    }
+    if (!top) {
+        q->shown_seq = 0;
+        return NULL;
+    }
+    if (top->seq != q->shown_seq) {
+        top->shown_us = now_us;
+        q->shown_seq = top->seq;
+    }
+    if (top->expires_us < *next_us) *next_us = top->expires_us;
+    return top;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lcd_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cola de peticiones de pantalla para el LCD1602. Quien escribe (pot_task,
+// rfid_task, control_task) publica una petición con clave, prioridad, tiempo
+// mínimo en pantalla y caducidad (TTL); el compositor (lcd_task) decide qué
+// se ve. Así un "ACCESS DENIED!" no lo pisa el progreso del potenciómetro
+// 100 ms después, y la vuelta a la bienvenida o el fin de "LOCKING..." son
+// caducidades, no marcas de tiempo sueltas.
+//
+// Reglas:
+//  - Una petición con la misma clave que otra la sustituye (el progreso
+//    nuevo reemplaza al viejo al instante, aunque este no haya cumplido su
+//    mínimo).
+//  - Se muestra la de mayor prioridad; a igualdad, la más reciente.
+//  - La que está en pantalla sigue mientras no cumpla su mínimo, salvo que
+//    llegue otra de prioridad estrictamente mayor.
+//  - Al caducar se descarta y aparece lo que haya debajo. ttl 0: no caduca
+//    (la bienvenida, siempre en el fondo).
+//
+// El compositor solo necesita despertar cuando cambia la cima: al publicar
+// algo que puede desplazarla (lcd_queue_post devuelve true) y en el plazo
+// que devuelve lcd_queue_compose (caducidad de la cima o fin de su mínimo
+// si hay otra esperando). Las caducidades ocultas se limpian de paso.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/lcd_queue_check).
+// Sin sincronización: en el firmware va bajo g_lcd_mutex.
+
+#define LCD_QUEUE_MAX  6
+#define LCD_QUEUE_NEVER INT64_MAX
+
+typedef struct {
+    char l1[LCD_COLS + 1];
+    char l2[LCD_COLS + 1];
+    uint8_t key;
+    uint8_t prio;
+    bool used;
+    uint32_t seq;            // Orden de publicación (0 = nunca)
+    uint32_t min_ms;
+    int64_t expires_us;      // LCD_QUEUE_NEVER si ttl 0
+    int64_t shown_us;        // -1 = aún no mostrada
+} lcd_req_t;
+
+typedef struct {
+    lcd_req_t req[LCD_QUEUE_MAX];
+    uint32_t seq;
+    uint32_t shown_seq;      // Petición en pantalla (0 = ninguna)
+    // Estadística
+    uint32_t posted;
+    uint32_t replaced;       // Sustituidas por otra con la misma clave
+    uint32_t expired;
+    uint32_t evicted;        // Expulsadas por cola llena
+    uint32_t preempted;      // Quitadas de pantalla antes de su mínimo
+    uint32_t composed;       // Llamadas al compositor
+} lcd_queue_t;
+
+void lcd_queue_init(lcd_queue_t *q);
+
+// Publica (o sustituye la de la misma clave). Con la cola llena expulsa la
+// de menor prioridad y más antigua que caduque si es peor que la nueva; si
+// no, descarta la nueva. Devuelve true si la cima puede cambiar (hay que
+// despertar al compositor)
+bool lcd_queue_post(lcd_queue_t *q, uint8_t key, uint8_t prio, uint32_t min_ms, uint32_t ttl_ms,
+                    const char *l1, const char *l2, int64_t now_us);
+// Retira la petición de esa clave; true si estaba en pantalla
+bool lcd_queue_cancel(lcd_queue_t *q, uint8_t key);
+
+// Compositor: descarta lo caducado y elige la cima. Devuelve la petición a
+// mostrar (NULL si la cola está vacía) y en *next_us cuándo volver a llamar
+// (LCD_QUEUE_NEVER = solo al publicar)
+const lcd_req_t *lcd_queue_compose(lcd_queue_t *q, int64_t now_us, int64_t *next_us);
+
+#ifdef __cplusplus
+}
+#endif
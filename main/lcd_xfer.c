@@ -0,0 +1,139 @@
+#include "lcd_xfer.h"
+
+const lcd_pinmap_t lcd_pinmaps[LCD_PINMAP_VARIANTS] = {
+    //  RS    RW    EN    BL     D4    D5    D6    D7
+    { 0x01, 0x02, 0x04, 0x08, { 0x10, 0x20, 0x40, 0x80 } },
+    { 0x80, 0x40, 0x20, 0x10, { 0x01, 0x02, 0x04, 0x08 } },
+    { 0x40, 0x20, 0x10, 0x80, { 0x01, 0x02, 0x04, 0x08 } },
+    { 0x01, 0x02, 0x04, 0x08, { 0x80, 0x40, 0x20, 0x10 } },
+    { 0x80, 0x40, 0x20, 0x10, { 0x08, 0x04, 0x02, 0x01 } },
+    { 0x40, 0x20, 0x10, 0x80, { 0x08, 0x04, 0x02, 0x01 } },
+};
+
+uint8_t lcd_pinmap_pack(const lcd_pinmap_t *pm, uint8_t hi_nibble, bool rs)
+{
+    uint8_t v = pm->bl | (rs ? pm->rs : 0);
+    for (int i = 0; i < 4; ++i) {
+        if (hi_nibble & (0x10u << i)) v |= pm->d[i];
+    }
+    return v;
+}
+
+void lcd_xfer_init(lcd_xfer_t *x, const lcd_pinmap_t *pm, uint32_t i2c_hz)
+{
+    x->pm = pm;
+    x->byte_ns = (uint32_t)((9000000000ull + i2c_hz - 1) / i2c_hz);
+    x->len = 0;
+    x->idle = lcd_pinmap_pack(pm, 0, false);
+}
+
+static size_t room(const lcd_xfer_t *x)
+{
+    return LCD_XFER_MAX - x->len;
+}
+
+static void put_nibble(lcd_xfer_t *x, uint8_t hi_nibble, bool rs)
+{
+    // El HD44780 captura en el flanco de bajada de EN; cada byte dura
+    // byte_ns, que ya cubre preparación y ancho de pulso
+    uint8_t v = lcd_pinmap_pack(x->pm, hi_nibble, rs);
+    x->buf[x->len++] = v;
+    x->buf[x->len++] = v | x->pm->en;
+    x->buf[x->len++] = v;
+    x->idle = v;
+}
+
+static uint32_t fill_count(const lcd_xfer_t *x, uint32_t us)
+{
+    return (uint32_t)(((uint64_t)us * 1000 + x->byte_ns - 1) / x->byte_ns);
+}
+
+bool lcd_xfer_nibble(lcd_xfer_t *x, uint8_t hi_nibble, bool rs)
+{
+    if (room(x) < 3) return false;
+    put_nibble(x, hi_nibble, rs);
+    return true;
+}
+
+bool lcd_xfer_wait_us(lcd_xfer_t *x, uint32_t us)
+{
+    uint32_t n = fill_count(x, us);
+    if (room(x) < n) return false;
+    for (uint32_t i = 0; i < n; ++i) x->buf[x->len++] = x->idle;
+    return true;
+}
+
+static bool put_byte(lcd_xfer_t *x, uint8_t val, bool rs, uint32_t exec_us)
+{
+    // Entre dos flancos de bajada hay 3 bytes de bus; solo a relojes muy
+    // altos hace falta relleno para la ejecución de la instrucción
+    uint32_t slack = 3u * x->byte_ns / 1000;
+    uint32_t wait = exec_us > slack ? exec_us - slack : 0;
+    if (room(x) < 6 + fill_count(x, wait)) return false;
+    put_nibble(x, val & 0xF0, rs);
+    put_nibble(x, (uint8_t)(val << 4), rs);
+    return lcd_xfer_wait_us(x, wait);
+}
+
+bool lcd_xfer_cmd(lcd_xfer_t *x, uint8_t cmd)
+{
+    bool slow = cmd == LCD_CMD_CLEAR || cmd == LCD_CMD_HOME;
+    return put_byte(x, cmd, false, slow ? LCD_CLEAR_US : LCD_EXEC_US);
+}
+
+bool lcd_xfer_data(lcd_xfer_t *x, uint8_t c)
+{
+    return put_byte(x, c, true, LCD_EXEC_US);
+}
+
+size_t lcd_xfer_ops(lcd_xfer_t *x, const lcd_op_t *ops, size_t n)
+{
+    size_t i = 0;
+    for (; i < n; ++i) {
+        bool ok = ops[i].kind == LCD_OP_CMD ? lcd_xfer_cmd(x, ops[i].val) : lcd_xfer_data(x, ops[i].val);
+        if (!ok) break;
+    }
+    return i;
+}
+
+size_t lcd_xfer_text(lcd_xfer_t *x, const char *s, size_t maxlen)
+{
+    size_t i = 0;
+    for (; i < maxlen && s[i]; ++i) {
+        if (!lcd_xfer_data(x, (uint8_t)s[i])) break;
+    }
+    return i;
+}
+
+bool lcd_xfer_hd44780_init(lcd_xfer_t *x)
+{
+    // Las salidas del PCF8574 pueden estar con EN alto (al encender todas lo
+    // están; tras un auto-probe con otro mapeo, cualquier cosa). Primero EN=1
+    // con los datos de reposo y luego EN=0 sin tocarlos: el único flanco que
+    // ve el HD44780 lleva un nibble 0 limpio, que las 0x30 de después
+    // absorben sea cual sea el modo en que estuviera
+    uint8_t idle = lcd_pinmap_pack(x->pm, 0, false);
+    if (room(x) < 2) return false;
+    x->buf[x->len++] = idle | x->pm->en;
+    x->buf[x->len++] = idle;
+    x->idle = idle;
+
+    // Secuencia "inicialización por instrucción" de la hoja de datos
+    return lcd_xfer_wait_us(x, LCD_EXEC_US)
+        && lcd_xfer_nibble(x, 0x30, false) && lcd_xfer_wait_us(x, 4100)
+        && lcd_xfer_nibble(x, 0x30, false) && lcd_xfer_wait_us(x, 100)
+        && lcd_xfer_nibble(x, 0x30, false) && lcd_xfer_wait_us(x, 100)
+        && lcd_xfer_nibble(x, 0x20, false) && lcd_xfer_wait_us(x, 100)  // Entrar a 4-bit
+        && lcd_xfer_cmd(x, 0x28)    // 2 líneas, 5x8
+        && lcd_xfer_cmd(x, 0x0C)    // Display ON
+        && lcd_xfer_cmd(x, 0x06)    // Entry mode
+        && lcd_xfer_cmd(x, LCD_CMD_CLEAR)
+        && lcd_xfer_cmd(x, LCD_CMD_HOME);
+}
+
+uint32_t lcd_xfer_bus_us(const lcd_xfer_t *x)
+{
+    if (x->len == 0) return 0;
+    // Dirección + datos a 9 bits, más START y STOP
+    return (uint32_t)(((uint64_t)(x->len + 1) * x->byte_ns + 2u * x->byte_ns / 9u) / 1000);
+}
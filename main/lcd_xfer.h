@@ -0,0 +1,84 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lcd_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Constructor de transferencias I2C para un HD44780 detrás de un PCF8574.
+// En vez de una transacción de 1 byte por flanco de EN (con esperas activas
+// entre medias), cada byte del HD44780 se convierte en 6 bytes del PCF8574
+// (nibble alto y bajo: dato, EN=1, EN=0) que se acumulan en un buffer y
+// salen en una única escritura: el expansor acepta bytes consecutivos en la
+// misma transacción y actualiza sus salidas tras cada ACK.
+//
+// Temporización: cada byte del PCF8574 dura 9 bits de reloj (180 us a
+// 50 kHz), de sobra para el ancho de EN (>= 450 ns) y para los 37 us de
+// ejecución entre bytes. Las esperas largas (0x01/0x02: 1,52 ms; arranque
+// en 4 bits: 4,1 ms) no son vTaskDelay ni ets_delay_us: se rellenan con
+// bytes que repiten el último valor (EN=0), así que el bus marca el tiempo
+// y la CPU queda libre.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutilizan main.c y tools/lcd_bench).
+
+#define LCD_PINMAP_VARIANTS  6
+#define LCD_XFER_MAX         256     // Cuadro completo (LCD_OPS_MAX x 6) con margen
+#define LCD_EXEC_US          37      // Ejecución típica de una instrucción
+#define LCD_CLEAR_US         1520    // 0x01 y 0x02
+
+// Bits del PCF8574 para cada línea del módulo (d[0] = D4 ... d[3] = D7)
+typedef struct {
+    uint8_t rs, rw, en, bl;
+    uint8_t d[4];
+} lcd_pinmap_t;
+
+// VARIANT 0 (muy común): P0=RS, P1=RW, P2=EN, P3=BL, P4..P7=D4..D7
+// VARIANT 1 (algunas placas): P0..P3=D4..D7, P4=BL, P5=EN, P6=RW, P7=RS
+// VARIANT 2: P0..P3=D4..D7, P4=EN, P5=RW, P6=RS, P7=BL
+// VARIANT 3: como 0 con las líneas de datos invertidas (P4..P7 = D7..D4)
+// VARIANT 4: P0..P3=D7..D4, P4=BL, P5=EN, P6=RW, P7=RS
+// VARIANT 5: P0..P3=D7..D4, P4=EN, P5=RW, P6=RS, P7=BL
+extern const lcd_pinmap_t lcd_pinmaps[LCD_PINMAP_VARIANTS];
+
+// Byte del PCF8574 para el nibble alto de hi_nibble (bits 7..4), con
+// retroiluminación encendida, RW=0 y EN=0
+uint8_t lcd_pinmap_pack(const lcd_pinmap_t *pm, uint8_t hi_nibble, bool rs);
+
+typedef struct {
+    const lcd_pinmap_t *pm;
+    uint32_t byte_ns;        // Duración de un byte en el bus (9 bits)
+    uint16_t len;
+    uint8_t idle;            // Último valor escrito (relleno de esperas)
+    uint8_t buf[LCD_XFER_MAX];
+} lcd_xfer_t;
+
+void lcd_xfer_init(lcd_xfer_t *x, const lcd_pinmap_t *pm, uint32_t i2c_hz);
+// Vacía el buffer (tras enviarlo); el valor de reposo se conserva
+static inline void lcd_xfer_reset(lcd_xfer_t *x) { x->len = 0; }
+
+// Todas devuelven false sin escribir nada si no cabe: enviar y reintentar
+bool lcd_xfer_nibble(lcd_xfer_t *x, uint8_t hi_nibble, bool rs);
+bool lcd_xfer_cmd(lcd_xfer_t *x, uint8_t cmd);       // Incluye la espera de 0x01/0x02
+bool lcd_xfer_data(lcd_xfer_t *x, uint8_t c);
+bool lcd_xfer_wait_us(lcd_xfer_t *x, uint32_t us);
+
+// Encola operaciones del render diferencial; devuelve cuántas cupieron
+size_t lcd_xfer_ops(lcd_xfer_t *x, const lcd_op_t *ops, size_t n);
+// Encola hasta maxlen caracteres de s; devuelve cuántos cupieron
+size_t lcd_xfer_text(lcd_xfer_t *x, const char *s, size_t maxlen);
+
+// Inicialización en 4 bits tras el encendido (>= 40 ms de alimentación):
+// 0x30 x3, 0x20, 0x28, 0x0C, 0x06, clear y home. Vale desde cualquier
+// estado previo del HD44780 y del PCF8574. Buffer vacío al llamar
+bool lcd_xfer_hd44780_init(lcd_xfer_t *x);
+
+// Tiempo de bus del buffer actual (START, dirección, datos, STOP)
+uint32_t lcd_xfer_bus_us(const lcd_xfer_t *x);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "sdkconfig.h"  // Define CONFIG_* Kconfig macros (e.g., CONFIG_FREERTOS_HZ, CONFIG_LOG_MAXIMUM_LEVEL)
 #ifndef CONFIG_FREERTOS_HZ
@@ -38,57 +39,78 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
-#include "esp_timer.h"
-#include "driver/gpio.h"
-#include "driver/ledc.h"
-#include "driver/i2c.h"
-#include "rom/ets_sys.h"
-#include "esp_spiffs.h"
-#include "esp_vfs.h"
-// ===== Añadidos para WiFi/MQTT (reutilizando código existente en main_mqtt.c) =====
-#include "nvs_flash.h"
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "esp_chip_info.h"
-#include "mqtt_client.h"
+#include "hal.h"        // GPIO, ADC, PWM, I2C, SPI, temporizadores, NVS, SPIFFS, WiFi y MQTT
 #include "cJSON.h"
+#include "pot_capture.h"
+#include "pot_trace.h"
+#include "door_debounce.h"
+#include "sched.h"
+#include "access_fsm.h"
+#include "cred_queue.h"
+#include "cred_fusion.h"
+#include "access_policy.h"
+#include "app_config.h"
+#include "boot_graph.h"
+#include "feedback.h"
+#include "lcd_drv.h"
+#include "lcd_queue.h"
+#include "twin_state.h"
+#include "state_doc.h"
+#include "cmd_ack.h"
+#include "task_plan.h"
+#include "jitter.h"
+#include "power_prof.h"
+#include "prof.h"
+#include "stack_sizes.h"
 #include "sys/time.h"
 #include <time.h>
 
 // =============================================================
 // ===============   CONFIGURACIÓN (EDITABLE)   ================
 // =============================================================
+// Red, broker, combinación, tiempos principales y pines son valores de
+// fábrica: lo vigente se guarda en NVS y se cambia por CONFIG_TOPIC sin
+// recompilar (app_config.h, cfg_factory()).
 
 // Modo de acceso:
-//   1 = AND (RFID y combinación)
-//   2 = OR  (RFID o combinación)
-#define ACCESS_MODE_AND 1
-#define ACCESS_MODE_OR  2
+//   1 = AND  (RFID y combinación dentro de la ventana)
+//   2 = OR   (RFID o combinación)
+//   3 = 2OF3 (dos métodos distintos entre RFID, combinación y remoto)
+//   4 = DUAL (dos tarjetas RFID distintas dentro de la ventana)
+#define ACCESS_MODE_AND  1
+#define ACCESS_MODE_OR   2
+#define ACCESS_MODE_2OF3 3
+#define ACCESS_MODE_DUAL 4
 #define ACCESS_MODE      ACCESS_MODE_OR    // Cambiar aquí para el modo deseado
+#define CRED_WINDOW_MS   30000             // Vigencia de cada factor en modos multifactor
 
 // Tiempos clave (en ms)
 #define UNLOCK_MAX_OPEN_TIME_MS   10000  // Tiempo máximo que permanecerá desbloqueada si la puerta no se abre
 #define INPUT_IDLE_RESET_MS        8000  // Tiempo de inactividad del encoder para resetear la captura
-#define DEBOUNCE_MS                 40   // Anti-rebote para entradas digitales
-
-// Configuración del buzzer (LEDC PWM)
-#define BUZZER_GPIO               GPIO_NUM_26
-#define BUZZER_LEDC_TIMER         LEDC_TIMER_0
-#define BUZZER_LEDC_MODE          LEDC_LOW_SPEED_MODE
-#define BUZZER_LEDC_CHANNEL       LEDC_CHANNEL_0
+#define RELOCK_DELAY_MS            1000  // Re-bloqueo tras cerrar la puerta
+#define LCD_IDLE_TIMEOUT_MS        5000  // Sin actividad: volver a la pantalla de bienvenida
+#define LCD_LOCKING_MS             1000  // Duración del mensaje "LOCKING..."
+#define LCD_RESULT_MIN_MS          1500  // Concedido/denegado: mínimo en pantalla ante mensajes nuevos
+#define DEBOUNCE_MS   DOOR_DEBOUNCE_MS  // Anti-rebote del reed: ventana de silencio tras el último flanco (20 ms)
+
+// Configuración del buzzer (PWM)
+#define BUZZER_GPIO               26
+#define BUZZER_PWM_CH             0
+#define BUZZER_PWM_BITS           10
 #define BUZZER_FREQ_HZ            2000   // Frecuencia del beep
 
 // LEDs de estado
-#define LED_STATUS_GPIO           GPIO_NUM_14  // LED de “sistema listo”
-#define LED_GREEN_GPIO            GPIO_NUM_12   // LED de acceso concedido
-#define LED_RED_GPIO              GPIO_NUM_27  // LED de acceso denegado / bloqueado
+#define LED_STATUS_GPIO           14  // LED de “sistema listo”
+#define LED_GREEN_GPIO            12   // LED de acceso concedido
+#define LED_RED_GPIO              27  // LED de acceso denegado / bloqueado
 
 // Sensor magnético de puerta (reed switch)
-#define DOOR_SENSOR_GPIO          GPIO_NUM_33  // Usar con pull-up interno y contacto a GND
+#define DOOR_SENSOR_GPIO          33  // Usar con pull-up interno y contacto a GND
 
 // Electroimán (cerradura) controlado por un MOSFET/Relay externo
-#define LOCK_GPIO                 GPIO_NUM_25
+#define LOCK_GPIO                 25
 // Nivel lógico que ACTIVA el relay (energiza el electroimán). Muchos módulos relay son activos en LOW.
 // Ajusta a 1 si tu módulo requiere nivel alto para activarse.
 #define RELAY_ACTIVE_LEVEL        0  // Transistor NPN: nivel alto en GPIO activa la bobina
@@ -97,13 +119,10 @@
 // Alternativa: Servo como cerradura (selección por compilación)
 // 0 = electroimán (LOCK_GPIO), 1 = servo (SERVO_GPIO)
 #define LOCK_USE_SERVO            0
-#define SERVO_GPIO                GPIO_NUM_25   // Cambia según tu hardware
-#define SERVO_LEDC_MODE           LEDC_LOW_SPEED_MODE
-#define SERVO_LEDC_TIMER          LEDC_TIMER_1
-#define SERVO_LEDC_CHANNEL        LEDC_CHANNEL_1
+#define SERVO_GPIO                25   // Cambia según tu hardware
+#define SERVO_PWM_CH              1
 #define SERVO_FREQ_HZ             50           // SG90: 50 Hz (periodo ~20 ms)
 // Usa mayor resolución para mejor precisión de pulso
-#define SERVO_TIMER_RES           LEDC_TIMER_14_BIT
 #define SERVO_TIMER_BITS          14
 // SG90 típico: ~500us (0°) a ~2400us (180°) — ajusta si tu servo necesita otro rango
 #define SERVO_MIN_US              500
@@ -113,7 +132,7 @@
 #define SERVO_UNLOCK_DEG          0
 
 // Potenciómetro analógico (sustituye encoder). Usamos solo GPIO34 (ADC1_CH6)
-#define POT_ADC_GPIO              GPIO_NUM_34
+#define POT_ADC_GPIO              34
 
 // Resolución esperada ADC (ESP32 ADC1 es 12 bits por defecto => 0..4095)
 #define POT_ADC_MAX_RAW           4095
@@ -124,13 +143,20 @@
 #define POT_INVALID_DIGIT         -1
 // Invertir mapeo si el potenciómetro está conectado al revés (1=invertido, 0=normal)
 #define POT_INVERT_MAPPING        1    // CAMBIAR A 0 SI AÚN ESTÁ INVERTIDO
-// Tiempo de estabilización
+// Tiempo de estabilización (techo: con el detector por varianza es el máximo de espera)
 #define POT_SETTLE_MS             2000
+// Detector de estabilidad: POT_SETTLE_MODE_FIXED (espera fija) o POT_SETTLE_MODE_VARIANCE
+#define POT_SETTLE_MODE           POT_SETTLE_MODE_VARIANCE
+#define POT_SETTLE_WINDOW         5     // Muestras en la ventana (5 x 120 ms = 600 ms)
+#define POT_SETTLE_Z              2.0f  // Confianza (~95%): media ± 2σ debe caer en el mismo dígito
+#define POT_SETTLE_MAX_SLOPE      15.0f // Deriva máxima admitida (cuentas ADC por muestra)
+#define POT_SETTLE_HORIZON        (1.0f / POT_FILTER_ALPHA) // Proyección de la tendencia (muestras, ~constante del IIR)
+#define POT_SETTLE_MIN_MS         900   // Piso: tiempo mínimo sostenido antes de capturar (hoy decide el instante; ver pot_replay)
 // Mínimo tiempo entre logs
 #define POT_LOG_MIN_MS            300
 // Longitud de la combinación
 #define COMBO_LEN                 3
-// Combinación objetivo (ejemplo)
+// Combinación objetivo de fábrica (la vigente admite de 3 a CFG_COMBO_MAX dígitos)
 static const int COMBO_TARGET[COMBO_LEN] = {3, 6, 4};
 
 // ===== Configuración WiFi / MQTT (desde main_mqtt.c) =====
@@ -138,95 +164,224 @@ static const int COMBO_TARGET[COMBO_LEN] = {3, 6, 4};
 #define WIFI_PASS "NYValencia120"
 #define MQTT_BROKER "mqtt://192.168.3.213:1883"
 #define MQTT_TOPIC "iot/telemetry"
+#define POLICY_TOPIC "iot/policy"             // Política de acceso en JSON (access_policy.h)
+#define CONFIG_TOPIC "iot/config"             // Parches de configuración en JSON (app_config.h)
+#define CONFIG_BUSY_RETRIES 5                 // Reintentos si un lector retiene las instantáneas
+#define BOOT_TOPIC "iot/boot"                 // Informe de tiempos de arranque (boot_graph.h)
+#define TWIN_TOPIC "iot/twin"                 // Estado para el gemelo: instantánea + deltas (twin_state.h)
+#define TWIN_RESYNC_TOPIC "iot/twin/resync"   // El gemelo pide instantánea (cualquier payload)
+#define TWIN_MIN_MS 100                       // Valor de fábrica de twin_min_ms: un mensaje por cuadro como mucho
+#define TWIN_HEARTBEAT_MS 10000               // En silencio: último seq, para detectar un delta perdido
+#define STATE_TOPIC "iot/state"               // Documento de estado retenido (state_doc.h)
+#define STATE_MIN_MS 1000                     // Como mucho un documento retenido por segundo
+#define CMD_ACK_TOPIC "iot/commands/ack"      // Acuses por etapas de las órdenes remotas con "id"
+#define BOOT_WORKERS 2                        // Tareas que ejecutan los pasos no críticos
+#define TASK_PRIO_LO 3                        // Banda de prioridades de la aplicación (task_plan.h)
+#define TASK_PRIO_HI 7
+#define TASK_PLAN_PINNED 1                    // 0: todas sin afinidad (disposición anterior, para comparar)
+#define JITTER_BENCH 0                        // 1: carga de red sintética + informe de retrasos en JITTER_TOPIC
+#define JITTER_TOPIC "iot/jitter"             // Retraso de despertar por tarea (jitter.h)
+#define JITTER_REPORT_MS 10000                // Ventana de cada informe
+#define NETLOAD_PERIOD_MS 50                  // Carga sintética: una ráfaga de CPU cada periodo...
+#define NETLOAD_BUSY_US 8000                  // ...de esta duración, a la prioridad de lwIP en el núcleo de red
+#define NETLOAD_BURST 8                       // Publicaciones QoS 0 de 512 bytes cada 10 periodos
+#define POWER_PROFILE POWER_BALANCED          // Valor de fábrica del campo "power" (power_prof.h)
+#define POWER_TOPIC "iot/power"               // Sueño medido y corriente estimada del perfil vigente
+#define POWER_REPORT_MS 60000                 // Ventana de cada informe
+#define PROF_TOPIC "iot/prof"                 // Volcados del perfilado (prof.h; tools/prof_sym los resuelve)
+#define PROF_CTRL_TOPIC "iot/prof/ctrl"       // {"on":true,"hz":997,"uart":false} / {"on":false} / {"dump":true} / {"stack":true}
+#define PROF_AT_BOOT 0                        // 1: perfilado activo desde el arranque con volcado por consola
+#define PROF_HZ 997                           // Muestreo del PC por núcleo; primo: no se alinea con el tick de 100 Hz
+#define PROF_REPORT_MS 10000                  // Ventana de cada volcado con el perfilado activo
+#define PROF_TOP_PCS 48                       // PCs más frecuentes de cada núcleo en el volcado
+#define STACK_TOPIC "iot/stack"               // Pico de pila de las tareas permanentes (tools/stack_plan)
+#define STACK_STRESS 0                        // 1: escenario de estrés tras el arranque + informe de pilas (en banco: acciona el relé)
+#define STACK_STRESS_DELAY_MS 10000           // Espera a que terminen el arranque y la conexión MQTT
+#define STACK_STRESS_ROUNDS 200               // Vueltas de credenciales, LCD y (cada 50) recarga de política
+#define STACK_STRESS_PERIOD_MS 100
+#define STACK_STRESS_SETTLE_MS 15000          // Tras la última vuelta: vencen los plazos de las puertas
+#define POT_ACTIVE_MS 120                     // Periodo del potenciómetro mientras se mueve...
+#define POT_IDLE_AFTER_MS 3000                // ...y tras este reposo sin combinación a medias, el del perfil
+#define POT_WAKE_DELTA_RAW 100                // Lectura tan lejos del filtro: movimiento (el IIR tarda en seguirlo)
+#define BOOT_CRITICAL_BUDGET_US 100000        // Cerradura y puerta listas antes de 100 ms
+#define POLICY_FILE_PATH HAL_FS_ROOT "/policy.json"  // Última política aceptada (se recarga al arrancar)
+#define POLICY_JSON_MAX (96 * 1024)
+
+// Puertas de esta placa. La del panel (LCD, potenciómetro, buzzer y LEDs)
+// toma relé, reed y CS del lector de la configuración (cfg_pins_t); las
+// demás solo tienen lector, reed y relé. Todas comparten control_task, el
+// bus SPI del lector (CS propio, RST común), el log y la sesión MQTT; cada
+// evento y cada orden llevan el id de la puerta en la política ("door").
+#define DOOR_COUNT                1   // 1..DOOR_MAX
+#define DOOR_MAX                  4
+#define PANEL_DOOR                0   // Índice en DOOR_HW de la puerta del panel
+
+typedef struct {
+	uint16_t policy_id;           // Puerta en la política
+	int8_t lock, door, rfid_cs;   // Pines; -1: los de la configuración (solo el panel)
+} door_hw_t;
+
+static const door_hw_t DOOR_HW[DOOR_MAX] = {
+	{ .policy_id = 0, .lock = -1, .door = -1, .rfid_cs = -1 },
+	// GPIO35/36/39 son solo de entrada y sin pull-up interno: el reed necesita uno externo
+	{ .policy_id = 1, .lock = 16, .door = 35, .rfid_cs = 17 },
+	{ .policy_id = 2, .lock = 32, .door = 36, .rfid_cs = 4 },
+	{ .policy_id = 3, .lock = 2,  .door = 39, .rfid_cs = 15 },
+};
+_Static_assert(DOOR_COUNT >= 1 && DOOR_COUNT <= DOOR_MAX, "DOOR_COUNT fuera de 1..DOOR_MAX");
+_Static_assert(PANEL_DOOR < DOOR_COUNT, "la puerta del panel debe existir");
+_Static_assert(DOOR_MAX <= POLICY_MAX_DOORS, "la política no distingue tantas puertas");
+
+// Plan de tareas (task_plan.h). La red queda en el núcleo 0: WiFi y esp_timer
+// ya lo están por defecto; lwIP, por sdkconfig.defaults. El cliente MQTT
+// (prioridad 5) sigue sin afinidad: en el 0 esperaría detrás de WiFi y lwIP.
+// Puertas, cerraduras, lectores y panel van al núcleo 1, donde no compiten
+// con la pila de red. Prioridad por plazo: control_task atiende el relé
+// (objetivo de desbloqueo), pot y rfid su periodo de muestreo, el LCD un
+// refresco legible; los trabajadores de arranque, lo que sobre.
+// Las pilas de las permanentes salen de stack_sizes.h (medidas).
+typedef enum { TASK_CONTROL = 0, TASK_POT, TASK_RFID, TASK_LCD, TASK_PROF, TASK_BOOT, TASK_BENCH, TASK_STRESS, TASK_COUNT } task_id_t;
+#define TASK_STATIC TASK_BOOT   // Las anteriores no terminan nunca: pila y TCB estáticos
+
+static task_spec_t g_tasks[TASK_COUNT] = {
+	[TASK_CONTROL] = { .name = "control", .deadline_ms = 20,   .core = TASK_CORE_APP, .stack = STACK_CONTROL },
+	[TASK_POT]     = { .name = "pot",     .deadline_ms = 120,  .core = TASK_CORE_APP, .stack = STACK_POT },
+	[TASK_RFID]    = { .name = "rfid",    .deadline_ms = 150,  .core = TASK_CORE_APP, .stack = STACK_RFID },
+	[TASK_LCD]     = { .name = "lcd",     .deadline_ms = 250,  .core = TASK_CORE_APP, .stack = STACK_LCD },
+	// Volcados del perfilado e informe de pilas, fuera de la tarea esp_timer
+	[TASK_PROF]    = { .name = "prof",    .deadline_ms = 1000, .core = TASK_CORE_ANY, .stack = STACK_PROF },
+	[TASK_BOOT]    = { .name = "boot",    .deadline_ms = 1000, .core = TASK_CORE_ANY, .stack = 4096 },
+	// Carga sintética de JITTER_BENCH: su prioridad se fija aparte (la de lwIP)
+	[TASK_BENCH]   = { .name = "netload", .deadline_ms = 1000, .core = TASK_CORE_NET, .stack = 3072 },
+	// Escenario de STACK_STRESS
+	[TASK_STRESS]  = { .name = "stress",  .deadline_ms = 1000, .core = TASK_CORE_ANY, .stack = 4096 },
+};
 
 // Tarjeta RFID MFRC522 (SPI). Pines VSPI por defecto del ESP32.
-#define RFID_SPI_CS_GPIO          GPIO_NUM_5
-#define RFID_SPI_SCK_GPIO         GPIO_NUM_18
-#define RFID_SPI_MOSI_GPIO        GPIO_NUM_23
-#define RFID_SPI_MISO_GPIO        GPIO_NUM_19
-#define RFID_RST_GPIO             GPIO_NUM_13
+#define RFID_SPI_CS_GPIO          5
+#define RFID_SPI_SCK_GPIO         18
+#define RFID_SPI_MOSI_GPIO        23
+#define RFID_SPI_MISO_GPIO        19
+#define RFID_RST_GPIO             13
+// IRQ de los lectores, una línea open-drain compartida (pull-up interno);
+// -1: sin cablear. Con DOOR_COUNT >= 3 el GPIO32 es el relé de la puerta 2
+#define RFID_IRQ_GPIO             32
 
 #define USE_MFRC522               1  // Desactivado por defecto para compilar sin librería externa
 
 #if USE_MFRC522
+// Tarjetas de la política por defecto (acceso 24/7) mientras no llegue otra por POLICY_TOPIC
 static const uint8_t AUTH_UIDS[][4] = {
     {0xEA, 0xE8, 0xD2, 0x84}
 };
 static const size_t AUTH_UIDS_COUNT = sizeof(AUTH_UIDS)/sizeof(AUTH_UIDS[0]);
 #endif
 
-// Eliminada la combinación multi-dígito (encoder). Ahora el evento EVT_COMBO_OK
-// se activa llevando el potenciómetro al máximo (dígito 10).
-
 // =============================================================
 // ============   VARIABLES GLOBALES DEL SISTEMA   =============
 // =============================================================
 
 static const char *TAG = "ACCESS";
 static const char *DEVICE_ID = "access_control_01";
-// Cliente MQTT (debe estar antes de log_event)
-static esp_mqtt_client_handle_t g_mqtt_client = NULL;
+
+// Configuración vigente (app_config.c): leer con cfg_acquire()/cfg_release()
+static cfg_store_t g_cfg;
+// Pines de la instantánea de arranque: un cambio de pines exige reiniciar
+static cfg_pins_t g_pins;
 
 // Ruta de archivo de logs (JSON lines)
-#define LOG_FILE_PATH "/spiffs/events.jsonl"
+#define LOG_FILE_PATH HAL_FS_ROOT "/events.jsonl"
+
+// Contención de g_log_mutex y g_lcd_mutex (prof.h): con el perfilado activo
+// cada toma anota su espera y su retención. Bajo g_prof_mux: lo comparten las
+// tareas que toman los mutex y el volcado
+typedef enum { PROF_LOCK_LOG = 0, PROF_LOCK_LCD, PROF_LOCK_COUNT } prof_lock_id_t;
+static const char *const PROF_LOCK_NAME[PROF_LOCK_COUNT] = { "g_log_mutex", "g_lcd_mutex" };
+static prof_lock_t g_prof_lock[PROF_LOCK_COUNT];
+static portMUX_TYPE g_prof_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool g_prof_on = false;
+
+static void lock_take(SemaphoreHandle_t m, prof_lock_id_t id)
+{
+	if (!g_prof_on) {
+		xSemaphoreTake(m, portMAX_DELAY);
+		return;
+	}
+	int64_t t0 = hal_time_us();
+	bool contended = xSemaphoreTake(m, 0) != pdTRUE;
+	if (contended) xSemaphoreTake(m, portMAX_DELAY);
+	int64_t now = hal_time_us();
+	portENTER_CRITICAL(&g_prof_mux);
+	prof_lock_taken(&g_prof_lock[id], t0, now, contended);
+	portEXIT_CRITICAL(&g_prof_mux);
+}
+
+static void lock_give(SemaphoreHandle_t m, prof_lock_id_t id)
+{
+	int64_t now = hal_time_us();
+	portENTER_CRITICAL(&g_prof_mux);
+	prof_lock_giving(&g_prof_lock[id], now); // Sin efecto si la toma no se midió
+	portEXIT_CRITICAL(&g_prof_mux);
+	xSemaphoreGive(m);
+}
 
 static SemaphoreHandle_t g_log_mutex; // Protege escritura concurrente
+static StaticSemaphore_t s_log_mutex_buf;
+static volatile bool g_fs_ready = false; // SPIFFS se monta en segundo plano (paso "fs")
+static volatile int64_t g_boot_door_ready_us = 0; // control_task aplicó el estado inicial
 
 static void fs_init(void)
 {
-	esp_vfs_spiffs_conf_t conf = {
-		.base_path = "/spiffs",
-		.partition_label = "storage", // etiqueta explícita según partitions.csv
-		.max_files = 5,
-		.format_if_mount_failed = true
-	};
-	esp_err_t ret = esp_vfs_spiffs_register(&conf);
-	if (ret != ESP_OK) {
-		ESP_LOGE(TAG, "Error montando SPIFFS (%s)", esp_err_to_name(ret));
+	size_t total=0, used=0;
+	if (!hal_fs_mount(&total, &used)) {
+		ESP_LOGE(TAG, "Sin sistema de archivos: eventos y política solo en memoria");
 	} else {
-		size_t total=0, used=0; esp_spiffs_info("storage", &total, &used);
 		ESP_LOGI(TAG, "SPIFFS montado. Total=%u Used=%u", (unsigned)total, (unsigned)used);
+		g_fs_ready = true;
 	}
-	g_log_mutex = xSemaphoreCreateMutex();
 }
 
 static void format_timestamp(char *buf, size_t sz)
 {
 	time_t now = 0; time(&now);
 	if (now <= 1000) { // Si no hay RTC/SNTP, usar tiempo desde arranque
-		now = esp_timer_get_time()/1000000; // segundos desde boot
+		now = hal_time_us()/1000000; // segundos desde boot
 	}
 	struct tm tm_info; localtime_r(&now, &tm_info);
 	strftime(buf, sz, "%Y-%m-%dT%H:%M:%S", &tm_info);
 }
 
-// access_method: "password", "rfid" o "door"; door_status: "open"/"close"; access_granted: true/false
-static void log_event(const char *access_method, bool access_granted, const char *door_status)
+// door: id de la puerta en la política; access_method: "password", "rfid" o "door";
+// door_status: "open"/"close"; access_granted: true/false
+static void log_event(unsigned door, const char *access_method, bool access_granted, const char *door_status)
 {
     if (!g_log_mutex) return;
-    xSemaphoreTake(g_log_mutex, portMAX_DELAY);
-    FILE *f = fopen(LOG_FILE_PATH, "a");
-    if (!f) {
+    lock_take(g_log_mutex, PROF_LOCK_LOG);
+    // Sin SPIFFS todavía (arranque) el evento solo sale por MQTT
+    FILE *f = g_fs_ready ? fopen(LOG_FILE_PATH, "a") : NULL;
+    if (!f && g_fs_ready) {
         ESP_LOGE(TAG, "No se pudo abrir log %s", LOG_FILE_PATH);
-        xSemaphoreGive(g_log_mutex);
+        lock_give(g_log_mutex, PROF_LOCK_LOG);
         return;
     }
     // Timestamp vacío solicitado por requerimiento ("timestamp":"")
     const char *ts_empty = "";
     char json_line[256];
     snprintf(json_line, sizeof(json_line),
-             "{\"device_id\":\"%s\",\"door_status\":\"%s\",\"access_method\":\"%s\",\"access_granted\":%s,\"timestamp\":\"%s\"}",
-             DEVICE_ID,
+             "{\"device_id\":\"%s\",\"door\":%u,\"door_status\":\"%s\",\"access_method\":\"%s\",\"access_granted\":%s,\"timestamp\":\"%s\"}",
+             DEVICE_ID, door,
              door_status ? door_status : "unknown",
              access_method ? access_method : "door",
              access_granted ? "true" : "false",
              ts_empty);
-    fprintf(f, "%s\n", json_line);
-    fclose(f);
-    if (g_mqtt_client) {
-        esp_mqtt_client_publish(g_mqtt_client, MQTT_TOPIC, json_line, 0, 1, 0);
+    if (f) {
+        fprintf(f, "%s\n", json_line);
+        fclose(f);
     }
-    xSemaphoreGive(g_log_mutex);
+    if (hal_mqtt_ready()) {
+        hal_mqtt_publish(MQTT_TOPIC, json_line, 0, 1, 0);
+    }
+    lock_give(g_log_mutex, PROF_LOCK_LOG);
 }
 
 typedef enum {
@@ -235,403 +390,871 @@ typedef enum {
 	DOOR_CLOSED
 } door_state_t;
 
+// Contexto de una puerta (DOOR_HW): máquina de estados, factores vigentes,
+// anti-rebote del reed, credenciales pendientes y pines. fsm y fusion son
+// solo de control_task; db y cred_q tienen su portMUX porque los tocan la
+// ISR del reed y los productores de credenciales.
+typedef struct {
+	uint8_t idx;                 // Posición en g_doors (eventos y plazos)
+	uint16_t policy_id;          // Puerta en la política, los logs y las órdenes
+	int lock_gpio, door_gpio, rfid_cs;
+	access_fsm_t fsm;            // Solo control_task
+	fusion_t fusion;             // Solo control_task: factores vigentes (cred_fusion.c)
+	access_state_t state_pub;    // Instantánea para consultas de solo lectura (g_ctrl_mux)
+	cred_queue_t cred_q;         // Credenciales válidas pendientes (cred_mux)
+	portMUX_TYPE cred_mux;
+	uint32_t seen_overflow;      // Solo control_task: desbordamientos ya avisados
+	door_debounce_t db;          // Anti-rebote del reed (db_mux)
+	portMUX_TYPE db_mux;
+	hal_timer_t *db_timer;
+} door_ctx_t;
+
+static door_ctx_t g_doors[DOOR_COUNT] = {
+	[0 ... DOOR_COUNT - 1] = {
+		.cred_mux = portMUX_INITIALIZER_UNLOCKED,
+		.db_mux = portMUX_INITIALIZER_UNLOCKED,
+		.state_pub = ACCESS_LOCKED_CLOSED,
+	},
+};
+
+static inline bool door_is_panel(const door_ctx_t *d)
+{
+	return d->idx == PANEL_DOOR;
+}
+
+// Puerta por su id en la política (órdenes remotas); NULL si no es de esta placa
+static door_ctx_t *door_by_policy_id(long id)
+{
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		if (g_doors[i].policy_id == id) return &g_doors[i];
+	}
+	return NULL;
+}
+
+// Tras cfg_init(): la puerta del panel usa los pines de la configuración
+static void doors_bind(void)
+{
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		door_ctx_t *d = &g_doors[i];
+		const door_hw_t *hw = &DOOR_HW[i];
+		d->idx = (uint8_t)i;
+		d->policy_id = hw->policy_id;
+		d->lock_gpio = hw->lock >= 0 ? hw->lock : g_pins.lock;
+		d->door_gpio = hw->door >= 0 ? hw->door : g_pins.door;
+		d->rfid_cs = hw->rfid_cs >= 0 ? hw->rfid_cs : g_pins.rfid_cs;
+	}
+}
+
+// Eventos tipados hacia control_task, único dueño del estado de puertas y
+// cerraduras (access_fsm.c). Sensores, RFID, potenciómetro, MQTT y plazos de
+// sched solo publican en g_ctrl_q; nadie más toca los relés ni ese estado.
+// Las credenciales viajan aparte, con sus datos, en la cred_q de su puerta
+// (cred_queue.c); g_ctrl_q solo lleva el aviso de que hay registros pendientes.
 typedef enum {
-	LOCK_STATE_UNKNOWN = 0,
-	LOCKED,
-	UNLOCKED
-} lock_state_t;
-
-// Evento/flags compartidos por tareas
-static EventGroupHandle_t g_events;
-#define EVT_RFID_OK      (1<<0)
-#define EVT_COMBO_OK     (1<<1)
-#define EVT_DOOR_CLOSED  (1<<2)
-#define EVT_LOCKED       (1<<3)
-#define EVT_REMOTE_OK    (1<<4) // Nuevo método de acceso remoto vía MQTT
-
-// Estado de alto nivel
-static volatile door_state_t g_door_state = DOOR_UNKNOWN;
-static volatile lock_state_t g_lock_state = LOCK_STATE_UNKNOWN;
-static volatile bool g_pending_relock = false;
-static int64_t g_relock_arm_time_us = 0;
+	CTRL_EV_CREDENTIAL = 0,  // Hay credenciales en alguna cred_q (RFID, combinación, remoto)
+	CTRL_EV_DOOR,            // Cambio de puerta confirmado por el anti-rebote
+	CTRL_EV_TIMER,           // Plazo de sched vencido (DL_RELOCK / DL_UNLOCK_MAX)
+	CTRL_EV_POLICY,          // Política nueva ya compilada (pasa a ser de control_task)
+} ctrl_evt_kind_t;
+
+typedef struct {
+	ctrl_evt_kind_t kind;
+	uint8_t door;                    // Índice en g_doors (puerta, plazo o credencial)
+	union {
+		struct {
+			door_state_t state;
+			int64_t edge_us;         // Primer flanco de la ráfaga
+		} door_ev;                   // CTRL_EV_DOOR
+		int timer_id;                // CTRL_EV_TIMER
+		policy_t *policy;            // CTRL_EV_POLICY
+	};
+	int64_t ts_us;                   // Instante de publicación
+} ctrl_evt_t;
 
-// Potenciómetro estado
-static volatile int g_current_digit = 0;
-static int64_t g_last_pot_print_us = 0;
-static volatile int g_entered[COMBO_LEN] = {0};
-static volatile int g_entered_count = 0;
-static int64_t g_last_move_ts_us = 0;
-static bool g_digit_captured_after_settle = false;
-
-// Adelantar prototipo para reiniciar combinación
-static void combo_reset(void);
-// Prototipo de buzzer usado antes de definición
-static void buzzer_play_ms(uint32_t ms, uint32_t duty);
-// =============================================================
-// ====================   LCD1602 (I2C)   =====================
-// =============================================================
+#define CTRL_QUEUE_LEN  16
+#define CTRL_POLICY_WAIT_MS 500   // Espera máxima por un hueco en g_ctrl_q al entregar una política
+static QueueHandle_t g_ctrl_q = NULL;
+static StaticQueue_t s_ctrl_q_buf;
+static uint8_t s_ctrl_q_store[CTRL_QUEUE_LEN * sizeof(ctrl_evt_t)];
 
-#define I2C_PORT                  I2C_NUM_0
-#define I2C_SDA_GPIO              GPIO_NUM_21
-#define I2C_SCL_GPIO              GPIO_NUM_22
-#define I2C_FREQ_HZ               50000  // Reducido para mayor margen frente a ruido
-#define LCD_ADDR                  0x27  // Confirmado por usuario
-// Auto-probe deshabilitado (ya identificamos mapeo correcto)
-#ifndef LCD_AUTOPROBE
-#define LCD_AUTOPROBE 0
-#endif
+// Protege las instantáneas state_pub que publica control_task (logs)
+static portMUX_TYPE g_ctrl_mux = portMUX_INITIALIZER_UNLOCKED;
 
-// PCF8574 pin mapping variants
-// VARIANT 0 (muy común): P0=RS, P1=RW, P2=EN, P3=BL, P4..P7=D4..D7
-// VARIANT 1 (algunas placas): P0..P3=D4..D7, P4=BL, P5=EN, P6=RW, P7=RS
-// VARIANT 2: P0..P3=D4..D7, P4=EN, P5=RW, P6=RS, P7=BL
-// VARIANT 3: P0=RS, P1=RW, P2=EN, P3=BL, P4..P7=D7..D4 (inversión D-lines)
-#ifndef LCD_PINMAP_VARIANT
-#define LCD_PINMAP_VARIANT 0
-#endif
+static bool ctrl_post_wait(ctrl_evt_t ev, TickType_t wait)
+{
+	ev.ts_us = hal_time_us();
+	if (!g_ctrl_q || xQueueSend(g_ctrl_q, &ev, wait) != pdTRUE) {
+		ESP_LOGW(TAG, "Cola de control llena; evento %d descartado", ev.kind);
+		return false;
+	}
+	return true;
+}
 
-#if LCD_PINMAP_VARIANT==0
-#define LCD_BL   0x08
-#define LCD_EN   0x04
-#define LCD_RW   0x02
-#define LCD_RS   0x01
-// Convierte nibble alto (D7..D4 en bits7..4) a bus P4..P7
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	uint8_t data = (hi_nibble & 0xF0) | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
-}
-#elif LCD_PINMAP_VARIANT==1
-#define LCD_BL   0x10
-#define LCD_EN   0x20
-#define LCD_RW   0x40
-#define LCD_RS   0x80
-// Convierte nibble alto (D7..D4 en bits7..4) a bus P0..P3
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	uint8_t lower = (hi_nibble >> 4) & 0x0F; // D7..D4 -> P3..P0
-	uint8_t data = lower | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
-}
-#elif LCD_PINMAP_VARIANT==2
-#define LCD_BL   0x80
-#define LCD_EN   0x10
-#define LCD_RW   0x20
-#define LCD_RS   0x40
-// P0..P3 = D4..D7; P4=EN; P5=RW; P6=RS; P7=BL
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	uint8_t lower = (hi_nibble >> 4) & 0x0F;
-	uint8_t data = lower | LCD_EN | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
-}
-#elif LCD_PINMAP_VARIANT==3
-#define LCD_BL   0x08
-#define LCD_EN   0x04
-#define LCD_RW   0x02
-#define LCD_RS   0x01
-// Igual que 0 pero D-lines invertidas: P4..P7 = D4..D7 reversed (rare)
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	// Reverse D7..D4 order onto P4..P7: map D7->P4, D6->P5, D5->P6, D4->P7
-	uint8_t d7 = (hi_nibble & 0x80) ? 0x10 : 0x00;
-	uint8_t d6 = (hi_nibble & 0x40) ? 0x20 : 0x00;
-	uint8_t d5 = (hi_nibble & 0x20) ? 0x40 : 0x00;
-	uint8_t d4 = (hi_nibble & 0x10) ? 0x80 : 0x00;
-	uint8_t data = d7 | d6 | d5 | d4 | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
-}
-
-#elif LCD_PINMAP_VARIANT==4
-// VARIANT 4: P0..P3 = D7..D4 (reversed on low nibble), P4=BL, P5=EN, P6=RW, P7=RS
-#define LCD_BL   0x10
-#define LCD_EN   0x20
-#define LCD_RW   0x40
-#define LCD_RS   0x80
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	// Map D7..D4 -> P0..P3 (reversed)
-	uint8_t p0 = (hi_nibble & 0x80) ? 0x01 : 0x00; // D7->P0
-	uint8_t p1 = (hi_nibble & 0x40) ? 0x02 : 0x00; // D6->P1
-	uint8_t p2 = (hi_nibble & 0x20) ? 0x04 : 0x00; // D5->P2
-	uint8_t p3 = (hi_nibble & 0x10) ? 0x08 : 0x00; // D4->P3
-	uint8_t data = p0 | p1 | p2 | p3 | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
-}
-
-#elif LCD_PINMAP_VARIANT==5
-// VARIANT 5: P0..P3 = D7..D4 (reversed on low nibble), P4=EN, P5=RW, P6=RS, P7=BL
-#define LCD_BL   0x80
-#define LCD_EN   0x10
-#define LCD_RW   0x20
-#define LCD_RS   0x40
-static inline uint8_t lcd_pack_nibble(uint8_t hi_nibble, bool rs)
-{
-	// Map D7..D4 -> P0..P3 (reversed)
-	uint8_t p0 = (hi_nibble & 0x80) ? 0x01 : 0x00; // D7->P0
-	uint8_t p1 = (hi_nibble & 0x40) ? 0x02 : 0x00; // D6->P1
-	uint8_t p2 = (hi_nibble & 0x20) ? 0x04 : 0x00; // D5->P2
-	uint8_t p3 = (hi_nibble & 0x10) ? 0x08 : 0x00; // D4->P3
-	uint8_t data = p0 | p1 | p2 | p3 | LCD_EN | LCD_BL | (rs ? LCD_RS : 0);
-	return data;
+static bool ctrl_post(ctrl_evt_t ev)
+{
+	return ctrl_post_wait(ev, 0);
 }
-#else
-#error "Unsupported LCD_PINMAP_VARIANT"
-#endif
 
-static SemaphoreHandle_t g_lcd_mutex;
-static char g_lcd_line1[17] = {0};
-static char g_lcd_line2[17] = {0};
-static volatile bool g_lcd_dirty = false;
-static int64_t g_last_activity_us = 0;
-static volatile int64_t g_locking_until_us = 0;
-
-static esp_err_t i2c_bus_init(void)
-{
-	i2c_config_t conf = {
-		.mode = I2C_MODE_MASTER,
-		.sda_io_num = I2C_SDA_GPIO,
-		.sda_pullup_en = GPIO_PULLUP_ENABLE,
-		.scl_io_num = I2C_SCL_GPIO,
-		.scl_pullup_en = GPIO_PULLUP_ENABLE,
-		.master.clk_speed = I2C_FREQ_HZ,
-		.clk_flags = 0,
-	};
-	ESP_ERROR_CHECK(i2c_param_config(I2C_PORT, &conf));
-	return i2c_driver_install(I2C_PORT, I2C_MODE_MASTER, 0, 0, 0);
+// Entrega a control_task una política compilada, esperando hasta
+// CTRL_POLICY_WAIT_MS por un hueco (nunca desde callbacks de sched ni ISR).
+// Si no entra se libera: false y la política vigente no cambia
+static bool ctrl_post_policy(policy_t *p)
+{
+	uint32_t version = p->version;
+	if (ctrl_post_wait((ctrl_evt_t){ .kind = CTRL_EV_POLICY, .policy = p }, pdMS_TO_TICKS(CTRL_POLICY_WAIT_MS))) {
+		return true;
+	}
+	ESP_LOGW(TAG, "Política v%u no instalada: control_task no admite eventos", (unsigned)version);
+	policy_free(p);
+	return false;
 }
 
-static esp_err_t lcd_write_byte(uint8_t val)
+// Prototipo del acuse de órdenes remotas (cmd_ack.c) usado antes de definición
+static void cmd_ack_stage(int h, cmd_stage_t s);
+
+// Encola una credencial presentada en la puerta d (control_task aplica la
+// política); id/id_len: UID RFID o usuario remoto (opcional); cmd: orden con acuses
+static bool cred_post(door_ctx_t *d, cred_method_t method, const uint8_t *id, size_t id_len, int cmd)
 {
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (LCD_ADDR << 1) | I2C_MASTER_WRITE, true);
-	i2c_master_write_byte(cmd, val, true);
-	i2c_master_stop(cmd);
-	esp_err_t err = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(50));
-	i2c_cmd_link_delete(cmd);
-	return err;
+	cred_rec_t rec = { .method = (uint8_t)method, .cmd = (uint16_t)(cmd > 0 ? cmd : 0),
+	                   .ts_us = hal_time_us() };
+	if (id && id_len) {
+		rec.id_len = (uint8_t)(id_len < CRED_ID_MAX ? id_len : CRED_ID_MAX);
+		memcpy(rec.id, id, rec.id_len);
+	}
+	uint32_t seq;
+	portENTER_CRITICAL(&d->cred_mux);
+	cred_push_t r = cred_queue_push(&d->cred_q, &rec, &seq);
+	portEXIT_CRITICAL(&d->cred_mux);
+	if (r == CRED_PUSH_DROPPED) {
+		ESP_LOGW(TAG, "Puerta %u: cola de credenciales llena; %s #%u descartada",
+		         d->policy_id, cred_method_name(method), (unsigned)seq);
+		cmd_ack_stage(cmd, CMD_ST_DROPPED);
+		return false;
+	}
+	if (r == CRED_PUSH_QUEUED_BELL && !ctrl_post((ctrl_evt_t){ .kind = CTRL_EV_CREDENTIAL, .door = d->idx })) {
+		// Sin aviso en vuelo: que el siguiente productor lo reintente
+		portENTER_CRITICAL(&d->cred_mux);
+		cred_queue_bell_lost(&d->cred_q);
+		portEXIT_CRITICAL(&d->cred_mux);
+	}
+	return true;
 }
 
-// Versión con dirección variable (para auto-probe)
-static esp_err_t pcf8574_write_addr(uint8_t addr, uint8_t val)
+static bool ctrl_door_closed(const door_ctx_t *d)
 {
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
-	i2c_master_write_byte(cmd, val, true);
-	i2c_master_stop(cmd);
-	esp_err_t err = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(50));
-	i2c_cmd_link_delete(cmd);
-	return err;
+	portENTER_CRITICAL(&g_ctrl_mux);
+	access_state_t st = d->state_pub;
+	portEXIT_CRITICAL(&g_ctrl_mux);
+	return access_state_door_closed(st);
 }
 
-static void lcd_pulse_enable(uint8_t data)
+static const char *door_status_str(const door_ctx_t *d)
 {
-	lcd_write_byte(data | LCD_EN);
-	ets_delay_us(5);
-	lcd_write_byte(data & ~LCD_EN);
-	ets_delay_us(50);
+	return ctrl_door_closed(d) ? "close" : "open";
 }
 
-static void lcd_write4(uint8_t nibble, bool rs)
+// Plazos gestionados por sched.c (un hal_timer one-shot al más próximo)
+enum {
+	DL_LCD = 0,         // Compositor del LCD: caducidad o fin de mínimo de la cima
+	DL_TWIN,            // Cierre del cuadro de deltas al gemelo (o heartbeat)
+	DL_STATE,           // Documento retenido de estado (agrupado a STATE_MIN_MS)
+	DL_ACK,             // Vaciado de los acuses de órdenes remotas (cmd_ack.c)
+	DL_POWER,           // Informe de energía (POWER_TOPIC)
+	DL_PROF,            // Volcado del perfilado (PROF_TOPIC)
+	DL_DOOR_BASE,       // Dos por puerta: DL_RELOCK(i) y DL_UNLOCK_MAX(i)
+	DL_COUNT = DL_DOOR_BASE + 2 * DOOR_COUNT
+};
+#define DL_RELOCK(i)      (DL_DOOR_BASE + 2 * (i))      // Re-bloqueo diferido tras el cierre
+#define DL_UNLOCK_MAX(i)  (DL_DOOR_BASE + 2 * (i) + 1)  // Tiempo máximo desbloqueada sin abrir
+
+// ===== Gemelo digital: réplica de estado por deltas (twin_state.c) =====
+// control_task y pot_task anotan campos con twin_update(); DL_TWIN cierra el
+// cuadro y lo encola en el cliente MQTT sin bloquear. Ritmo máximo:
+// twin_min_ms de la configuración. Los campos autoritativos alimentan
+// además el documento retenido de STATE_TOPIC (g_state_doc, DL_STATE).
+static twin_state_t g_twin;
+static twin_state_t g_state_doc;
+static portMUX_TYPE g_twin_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Bajo g_twin_mux: así el último plazo armado es siempre el último calculado
+static void twin_arm_locked(int id, int64_t due_us, int64_t now_us)
 {
-	uint8_t data = lcd_pack_nibble(nibble, rs);
-	lcd_write_byte(data & ~(LCD_RW)); // asegurar RW=0
-	lcd_pulse_enable(data & ~(LCD_RW));
-	ets_delay_us(100); // margen adicional
+	sched_arm_in(id, due_us > now_us ? (uint32_t)((due_us - now_us + 999) / 1000) : 0);
 }
 
-static void lcd_send(uint8_t value, bool rs)
+static void twin_update(twin_field_t f, int32_t v)
 {
-    lcd_write4(value & 0xF0, rs);         // nibble alto
-    lcd_write4((value << 4) & 0xF0, rs);   // nibble bajo
-    ets_delay_us(200); // estabilizar tras byte completo
+	int64_t now = hal_time_us(), due;
+	portENTER_CRITICAL(&g_twin_mux);
+	if (twin_set(&g_twin, f, v, now, &due)) twin_arm_locked(DL_TWIN, due, now);
+	if ((STATE_DOC_FIELDS & (1u << f)) && twin_set(&g_state_doc, f, v, now, &due)) {
+		twin_arm_locked(DL_STATE, due, now);
+	}
+	portEXIT_CRITICAL(&g_twin_mux);
+}
+
+// Sesión MQTT nueva: el broker pudo reiniciarse sin el retenido
+static void state_doc_republish(void)
+{
+	int64_t now = hal_time_us(), due;
+	portENTER_CRITICAL(&g_twin_mux);
+	if (twin_request_snapshot(&g_state_doc, now, &due)) twin_arm_locked(DL_STATE, due, now);
+	portEXIT_CRITICAL(&g_twin_mux);
+}
+
+// Callback de sched (tarea esp_timer): documento completo, retenido, QoS 1
+static void state_deadline_cb(int id, void *arg)
+{
+	twin_msg_t m;
+	int64_t now = hal_time_us(), next;
+	portENTER_CRITICAL(&g_twin_mux);
+	bool send = twin_take(&g_state_doc, now, &m, &next);
+	portEXIT_CRITICAL(&g_twin_mux);
+	char buf[STATE_DOC_MAX];
+	size_t n = send ? state_doc_format(&m, DEVICE_ID, now / 1000000, buf, sizeof(buf)) : 0;
+	if (n && hal_mqtt_ready()) hal_mqtt_enqueue(STATE_TOPIC, buf, (int)n, 1, 1);
+}
+
+// Conexión al broker o petición del gemelo: instantánea en el próximo cuadro
+static void twin_resync(void)
+{
+	const app_cfg_t *cfg = cfg_acquire(&g_cfg);
+	uint32_t rate_ms = (uint32_t)cfg->twin_min_ms;
+	cfg_release(&g_cfg, cfg);
+	int64_t now = hal_time_us(), due;
+	portENTER_CRITICAL(&g_twin_mux);
+	twin_set_rate(&g_twin, rate_ms);
+	if (twin_request_snapshot(&g_twin, now, &due)) twin_arm_locked(DL_TWIN, due, now);
+	portEXIT_CRITICAL(&g_twin_mux);
+}
+
+// Callback de sched (tarea esp_timer): cierra el cuadro. Deltas y
+// heartbeats con QoS 0 (el gemelo detecta pérdidas por seq); la
+// instantánea con QoS 1. enqueue copia el mensaje y no espera a la red.
+static void twin_deadline_cb(int id, void *arg)
+{
+	twin_msg_t m;
+	int64_t now = hal_time_us(), next;
+	portENTER_CRITICAL(&g_twin_mux);
+	bool send = twin_take(&g_twin, now, &m, &next);
+	if (next != INT64_MAX) twin_arm_locked(DL_TWIN, next, now);
+	portEXIT_CRITICAL(&g_twin_mux);
+	char buf[TWIN_MSG_MAX];
+	size_t n = send ? twin_format(&m, buf, sizeof(buf)) : 0;
+	if (n && hal_mqtt_ready()) {
+		hal_mqtt_enqueue(TWIN_TOPIC, buf, (int)n, m.kind == TWIN_MSG_SNAPSHOT ? 1 : 0, 0);
+	}
 }
 
-static inline void lcd_cmd(uint8_t cmd) { lcd_send(cmd, false); }
-static inline void lcd_data(uint8_t data) { lcd_send(data, true); }
+// ===== Acuses de órdenes remotas (cmd_ack.c) =====
+// El handler MQTT registra la orden y su manejador viaja con la credencial;
+// control_task anuncia cada etapa. Los acuses esperan en el anillo de
+// g_cmd y DL_ACK los encola en el cliente MQTT desde la tarea esp_timer,
+// así control_task nunca espera al cliente.
+static cmd_tracker_t g_cmd;
+static portMUX_TYPE g_cmd_mux = portMUX_INITIALIZER_UNLOCKED;
 
-static void lcd_clear(void)
+static void cmd_ack_stage(int h, cmd_stage_t s)
 {
-	lcd_cmd(0x01);
-	vTaskDelay(pdMS_TO_TICKS(3));
-	lcd_cmd(0x02); // HOME para garantizar cursor en 0
-	vTaskDelay(pdMS_TO_TICKS(2));
+	if (h <= 0) return;
+	bool kick = false;
+	portENTER_CRITICAL(&g_cmd_mux);
+	cmd_stage(&g_cmd, h, s, hal_time_us(), &kick);
+	portEXIT_CRITICAL(&g_cmd_mux);
+	if (kick) sched_arm_in(DL_ACK, 0);
 }
 
-static void lcd_home(void)
+static void cmd_ack_advance(const door_ctx_t *d, uint32_t from_mask, cmd_stage_t s)
 {
-	lcd_cmd(0x02);
-	vTaskDelay(pdMS_TO_TICKS(2));
+	bool kick = false;
+	portENTER_CRITICAL(&g_cmd_mux);
+	cmd_advance(&g_cmd, d->policy_id, from_mask, s, hal_time_us(), &kick);
+	portEXIT_CRITICAL(&g_cmd_mux);
+	if (kick) sched_arm_in(DL_ACK, 0);
 }
 
-static void lcd_set_cursor(uint8_t col, uint8_t row)
+// Callback de sched (tarea esp_timer): QoS 1, sin retener
+static void ack_deadline_cb(int id, void *arg)
 {
-	static const uint8_t row_addr[] = {0x00, 0x40, 0x14, 0x54};
-	if (row > 1) row = 1;
-	lcd_cmd(0x80 | (row_addr[row] + col));
+	for (;;) {
+		cmd_ack_t a;
+		portENTER_CRITICAL(&g_cmd_mux);
+		bool got = cmd_ack_pop(&g_cmd, &a);
+		portEXIT_CRITICAL(&g_cmd_mux);
+		if (!got) break;
+		char buf[CMD_ACK_MSG_MAX];
+		size_t n = cmd_ack_format(&a, buf, sizeof(buf));
+		if (n && hal_mqtt_ready()) hal_mqtt_enqueue(CMD_ACK_TOPIC, buf, (int)n, 1, 0);
+	}
 }
+_Static_assert(DL_COUNT <= DEADLINE_MAX, "demasiados plazos para deadline_set_t");
+
+// =============================================================
+// ==================   PLAN DE TAREAS   ======================
+// =============================================================
+
+#ifndef CONFIG_LWIP_TCPIP_TASK_PRIO
+#define CONFIG_LWIP_TCPIP_TASK_PRIO 18
+#endif
+
+// Retraso de despertar por tarea (jitter.h): lo escribe cada tarea y lo lee
+// el informe de JITTER_BENCH
+static jitter_t g_jit[TASK_COUNT];
+static portMUX_TYPE g_jit_mux = portMUX_INITIALIZER_UNLOCKED;
 
-static void lcd_print_len(const char *s, size_t maxlen)
+static BaseType_t task_core(const task_spec_t *t)
 {
-	for (size_t i=0; i<maxlen; ++i) {
-		char c = s[i];
-		if (!c) break;
-		lcd_data((uint8_t)c);
+#if CONFIG_FREERTOS_UNICORE || !TASK_PLAN_PINNED
+	// Un solo núcleo, o el plan desactivado: todo sin afinidad
+	(void)t;
+	return tskNO_AFFINITY;
+#else
+	// Núcleo que este destino no tiene (el target linux tiene uno): sin afinidad
+	return (t->core == TASK_CORE_ANY || t->core >= portNUM_PROCESSORS) ? tskNO_AFFINITY : (BaseType_t)t->core;
+#endif
+}
+
+// Tareas permanentes: pila y TCB en .bss en vez del montículo. No fragmentan
+// el montículo, no pueden fallar por falta de memoria y tools/ram_report las
+// cuenta en el informe de RAM estática. Las transitorias (trabajadores de
+// arranque) devuelven su pila al montículo al terminar.
+static StackType_t s_stack_control[STACK_CONTROL];
+static StackType_t s_stack_pot[STACK_POT];
+static StackType_t s_stack_rfid[STACK_RFID];
+static StackType_t s_stack_lcd[STACK_LCD];
+static StackType_t s_stack_prof[STACK_PROF];
+static StackType_t *const TASK_STACK[TASK_STATIC] = {
+	[TASK_CONTROL] = s_stack_control, [TASK_POT] = s_stack_pot, [TASK_RFID] = s_stack_rfid, [TASK_LCD] = s_stack_lcd,
+	[TASK_PROF] = s_stack_prof,
+};
+static StaticTask_t s_task_tcb[TASK_STATIC];
+static TaskHandle_t g_task_h[TASK_STATIC];   // Para stack_report()
+_Static_assert(TASK_STATIC == 5, "una pila estática por tarea permanente");
+
+static void task_start(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+	const task_spec_t *t = &g_tasks[id];
+	TaskHandle_t h = NULL;
+	if (id < TASK_STATIC) {
+		h = xTaskCreateStaticPinnedToCore(fn, t->name, t->stack, arg, t->prio, TASK_STACK[id], &s_task_tcb[id],
+		                                  task_core(t));
+		g_task_h[id] = h;
+	} else if (xTaskCreatePinnedToCore(fn, t->name, t->stack, arg, t->prio, &h, task_core(t)) != pdPASS) {
+		h = NULL;
+	}
+	if (!h) ESP_LOGE(TAG, "No se pudo crear la tarea %s", t->name);
+	if (handle) *handle = h;
+}
+
+// Pico de pila de cada tarea permanente desde su creación (tamaño menos el
+// mínimo libre que registra FreeRTOS) y el tamaño que le daría
+// task_plan_stack(). {"device_id":..,"why":..,"tasks":{"control":{"size":..,
+// "peak":..,"plan":..},..},"size_b":..,"plan_b":..,"reclaim_b":..,"heap":{..}}
+// en STACK_TOPIC; tools/stack_plan lo convierte en stack_sizes.h. Solo desde
+// prof_task (búfer estático)
+static void stack_report(const char *why)
+{
+	static char buf[704];
+	uint32_t size_b = 0, plan_b = 0;
+	int n = snprintf(buf, sizeof(buf), "{\"device_id\":\"%s\",\"why\":\"%s\",\"margin_pct\":%d,\"margin_min\":%d,\"tasks\":{",
+	                 DEVICE_ID, why, TASK_STACK_MARGIN_PCT, TASK_STACK_MARGIN_MIN);
+	for (int i = 0; i < TASK_STATIC && n > 0 && n < (int)sizeof(buf); ++i) {
+		const task_spec_t *t = &g_tasks[i];
+		uint32_t peak = g_task_h[i] ? t->stack - (uint32_t)uxTaskGetStackHighWaterMark(g_task_h[i]) : 0;
+		uint32_t plan = task_plan_stack(peak, TASK_STACK_MARGIN_PCT, TASK_STACK_MARGIN_MIN);
+		size_b += t->stack;
+		plan_b += plan ? plan : t->stack;
+		n += snprintf(buf + n, sizeof(buf) - n, "%s\"%s\":{\"size\":%u,\"peak\":%u,\"plan\":%u}", i ? "," : "",
+		              t->name, (unsigned)t->stack, (unsigned)peak, (unsigned)plan);
+		if (plan > t->stack) {
+			ESP_LOGW(TAG, "Pila %-7s %u B, pico %u B: sin el margen, debería ser de %u B", t->name,
+			         (unsigned)t->stack, (unsigned)peak, (unsigned)plan);
+		} else {
+			ESP_LOGI(TAG, "Pila %-7s %u B, pico %u B (%u %%) -> %u B", t->name, (unsigned)t->stack, (unsigned)peak,
+			         (unsigned)(peak * 100 / t->stack), (unsigned)plan);
+		}
+	}
+	size_t heap_free, heap_min, heap_big;
+	hal_heap_stats(&heap_free, &heap_min, &heap_big);
+	if (n > 0 && n < (int)sizeof(buf)) {
+		n += snprintf(buf + n, sizeof(buf) - n,
+		              "},\"size_b\":%u,\"plan_b\":%u,\"reclaim_b\":%d,\"heap\":{\"free\":%u,\"min_free\":%u,\"largest\":%u}}",
+		              (unsigned)size_b, (unsigned)plan_b, (int)size_b - (int)plan_b, (unsigned)heap_free,
+		              (unsigned)heap_min, (unsigned)heap_big);
+	}
+	ESP_LOGI(TAG, "Pilas: %u B en total, %u B con el plan (%d B recuperables); montículo libre %u B (mínimo %u, bloque %u)",
+	         (unsigned)size_b, (unsigned)plan_b, (int)size_b - (int)plan_b, (unsigned)heap_free, (unsigned)heap_min,
+	         (unsigned)heap_big);
+	if (n > 0 && n < (int)sizeof(buf)) {
+		if (hal_mqtt_ready()) hal_mqtt_enqueue(STACK_TOPIC, buf, n, 1, 0);
+	} else {
+		ESP_LOGE(TAG, "Informe de pilas truncado");
 	}
 }
 
-static void lcd_init(void)
+// Prioridades a partir de los plazos; se llama antes de crear ninguna tarea
+static void task_plan_init(void)
 {
-    i2c_bus_init();
-    vTaskDelay(pdMS_TO_TICKS(120));
-    // Secuencia idéntica a auto-probe
-    lcd_write4(0x30, false); vTaskDelay(pdMS_TO_TICKS(5));
-    lcd_write4(0x30, false); vTaskDelay(pdMS_TO_TICKS(2));
-    lcd_write4(0x30, false); vTaskDelay(pdMS_TO_TICKS(2));
-    lcd_write4(0x20, false); vTaskDelay(pdMS_TO_TICKS(2)); // Entrar a 4-bit
-    lcd_cmd(0x28); // 2 líneas, 5x8
-    lcd_cmd(0x0C); // Display ON
-    lcd_cmd(0x06); // Entry mode
-    lcd_clear();
-    g_lcd_mutex = xSemaphoreCreateMutex();
+	if (!task_plan_assign(g_tasks, TASK_COUNT, TASK_PRIO_LO, TASK_PRIO_HI)) {
+		ESP_LOGE(TAG, "El plan de tareas no cabe en las prioridades %d..%d", TASK_PRIO_LO, TASK_PRIO_HI);
+		abort();
+	}
+	g_tasks[TASK_BENCH].prio = CONFIG_LWIP_TCPIP_TASK_PRIO;
+	for (int i = 0; i < TASK_COUNT; ++i) jitter_init(&g_jit[i]);
+	for (int i = 0; i < TASK_BENCH; ++i) {
+		const task_spec_t *t = &g_tasks[i];
+		ESP_LOGI(TAG, "Tarea %-7s plazo %4u ms -> prioridad %u, núcleo %s", t->name, (unsigned)t->deadline_ms,
+		         t->prio, task_core(t) == tskNO_AFFINITY ? "cualquiera" : (t->core == TASK_CORE_APP ? "1" : "0"));
+	}
 }
 
-#ifndef LCD_DEBUG_PATTERN
-#define LCD_DEBUG_PATTERN 1
-#endif
+// vTaskDelay que mide el retraso con que la tarea vuelve a ejecutarse
+// respecto al tick en que vence la espera
+static void task_sleep(task_id_t id, TickType_t ticks)
+{
+	TickType_t wake = xTaskGetTickCount();
+	xTaskDelayUntil(&wake, ticks); // Deja en wake el tick de vencimiento
+	int64_t now = hal_time_us();
+	portENTER_CRITICAL(&g_jit_mux);
+	jitter_wake(&g_jit[id], now, (uint32_t)wake, portTICK_PERIOD_MS * 1000);
+	portEXIT_CRITICAL(&g_jit_mux);
+}
 
-static void lcd_debug_pattern(void)
+static void task_late(task_id_t id, int64_t late_us)
 {
-	// Patrón de diagnóstico para verificar mapeo estable sin interferencias
-	lcd_clear();
-	lcd_set_cursor(0,0); lcd_print_len("ADDR27 VAR0 OK", 16);
-	lcd_set_cursor(0,1); lcd_print_len("ABCDEFGHIJKLMN", 16);
-	vTaskDelay(pdMS_TO_TICKS(1200));
-	lcd_clear();
-	lcd_set_cursor(0,0); lcd_print_len("0123456789.,:?", 16);
-	lcd_set_cursor(0,1); lcd_print_len("RF=READY POT=OK", 16);
-	vTaskDelay(pdMS_TO_TICKS(1500));
+	portENTER_CRITICAL(&g_jit_mux);
+	jitter_add(&g_jit[id], late_us);
+	portEXIT_CRITICAL(&g_jit_mux);
 }
 
-#if LCD_AUTOPROBE
-// ================= Auto-probe visual en arranque =================
-// Construye el byte segun variante (0..5) para un nibble alto D7..D4
-static inline uint8_t pack_by_variant_runtime(int variant, uint8_t hi_nibble, bool rs)
+#if JITTER_BENCH
+// Informe de una ventana y puesta a cero: {"device_id":..,"window_ms":..,
+// "pinned":..,"tasks":{"control":{"n":..,"p50_us":..,...},...}}
+static void jitter_report(void)
 {
-	switch (variant) {
-		case 0: { // P0=RS,P1=RW,P2=EN,P3=BL,P4..P7=D4..D7
-			uint8_t data = (hi_nibble & 0xF0) | 0x08 | (rs ? 0x01 : 0);
-			return data;
-		}
-		case 1: { // P0..P3=D4..D7, P4=BL, P5=EN, P6=RW, P7=RS
-			uint8_t lower = (hi_nibble >> 4) & 0x0F;
-			uint8_t data = lower | 0x10 | (rs ? 0x80 : 0);
-			return data;
+	static const task_id_t SHOWN[] = { TASK_CONTROL, TASK_POT, TASK_RFID };
+	jitter_t snap[TASK_COUNT];
+	portENTER_CRITICAL(&g_jit_mux);
+	memcpy(snap, g_jit, sizeof(snap));
+	for (int i = 0; i < TASK_COUNT; ++i) {
+		bool anchored = g_jit[i].anchored;
+		int64_t off = g_jit[i].offset_us;
+		jitter_init(&g_jit[i]);
+		g_jit[i].anchored = anchored; // El desfase del tick sigue valiendo
+		g_jit[i].offset_us = off;
+	}
+	portEXIT_CRITICAL(&g_jit_mux);
+	char buf[512];
+	int n = snprintf(buf, sizeof(buf), "{\"device_id\":\"%s\",\"window_ms\":%d,\"pinned\":%s,\"tasks\":{",
+	                 DEVICE_ID, JITTER_REPORT_MS, TASK_PLAN_PINNED ? "true" : "false");
+	for (size_t k = 0; k < sizeof(SHOWN) / sizeof(SHOWN[0]) && n > 0 && n < (int)sizeof(buf); ++k) {
+		const jitter_t *j = &snap[SHOWN[k]];
+		n += snprintf(buf + n, sizeof(buf) - n, "%s\"%s\":", k ? "," : "", g_tasks[SHOWN[k]].name);
+		if (n < (int)sizeof(buf)) n += (int)jitter_json(j, buf + n, sizeof(buf) - n);
+		ESP_LOGI(TAG, "Retraso %-7s n=%u p50=%lld p99=%lld máx=%lld us", g_tasks[SHOWN[k]].name, (unsigned)j->n,
+		         (long long)jitter_pct_us(j, 0.50), (long long)jitter_pct_us(j, 0.99), (long long)j->max_us);
+	}
+	if (n > 0 && n + 3 <= (int)sizeof(buf)) {
+		n += snprintf(buf + n, sizeof(buf) - n, "}}");
+		if (hal_mqtt_ready()) hal_mqtt_enqueue(JITTER_TOPIC, buf, n, 1, 0);
+	}
+}
+
+// Carga de red sintética en el núcleo de red, a la prioridad de lwIP: CPU
+// ocupada NETLOAD_BUSY_US de cada NETLOAD_PERIOD_MS y ráfagas de
+// publicaciones que ejercitan WiFi, lwIP y el cliente MQTT de verdad
+static void netload_task(void *arg)
+{
+	static char junk[512];
+	memset(junk, 'x', sizeof(junk) - 1);
+	TickType_t last = xTaskGetTickCount();
+	int64_t report_at = hal_time_us() + (int64_t)JITTER_REPORT_MS * 1000;
+	for (uint32_t k = 0;; ++k) {
+		int64_t until = hal_time_us() + NETLOAD_BUSY_US;
+		while (hal_time_us() < until) {
 		}
-		case 2: { // P0..P3=D4..D7, P4=EN, P5=RW, P6=RS, P7=BL
-			uint8_t lower = (hi_nibble >> 4) & 0x0F;
-			uint8_t data = lower | 0x10 | 0x80 | (rs ? 0x40 : 0);
-			return data;
+		if (k % 10 == 0 && hal_mqtt_ready()) {
+			for (int i = 0; i < NETLOAD_BURST; ++i) hal_mqtt_enqueue(JITTER_TOPIC "/load", junk, 0, 0, 0);
 		}
-		case 3: { // P0=RS,P1=RW,P2=EN,P3=BL,P4..P7=D7..D4
-			uint8_t d7 = (hi_nibble & 0x80) ? 0x10 : 0x00;
-			uint8_t d6 = (hi_nibble & 0x40) ? 0x20 : 0x00;
-			uint8_t d5 = (hi_nibble & 0x20) ? 0x40 : 0x00;
-			uint8_t d4 = (hi_nibble & 0x10) ? 0x80 : 0x00;
-			uint8_t data = d7 | d6 | d5 | d4 | 0x08 | (rs ? 0x01 : 0);
-			return data;
+		if (hal_time_us() >= report_at) {
+			jitter_report();
+			report_at += (int64_t)JITTER_REPORT_MS * 1000;
 		}
-		case 4: { // P0..P3=D7..D4, P4=BL, P5=EN, P6=RW, P7=RS
-			uint8_t p0 = (hi_nibble & 0x80) ? 0x01 : 0x00;
-			uint8_t p1 = (hi_nibble & 0x40) ? 0x02 : 0x00;
-			uint8_t p2 = (hi_nibble & 0x20) ? 0x04 : 0x00;
-			uint8_t p3 = (hi_nibble & 0x10) ? 0x08 : 0x00;
-			uint8_t data = p0 | p1 | p2 | p3 | 0x10 | (rs ? 0x80 : 0);
-			return data;
+		xTaskDelayUntil(&last, pdMS_TO_TICKS(NETLOAD_PERIOD_MS));
+	}
+}
+#endif
+
+// =============================================================
+// =====================   ENERGÍA   ==========================
+// =============================================================
+
+// Perfil vigente (power_prof.h); lo leen pot_task y rfid_task en cada vuelta
+static volatile uint8_t g_power_id = POWER_PROFILE;
+_Static_assert(POWER_PROF_COUNT == 3, "el rango de \"power\" en app_config.c es 0..2");
+static int64_t g_power_slept0_us;
+static uint32_t g_power_wakeups0;
+static uint32_t g_power_idle0_us;
+static int64_t g_power_t0_us;
+
+static const power_prof_t *power_prof(void)
+{
+	return &power_profiles[g_power_id];
+}
+
+// DFS, sueño ligero y ahorro de la radio; en ejecución al cambiar "power"
+static void power_apply(int id)
+{
+	if (id < 0 || id >= POWER_PROF_COUNT) id = POWER_PROFILE;
+	const power_prof_t *p = &power_profiles[id];
+	bool pm = hal_pm_config(p->cpu_max_mhz, p->cpu_min_mhz, p->light_sleep);
+	hal_net_power_save(p->wifi_listen);
+	g_power_id = (uint8_t)id;
+	ESP_LOGI(TAG, "Energía: perfil %s, CPU %u-%u MHz, sueño ligero %s, radio %d, RFID cada %u ms%s", p->name,
+	         p->cpu_min_mhz, p->cpu_max_mhz, (pm && p->light_sleep) ? "sí" : "no", p->wifi_listen, p->rfid_ms,
+	         pm ? "" : " (sin CONFIG_PM_ENABLE)");
+}
+
+// Callback de sched (tarea esp_timer): tiempo en sueño ligero de la ventana,
+// tiempo fuera de IDLE (cota del trabajo a la frecuencia máxima: lo que corre
+// sin cerrojo de DFS va a la mínima) y corriente media que les corresponde
+// según el modelo de power_prof.c
+static void power_deadline_cb(int id, void *arg)
+{
+	int64_t slept_us, now = hal_time_us();
+	uint32_t wakeups, idle_us;
+	hal_pm_stats(&slept_us, &wakeups);
+	bool have_idle = hal_pm_idle_us(&idle_us);
+	int64_t win_us = now - g_power_t0_us;
+	double sleep = win_us > 0 ? (double)(slept_us - g_power_slept0_us) / win_us : 0;
+	double busy = 0;
+	if (have_idle && win_us > 0) busy = 1.0 - (double)(uint32_t)(idle_us - g_power_idle0_us) / portNUM_PROCESSORS / win_us;
+	if (busy < 0) busy = 0;
+	const power_prof_t *p = power_prof();
+	char buf[192];
+	int n = snprintf(buf, sizeof(buf),
+	                 "{\"device_id\":\"%s\",\"profile\":\"%s\",\"window_ms\":%lld,\"sleep_pct\":%.1f,"
+	                 "\"busy_pct\":%.1f,\"wakeups\":%u,\"est_ma\":%.1f}",
+	                 DEVICE_ID, p->name, (long long)(win_us / 1000), sleep * 100, busy * 100,
+	                 (unsigned)(wakeups - g_power_wakeups0), power_est_ma(p, sleep, busy, DOOR_COUNT));
+	ESP_LOGI(TAG, "Energía: %s", buf);
+	if (n > 0 && n < (int)sizeof(buf) && hal_mqtt_ready()) hal_mqtt_enqueue(POWER_TOPIC, buf, n, 0, 0);
+	g_power_t0_us = now;
+	g_power_slept0_us = slept_us;
+	g_power_wakeups0 = wakeups;
+	g_power_idle0_us = idle_us;
+	sched_arm_in(DL_POWER, POWER_REPORT_MS);
+}
+
+// =============================================================
+// ====================   PERFILADO   =========================
+// =============================================================
+// Se activa en ejecución por PROF_CTRL_TOPIC. Con el perfilado activo, cada
+// PROF_REPORT_MS (o al pedir "dump") se vuelca en PROF_TOPIC, y por consola
+// con "uart", una ventana con:
+//  - tasks: CPU de cada tarea (100 = un núcleo entero) según los contadores
+//    de tiempo de ejecución de FreeRTOS, prioridad, núcleo y pila libre
+//  - locks: espera y retención de g_log_mutex y g_lcd_mutex (prof.h)
+//  - pcs:   PCs más frecuentes de cada núcleo, sin resolver (tools/prof_sym)
+// prof_task es la única que arranca, para y vuelca: hal_prof_start/stop
+// esperan a una tarea por núcleo y el volcado formatea unos 6 KB, nada de eso
+// cabe en la tarea esp_timer. El callback de DL_PROF y las peticiones de MQTT
+// solo la despiertan.
+
+// Muestras de PC: la ISR de cada núcleo escribe en la suya, bajo g_prof_mux
+static prof_pcs_t g_prof_pcs[portNUM_PROCESSORS];
+static bool g_prof_uart;
+static uint32_t g_prof_hz;      // Muestreo vigente; 0: sin muestreo de PC (destino sin soporte)
+static int64_t g_prof_t0_us;
+
+typedef struct {
+	bool set;                   // false: solo volcar
+	bool on, uart;
+	bool stack;                 // Publicar también stack_report()
+	const char *why;            // Motivo del informe de pilas; NULL: "request"
+	uint32_t hz;
+} prof_req_t;
+static prof_req_t g_prof_req;   // Bajo g_prof_mux
+static bool g_prof_req_pending;
+static TaskHandle_t g_prof_task;
+
+#define PROF_TASKS_MAX 32
+#define PROF_DUMP_MAX 6144
+
+// Contador de tiempo de ejecución de cada tarea al empezar la ventana
+typedef struct {
+	TaskHandle_t h;
+	uint32_t run;
+} prof_run_t;
+static prof_run_t g_prof_run0[PROF_TASKS_MAX];
+static size_t g_prof_nrun0;
+
+static void prof_pc_sample(int core, uint32_t pc, void *arg)
+{
+	portENTER_CRITICAL_ISR(&g_prof_mux);
+	prof_pcs_add(&g_prof_pcs[core], pc);
+	portEXIT_CRITICAL_ISR(&g_prof_mux);
+}
+
+// Petición desde la tarea MQTT (o el arranque); la atiende prof_task
+static void prof_request(prof_req_t r)
+{
+	portENTER_CRITICAL(&g_prof_mux);
+	g_prof_req = r;
+	g_prof_req_pending = true;
+	portEXIT_CRITICAL(&g_prof_mux);
+	if (g_prof_task) xTaskNotifyGive(g_prof_task);
+}
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+// [{"name":..,"core":..,"prio":..,"cpu_pct":..,"stack_free":..},..] desde el
+// inicio de la ventana (contador de 32 bits en us: vale hasta 71 min), y
+// abre la siguiente. buf NULL: solo abre la ventana
+static int prof_tasks_json(char *buf, size_t cap, int64_t win_us)
+{
+	static TaskStatus_t st[PROF_TASKS_MAX];
+	uint32_t total;
+	UBaseType_t n = uxTaskGetSystemState(st, PROF_TASKS_MAX, &total);
+	int len = buf ? snprintf(buf, cap, "[") : 0;
+	for (UBaseType_t i = 0; buf && i < n && len > 0 && len < (int)cap; ++i) {
+		uint32_t run0 = 0;
+		for (size_t k = 0; k < g_prof_nrun0; ++k) {
+			if (g_prof_run0[k].h == st[i].xHandle) run0 = g_prof_run0[k].run;
 		}
-		case 5: { // P0..P3=D7..D4, P4=EN, P5=RW, P6=RS, P7=BL
-			uint8_t p0 = (hi_nibble & 0x80) ? 0x01 : 0x00;
-			uint8_t p1 = (hi_nibble & 0x40) ? 0x02 : 0x00;
-			uint8_t p2 = (hi_nibble & 0x20) ? 0x04 : 0x00;
-			uint8_t p3 = (hi_nibble & 0x10) ? 0x08 : 0x00;
-			uint8_t data = p0 | p1 | p2 | p3 | 0x10 | 0x80 | (rs ? 0x40 : 0);
-			return data;
+		BaseType_t core = xTaskGetCoreID(st[i].xHandle);
+		len += snprintf(buf + len, cap - len, "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"cpu_pct\":%.1f,\"stack_free\":%u}",
+		                i ? "," : "", st[i].pcTaskName, core == tskNO_AFFINITY ? -1 : (int)core,
+		                (unsigned)st[i].uxCurrentPriority,
+		                win_us > 0 ? (double)(uint32_t)(st[i].ulRunTimeCounter - run0) * 100.0 / win_us : 0.0,
+		                (unsigned)st[i].usStackHighWaterMark);
+	}
+	if (buf && len > 0 && len < (int)cap) len += snprintf(buf + len, cap - len, "]");
+	for (UBaseType_t i = 0; i < n; ++i) g_prof_run0[i] = (prof_run_t){ st[i].xHandle, (uint32_t)st[i].ulRunTimeCounter };
+	g_prof_nrun0 = n;
+	if (!n) ESP_LOGW(TAG, "Perfilado: más de %d tareas, sin tiempos por tarea", PROF_TASKS_MAX);
+	return (len > 0 && len < (int)cap) ? len : 0;
+}
+#else
+static int prof_tasks_json(char *buf, size_t cap, int64_t win_us)
+{
+	// Sin CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS / USE_TRACE_FACILITY
+	return buf ? snprintf(buf, cap, "[]") : 0;
+}
+#endif
+
+// Cierra la ventana: copia y pone a cero muestras y mutex bajo el cerrojo
+// (unos 4 KB) y abre la siguiente
+static void prof_window(prof_pcs_t *pcs, prof_lock_t *locks)
+{
+	portENTER_CRITICAL(&g_prof_mux);
+	if (pcs) memcpy(pcs, g_prof_pcs, sizeof(g_prof_pcs));
+	if (locks) memcpy(locks, g_prof_lock, sizeof(g_prof_lock));
+	for (int c = 0; c < portNUM_PROCESSORS; ++c) prof_pcs_reset(&g_prof_pcs[c]);
+	for (int i = 0; i < PROF_LOCK_COUNT; ++i) prof_lock_reset(&g_prof_lock[i]);
+	portEXIT_CRITICAL(&g_prof_mux);
+}
+
+// Solo desde prof_task: búferes estáticos
+static void prof_dump(void)
+{
+	static prof_pcs_t pcs[portNUM_PROCESSORS];
+	static char buf[PROF_DUMP_MAX];
+	prof_lock_t locks[PROF_LOCK_COUNT];
+	int64_t now = hal_time_us(), win_us = now - g_prof_t0_us;
+	prof_window(pcs, locks);
+	g_prof_t0_us = now;
+	size_t cap = sizeof(buf);
+	int n = snprintf(buf, cap, "{\"device_id\":\"%s\",\"window_ms\":%lld,\"hz\":%u,\"tasks\":", DEVICE_ID,
+	                 (long long)(win_us / 1000), (unsigned)g_prof_hz);
+	int w = prof_tasks_json(buf + n, cap - n, win_us);
+	n = w ? n + w : 0;
+	for (int i = 0; i < PROF_LOCK_COUNT && n > 0 && n < (int)cap; ++i) {
+		n += snprintf(buf + n, cap - n, "%s\"%s\":", i ? "," : ",\"locks\":{", PROF_LOCK_NAME[i]);
+		w = n < (int)cap ? (int)prof_lock_json(&locks[i], buf + n, cap - n) : 0;
+		n = w ? n + w : 0;
+	}
+	for (int c = 0; c < portNUM_PROCESSORS && n > 0 && n < (int)cap; ++c) {
+		n += snprintf(buf + n, cap - n, "%s", c ? "," : "},\"pcs\":[");
+		w = n < (int)cap ? (int)prof_pcs_json(&pcs[c], c, PROF_TOP_PCS, buf + n, cap - n) : 0;
+		n = w ? n + w : 0;
+	}
+	if (n > 0 && n + 3 <= (int)cap) {
+		n += snprintf(buf + n, cap - n, "]}");
+		if (hal_mqtt_ready()) hal_mqtt_enqueue(PROF_TOPIC, buf, n, 0, 0);
+		if (g_prof_uart) ESP_LOGI(TAG, "PROF %s", buf);
+	} else {
+		ESP_LOGE(TAG, "Perfilado: el volcado no cabe en %d bytes", PROF_DUMP_MAX);
+	}
+	const prof_lock_t *lg = &locks[PROF_LOCK_LOG], *lc = &locks[PROF_LOCK_LCD];
+	ESP_LOGI(TAG, "Perfilado: %lld ms, %u+%u muestras; log espera p99 %u us retención p99 %u us; lcd %u / %u us",
+	         (long long)(win_us / 1000), (unsigned)pcs[0].samples, (unsigned)pcs[portNUM_PROCESSORS - 1].samples,
+	         (unsigned)prof_hist_pct_us(&lg->wait, 0.99), (unsigned)prof_hist_pct_us(&lg->hold, 0.99),
+	         (unsigned)prof_hist_pct_us(&lc->wait, 0.99), (unsigned)prof_hist_pct_us(&lc->hold, 0.99));
+}
+
+// Vuelca la ventana, atiende la petición y rearma el plazo
+static void prof_serve(bool pending, prof_req_t r)
+{
+	if (g_prof_on) prof_dump();
+	if (pending && r.stack) stack_report(r.why ? r.why : "request");
+	if (pending && r.set) {
+		g_prof_uart = r.uart;
+		if (!r.on && g_prof_on) {
+			hal_prof_stop();
+			g_prof_on = false;
+			g_prof_hz = 0;
+			ESP_LOGI(TAG, "Perfilado desactivado");
+		} else if (r.on && (!g_prof_on || r.hz != g_prof_hz)) {
+			if (g_prof_on) hal_prof_stop();
+			prof_window(NULL, NULL);
+			prof_tasks_json(NULL, 0, 0);
+			g_prof_t0_us = hal_time_us();
+			g_prof_hz = hal_prof_start(r.hz, prof_pc_sample, NULL) ? r.hz : 0;
+			g_prof_on = true;
+			ESP_LOGI(TAG, "Perfilado activo: PC a %u Hz%s, volcado cada %d ms%s", (unsigned)r.hz,
+			         g_prof_hz ? "" : " (no disponible)", PROF_REPORT_MS, g_prof_uart ? " también por consola" : "");
 		}
-		default:
-			return 0x00;
 	}
+	if (g_prof_on) sched_arm_in(DL_PROF, PROF_REPORT_MS);
 }
 
-static void lcd_pulse_enable_addr(uint8_t addr, uint8_t data, int variant)
+// Callback de sched (tarea esp_timer): fin de ventana, lo atiende prof_task
+static void prof_deadline_cb(int id, void *arg)
 {
-	// EN mask per variant
-	uint8_t en_mask = 0;
-	switch (variant) {
-		case 0: case 3: en_mask = 0x04; break;      // P2
-		case 1: case 4: en_mask = 0x20; break;      // P5
-		case 2: case 5: en_mask = 0x10; break;      // P4
-	}
-	pcf8574_write_addr(addr, data | en_mask);
-	ets_delay_us(5);
-	pcf8574_write_addr(addr, data & ~en_mask);
-	ets_delay_us(50);
+	if (g_prof_task) xTaskNotifyGive(g_prof_task);
 }
 
-static void lcd_write4_addr(uint8_t addr, uint8_t nibble, bool rs, int variant)
+// Vuelca la ventana y atiende la última petición en cada aviso
+static void prof_task(void *arg)
 {
-	uint8_t data = pack_by_variant_runtime(variant, nibble, rs);
-	pcf8574_write_addr(addr, data);
-	lcd_pulse_enable_addr(addr, data, variant);
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		portENTER_CRITICAL(&g_prof_mux);
+		bool pending = g_prof_req_pending;
+		prof_req_t r = g_prof_req;
+		g_prof_req_pending = false;
+		portEXIT_CRITICAL(&g_prof_mux);
+		prof_serve(pending, r);
+	}
 }
 
-static void lcd_send_addr(uint8_t addr, uint8_t value, bool rs, int variant)
+// PROF_CTRL_TOPIC: {"on":true,"hz":997,"uart":false}, {"on":false}, {"dump":true}
+// o {"stack":true} (informe de pilas en STACK_TOPIC)
+static void prof_rx(const hal_mqtt_event_t *event)
 {
-	lcd_write4_addr(addr, value & 0xF0, rs, variant);
-	lcd_write4_addr(addr, (value << 4) & 0xF0, rs, variant);
+	char buf[128];
+	int len = event->data_len < (int)sizeof(buf) - 1 ? event->data_len : (int)sizeof(buf) - 1;
+	memcpy(buf, event->data, len);
+	buf[len] = '\0';
+	cJSON *json = cJSON_Parse(buf);
+	if (!json) {
+		ESP_LOGW(TAG, "Perfilado: orden no es JSON");
+		return;
+	}
+	cJSON *on = cJSON_GetObjectItem(json, "on");
+	cJSON *hz = cJSON_GetObjectItem(json, "hz");
+	cJSON *uart = cJSON_GetObjectItem(json, "uart");
+	prof_req_t r = { .set = cJSON_IsBool(on), .on = cJSON_IsTrue(on), .uart = cJSON_IsTrue(uart), .hz = PROF_HZ,
+	                 .stack = cJSON_IsTrue(cJSON_GetObjectItem(json, "stack")) };
+	if (cJSON_IsNumber(hz) && hz->valuedouble >= 1 && hz->valuedouble <= 10000) r.hz = (uint32_t)hz->valuedouble;
+	cJSON_Delete(json);
+	prof_request(r);
 }
 
-static inline void lcd_cmd_addr(uint8_t addr, uint8_t cmd, int variant){ lcd_send_addr(addr, cmd, false, variant); }
-static inline void lcd_data_addr(uint8_t addr, uint8_t data, int variant){ lcd_send_addr(addr, data, true, variant); }
+// Potenciómetro estado
+static int64_t g_last_pot_print_us = 0;
+
+// pot_task: el controlador le notifica para reiniciar la combinación al bloquear
+static TaskHandle_t g_pot_task = NULL;
+// Prototipo de feedback (buzzer/LED) usado antes de definición
+static void fb_post(fb_pattern_t id);
+// =============================================================
+// ====================   LCD1602 (I2C)   =====================
+// =============================================================
+
+#define I2C_SDA_GPIO              21
+#define I2C_SCL_GPIO              22
+#define I2C_FREQ_HZ               50000  // Reducido para mayor margen frente a ruido
+#define LCD_ADDR                  0x27  // Confirmado por usuario
+// Auto-probe deshabilitado (ya identificamos mapeo correcto)
+#ifndef LCD_AUTOPROBE
+#define LCD_AUTOPROBE 0
+#endif
+
+// PCF8574 pin mapping variants: tabla lcd_pinmaps en lcd_xfer.c (0..5)
+#ifndef LCD_PINMAP_VARIANT
+#define LCD_PINMAP_VARIANT 0
+#endif
+#if LCD_PINMAP_VARIANT < 0 || LCD_PINMAP_VARIANT >= LCD_PINMAP_VARIANTS
+#error "Unsupported LCD_PINMAP_VARIANT"
+#endif
+
+static SemaphoreHandle_t g_lcd_mutex;
+static StaticSemaphore_t s_lcd_mutex_buf;
+// Peticiones de pantalla pendientes (lcd_queue.c); bajo g_lcd_mutex
+static lcd_queue_t g_lcd_q;
+static TaskHandle_t g_lcd_task = NULL;
+// Notificaciones a lcd_task (bits de xTaskNotify)
+#define LCD_NTF_DIRTY    (1u<<0)
+#define LCD_NTF_DEADLINE (1u<<1)
 
-static void lcd_clear_addr(uint8_t addr, int variant){ lcd_cmd_addr(addr, 0x01, variant); vTaskDelay(pdMS_TO_TICKS(2)); }
-static void lcd_set_cursor_addr(uint8_t addr, uint8_t col, uint8_t row, int variant){ static const uint8_t row_addr[] = {0x00,0x40,0x14,0x54}; if(row>1) row=1; lcd_cmd_addr(addr, 0x80 | (row_addr[row] + col), variant);} 
+// Transferencias al LCD (hal_i2c_write: una escritura y la tarea duerme
+// hasta el fin, sin esperas activas). Un solo usuario a la vez: el paso de
+// arranque "lcd" y después lcd_task
+static lcd_drv_t g_lcd;
 
-static void lcd_print_addr(uint8_t addr, const char* s, int variant)
+// lcd_port_t del firmware: envía el buffer en una sola escritura; el bus
+// marca los tiempos del HD44780 (ver lcd_xfer.h). Otras direcciones
+// (auto-probe) van por un dispositivo temporal
+static bool lcd_i2c_write(void *ctx, uint8_t addr, const uint8_t *buf, size_t len)
 {
-	for (; *s; ++s) lcd_data_addr(addr, (uint8_t)*s, variant);
+	return hal_i2c_write(addr, I2C_FREQ_HZ, buf, len);
 }
 
-static void lcd_probe_show(uint8_t addr, int variant)
+static const lcd_port_t k_lcd_port = { .write = lcd_i2c_write, .ctx = NULL };
+
+static void lcd_init(void)
+{
+    hal_i2c_init(g_pins.i2c_sda, g_pins.i2c_scl);
+    hal_i2c_add(LCD_ADDR, I2C_FREQ_HZ);
+    lcd_drv_setup(&g_lcd, &k_lcd_port, LCD_ADDR, LCD_PINMAP_VARIANT, I2C_FREQ_HZ);
+    vTaskDelay(pdMS_TO_TICKS(120));
+    // Secuencia idéntica a auto-probe, en una sola transferencia
+    lcd_drv_init(&g_lcd);
+    lcd_queue_init(&g_lcd_q);
+    g_lcd_mutex = xSemaphoreCreateMutexStatic(&s_lcd_mutex_buf);
+}
+
+#ifndef LCD_DEBUG_PATTERN
+#define LCD_DEBUG_PATTERN 1
+#endif
+
+static void lcd_debug_pattern(void)
 {
-	// Secuencia de init 4-bit por dirección/variante
-	lcd_write4_addr(addr, 0x30, false, variant); vTaskDelay(pdMS_TO_TICKS(5));
-	lcd_write4_addr(addr, 0x30, false, variant); vTaskDelay(pdMS_TO_TICKS(1));
-	lcd_write4_addr(addr, 0x30, false, variant); vTaskDelay(pdMS_TO_TICKS(1));
-	lcd_write4_addr(addr, 0x20, false, variant); vTaskDelay(pdMS_TO_TICKS(1));
-	lcd_cmd_addr(addr, 0x28, variant);
-	lcd_cmd_addr(addr, 0x0C, variant);
-	lcd_cmd_addr(addr, 0x06, variant);
-	lcd_clear_addr(addr, variant);
-	char l1[17]; snprintf(l1, sizeof(l1), "ADDR %02X VAR %d", addr, variant);
-	lcd_set_cursor_addr(addr, 0, 0, variant); lcd_print_addr(addr, l1, variant);
-	lcd_set_cursor_addr(addr, 0, 1, variant); lcd_print_addr(addr, "HELLO 1602", variant);
+	// Patrón de diagnóstico para verificar mapeo estable sin interferencias
+	lcd_drv_show_raw(&g_lcd, "ADDR27 VAR0 OK", "ABCDEFGHIJKLMN");
+	vTaskDelay(pdMS_TO_TICKS(1200));
+	lcd_drv_show_raw(&g_lcd, "0123456789.,:?", "RF=READY POT=OK");
+	vTaskDelay(pdMS_TO_TICKS(1500));
 }
 
+#if LCD_AUTOPROBE
+// ================= Auto-probe visual en arranque =================
 static void lcd_autoprobe_run(void)
 {
 	ESP_LOGI(TAG, "LCD auto-probe iniciado");
-	i2c_bus_init();
+	hal_i2c_init(g_pins.i2c_sda, g_pins.i2c_scl);
 	vTaskDelay(pdMS_TO_TICKS(100));
+	static lcd_drv_t probe;
 	const uint8_t addrs[] = {0x27, 0x3F};
 	for (size_t ai=0; ai<sizeof(addrs); ++ai) {
 		uint8_t addr = addrs[ai];
-		for (int v=0; v<=5; ++v) {
+		for (int v=0; v<LCD_PINMAP_VARIANTS; ++v) {
 			ESP_LOGI(TAG, "Probe addr 0x%02X var %d", addr, v);
-			lcd_probe_show(addr, v);
+			lcd_drv_probe_show(&probe, &k_lcd_port, addr, v, I2C_FREQ_HZ);
 			// beep cortito para marcar cambio
-			buzzer_play_ms(60, 300);
+			fb_post(FB_PROBE);
 			vTaskDelay(pdMS_TO_TICKS(1500));
 		}
 	}
@@ -639,57 +1262,97 @@ static void lcd_autoprobe_run(void)
 }
 #endif // LCD_AUTOPROBE
 
-static void lcd_set_message(const char *l1, const char *l2)
+// Peticiones de pantalla (lcd_queue.h): clave = quién escribe
+enum {
+	LCD_KEY_IDLE = 0,      // Bienvenida, siempre en el fondo
+	LCD_KEY_PROGRESS,      // Progreso de la combinación (pot_task)
+	LCD_KEY_RESULT,        // Concedido / denegado / LOCKING...
+};
+#define LCD_PRIO_IDLE      0
+#define LCD_PRIO_MSG       1   // Progreso y resultados: gana el más reciente tras su mínimo
+#define LCD_PRIO_LOCKING   2
+
+// Publica bajo g_lcd_mutex y despierta al compositor si la cima puede cambiar
+static void lcd_post(uint8_t key, uint8_t prio, uint32_t min_ms, uint32_t ttl_ms, const char *l1, const char *l2)
 {
 	if (!g_lcd_mutex) return;
-	xSemaphoreTake(g_lcd_mutex, portMAX_DELAY);
-	snprintf(g_lcd_line1, sizeof(g_lcd_line1), "%-16.16s", l1 ? l1 : "");
-	snprintf(g_lcd_line2, sizeof(g_lcd_line2), "%-16.16s", l2 ? l2 : "");
-	g_lcd_dirty = true;
-	xSemaphoreGive(g_lcd_mutex);
+	lock_take(g_lcd_mutex, PROF_LOCK_LCD);
+	bool wake = lcd_queue_post(&g_lcd_q, key, prio, min_ms, ttl_ms, l1, l2, hal_time_us());
+	lock_give(g_lcd_mutex, PROF_LOCK_LCD);
+	if (wake && g_lcd_task) xTaskNotify(g_lcd_task, LCD_NTF_DIRTY, eSetBits);
 }
 
-static void touch_activity(void)
+static void lcd_cancel(uint8_t key)
 {
-	g_last_activity_us = esp_timer_get_time();
+	if (!g_lcd_mutex) return;
+	lock_take(g_lcd_mutex, PROF_LOCK_LCD);
+	bool wake = lcd_queue_cancel(&g_lcd_q, key);
+	lock_give(g_lcd_mutex, PROF_LOCK_LCD);
+	if (wake && g_lcd_task) xTaskNotify(g_lcd_task, LCD_NTF_DIRTY, eSetBits);
+}
+
+// Sin actividad, progreso y resultados caducan y vuelve la bienvenida
+static uint32_t lcd_idle_ms(void)
+{
+	const app_cfg_t *cfg = cfg_acquire(&g_cfg);
+	uint32_t ms = (uint32_t)cfg->lcd_idle_ms;
+	cfg_release(&g_cfg, cfg);
+	return ms;
 }
 
 static void lcd_show_idle(void)
 {
-	lcd_set_message("WELCOME, INPUT", "PASSWORD OR RFID");
+	lcd_post(LCD_KEY_IDLE, LCD_PRIO_IDLE, 0, 0, "WELCOME, INPUT", "PASSWORD OR RFID");
+}
+
+static void lcd_show_progress(const char *l1, const char *l2)
+{
+	lcd_post(LCD_KEY_PROGRESS, LCD_PRIO_MSG, 0, lcd_idle_ms(), l1, l2);
+}
+
+static void lcd_show_result(const char *l1, const char *l2)
+{
+	lcd_post(LCD_KEY_RESULT, LCD_PRIO_MSG, LCD_RESULT_MIN_MS, lcd_idle_ms(), l1, l2);
+}
+
+// Callback de sched (tarea esp_timer): caduca la cima o cumple su mínimo
+static void lcd_deadline_cb(int id, void *arg)
+{
+	if (g_lcd_task) xTaskNotify(g_lcd_task, LCD_NTF_DEADLINE, eSetBits);
+}
+
+// Solo lo que cambió respecto de la sombra, sin 0x01 (ver lcd_frame.h)
+static void lcd_render(const char *l1, const char *l2)
+{
+	int64_t t0 = hal_time_us();
+	uint32_t bytes0 = g_lcd.bytes;
+	size_t n = lcd_drv_render(&g_lcd, l1, l2);
+	ESP_LOGD(TAG, "LCD: %u operaciones, %u bytes I2C, %lld us (lcd_task dormida)",
+	         (unsigned)n, (unsigned)(g_lcd.bytes - bytes0), (long long)(hal_time_us() - t0));
 }
 
 static void lcd_task(void *arg)
 {
-	const int64_t IDLE_TIMEOUT_US = 5000000; // 5s
+	uint32_t shown_seq = 0;
 	for (;;) {
-		int64_t now = esp_timer_get_time();
-		// Manejo de LOCKING...
-		if (g_locking_until_us > 0 && now >= g_locking_until_us) {
-			g_locking_until_us = 0;
-			lcd_show_idle();
-		}
-
-		// Mostrar idle si no hay actividad por 5s y no estamos mostrando progreso de pass
-		if ((now - g_last_activity_us) >= IDLE_TIMEOUT_US) {
-			lcd_show_idle();
-			// Evitar que se vuelva a setear innecesariamente en cada ciclo
-			g_last_activity_us = now; // marca como "mostrado"
+		// Compositor: elige la cima y programa el siguiente cambio posible
+		lock_take(g_lcd_mutex, PROF_LOCK_LCD);
+		int64_t now = hal_time_us(), next = LCD_QUEUE_NEVER;
+		const lcd_req_t *top = lcd_queue_compose(&g_lcd_q, now, &next);
+		char l1[LCD_COLS + 1], l2[LCD_COLS + 1];
+		bool changed = top && top->seq != shown_seq;
+		if (changed) {
+			memcpy(l1, top->l1, sizeof(l1));
+			memcpy(l2, top->l2, sizeof(l2));
+			shown_seq = top->seq;
 		}
+		lock_give(g_lcd_mutex, PROF_LOCK_LCD);
 
-		if (g_lcd_dirty && g_lcd_mutex) {
-			xSemaphoreTake(g_lcd_mutex, portMAX_DELAY);
-			char l1[17]; char l2[17];
-			memcpy(l1, g_lcd_line1, 17);
-			memcpy(l2, g_lcd_line2, 17);
-			g_lcd_dirty = false;
-			xSemaphoreGive(g_lcd_mutex);
-
-			lcd_clear();
-			lcd_set_cursor(0,0); lcd_print_len(l1, 16);
-			lcd_set_cursor(0,1); lcd_print_len(l2, 16);
-		}
-		vTaskDelay(pdMS_TO_TICKS(100));
+		if (next == LCD_QUEUE_NEVER) sched_cancel(DL_LCD);
+		else sched_arm_in(DL_LCD, (uint32_t)((next - now + 999) / 1000));
+		if (changed) lcd_render(l1, l2);
+		// Sin sondeo: despierta solo si la cima puede cambiar o vence su plazo
+		xTaskNotifyWait(0, UINT32_MAX, NULL, portMAX_DELAY);
 	}
 }
 
@@ -699,78 +1362,85 @@ static void lcd_task(void *arg)
 
 static void buzzer_init(void)
 {
-	ledc_timer_config_t tcfg = {
-		.speed_mode = BUZZER_LEDC_MODE,
-		.duty_resolution = LEDC_TIMER_10_BIT,
-		.timer_num = BUZZER_LEDC_TIMER,
-		.freq_hz = BUZZER_FREQ_HZ,
-		.clk_cfg = LEDC_AUTO_CLK,
-	};
-	ledc_timer_config(&tcfg);
-
-	ledc_channel_config_t ch = {
-		.gpio_num = BUZZER_GPIO,
-		.speed_mode = BUZZER_LEDC_MODE,
-		.channel = BUZZER_LEDC_CHANNEL,
-		.intr_type = LEDC_INTR_DISABLE,
-		.timer_sel = BUZZER_LEDC_TIMER,
-		.duty = 0,
-		.hpoint = 0,
-	};
-	ledc_channel_config(&ch);
-}
-
-static void buzzer_play_ms(uint32_t ms, uint32_t duty)
-{
-	ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, duty);
-	ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
-	vTaskDelay(pdMS_TO_TICKS(ms));
-	ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL, 0);
-	ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CHANNEL);
+	hal_pwm_init(BUZZER_PWM_CH, g_pins.buzzer, BUZZER_FREQ_HZ, BUZZER_PWM_BITS);
 }
 
-static void beep_ok(void)      { buzzer_play_ms(80, 300); vTaskDelay(pdMS_TO_TICKS(40)); buzzer_play_ms(80, 300); }
-static void beep_error(void)   { buzzer_play_ms(300, 500); }
-static void beep_tick(void)    { buzzer_play_ms(30, 300); }
-
-// Patrones solicitados para contraseña:
-// - Pip único al capturar un dígito
-// - Doble pip al acertar la contraseña (ya cubierto por beep_ok)
-// - Triple pip al fallar la contraseña
-static void beep_triple(void)
+static void buzzer_set_duty(uint32_t duty)
 {
-	beep_tick();
-	vTaskDelay(pdMS_TO_TICKS(40));
-	beep_tick();
-	vTaskDelay(pdMS_TO_TICKS(40));
-	beep_tick();
+	hal_pwm_set(BUZZER_PWM_CH, duty);
 }
 
 // =============================================================
 // ==================   UTILIDADES DE LEDS   ===================
 // =============================================================
 
-static inline void led_set(gpio_num_t gpio, bool on)
+static inline void led_set(int gpio, bool on)
 {
-	gpio_set_level(gpio, on ? 1 : 0);
+	hal_gpio_set(gpio, on ? 1 : 0);
 }
 
 static void leds_init(void)
 {
-	gpio_config_t io = {
-		.pin_bit_mask = (1ULL<<LED_STATUS_GPIO) | (1ULL<<LED_GREEN_GPIO) | (1ULL<<LED_RED_GPIO),
-		.mode = GPIO_MODE_OUTPUT,
-		.pull_up_en = GPIO_PULLUP_DISABLE,
-		.pull_down_en = GPIO_PULLDOWN_DISABLE,
-		.intr_type = GPIO_INTR_DISABLE
-	};
-	gpio_config(&io);
+	hal_gpio_config(g_pins.led_status, HAL_GPIO_OUTPUT);
+	hal_gpio_config(g_pins.led_green, HAL_GPIO_OUTPUT);
+	hal_gpio_config(g_pins.led_red, HAL_GPIO_OUTPUT);
 
 	// Azul (status) siempre encendido
-	led_set(LED_STATUS_GPIO, 1);
+	led_set(g_pins.led_status, 1);
 	// En reposo: verde y rojo apagados. Verde solo al conceder acceso; rojo solo al denegar.
-	led_set(LED_GREEN_GPIO, 0);
-	led_set(LED_RED_GPIO, 0);
+	led_set(g_pins.led_green, 0);
+	led_set(g_pins.led_red, 0);
+}
+
+// =============================================================
+// ============   FEEDBACK (BUZZER + LED ROJO)   ===============
+// =============================================================
+
+// Secuenciador de patrones (feedback.c): fb_post() solo marca el patrón y
+// despierta a g_fb_kick; los pasos los reproduce g_fb_step en la tarea de
+// temporizadores, así que RFID, potenciómetro y controlador no esperan a que
+// termine un pitido o el parpadeo de "denegado". Ambos callbacks corren en
+// la misma tarea, uno tras otro: el estado del secuenciador no necesita cerrojo.
+static fb_seq_t g_fb;
+static hal_timer_t *g_fb_kick = NULL;  // One-shot inmediato: atender pedidos
+static hal_timer_t *g_fb_step = NULL;  // Fin del paso en curso
+
+static void fb_apply(const fb_out_t *out)
+{
+	buzzer_set_duty(out->duty);
+	led_set(g_pins.led_red, out->leds & FB_LED_RED);
+	if (out->hold_ms) hal_timer_start_once(g_fb_step, (uint64_t)out->hold_ms * 1000);
+}
+
+static void fb_kick_cb(void *arg)
+{
+	fb_out_t out;
+	if (!fb_service(&g_fb, &out)) return;
+	hal_timer_stop(g_fb_step); // El patrón interrumpido pierde su plazo
+	fb_apply(&out);
+}
+
+static void fb_step_cb(void *arg)
+{
+	fb_out_t out;
+	fb_step_expired(&g_fb, &out);
+	fb_apply(&out);
+}
+
+static void fb_init_timers(void)
+{
+	fb_init(&g_fb);
+	g_fb_kick = hal_timer_create("fb_kick", fb_kick_cb, NULL);
+	g_fb_step = hal_timer_create("fb_step", fb_step_cb, NULL);
+	if (!g_fb_kick || !g_fb_step) abort();
+}
+
+// Pide un patrón y vuelve al instante. Si el despertador ya estaba armado,
+// su callback recogerá también este pedido (start_once devuelve false)
+static void fb_post(fb_pattern_t id)
+{
+	if (!g_fb_kick) return;
+	if (fb_request(&g_fb, id)) hal_timer_start_once(g_fb_kick, 0);
 }
 
 // =============================================================
@@ -781,25 +1451,7 @@ static void leds_init(void)
 #if LOCK_USE_SERVO
 static void servo_init(void)
 {
-	ledc_timer_config_t tcfg = {
-		.speed_mode = SERVO_LEDC_MODE,
-		.duty_resolution = SERVO_TIMER_RES,
-		.timer_num = SERVO_LEDC_TIMER,
-		.freq_hz = SERVO_FREQ_HZ,
-		.clk_cfg = LEDC_AUTO_CLK,
-	};
-	ledc_timer_config(&tcfg);
-
-	ledc_channel_config_t ch = {
-		.gpio_num = SERVO_GPIO,
-		.speed_mode = SERVO_LEDC_MODE,
-		.channel = SERVO_LEDC_CHANNEL,
-		.intr_type = LEDC_INTR_DISABLE,
-		.timer_sel = SERVO_LEDC_TIMER,
-		.duty = 0,
-		.hpoint = 0,
-	};
-	ledc_channel_config(&ch);
+	hal_pwm_init(SERVO_PWM_CH, SERVO_GPIO, SERVO_FREQ_HZ, SERVO_TIMER_BITS);
 }
 
 static void servo_write_pulse_us(uint32_t us)
@@ -810,8 +1462,7 @@ static void servo_write_pulse_us(uint32_t us)
 	if (us > SERVO_MAX_US) us = SERVO_MAX_US;
 	uint32_t duty = (uint32_t)((((uint64_t)us) * max_duty + (period_us/2)) / period_us);
 	if (duty > max_duty) duty = max_duty;
-	ledc_set_duty(SERVO_LEDC_MODE, SERVO_LEDC_CHANNEL, duty);
-	ledc_update_duty(SERVO_LEDC_MODE, SERVO_LEDC_CHANNEL);
+	hal_pwm_set(SERVO_PWM_CH, duty);
 }
 
 static inline void servo_set_locked(bool locked)
@@ -825,179 +1476,152 @@ static inline void servo_set_locked(bool locked)
 }
 #endif
 
+// El servo, si se usa, mueve solo la cerradura del panel; el resto son relés
 static void lock_hw_init(void)
 {
 #if LOCK_USE_SERVO
 	servo_init();
-#else
-	gpio_config_t io = {
-		.pin_bit_mask = (1ULL<<LOCK_GPIO),
-		.mode = GPIO_MODE_OUTPUT,
-		.pull_up_en = GPIO_PULLUP_DISABLE,
-		.pull_down_en = GPIO_PULLDOWN_DISABLE,
-		.intr_type = GPIO_INTR_DISABLE
-	};
-	gpio_config(&io);
-	// Estado inicial: activo (energizado) excepto cuando la puerta se abra.
-	gpio_set_level(LOCK_GPIO, RELAY_ACTIVE_LEVEL);
 #endif
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		if (LOCK_USE_SERVO && door_is_panel(&g_doors[i])) continue;
+		hal_gpio_config(g_doors[i].lock_gpio, HAL_GPIO_OUTPUT);
+		// Estado inicial: activo (energizado) excepto cuando la puerta se abra.
+		hal_gpio_set(g_doors[i].lock_gpio, RELAY_ACTIVE_LEVEL);
+	}
 }
 
-#if !LOCK_USE_SERVO
-static void lock_apply_level(bool lock_on)
+static void lock_apply_level(const door_ctx_t *d, bool lock_on)
 {
 	// lock_on = true => energizar electroimán (cerrar). Mapear directo con RELAY_ACTIVE_LEVEL.
 	// Si RELAY_ACTIVE_LEVEL == 0 (relay activo en LOW): lock_on -> 0, unlock -> 1.
 	// Si RELAY_ACTIVE_LEVEL == 1 (relay activo en HIGH): lock_on -> 1, unlock -> 0.
 	int level = lock_on ? RELAY_ACTIVE_LEVEL : (RELAY_ACTIVE_LEVEL ^ 1);
-	gpio_set_level(LOCK_GPIO, level);
-	ESP_LOGD(TAG, "Relay GPIO25 nivel=%d (lock_on=%d)", level, lock_on);
+	hal_gpio_set(d->lock_gpio, level);
+	ESP_LOGD(TAG, "Relay GPIO%d nivel=%d (lock_on=%d)", d->lock_gpio, level, lock_on);
 }
-#endif
 
-static inline void lock_apply_locked_hw(bool locked)
+static inline void lock_apply_locked_hw(const door_ctx_t *d, bool locked)
 {
 #if LOCK_USE_SERVO
-	servo_set_locked(locked);
-#else
-	lock_apply_level(locked);
+	if (door_is_panel(d)) {
+		servo_set_locked(locked);
+		return;
+	}
 #endif
+	lock_apply_level(d, locked);
 }
 
 static void set_locked_state(bool locked)
 {
-	g_lock_state = locked ? LOCKED : UNLOCKED;
 	if (locked) {
-		xEventGroupSetBits(g_events, EVT_LOCKED);
 		// Estado bloqueado: solo LED de status (azul). Verde y rojo apagados.
-		led_set(LED_GREEN_GPIO, 0);
-		led_set(LED_RED_GPIO, 0);
+		led_set(g_pins.led_green, 0);
+		led_set(g_pins.led_red, 0);
 	} else {
-		xEventGroupClearBits(g_events, EVT_LOCKED);
 		// Acceso concedido: verde encendido, rojo apagado.
-		led_set(LED_RED_GPIO, 0);
-		led_set(LED_GREEN_GPIO, 1);
+		led_set(g_pins.led_red, 0);
+		led_set(g_pins.led_green, 1);
 	}
 }
 
-static void led_show_denied(void)
+// Solo control_task las invoca (acciones ACCESS_ACT_LOCK / ACCESS_ACT_UNLOCK);
+// la máquina de estados garantiza que lock_door() ocurre con la puerta cerrada.
+// LEDs, LCD y potenciómetro son del panel: las demás puertas solo mueven su relé.
+static void lock_door(door_ctx_t *d)
 {
-    // Muestra acceso denegado: rojo encendido breve y se apaga
-    led_set(LED_RED_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(300));
-    led_set(LED_RED_GPIO, 0);
-}
-
-static void lock_door(void)
-{
-	if (g_door_state != DOOR_CLOSED) {
-		ESP_LOGW(TAG, "Intento de lock ignorado: puerta no está cerrada");
-		return;
-	}
 	// Lock: desenergizar bobina (relay inactivo) para cerrar (estado reposo seguro)
-	lock_apply_locked_hw(false);
+	lock_apply_locked_hw(d, false);
+	ESP_LOGI(TAG, "Puerta %u: cerradura BLOQUEADA (bobina OFF)", d->policy_id);
+	if (!door_is_panel(d)) return;
 	set_locked_state(true);
-	g_pending_relock = false;
-	combo_reset();
-	ESP_LOGI(TAG, "Cerradura BLOQUEADA (bobina OFF)");
-	lcd_set_message("LOCKING...", "");
-	touch_activity();
-	g_locking_until_us = esp_timer_get_time() + 1000000; // 1s
+	if (g_pot_task) xTaskNotifyGive(g_pot_task); // Reiniciar combinación parcial
+	// Sustituye al resultado y tapa lo demás durante LCD_LOCKING_MS; luego, bienvenida
+	lcd_cancel(LCD_KEY_PROGRESS);
+	lcd_post(LCD_KEY_RESULT, LCD_PRIO_LOCKING, LCD_LOCKING_MS, LCD_LOCKING_MS, "LOCKING...", "");
 }
 
-static void unlock_door(void)
+static void unlock_door(door_ctx_t *d)
 {
 	// Unlock: energizar bobina para liberar
-	lock_apply_locked_hw(true);
-	set_locked_state(false);
-	g_pending_relock = true;  // Se re-bloqueará (bobina OFF) al cerrar puerta
-	ESP_LOGI(TAG, "Cerradura DESBLOQUEADA (bobina ON)");
+	lock_apply_locked_hw(d, true);
+	if (door_is_panel(d)) set_locked_state(false);
+	ESP_LOGI(TAG, "Puerta %u: cerradura DESBLOQUEADA (bobina ON)", d->policy_id);
 }
 
 // =============================================================
 // ==============   SENSOR DE PUERTA (REED)   ==================
 // =============================================================
 
-static void door_sensor_init(void)
-{
-	gpio_config_t io = {
-		.pin_bit_mask = (1ULL<<DOOR_SENSOR_GPIO),
-		.mode = GPIO_MODE_INPUT,
-		.pull_up_en = GPIO_PULLUP_ENABLE,   // Suponemos reed a GND cuando puerta cerrada u abierta (ajustar cableado)
-		.pull_down_en = GPIO_PULLDOWN_DISABLE,
-		.intr_type = GPIO_INTR_DISABLE
-	};
-	gpio_config(&io);
-}
+// Cada reed se atiende por interrupción any-edge: cada flanco reinicia una
+// ventana de DEBOUNCE_MS (hal_timer de su puerta) y, al vencer sin rebotes,
+// el callback confirma el nivel y lo publica como CTRL_EV_DOOR para control_task.
 
-static door_state_t read_door_state(void)
+static door_state_t door_level_to_state(int level)
 {
 	// NOTA: Ajusta esta lógica según tu cableado. Aquí asumimos:
 	//  - Reed cerrado => GPIO en 0
 	//  - Reed abierto  => GPIO en 1
-	int level = gpio_get_level(DOOR_SENSOR_GPIO);
 	return (level == 0) ? DOOR_CLOSED : DOOR_OPEN;
 }
 
-static void door_monitor_task(void *arg)
+static door_state_t read_door_state(const door_ctx_t *d)
 {
-	door_state_t last = DOOR_UNKNOWN;
-	int64_t unlock_start_us = 0;
+	return door_level_to_state(hal_gpio_get(d->door_gpio));
+}
 
-	for (;;) {
-		door_state_t now = read_door_state();
-		int64_t now_us = esp_timer_get_time();
-		if (now != last) {
-			last = now;
-			g_door_state = now;
-			if (now == DOOR_CLOSED) {
-				xEventGroupSetBits(g_events, EVT_DOOR_CLOSED);
-				ESP_LOGI(TAG, "Puerta: CERRADA");
-				log_event("door", false, "close");
-				// (Removido cambio directo de estado del relay al cerrar para cumplir nueva regla)
-				// Si hay un re-bloqueo pendiente, armar bloqueo con retardo de 1s
-				if (g_pending_relock) {
-					g_relock_arm_time_us = now_us + 1000000; // 1 segundo
-					ESP_LOGI(TAG, "Re-bloqueo armado para 1s después del cierre");
-				}
-			} else {
-				xEventGroupClearBits(g_events, EVT_DOOR_CLOSED);
-				ESP_LOGI(TAG, "Puerta: ABIERTA");
-				log_event("door", false, "open");
-				// (Removido cambio directo de estado del relay al abrir para cumplir nueva regla)
-				// Cancelar cualquier re-bloqueo armado previo
-				g_relock_arm_time_us = 0;
-			}
-		}
+// arg: door_ctx_t de la puerta
+static void IRAM_ATTR door_sensor_isr(void *arg)
+{
+	door_ctx_t *d = arg;
+	int64_t now_us = hal_time_us();
+	portENTER_CRITICAL_ISR(&d->db_mux);
+	int64_t deadline_us = door_debounce_edge(&d->db, now_us);
+	portEXIT_CRITICAL_ISR(&d->db_mux);
+	// Reiniciar la ventana de silencio (stop/start_once admiten contexto ISR)
+	hal_timer_stop(d->db_timer);
+	hal_timer_start_once(d->db_timer, (uint64_t)(deadline_us - now_us));
+}
 
-		// Ejecutar re-bloqueo diferido si corresponde y la puerta sigue cerrada
-		if (g_pending_relock && g_door_state == DOOR_CLOSED && g_relock_arm_time_us > 0 && now_us >= g_relock_arm_time_us) {
-			lock_door();
-			g_relock_arm_time_us = 0;
-		}
+static void door_debounce_cb(void *arg)
+{
+	door_ctx_t *d = arg;
+	int level = hal_gpio_get(d->door_gpio);
+	int64_t now_us = hal_time_us();
+	portENTER_CRITICAL(&d->db_mux);
+	int64_t edge_us = d->db.burst_start_us;
+	bool changed = door_debounce_expire(&d->db, level, now_us);
+	portEXIT_CRITICAL(&d->db_mux);
+	if (!changed) return;
+	ctrl_post((ctrl_evt_t){
+		.kind = CTRL_EV_DOOR,
+		.door = d->idx,
+		.door_ev = { .state = door_level_to_state(level), .edge_us = edge_us },
+	});
+}
 
-		// Gestión de tiempo máximo de desbloqueo si la puerta no se abrió
-		if (g_lock_state == UNLOCKED) {
-			if (unlock_start_us == 0) {
-				unlock_start_us = now_us;
-			}
-			int64_t dt_ms = (now_us - unlock_start_us) / 1000;
-			if (dt_ms >= UNLOCK_MAX_OPEN_TIME_MS) {
-				// Solo bloquear si la puerta está cerrada (regla del sistema)
-				if (g_door_state == DOOR_CLOSED) {
-					ESP_LOGI(TAG, "Tiempo max. desbloqueo alcanzado con puerta cerrada => lock");
-					lock_door();
-				} else {
-					// Si está abierta, esperamos a que cierre para poder lock
-					ESP_LOGW(TAG, "Tiempo max. alcanzado pero puerta ABIERTA; esperando cierre para lock");
-				}
-				unlock_start_us = 0; // Reiniciar para el siguiente ciclo de unlock
-			}
-		} else {
-			unlock_start_us = 0; // No estamos desbloqueados, contador detenido
-		}
+// Callback de sched (tarea esp_timer): reenvía el plazo a control_task; arg: door_ctx_t
+static void ctrl_deadline_cb(int id, void *arg)
+{
+	const door_ctx_t *d = arg;
+	ctrl_post((ctrl_evt_t){ .kind = CTRL_EV_TIMER, .door = d->idx, .timer_id = id });
+}
+
+static void door_sensor_init(void)
+{
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		door_ctx_t *d = &g_doors[i];
+		// Suponemos reed a GND cuando puerta cerrada u abierta (ajustar cableado)
+		hal_gpio_config(d->door_gpio, HAL_GPIO_INPUT_PULLUP);
+
+		door_debounce_init(&d->db, DEBOUNCE_MS, hal_gpio_get(d->door_gpio));
+		d->db_timer = hal_timer_create("door_db", door_debounce_cb, d);
+		if (!d->db_timer) abort();
 
-		vTaskDelay(pdMS_TO_TICKS(50));
+		if (!hal_gpio_on_edge(d->door_gpio, door_sensor_isr, d)) {
+			ESP_LOGE(TAG, "Sin interrupción del reed de la puerta %u en GPIO%d", d->policy_id, d->door_gpio);
+		} else if (!hal_gpio_wake(d->door_gpio)) {
+			ESP_LOGW(TAG, "El reed de la puerta %u no despierta del sueño ligero", d->policy_id);
+		}
 	}
 }
 
@@ -1006,174 +1630,182 @@ static void door_monitor_task(void *arg)
 // =============================================================
 
 // ================= POTENCIÓMETRO (LECTURA ANALÓGICA) =================
-#include "esp_adc/adc_oneshot.h"
-static adc_oneshot_unit_handle_t g_adc_handle;
-static adc_channel_t g_adc_channel = ADC_CHANNEL_6; // GPIO34 -> ADC1_CH6
+static int g_adc_pin = POT_ADC_GPIO;
 
 static void pot_init(void)
 {
-    adc_oneshot_unit_init_cfg_t unit_cfg = {
-        .unit_id = ADC_UNIT_1,
-    };
-    adc_oneshot_new_unit(&unit_cfg, &g_adc_handle);
-
-    adc_oneshot_chan_cfg_t chan_cfg = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = ADC_ATTEN_DB_11, // Mayor rango de entrada (~0-3.3V)
-    };
-    adc_oneshot_config_channel(g_adc_handle, g_adc_channel, &chan_cfg);
+    // Pin configurado; solo ADC1 (ADC2 lo ocupa el WiFi)
+    if (hal_adc_init(g_pins.pot)) {
+        g_adc_pin = g_pins.pot;
+    } else {
+        ESP_LOGE(TAG, "GPIO%d no es una entrada de ADC1; potenciómetro en GPIO%d", (int)g_pins.pot, POT_ADC_GPIO);
+        hal_adc_init(POT_ADC_GPIO);
+    }
 }
 
 // Filtro IIR (Exponential Moving Average) para suavizar lecturas ADC
 // Alpha: 0.0 = máximo filtrado, 1.0 = sin filtrado. Recomendado: 0.1-0.3
 #define POT_FILTER_ALPHA  0.15f
-static float g_filtered_raw = 0.0f;
 
-static int pot_apply_filter(int raw_sample)
-{
-    if (g_filtered_raw == 0.0f) {
-        g_filtered_raw = (float)raw_sample; // Inicializar en primera lectura
-    }
-    // IIR: y[n] = alpha * x[n] + (1-alpha) * y[n-1]
-    g_filtered_raw = POT_FILTER_ALPHA * raw_sample + (1.0f - POT_FILTER_ALPHA) * g_filtered_raw;
-    return (int)(g_filtered_raw + 0.5f); // Redondear
-}
+// Grabación de trazas ADC crudas para reproducirlas en host (tools/pot_replay):
+// POT_TRACE_OFF, POT_TRACE_UART (binario por el puerto del monitor) o POT_TRACE_SPIFFS
+#ifndef POT_TRACE_MODE
+#define POT_TRACE_MODE    POT_TRACE_OFF
+#endif
+
+// Filtro, mapeo, detector de estabilidad y validación viven en pot_capture.c
+static pot_capture_t g_pot;
+_Static_assert(CFG_COMBO_MAX <= POT_CAPTURE_MAX_LEN, "combinación de config mayor que la captura");
 
-static int pot_raw_to_digit(int raw)
+// "3 6 #" / "364": dígitos ingresados (o '#' pendientes) para LCD y logs
+static void pot_format_digits(char *buf, size_t sz, const int *d, int n, int len, bool spaced)
 {
-    if (raw < 0) raw = 0;
-    if (raw > POT_ADC_MAX_RAW) raw = POT_ADC_MAX_RAW;
-    
-    // Aplicar deadzone
-    if (raw < POT_DEADZONE_RAW || raw >= (POT_ADC_MAX_RAW - POT_DEADZONE_RAW)) {
-        return POT_INVALID_DIGIT;
-    }
-    
-    // Normalizar a rango sin deadzones
-    int effective_range = POT_ADC_MAX_RAW - 2 * POT_DEADZONE_RAW;
-    int normalized = raw - POT_DEADZONE_RAW; // 0 .. effective_range-1
-    
-    // Mapear a dígitos 0-9
-    int digit = (normalized * 10) / effective_range;
-    if (digit > 9) digit = 9; // Clamp
-    
-    // Invertir si el potenciómetro está al revés
-    if (POT_INVERT_MAPPING) {
-        digit = 9 - digit;
-    }
-    
-    return digit;
+	size_t k = 0;
+	for (int i = 0; i < len; ++i) {
+		size_t need = (spaced && i) ? 2 : 1;
+		if (k + need >= sz) break;
+		if (spaced && i) buf[k++] = ' ';
+		buf[k++] = (i < n) ? (char)('0' + d[i]) : '#';
+	}
+	buf[k] = '\0';
+}
+
+// Reconstruye la captura con la combinación y el tiempo de la configuración
+// vigente (al arrancar y en cada recarga; descarta la combinación parcial)
+static uint32_t pot_capture_setup(void)
+{
+	const app_cfg_t *app = cfg_acquire(&g_cfg);
+	pot_capture_cfg_t cfg = {
+		.filter_alpha = POT_FILTER_ALPHA,
+		.adc_max_raw = POT_ADC_MAX_RAW,
+		.deadzone_raw = POT_DEADZONE_RAW,
+		.invert = POT_INVERT_MAPPING,
+		.settle = {
+			.mode = POT_SETTLE_MODE,
+			.window = POT_SETTLE_WINDOW,
+			.z = POT_SETTLE_Z,
+			.max_slope = POT_SETTLE_MAX_SLOPE,
+			.horizon = POT_SETTLE_HORIZON,
+			.min_hold_ms = POT_SETTLE_MIN_MS,
+			.max_hold_ms = app->pot_settle_ms,
+		},
+		.combo_len = (int)strlen(app->combo),
+	};
+	for (int i = 0; i < cfg.combo_len; ++i) cfg.combo_target[i] = app->combo[i] - '0';
+	uint32_t gen = app->gen;
+	cfg_release(&g_cfg, app);
+	pot_capture_init(&g_pot, &cfg);
+	twin_update(TWIN_F_COMBO_LEN, cfg.combo_len);
+	return gen;
 }
 
 static void combo_reset(void)
 {
-	for (int i=0;i<COMBO_LEN;++i) g_entered[i]=0;
-	g_entered_count = 0;
-	g_digit_captured_after_settle = false;
-	xEventGroupClearBits(g_events, EVT_COMBO_OK);
+	pot_capture_reset(&g_pot);
+	twin_update(TWIN_F_COMBO, 0);
 }
 
-static bool combo_is_correct(void)
+// Último movimiento visto en la lectura cruda (antes que en el dígito filtrado)
+static int64_t g_pot_active_us;
+
+// En reposo y sin combinación a medias, el periodo del perfil: el primer
+// movimiento se ve algo más tarde, dentro del tiempo de estabilidad
+static uint32_t pot_period_ms(uint32_t active_ms)
 {
-	for (int i=0;i<COMBO_LEN;++i) {
-		if (g_entered[i] != COMBO_TARGET[i]) return false;
-	}
-	return true;
+	int64_t last = g_pot.last_move_us > g_pot_active_us ? g_pot.last_move_us : g_pot_active_us;
+	bool idle = g_pot.entered_count == 0 && hal_time_us() - last >= (int64_t)POT_IDLE_AFTER_MS * 1000;
+	uint32_t idle_ms = power_prof()->pot_idle_ms;
+	return (idle && idle_ms > active_ms) ? idle_ms : active_ms;
 }
 
 static void pot_task(void *arg)
 {
 	int last_digit_for_log = -1;
-	bool moved_since_last_capture = false; // Requiere movimiento antes de considerar nuevo dígito
+	uint32_t cfg_gen = pot_capture_setup();
+	pot_trace_init(POT_TRACE_MODE);
 	combo_reset();
 	// Mostrar mensaje idle al iniciar
 	lcd_show_idle();
-	touch_activity();
 	for (;;) {
-		int raw = 0;
-		if (adc_oneshot_read(g_adc_handle, g_adc_channel, &raw) == ESP_OK) {
-			// Aplicar filtro IIR para suavizar ruido
-			int filtered_raw = pot_apply_filter(raw);
-			int digit = pot_raw_to_digit(filtered_raw);
-			int64_t now_us = esp_timer_get_time();
+		// Bloqueo de la cerradura (control_task) => descartar combinación parcial
+		if (ulTaskNotifyTake(pdTRUE, 0)) {
+			combo_reset();
+		}
+		// Configuración recargada (combinación / tiempo de estabilidad)
+		const app_cfg_t *cfg = cfg_acquire(&g_cfg);
+		bool reload = (cfg->gen != cfg_gen);
+		int64_t published_us = cfg->published_us;
+		cfg_release(&g_cfg, cfg);
+		if (reload) {
+			cfg_gen = pot_capture_setup();
+			ESP_LOGI(TAG, "Captura reconfigurada (config gen %u, %lld us tras publicar)",
+			         (unsigned)cfg_gen, (long long)(hal_time_us() - published_us));
+		}
+		int raw = hal_adc_read(g_adc_pin);
+		if (raw >= 0) {
+			int64_t now_us = hal_time_us();
+			if (abs(raw - g_pot.filtered_raw) >= POT_WAKE_DELTA_RAW) g_pot_active_us = now_us;
+			pot_trace_sample(raw, now_us);
+			// Filtro IIR + mapeo + detector de estabilidad + captura
+			pot_capture_event_t ev = pot_capture_feed(&g_pot, raw, now_us);
 
 			// Ignorar si estamos en deadzone (no considerar como input válido)
-			if (digit == POT_INVALID_DIGIT) {
-				vTaskDelay(pdMS_TO_TICKS(40));
+			if (ev == POT_CAP_DEADZONE) {
+				twin_update(TWIN_F_DIGIT, POT_INVALID_DIGIT);
+				task_sleep(TASK_POT, pdMS_TO_TICKS(pot_period_ms(40)));
 				continue; // No procesar captura ni logs
 			}
-
-			if (digit != g_current_digit) {
-				// Movimiento detectado
-				g_current_digit = digit;
-				g_last_move_ts_us = now_us;
-				g_digit_captured_after_settle = false; // Permitirá capturar el nuevo valor cuando se estabilice
-				moved_since_last_capture = true;
-			}
+			int digit = g_pot.current_digit;
+			twin_update(TWIN_F_DIGIT, digit);
 
 			// Log del número del potenciómetro: solo al cambiar y con anti-spam (>= POT_LOG_MIN_MS)
 			if (digit != last_digit_for_log && (now_us - g_last_pot_print_us) >= (int64_t)POT_LOG_MIN_MS*1000) {
 				// Log con formato para graficar: RAW | FILTRADO | DIGITO
-				ESP_LOGI(TAG, "POT: raw=%d filtered=%d digit=%d", raw, filtered_raw, digit);
+				ESP_LOGI(TAG, "POT: raw=%d filtered=%d digit=%d", raw, g_pot.filtered_raw, digit);
 				g_last_pot_print_us = now_us;
 				last_digit_for_log = digit;
 			}
 
-			// Estabilidad: si ha pasado POT_SETTLE_MS desde el último movimiento y aún no se capturó
-			if (moved_since_last_capture && !g_digit_captured_after_settle && (now_us - g_last_move_ts_us)/1000 >= POT_SETTLE_MS) {
-				// Capturamos el dígito estabilizado como parte de la combinación
-				if (g_entered_count < COMBO_LEN) {
-					g_entered[g_entered_count++] = g_current_digit;
-					ESP_LOGI(TAG, "Dígito capturado: %d (progreso %d/%d)", g_current_digit, g_entered_count, COMBO_LEN);
-					// Pip único por dígito ingresado
-					beep_tick();
-					// LCD: mostrar progreso de contraseña
-					char l1[17] = "CURRENT PASS:";
-					char l2[17];
-					int d0 = (g_entered_count >= 1) ? g_entered[0] : -1;
-					int d1 = (g_entered_count >= 2) ? g_entered[1] : -1;
-					int d2 = (g_entered_count >= 3) ? g_entered[2] : -1;
-					snprintf(l2, sizeof(l2), "%c %c %c",
-						 (d0>=0? ('0'+d0): '#'),
-						 (d1>=0? ('0'+d1): '#'),
-						 (d2>=0? ('0'+d2): '#'));
-					lcd_set_message(l1, l2);
-					touch_activity();
-					g_digit_captured_after_settle = true; // Evita múltiples capturas sin movimiento
-					moved_since_last_capture = false;      // Requiere nuevo movimiento para el próximo dígito
-
-					if (g_entered_count == COMBO_LEN) {
-						if (combo_is_correct()) {
-							ESP_LOGI(TAG, "Combinación CORRECTA (%d %d %d)", g_entered[0], g_entered[1], g_entered[2]);
-							// Doble pip por contraseña correcta
-							beep_ok();
-							lcd_set_message("ACCESS GRANTED!", "WELCOME HOME");
-							touch_activity();
-							log_event("password", true, (g_door_state==DOOR_CLOSED?"close":"open"));
-							xEventGroupSetBits(g_events, EVT_COMBO_OK);
-						} else {
-							ESP_LOGW(TAG, "Combinación INCORRECTA (%d %d %d != %d %d %d)",
-									 g_entered[0], g_entered[1], g_entered[2],
-									 COMBO_TARGET[0], COMBO_TARGET[1], COMBO_TARGET[2]);
-							// Triple pip por contraseña incorrecta
-							beep_triple();
-							led_show_denied();
-							lcd_set_message("ACCESS DENIED!", "");
-							touch_activity();
-							log_event("password", false, (g_door_state==DOOR_CLOSED?"close":"open"));
-							combo_reset();
-							moved_since_last_capture = false; // Se exigirá movimiento antes de capturar de nuevo
-						}
-					}
+			if (ev != POT_CAP_NONE) {
+				// Dígito capturado como parte de la combinación
+				ESP_LOGI(TAG, "Dígito capturado: %d (progreso %d/%d, %lld ms, sd=%.1f slope=%.1f)",
+					 digit, g_pot.entered_count, g_pot.cfg.combo_len,
+					 (long long)((now_us - g_pot.last_move_us) / 1000),
+					 g_pot.settle.stddev, g_pot.settle.slope);
+				// Pip único por dígito ingresado
+				fb_post(FB_TICK);
+				twin_update(TWIN_F_COMBO, g_pot.entered_count);
+				// LCD: mostrar progreso de contraseña
+				char l1[17] = "CURRENT PASS:";
+				char l2[17];
+				pot_format_digits(l2, sizeof(l2), g_pot.entered, g_pot.entered_count, g_pot.cfg.combo_len, true);
+				lcd_show_progress(l1, l2);
+
+				if (ev == POT_CAP_COMBO_OK) {
+					char got[CFG_COMBO_MAX + 1];
+					pot_format_digits(got, sizeof(got), g_pot.entered, g_pot.entered_count, g_pot.cfg.combo_len, false);
+					ESP_LOGI(TAG, "Combinación CORRECTA (%s)", got);
+					// Doble pip por contraseña correcta
+					fb_post(FB_OK);
+					cred_post(&g_doors[PANEL_DOOR], CRED_COMBO, NULL, 0, 0); // control_task aplica la política y muestra el resultado
+					// La captura llena ignora lecturas: si el factor queda pendiente (modo AND)
+					// no hay bloqueo que la reinicie y el potenciómetro quedaría mudo
+					combo_reset();
+				} else if (ev == POT_CAP_COMBO_BAD) {
+					char got[CFG_COMBO_MAX + 1], want[CFG_COMBO_MAX + 1];
+					pot_format_digits(got, sizeof(got), g_pot.entered, g_pot.entered_count, g_pot.cfg.combo_len, false);
+					pot_format_digits(want, sizeof(want), g_pot.cfg.combo_target, g_pot.cfg.combo_len, g_pot.cfg.combo_len, false);
+					ESP_LOGW(TAG, "Combinación INCORRECTA (%s != %s)", got, want);
+					// Triple pip + LED rojo por contraseña incorrecta
+					fb_post(FB_BAD_COMBO);
+					lcd_cancel(LCD_KEY_PROGRESS);
+					lcd_show_result("ACCESS DENIED!", "");
+					log_event(g_doors[PANEL_DOOR].policy_id, "password", false, door_status_str(&g_doors[PANEL_DOOR]));
+					combo_reset(); // Se exigirá movimiento antes de capturar de nuevo
 				}
 			}
-
-			// Si la combinación ya fue validada, mantener el evento hasta que se mueva de nuevo
-			if ((xEventGroupGetBits(g_events) & EVT_COMBO_OK) && (digit != COMBO_TARGET[COMBO_LEN-1])) {
-				// Opcional: podríamos limpiar al mover, pero lo dejamos persistir hasta uso por control_task
-			}
 		}
-		vTaskDelay(pdMS_TO_TICKS(120));
+		task_sleep(TASK_POT, pdMS_TO_TICKS(pot_period_ms(POT_ACTIVE_MS)));
 	}
 }
 
@@ -1184,82 +1816,99 @@ static void pot_task(void *arg)
 #if USE_MFRC522
 #include "mfrc522_min.h"
 
-static bool uid_is_authorized(const uint8_t *uid, size_t len)
-{
-	if (len < 4) return false;
-	for (size_t i=0; i<AUTH_UIDS_COUNT; ++i) {
-		if (memcmp(uid, AUTH_UIDS[i], 4) == 0) return true;
+// Un lector por puerta en el mismo bus SPI (CS propio). El RST es común: lo
+// pulsa solo el primero, antes de inicializar los demás. Cada vuelta sondea
+// todos los lectores en serie; un lector sin tarjeta cuesta lo que tarda
+// en vencer el temporizador del chip (mfrc522_min.c), no la espera entera.
+typedef struct {
+	mfrc522_t dev;
+	bool card_present_last;
+	uint8_t last_uid[10];
+	size_t last_uid_len;
+} rfid_reader_t;
+
+static void rfid_poll(door_ctx_t *d, rfid_reader_t *r)
+{
+	uint8_t atqa[2] = {0}; size_t atqa_len = sizeof(atqa);
+	bool present = mfrc522_request_a(&r->dev, atqa, &atqa_len);
+	if (present) {
+		uint8_t uid[10] = {0};
+		size_t uid_len = 0;
+		// Intentamos anticollision nivel 1 (4 bytes de UID base)
+		if (mfrc522_anticoll_cl1(&r->dev, uid)) {
+			uid_len = 4;
+			bool is_new = (!r->card_present_last) || (uid_len != r->last_uid_len) || (memcmp(uid, r->last_uid, uid_len) != 0);
+			if (is_new) {
+				ESP_LOGI(TAG, "Puerta %u: RFID UID: %02X:%02X:%02X:%02X", d->policy_id, uid[0], uid[1], uid[2], uid[3]);
+				// Pip único por escaneo (el buzzer es del panel)
+				if (door_is_panel(d)) fb_post(FB_TICK);
+				// La autorización (política por grupos y horario) la decide control_task
+				cred_post(d, CRED_RFID, uid, uid_len, 0);
+				memcpy(r->last_uid, uid, uid_len);
+				r->last_uid_len = uid_len;
+			}
+			r->card_present_last = true;
+		} else {
+			// No se pudo leer UID en CL1, consideramos como no presente para evitar spam
+			r->card_present_last = false;
+			r->last_uid_len = 0;
+		}
+	} else {
+		r->card_present_last = false;
+		r->last_uid_len = 0;
 	}
-	return false;
 }
 
-static void rfid_task(void *arg)
+// La línea IRQ no puede ser pin de ninguna puerta
+static bool rfid_irq_free(void)
 {
-	ESP_LOGI(TAG, "RFID (MFRC522) habilitado");
-	mfrc522_t rfid = {0};
-	if (!mfrc522_init(&rfid, SPI3_HOST, RFID_SPI_SCK_GPIO, RFID_SPI_MOSI_GPIO, RFID_SPI_MISO_GPIO, RFID_SPI_CS_GPIO, RFID_RST_GPIO)) {
-		ESP_LOGE(TAG, "Error inicializando MFRC522");
+	if (RFID_IRQ_GPIO < 0) return false;
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		if (g_doors[i].lock_gpio == RFID_IRQ_GPIO || g_doors[i].door_gpio == RFID_IRQ_GPIO ||
+		    g_doors[i].rfid_cs == RFID_IRQ_GPIO) {
+			ESP_LOGW(TAG, "GPIO%d es de la puerta %u: lectores sin IRQ", RFID_IRQ_GPIO, g_doors[i].policy_id);
+			return false;
+		}
 	}
+	return true;
+}
 
-	uint8_t ver = 0;
-	if (mfrc522_get_version(&rfid, &ver)) {
-		ESP_LOGI(TAG, "MFRC522 VersionReg=0x%02X", ver);
+static void rfid_task(void *arg)
+{
+	ESP_LOGI(TAG, "RFID (MFRC522) habilitado: %d lector(es)", DOOR_COUNT);
+	static rfid_reader_t readers[DOOR_COUNT];
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		rfid_reader_t *r = &readers[i];
+		if (!mfrc522_init(&r->dev, g_pins.rfid_sck, g_pins.rfid_mosi, g_pins.rfid_miso,
+		                  g_doors[i].rfid_cs, i == 0 ? g_pins.rfid_rst : -1)) {
+			ESP_LOGE(TAG, "Error inicializando el MFRC522 de la puerta %u", g_doors[i].policy_id);
+		}
+		uint8_t ver = 0;
+		if (mfrc522_get_version(&r->dev, &ver)) {
+			ESP_LOGI(TAG, "Puerta %u: MFRC522 VersionReg=0x%02X", g_doors[i].policy_id, ver);
+		}
+		if (rfid_irq_free() && !mfrc522_use_irq(&r->dev, RFID_IRQ_GPIO)) {
+			ESP_LOGW(TAG, "Puerta %u: sin IRQ del MFRC522 en GPIO%d", g_doors[i].policy_id, RFID_IRQ_GPIO);
+		}
 	}
 
-	uint8_t last_uid[10] = {0};
-	size_t last_uid_len = 0;
-	bool card_present_last = false;
-
+	bool asleep = false;
 	for (;;) {
-		uint8_t atqa[2] = {0}; size_t atqa_len = sizeof(atqa);
-		bool present = mfrc522_request_a(&rfid, atqa, &atqa_len);
-		if (present) {
-			uint8_t uid[10] = {0};
-			size_t uid_len = 0;
-			// Intentamos anticollision nivel 1 (4 bytes de UID base)
-			if (mfrc522_anticoll_cl1(&rfid, uid)) {
-				uid_len = 4;
-				bool is_new = (!card_present_last) || (uid_len != last_uid_len) || (memcmp(uid, last_uid, uid_len) != 0);
-				if (is_new) {
-					ESP_LOGI(TAG, "RFID UID: %02X:%02X:%02X:%02X", uid[0], uid[1], uid[2], uid[3]);
-					// Pip único por escaneo
-					beep_tick();
-					touch_activity();
-					// Autorización por lista blanca
-					if (uid_is_authorized(uid, uid_len)) {
-						ESP_LOGI(TAG, "RFID autorizado (whitelist)");
-						lcd_set_message("ACCESS GRANTED!", "WELCOME HOME");
-						touch_activity();
-						log_event("rfid", true, (g_door_state==DOOR_CLOSED?"close":"open"));
-						xEventGroupSetBits(g_events, EVT_RFID_OK);
-					} else {
-						ESP_LOGW(TAG, "RFID NO autorizado");
-						led_show_denied();
-						lcd_set_message("ACCESS DENIED!", "");
-						touch_activity();
-						log_event("rfid", false, (g_door_state==DOOR_CLOSED?"close":"open"));
-					}
-					memcpy(last_uid, uid, uid_len);
-					last_uid_len = uid_len;
-				}
-				card_present_last = true;
-			} else {
-				// No se pudo leer UID en CL1, consideramos como no presente para evitar spam
-				card_present_last = false;
-				last_uid_len = 0;
-			}
-		} else {
-			card_present_last = false;
-			last_uid_len = 0;
+		const power_prof_t *p = power_prof();
+		for (int i = 0; i < DOOR_COUNT; ++i) {
+			if (asleep) mfrc522_power_down(&readers[i].dev, false);
+			rfid_poll(&g_doors[i], &readers[i]);
+			if (p->rfid_sleep) mfrc522_power_down(&readers[i].dev, true);
 		}
-		vTaskDelay(pdMS_TO_TICKS(150));
+		asleep = p->rfid_sleep;
+		task_sleep(TASK_RFID, pdMS_TO_TICKS(p->rfid_ms));
 	}
 }
 
 #else
 static void rfid_task(void *arg)
 {
-	// Stub sin RFID real: solo informa. Deja el bit EVT_RFID_OK sin activar.
+	// Stub sin RFID real: solo informa. No publica credenciales.
 	ESP_LOGW(TAG, "RFID deshabilitado (USE_MFRC522=0). Ver README para habilitar.");
 	for (;;) {
 		vTaskDelay(pdMS_TO_TICKS(1000));
@@ -1271,44 +1920,290 @@ static void rfid_task(void *arg)
 // ===================   LÓGICA PRINCIPAL   ====================
 // =============================================================
 
-static void control_task(void *arg)
+static policy_t *g_policy = NULL;    // Solo control_task: política compilada en uso (todas las puertas)
+
+// Regla de fusión: ACCESS_MODE por defecto, o la que fije la política ("mode").
+// Cada puerta guarda sus factores: una tarjeta en una no completa otra.
+static void ctrl_fusion_init(int rule, int32_t window_ms)
 {
-	// Arranque: establecer estado bloqueado coherente
-	if (read_door_state() == DOOR_CLOSED) {
-		lock_door();
-	} else {
-		lock_apply_locked_hw(true);
-		set_locked_state(true);
+	if (rule < 0) {
+#if ACCESS_MODE == ACCESS_MODE_AND
+		rule = FUSION_RULE_RFID_PIN;
+#elif ACCESS_MODE == ACCESS_MODE_2OF3
+		rule = FUSION_RULE_2_OF_3;
+#elif ACCESS_MODE == ACCESS_MODE_DUAL
+		rule = FUSION_RULE_DUAL_PERSON;
+#else
+		rule = FUSION_RULE_ANY;
+#endif
 	}
+	if (window_ms <= 0) window_ms = CRED_WINDOW_MS;
+	fusion_cfg_t cfg = {
+		.rule = (fusion_rule_t)rule,
+		.window_us = (int64_t)window_ms * 1000,
+		// En 2-de-3 el remoto cuenta como factor; en el resto siempre concede
+		.bypass_mask = (rule == FUSION_RULE_2_OF_3) ? 0 : (1u << CRED_REMOTE),
+	};
+	for (int i = 0; i < DOOR_COUNT; ++i) fusion_init(&g_doors[i].fusion, &cfg);
+	ESP_LOGI(TAG, "Regla de acceso: %s (ventana %ld ms)", fusion_rule_name(cfg.rule), (long)window_ms);
+}
 
-	const EventBits_t ACCESS_ALL_BITS = EVT_RFID_OK | EVT_COMBO_OK | EVT_REMOTE_OK;
+// Instala una política compilada (control_task pasa a ser su dueño)
+static void ctrl_policy_install(policy_t *p)
+{
+	policy_free(g_policy);
+	g_policy = p;
+	ctrl_fusion_init(p->rule, p->window_ms);
+	twin_update(TWIN_F_POLICY, (int32_t)p->version);
+	ESP_LOGI(TAG, "Política v%u: %u reglas, %u tarjetas, %u grupos, %u festivos (%u bytes)",
+	         (unsigned)p->version, (unsigned)p->n_rules, (unsigned)p->n_creds, p->n_groups,
+	         p->n_holidays, (unsigned)policy_size(p));
+}
 
-	for (;;) {
-		ESP_LOGI(TAG, "Esperando métodos de acceso (RFID, combo, remoto)...");
-		EventBits_t bits = xEventGroupWaitBits(g_events, ACCESS_ALL_BITS, pdTRUE, pdFALSE, portMAX_DELAY);
-
-		bool granted = false;
-		if (bits & EVT_REMOTE_OK) {
-			granted = true; // Acceso remoto siempre concede
-			ESP_LOGI(TAG, "Acceso remoto recibido (MQTT)");
-		} else if (ACCESS_MODE == ACCESS_MODE_AND) {
-			granted = ((bits & (EVT_RFID_OK | EVT_COMBO_OK)) == (EVT_RFID_OK | EVT_COMBO_OK));
-		} else { // OR
-			granted = (bits & (EVT_RFID_OK | EVT_COMBO_OK)) != 0;
+// Política por defecto: AUTH_UIDS, combinación y remoto con acceso a todas horas
+static policy_t *ctrl_policy_default(void)
+{
+	char json[512];
+	int n = snprintf(json, sizeof(json),
+		"{\"version\":0,\"groups\":[\"default\"],\"combo\":[\"default\"],\"remote\":[\"default\"],"
+		"\"rules\":[{\"groups\":[\"default\"],\"days\":\"all\"}],\"credentials\":[");
+#if USE_MFRC522
+	for (size_t i = 0; i < AUTH_UIDS_COUNT && n < (int)sizeof(json) - 64; ++i) {
+		n += snprintf(json + n, sizeof(json) - n, "%s{\"uid\":\"%02X%02X%02X%02X\",\"groups\":[\"default\"]}",
+		              i ? "," : "", AUTH_UIDS[i][0], AUTH_UIDS[i][1], AUTH_UIDS[i][2], AUTH_UIDS[i][3]);
+	}
+#endif
+	snprintf(json + n, sizeof(json) - n, "]}");
+	char err[64];
+	policy_t *p = policy_compile(json, strlen(json), err, sizeof(err));
+	if (!p) ESP_LOGE(TAG, "Política por defecto no válida: %s", err);
+	return p;
+}
+
+// Última política aceptada (SPIFFS); NULL si no hay o no compila
+static policy_t *ctrl_policy_load(void)
+{
+	FILE *f = fopen(POLICY_FILE_PATH, "r");
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	policy_t *p = NULL;
+	char *buf = (len > 0 && len <= POLICY_JSON_MAX) ? malloc((size_t)len) : NULL;
+	if (buf && fread(buf, 1, (size_t)len, f) == (size_t)len) {
+		char err[64];
+		p = policy_compile(buf, (size_t)len, err, sizeof(err));
+		if (!p) ESP_LOGW(TAG, "Política guardada no válida (%s); se usa la de por defecto", err);
+	}
+	free(buf);
+	fclose(f);
+	return p;
+}
+
+// Franja de la política para la hora local; POLICY_NO_CLOCK sin hora válida
+static int ctrl_policy_slot(void)
+{
+	if (!g_policy) return POLICY_NO_CLOCK;
+	time_t now = 0; time(&now);
+	struct tm tm_info; localtime_r(&now, &tm_info);
+	if (tm_info.tm_year + 1900 < 2024) return POLICY_NO_CLOCK;
+	return policy_slot(g_policy, tm_info.tm_wday, tm_info.tm_hour * 60 + tm_info.tm_min,
+	                   policy_epoch_day(tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday));
+}
+
+// Política de credenciales: ¿esta credencial (junto a las vigentes en la
+// puerta d) concede acceso? LCD y buzzer solo informan de la del panel.
+static bool ctrl_credential_grants(door_ctx_t *d, const cred_rec_t *rec)
+{
+	const char *method = cred_method_name((cred_method_t)rec->method);
+	bool panel = door_is_panel(d);
+	policy_decision_t pd = policy_decide(g_policy, d->policy_id, (cred_method_t)rec->method,
+	                                     rec->id, rec->id_len, ctrl_policy_slot());
+	if (pd != POLICY_ALLOW) {
+		ESP_LOGW(TAG, "Puerta %u: credencial %s rechazada por la política (%s)", d->policy_id, method,
+		         policy_decision_name(pd));
+		if (panel) lcd_show_result("ACCESS DENIED!", pd == POLICY_DENY_SCHEDULE ? "OUT OF SCHEDULE" : "");
+		log_event(d->policy_id, method, false, door_status_str(d));
+		if (panel) fb_post(FB_DENIED);
+		cmd_ack_stage(rec->cmd, CMD_ST_DENIED);
+		return false;
+	}
+
+	int64_t now = hal_time_us();
+	if (fusion_offer(&d->fusion, rec, now) == FUSION_GRANT) {
+		// Solo aquí hay acceso: con RFID+PIN, 2 de 3 o dos personas, el
+		// primer factor únicamente queda guardado
+		if (rec->method != CRED_REMOTE) {
+			if (panel) lcd_show_result("ACCESS GRANTED!", "WELCOME HOME");
+			log_event(d->policy_id, method, true, door_status_str(d));
 		}
+		// La concesión consume todos los factores guardados
+		cmd_ack_advance(d, CMD_ST_BIT(CMD_ST_PENDING), CMD_ST_AUTHORIZED);
+		cmd_ack_stage(rec->cmd, CMD_ST_AUTHORIZED);
+		return true;
+	}
+	if (panel) lcd_show_progress("FACTOR OK", "NEXT FACTOR...");
+	cmd_ack_stage(rec->cmd, CMD_ST_PENDING);
+	ESP_LOGI(TAG, "Puerta %u: factor %s guardado (%u vigentes, regla %s)", d->policy_id,
+	         cred_method_name((cred_method_t)rec->method), fusion_pending(&d->fusion),
+	         fusion_rule_name(d->fusion.cfg.rule));
+	return false;
+}
 
-		if (!granted) {
-			// Bits recibidos pero no cumplen condición (p.ej. solo RFID en modo AND). Continúa esperando.
-			continue;
+// Ejecuta las acciones devueltas por access_fsm_step() en la puerta d
+static void ctrl_apply(door_ctx_t *d, uint8_t act)
+{
+	if (act & ACCESS_ACT_CANCEL_RELOCK) sched_cancel(DL_RELOCK(d->idx));
+	if (act & ACCESS_ACT_CANCEL_UNLOCK_MAX) sched_cancel(DL_UNLOCK_MAX(d->idx));
+	if (act & ACCESS_ACT_LOCK) lock_door(d);
+	if (act & ACCESS_ACT_UNLOCK) unlock_door(d);
+	const app_cfg_t *cfg = cfg_acquire(&g_cfg);
+	if (act & ACCESS_ACT_ARM_RELOCK) {
+		sched_arm_in(DL_RELOCK(d->idx), cfg->relock_ms);
+		ESP_LOGI(TAG, "Puerta %u: re-bloqueo armado para %ld ms después del cierre", d->policy_id,
+		         (long)cfg->relock_ms);
+	}
+	if (act & ACCESS_ACT_ARM_UNLOCK_MAX) sched_arm_in(DL_UNLOCK_MAX(d->idx), cfg->unlock_max_ms);
+	cfg_release(&g_cfg, cfg);
+	if (act & ACCESS_ACT_WAIT_CLOSE) {
+		ESP_LOGW(TAG, "Puerta %u: acceso listo pero puerta ABIERTA; esperando cierre para desbloquear", d->policy_id);
+	}
+	if (act & ACCESS_ACT_WARN_OPEN) {
+		ESP_LOGW(TAG, "Puerta %u: tiempo max. alcanzado pero puerta ABIERTA; esperando cierre para lock", d->policy_id);
+	}
+}
+
+// El gemelo y el documento de estado describen la puerta del panel
+static void ctrl_publish_state(door_ctx_t *d, access_state_t st)
+{
+	portENTER_CRITICAL(&g_ctrl_mux);
+	d->state_pub = st;
+	portEXIT_CRITICAL(&g_ctrl_mux);
+	if (!door_is_panel(d)) return;
+	twin_update(TWIN_F_STATE, st);
+	twin_update(TWIN_F_LOCKED, access_state_is_locked(st));
+	twin_update(TWIN_F_DOOR, access_state_door_closed(st));
+	twin_update(TWIN_F_RELOCK, st == ACCESS_RELOCK_PENDING);
+}
+
+// Traduce un evento de la cola a evento de la máquina de la puerta d;
+// false si se descarta. Las credenciales no pasan por aquí: ver
+// ctrl_drain_credentials().
+static bool ctrl_translate(const door_ctx_t *d, const ctrl_evt_t *ev, access_event_t *out)
+{
+	switch (ev->kind) {
+	case CTRL_EV_CREDENTIAL:
+		return false;
+	case CTRL_EV_DOOR: {
+		bool closed = (ev->door_ev.state == DOOR_CLOSED);
+		if (closed == access_state_door_closed(d->fsm.state)) return false; // Sin cambio
+		ESP_LOGI(TAG, "Puerta %u: reed %lld us flanco->evento (flancos=%u glitches=%u max=%lld us)",
+		         d->policy_id, (long long)(ev->ts_us - ev->door_ev.edge_us), (unsigned)d->db.edges,
+		         (unsigned)d->db.glitches, (long long)d->db.max_latency_us);
+		ESP_LOGI(TAG, "Puerta %u: %s", d->policy_id, closed ? "CERRADA" : "ABIERTA");
+		log_event(d->policy_id, "door", false, closed ? "close" : "open");
+		*out = closed ? ACCESS_EV_DOOR_CLOSED : ACCESS_EV_DOOR_OPEN;
+		return true;
+	}
+	case CTRL_EV_TIMER:
+		// Rearmado después de disparar: este vencimiento quedó obsoleto
+		if (sched_is_armed(ev->timer_id)) return false;
+		*out = (ev->timer_id == DL_RELOCK(d->idx)) ? ACCESS_EV_RELOCK_DUE : ACCESS_EV_UNLOCK_MAX_DUE;
+		return true;
+	case CTRL_EV_POLICY:
+		ctrl_policy_install(ev->policy);
+		return false;
+	}
+	return false;
+}
+
+static void ctrl_step(door_ctx_t *d, access_event_t aev)
+{
+	access_state_t prev = d->fsm.state;
+	uint8_t act = access_fsm_step(&d->fsm, aev);
+	ctrl_publish_state(d, d->fsm.state);
+	if (prev != d->fsm.state) {
+		ESP_LOGI(TAG, "Puerta %u: FSM %s --%s--> %s", d->policy_id, access_state_name(prev),
+		         access_event_name(aev), access_state_name(d->fsm.state));
+	}
+	ctrl_apply(d, act);
+	// Acuses: una apertura pendiente avanza con la cerradura, no con la orden
+	if (d->fsm.state == ACCESS_GRANTED_WAIT_CLOSE) cmd_ack_advance(d, CMD_ST_BIT(CMD_ST_AUTHORIZED), CMD_ST_WAITING_DOOR);
+	if (!access_state_is_locked(d->fsm.state)) {
+		cmd_ack_advance(d, CMD_ST_BIT(CMD_ST_AUTHORIZED) | CMD_ST_BIT(CMD_ST_WAITING_DOOR), CMD_ST_ACTUATED);
+	}
+	if (act & ACCESS_ACT_LOCK) cmd_ack_advance(d, CMD_ST_BIT(CMD_ST_ACTUATED), CMD_ST_RELOCKED);
+}
+
+// Consume en orden todas las credenciales pendientes de la puerta d (remotas primero)
+static void ctrl_drain_credentials(door_ctx_t *d)
+{
+	for (;;) {
+		cred_rec_t rec;
+		portENTER_CRITICAL(&d->cred_mux);
+		bool got = cred_queue_pop(&d->cred_q, &rec);
+		cred_queue_stats_t st = d->cred_q.st;
+		portEXIT_CRITICAL(&d->cred_mux);
+		if (!got) break;
+
+		char id[2 * CRED_ID_MAX + 1] = "-";
+		if (rec.method == CRED_REMOTE && rec.id_len) {
+			snprintf(id, sizeof(id), "%.*s", rec.id_len, (const char *)rec.id);
+		} else {
+			for (int i = 0; i < rec.id_len; ++i) snprintf(&id[2 * i], 3, "%02X", rec.id[i]);
+		}
+		ESP_LOGI(TAG, "Puerta %u: credencial #%u %s id=%s (%lld us en cola)", d->policy_id, (unsigned)rec.seq,
+		         cred_method_name((cred_method_t)rec.method), id,
+		         (long long)(hal_time_us() - rec.ts_us));
+		uint32_t overflow = st.overflow[CRED_LANE_NORMAL] + st.overflow[CRED_LANE_PRIO];
+		if (overflow != d->seen_overflow) {
+			ESP_LOGW(TAG, "Puerta %u: credenciales perdidas por desbordamiento: normal=%u remoto=%u (última #%u)",
+			         d->policy_id, (unsigned)st.overflow[CRED_LANE_NORMAL], (unsigned)st.overflow[CRED_LANE_PRIO],
+			         (unsigned)st.last_overflow_seq);
+			d->seen_overflow = overflow;
 		}
 
-		if (g_door_state != DOOR_CLOSED) {
-			ESP_LOGW(TAG, "Acceso listo pero puerta ABIERTA; esperando cierre para desbloquear");
-			xEventGroupWaitBits(g_events, EVT_DOOR_CLOSED, pdFALSE, pdTRUE, portMAX_DELAY);
+		if (ctrl_credential_grants(d, &rec)) ctrl_step(d, ACCESS_EV_GRANT);
+	}
+}
+
+static void control_task(void *arg)
+{
+	// La política guardada llega después como CTRL_EV_POLICY (paso "policy",
+	// tras montar SPIFFS); mientras tanto rige la de por defecto
+	policy_t *pol = ctrl_policy_default();
+	if (pol) ctrl_policy_install(pol);
+	else ctrl_fusion_init(-1, 0);
+	// Arranque: establecer estado bloqueado coherente en cada puerta
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		door_ctx_t *d = &g_doors[i];
+		bool closed = (read_door_state(d) == DOOR_CLOSED);
+		uint8_t act = access_fsm_init(&d->fsm, closed);
+		ctrl_publish_state(d, d->fsm.state);
+		log_event(d->policy_id, "door", false, closed ? "close" : "open");
+		if (closed) {
+			ctrl_apply(d, act);
+		} else {
+			lock_apply_locked_hw(d, true);
+			if (door_is_panel(d)) set_locked_state(true);
 		}
-		unlock_door();
-		// Limpieza de bits de acceso para siguiente ciclo (los ya consumidos fueron clear por pdTRUE)
-		xEventGroupClearBits(g_events, EVT_RFID_OK | EVT_COMBO_OK | EVT_REMOTE_OK);
+		ESP_LOGI(TAG, "Puerta %u en %s", d->policy_id, access_state_name(d->fsm.state));
+	}
+	g_boot_door_ready_us = hal_time_us();
+	ESP_LOGI(TAG, "Controlador de %d puerta(s); esperando eventos (RFID, combo, remoto, puerta)", DOOR_COUNT);
+
+	for (;;) {
+		ctrl_evt_t ev;
+		xQueueReceive(g_ctrl_q, &ev, portMAX_DELAY);
+		hal_pm_busy(true); // Decisión y relé a la frecuencia máxima
+		task_late(TASK_CONTROL, hal_time_us() - ev.ts_us);
+		access_event_t aev;
+		door_ctx_t *d = &g_doors[ev.door < DOOR_COUNT ? ev.door : PANEL_DOOR];
+		if (ctrl_translate(d, &ev, &aev)) ctrl_step(d, aev);
+		// Cualquier despertar vacía también las credenciales de todas las
+		// puertas (aviso perdido incluido)
+		for (int i = 0; i < DOOR_COUNT; ++i) ctrl_drain_credentials(&g_doors[i]);
+		hal_pm_busy(false);
 	}
 }
 
@@ -1316,61 +2211,289 @@ static void control_task(void *arg)
 // ==================   INICIALIZACIÓN GENERAL   ===============
 // =============================================================
 
+// ===== Configuración de ejecución (NVS, por hal_kv) =====
+static bool cfg_kv_get_i32(void *ctx, const char *key, int32_t *out)
+{
+	return hal_kv_get_i32(key, out);
+}
+
+static bool cfg_kv_set_i32(void *ctx, const char *key, int32_t v)
+{
+	return hal_kv_set_i32(key, v);
+}
+
+static bool cfg_kv_get_str(void *ctx, const char *key, char *out, size_t cap)
+{
+	return hal_kv_get_str(key, out, cap);
+}
+
+static bool cfg_kv_set_str(void *ctx, const char *key, const char *v)
+{
+	return hal_kv_set_str(key, v);
+}
+
+static bool cfg_kv_commit(void *ctx)
+{
+	return hal_kv_commit();
+}
+
+static const cfg_backend_t g_cfg_backend = {
+	.get_i32 = cfg_kv_get_i32, .set_i32 = cfg_kv_set_i32,
+	.get_str = cfg_kv_get_str, .set_str = cfg_kv_set_str,
+	.commit = cfg_kv_commit,
+};
+
+// Valores de fábrica: los #define de CONFIGURACIÓN
+static void cfg_factory(app_cfg_t *c)
+{
+	memset(c, 0, sizeof(*c));
+	snprintf(c->wifi_ssid, sizeof(c->wifi_ssid), "%s", WIFI_SSID);
+	snprintf(c->wifi_pass, sizeof(c->wifi_pass), "%s", WIFI_PASS);
+	snprintf(c->mqtt_uri, sizeof(c->mqtt_uri), "%s", MQTT_BROKER);
+	for (int i = 0; i < COMBO_LEN; ++i) c->combo[i] = (char)('0' + COMBO_TARGET[i]);
+	c->unlock_max_ms = UNLOCK_MAX_OPEN_TIME_MS;
+	c->relock_ms = RELOCK_DELAY_MS;
+	c->pot_settle_ms = POT_SETTLE_MS;
+	c->lcd_idle_ms = LCD_IDLE_TIMEOUT_MS;
+	c->twin_min_ms = TWIN_MIN_MS;
+	c->power = POWER_PROFILE;
+	c->pins = (cfg_pins_t){
+		.lock = LOCK_GPIO, .door = DOOR_SENSOR_GPIO, .buzzer = BUZZER_GPIO,
+		.led_status = LED_STATUS_GPIO, .led_green = LED_GREEN_GPIO, .led_red = LED_RED_GPIO,
+		.pot = POT_ADC_GPIO, .i2c_sda = I2C_SDA_GPIO, .i2c_scl = I2C_SCL_GPIO,
+		.rfid_cs = RFID_SPI_CS_GPIO, .rfid_sck = RFID_SPI_SCK_GPIO, .rfid_mosi = RFID_SPI_MOSI_GPIO,
+		.rfid_miso = RFID_SPI_MISO_GPIO, .rfid_rst = RFID_RST_GPIO,
+	};
+}
+
+// Tras hal_kv_init(): carga la configuración y fija los pines del arranque
+static void cfg_init(void)
+{
+	app_cfg_t def;
+	cfg_factory(&def);
+	const cfg_backend_t *be = NULL;
+	if (hal_kv_open(CFG_NVS_NAMESPACE)) be = &g_cfg_backend;
+	else ESP_LOGE(TAG, "NVS '%s' no disponible: configuración de fábrica", CFG_NVS_NAMESPACE);
+
+	cfg_load_report_t rep;
+	int64_t t0 = hal_time_us();
+	cfg_boot(&g_cfg, &def, be, hal_time_us, &rep);
+	int64_t dt = hal_time_us() - t0;
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	g_pins = c->pins;
+	cfg_release(&g_cfg, c);
+	ESP_LOGI(TAG, "Config: esquema %u (guardado %u), %u de NVS, %u de fábrica, %u fuera de rango; %lld us",
+	         CFG_SCHEMA_VERSION, (unsigned)rep.stored_schema, rep.loaded, rep.defaulted, rep.rejected,
+	         (long long)dt);
+}
+
 static void gpio_basic_init(void)
 {
 	// Nada especial aquí por ahora
 }
 
-// ===== Código WiFi/MQTT reutilizado de main_mqtt.c =====
-// (Definición de g_mqtt_client movida arriba para visibilidad en log_event)
+// Recepción de POLICY_TOPIC: el cliente MQTT entrega los mensajes grandes en
+// trozos (solo el primero trae el topic); se reensamblan, se compilan aquí y
+// la política compilada se entrega a control_task por g_ctrl_q.
+static char *s_policy_rx = NULL;
+static int s_policy_rx_len = 0;
+
+// Resultado en MQTT_TOPIC; err NULL: instalada (versión y tamaño copiados
+// antes de entregarla, desde entonces es de control_task)
+static void policy_publish_result(uint32_t version, uint32_t rules, uint32_t creds, const char *err)
+{
+	if (!hal_mqtt_ready()) return;
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "device_id", DEVICE_ID);
+	cJSON_AddBoolToObject(root, "policy_ok", err == NULL);
+	if (!err) {
+		cJSON_AddNumberToObject(root, "policy_version", version);
+		cJSON_AddNumberToObject(root, "rules", rules);
+		cJSON_AddNumberToObject(root, "credentials", creds);
+	} else {
+		cJSON_AddStringToObject(root, "error", err);
+	}
+	char *payload = cJSON_PrintUnformatted(root);
+	if (payload) hal_mqtt_publish(MQTT_TOPIC, payload, 0, 1, 0);
+	cJSON_Delete(root);
+	free(payload);
+}
 
-// Helper para obtener modelo de chip (igual a main_mqtt.c)
-static const char *get_chip_model()
+static void policy_rx_chunk(const hal_mqtt_event_t *event)
 {
-	esp_chip_info_t chip_info;
-	esp_chip_info(&chip_info);
-	switch (chip_info.model) {
-	case CHIP_ESP32:   return "ESP32_Classic";
-	case CHIP_ESP32S3: return "ESP32_S3";
-	case CHIP_ESP32C3: return "ESP32_C3";
-	default:           return "ESP_Unknown";
+	if (event->offset == 0) {
+		free(s_policy_rx);
+		s_policy_rx = NULL;
+		if (event->total_len <= 0 || event->total_len > POLICY_JSON_MAX) {
+			ESP_LOGW(TAG, "Política de %d bytes descartada (máx %d)", event->total_len, POLICY_JSON_MAX);
+			policy_publish_result(0, 0, 0, "too large");
+			return;
+		}
+		s_policy_rx = malloc((size_t)event->total_len);
+		s_policy_rx_len = event->total_len;
+		if (!s_policy_rx) {
+			policy_publish_result(0, 0, 0, "no memory");
+			return;
+		}
+	}
+	if (!s_policy_rx || event->offset + event->data_len > s_policy_rx_len) return;
+	memcpy(s_policy_rx + event->offset, event->data, event->data_len);
+	if (event->offset + event->data_len < s_policy_rx_len) return; // Faltan trozos
+
+	char err[64];
+	int64_t t0 = hal_time_us();
+	policy_t *p = policy_compile(s_policy_rx, (size_t)s_policy_rx_len, err, sizeof(err));
+	if (p) {
+		ESP_LOGI(TAG, "Política v%u compilada en %lld us", (unsigned)p->version,
+		         (long long)(hal_time_us() - t0));
+		uint32_t version = p->version, rules = p->n_rules, creds = p->n_creds;
+		// Se guarda y se confirma solo si control_task la recibe: si no, la
+		// guardada sigue siendo la vigente y el operador puede reintentar
+		if (ctrl_post_policy(p)) {
+			FILE *f = fopen(POLICY_FILE_PATH, "w");
+			if (f) {
+				fwrite(s_policy_rx, 1, (size_t)s_policy_rx_len, f);
+				fclose(f);
+			}
+			policy_publish_result(version, rules, creds, NULL);
+		} else {
+			policy_publish_result(0, 0, 0, "busy");
+		}
+	} else {
+		ESP_LOGW(TAG, "Política rechazada: %s", err);
+		policy_publish_result(0, 0, 0, err);
 	}
+	free(s_policy_rx);
+	s_policy_rx = NULL;
+}
+
+static bool mqtt_topic_is(const hal_mqtt_event_t *event, const char *topic)
+{
+	return event->topic_len == (int)strlen(topic) && strncmp(event->topic, topic, event->topic_len) == 0;
 }
 
-static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+static void config_publish_result(cfg_err_t rc, uint64_t changed, const char *err, int64_t update_us)
 {
-	if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-		esp_wifi_connect();
-	} else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-		esp_wifi_connect();
-		ESP_LOGW(TAG, "Retrying WiFi...");
-	} else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-		ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-		ESP_LOGI(TAG, "WiFi Connected! IP: " IPSTR, IP2STR(&event->ip_info.ip));
+	if (!hal_mqtt_ready()) return;
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	uint32_t gen = c->gen;
+	cfg_release(&g_cfg, c);
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "device_id", DEVICE_ID);
+	cJSON_AddBoolToObject(root, "config_ok", rc == CFG_OK);
+	cJSON_AddNumberToObject(root, "config_gen", gen);
+	if (rc == CFG_OK) {
+		cJSON *keys = cJSON_AddArrayToObject(root, "changed");
+		for (size_t i = 0; i < cfg_field_count; ++i) {
+			if (changed >> i & 1u) cJSON_AddItemToArray(keys, cJSON_CreateString(cfg_fields[i].key));
+		}
+		cJSON_AddBoolToObject(root, "reboot_required", cfg_changed_with_flag(changed, CFG_F_REBOOT));
+		cJSON_AddNumberToObject(root, "update_us", (double)update_us);
+	} else {
+		cJSON_AddStringToObject(root, "error", err[0] ? err : cfg_err_name(rc));
+	}
+	char *payload = cJSON_PrintUnformatted(root);
+	if (payload) hal_mqtt_publish(MQTT_TOPIC, payload, 0, 1, 0);
+	cJSON_Delete(root);
+	free(payload);
+}
+
+// Parche de configuración (CONFIG_TOPIC): se valida, se guarda en NVS y se
+// publica una instantánea nueva; los lectores la ven en su siguiente
+// iteración. Red y broker se reaplican aquí; los pines, al reiniciar.
+static void config_rx(const hal_mqtt_event_t *event)
+{
+	uint64_t changed = 0;
+	char err[96] = "";
+	cfg_err_t rc = CFG_ERR_PARSE;
+	int64_t t0 = hal_time_us();
+	if (event->data_len != event->total_len) {
+		snprintf(err, sizeof(err), "mensaje fragmentado (%d bytes)", event->total_len);
+	} else {
+		for (int i = 0; ; ++i) {
+			rc = cfg_update_json(&g_cfg, event->data, (size_t)event->data_len, &changed, err, sizeof(err));
+			if (rc != CFG_ERR_BUSY || i == CONFIG_BUSY_RETRIES) break;
+			vTaskDelay(pdMS_TO_TICKS(20)); // Algún lector retiene las instantáneas anteriores
+		}
+	}
+	int64_t dt = hal_time_us() - t0;
+	if (rc != CFG_OK) {
+		ESP_LOGW(TAG, "Config rechazada (%s): %s", cfg_err_name(rc), err);
+		config_publish_result(rc, 0, err, dt);
+		return;
+	}
+	ESP_LOGI(TAG, "Config: %d campo(s) cambiado(s) en %lld us%s", __builtin_popcountll(changed),
+	         (long long)dt, cfg_changed_with_flag(changed, CFG_F_REBOOT) ? " (pines: al reiniciar)" : "");
+	config_publish_result(rc, changed, err, dt);
+
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	if (changed & ((1ull << cfg_field_index("wifi_ssid")) | (1ull << cfg_field_index("wifi_pass")))) {
+		ESP_LOGI(TAG, "WiFi: reconectando a \"%s\"", c->wifi_ssid);
+		hal_net_reconfigure(c->wifi_ssid, c->wifi_pass);
+	}
+	if (changed & (1ull << cfg_field_index("twin_min_ms"))) {
+		portENTER_CRITICAL(&g_twin_mux);
+		twin_set_rate(&g_twin, (uint32_t)c->twin_min_ms); // Desde el próximo cuadro
+		portEXIT_CRITICAL(&g_twin_mux);
 	}
+	if (changed & (1ull << cfg_field_index("power"))) power_apply(c->power);
+	if (changed & (1ull << cfg_field_index("mqtt_uri"))) {
+		ESP_LOGI(TAG, "MQTT: nuevo broker %s", c->mqtt_uri);
+		hal_mqtt_set_uri(c->mqtt_uri);
+	}
+	cfg_release(&g_cfg, c);
 }
 
-static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+// En la tarea del cliente MQTT (hal_mqtt_start)
+static void mqtt_event_handler(const hal_mqtt_event_t *event)
 {
-	esp_mqtt_event_handle_t event = event_data;
-	switch (event_id) {
-	case MQTT_EVENT_CONNECTED: {
+	switch (event->kind) {
+	case HAL_MQTT_CONNECTED: {
 		ESP_LOGI(TAG, "MQTT Connected. Enviando payload inicial...");
 		cJSON *root = cJSON_CreateObject();
-		cJSON_AddStringToObject(root, "device", get_chip_model());
-		cJSON_AddNumberToObject(root, "uptime_sec", esp_timer_get_time() / 1000000);
-		cJSON_AddStringToObject(root, "ssid", WIFI_SSID);
+		cJSON_AddStringToObject(root, "device", hal_chip_model());
+		cJSON_AddNumberToObject(root, "uptime_sec", hal_time_us() / 1000000);
+		const app_cfg_t *c = cfg_acquire(&g_cfg);
+		cJSON_AddStringToObject(root, "ssid", c->wifi_ssid);
+		cJSON_AddNumberToObject(root, "config_gen", c->gen);
+		cfg_release(&g_cfg, c);
 		char *payload = cJSON_PrintUnformatted(root);
-		esp_mqtt_client_publish(event->client, MQTT_TOPIC, payload, 0, 1, 0);
+		hal_mqtt_publish(MQTT_TOPIC, payload, 0, 1, 0);
 		ESP_LOGI(TAG, "Published init: %s", payload);
 		cJSON_Delete(root);
 		free(payload);
 		// Suscribir al topic de comandos remoto
-		esp_mqtt_client_subscribe(event->client, "iot/commands", 1);
-		ESP_LOGI(TAG, "Suscrito a iot/commands para comandos remotos");
+		hal_mqtt_subscribe("iot/commands", 1);
+		hal_mqtt_subscribe(POLICY_TOPIC, 1);
+		hal_mqtt_subscribe(CONFIG_TOPIC, 1);
+		hal_mqtt_subscribe(TWIN_RESYNC_TOPIC, 0);
+		hal_mqtt_subscribe(PROF_CTRL_TOPIC, 0);
+		ESP_LOGI(TAG, "Suscrito a iot/commands (comandos remotos), " POLICY_TOPIC " (política), "
+		         CONFIG_TOPIC " (configuración), " TWIN_RESYNC_TOPIC " (gemelo) y " PROF_CTRL_TOPIC " (perfilado)");
+		twin_resync(); // Sesión nueva: el gemelo parte de una instantánea
+		state_doc_republish();
 		break;
 	}
-	case MQTT_EVENT_DATA: {
+	case HAL_MQTT_DATA: {
+		// Política (posiblemente en varios trozos; los siguientes llegan sin topic)
+		if ((event->offset == 0 && mqtt_topic_is(event, POLICY_TOPIC)) ||
+		    (event->offset > 0 && s_policy_rx)) {
+			policy_rx_chunk(event);
+			break;
+		}
+		if (event->offset == 0 && mqtt_topic_is(event, CONFIG_TOPIC)) {
+			config_rx(event);
+			break;
+		}
+		if (mqtt_topic_is(event, TWIN_RESYNC_TOPIC)) {
+			ESP_LOGI(TAG, "Gemelo pide instantánea (seq actual %u)", (unsigned)g_twin.seq);
+			twin_resync();
+			break;
+		}
+		if (mqtt_topic_is(event, PROF_CTRL_TOPIC)) {
+			prof_rx(event);
+			break;
+		}
 		// Verificar topic
 		if (event->topic_len == (int)strlen("iot/commands") && strncmp(event->topic, "iot/commands", event->topic_len) == 0) {
 			ESP_LOGI(TAG, "Comando remoto MQTT recibido (len=%d)", event->data_len);
@@ -1380,6 +2503,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 			memcpy(buf, event->data, copy_len);
 			buf[copy_len] = '\0';
 			bool unlock_request = false;
+			const char *user = NULL;
+			int cmd = 0; // Manejador de acuses (cmd_ack.h) si la orden trae "id"
+			bool kick = false;
+			door_ctx_t *door = &g_doors[PANEL_DOOR];
 			cJSON *json = cJSON_Parse(buf);
 			if (json) {
 				// Aceptar si hay campo action="unlock" o unlock=true; si no, cualquier JSON concede
@@ -1392,14 +2519,37 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 					// Sin claves específicas: interpretar cualquier JSON como solicitud
 					unlock_request = true;
 				}
+				// Usuario remoto opcional: viaja con la credencial
+				cJSON *juser = cJSON_GetObjectItem(json, "user");
+				if (cJSON_IsString(juser)) user = juser->valuestring;
+				// Puerta opcional (id en la política); sin ella, la del panel
+				cJSON *jdoor = cJSON_GetObjectItem(json, "door");
+				if (jdoor) door = cJSON_IsNumber(jdoor) ? door_by_policy_id((long)jdoor->valuedouble) : NULL;
+				// Id de correlación opcional: acuses en CMD_ACK_TOPIC y sin repeticiones
+				cJSON *jid = cJSON_GetObjectItem(json, "id");
+				if (jid) {
+					uint16_t ack_door = door ? door->policy_id : 0;
+					portENTER_CRITICAL(&g_cmd_mux);
+					cmd = cJSON_IsString(jid) ? cmd_receive(&g_cmd, jid->valuestring, ack_door, hal_time_us(), &kick) : -1;
+					portEXIT_CRITICAL(&g_cmd_mux);
+					if (kick) sched_arm_in(DL_ACK, 0);
+				}
 			}
-			if (unlock_request) {
-				// log_event("remote", true, (g_door_state==DOOR_CLOSED?"close":"open"));
-				xEventGroupSetBits(g_events, EVT_REMOTE_OK);
-				ESP_LOGI(TAG, "Solicitud remota de desbloqueo aceptada");
+			if (cmd == 0 && json && cJSON_GetObjectItem(json, "id")) {
+				ESP_LOGW(TAG, "Orden remota repetida; no se ejecuta de nuevo");
+			} else if (cmd < 0) {
+				ESP_LOGW(TAG, "Orden remota con id no válido (texto de 1 a %d caracteres); descartada", CMD_ID_MAX);
+			} else if (!door) {
+				ESP_LOGW(TAG, "Orden remota para una puerta que no es de esta placa");
+				cmd_ack_stage(cmd, CMD_ST_REJECTED);
+			} else if (unlock_request) {
+				// log_event(door->policy_id, "remote", true, door_status_str(door));
+				cred_post(door, CRED_REMOTE, (const uint8_t *)user, user ? strlen(user) : 0, cmd);
+				ESP_LOGI(TAG, "Solicitud remota de desbloqueo aceptada (puerta %u)", door->policy_id);
 			} else {
-				// log_event("remote", false, (g_door_state==DOOR_CLOSED?"close":"open"));
+				// log_event(door->policy_id, "remote", false, door_status_str(door));
 				ESP_LOGW(TAG, "JSON remoto no contiene accion de desbloqueo");
+				cmd_ack_stage(cmd, CMD_ST_REJECTED);
 			}
 			if (json) cJSON_Delete(json);
 		}
@@ -1410,81 +2560,253 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 	}
 }
 
-void app_main(void)
-{
-	ESP_LOGI(TAG, "Sistema de Acceso y Monitoreo de Seguridad");
+// ===== Arranque por grafo de dependencias (boot_graph.c) =====
+// Lo crítico (cerradura en reposo seguro, sensor de puerta y controlador) lo
+// ejecuta app_main en cuanto arranca; red, SPIFFS, LCD, potenciómetro y RFID
+// los ejecutan BOOT_WORKERS tareas en paralelo, cada paso al estar listas sus
+// dependencias. Un corte de luz ya no deja la puerta sin atender mientras se
+// monta SPIFFS (formateo incluido) o se inicializa el LCD. Entre pasos
+// listos a la vez gana el declarado antes: lo breve e interactivo primero y
+// el LCD (patrón de diagnóstico de ~2,7 s) antes que la red para solaparlos.
+enum {
+	BOOT_NVS = 0, BOOT_LOCK, BOOT_CORE, BOOT_DOOR, BOOT_CONTROL,
+	BOOT_POT, BOOT_RFID, BOOT_LCD, BOOT_NET, BOOT_FS, BOOT_POLICY, BOOT_MQTT,
+};
 
-	// ===== Inicialización NVS y WiFi/MQTT (copiado de main_mqtt.c) =====
-	esp_err_t ret = nvs_flash_init();
-	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		ret = nvs_flash_init();
-	}
-	ESP_ERROR_CHECK(ret);
+static boot_graph_t g_boot;
+static portMUX_TYPE g_boot_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t g_boot_progress; // Un "give" por trabajador en cada paso terminado
+static StaticSemaphore_t s_boot_progress_buf;
 
-	esp_netif_init();
-	esp_event_loop_create_default();
-	esp_netif_create_default_wifi_sta();
-	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-	esp_wifi_init(&cfg);
+static void boot_step_nvs(void)
+{
+	if (!hal_kv_init()) abort();
+	cfg_init(); // Antes de cualquier uso de pines, red o tiempos configurables
+	doors_bind();
+	// Antes de que control_task o pot_task anoten campos del gemelo
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	twin_init(&g_twin, (uint32_t)c->twin_min_ms, TWIN_HEARTBEAT_MS);
+	twin_init(&g_state_doc, STATE_MIN_MS, 0);
+	cfg_release(&g_cfg, c);
+}
 
-	esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL);
-	esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL);
+static void boot_step_lock(void)
+{
+	gpio_basic_init();
+	lock_hw_init();
+	leds_init();
+	buzzer_init();
+	fb_init_timers();
+}
 
-	wifi_config_t wifi_config = {
-		.sta = {
-			.threshold.authmode = WIFI_AUTH_WPA2_PSK,
-			.pmf_cfg = {.capable = true, .required = false}
-		},
-	};
+static void boot_step_core(void)
+{
+	g_ctrl_q = xQueueCreateStatic(CTRL_QUEUE_LEN, sizeof(ctrl_evt_t), s_ctrl_q_store, &s_ctrl_q_buf);
+	for (int i = 0; i < DOOR_COUNT; ++i) cred_queue_init(&g_doors[i].cred_q);
+	cmd_init(&g_cmd);
+	g_log_mutex = xSemaphoreCreateMutexStatic(&s_log_mutex_buf);
+	sched_init();
+	for (int i = 0; i < DOOR_COUNT; ++i) {
+		sched_register(DL_RELOCK(i),     "relock",     ctrl_deadline_cb, &g_doors[i]);
+		sched_register(DL_UNLOCK_MAX(i), "unlock_max", ctrl_deadline_cb, &g_doors[i]);
+	}
+	sched_register(DL_LCD,         "lcd",         lcd_deadline_cb,  NULL);
+	sched_register(DL_TWIN,        "twin",        twin_deadline_cb, NULL);
+	sched_register(DL_STATE,       "state",       state_deadline_cb, NULL);
+	sched_register(DL_ACK,         "ack",         ack_deadline_cb,  NULL);
+	sched_register(DL_POWER,       "power",       power_deadline_cb, NULL);
+	sched_register(DL_PROF,        "prof",        prof_deadline_cb, NULL);
+	task_start(TASK_PROF, prof_task, NULL, &g_prof_task);
+#if PROF_AT_BOOT
+	prof_request((prof_req_t){ .set = true, .on = true, .uart = true, .hz = PROF_HZ });
+#endif
+}
 
-	strncpy((char *)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid) - 1);
-	strncpy((char *)wifi_config.sta.password, WIFI_PASS, sizeof(wifi_config.sta.password) - 1);
+static void boot_step_control(void)
+{
+	// El estado inicial de puerta lo registra control_task al arrancar
+	task_start(TASK_CONTROL, control_task, NULL, NULL);
+}
 
-	esp_wifi_set_mode(WIFI_MODE_STA);
-	esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-	esp_wifi_start();
+static void boot_step_net(void)
+{
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	power_apply(c->power); // El modo de la radio se fija antes de asociarse
+	hal_net_start(c->wifi_ssid, c->wifi_pass);
+	cfg_release(&g_cfg, c);
+}
 
-	esp_mqtt_client_config_t mqtt_cfg = { .broker.address.uri = MQTT_BROKER };
-	g_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
-	esp_mqtt_client_register_event(g_mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-	esp_mqtt_client_start(g_mqtt_client);
+static void boot_step_policy(void)
+{
+	// Va antes que MQTT: una política remota nunca queda pisada por la guardada
+	policy_t *p = ctrl_policy_load();
+	if (p) ctrl_post_policy(p);
+}
 
-	g_events = xEventGroupCreate();
+static void boot_step_mqtt(void)
+{
+	// El cliente copia la URI: la instantánea se suelta justo después
+	const app_cfg_t *c = cfg_acquire(&g_cfg);
+	bool ok = hal_mqtt_start(c->mqtt_uri, mqtt_event_handler);
+	cfg_release(&g_cfg, c);
+	if (!ok) ESP_LOGE(TAG, "No se pudo crear el cliente MQTT");
+	g_power_t0_us = hal_time_us();
+	hal_pm_idle_us(&g_power_idle0_us);
+	sched_arm_in(DL_POWER, POWER_REPORT_MS);
+}
 
-	gpio_basic_init();
-	leds_init();
-	fs_init(); // Montar SPIFFS antes de posibles logs
-	buzzer_init();
+static void boot_step_lcd(void)
+{
 #if LCD_AUTOPROBE
 	// Ejecuta auto-probe visual antes de usar el driver LCD normal
 	lcd_autoprobe_run();
 #endif
-	door_sensor_init();
-	lock_hw_init();
-	pot_init();
 	lcd_init();
 #if LCD_DEBUG_PATTERN
 	lcd_debug_pattern(); // Muestra patrón inicial para validar caracteres antes de flujo normal
 #endif
 	lcd_show_idle();
-	touch_activity();
+	task_start(TASK_LCD, lcd_task, NULL, &g_lcd_task);
+}
 
-	// Estado inicial de puerta
-	g_door_state = read_door_state();
-	if (g_door_state == DOOR_CLOSED) {
-		xEventGroupSetBits(g_events, EVT_DOOR_CLOSED);
-		log_event("door", false, "close");
-	} else {
-		xEventGroupClearBits(g_events, EVT_DOOR_CLOSED);
-		log_event("door", false, "open");
+static void boot_step_pot(void)
+{
+	pot_init();
+	task_start(TASK_POT, pot_task, NULL, &g_pot_task);
+}
+
+static void boot_step_rfid(void)
+{
+	task_start(TASK_RFID, rfid_task, NULL, NULL);
+}
+
+static const boot_step_t BOOT_STEPS[] = {
+	[BOOT_NVS]     = { "nvs",     0,                                                   BOOT_F_CRITICAL, boot_step_nvs },
+	[BOOT_LOCK]    = { "lock",    BOOT_DEP(BOOT_NVS),                                  BOOT_F_CRITICAL, boot_step_lock },
+	[BOOT_CORE]    = { "core",    0,                                                   BOOT_F_CRITICAL, boot_step_core },
+	[BOOT_DOOR]    = { "door",    BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),            BOOT_F_CRITICAL, door_sensor_init },
+	[BOOT_CONTROL] = { "control", BOOT_DEP(BOOT_LOCK) | BOOT_DEP(BOOT_DOOR),           BOOT_F_CRITICAL, boot_step_control },
+	[BOOT_POT]     = { "pot",     BOOT_DEP(BOOT_NVS),                                  0, boot_step_pot },
+	[BOOT_RFID]    = { "rfid",    BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),            0, boot_step_rfid },
+	[BOOT_LCD]     = { "lcd",     BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),            0, boot_step_lcd },
+	[BOOT_NET]     = { "net",     BOOT_DEP(BOOT_NVS),                                  0, boot_step_net },
+	[BOOT_FS]      = { "fs",      0,                                                   0, fs_init },
+	[BOOT_POLICY]  = { "policy",  BOOT_DEP(BOOT_FS) | BOOT_DEP(BOOT_CONTROL),          0, boot_step_policy },
+	[BOOT_MQTT]    = { "mqtt",    BOOT_DEP(BOOT_NET) | BOOT_DEP(BOOT_POLICY),          0, boot_step_mqtt },
+};
+
+// Informe al terminar el último paso; se encola (QoS 1) y sale al conectar
+static void boot_report_publish(void)
+{
+	// Estáticos: se llama una sola vez y la pila del trabajador es pequeña
+	static char graph[1280];
+	static char payload[1400];
+	int n = boot_graph_report(&g_boot, graph, sizeof(graph));
+	if (n < 0 || n >= (int)sizeof(graph)) {
+		ESP_LOGE(TAG, "Informe de arranque truncado (%d bytes)", n);
+		return;
 	}
+	snprintf(payload, sizeof(payload), "{\"device_id\":\"%s\",\"door_ready_us\":%lld,\"boot\":%s}",
+	         DEVICE_ID, (long long)g_boot_door_ready_us, graph);
+	ESP_LOGI(TAG, "Arranque: puerta lista a %lld us, todo a %lld us (en serie serían %lld us)",
+	         (long long)g_boot_door_ready_us, (long long)boot_graph_span_us(&g_boot, 0),
+	         (long long)boot_graph_serial_us(&g_boot));
+	if (hal_mqtt_ready()) hal_mqtt_enqueue(BOOT_TOPIC, payload, 0, 1, 0);
+}
 
-	// Tareas
-	xTaskCreatePinnedToCore(door_monitor_task, "door_mon", 4096, NULL, 6, NULL, tskNO_AFFINITY);
-	xTaskCreatePinnedToCore(pot_task,         "pot",      4096, NULL, 5, NULL, tskNO_AFFINITY);
-	xTaskCreatePinnedToCore(rfid_task,         "rfid",     4096, NULL, 4, NULL, tskNO_AFFINITY);
-	xTaskCreatePinnedToCore(control_task,      "control",  4096, NULL, 7, NULL, tskNO_AFFINITY);
-	xTaskCreatePinnedToCore(lcd_task,          "lcd",      3072, NULL, 3, NULL, tskNO_AFFINITY);
+static void boot_worker_task(void *arg)
+{
+	uint8_t worker = (uint8_t)(uintptr_t)arg;
+	for (;;) {
+		taskENTER_CRITICAL(&g_boot_mux);
+		int i = boot_graph_claim(&g_boot, 0);
+		bool pending = boot_graph_pending(&g_boot);
+		taskEXIT_CRITICAL(&g_boot_mux);
+		if (i < 0) {
+			if (!pending) break;
+			// Esperar a que otro trabajador termine un paso (semáforo contador)
+			xSemaphoreTake(g_boot_progress, portMAX_DELAY);
+			continue;
+		}
+		boot_graph_run(&g_boot, i, worker, hal_time_us);
+		ESP_LOGI(TAG, "Arranque: %s en %lld us", BOOT_STEPS[i].name,
+		         (long long)(g_boot.marks[i].end_us - g_boot.marks[i].start_us));
+		taskENTER_CRITICAL(&g_boot_mux);
+		boot_graph_done(&g_boot, i);
+		bool finished = boot_graph_finished(&g_boot);
+		taskEXIT_CRITICAL(&g_boot_mux);
+		for (int w = 0; w < BOOT_WORKERS; ++w) xSemaphoreGive(g_boot_progress);
+		if (finished) boot_report_publish();
+	}
+	vTaskDelete(NULL);
+}
+
+#if STACK_STRESS
+// Escenario para medir las pilas de las tareas permanentes (en banco: el
+// relé se acciona). Recorre sus caminos más profundos a la vez: credenciales
+// remotas, RFID y de combinación en cada puerta (política, log en SPIFFS y
+// MQTT, LCD, gemelo y documento de estado en control_task), textos en el
+// LCD, recargas de la política guardada y el perfilado activo (mutex
+// medidos y volcados). Al terminar, stack_report() en STACK_TOPIC; pot y
+// rfid ejercitan sus caminos con el potenciómetro y una tarjeta reales.
+static void stress_task(void *arg)
+{
+	static const uint8_t UID[] = { 0x5e, 0x55, 0x00, 0x01 };   // Desconocida: camino de rechazo
+	vTaskDelay(pdMS_TO_TICKS(STACK_STRESS_DELAY_MS));
+	ESP_LOGI(TAG, "Estrés de pilas: %d vueltas cada %d ms", STACK_STRESS_ROUNDS, STACK_STRESS_PERIOD_MS);
+	prof_request((prof_req_t){ .set = true, .on = true, .hz = PROF_HZ });
+	char l2[17];
+	for (int k = 0; k < STACK_STRESS_ROUNDS; ++k) {
+		door_ctx_t *d = &g_doors[k % DOOR_COUNT];
+		cred_post(d, CRED_REMOTE, (const uint8_t *)"stress", 6, 0);
+		cred_post(d, CRED_RFID, UID, sizeof(UID), 0);
+		cred_post(&g_doors[PANEL_DOOR], CRED_COMBO, NULL, 0, 0);
+		snprintf(l2, sizeof(l2), "ROUND %d/%d", k + 1, STACK_STRESS_ROUNDS);
+		lcd_show_progress("STACK STRESS", l2);
+		if (k % 50 == 49) {
+			policy_t *p = ctrl_policy_load();
+			if (p) ctrl_post_policy(p);
+		}
+		vTaskDelay(pdMS_TO_TICKS(STACK_STRESS_PERIOD_MS));
+	}
+	vTaskDelay(pdMS_TO_TICKS(STACK_STRESS_SETTLE_MS));
+	prof_request((prof_req_t){ .set = true, .on = false, .stack = true, .why = "stress" });
+	vTaskDelete(NULL);
 }
+#endif
+
+void app_main(void)
+{
+	int64_t t0 = hal_time_us();
+	ESP_LOGI(TAG, "Sistema de Acceso y Monitoreo de Seguridad");
+	task_plan_init();
+
+	if (!boot_graph_init(&g_boot, BOOT_STEPS, sizeof(BOOT_STEPS) / sizeof(BOOT_STEPS[0]), t0)) {
+		ESP_LOGE(TAG, "Grafo de arranque inválido");
+		abort();
+	}
+	// Camino crítico en esta tarea y en orden; aún no hay concurrencia
+	int i;
+	while ((i = boot_graph_claim(&g_boot, BOOT_F_CRITICAL)) >= 0) {
+		boot_graph_run(&g_boot, i, 0, hal_time_us);
+		boot_graph_done(&g_boot, i);
+	}
+	int64_t crit = boot_graph_span_us(&g_boot, BOOT_F_CRITICAL);
+	if (crit > BOOT_CRITICAL_BUDGET_US) {
+		ESP_LOGW(TAG, "Arranque crítico en %lld us (objetivo %d us)", (long long)crit, BOOT_CRITICAL_BUDGET_US);
+	} else {
+		ESP_LOGI(TAG, "Arranque crítico en %lld us", (long long)crit);
+	}
 
+	// El resto, en paralelo
+	g_boot_progress = xSemaphoreCreateCountingStatic(BOOT_WORKERS * BOOT_STEPS_MAX, 0, &s_boot_progress_buf);
+	for (int w = 0; w < BOOT_WORKERS; ++w) {
+		task_start(TASK_BOOT, boot_worker_task, (void *)(uintptr_t)(w + 1), NULL);
+	}
+#if JITTER_BENCH
+	task_start(TASK_BENCH, netload_task, NULL, NULL);
+#endif
+#if STACK_STRESS
+	task_start(TASK_STRESS, stress_task, NULL, NULL);
+#endif
+}
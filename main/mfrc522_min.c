@@ -11,6 +11,7 @@
 #define ComIEnReg       0x02
 #define DivIrqReg       0x05
 #define ComIrqReg       0x04
+#define DivIEnReg       0x03
 #define ErrorReg        0x06
 #define FIFODataReg     0x09
 #define FIFOLevelReg    0x0A
@@ -34,6 +35,7 @@
 #define PCD_CalcCRC     0x03
 #define PCD_Transceive  0x0C
 #define PCD_SoftReset   0x0F
+#define PCD_PowerDown   0x10    // Bit de CommandReg
 
 // PICC commands
 #define PICC_REQA       0x26
@@ -51,21 +53,14 @@ static inline uint8_t _cmd_addr(uint8_t reg, bool read)
 static bool _spi_write(mfrc522_t *dev, uint8_t reg, uint8_t val)
 {
     uint8_t tx[2] = { _cmd_addr(reg, false), val };
-    spi_transaction_t t = { 0 };
-    t.length = 16; // bits
-    t.tx_buffer = tx;
-    return spi_device_transmit(dev->spi, &t) == ESP_OK;
+    return hal_spi_xfer(dev->spi, tx, NULL, sizeof(tx));
 }
 
 static bool _spi_read(mfrc522_t *dev, uint8_t reg, uint8_t *val)
 {
     uint8_t tx[2] = { _cmd_addr(reg, true), 0x00 };
     uint8_t rx[2] = { 0 };
-    spi_transaction_t t = { 0 };
-    t.length = 16;
-    t.tx_buffer = tx;
-    t.rx_buffer = rx;
-    if (spi_device_transmit(dev->spi, &t) != ESP_OK) return false;
+    if (!hal_spi_xfer(dev->spi, tx, rx, sizeof(tx))) return false;
     *val = rx[1];
     return true;
 }
@@ -100,51 +95,26 @@ bool mfrc522_antenna_on(mfrc522_t *dev)
     return true;
 }
 
-bool mfrc522_init(mfrc522_t *dev, spi_host_device_t host, gpio_num_t sck, gpio_num_t mosi, gpio_num_t miso, gpio_num_t cs, gpio_num_t rst)
+bool mfrc522_init(mfrc522_t *dev, int sck, int mosi, int miso, int cs, int rst)
 {
     memset(dev, 0, sizeof(*dev));
     dev->rst_gpio = rst;
+    dev->irq_gpio = -1;
 
     // Reset pin
-    if (rst != GPIO_NUM_NC) {
-        gpio_config_t io = {
-            .pin_bit_mask = (1ULL << rst),
-            .mode = GPIO_MODE_OUTPUT,
-            .pull_up_en = GPIO_PULLUP_DISABLE,
-            .pull_down_en = GPIO_PULLDOWN_DISABLE,
-            .intr_type = GPIO_INTR_DISABLE,
-        };
-        gpio_config(&io);
+    if (rst >= 0) {
+        hal_gpio_config(rst, HAL_GPIO_OUTPUT);
         // Pulso de reset: bajo -> alto para asegurar estado conocido
-        gpio_set_level(rst, 0);
+        hal_gpio_set(rst, 0);
         vTaskDelay(pdMS_TO_TICKS(10));
-        gpio_set_level(rst, 1);
+        hal_gpio_set(rst, 1);
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
-    spi_bus_config_t buscfg = {
-        .sclk_io_num = sck,
-        .mosi_io_num = mosi,
-        .miso_io_num = miso,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .max_transfer_sz = 0,
-    };
-    esp_err_t err = spi_bus_initialize(host, &buscfg, SPI_DMA_CH_AUTO);
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_LOGE(TAG, "spi_bus_initialize failed: %d", err);
-        return false;
-    }
-
-    spi_device_interface_config_t devcfg = {
-        .clock_speed_hz = 1 * 1000 * 1000, // 1 MHz (más robusto con cables largos)
-        .mode = 0,
-        .spics_io_num = cs,
-        .queue_size = 3,
-        .flags = 0,
-    };
-    if (spi_bus_add_device(host, &devcfg, &dev->spi) != ESP_OK) {
-        ESP_LOGE(TAG, "spi_bus_add_device failed");
+    // 1 MHz (más robusto con cables largos)
+    dev->spi = hal_spi_open(sck, mosi, miso, cs, 1 * 1000 * 1000);
+    if (!dev->spi) {
+        ESP_LOGE(TAG, "SPI no disponible");
         return false;
     }
 
@@ -168,6 +138,46 @@ bool mfrc522_init(mfrc522_t *dev, spi_host_device_t host, gpio_num_t sck, gpio_n
     return true;
 }
 
+// Tarea que espera el fin de una trama. Una sola a la vez: los lectores de
+// una línea compartida se consultan en serie
+static TaskHandle_t volatile s_irq_waiter;
+
+static void IRAM_ATTR _irq_isr(void *arg)
+{
+    TaskHandle_t waiter = s_irq_waiter;
+    if (!waiter || hal_gpio_get((int)(intptr_t)arg) != 0) return; // Solo el flanco de bajada
+    BaseType_t hp = pdFALSE;
+    vTaskNotifyGiveFromISR(waiter, &hp);
+    portYIELD_FROM_ISR(hp);
+}
+
+bool mfrc522_use_irq(mfrc522_t *dev, int irq)
+{
+    if (irq < 0) return false;
+    if (!hal_gpio_config(irq, HAL_GPIO_INPUT_PULLUP)) return false;
+    // IRQ open-drain (IRQPushPull = 0), activa a nivel bajo (IRqInv = 1):
+    // fin de la trama (RxIRq, IdleIRq) o temporizador vencido (TimerIRq)
+    if (!_spi_write(dev, DivIEnReg, 0x00)) return false;
+    if (!_spi_write(dev, ComIEnReg, 0x80 | 0x20 | 0x10 | 0x01)) return false;
+    if (!hal_gpio_on_edge(irq, _irq_isr, (void *)(intptr_t)irq)) return false;
+    dev->irq_gpio = irq;
+    return true;
+}
+
+bool mfrc522_power_down(mfrc522_t *dev, bool down)
+{
+    if (down) return _set_bits(dev, CommandReg, PCD_PowerDown);
+    if (!_clr_bits(dev, CommandReg, PCD_PowerDown)) return false;
+    // PowerDown se lee a 1 mientras arranca el oscilador
+    int64_t t0 = hal_time_us();
+    for (;;) {
+        uint8_t v = 0;
+        if (!_spi_read(dev, CommandReg, &v)) return false;
+        if (!(v & PCD_PowerDown)) return true;
+        if (hal_time_us() - t0 > 5000) return false;
+    }
+}
+
 static bool _transceive(mfrc522_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t *rx_len, uint8_t bit_framing, uint32_t timeout_ms)
 {
     // Stop command
@@ -185,21 +195,38 @@ static bool _transceive(mfrc522_t *dev, const uint8_t *tx, size_t tx_len, uint8_
     }
 
     // Start transceive
+    bool use_irq = dev->irq_gpio >= 0;
+    if (use_irq) {
+        ulTaskNotifyTake(pdTRUE, 0);     // Aviso viejo de otra trama
+        s_irq_waiter = xTaskGetCurrentTaskHandle();
+    }
     _spi_write(dev, CommandReg, PCD_Transceive);
     _set_bits(dev, BitFramingReg, 0x80); // StartSend=1
 
     uint32_t start = (uint32_t)xTaskGetTickCount();
+    bool done = false;
     while (true) {
         uint8_t irq = 0;
         _spi_read(dev, ComIrqReg, &irq);
         if (irq & 0x30) { // RxIRq or IdleIRq
+            done = true;
+            break;
+        }
+        if (irq & 0x01) { // TimerIRq: nadie contestó (sin tarjeta), no esperar a timeout_ms
             break;
         }
         if (((uint32_t)xTaskGetTickCount() - start) * portTICK_PERIOD_MS >= timeout_ms) {
-            return false;
+            break;
         }
-        vTaskDelay(1);
+        // Con IRQ despierta al terminar la trama; el tick queda de respaldo
+        if (use_irq) ulTaskNotifyTake(pdTRUE, 1);
+        else vTaskDelay(1);
+    }
+    if (use_irq) {
+        s_irq_waiter = NULL;
+        _spi_write(dev, ComIrqReg, 0x7F); // Suelta la línea compartida
     }
+    if (!done) return false;
 
     // Clear StartSend
     _clr_bits(dev, BitFramingReg, 0x80);
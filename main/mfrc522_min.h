@@ -2,21 +2,28 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
+#include "hal.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct {
-    spi_device_handle_t spi;
-    gpio_num_t rst_gpio;
+    hal_spi_t *spi;
+    int rst_gpio;            // -1: sin pin de reset
+    int irq_gpio;            // -1: sin IRQ (espera sondeando ComIrqReg cada tick)
 } mfrc522_t;
 
-bool mfrc522_init(mfrc522_t *dev, spi_host_device_t host, gpio_num_t sck, gpio_num_t mosi, gpio_num_t miso, gpio_num_t cs, gpio_num_t rst);
+bool mfrc522_init(mfrc522_t *dev, int sck, int mosi, int miso, int cs, int rst);
 bool mfrc522_get_version(mfrc522_t *dev, uint8_t *ver);
 bool mfrc522_antenna_on(mfrc522_t *dev);
+// IRQ del lector (activa a nivel bajo, open-drain: varios lectores pueden
+// compartir línea si se consultan de uno en uno). La espera de cada trama
+// termina con la interrupción en vez de en el siguiente tick
+bool mfrc522_use_irq(mfrc522_t *dev, int irq);
+// Soft power-down (antena y oscilador apagados, registros conservados).
+// Al despertar espera a que el oscilador esté listo
+bool mfrc522_power_down(mfrc522_t *dev, bool down);
 bool mfrc522_request_a(mfrc522_t *dev, uint8_t *atqa, size_t *atqa_len);
 bool mfrc522_anticoll_cl1(mfrc522_t *dev, uint8_t *uid4);
 
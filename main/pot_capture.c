@@ -0,0 +1,96 @@
+#include "pot_capture.h"
+#include <string.h>
+
+static int to_digit_cb(const void *ctx, int raw)
+{
+    return pot_capture_raw_to_digit((const pot_capture_cfg_t *)ctx, raw);
+}
+
+void pot_capture_init(pot_capture_t *c, const pot_capture_cfg_t *cfg)
+{
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    if (c->cfg.combo_len > POT_CAPTURE_MAX_LEN) c->cfg.combo_len = POT_CAPTURE_MAX_LEN;
+    pot_settle_cfg_t scfg = c->cfg.settle;
+    scfg.to_digit = to_digit_cb;
+    scfg.ctx = &c->cfg;
+    pot_settle_init(&c->settle, &scfg);
+}
+
+void pot_capture_reset(pot_capture_t *c)
+{
+    for (int i = 0; i < POT_CAPTURE_MAX_LEN; ++i) c->entered[i] = 0;
+    c->entered_count = 0;
+    c->captured = false;
+}
+
+int pot_capture_raw_to_digit(const pot_capture_cfg_t *cfg, int raw)
+{
+    if (raw < 0) raw = 0;
+    if (raw > cfg->adc_max_raw) raw = cfg->adc_max_raw;
+
+    // Aplicar deadzone
+    if (raw < cfg->deadzone_raw || raw >= (cfg->adc_max_raw - cfg->deadzone_raw)) {
+        return -1;
+    }
+
+    // Normalizar a rango sin deadzones
+    int effective_range = cfg->adc_max_raw - 2 * cfg->deadzone_raw;
+    int normalized = raw - cfg->deadzone_raw; // 0 .. effective_range-1
+
+    // Mapear a dígitos 0-9
+    int digit = (normalized * 10) / effective_range;
+    if (digit > 9) digit = 9; // Clamp
+
+    // Invertir si el potenciómetro está al revés
+    if (cfg->invert) {
+        digit = 9 - digit;
+    }
+    return digit;
+}
+
+// Filtro IIR (EMA): y[n] = alpha * x[n] + (1-alpha) * y[n-1]
+static int pot_capture_filter(pot_capture_t *c, int raw_sample)
+{
+    if (c->filtered == 0.0f) {
+        c->filtered = (float)raw_sample; // Inicializar en primera lectura
+    }
+    c->filtered = c->cfg.filter_alpha * raw_sample + (1.0f - c->cfg.filter_alpha) * c->filtered;
+    return (int)(c->filtered + 0.5f); // Redondear
+}
+
+bool pot_capture_is_correct(const pot_capture_t *c)
+{
+    for (int i = 0; i < c->cfg.combo_len; ++i) {
+        if (c->entered[i] != c->cfg.combo_target[i]) return false;
+    }
+    return true;
+}
+
+pot_capture_event_t pot_capture_feed(pot_capture_t *c, int raw, int64_t now_us)
+{
+    c->filtered_raw = pot_capture_filter(c, raw);
+    int digit = pot_capture_raw_to_digit(&c->cfg, c->filtered_raw);
+
+    // Deadzone: no se considera input válido
+    if (digit < 0) return POT_CAP_DEADZONE;
+
+    if (digit != c->current_digit) {
+        // Movimiento detectado
+        c->current_digit = digit;
+        c->last_move_us = now_us;
+        c->captured = false; // Permitirá capturar el nuevo valor cuando se estabilice
+        c->moved = true;
+        pot_settle_reset(&c->settle, now_us);
+    }
+    bool held = pot_settle_feed(&c->settle, c->filtered, now_us);
+
+    if (!c->moved || c->captured || !held) return POT_CAP_NONE;
+    if (c->entered_count >= c->cfg.combo_len) return POT_CAP_NONE;
+
+    c->entered[c->entered_count++] = c->current_digit;
+    c->captured = true;  // Evita múltiples capturas sin movimiento
+    c->moved = false;    // Requiere nuevo movimiento para el próximo dígito
+    if (c->entered_count < c->cfg.combo_len) return POT_CAP_DIGIT;
+    return pot_capture_is_correct(c) ? POT_CAP_COMBO_OK : POT_CAP_COMBO_BAD;
+}
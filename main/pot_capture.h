@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "pot_settle.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lógica de captura de la combinación por potenciómetro: filtro IIR, mapeo
+// ADC -> dígito con deadzones, detector de estabilidad y validación de la
+// secuencia. No toca hardware ni FreeRTOS: pot_task le entrega cada lectura
+// ADC y reacciona a los eventos devueltos (beeps, LCD, logs). La misma
+// implementación se compila en host para reproducir trazas (tools/pot_replay).
+
+#define POT_CAPTURE_MAX_LEN 8
+
+typedef struct {
+    float filter_alpha;      // POT_FILTER_ALPHA
+    int adc_max_raw;         // POT_ADC_MAX_RAW
+    int deadzone_raw;        // POT_DEADZONE_RAW
+    bool invert;             // POT_INVERT_MAPPING
+    pot_settle_cfg_t settle; // to_digit/ctx se rellenan en pot_capture_init
+    int combo_len;
+    int combo_target[POT_CAPTURE_MAX_LEN];
+} pot_capture_cfg_t;
+
+typedef enum {
+    POT_CAP_NONE = 0,        // Lectura procesada sin novedades
+    POT_CAP_DEADZONE,        // Lectura en deadzone: ignorada
+    POT_CAP_DIGIT,           // Dígito capturado (no completa la combinación)
+    POT_CAP_COMBO_OK,        // Último dígito capturado y combinación correcta
+    POT_CAP_COMBO_BAD,       // Último dígito capturado y combinación incorrecta
+} pot_capture_event_t;
+
+typedef struct {
+    pot_capture_cfg_t cfg;
+    float filtered;          // Estado del filtro IIR
+    int filtered_raw;        // Última salida redondeada
+    int current_digit;
+    bool moved;              // Hubo movimiento desde la última captura
+    bool captured;           // Ya se capturó el dígito actual
+    int64_t last_move_us;
+    int entered[POT_CAPTURE_MAX_LEN];
+    int entered_count;
+    pot_settle_t settle;
+} pot_capture_t;
+
+void pot_capture_init(pot_capture_t *c, const pot_capture_cfg_t *cfg);
+// Limpia la combinación parcial (equivale al antiguo combo_reset)
+void pot_capture_reset(pot_capture_t *c);
+int pot_capture_raw_to_digit(const pot_capture_cfg_t *cfg, int raw);
+// Procesa una lectura ADC cruda tomada en now_us
+pot_capture_event_t pot_capture_feed(pot_capture_t *c, int raw, int64_t now_us);
+bool pot_capture_is_correct(const pot_capture_t *c);
+
+#ifdef __cplusplus
+}
+#endif
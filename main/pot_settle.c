@@ -0,0 +1,85 @@
+#include "pot_settle.h"
+#include <math.h>
+#include <string.h>
+
+void pot_settle_init(pot_settle_t *s, const pot_settle_cfg_t *cfg)
+{
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    if (s->cfg.window < 2) s->cfg.window = 2;
+    if (s->cfg.window > POT_SETTLE_MAX_WINDOW) s->cfg.window = POT_SETTLE_MAX_WINDOW;
+    if (s->cfg.min_hold_ms > s->cfg.max_hold_ms) s->cfg.min_hold_ms = s->cfg.max_hold_ms;
+}
+
+void pot_settle_reset(pot_settle_t *s, int64_t now_us)
+{
+    s->move_ts_us = now_us;
+    s->head = 0;
+    s->count = 0;
+    s->mean = 0.0f;
+    s->stddev = 0.0f;
+    s->slope = 0.0f;
+}
+
+// Media, pendiente (mínimos cuadrados sobre el índice de muestra) y desviación
+// típica del residuo de la ventana, recorrida en orden cronológico.
+static void pot_settle_stats(pot_settle_t *s)
+{
+    const int n = s->count;
+    const int w = s->cfg.window;
+    int start = (s->head - n + w) % w;
+
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) sum += s->buf[(start + i) % w];
+    float mean = sum / n;
+
+    // x centrado: i - (n-1)/2
+    const float xc = (n - 1) * 0.5f;
+    float sxx = 0.0f, sxy = 0.0f, syy = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        float dx = i - xc;
+        float dy = s->buf[(start + i) % w] - mean;
+        sxx += dx * dx;
+        sxy += dx * dy;
+        syy += dy * dy;
+    }
+    s->mean = mean;
+    s->slope = (sxx > 0.0f) ? (sxy / sxx) : 0.0f;
+    float resid = syy - s->slope * sxy;
+    s->stddev = (n > 2 && resid > 0.0f) ? sqrtf(resid / (n - 2)) : 0.0f;
+}
+
+// true si [x - spread, x + spread] cae entero en el dígito d
+static bool pot_settle_band_in(const pot_settle_cfg_t *c, float x, float spread, int d)
+{
+    return c->to_digit(c->ctx, (int)(x - spread + 0.5f)) == d &&
+           c->to_digit(c->ctx, (int)(x + spread + 0.5f)) == d;
+}
+
+bool pot_settle_feed(pot_settle_t *s, float filtered_raw, int64_t now_us)
+{
+    const pot_settle_cfg_t *c = &s->cfg;
+    int64_t held_ms = (now_us - s->move_ts_us) / 1000;
+
+    s->buf[s->head] = filtered_raw;
+    s->head = (s->head + 1) % c->window;
+    if (s->count < c->window) s->count++;
+
+    // Techo: pase lo que pase, no esperar más que el temporizador fijo original
+    if (held_ms >= c->max_hold_ms) return true;
+    if (c->mode == POT_SETTLE_MODE_FIXED) return false;
+
+    // Piso configurable y ventana llena antes de opinar
+    if (held_ms < c->min_hold_ms || s->count < c->window) return false;
+
+    pot_settle_stats(s);
+    if (fabsf(s->slope) > c->max_slope) return false;
+    if (!c->to_digit) return true;
+
+    // Valor ajustado en la muestra más reciente y su proyección por la tendencia
+    float now_fit = s->mean + s->slope * (s->count - 1) * 0.5f;
+    float projected = now_fit + s->slope * c->horizon;
+    float spread = c->z * s->stddev;
+    int d = c->to_digit(c->ctx, (int)(now_fit + 0.5f));
+    return d >= 0 && pot_settle_band_in(c, now_fit, spread, d) && pot_settle_band_in(c, projected, spread, d);
+}
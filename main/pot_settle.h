@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Detector de estabilidad ("dígito sostenido") para la señal filtrada del
+// potenciómetro. Sustituye la espera fija de POT_SETTLE_MS por una prueba
+// estadística sobre una ventana deslizante: se ajusta una recta por mínimos
+// cuadrados y el dígito se considera sostenido cuando tanto el valor actual
+// como su proyección a `horizon` muestras, ± z desviaciones típicas del
+// residuo, caen dentro del mismo dígito y la pendiente no supera max_slope.
+// La proyección absorbe el retardo del filtro IIR: con un EMA de factor
+// alpha la señal aún avanzará ~pendiente/alpha, de ahí horizon = 1/alpha.
+//
+// Módulo sin dependencias de ESP-IDF para poder compilarse también en host.
+
+#define POT_SETTLE_MAX_WINDOW 16
+
+typedef enum {
+    POT_SETTLE_MODE_FIXED = 0,      // Comportamiento original: espera fija max_hold_ms
+    POT_SETTLE_MODE_VARIANCE = 1,   // Varianza + pendiente, con piso min_hold_ms
+} pot_settle_mode_t;
+
+typedef struct {
+    pot_settle_mode_t mode;
+    int window;              // Muestras en la ventana (2..POT_SETTLE_MAX_WINDOW)
+    float z;                 // Confianza: nº de desviaciones típicas que deben caber en el dígito
+    float max_slope;         // Pendiente máxima admitida (cuentas ADC por muestra)
+    float horizon;           // Muestras a proyectar la tendencia (típicamente 1/alpha del filtro)
+    int min_hold_ms;         // Piso: nunca capturar antes de este tiempo tras el último movimiento
+    int max_hold_ms;         // Techo: capturar siempre pasado este tiempo (equivale a POT_SETTLE_MS)
+    int (*to_digit)(const void *ctx, int raw); // Mapeo ADC -> dígito (devuelve <0 en deadzone)
+    const void *ctx;         // Contexto para to_digit
+} pot_settle_cfg_t;
+
+typedef struct {
+    pot_settle_cfg_t cfg;
+    int64_t move_ts_us;      // Instante del último movimiento (reset)
+    float buf[POT_SETTLE_MAX_WINDOW];
+    int head;
+    int count;
+    // Últimas estadísticas calculadas (útiles para logs/trazas)
+    float mean;
+    float stddev;            // Desviación típica del residuo respecto a la recta ajustada
+    float slope;
+} pot_settle_t;
+
+void pot_settle_init(pot_settle_t *s, const pot_settle_cfg_t *cfg);
+// Llamar cuando el dígito cambia (movimiento): vacía la ventana y reinicia el cronómetro.
+void pot_settle_reset(pot_settle_t *s, int64_t now_us);
+// Añade una muestra filtrada y devuelve true si el dígito actual se considera sostenido.
+bool pot_settle_feed(pot_settle_t *s, float filtered_raw, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,101 @@
+#include "pot_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "hal.h"
+
+#define TAG "POT_TRACE"
+
+#ifndef CONFIG_ESP_CONSOLE_UART_NUM
+#define CONFIG_ESP_CONSOLE_UART_NUM 0
+#endif
+// Puerto de salida en modo UART (por defecto el de consola/monitor)
+#ifndef POT_TRACE_UART_NUM
+#define POT_TRACE_UART_NUM        CONFIG_ESP_CONSOLE_UART_NUM
+#endif
+#define POT_TRACE_FILE_PATH       HAL_FS_ROOT "/pot_trace.bin"
+// Límite del archivo en modo SPIFFS (~4 h de trazas a 120 ms/muestra)
+#ifndef POT_TRACE_FILE_MAX_BYTES
+#define POT_TRACE_FILE_MAX_BYTES  (512 * 1024)
+#endif
+
+static int s_mode = POT_TRACE_OFF;
+static uint8_t s_frame[POT_TRACE_FRAME_MAX];
+static uint8_t s_seq = 0;
+static int s_count = 0;
+static int64_t s_last_us = 0;
+static size_t s_file_bytes = 0;
+
+void pot_trace_init(int mode)
+{
+    s_mode = mode;
+    s_count = 0;
+    if (mode == POT_TRACE_UART) {
+        if (!hal_uart_open(POT_TRACE_UART_NUM)) {
+            ESP_LOGE(TAG, "UART%d no disponible; trazas desactivadas", POT_TRACE_UART_NUM);
+            s_mode = POT_TRACE_OFF;
+            return;
+        }
+        ESP_LOGI(TAG, "Trazas ADC por UART%d", POT_TRACE_UART_NUM);
+    } else if (mode == POT_TRACE_SPIFFS) {
+        FILE *f = fopen(POT_TRACE_FILE_PATH, "rb");
+        if (f) {
+            fseek(f, 0, SEEK_END);
+            s_file_bytes = (size_t)ftell(f);
+            fclose(f);
+        }
+        ESP_LOGI(TAG, "Trazas ADC en %s (%u bytes previos)", POT_TRACE_FILE_PATH, (unsigned)s_file_bytes);
+    }
+}
+
+void pot_trace_flush(void)
+{
+    if (s_mode == POT_TRACE_OFF || s_count == 0) return;
+    int len = POT_TRACE_HDR_LEN + s_count * POT_TRACE_SAMPLE_LEN;
+    s_frame[0] = POT_TRACE_SYNC0;
+    s_frame[1] = POT_TRACE_SYNC1;
+    s_frame[2] = s_seq++;
+    s_frame[3] = (uint8_t)s_count;
+    s_frame[len] = pot_trace_crc8(&s_frame[2], len - 2);
+    len += 1;
+
+    if (s_mode == POT_TRACE_UART) {
+        hal_uart_write(POT_TRACE_UART_NUM, s_frame, (size_t)len);
+    } else if (s_mode == POT_TRACE_SPIFFS && s_file_bytes + len <= POT_TRACE_FILE_MAX_BYTES) {
+        FILE *f = fopen(POT_TRACE_FILE_PATH, "ab");
+        if (f) {
+            s_file_bytes += fwrite(s_frame, 1, len, f);
+            fclose(f);
+        }
+    }
+    s_count = 0;
+}
+
+void pot_trace_sample(int raw, int64_t now_us)
+{
+    if (s_mode == POT_TRACE_OFF) return;
+    int64_t dt_ms = (s_count == 0) ? 0 : (now_us - s_last_us) / 1000;
+    if (dt_ms > POT_TRACE_MAX_DT_MS) {
+        // Hueco demasiado largo para el campo dt: cerrar trama y empezar otra
+        pot_trace_flush();
+        dt_ms = 0;
+    }
+    if (s_count == 0) {
+        uint32_t t0_ms = (uint32_t)(now_us / 1000);
+        s_frame[4] = (uint8_t)(t0_ms);
+        s_frame[5] = (uint8_t)(t0_ms >> 8);
+        s_frame[6] = (uint8_t)(t0_ms >> 16);
+        s_frame[7] = (uint8_t)(t0_ms >> 24);
+    }
+    uint16_t r = (uint16_t)(raw & 0x0FFF);
+    uint16_t d = (uint16_t)(dt_ms & 0x0FFF);
+    uint8_t *p = &s_frame[POT_TRACE_HDR_LEN + s_count * POT_TRACE_SAMPLE_LEN];
+    p[0] = (uint8_t)(r & 0xFF);
+    p[1] = (uint8_t)((r >> 8) | ((d & 0x0F) << 4));
+    p[2] = (uint8_t)(d >> 4);
+    s_last_us = now_us;
+    if (++s_count == POT_TRACE_MAX_SAMPLES) {
+        pot_trace_flush();
+    }
+}
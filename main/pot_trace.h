@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Grabador de trazas ADC del potenciómetro (lecturas crudas, antes del filtro).
+//
+// Formato binario compacto, idéntico por UART y en SPIFFS:
+//
+//   +------+------+-----+---+--------------+---------------------+------+
+//   | 0xA5 | 0x5A | seq | n | t0_ms (u32LE) | n x muestra (3 bytes) | crc8 |
+//   +------+------+-----+---+--------------+---------------------+------+
+//
+//   muestra = raw (12 bits) | dt_ms (12 bits), little endian:
+//             b0 = raw[7:0], b1 = raw[11:8] | dt[3:0] << 4, b2 = dt[11:4]
+//   dt_ms   = ms desde la muestra anterior (0 para la primera de la trama)
+//   crc8    = CRC-8 (poly 0x07, init 0x00) sobre seq..última muestra
+//
+// La sincronía + CRC permiten extraer tramas intercaladas con texto de
+// ESP_LOG en el mismo puerto serie (el host descarta lo que no valida).
+
+#define POT_TRACE_SYNC0        0xA5
+#define POT_TRACE_SYNC1        0x5A
+#define POT_TRACE_HDR_LEN      8     // sync(2) + seq + n + t0_ms(4)
+#define POT_TRACE_SAMPLE_LEN   3
+#define POT_TRACE_MAX_SAMPLES  16
+#define POT_TRACE_MAX_DT_MS    0x0FFF
+#define POT_TRACE_FRAME_MAX    (POT_TRACE_HDR_LEN + POT_TRACE_MAX_SAMPLES * POT_TRACE_SAMPLE_LEN + 1)
+
+// Destinos (POT_TRACE_MODE)
+#define POT_TRACE_OFF      0
+#define POT_TRACE_UART     1
+#define POT_TRACE_SPIFFS   2
+
+static inline uint8_t pot_trace_crc8(const uint8_t *p, int len)
+{
+    uint8_t crc = 0x00;
+    for (int i = 0; i < len; ++i) {
+        crc ^= p[i];
+        for (int b = 0; b < 8; ++b) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+#ifdef ESP_PLATFORM
+// Inicializa el destino seleccionado (no-op con POT_TRACE_OFF)
+void pot_trace_init(int mode);
+// Registra una lectura cruda; emite la trama al llenarse
+void pot_trace_sample(int raw, int64_t now_us);
+// Fuerza la emisión de la trama parcial
+void pot_trace_flush(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
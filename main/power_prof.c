@@ -0,0 +1,54 @@
+#include "power_prof.h"
+#include <string.h>
+
+const power_prof_t power_profiles[POWER_PROF_COUNT] = {
+    [POWER_PERF] = {
+        .name = "perf", .cpu_max_mhz = 240, .cpu_min_mhz = 240, .light_sleep = false,
+        .wifi_listen = -1, .rfid_sleep = false, .rfid_ms = 150, .pot_idle_ms = 120,
+    },
+    [POWER_BALANCED] = {
+        .name = "balanced", .cpu_max_mhz = 240, .cpu_min_mhz = 80, .light_sleep = true,
+        .wifi_listen = 0, .rfid_sleep = true, .rfid_ms = 150, .pot_idle_ms = 500,
+    },
+    [POWER_BATTERY] = {
+        .name = "battery", .cpu_max_mhz = 160, .cpu_min_mhz = 40, .light_sleep = true,
+        .wifi_listen = 3, .rfid_sleep = true, .rfid_ms = 300, .pot_idle_ms = 1000,
+    },
+};
+
+int power_prof_find(const char *name)
+{
+    for (int i = 0; i < POWER_PROF_COUNT; ++i) {
+        if (strcmp(power_profiles[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+double power_cpu_ma(int mhz)
+{
+    // Tabla de modem sleep del ESP32: ~39 mA a 240 MHz, ~29 a 160, ~18 a 80
+    return 8.0 + 0.13 * mhz;
+}
+
+double power_est_ma(const power_prof_t *p, double sleep_frac, double busy_frac, int readers)
+{
+    if (sleep_frac < 0) sleep_frac = 0;
+    if (sleep_frac > 1) sleep_frac = 1;
+    if (busy_frac < 0) busy_frac = 0;
+    if (busy_frac > 1 - sleep_frac) busy_frac = 1 - sleep_frac;
+    double ma = sleep_frac * POWER_MA_LIGHT_SLEEP + busy_frac * power_cpu_ma(p->cpu_max_mhz) +
+                (1.0 - sleep_frac - busy_frac) * power_cpu_ma(p->cpu_min_mhz);
+    if (p->wifi_listen < 0) {
+        ma += POWER_MA_RADIO_RX;
+    } else {
+        int beacons = p->wifi_listen > 0 ? p->wifi_listen : 1;
+        ma += POWER_MA_RADIO_RX * POWER_MS_BEACON / (POWER_MS_BEACON_TU * beacons);
+    }
+    if (p->rfid_sleep) {
+        double on = POWER_MS_READER_POLL / p->rfid_ms;
+        ma += readers * (on * POWER_MA_READER_ON + (1.0 - on) * POWER_MA_READER_PD);
+    } else {
+        ma += readers * POWER_MA_READER_ON;
+    }
+    return ma;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Perfiles de energía: frecuencia de CPU (DFS), sueño ligero automático
+// (tickless idle), ahorro de la radio WiFi y ritmo de los únicos sondeos que
+// quedan (lectores RFID y potenciómetro; el reed despierta por GPIO y los
+// plazos por esp_timer). Se eligen en ejecución con el campo "power" de la
+// configuración.
+//
+// Incluye el modelo de consumo con el que el firmware estima la corriente
+// media a partir del tiempo medido en sueño ligero (iot/power) y con el que
+// tools/power_sim compara los perfiles.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/power_sim).
+
+typedef enum {
+    POWER_PERF = 0,          // Alimentación de red: sin DFS, sin sueño, radio encendida
+    POWER_BALANCED,          // DFS, sueño ligero y modem sleep en cada DTIM
+    POWER_BATTERY,           // Además escucha cada 3 beacons y sondeos más lentos
+    POWER_PROF_COUNT
+} power_prof_id_t;
+
+typedef struct {
+    const char *name;
+    uint16_t cpu_max_mhz;
+    uint16_t cpu_min_mhz;    // Igual a cpu_max_mhz: sin DFS
+    bool light_sleep;        // Sueño ligero cuando FreeRTOS no tiene trabajo
+    int8_t wifi_listen;      // -1: radio siempre encendida; 0: despierta en cada
+                             // DTIM; n: cada n beacons (listen interval)
+    bool rfid_sleep;         // Lectores en soft power-down entre barridos
+    uint16_t rfid_ms;        // Periodo de barrido de los lectores
+    uint16_t pot_idle_ms;    // Periodo del potenciómetro en reposo (120 ms al moverlo)
+} power_prof_t;
+
+extern const power_prof_t power_profiles[POWER_PROF_COUNT];
+
+// Índice del perfil con ese nombre (-1 si no existe)
+int power_prof_find(const char *name);
+
+// ---- Modelo de consumo (mA a 3,3 V, valores típicos de hoja de datos) ----
+#define POWER_MA_LIGHT_SLEEP   0.8   // ESP32 en sueño ligero
+#define POWER_MA_RADIO_RX      100.0 // Radio WiFi escuchando
+#define POWER_MS_BEACON        3.0   // Radio despierta por beacon en modem sleep
+#define POWER_MS_BEACON_TU     102.4 // Intervalo de beacon (100 TU)
+#define POWER_MA_READER_ON     30.0  // MFRC522 con la antena encendida
+#define POWER_MA_READER_PD     0.01  // MFRC522 en soft power-down
+#define POWER_MS_READER_POLL   16.0  // Barrido de un lector: arranque + REQA sin respuesta
+
+// CPU despierta y ociosa a esa frecuencia (interpolación de modem sleep)
+double power_cpu_ma(int mhz);
+
+// Corriente media estimada del perfil con sleep_frac del tiempo en sueño
+// ligero, busy_frac trabajando a la frecuencia máxima (cerrojos de DFS:
+// hal_pm_busy, la radio) y readers lectores; el resto, CPU ociosa a la mínima
+double power_est_ma(const power_prof_t *p, double sleep_frac, double busy_frac, int readers);
+
+#ifdef __cplusplus
+}
+#endif
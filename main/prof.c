@@ -0,0 +1,157 @@
+#include "prof.h"
+#include <stdio.h>
+#include <string.h>
+
+static int hist_bucket(uint32_t us)
+{
+    int b = 0;
+    while (us && b < PROF_HIST_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void prof_hist_add(prof_hist_t *h, int64_t us)
+{
+    if (us < 0) us = 0;
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    h->hist[hist_bucket(v)]++;
+    h->n++;
+    h->sum_us += v;
+    if (v > h->max_us) h->max_us = v;
+}
+
+uint32_t prof_hist_pct_us(const prof_hist_t *h, double p)
+{
+    if (!h->n) return 0;
+    uint32_t want = (uint32_t)(p * h->n + 0.999999);
+    if (want < 1) want = 1;
+    uint32_t acc = 0;
+    for (int b = 0; b < PROF_HIST_BUCKETS - 1; ++b) {
+        acc += h->hist[b];
+        uint32_t bound = 1u << b;   // Límite superior (exclusivo) del cubo b
+        if (acc >= want) return bound < h->max_us ? bound : h->max_us;
+    }
+    return h->max_us;
+}
+
+size_t prof_hist_json(const prof_hist_t *h, char *buf, size_t cap)
+{
+    int last = PROF_HIST_BUCKETS - 1;
+    while (last >= 0 && !h->hist[last]) last--;
+    int n = snprintf(buf, cap, "{\"n\":%u,\"p50_us\":%u,\"p99_us\":%u,\"max_us\":%u,\"mean_us\":%u,\"hist\":[",
+                     (unsigned)h->n, (unsigned)prof_hist_pct_us(h, 0.50), (unsigned)prof_hist_pct_us(h, 0.99),
+                     (unsigned)h->max_us, (unsigned)(h->n ? h->sum_us / h->n : 0));
+    for (int b = 0; b <= last && n > 0 && (size_t)n < cap; ++b) {
+        n += snprintf(buf + n, cap - n, "%s%u", b ? "," : "", (unsigned)h->hist[b]);
+    }
+    if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - n, "]}");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+void prof_lock_taken(prof_lock_t *l, int64_t req_us, int64_t now_us, bool contended)
+{
+    prof_hist_add(&l->wait, now_us - req_us);
+    if (contended) l->contended++;
+    l->held_at_us = now_us ? now_us : 1;
+}
+
+void prof_lock_giving(prof_lock_t *l, int64_t now_us)
+{
+    if (!l->held_at_us) return;
+    prof_hist_add(&l->hold, now_us - l->held_at_us);
+    l->held_at_us = 0;
+}
+
+void prof_lock_reset(prof_lock_t *l)
+{
+    int64_t held = l->held_at_us;
+    memset(l, 0, sizeof(*l));
+    l->held_at_us = held;
+}
+
+size_t prof_lock_json(const prof_lock_t *l, char *buf, size_t cap)
+{
+    int n = snprintf(buf, cap, "{\"contended\":%u,\"wait\":", (unsigned)l->contended);
+    if (n <= 0 || (size_t)n >= cap) return 0;
+    size_t w = prof_hist_json(&l->wait, buf + n, cap - n);
+    if (!w) return 0;
+    n += (int)w;
+    n += snprintf(buf + n, cap - n, ",\"hold\":");
+    if ((size_t)n >= cap) return 0;
+    w = prof_hist_json(&l->hold, buf + n, cap - n);
+    if (!w) return 0;
+    n += (int)w;
+    n += snprintf(buf + n, cap - n, "}");
+    return (size_t)n < cap ? (size_t)n : 0;
+}
+
+void prof_pcs_reset(prof_pcs_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+bool prof_pcs_add(prof_pcs_t *t, uint32_t pc)
+{
+    t->samples++;
+    if (!pc) {
+        t->lost++;
+        return false;
+    }
+    // Instrucciones de 2 y 3 bytes: el hash mezcla también los bits bajos
+    uint32_t h = (pc ^ (pc >> 9)) * 2654435761u;
+    for (int k = 0; k < PROF_PC_PROBES; ++k) {
+        uint32_t i = (h + k) & (PROF_PC_SLOTS - 1);
+        if (t->pc[i] == pc) {
+            t->count[i]++;
+            return true;
+        }
+        if (!t->pc[i]) {
+            t->pc[i] = pc;
+            t->count[i] = 1;
+            t->used++;
+            return true;
+        }
+    }
+    t->lost++;
+    return false;
+}
+
+size_t prof_pcs_top(prof_pcs_t *t, size_t max)
+{
+    // Compacta las ranuras ocupadas al principio y ordena por selección (max es pequeño)
+    size_t n = 0;
+    for (size_t i = 0; i < PROF_PC_SLOTS; ++i) {
+        if (!t->pc[i]) continue;
+        t->pc[n] = t->pc[i];
+        t->count[n] = t->count[i];
+        n++;
+    }
+    for (size_t i = n; i < PROF_PC_SLOTS; ++i) t->pc[i] = t->count[i] = 0;
+    if (max > n) max = n;
+    for (size_t i = 0; i < max; ++i) {
+        size_t best = i;
+        for (size_t j = i + 1; j < n; ++j) {
+            if (t->count[j] > t->count[best] || (t->count[j] == t->count[best] && t->pc[j] < t->pc[best])) best = j;
+        }
+        uint32_t pc = t->pc[i], c = t->count[i];
+        t->pc[i] = t->pc[best];
+        t->count[i] = t->count[best];
+        t->pc[best] = pc;
+        t->count[best] = c;
+    }
+    return max;
+}
+
+size_t prof_pcs_json(prof_pcs_t *t, int core, size_t max, char *buf, size_t cap)
+{
+    size_t k = prof_pcs_top(t, max);
+    int n = snprintf(buf, cap, "{\"core\":%d,\"samples\":%u,\"lost\":%u,\"top\":[", core, (unsigned)t->samples,
+                     (unsigned)t->lost);
+    for (size_t i = 0; i < k && n > 0 && (size_t)n < cap; ++i) {
+        n += snprintf(buf + n, cap - n, "%s[\"%08x\",%u]", i ? "," : "", (unsigned)t->pc[i], (unsigned)t->count[i]);
+    }
+    if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - n, "]}");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
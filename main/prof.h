@@ -0,0 +1,80 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Perfilado en ejecución: histogramas de duración (espera y retención de
+// mutex) y tabla compacta de PCs muestreados desde una interrupción de
+// temporizador. Sin hora ni cerrojos propios: el firmware pasa los tiempos y
+// serializa los accesos (portMUX); la ISR de cada núcleo escribe solo en su
+// tabla.
+//
+// Volcado JSON (PROF_TOPIC o consola), que tools/prof_sym resuelve contra el
+// ELF: los PCs van en hexadecimal, sin símbolos, para no cargar el firmware
+// con tablas de nombres.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/prof_sym).
+
+// ---- Histograma de duraciones ----
+// Cubo 0: < 1 us; cubo b: [2^(b-1), 2^b) us; el último recoge el resto (>= 262 ms)
+#define PROF_HIST_BUCKETS 20
+
+typedef struct {
+    uint32_t n;
+    uint32_t hist[PROF_HIST_BUCKETS];
+    uint64_t sum_us;
+    uint32_t max_us;
+} prof_hist_t;
+
+void prof_hist_add(prof_hist_t *h, int64_t us);
+// Cota superior del cubo que contiene el percentil p (0..1), sin pasar del máximo
+uint32_t prof_hist_pct_us(const prof_hist_t *h, double p);
+// {"n":..,"p50_us":..,"p99_us":..,"max_us":..,"mean_us":..,"hist":[..]}
+// (hist sin los ceros finales); bytes escritos (0 si no cabe)
+size_t prof_hist_json(const prof_hist_t *h, char *buf, size_t cap);
+
+// ---- Contención de un mutex ----
+typedef struct {
+    prof_hist_t wait;        // Desde que se pide hasta que se obtiene
+    prof_hist_t hold;        // Desde que se obtiene hasta que se suelta
+    uint32_t contended;      // Tomas que no lo encontraron libre
+    int64_t held_at_us;      // Del poseedor actual; 0: no medido
+} prof_lock_t;
+
+// Ya con el mutex tomado: pedido en req_us, obtenido en now_us
+void prof_lock_taken(prof_lock_t *l, int64_t req_us, int64_t now_us, bool contended);
+// Justo antes de soltarlo; no hace nada si la toma no se midió
+void prof_lock_giving(prof_lock_t *l, int64_t now_us);
+// Pone a cero las estadísticas sin olvidar la toma en curso
+void prof_lock_reset(prof_lock_t *l);
+// {"contended":..,"wait":{..},"hold":{..}}
+size_t prof_lock_json(const prof_lock_t *l, char *buf, size_t cap);
+
+// ---- Muestras de PC de un núcleo ----
+// Tabla abierta de PCs exactos; las muestras de un PC nuevo con la tabla
+// llena (o tras PROF_PC_PROBES colisiones) se cuentan en lost
+#define PROF_PC_SLOTS  256       // Potencia de 2
+#define PROF_PC_PROBES 8
+
+typedef struct {
+    uint32_t pc[PROF_PC_SLOTS];  // 0: libre
+    uint32_t count[PROF_PC_SLOTS];
+    uint32_t samples, lost, used;
+} prof_pcs_t;
+
+void prof_pcs_reset(prof_pcs_t *t);
+// Apta para ISR: sin memoria dinámica ni llamadas; false si la muestra se pierde
+bool prof_pcs_add(prof_pcs_t *t, uint32_t pc);
+// Los max PCs más frecuentes, de más a menos (reordena t: usar sobre una copia)
+size_t prof_pcs_top(prof_pcs_t *t, size_t max);
+// {"core":..,"samples":..,"lost":..,"top":[["400d1234",37],..]} con hasta max PCs
+// (reordena t); bytes escritos (0 si no cabe)
+size_t prof_pcs_json(prof_pcs_t *t, int core, size_t max, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
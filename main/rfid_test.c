@@ -69,7 +69,7 @@ void app_main(void)
     buzzer_init();
 
     mfrc522_t rfid = {0};
-    if (!mfrc522_init(&rfid, SPI3_HOST, RFID_SPI_SCK_GPIO, RFID_SPI_MOSI_GPIO, RFID_SPI_MISO_GPIO, RFID_SPI_CS_GPIO, RFID_RST_GPIO)) {
+    if (!mfrc522_init(&rfid, RFID_SPI_SCK_GPIO, RFID_SPI_MOSI_GPIO, RFID_SPI_MISO_GPIO, RFID_SPI_CS_GPIO, RFID_RST_GPIO)) {
         ESP_LOGE(TAG, "Failed to init MFRC522");
     }
 
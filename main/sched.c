@@ -0,0 +1,102 @@
+#include "sched.h"
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "hal.h"
+
+#define TAG "SCHED"
+
+typedef struct {
+    const char *name;
+    sched_cb_t cb;
+    void *arg;
+} sched_entry_t;
+
+static deadline_set_t s_set;
+static sched_entry_t s_entry[DEADLINE_MAX];
+static hal_timer_t *s_timer = NULL;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_fired = 0;
+static uint32_t s_reprograms = 0;
+
+// Programa el temporizador al plazo más próximo (o lo detiene si no hay).
+// Todo bajo s_mux para que dos tareas que arman a la vez no dejen el timer
+// apuntando a un plazo obsoleto.
+static void sched_reprogram(void)
+{
+    if (!s_timer) return;
+    portENTER_CRITICAL(&s_mux);
+    int64_t at_us;
+    bool any = deadline_next(&s_set, &at_us);
+    hal_timer_stop(s_timer);
+    if (any) {
+        int64_t now_us = hal_time_us();
+        hal_timer_start_once(s_timer, at_us > now_us ? (uint64_t)(at_us - now_us) : 1);
+        s_reprograms++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void sched_timer_cb(void *arg)
+{
+    for (;;) {
+        portENTER_CRITICAL(&s_mux);
+        int id = deadline_pop_expired(&s_set, hal_time_us());
+        if (id >= 0) s_fired++;
+        portEXIT_CRITICAL(&s_mux);
+        if (id < 0) break;
+        ESP_LOGD(TAG, "Vence %s", s_entry[id].name ? s_entry[id].name : "?");
+        if (s_entry[id].cb) {
+            s_entry[id].cb(id, s_entry[id].arg);
+        } else {
+            ESP_LOGW(TAG, "Plazo %d vencido sin callback", id);
+        }
+    }
+    sched_reprogram();
+}
+
+void sched_init(void)
+{
+    if (s_timer) return;
+    s_timer = hal_timer_create("sched", sched_timer_cb, NULL);
+    if (!s_timer) abort();
+    // Plazos armados antes de init (si los hubiera) quedan programados aquí
+    sched_reprogram();
+}
+
+void sched_register(int id, const char *name, sched_cb_t cb, void *arg)
+{
+    if (id < 0 || id >= DEADLINE_MAX) return;
+    s_entry[id] = (sched_entry_t){ .name = name, .cb = cb, .arg = arg };
+}
+
+void sched_arm_in(int id, uint32_t delay_ms)
+{
+    portENTER_CRITICAL(&s_mux);
+    deadline_arm(&s_set, id, hal_time_us() + (int64_t)delay_ms * 1000);
+    portEXIT_CRITICAL(&s_mux);
+    sched_reprogram();
+}
+
+void sched_cancel(int id)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool was = deadline_is_armed(&s_set, id);
+    deadline_cancel(&s_set, id);
+    portEXIT_CRITICAL(&s_mux);
+    if (was) sched_reprogram();
+}
+
+bool sched_is_armed(int id)
+{
+    portENTER_CRITICAL(&s_mux);
+    bool armed = deadline_is_armed(&s_set, id);
+    portEXIT_CRITICAL(&s_mux);
+    return armed;
+}
+
+void sched_get_stats(uint32_t *fired, uint32_t *reprograms)
+{
+    if (fired) *fired = s_fired;
+    if (reprograms) *reprograms = s_reprograms;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "deadline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Planificador de plazos del firmware: un único esp_timer one-shot siempre
+// programado al plazo más próximo de un deadline_set_t. Sustituye el sondeo
+// periódico de marcas de tiempo (re-bloqueo, desbloqueo máximo, LCD).
+//
+// Los callbacks se ejecutan en la tarea de esp_timer, uno por plazo vencido y
+// en orden determinista; deben ser breves (publicar en una cola o notificar a
+// la tarea dueña), nunca bloquear.
+
+typedef void (*sched_cb_t)(int id, void *arg);
+
+void sched_init(void);
+// Asocia un callback a un id (0..DEADLINE_MAX-1); llamar antes de armarlo
+void sched_register(int id, const char *name, sched_cb_t cb, void *arg);
+// Arma (o rearma) el id para vencer dentro de delay_ms
+void sched_arm_in(int id, uint32_t delay_ms);
+void sched_cancel(int id);
+bool sched_is_armed(int id);
+// Plazos disparados y reprogramaciones del esp_timer desde el arranque
+void sched_get_stats(uint32_t *fired, uint32_t *reprograms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+// Pilas de las tareas permanentes, en bytes (en ESP-IDF StackType_t es un
+// byte). Las dimensionan los arrays estáticos de main.c y el plan de tareas.
+//
+// Lo regenera tools/stack_plan a partir de los informes de STACK_TOPIC
+// (STACK_STRESS 1 en main.c): pico medido + TASK_STACK_MARGIN_PCT %, al menos
+// TASK_STACK_MARGIN_MIN bytes, múltiplo de TASK_STACK_ALIGN (task_plan.h).
+// No editar a mano: regenerar y anotar aquí el informe de origen.
+//
+// Origen: sin medir; tamaños previos a la asignación estática (prof, el de
+// las demás tareas de 4 KB). Pendiente de una pasada de STACK_STRESS en placa.
+//          pico (B)  tamaño (B)
+// control         -        4096
+// pot             -        4096
+// rfid            -        4096
+// lcd             -        3072
+// prof            -        4096
+
+#define STACK_CONTROL 4096
+#define STACK_POT     4096
+#define STACK_RFID    4096
+#define STACK_LCD     3072
+#define STACK_PROF    4096
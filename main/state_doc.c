@@ -0,0 +1,19 @@
+#include "state_doc.h"
+#include <stdio.h>
+
+#include "access_fsm.h"
+
+size_t state_doc_format(const twin_msg_t *m, const char *device, int64_t uptime_s, char *buf, size_t cap)
+{
+    const int32_t *v = m->val;
+    int n = snprintf(buf, cap,
+                     "{\"v\":%d,\"rev\":%u,\"device\":\"%s\",\"state\":\"%s\",\"locked\":%s,\"door\":\"%s\","
+                     "\"relock_pending\":%s,\"policy\":%ld,\"uptime_s\":%lld}",
+                     STATE_DOC_VERSION, (unsigned)m->seq, device,
+                     access_state_name((access_state_t)v[TWIN_F_STATE]),
+                     v[TWIN_F_LOCKED] ? "true" : "false",
+                     v[TWIN_F_DOOR] ? "closed" : "open",
+                     v[TWIN_F_RELOCK] ? "true" : "false",
+                     (long)v[TWIN_F_POLICY], (long long)uptime_s);
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "twin_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Documento de estado retenido (iot/state) para que el gemelo o un panel
+// que se suscribe reciba el estado vigente en un solo mensaje, sin esperar
+// al siguiente evento ni recorrer el log:
+//   {"v":1,"rev":7,"device":"access_control_01","state":"UNLOCKED_OPEN",
+//    "locked":false,"door":"open","relock_pending":false,"policy":3,"uptime_s":812}
+//
+// Lo programa una segunda instancia de twin_state_t con solo los campos
+// autoritativos (estado de la máquina y versión de la política; ni dígito
+// ni progreso de la combinación): el primer cambio tras un silencio sale al
+// instante, los siguientes se agrupan hasta STATE_MIN_MS desde el último y
+// el estado final siempre se publica. rev es el seq de esa instancia: crece
+// en uno por documento, así que un suscriptor descarta los que ya tiene.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/state_retain).
+
+#define STATE_DOC_VERSION  1
+#define STATE_DOC_MAX      224
+
+// Campos de twin_state que viajan en el documento
+#define STATE_DOC_FIELDS ((1u << TWIN_F_STATE) | (1u << TWIN_F_LOCKED) | (1u << TWIN_F_DOOR) | \
+                          (1u << TWIN_F_RELOCK) | (1u << TWIN_F_POLICY))
+
+// Documento completo a partir de un mensaje de twin_take(); 0 si no cabe
+size_t state_doc_format(const twin_msg_t *m, const char *device, int64_t uptime_s, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
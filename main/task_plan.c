@@ -0,0 +1,43 @@
+#include "task_plan.h"
+#include <string.h>
+
+// Plazos distintos más cortos que el de la tarea i (0: la más urgente)
+static int plan_rank(const task_spec_t *t, int n, int i)
+{
+    int rank = 0;
+    for (int j = 0; j < n; ++j) {
+        if (t[j].deadline_ms >= t[i].deadline_ms) continue;
+        // Cada plazo cuenta una vez: solo en su primera aparición
+        bool first = true;
+        for (int k = 0; k < j && first; ++k) first = t[k].deadline_ms != t[j].deadline_ms;
+        if (first) rank++;
+    }
+    return rank;
+}
+
+bool task_plan_assign(task_spec_t *t, int n, uint8_t lo, uint8_t hi)
+{
+    if (n < 0 || hi < lo) return false;
+    for (int i = 0; i < n; ++i) {
+        if (plan_rank(t, n, i) > hi - lo) return false;
+    }
+    for (int i = 0; i < n; ++i) t[i].prio = (uint8_t)(hi - plan_rank(t, n, i));
+    return true;
+}
+
+int task_plan_find(const task_spec_t *t, int n, const char *name)
+{
+    for (int i = 0; i < n; ++i) {
+        if (t[i].name && strcmp(t[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+uint32_t task_plan_stack(uint32_t peak, uint32_t margin_pct, uint32_t min_margin)
+{
+    if (!peak) return 0;
+    uint64_t margin = (uint64_t)peak * margin_pct / 100;
+    if (margin < min_margin) margin = min_margin;
+    uint64_t size = (peak + margin + TASK_STACK_ALIGN - 1) / TASK_STACK_ALIGN * TASK_STACK_ALIGN;
+    return size > UINT32_MAX ? UINT32_MAX / TASK_STACK_ALIGN * TASK_STACK_ALIGN : (uint32_t)size;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Plan de tareas: núcleo y prioridad de cada tarea de la aplicación. Las
+// prioridades no se eligen a mano: salen de los plazos (deadline monotonic),
+// plazo más corto, prioridad más alta, dentro de una banda por debajo de la
+// pila de red (lwIP 18, esp_timer 22, WiFi 23) y por encima de las tareas
+// del sistema de prioridad 1.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutilizan tools/jitter_sim y
+// tools/stack_plan).
+
+typedef enum {
+    TASK_CORE_ANY = -1,      // Sin afinidad (tskNO_AFFINITY)
+    TASK_CORE_NET = 0,       // WiFi, lwIP y esp_timer
+    TASK_CORE_APP = 1,       // Puertas, cerraduras, lectores y panel
+} task_core_t;
+
+typedef struct {
+    const char *name;
+    uint32_t deadline_ms;    // Plazo de reacción (periódicas: su periodo)
+    int8_t core;             // task_core_t
+    uint16_t stack;          // Bytes (xTaskCreate de ESP-IDF)
+    uint8_t prio;            // Lo rellena task_plan_assign()
+} task_spec_t;
+
+// Asigna prio a las n tareas: la de plazo más corto recibe hi y cada plazo
+// distinto baja un nivel; plazos iguales comparten prioridad. false si hay
+// más plazos distintos que niveles en [lo, hi] (prio queda sin tocar).
+bool task_plan_assign(task_spec_t *t, int n, uint8_t lo, uint8_t hi);
+
+// Índice de la tarea con ese nombre (-1 si no está)
+int task_plan_find(const task_spec_t *t, int n, const char *name);
+
+// ---- Tamaño de pila ----
+// A partir del pico medido (tamaño menos el mínimo libre que registra
+// FreeRTOS bajo el escenario de estrés): pico + margin_pct %, con al menos
+// min_margin bytes de holgura, redondeado hacia arriba a TASK_STACK_ALIGN.
+// Los márgenes cubren los caminos que el estrés no recorre (errores, logs
+// raros); 0 si peak es 0 (sin medida).
+#define TASK_STACK_ALIGN      256
+#define TASK_STACK_MARGIN_PCT 25
+#define TASK_STACK_MARGIN_MIN 512
+uint32_t task_plan_stack(uint32_t peak, uint32_t margin_pct, uint32_t min_margin);
+
+#ifdef __cplusplus
+}
+#endif
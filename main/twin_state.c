@@ -0,0 +1,124 @@
+#include "twin_state.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const k_names[TWIN_F_COUNT] = {
+    [TWIN_F_STATE] = "st",
+    [TWIN_F_LOCKED] = "lock",
+    [TWIN_F_DOOR] = "door",
+    [TWIN_F_RELOCK] = "relock",
+    [TWIN_F_COMBO] = "combo",
+    [TWIN_F_COMBO_LEN] = "len",
+    [TWIN_F_DIGIT] = "digit",
+    [TWIN_F_POLICY] = "pol",
+};
+
+void twin_init(twin_state_t *t, uint32_t min_interval_ms, uint32_t heartbeat_ms)
+{
+    memset(t, 0, sizeof(*t));
+    t->snapshot = true;
+    t->due_us = INT64_MAX;
+    t->last_tx_us = INT64_MIN / 2;
+    t->heartbeat_us = (int64_t)heartbeat_ms * 1000;
+    twin_set_rate(t, min_interval_ms);
+}
+
+void twin_set_rate(twin_state_t *t, uint32_t min_interval_ms)
+{
+    t->min_interval_us = (int64_t)min_interval_ms * 1000;
+}
+
+// Programa el envío del cuadro salvo que ya haya uno igual o antes (el
+// heartbeat programado queda más tarde y se adelanta)
+static bool arm(twin_state_t *t, int64_t now_us, int64_t *due_us)
+{
+    int64_t due = t->last_tx_us + t->min_interval_us;
+    if (due < now_us) due = now_us;
+    if (t->due_us <= due) return false;
+    t->due_us = due;
+    *due_us = due;
+    return true;
+}
+
+bool twin_set(twin_state_t *t, twin_field_t f, int32_t v, int64_t now_us, int64_t *due_us)
+{
+    if ((unsigned)f >= TWIN_F_COUNT || t->val[f] == v) return false;
+    t->st.sets++;
+    t->val[f] = v;
+    if (t->dirty || t->snapshot) t->st.coalesced++;
+    t->dirty |= 1u << f;
+    return arm(t, now_us, due_us);
+}
+
+bool twin_request_snapshot(twin_state_t *t, int64_t now_us, int64_t *due_us)
+{
+    t->st.resyncs++;
+    t->snapshot = true;
+    return arm(t, now_us, due_us);
+}
+
+bool twin_take(twin_state_t *t, int64_t now_us, twin_msg_t *out, int64_t *next_us)
+{
+    uint32_t mask = 0;
+    if (t->snapshot) {
+        mask = (1u << TWIN_F_COUNT) - 1;
+    } else {
+        for (int i = 0; i < TWIN_F_COUNT; ++i) {
+            if ((t->dirty & (1u << i)) && t->val[i] != t->sent[i]) mask |= 1u << i;
+        }
+    }
+    t->dirty = 0;
+    bool beat = !mask && t->heartbeat_us && now_us - t->last_tx_us >= t->heartbeat_us;
+    bool send = mask || beat;
+    if (send) {
+        out->kind = t->snapshot ? TWIN_MSG_SNAPSHOT : mask ? TWIN_MSG_DELTA : TWIN_MSG_HEARTBEAT;
+        out->seq = beat ? t->seq : ++t->seq;
+        out->mask = mask;
+        memcpy(out->val, t->val, sizeof(out->val));
+        memcpy(t->sent, t->val, sizeof(t->sent));
+        t->snapshot = false;
+        t->last_tx_us = now_us;
+        if (out->kind == TWIN_MSG_SNAPSHOT) {
+            t->st.snapshots++;
+        } else if (out->kind == TWIN_MSG_DELTA) {
+            t->st.deltas++;
+            t->st.fields += (uint32_t)__builtin_popcount(mask);
+        } else {
+            t->st.heartbeats++;
+        }
+    }
+    t->due_us = t->heartbeat_us ? t->last_tx_us + t->heartbeat_us : INT64_MAX;
+    *next_us = t->due_us;
+    return send;
+}
+
+size_t twin_format(const twin_msg_t *m, char *buf, size_t cap)
+{
+    if (m->kind == TWIN_MSG_HEARTBEAT) {
+        int n = snprintf(buf, cap, "{\"seq\":%u}", (unsigned)m->seq);
+        return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+    }
+    int n = snprintf(buf, cap, "{\"seq\":%u,\"%s\":{", (unsigned)m->seq,
+                     m->kind == TWIN_MSG_SNAPSHOT ? "snap" : "d");
+    bool first = true;
+    for (int i = 0; i < TWIN_F_COUNT && n > 0 && (size_t)n < cap; ++i) {
+        if (!(m->mask & (1u << i))) continue;
+        n += snprintf(buf + n, cap - (size_t)n, "%s\"%s\":%ld", first ? "" : ",", k_names[i], (long)m->val[i]);
+        first = false;
+    }
+    if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - (size_t)n, "}}");
+    return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+const char *twin_field_name(twin_field_t f)
+{
+    return (unsigned)f < TWIN_F_COUNT ? k_names[f] : "?";
+}
+
+int twin_field_index(const char *name)
+{
+    for (int i = 0; i < TWIN_F_COUNT; ++i) {
+        if (strcmp(k_names[i], name) == 0) return i;
+    }
+    return -1;
+}
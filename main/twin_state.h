@@ -0,0 +1,106 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Réplica del estado para el gemelo digital (Unity). Los eventos de
+// iot/telemetry no bastan para reconstruirlo (timestamp vacío, nada sobre
+// re-bloqueo pendiente, progreso de la combinación o dígito del
+// potenciómetro), así que el firmware mantiene una tabla de campos y emite:
+//  - Una instantánea completa al conectar y cuando el gemelo la pide:
+//    {"seq":41,"snap":{"st":0,"lock":1,...}}
+//  - Después solo los campos que cambian: {"seq":42,"d":{"digit":6}}
+//  - En silencio, cada heartbeat, el último seq enviado: {"seq":42}
+//
+// Cuadros: el primer cambio tras un envío programa el siguiente para no
+// antes de min_interval; lo que cambie mientras tanto viaja en ese mismo
+// mensaje (un campo que vuelve a su valor enviado no viaja). seq crece en
+// uno por instantánea o delta; si el gemelo ve un salto, o un heartbeat con
+// un seq que no es el suyo (se perdió el último delta), pide una
+// instantánea. Los deltas pueden ir con QoS 0.
+//
+// twin_take() copia lo pendiente (barato, bajo el cerrojo del llamador) y
+// twin_format() lo serializa fuera de él.
+//
+// Módulo sin dependencias de ESP-IDF (lo reutiliza tools/twin_check).
+// Sin sincronización: en el firmware va bajo g_twin_mux.
+
+typedef enum {
+    TWIN_F_STATE = 0,        // access_state_t
+    TWIN_F_LOCKED,           // 1 = bloqueada
+    TWIN_F_DOOR,             // 1 = cerrada
+    TWIN_F_RELOCK,           // 1 = re-bloqueo pendiente (DL_RELOCK armado)
+    TWIN_F_COMBO,            // Dígitos introducidos
+    TWIN_F_COMBO_LEN,
+    TWIN_F_DIGIT,            // Dígito del potenciómetro (-1 = zona muerta)
+    TWIN_F_POLICY,           // Versión de la política vigente
+    TWIN_F_COUNT
+} twin_field_t;
+
+#define TWIN_MSG_MAX  160    // Instantánea completa con margen
+
+typedef struct {
+    uint32_t snapshots;
+    uint32_t deltas;
+    uint32_t heartbeats;
+    uint32_t fields;         // Campos enviados en deltas
+    uint32_t sets;           // Cambios recibidos
+    uint32_t coalesced;      // Cambios absorbidos por un cuadro (o revertidos)
+    uint32_t resyncs;        // Instantáneas pedidas
+} twin_stats_t;
+
+typedef struct {
+    int32_t val[TWIN_F_COUNT];
+    int32_t sent[TWIN_F_COUNT];  // Último valor enviado de cada campo
+    uint32_t dirty;              // Bit i: campo i cambió desde el último envío
+    bool snapshot;               // El próximo envío es una instantánea
+    int64_t due_us;              // Envío programado (INT64_MAX: ninguno)
+    uint32_t seq;                // Último seq enviado
+    int64_t min_interval_us;
+    int64_t heartbeat_us;        // 0: sin heartbeat
+    int64_t last_tx_us;
+    twin_stats_t st;
+} twin_state_t;
+
+typedef enum {
+    TWIN_MSG_SNAPSHOT = 0,
+    TWIN_MSG_DELTA,
+    TWIN_MSG_HEARTBEAT,
+} twin_msg_kind_t;
+
+// Lo que sale en un mensaje (copia, para serializar sin cerrojo)
+typedef struct {
+    uint32_t seq;
+    twin_msg_kind_t kind;
+    uint32_t mask;           // Campos incluidos
+    int32_t val[TWIN_F_COUNT];
+} twin_msg_t;
+
+// Empieza con todos los campos a 0 y una instantánea pendiente
+void twin_init(twin_state_t *t, uint32_t min_interval_ms, uint32_t heartbeat_ms);
+void twin_set_rate(twin_state_t *t, uint32_t min_interval_ms);
+
+// Actualiza un campo. true: hay que (re)programar el envío para *due_us
+// (la primera vez en cada cuadro; el resto se suma al ya programado)
+bool twin_set(twin_state_t *t, twin_field_t f, int32_t v, int64_t now_us, int64_t *due_us);
+// Fuerza una instantánea en el próximo envío (conexión, petición del gemelo)
+bool twin_request_snapshot(twin_state_t *t, int64_t now_us, int64_t *due_us);
+
+// Vence el envío programado: copia el mensaje (y avanza seq salvo en los
+// heartbeats). false si no hay nada que enviar (cambios revertidos dentro
+// del cuadro). *next_us: siguiente envío a programar (heartbeat), o
+// INT64_MAX
+bool twin_take(twin_state_t *t, int64_t now_us, twin_msg_t *out, int64_t *next_us);
+// JSON compacto; devuelve la longitud (0 si no cabe)
+size_t twin_format(const twin_msg_t *m, char *buf, size_t cap);
+
+const char *twin_field_name(twin_field_t f);
+int twin_field_index(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,185 @@
+/*
+ * access_fsm_check: verificación exhaustiva en host de la máquina de estados
+ * de control_task (main/access_fsm.c) y medida de su rendimiento.
+ *
+ * Recorre TODAS las secuencias de eventos hasta --depth (5^depth por estado
+ * inicial) con un modelo del entorno: nivel real de la puerta y plazos
+ * armados según las acciones devueltas. Los plazos solo vencen si están
+ * armados (salvo --stale, que también inyecta vencimientos obsoletos). En
+ * cada paso comprueba:
+ *   - La puerta que codifica el estado coincide con la puerta del modelo.
+ *   - ACCESS_ACT_LOCK solo ocurre con la puerta cerrada.
+ *   - Desbloqueada => DL_UNLOCK_MAX armado; bloqueada => ningún plazo armado.
+ *   - DL_RELOCK armado <=> estado ACCESS_RELOCK_PENDING.
+ *   - Vivacidad: desde cualquier estado alcanzado, cerrar la puerta y dejar
+ *     vencer los plazos armados lleva a un estado bloqueado.
+ *
+ * Compilar: make -C tools access_fsm_check   (binario en tools/build/)
+ * Ejemplo:  tools/build/access_fsm_check --depth 10 --stale
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "access_fsm.h"
+
+typedef struct {
+    access_fsm_t fsm;
+    bool door_closed;        // Puerta real
+    bool relock_armed;
+    bool unlock_max_armed;
+} world_t;
+
+static long g_paths = 0;
+static long g_steps = 0;
+static bool g_stale = false;
+static int g_depth = 8;
+static bool g_fail = false;
+static access_event_t g_trail[64];
+
+static void report(const char *what, const world_t *w, int depth)
+{
+    if (g_fail) return;
+    g_fail = true;
+    fprintf(stderr, "FALLO: %s (estado %s)\n  secuencia:", what, access_state_name(w->fsm.state));
+    for (int i = 0; i < depth; ++i) fprintf(stderr, " %s", access_event_name(g_trail[i]));
+    fprintf(stderr, "\n");
+}
+
+// Aplica las acciones al modelo del entorno
+static void world_apply(world_t *w, uint8_t act, int depth)
+{
+    if ((act & ACCESS_ACT_LOCK) && !w->door_closed) report("LOCK con la puerta abierta", w, depth);
+    if (act & ACCESS_ACT_CANCEL_RELOCK) w->relock_armed = false;
+    if (act & ACCESS_ACT_CANCEL_UNLOCK_MAX) w->unlock_max_armed = false;
+    if (act & ACCESS_ACT_ARM_RELOCK) w->relock_armed = true;
+    if (act & ACCESS_ACT_ARM_UNLOCK_MAX) w->unlock_max_armed = true;
+}
+
+static void check_invariants(const world_t *w, int depth)
+{
+    access_state_t s = w->fsm.state;
+    if (access_state_door_closed(s) != w->door_closed) report("puerta del estado != puerta real", w, depth);
+    if (access_state_is_locked(s)) {
+        if (w->relock_armed || w->unlock_max_armed) report("bloqueada con plazos armados", w, depth);
+    } else if (!w->unlock_max_armed) {
+        report("desbloqueada sin DL_UNLOCK_MAX", w, depth);
+    }
+    if (w->relock_armed != (s == ACCESS_RELOCK_PENDING)) report("DL_RELOCK incoherente", w, depth);
+}
+
+// ¿El evento puede ocurrir en este entorno?
+static bool world_admits(const world_t *w, access_event_t ev)
+{
+    switch (ev) {
+    case ACCESS_EV_DOOR_OPEN:       return w->door_closed;     // Solo se publican cambios
+    case ACCESS_EV_DOOR_CLOSED:     return !w->door_closed;
+    case ACCESS_EV_RELOCK_DUE:      return g_stale || w->relock_armed;
+    case ACCESS_EV_UNLOCK_MAX_DUE:  return g_stale || w->unlock_max_armed;
+    default:                        return true;
+    }
+}
+
+static void world_event(world_t *w, access_event_t ev, int depth)
+{
+    if (ev == ACCESS_EV_DOOR_OPEN) w->door_closed = false;
+    if (ev == ACCESS_EV_DOOR_CLOSED) w->door_closed = true;
+    // Un plazo que vence deja de estar armado
+    if (ev == ACCESS_EV_RELOCK_DUE) w->relock_armed = false;
+    if (ev == ACCESS_EV_UNLOCK_MAX_DUE) w->unlock_max_armed = false;
+    uint8_t act = access_fsm_step(&w->fsm, ev);
+    g_steps++;
+    world_apply(w, act, depth);
+}
+
+static void check_liveness(world_t w, int depth)
+{
+    for (int i = 0; i < 8 && !access_state_is_locked(w.fsm.state); ++i) {
+        if (!w.door_closed) world_event(&w, ACCESS_EV_DOOR_CLOSED, depth);
+        else if (w.relock_armed) world_event(&w, ACCESS_EV_RELOCK_DUE, depth);
+        else if (w.unlock_max_armed) world_event(&w, ACCESS_EV_UNLOCK_MAX_DUE, depth);
+    }
+    if (!access_state_is_locked(w.fsm.state)) report("no vuelve a bloquear", &w, depth);
+}
+
+static void explore(const world_t *w, int depth)
+{
+    check_invariants(w, depth);
+    check_liveness(*w, depth);
+    if (g_fail) return;
+    if (depth == g_depth) { g_paths++; return; }
+    for (int e = 0; e < ACCESS_EV_COUNT; ++e) {
+        if (!world_admits(w, (access_event_t)e)) continue;
+        world_t next = *w;
+        g_trail[depth] = (access_event_t)e;
+        world_event(&next, (access_event_t)e, depth + 1);
+        if (g_stale) {
+            // Con vencimientos obsoletos el modelo de plazos no es exacto:
+            // solo se exigen la regla de LOCK y la coherencia de la puerta
+            next.relock_armed = (next.fsm.state == ACCESS_RELOCK_PENDING);
+            next.unlock_max_armed = !access_state_is_locked(next.fsm.state);
+        }
+        explore(&next, depth + 1);
+        if (g_fail) return;
+    }
+}
+
+static void check_table(void)
+{
+    for (int s = 0; s < ACCESS_STATE_COUNT; ++s) {
+        for (int e = 0; e < ACCESS_EV_COUNT; ++e) {
+            if (access_fsm_table[s][e].next >= ACCESS_STATE_COUNT) {
+                fprintf(stderr, "FALLO: tabla[%s][%s] fuera de rango\n",
+                        access_state_name((access_state_t)s), access_event_name((access_event_t)e));
+                g_fail = true;
+            }
+        }
+    }
+}
+
+static void bench(long n)
+{
+    access_fsm_t f;
+    access_fsm_init(&f, true);
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    uint32_t acc = 0;
+    clock_t t0 = clock();
+    for (long i = 0; i < n; ++i) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        acc += access_fsm_step(&f, (access_event_t)(rng % ACCESS_EV_COUNT));
+    }
+    double dt = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    printf("rendimiento: %.1f M eventos/s (%.1f ns/evento, acc=%u)\n",
+           n / dt / 1e6, dt * 1e9 / n, (unsigned)acc);
+}
+
+int main(int argc, char **argv)
+{
+    long bench_n = 50000000;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--depth") && i + 1 < argc) g_depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--stale")) g_stale = true;
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc) bench_n = atol(argv[++i]);
+        else {
+            fprintf(stderr, "uso: access_fsm_check [--depth N (8)] [--stale] [--bench N]\n");
+            return 2;
+        }
+    }
+    if (g_depth < 1 || g_depth > 60) g_depth = 8;
+
+    check_table();
+    for (int closed = 0; closed <= 1 && !g_fail; ++closed) {
+        world_t w = { .door_closed = closed };
+        uint8_t act = access_fsm_init(&w.fsm, closed);
+        // Arranque con la puerta abierta: control_task no ejecuta LOCK (ver main.c)
+        if (closed) world_apply(&w, act, 0);
+        explore(&w, 0);
+    }
+    if (g_fail) return 1;
+    printf("OK: %ld secuencias de %d eventos%s, %ld transiciones comprobadas\n",
+           g_paths, g_depth, g_stale ? " (con vencimientos obsoletos)" : "", g_steps);
+    if (bench_n > 0) bench(bench_n);
+    return 0;
+}
@@ -0,0 +1,1399 @@
+/*
+ * access_sim: simulador de eventos discretos del controlador de acceso con
+ * tiempo virtual y generador de carga.
+ *
+ * Ejecuta el código real de main/ con el mismo cableado que main.c:
+ * reed con rebotes -> door_debounce -> g_ctrl_q; rfid_task (sondeo cada
+ * 150 ms, una credencial por tarjeta nueva) y pot_task (lectura cada
+ * 120 ms -> pot_capture) -> cred_queue -> control_task (access_policy,
+ * cred_fusion, access_fsm) -> relé y plazos de sched (deadline) -> reed.
+ * control_task es un servidor único con tiempo de servicio: política y FSM
+ * (--ctrl-us) más cada log_event (--log-us, append en SPIFFS). Las personas
+ * simuladas presentan credenciales, abren la puerta solo si la cerradura
+ * está libre o la puerta ya está abierta, y la cierran al pasar.
+ *
+ * Escenarios (--scenario, por defecto todos):
+ *   shift  cambio de turno: una pasada por segundo (--period) durante
+ *          --minutes, con tarjetas desconocidas y alguna orden remota
+ *   held   puerta sujeta abierta 5 min en mitad del turno
+ *   flap   broker que cae 10 s de cada 30 con órdenes remotas cada 2 s
+ *   mix    día aleatorio (--hours): tarjeta, combinación y remoto, con
+ *          cortes del broker
+ * --runs N repite cada escenario con semillas consecutivas y acumula.
+ * Con --script FILE se ejecuta un guion con el formato de main/hal_vdev.h
+ * (el mismo del firmware en el target linux): gpio del reed, adc del
+ * potenciómetro, card (card@<cs> para el lector de otra puerta) y mqtt
+ * iot/commands (con "door" opcional).
+ *
+ * Varias puertas (--doors N), como main.c con DOOR_COUNT: cada una con su
+ * reed, relé, lector, cola de credenciales, fusión y FSM, y su propio flujo
+ * de personas; comparten control_task, log y MQTT, y rfid_task sondea los
+ * lectores en serie (--reader-us cada uno) antes de dormir 150 ms. El
+ * potenciómetro es de la puerta del panel (0). --sweep repite el escenario
+ * con 1..N puertas y da cuántas mantienen el p99 presentación -> relé por
+ * debajo de --target-ms. Más allá de 4 puertas (DOOR_MAX) solo es tendencia:
+ * la política se reparte módulo POLICY_MAX_DOORS.
+ *
+ * Informe: latencia presentación -> decisión y presentación -> desbloqueo
+ * (p50/p90/p99/máx), credenciales perdidas por causa, volumen de log
+ * (SPIFFS y MQTT) y cierres con la puerta abierta (regla de seguridad),
+ * separando los de la lógica (deben ser 0) de los que caen dentro de la
+ * ventana del anti-rebote. Misma semilla, mismo resultado.
+ *
+ * Compilar: make -C tools access_sim   (binario en tools/build/)
+ * Ejemplos: tools/build/access_sim --runs 10
+ *           tools/build/access_sim --scenario shift --period 500 --log-us 15000
+ *           tools/build/access_sim --scenario shift --doors 8 --sweep --runs 5
+ *           tools/build/access_sim --script escenario.txt -v
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "access_fsm.h"
+#include "access_policy.h"
+#include "cred_fusion.h"
+#include "cred_queue.h"
+#include "deadline.h"
+#include "door_debounce.h"
+#include "hal_vdev.h"
+#include "pot_capture.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define S(x)  ((int64_t)(x) * 1000000)
+
+// Igual que main.c
+#define DEBOUNCE_MS       DOOR_DEBOUNCE_MS
+#define RELOCK_MS         1000
+#define UNLOCK_MAX_MS     10000
+#define CTRL_QUEUE_LEN    16
+#define RFID_POLL_MS      150
+#define POT_POLL_MS       120
+#define CRED_WINDOW_MS    30000
+#define POT_PATIENCE_MS   10000   // Sin pip en este tiempo, la persona se rinde
+#define POT_GPIO          34
+#define CMD_TOPIC         "iot/commands"
+#define DEVICE_ID         "access_control_01"
+#define PANEL_DOOR        0       // Puerta con potenciómetro
+#define SIM_DOORS_MAX     8
+enum { DL_RELOCK = 0, DL_UNLOCK_MAX };   // Por puerta (un deadline_set_t en cada una)
+
+// Reed y CS del lector de cada puerta (DOOR_HW de main.c), para el guion
+static const struct { int reed, cs; } DOOR_PINS[] = { { 33, 5 }, { 35, 17 }, { 36, 4 }, { 39, 15 } };
+#define SCRIPT_DOORS ((int)(sizeof(DOOR_PINS) / sizeof(DOOR_PINS[0])))
+
+static const int COMBO[3] = { 3, 6, 4 };
+
+static bool g_verbose = false;
+
+// ---- Azar reproducible (urand() de tools/common, xorshift64*) ----
+static double nrand(void)
+{
+    return sqrt(-2.0 * log(urand())) * cos(6.283185307179586 * urand());
+}
+
+// ---- Cola de eventos (montículo, desempate FIFO) ----
+// door: puerta del evento (reed, anti-rebote, plazos, fin de paso, sujetar)
+typedef enum {
+    EV_ARRIVE = 0,     // arg: persona
+    EV_PERSON,         // arg: persona; gen: 1 cruzar, 2 marcar, 3 fin de paso, 4 paciencia
+    EV_CARD,           // arg: 1 tarjeta en el campo, 0 retirada; gen: estímulo
+    EV_EDGE,           // arg: nivel del reed (flanco o rebote)
+    EV_DB_EXPIRE,      // gen: ventana de anti-rebote vigente
+    EV_SCHED,          // gen: armado vigente del esp_timer de sched
+    EV_RFID_POLL,      // arg: lector que toca sondear
+    EV_POT_POLL,
+    EV_CTRL,           // control_task atiende g_ctrl_q
+    EV_MQTT_RX,        // arg: estímulo de la orden remota
+    EV_BROKER,         // arg: 1 conectado
+    EV_PROP,           // arg: 1 sujetar la puerta abierta, 0 soltarla
+    EV_SCRIPT,         // arg: línea del guion
+    EV_END,
+} ev_kind_t;
+
+typedef struct {
+    int64_t t;
+    uint32_t ord;
+    uint8_t kind;
+    uint8_t door;
+    int arg;
+    uint32_t gen;
+} ev_t;
+
+typedef struct {
+    ev_t *h;
+    int n, cap;
+    uint32_t ord;
+} evq_t;
+
+static bool before(const ev_t *a, const ev_t *b)
+{
+    return a->t < b->t || (a->t == b->t && a->ord < b->ord);
+}
+
+static void evq_push_door(evq_t *q, int64_t t, ev_kind_t kind, int arg, uint32_t gen, int door)
+{
+    if (q->n == q->cap) {
+        q->cap = q->cap ? 2 * q->cap : 256;
+        q->h = realloc(q->h, sizeof(ev_t) * (size_t)q->cap);
+    }
+    ev_t e = { t, q->ord++, (uint8_t)kind, (uint8_t)door, arg, gen };
+    int i = q->n++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (before(&q->h[p], &e)) break;
+        q->h[i] = q->h[p];
+        i = p;
+    }
+    q->h[i] = e;
+}
+
+static void evq_push(evq_t *q, int64_t t, ev_kind_t kind, int arg, uint32_t gen)
+{
+    evq_push_door(q, t, kind, arg, gen, 0);
+}
+
+static ev_t evq_pop(evq_t *q)
+{
+    ev_t top = q->h[0], last = q->h[--q->n];
+    int i = 0;
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        const ev_t *best = &last;
+        if (l < q->n && before(&q->h[l], best)) { m = l; best = &q->h[l]; }
+        if (r < q->n && before(&q->h[r], best)) m = r;
+        if (m == i) break;
+        q->h[i] = q->h[m];
+        i = m;
+    }
+    if (q->n) q->h[i] = last;
+    return top;
+}
+
+// ---- Estímulos (una presentación de credencial) y personas ----
+typedef enum {
+    OUT_NONE = 0,      // Sin decisión (perdida)
+    OUT_GRANT,
+    OUT_DENY,
+    OUT_PENDING,       // Factor guardado por la fusión
+} outcome_t;
+
+typedef enum {
+    LOST_NONE = 0,
+    LOST_UNREAD,       // Tarjeta retirada antes de un sondeo
+    LOST_OVERFLOW,     // Carril de cred_queue lleno
+    LOST_NO_BROKER,    // Orden remota con el broker caído
+    LOST_RESET,        // Combinación anulada por un bloqueo a medias
+    LOST_STALL,        // Captura llena (combinación correcta sin bloqueo): se rinde
+    LOST_OTHER,
+    LOST_COUNT
+} lost_t;
+
+static const char *const LOST_NAMES[LOST_COUNT] = { "-", "tarjeta no leída", "cola llena", "remoto sin broker", "combinación anulada",
+                                                      "potenciómetro sin respuesta", "otras" };
+
+typedef struct {
+    int64_t at;        // Presentación: tarjeta en el campo, último dígito marcado, orden enviada
+    int64_t decided, unlocked;
+    int64_t offered;   // Guardado en la fusión
+    uint8_t method;
+    uint8_t outcome;
+    uint8_t lost;
+    bool waited;       // Concedida con la puerta abierta (desbloqueo al cerrar)
+    uint8_t door;
+    int person;        // -1: guion
+} stim_t;
+
+typedef struct {
+    uint8_t method;
+    uint8_t door;
+    bool valid;        // Tarjeta en la política / combinación correcta
+    bool tailgate;     // Pasa por la puerta abierta sin credencial
+    uint8_t uid[4];
+    int stim;          // Tarjeta u orden remota
+    int combo;         // Combinación en curso
+    int step;          // Dígito en curso (combinación)
+    int64_t progress;  // Último dígito marcado o capturado
+    bool passed, blocked;
+} person_t;
+
+// ---- Configuración del escenario ----
+typedef struct {
+    const char *name;
+    int64_t duration;
+    int64_t period;            // Llegadas: periodo fijo con ±20 % (0: Poisson con mean_gap)
+    int64_t mean_gap;
+    double p_combo, p_remote, p_invalid, p_tailgate;
+    int64_t prop_from, prop_to;        // Puerta sujeta abierta (0, 0: nunca)
+    int64_t broker_up, broker_down;    // Ciclo fijo del broker (0: siempre arriba)
+    double outage_mean_up, outage_mean_down; // Cortes aleatorios (0: no)
+    int64_t ctrl_us, log_us;
+    int64_t reader_us;         // rfid_task: un sondeo de lector (REQA y, con tarjeta, anticolisión)
+    int doors;
+    fusion_rule_t rule;
+    const char *script;
+} scen_t;
+
+typedef struct {
+    uint32_t ctrl_q_full, ctrl_q_max;
+    uint32_t log_lines, log_bytes, mqtt_pub, mqtt_lost;
+    uint32_t lock_open_logic, lock_open_lag;
+    int64_t lock_open_lag_max;
+    uint32_t blocked, tailgates, passes;
+    uint32_t edges, glitches;
+    int64_t ctrl_busy;
+    int64_t vtime;
+    double wall;
+} stats_t;
+
+// Una puerta: reed, relé y lector, y su parte del firmware (door_ctx_t de main.c)
+typedef struct {
+    // Hardware
+    int reed;                  // Nivel instantáneo (0 cerrada, con rebotes)
+    bool phys_open;            // Puerta abierta de verdad
+    int64_t open_since;
+    int64_t close_at;          // Cierre previsto (personas pasando)
+    bool propped;
+    bool locked_hw;
+    // Lector RFID
+    bool card;
+    uint8_t card_uid[4];
+    int card_stim;
+    int64_t reader_free;
+    bool card_present_last;
+    uint8_t last_uid[4];
+    // Firmware
+    door_debounce_t db;
+    uint32_t db_gen;
+    deadline_set_t dl;
+    uint32_t sched_gen;
+    cred_queue_t cq;
+    int *seq_stim;             // Secuencia de cred_queue -> estímulo
+    int seq_cap;
+    fusion_t fusion;
+    access_fsm_t fsm;
+    int *walkers;              // Concedidas esperando a que la cerradura se libere
+    int nwalk, walk_cap;
+    int *pend;                 // Factores guardados en la fusión
+    int npend, pend_cap;
+} door_t;
+
+typedef struct {
+    scen_t sc;
+    evq_t q;
+    stats_t st;
+    stim_t *stim;
+    int nstim, stim_cap;
+    person_t *pp;
+    int npp, pp_cap;
+    policy_t *pol;
+    door_t door[SIM_DOORS_MAX];
+    int ndoors;
+    bool broker;
+    // Potenciómetro (puerta del panel)
+    double pot_from, pot_to;
+    int64_t pot_t0, pot_t1;
+    int pot_user;              // Persona marcando (-1 ninguna)
+    int *pot_wait;             // Personas esperando el potenciómetro
+    int npot_wait, pot_wait_cap, pot_wait_head;
+    int64_t pot_last_set;      // Guion: última orden adc
+    // Firmware compartido
+    pot_capture_t pot;
+    struct { uint8_t kind, door; int arg; } ctrl_q[CTRL_QUEUE_LEN];
+    int cq_head, cq_n;
+    bool ctrl_running;
+    int64_t ctrl_free;
+    int64_t t_now;             // Instante del trabajo en curso de control_task
+    int *granted;              // Concedidas en la credencial en curso
+    int ngranted, granted_cap;
+    // Guion
+    char **lines;
+    int nlines;
+    vdev_cmd_t *cmds;
+    int ncmds;
+    bool ended;
+} sim_t;
+
+enum { CTRL_CRED = 0, CTRL_DOOR, CTRL_TIMER };
+
+static void *grow(void *p, int *cap, int need, size_t sz)
+{
+    if (need <= *cap) return p;
+    int c = *cap ? *cap : 64;
+    while (c < need) c *= 2;
+    p = realloc(p, sz * (size_t)c);
+    memset((char *)p + sz * (size_t)*cap, 0, sz * (size_t)(c - *cap));
+    *cap = c;
+    return p;
+}
+
+static int stim_new(sim_t *s, int64_t at, cred_method_t m, int person, int door)
+{
+    s->stim = grow(s->stim, &s->stim_cap, s->nstim + 1, sizeof(stim_t));
+    stim_t *x = &s->stim[s->nstim];
+    memset(x, 0, sizeof(*x));
+    x->at = at;
+    x->decided = x->unlocked = -1;
+    x->method = (uint8_t)m;
+    x->door = (uint8_t)door;
+    x->person = person;
+    return s->nstim++;
+}
+
+// ---- log_event() de main.c: línea en SPIFFS + publicación QoS 1 ----
+static int64_t log_event(sim_t *s, int door, const char *method, bool granted, const char *status)
+{
+    char line[256];
+    int n = snprintf(line, sizeof(line),
+                     "{\"device_id\":\"%s\",\"door\":%d,\"door_status\":\"%s\",\"access_method\":\"%s\",\"access_granted\":%s,\"timestamp\":\"%s\"}",
+                     DEVICE_ID, door, status, method, granted ? "true" : "false", "");
+    s->st.log_lines++;
+    s->st.log_bytes += (uint32_t)n + 1;
+    if (s->broker) s->st.mqtt_pub++;
+    else s->st.mqtt_lost++;
+    return s->sc.log_us;
+}
+
+static const char *door_str(const door_t *d)
+{
+    return access_state_door_closed(d->fsm.state) ? "close" : "open";
+}
+
+// ---- Reed: flanco físico con rebotes ----
+static void door_set(sim_t *s, int di, int64_t t, bool open)
+{
+    door_t *d = &s->door[di];
+    if (open == d->phys_open) return;
+    d->phys_open = open;
+    if (open) d->open_since = t;
+    int level = open ? 1 : 0;
+    // 0 a 4 rebotes en los primeros ms, siempre acabando en el nivel final
+    int bounces = (int)(urand() * 5);
+    int64_t at = t;
+    for (int i = 0; i < bounces; ++i) {
+        evq_push_door(&s->q, at, EV_EDGE, (i % 2) ? 1 - level : level, 0, di);
+        at += 200 + exp_us(600);
+        evq_push_door(&s->q, at, EV_EDGE, (i % 2) ? level : 1 - level, 0, di);
+        at += 200 + exp_us(600);
+    }
+    evq_push_door(&s->q, at, EV_EDGE, level, 0, di);
+}
+
+// ---- sched.c sobre deadline: un esp_timer al plazo más próximo ----
+static void sched_rearm(sim_t *s, int di)
+{
+    door_t *d = &s->door[di];
+    int64_t at;
+    d->sched_gen++;
+    if (deadline_next(&d->dl, &at)) evq_push_door(&s->q, at < s->t_now ? s->t_now : at, EV_SCHED, 0, d->sched_gen, di);
+}
+
+// ---- g_ctrl_q (compartida por todas las puertas) ----
+static bool ctrl_post(sim_t *s, int64_t t, uint8_t kind, int di, int arg)
+{
+    if (s->cq_n == CTRL_QUEUE_LEN) {
+        s->st.ctrl_q_full++;
+        return false;
+    }
+    int i = (s->cq_head + s->cq_n++) % CTRL_QUEUE_LEN;
+    s->ctrl_q[i].kind = kind;
+    s->ctrl_q[i].door = (uint8_t)di;
+    s->ctrl_q[i].arg = arg;
+    if ((uint32_t)s->cq_n > s->st.ctrl_q_max) s->st.ctrl_q_max = (uint32_t)s->cq_n;
+    if (!s->ctrl_running) {
+        s->ctrl_running = true;
+        evq_push(&s->q, t < s->ctrl_free ? s->ctrl_free : t, EV_CTRL, 0, 0);
+    }
+    return true;
+}
+
+// cred_post() de main.c
+static void cred_post(sim_t *s, int64_t t, int di, cred_method_t m, const uint8_t *id, int id_len, int stim)
+{
+    door_t *d = &s->door[di];
+    cred_rec_t rec = { .method = (uint8_t)m, .id_len = (uint8_t)id_len, .ts_us = t };
+    if (id_len) memcpy(rec.id, id, (size_t)id_len);
+    uint32_t seq;
+    cred_push_t r = cred_queue_push(&d->cq, &rec, &seq);
+    d->seq_stim = grow(d->seq_stim, &d->seq_cap, (int)seq + 1, sizeof(int));
+    d->seq_stim[seq] = stim;
+    if (r == CRED_PUSH_DROPPED) {
+        if (stim >= 0) s->stim[stim].lost = LOST_OVERFLOW;
+        return;
+    }
+    if (r == CRED_PUSH_QUEUED_BELL && !ctrl_post(s, t, CTRL_CRED, di, 0)) cred_queue_bell_lost(&d->cq);
+}
+
+// ---- Personas que cruzan ----
+static void person_walk(sim_t *s, int p, int64_t t)
+{
+    evq_push_door(&s->q, t, EV_PERSON, p, 1, s->pp[p].door);
+}
+
+// Relé liberado: los que esperaban tiran de la puerta
+static void walkers_go(sim_t *s, door_t *d, int64_t t)
+{
+    for (int i = 0; i < d->nwalk; ++i) person_walk(s, d->walkers[i], t + MS(500) + exp_us(MS(700)));
+    d->nwalk = 0;
+}
+
+static void walkers_add(door_t *d, int p)
+{
+    if (p < 0) return;
+    d->walkers = grow(d->walkers, &d->walk_cap, d->nwalk + 1, sizeof(int));
+    d->walkers[d->nwalk++] = p;
+}
+
+// ---- control_task ----
+
+// ctrl_apply() de main.c: relé, plazos, y la comprobación de seguridad
+static void ctrl_apply(sim_t *s, int di, uint8_t act)
+{
+    door_t *d = &s->door[di];
+    int64_t t = s->t_now;
+    bool rearm = false;
+    if (act & ACCESS_ACT_CANCEL_RELOCK) { deadline_cancel(&d->dl, DL_RELOCK); rearm = true; }
+    if (act & ACCESS_ACT_CANCEL_UNLOCK_MAX) { deadline_cancel(&d->dl, DL_UNLOCK_MAX); rearm = true; }
+    if (act & ACCESS_ACT_LOCK) {
+        if (d->phys_open) {
+            // La FSM cree la puerta cerrada: el reed aún no confirmó la apertura
+            if (access_state_door_closed(d->fsm.state)) {
+                s->st.lock_open_lag++;
+                if (t - d->open_since > s->st.lock_open_lag_max) s->st.lock_open_lag_max = t - d->open_since;
+            } else {
+                s->st.lock_open_logic++;
+            }
+            if (g_verbose) printf("  %10.3f s  puerta %d: cierre con la puerta abierta hace %lld us\n", t / 1e6, di,
+                                  (long long)(t - d->open_since));
+        }
+        d->locked_hw = true;
+        if (di == PANEL_DOOR) pot_capture_reset(&s->pot); // xTaskNotifyGive a pot_task
+    }
+    if (act & ACCESS_ACT_UNLOCK) {
+        d->locked_hw = false;
+        walkers_go(s, d, t);
+    }
+    if (act & ACCESS_ACT_ARM_RELOCK) { deadline_arm(&d->dl, DL_RELOCK, t + MS(RELOCK_MS)); rearm = true; }
+    if (act & ACCESS_ACT_ARM_UNLOCK_MAX) { deadline_arm(&d->dl, DL_UNLOCK_MAX, t + MS(UNLOCK_MAX_MS)); rearm = true; }
+    if (rearm) sched_rearm(s, di);
+}
+
+static void ctrl_step(sim_t *s, int di, access_event_t aev)
+{
+    access_fsm_t *fsm = &s->door[di].fsm;
+    access_state_t prev = fsm->state;
+    uint8_t act = access_fsm_step(fsm, aev);
+    if (g_verbose && prev != fsm->state) {
+        printf("  %10.3f s  puerta %d: FSM %s --%s--> %s\n", s->t_now / 1e6, di, access_state_name(prev),
+               access_event_name(aev), access_state_name(fsm->state));
+    }
+    ctrl_apply(s, di, act);
+}
+
+// ctrl_credential_grants() de main.c
+static bool ctrl_credential_grants(sim_t *s, int di, const cred_rec_t *rec, int si)
+{
+    door_t *d = &s->door[di];
+    stim_t *x = si >= 0 ? &s->stim[si] : NULL;
+    const char *method = cred_method_name((cred_method_t)rec->method);
+    policy_decision_t pd = policy_decide(s->pol, (uint16_t)(di % POLICY_MAX_DOORS), (cred_method_t)rec->method, rec->id,
+                                         rec->id_len, POLICY_NO_CLOCK);
+    if (pd != POLICY_ALLOW) {
+        s->t_now += log_event(s, di, method, false, door_str(d));
+        if (x) { x->outcome = OUT_DENY; x->decided = s->t_now; }
+        return false;
+    }
+    if (rec->method != CRED_REMOTE) s->t_now += log_event(s, di, method, true, door_str(d));
+    s->ngranted = 0;
+    if (fusion_offer(&d->fusion, rec, s->t_now) == FUSION_GRANT) {
+        // La concesión consume también los factores vigentes
+        for (int i = 0; i < d->npend; ++i) {
+            stim_t *y = &s->stim[d->pend[i]];
+            if (s->t_now - y->offered >= d->fusion.cfg.window_us) continue; // Caducado: queda sin completar
+            y->outcome = OUT_GRANT;
+            y->decided = s->t_now;
+            s->granted = grow(s->granted, &s->granted_cap, s->ngranted + 1, sizeof(int));
+            s->granted[s->ngranted++] = d->pend[i];
+        }
+        d->npend = 0;
+        if (x) {
+            x->outcome = OUT_GRANT;
+            x->decided = s->t_now;
+            s->granted = grow(s->granted, &s->granted_cap, s->ngranted + 1, sizeof(int));
+            s->granted[s->ngranted++] = si;
+        }
+        return true;
+    }
+    if (x) {
+        x->outcome = OUT_PENDING;
+        x->offered = s->t_now;
+        d->pend = grow(d->pend, &d->pend_cap, d->npend + 1, sizeof(int));
+        d->pend[d->npend++] = si;
+    }
+    return false;
+}
+
+static void ctrl_drain_credentials(sim_t *s, int di)
+{
+    door_t *d = &s->door[di];
+    cred_rec_t rec;
+    while (cred_queue_pop(&d->cq, &rec)) {
+        s->t_now += s->sc.ctrl_us;
+        if (!ctrl_credential_grants(s, di, &rec, d->seq_stim[rec.seq])) continue;
+        ctrl_step(s, di, ACCESS_EV_GRANT);
+        bool wait = d->fsm.state == ACCESS_GRANTED_WAIT_CLOSE;
+        for (int i = 0; i < s->ngranted; ++i) {
+            stim_t *x = &s->stim[s->granted[i]];
+            // Relé liberado en este instante (o ya lo estaba); si no, al cerrar la puerta
+            if (wait) x->waited = true;
+            else x->unlocked = s->t_now;
+            if (x->person < 0) continue;
+            if (d->phys_open) {
+                person_walk(s, x->person, s->t_now + MS(300)); // Cruza por la abierta
+            } else {
+                walkers_add(d, x->person);
+                if (!d->locked_hw) walkers_go(s, d, s->t_now);
+            }
+        }
+    }
+}
+
+static void ev_ctrl(sim_t *s, int64_t now)
+{
+    s->t_now = now;
+    if (s->cq_n) {
+        uint8_t kind = s->ctrl_q[s->cq_head].kind;
+        int di = s->ctrl_q[s->cq_head].door;
+        int arg = s->ctrl_q[s->cq_head].arg;
+        door_t *d = &s->door[di];
+        s->cq_head = (s->cq_head + 1) % CTRL_QUEUE_LEN;
+        s->cq_n--;
+        s->t_now += s->sc.ctrl_us;
+        if (kind == CTRL_DOOR) {
+            bool closed = arg == 0;
+            if (closed != access_state_door_closed(d->fsm.state)) {
+                s->t_now += log_event(s, di, "door", false, closed ? "close" : "open");
+                ctrl_step(s, di, closed ? ACCESS_EV_DOOR_CLOSED : ACCESS_EV_DOOR_OPEN);
+            }
+        } else if (kind == CTRL_TIMER) {
+            // Rearmado después de disparar: vencimiento obsoleto
+            if (!deadline_is_armed(&d->dl, arg)) ctrl_step(s, di, arg == DL_RELOCK ? ACCESS_EV_RELOCK_DUE : ACCESS_EV_UNLOCK_MAX_DUE);
+        }
+        // Cualquier despertar vacía las credenciales de todas las puertas
+        for (int i = 0; i < s->ndoors; ++i) ctrl_drain_credentials(s, i);
+    }
+    s->st.ctrl_busy += s->t_now - now;
+    s->ctrl_free = s->t_now;
+    if (s->cq_n) evq_push(&s->q, s->t_now, EV_CTRL, 0, 0);
+    else s->ctrl_running = false;
+}
+
+// ---- Sensores ----
+
+static void ev_edge(sim_t *s, int di, int64_t t, int level)
+{
+    door_t *d = &s->door[di];
+    d->reed = level;
+    int64_t due = door_debounce_edge(&d->db, t);
+    evq_push_door(&s->q, due, EV_DB_EXPIRE, 0, ++d->db_gen, di);
+}
+
+static void ev_db_expire(sim_t *s, int di, int64_t t)
+{
+    door_t *d = &s->door[di];
+    if (door_debounce_expire(&d->db, d->reed, t)) ctrl_post(s, t, CTRL_DOOR, di, d->reed);
+}
+
+static void ev_sched(sim_t *s, int di, int64_t t)
+{
+    int id;
+    while ((id = deadline_pop_expired(&s->door[di].dl, t)) >= 0) ctrl_post(s, t, CTRL_TIMER, di, id);
+    s->t_now = t;
+    sched_rearm(s, di);
+}
+
+// rfid_task: sondea los lectores en serie (--reader-us cada uno, el evento
+// marca el final del sondeo) y duerme 150 ms tras el último. Una credencial
+// por tarjeta nueva; "sin tarjeta" rearma.
+static void ev_rfid_poll(sim_t *s, int64_t t, int di)
+{
+    door_t *d = &s->door[di];
+    if (d->card) {
+        bool is_new = !d->card_present_last || memcmp(d->last_uid, d->card_uid, 4) != 0;
+        if (is_new) {
+            int si = d->card_stim;
+            if (si < 0) si = stim_new(s, t, CRED_RFID, -1, di);
+            s->stim[si].lost = LOST_NONE;
+            cred_post(s, t, di, CRED_RFID, d->card_uid, 4, si);
+            memcpy(d->last_uid, d->card_uid, 4);
+            d->card_stim = -1;
+        }
+        d->card_present_last = true;
+    } else {
+        d->card_present_last = false;
+    }
+    if (di + 1 < s->ndoors) evq_push(&s->q, t + s->sc.reader_us, EV_RFID_POLL, di + 1, 0);
+    else evq_push(&s->q, t + MS(RFID_POLL_MS) + s->sc.reader_us, EV_RFID_POLL, 0, 0);
+}
+
+static double digit_raw(const pot_capture_cfg_t *c, int digit)
+{
+    int d = c->invert ? 9 - digit : digit;
+    double eff = c->adc_max_raw - 2 * c->deadzone_raw;
+    return c->deadzone_raw + (d + 0.5) * eff / 10.0;
+}
+
+static double pot_pos(const sim_t *s, int64_t t)
+{
+    if (t >= s->pot_t1) return s->pot_to;
+    if (t <= s->pot_t0) return s->pot_from;
+    return s->pot_from + (s->pot_to - s->pot_from) * (double)(t - s->pot_t0) / (double)(s->pot_t1 - s->pot_t0);
+}
+
+static void pot_move(sim_t *s, int64_t t, double to, int64_t dur)
+{
+    s->pot_from = pot_pos(s, t);
+    s->pot_to = to;
+    s->pot_t0 = t;
+    s->pot_t1 = t + dur;
+}
+
+static void pot_user_next(sim_t *s, int64_t t);
+
+// pot_task: lectura, pot_capture y reacción a sus eventos (puerta del panel)
+static void ev_pot_poll(sim_t *s, int64_t t)
+{
+    int raw = (int)lround(pot_pos(s, t) + 6.0 * nrand());
+    if (raw < 0) raw = 0;
+    if (raw > 4095) raw = 4095;
+    pot_capture_event_t ev = pot_capture_feed(&s->pot, raw, t);
+    int64_t next = t + MS(POT_POLL_MS) + (ev == POT_CAP_DEADZONE ? MS(40) : 0);
+    if (ev == POT_CAP_DIGIT || ev == POT_CAP_COMBO_OK || ev == POT_CAP_COMBO_BAD) {
+        int p = s->pot_user;
+        int si = p >= 0 ? s->pp[p].combo : -1;
+        if (ev == POT_CAP_COMBO_OK) {
+            if (si < 0) si = stim_new(s, s->pot_last_set >= 0 ? s->pot_last_set : t, CRED_COMBO, -1, PANEL_DOOR);
+            cred_post(s, t, PANEL_DOOR, CRED_COMBO, NULL, 0, si);
+            pot_capture_reset(&s->pot); // combo_reset() tras publicar el factor
+        } else if (ev == POT_CAP_COMBO_BAD) {
+            log_event(s, PANEL_DOOR, "password", false, door_str(&s->door[PANEL_DOOR])); // En pot_task, no en control_task
+            if (si >= 0) { s->stim[si].outcome = OUT_DENY; s->stim[si].decided = t; }
+            pot_capture_reset(&s->pot);
+        }
+        if (p >= 0) {
+            s->pp[p].progress = t;
+            if (ev == POT_CAP_DIGIT) evq_push(&s->q, t + MS(250) + exp_us(MS(300)), EV_PERSON, p, 2); // Oye el pip
+            else pot_user_next(s, t + MS(300));
+        }
+    }
+    evq_push(&s->q, next, EV_POT_POLL, 0, 0);
+}
+
+// ---- Recorrido de las personas ----
+
+static void pot_user_next(sim_t *s, int64_t t)
+{
+    s->pot_user = -1;
+    if (s->pot_wait_head < s->npot_wait) {
+        int p = s->pot_wait[s->pot_wait_head++];
+        s->pot_user = p;
+        s->pp[p].step = 0;
+        s->pp[p].combo = stim_new(s, t, CRED_COMBO, p, PANEL_DOOR);
+        evq_push(&s->q, t + MS(500), EV_PERSON, p, 2);
+    }
+}
+
+// Marca el siguiente dígito: gira hasta su centro (con una pasada por otro
+// dígito si ya está encima, porque la captura exige movimiento)
+static void person_dial(sim_t *s, int p, int64_t t)
+{
+    person_t *pp = &s->pp[p];
+    if (pp->step >= 3) {
+        // Un bloqueo reinició la captura a medias: los dígitos ya no cuadran
+        s->stim[pp->combo].lost = LOST_RESET;
+        pot_user_next(s, t + MS(300));
+        return;
+    }
+    int want = pp->valid ? COMBO[pp->step] : (COMBO[pp->step] + 1 + pp->step) % 10;
+    int cur = pot_capture_raw_to_digit(&s->pot.cfg, (int)lround(pot_pos(s, t)));
+    if (cur == want) {
+        // Ya está encima: la captura exige movimiento, pasa por otro dígito
+        pot_move(s, t, digit_raw(&s->pot.cfg, (want + 3) % 10), MS(300));
+        evq_push(&s->q, t + MS(400), EV_PERSON, p, 2);
+        return;
+    }
+    int64_t dur = MS(400) + exp_us(MS(400));
+    pot_move(s, t, digit_raw(&s->pot.cfg, want) + 40.0 * nrand(), dur);
+    pp->progress = t;
+    evq_push(&s->q, t + MS(POT_PATIENCE_MS), EV_PERSON, p, 4);
+    pp->step++;
+    if (pp->step == 3) s->stim[pp->combo].at = t + dur; // Presentación: queda quieta en el último
+}
+
+static void ev_arrive(sim_t *s, int64_t t, int p)
+{
+    person_t *pp = &s->pp[p];
+    door_t *d = &s->door[pp->door];
+    if (pp->tailgate) {
+        // Sin credencial: solo pasa si la puerta ya está abierta
+        if (d->phys_open) { s->st.tailgates++; person_walk(s, p, t); }
+        return;
+    }
+    if (pp->method == CRED_COMBO || (pp->method == CRED_RFID && s->sc.rule == FUSION_RULE_RFID_PIN)) {
+        // Espera turno en el potenciómetro (con AND, después de pasar la tarjeta)
+        s->pot_wait = grow(s->pot_wait, &s->pot_wait_cap, s->npot_wait + 1, sizeof(int));
+        s->pot_wait[s->npot_wait++] = p;
+        if (s->pot_user < 0) pot_user_next(s, t);
+    }
+    if (pp->method == CRED_COMBO) return;
+    pp->stim = stim_new(s, t, (cred_method_t)pp->method, p, pp->door);
+    if (pp->method == CRED_RFID) {
+        // Cola en el lector: una tarjeta en el campo cada vez
+        int64_t at = t > d->reader_free ? t : d->reader_free;
+        int64_t hold = MS(80) + exp_us(MS(350));
+        s->stim[pp->stim].at = at;
+        s->stim[pp->stim].lost = LOST_UNREAD; // Hasta que rfid_task la lea
+        evq_push_door(&s->q, at, EV_CARD, 1, (uint32_t)pp->stim, pp->door);
+        evq_push_door(&s->q, at + hold, EV_CARD, 0, (uint32_t)pp->stim, pp->door);
+        d->reader_free = at + hold + MS(200);
+    } else {
+        // Orden remota: app -> broker -> dispositivo
+        if (s->broker) evq_push(&s->q, t + MS(2) + exp_us(MS(15)), EV_MQTT_RX, pp->stim, 0);
+        else s->stim[pp->stim].lost = LOST_NO_BROKER;
+    }
+}
+
+// Cruza: abre si la cerradura está libre o la puerta abierta y cierra al pasar
+static void person_pass(sim_t *s, int p, int64_t t)
+{
+    person_t *pp = &s->pp[p];
+    door_t *d = &s->door[pp->door];
+    if (pp->passed) return;
+    if (!d->phys_open && d->locked_hw) {
+        pp->blocked = true;
+        s->st.blocked++;
+        return;
+    }
+    pp->passed = true;
+    s->st.passes++;
+    door_set(s, pp->door, t, true);
+    int64_t close = t + MS(1500) + exp_us(MS(1500));
+    if (close > d->close_at) {
+        d->close_at = close;
+        evq_push_door(&s->q, close, EV_PERSON, -1, 3, pp->door);
+    }
+}
+
+static void ev_person(sim_t *s, const ev_t *e)
+{
+    if (e->gen == 3) {
+        // Fin de un paso: la puerta se cierra si nadie más la sujeta
+        const door_t *d = &s->door[e->door];
+        if (e->t >= d->close_at && !d->propped) door_set(s, e->door, e->t, false);
+    } else if (e->gen == 2) {
+        person_dial(s, e->arg, e->t);
+    } else if (e->gen == 4) {
+        // Sin pip tras marcar: pot_capture ya tenía la combinación completa
+        person_t *pp = &s->pp[e->arg];
+        if (s->pot_user == e->arg && e->t - pp->progress >= MS(POT_PATIENCE_MS)) {
+            s->stim[pp->combo].lost = LOST_STALL;
+            pot_user_next(s, e->t);
+        }
+    } else {
+        person_pass(s, e->arg, e->t);
+    }
+}
+
+static void ev_card(sim_t *s, const ev_t *e)
+{
+    door_t *d = &s->door[e->door];
+    stim_t *x = &s->stim[e->gen];
+    if (e->arg) {
+        d->card = true;
+        memcpy(d->card_uid, s->pp[x->person].uid, 4);
+        d->card_stim = (int)e->gen;
+    } else if (d->card_stim == (int)e->gen || d->card_stim < 0) {
+        d->card = false;
+        d->card_stim = -1;
+    }
+}
+
+static void ev_mqtt_rx(sim_t *s, int64_t t, int si)
+{
+    if (!s->broker) {
+        s->stim[si].lost = LOST_NO_BROKER;
+        return;
+    }
+    const char *user = "app";
+    cred_post(s, t, s->stim[si].door, CRED_REMOTE, (const uint8_t *)user, (int)strlen(user), si);
+}
+
+// ---- Guion (formato de hal_vdev.h) ----
+
+// Puerta de un pin del guion (reed o CS del lector); -1 si no es de ninguna
+static int script_door(const sim_t *s, int pin, bool cs)
+{
+    for (int i = 0; i < s->ndoors && i < SCRIPT_DOORS; ++i) {
+        if (pin == (cs ? DOOR_PINS[i].cs : DOOR_PINS[i].reed)) return i;
+    }
+    return -1;
+}
+
+// "door" de una orden remota, como mqtt_on_data(): sin él, la del panel
+static int script_cmd_door(const sim_t *s, const char *payload)
+{
+    const char *k = strstr(payload, "\"door\"");
+    if (!k) return PANEL_DOOR;
+    k = strchr(k, ':');
+    int id = k ? atoi(k + 1) : -1;
+    return id >= 0 && id < s->ndoors ? id : -1;
+}
+
+static void ev_script(sim_t *s, int64_t t, int i)
+{
+    const vdev_cmd_t *c = &s->cmds[i];
+    int di;
+    switch (c->op) {
+    case VDEV_OP_GPIO:
+        if ((di = script_door(s, c->pin, false)) >= 0) {
+            door_t *d = &s->door[di];
+            d->phys_open = c->value != 0;
+            if (d->phys_open) d->open_since = t;
+            ev_edge(s, di, t, c->value);
+        }
+        break;
+    case VDEV_OP_ADC:
+        if (c->pin == POT_GPIO) {
+            pot_move(s, t, c->value, 0);
+            s->pot_last_set = t;
+        }
+        break;
+    case VDEV_OP_CARD: {
+        di = c->pin < 0 ? 0 : script_door(s, c->pin, true);
+        if (di < 0) break;
+        door_t *d = &s->door[di];
+        d->card = c->card_on;
+        if (c->card_on) {
+            memcpy(d->card_uid, c->uid, 4);
+            d->card_stim = stim_new(s, t, CRED_RFID, -1, di);
+            s->stim[d->card_stim].lost = LOST_UNREAD;
+            if (c->value) {
+                // Retirada automática: se reprograma como una orden "card -"
+                s->cmds = realloc(s->cmds, sizeof(vdev_cmd_t) * (size_t)(s->ncmds + 1));
+                c = &s->cmds[i];
+                s->cmds[s->ncmds] = (vdev_cmd_t){ .op = VDEV_OP_CARD, .pin = c->pin, .card_on = false, .at_ms = c->at_ms + c->value };
+                evq_push(&s->q, t + MS(c->value), EV_SCRIPT, s->ncmds++, 0);
+            }
+        } else {
+            d->card_stim = -1;
+        }
+        break;
+    }
+    case VDEV_OP_MQTT:
+        if (strcmp(c->topic, CMD_TOPIC) == 0 && (di = script_cmd_door(s, c->payload)) >= 0) {
+            int si = stim_new(s, t, CRED_REMOTE, -1, di);
+            evq_push(&s->q, t + MS(2), EV_MQTT_RX, si, 0);
+        }
+        break;
+    case VDEV_OP_EXIT:
+        evq_push(&s->q, t, EV_END, 0, 0);
+        break;
+    }
+}
+
+static int script_load(sim_t *s, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+    char buf[VDEV_LINE_MAX], err[96];
+    int64_t prev = 0;
+    int n = 0, lineno = 0;
+    while (fgets(buf, sizeof(buf), f)) {
+        lineno++;
+        s->lines = realloc(s->lines, sizeof(char *) * (size_t)(n + 1));
+        s->cmds = realloc(s->cmds, sizeof(vdev_cmd_t) * (size_t)(n + 1));
+        s->lines[n] = strdup(buf);
+        int r = vdev_parse_line(s->lines[n], prev, &s->cmds[n], err, sizeof(err));
+        if (r < 0) {
+            fprintf(stderr, "%s:%d: %s\n", path, lineno, err);
+            fclose(f);
+            return -1;
+        }
+        if (r == 0) { free(s->lines[n]); continue; }
+        s->nlines = n + 1;
+        prev = s->cmds[n].at_ms;
+        evq_push(&s->q, MS(prev), EV_SCRIPT, n, 0);
+        n++;
+    }
+    fclose(f);
+    s->ncmds = n;
+    s->sc.duration = n ? MS(s->cmds[n - 1].at_ms) : 0;
+    return n;
+}
+
+// ---- Montaje ----
+
+static policy_t *sim_policy(int ncards)
+{
+    size_t cap = 256 + (size_t)ncards * 48;
+    char *json = malloc(cap);
+    int n = snprintf(json, cap, "{\"version\":1,\"groups\":[\"staff\"],\"combo\":[\"staff\"],\"remote\":[\"staff\"],"
+                                "\"rules\":[{\"groups\":[\"staff\"],\"days\":\"all\"}],\"credentials\":[");
+    for (int i = 0; i < ncards; ++i) {
+        n += snprintf(json + n, cap - (size_t)n, "%s{\"uid\":\"%08X\",\"groups\":[\"staff\"]}", i ? "," : "", 0x10000000u + (unsigned)i);
+    }
+    n += snprintf(json + n, cap - (size_t)n, ",{\"uid\":\"EAE8D284\",\"groups\":[\"staff\"]}]}");
+    char err[64];
+    policy_t *p = policy_compile(json, (size_t)n, err, sizeof(err));
+    if (!p) fprintf(stderr, "política no válida: %s\n", err);
+    free(json);
+    return p;
+}
+
+static void sim_init(sim_t *s, const scen_t *sc, policy_t *pol)
+{
+    memset(s, 0, sizeof(*s));
+    s->sc = *sc;
+    s->pol = pol;
+    s->ndoors = sc->doors;
+    s->pot_user = -1;
+    s->pot_last_set = -1;
+    s->broker = true;
+    fusion_cfg_t fc = {
+        .rule = sc->rule,
+        .window_us = MS(CRED_WINDOW_MS),
+        .bypass_mask = (sc->rule == FUSION_RULE_2_OF_3) ? 0 : (1u << CRED_REMOTE),
+    };
+    for (int i = 0; i < s->ndoors; ++i) {
+        door_t *d = &s->door[i];
+        d->card_stim = -1;
+        d->locked_hw = true;
+        door_debounce_init(&d->db, DEBOUNCE_MS, 0);
+        deadline_set_init(&d->dl);
+        cred_queue_init(&d->cq);
+        fusion_init(&d->fusion, &fc);
+        access_fsm_init(&d->fsm, true);
+    }
+    pot_capture_cfg_t pc = {
+        .filter_alpha = 0.15f,
+        .adc_max_raw = 4095,
+        .deadzone_raw = 80,
+        .invert = true,
+        .settle = {
+            .mode = POT_SETTLE_MODE_VARIANCE,
+            .window = 5,
+            .z = 2.0f,
+            .max_slope = 15.0f,
+            .horizon = 1.0f / 0.15f,
+            .min_hold_ms = 900,
+            .max_hold_ms = 2000,
+        },
+        .combo_len = 3,
+        .combo_target = { COMBO[0], COMBO[1], COMBO[2] },
+    };
+    pot_capture_init(&s->pot, &pc);
+    s->pot_from = s->pot_to = digit_raw(&pc, 0);
+    evq_push(&s->q, MS(7) + sc->reader_us, EV_RFID_POLL, 0, 0);
+    evq_push(&s->q, MS(3), EV_POT_POLL, 0, 0);
+}
+
+static void sim_free(sim_t *s)
+{
+    for (int i = 0; i < s->nlines; ++i) free(s->lines[i]);
+    free(s->lines);
+    free(s->cmds);
+    free(s->q.h);
+    free(s->stim);
+    free(s->pp);
+    free(s->pot_wait);
+    free(s->granted);
+    for (int i = 0; i < s->ndoors; ++i) {
+        free(s->door[i].seq_stim);
+        free(s->door[i].walkers);
+        free(s->door[i].pend);
+    }
+}
+
+// Llegadas y condiciones del escenario generado: un flujo de personas por
+// puerta; la combinación solo se marca en la del panel (en las demás, tarjeta)
+static void sim_populate(sim_t *s)
+{
+    const scen_t *sc = &s->sc;
+    for (int di = 0; di < s->ndoors; ++di) {
+        int64_t t = S(1) + (sc->period ? sc->period * di / s->ndoors : 0);
+        while (t < sc->duration) {
+            s->pp = grow(s->pp, &s->pp_cap, s->npp + 1, sizeof(person_t));
+            person_t *p = &s->pp[s->npp];
+            double u = urand();
+            p->method = u < sc->p_combo ? CRED_COMBO : u < sc->p_combo + sc->p_remote ? CRED_REMOTE : CRED_RFID;
+            if (p->method == CRED_COMBO && di != PANEL_DOOR) p->method = CRED_RFID;
+            p->door = (uint8_t)di;
+            p->valid = urand() >= sc->p_invalid;
+            p->tailgate = urand() < sc->p_tailgate;
+            uint32_t uid = p->valid ? 0x10000000u + (uint32_t)(urand() * 500) : 0xB0000000u + (uint32_t)(urand() * 1e6);
+            for (int k = 0; k < 4; ++k) p->uid[k] = (uint8_t)(uid >> (24 - 8 * k));
+            p->stim = p->combo = -1;
+            evq_push(&s->q, t, EV_ARRIVE, s->npp++, 0);
+            t += sc->period ? (int64_t)(sc->period * (0.8 + 0.4 * urand())) : exp_us((double)sc->mean_gap);
+        }
+    }
+    if (sc->prop_to > sc->prop_from) {
+        evq_push_door(&s->q, sc->prop_from, EV_PROP, 1, 0, PANEL_DOOR);
+        evq_push_door(&s->q, sc->prop_to, EV_PROP, 0, 0, PANEL_DOOR);
+    }
+    if (sc->broker_up) {
+        for (int64_t b = sc->broker_up; b < sc->duration; b += sc->broker_up + sc->broker_down) {
+            evq_push(&s->q, b, EV_BROKER, 0, 0);
+            evq_push(&s->q, b + sc->broker_down, EV_BROKER, 1, 0);
+        }
+    } else if (sc->outage_mean_up > 0) {
+        for (int64_t b = exp_us(sc->outage_mean_up); b < sc->duration;) {
+            int64_t down = exp_us(sc->outage_mean_down);
+            evq_push(&s->q, b, EV_BROKER, 0, 0);
+            evq_push(&s->q, b + down, EV_BROKER, 1, 0);
+            b += down + exp_us(sc->outage_mean_up);
+        }
+    }
+}
+
+static void sim_run(sim_t *s)
+{
+    clock_t c0 = clock();
+    // Margen tras la última llegada para que todo se resuelva
+    int64_t end = s->sc.duration + S(60);
+    evq_push(&s->q, end, EV_END, 0, 0);
+    while (s->q.n && !s->ended) {
+        ev_t e = evq_pop(&s->q);
+        s->t_now = e.t;
+        switch ((ev_kind_t)e.kind) {
+        case EV_ARRIVE:    ev_arrive(s, e.t, e.arg); break;
+        case EV_PERSON:    ev_person(s, &e); break;
+        case EV_CARD:      ev_card(s, &e); break;
+        case EV_EDGE:      ev_edge(s, e.door, e.t, e.arg); break;
+        case EV_DB_EXPIRE: if (e.gen == s->door[e.door].db_gen) ev_db_expire(s, e.door, e.t); break;
+        case EV_SCHED:     if (e.gen == s->door[e.door].sched_gen) ev_sched(s, e.door, e.t); break;
+        case EV_RFID_POLL: ev_rfid_poll(s, e.t, e.arg); break;
+        case EV_POT_POLL:  ev_pot_poll(s, e.t); break;
+        case EV_CTRL:      ev_ctrl(s, e.t); break;
+        case EV_MQTT_RX:   ev_mqtt_rx(s, e.t, e.arg); break;
+        case EV_BROKER:    s->broker = e.arg != 0; break;
+        case EV_PROP: {
+            door_t *d = &s->door[e.door];
+            d->propped = e.arg != 0;
+            if (d->propped) door_set(s, e.door, e.t, true);
+            else if (e.t >= d->close_at) door_set(s, e.door, e.t, false);
+            break;
+        }
+        case EV_SCRIPT:    ev_script(s, e.t, e.arg); break;
+        case EV_END:
+            s->ended = true;
+            s->st.vtime = e.t;
+            break;
+        }
+    }
+    if (!s->ended) s->st.vtime = s->t_now;
+    for (int i = 0; i < s->ndoors; ++i) {
+        s->st.edges += s->door[i].db.edges;
+        s->st.glitches += s->door[i].db.glitches;
+    }
+    s->st.wall = (double)(clock() - c0) / CLOCKS_PER_SEC;
+}
+
+// ---- Informe ----
+
+typedef struct {
+    int64_t *dec, *unl;
+    int ndec, nunl, cap_dec, cap_unl;
+    uint32_t stims, grants, denies, pending, waited, unserved;
+    uint32_t lost[LOST_COUNT];
+    stats_t st;
+    int runs;
+} report_t;
+
+static void report_add(report_t *r, const sim_t *s)
+{
+    for (int i = 0; i < s->nstim; ++i) {
+        const stim_t *x = &s->stim[i];
+        if (x->at >= s->st.vtime) { r->unserved++; continue; } // Aún en la cola del lector
+        r->stims++;
+        if (x->outcome == OUT_NONE) {
+            r->lost[x->lost ? x->lost : LOST_OTHER]++;
+            continue;
+        }
+        if (x->outcome == OUT_PENDING) { r->pending++; continue; }
+        if (x->outcome == OUT_DENY) r->denies++;
+        else r->grants++;
+        r->dec = grow(r->dec, &r->cap_dec, r->ndec + 1, sizeof(int64_t));
+        r->dec[r->ndec++] = x->decided - x->at;
+        if (x->outcome != OUT_GRANT) continue;
+        if (x->waited) { r->waited++; continue; }
+        if (x->unlocked >= 0) {
+            r->unl = grow(r->unl, &r->cap_unl, r->nunl + 1, sizeof(int64_t));
+            r->unl[r->nunl++] = x->unlocked - x->at;
+        }
+    }
+    const stats_t *a = &s->st;
+    stats_t *b = &r->st;
+    b->ctrl_q_full += a->ctrl_q_full;
+    if (a->ctrl_q_max > b->ctrl_q_max) b->ctrl_q_max = a->ctrl_q_max;
+    b->log_lines += a->log_lines;
+    b->log_bytes += a->log_bytes;
+    b->mqtt_pub += a->mqtt_pub;
+    b->mqtt_lost += a->mqtt_lost;
+    b->lock_open_logic += a->lock_open_logic;
+    b->lock_open_lag += a->lock_open_lag;
+    if (a->lock_open_lag_max > b->lock_open_lag_max) b->lock_open_lag_max = a->lock_open_lag_max;
+    b->blocked += a->blocked;
+    b->tailgates += a->tailgates;
+    b->passes += a->passes;
+    b->edges += a->edges;
+    b->glitches += a->glitches;
+    b->ctrl_busy += a->ctrl_busy;
+    b->vtime += a->vtime;
+    b->wall += a->wall;
+    r->runs++;
+}
+
+static void print_lat(const char *what, int64_t *v, int n)
+{
+    if (!n) {
+        printf("  %-24s %7s\n", what, "-");
+        return;
+    }
+    qsort(v, (size_t)n, sizeof(int64_t), cmp_i64);
+    printf("  %-24s %7d %9.1f %9.1f %9.1f %9.1f\n", what, n,
+           pct_ms(v, n, 0.50), pct_ms(v, n, 0.90), pct_ms(v, n, 0.99), v[n - 1] / 1000.0);
+}
+
+static void report_print(report_t *r, const char *name)
+{
+    const stats_t *st = &r->st;
+    double hours = st->vtime / 3.6e9;
+    printf("[%s] %d ejecución(es), %.2f h virtuales en %.2f s (%.0fx tiempo real)\n", name, r->runs, hours,
+           st->wall, st->wall > 0 ? st->vtime / 1e6 / st->wall : 0.0);
+    printf("  credenciales: %u presentadas, %u concedidas, %u denegadas, %u factores sin completar, %u con la puerta abierta\n",
+           r->stims, r->grants, r->denies, r->pending, r->waited);
+    if (r->unserved) printf("  %u personas aún en la cola del lector al terminar (llegadas más rápidas que el lector)\n", r->unserved);
+    printf("  %-24s %7s %9s %9s %9s %9s\n", "latencia", "n", "p50 ms", "p90 ms", "p99 ms", "máx ms");
+    print_lat("presentación->decisión", r->dec, r->ndec);
+    print_lat("presentación->relé", r->unl, r->nunl);
+    uint32_t lost = 0;
+    for (int k = 1; k < LOST_COUNT; ++k) lost += r->lost[k];
+    printf("  perdidas: %u", lost);
+    for (int k = 1; k < LOST_COUNT; ++k) if (r->lost[k]) printf(", %s %u", LOST_NAMES[k], r->lost[k]);
+    printf(" (g_ctrl_q llena %u veces, máx %u de %d)\n", st->ctrl_q_full, st->ctrl_q_max, CTRL_QUEUE_LEN);
+    printf("  log: %u eventos, %.1f KB en SPIFFS (%.1f KB/día); MQTT %u publicados, %u sin broker\n",
+           st->log_lines, st->log_bytes / 1024.0, hours > 0 ? st->log_bytes / 1024.0 / hours * 24 : 0.0,
+           st->mqtt_pub, st->mqtt_lost);
+    printf("  puerta: %u pasos, %u bloqueados con la cerradura echada, %u detrás de otro; reed %u flancos, %u glitches\n",
+           st->passes, st->blocked, st->tailgates, st->edges, st->glitches);
+    printf("  control_task ocupada %.2f %%\n", st->vtime ? 100.0 * st->ctrl_busy / st->vtime : 0.0);
+    printf("  seguridad: cierres con la puerta abierta: lógica %u, dentro del anti-rebote %u (máx %.1f ms tras abrir)\n",
+           st->lock_open_logic, st->lock_open_lag, st->lock_open_lag_max / 1000.0);
+    check(st->lock_open_logic == 0, "la FSM cerró con la puerta abierta");
+    free(r->dec);
+    free(r->unl);
+}
+
+// Ejecuta el escenario runs veces con semillas consecutivas y acumula en r
+static int run_runs(const scen_t *sc, int runs, unsigned seed, policy_t *pol, report_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    for (int i = 0; i < runs; ++i) {
+        g_rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)(seed + (unsigned)i) * 0xD1B54A32D192ED03ULL);
+        if (!g_rng) g_rng = 1;
+        static sim_t s;
+        sim_init(&s, sc, pol);
+        if (sc->script) {
+            if (script_load(&s, sc->script) < 0) { sim_free(&s); return -1; }
+        } else {
+            sim_populate(&s);
+        }
+        sim_run(&s);
+        report_add(r, &s);
+        // Contabilidad de cred_queue: todo lo encolado se consumió
+        for (int k = 0; k < s.ndoors; ++k) {
+            const cred_queue_t *q = &s.door[k].cq;
+            check(q->st.pushed[0] + q->st.pushed[1] == q->st.popped[0] + q->st.popped[1], "credenciales encoladas sin consumir");
+        }
+        sim_free(&s);
+    }
+    return 0;
+}
+
+static int run_scenario(const scen_t *sc, int runs, unsigned seed, policy_t *pol)
+{
+    report_t r;
+    if (run_runs(sc, runs, seed, pol, &r) < 0) return -1;
+    report_print(&r, sc->name);
+    return 0;
+}
+
+// --sweep: el escenario con 1..sc->doors puertas; una fila por número de
+// puertas y el máximo que mantiene el p99 presentación -> relé en target
+static void run_sweep(const scen_t *sc, int runs, unsigned seed, policy_t *pol, int64_t target)
+{
+    printf("[%s] barrido de puertas, objetivo p99 presentación->relé < %.0f ms\n", sc->name, target / 1000.0);
+    printf("  %7s %7s %9s %9s %9s %9s %10s %9s\n", "puertas", "n", "p50 ms", "p99 ms", "máx ms", "control %", "perdidas %", "cola máx");
+    int best = 0;
+    for (int n = 1; n <= sc->doors; ++n) {
+        scen_t one = *sc;
+        one.doors = n;
+        report_t r;
+        run_runs(&one, runs, seed, pol, &r);
+        uint32_t lost = 0;
+        for (int k = 1; k < LOST_COUNT; ++k) lost += r.lost[k];
+        double p50 = 0, p99 = 0, max = 0;
+        if (r.nunl) {
+            qsort(r.unl, (size_t)r.nunl, sizeof(int64_t), cmp_i64);
+            p50 = pct_ms(r.unl, r.nunl, 0.50);
+            p99 = pct_ms(r.unl, r.nunl, 0.99);
+            max = r.unl[r.nunl - 1] / 1000.0;
+        }
+        printf("  %7d %7d %9.1f %9.1f %9.1f %9.2f %10.1f %6u/%d\n", n, r.nunl, p50, p99, max,
+               r.st.vtime ? 100.0 * r.st.ctrl_busy / r.st.vtime : 0.0, r.stims ? 100.0 * lost / r.stims : 0.0,
+               r.st.ctrl_q_max, CTRL_QUEUE_LEN);
+        check(r.st.lock_open_logic == 0, "la FSM cerró con la puerta abierta");
+        if (r.nunl && p99 < target / 1000.0 && best == n - 1) best = n;
+        free(r.dec);
+        free(r.unl);
+    }
+    printf("  %d puerta(s) dentro del objetivo\n", best);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones]\n"
+            "  --scenario X     shift | held | flap | mix | all (all)\n"
+            "  --runs N         ejecuciones por escenario con semillas consecutivas (1)\n"
+            "  --seed S         semilla inicial (1)\n"
+            "  --period MS      shift/held: una pasada cada MS (1000)\n"
+            "  --minutes M      shift/held/flap: duración (30)\n"
+            "  --hours H        mix: duración (24)\n"
+            "  --rate N         mix: personas por hora (60)\n"
+            "  --ctrl-us US     control_task por evento: política + FSM (300)\n"
+            "  --log-us US      log_event: append en SPIFFS (6000)\n"
+            "  --rule R         any | and (any, como ACCESS_MODE_OR; con and cada tarjeta va seguida de la combinación)\n"
+            "  --doors N        puertas en el controlador, 1..%d (1)\n"
+            "  --reader-us US   rfid_task: sondeo de un lector (15000; 55000 con el driver que esperaba el timeout)\n"
+            "  --sweep          repite el escenario con 1..N puertas\n"
+            "  --target-ms MS   --sweep: objetivo del p99 presentación->relé (500)\n"
+            "  --script FILE    guion con el formato de main/hal_vdev.h\n"
+            "  -v               transiciones de la FSM y cierres con la puerta abierta\n",
+            argv0, SIM_DOORS_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    const char *which = "all", *script = NULL;
+    int runs = 1, minutes = 30, hours = 24, rate = 60, doors = 1;
+    unsigned seed = 1;
+    int64_t period = MS(1000), ctrl_us = 300, log_us = 6000, reader_us = 15000, target = MS(500);
+    bool sweep = false;
+    fusion_rule_t rule = FUSION_RULE_ANY;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "-v")) { g_verbose = true; continue; }
+        if (!strcmp(a, "--sweep")) { sweep = true; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--scenario")) which = v;
+        else if (!strcmp(a, "--runs")) runs = atoi(v);
+        else if (!strcmp(a, "--seed")) seed = arg_seed(v);
+        else if (!strcmp(a, "--period")) period = MS(atoi(v));
+        else if (!strcmp(a, "--minutes")) minutes = atoi(v);
+        else if (!strcmp(a, "--hours")) hours = atoi(v);
+        else if (!strcmp(a, "--rate")) rate = atoi(v);
+        else if (!strcmp(a, "--ctrl-us")) ctrl_us = atoi(v);
+        else if (!strcmp(a, "--log-us")) log_us = atoi(v);
+        else if (!strcmp(a, "--script")) script = v;
+        else if (!strcmp(a, "--doors")) doors = atoi(v);
+        else if (!strcmp(a, "--reader-us")) reader_us = atoi(v);
+        else if (!strcmp(a, "--target-ms")) target = MS(atoi(v));
+        else if (!strcmp(a, "--rule")) {
+            if (!strcmp(v, "and")) rule = FUSION_RULE_RFID_PIN;
+            else if (!strcmp(v, "any")) rule = FUSION_RULE_ANY;
+            else { usage(argv[0]); return 2; }
+        } else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (runs < 1 || minutes < 1 || hours < 1 || rate < 1 || period < MS(10) || doors < 1 || doors > SIM_DOORS_MAX ||
+        reader_us < 0 || target <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (doors > 1 && rule == FUSION_RULE_RFID_PIN) {
+        // El potenciómetro es de la puerta del panel: AND solo tiene sentido allí
+        fprintf(stderr, "--rule and necesita --doors 1 (la combinación solo se marca en el panel)\n");
+        return 2;
+    }
+
+    policy_t *pol = sim_policy(500);
+    if (!pol) return 1;
+    const scen_t base = { .ctrl_us = ctrl_us, .log_us = log_us, .reader_us = reader_us, .doors = doors, .rule = rule };
+    printf("access_sim: regla %s, control %lld us + log %lld us, anti-rebote %d ms, re-bloqueo %d ms, desbloqueo máx %d ms\n",
+           fusion_rule_name(rule), (long long)ctrl_us, (long long)log_us, DEBOUNCE_MS, RELOCK_MS, UNLOCK_MAX_MS);
+    printf("  %d puerta(s), sondeo de lector %lld us\n", doors, (long long)reader_us);
+
+    if (script) {
+        scen_t sc = base;
+        sc.name = script;
+        sc.script = script;
+        if (run_scenario(&sc, 1, seed, pol) < 0) { policy_free(pol); return 2; }
+        policy_free(pol);
+        return g_fail ? 1 : 0;
+    }
+
+    bool all = !strcmp(which, "all");
+    if (all || !strcmp(which, "shift")) {
+        scen_t sc = base;
+        sc.name = "shift";
+        sc.duration = S(60) * minutes;
+        sc.period = period;
+        sc.p_remote = 0.03;
+        sc.p_invalid = 0.05;
+        sc.p_tailgate = 0.10;
+        sweep ? run_sweep(&sc, runs, seed, pol, target) : (void)run_scenario(&sc, runs, seed, pol);
+    }
+    if (all || !strcmp(which, "held")) {
+        scen_t sc = base;
+        sc.name = "held";
+        sc.duration = S(60) * minutes;
+        sc.period = period * 3;
+        sc.p_invalid = 0.05;
+        sc.p_tailgate = 0.20;
+        sc.prop_from = sc.duration / 2 - S(150);
+        sc.prop_to = sc.duration / 2 + S(150);
+        sweep ? run_sweep(&sc, runs, seed, pol, target) : (void)run_scenario(&sc, runs, seed, pol);
+    }
+    if (all || !strcmp(which, "flap")) {
+        scen_t sc = base;
+        sc.name = "flap";
+        sc.duration = S(60) * minutes;
+        sc.period = S(2);
+        sc.p_remote = 0.7;
+        sc.broker_up = S(20);
+        sc.broker_down = S(10);
+        sweep ? run_sweep(&sc, runs, seed, pol, target) : (void)run_scenario(&sc, runs, seed, pol);
+    }
+    if (all || !strcmp(which, "mix")) {
+        scen_t sc = base;
+        sc.name = "mix";
+        sc.duration = S(3600) * hours;
+        sc.mean_gap = S(3600) / rate;
+        sc.p_combo = 0.20;
+        sc.p_remote = 0.10;
+        sc.p_invalid = 0.05;
+        sc.p_tailgate = 0.02;
+        sc.outage_mean_up = 2 * 3.6e9;
+        sc.outage_mean_down = 120e6;
+        sweep ? run_sweep(&sc, runs, seed, pol, target) : (void)run_scenario(&sc, runs, seed, pol);
+    }
+    policy_free(pol);
+    return g_fail ? 1 : 0;
+}
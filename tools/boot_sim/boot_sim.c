@@ -0,0 +1,277 @@
+/*
+ * boot_sim: comprueba en host el grafo de arranque (main/boot_graph.c) y
+ * compara el arranque en serie original con el paralelo del firmware.
+ *
+ * 1) Comprobación (--check N): rechazo de grafos inválidos (ciclos,
+ *    dependencias inexistentes, crítico que depende de no crítico) y N grafos
+ *    aleatorios ejecutados con varios hilos: cada paso corre una sola vez y
+ *    nunca empieza antes de que terminen sus dependencias. Devuelve 1 ante la
+ *    primera violación.
+ *
+ * 2) Simulación: los pasos de app_main con duraciones aproximadas medidas en
+ *    placa (NVS, WiFi, montaje SPIFFS, LCD con su patrón de diagnóstico...)
+ *    como esperas reales, con el mismo bucle de trabajadores que main.c.
+ *    Informa cuándo queda lista la puerta en serie (orden antiguo) y con el
+ *    grafo. --format simula el primer arranque (SPIFFS se formatea).
+ *
+ * Compilar: make -C tools boot_sim   (binario en tools/build/)
+ * Ejemplo:  tools/build/boot_sim --check 2000 --workers 2 --scale 0.2
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "boot_graph.h"
+#include "tool_util.h"
+
+static uint32_t rnd(uint32_t n)
+{
+    return (uint32_t)(rng_step(&g_rng) >> 33) % n;
+}
+
+// ---------------------------------------------------------------------------
+// Ejecución con hilos: mismo protocolo que boot_worker_task en main.c
+// ---------------------------------------------------------------------------
+
+static boot_graph_t g_graph;
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cv = PTHREAD_COND_INITIALIZER;
+static int g_runs[BOOT_STEPS_MAX];
+static __thread int t_step = -1;       // Paso que ejecuta este hilo (run no lleva argumentos)
+static int64_t g_step_us[BOOT_STEPS_MAX];
+static double g_scale = 1.0;
+
+static void step_sleep(void)
+{
+    __atomic_add_fetch(&g_runs[t_step], 1, __ATOMIC_RELAXED);
+    int64_t us = (int64_t)(g_step_us[t_step] * g_scale);
+    if (us > 0) nanosleep(&(struct timespec){ us / 1000000, (us % 1000000) * 1000 }, NULL);
+}
+
+static void *worker(void *arg)
+{
+    uint8_t id = (uint8_t)(uintptr_t)arg;
+    pthread_mutex_lock(&g_mu);
+    for (;;) {
+        int i = boot_graph_claim(&g_graph, 0);
+        if (i < 0) {
+            if (!boot_graph_pending(&g_graph)) break;
+            pthread_cond_wait(&g_cv, &g_mu);
+            continue;
+        }
+        pthread_mutex_unlock(&g_mu);
+        t_step = i;
+        boot_graph_run(&g_graph, i, id, mono_us);
+        pthread_mutex_lock(&g_mu);
+        boot_graph_done(&g_graph, i);
+        pthread_cond_broadcast(&g_cv);
+    }
+    pthread_mutex_unlock(&g_mu);
+    return NULL;
+}
+
+// Crítico en el hilo principal y en orden; el resto con n trabajadores
+static void run_graph(int workers)
+{
+    int i;
+    while ((i = boot_graph_claim(&g_graph, BOOT_F_CRITICAL)) >= 0) {
+        t_step = i;
+        boot_graph_run(&g_graph, i, 0, mono_us);
+        boot_graph_done(&g_graph, i);
+    }
+    pthread_t th[16];
+    for (int w = 0; w < workers; ++w) pthread_create(&th[w], NULL, worker, (void *)(uintptr_t)(w + 1));
+    for (int w = 0; w < workers; ++w) pthread_join(th[w], NULL);
+}
+
+// ---------------------------------------------------------------------------
+// 1) Comprobación
+// ---------------------------------------------------------------------------
+
+static int check_invalid(void)
+{
+    boot_graph_t g;
+    const boot_step_t cycle[] = {
+        { "a", BOOT_DEP(2), 0, NULL }, { "b", BOOT_DEP(0), 0, NULL }, { "c", BOOT_DEP(1), 0, NULL },
+    };
+    const boot_step_t unknown[] = { { "a", 0, 0, NULL }, { "b", BOOT_DEP(5), 0, NULL } };
+    const boot_step_t inverted[] = { { "fs", 0, 0, NULL }, { "lock", BOOT_DEP(0), BOOT_F_CRITICAL, NULL } };
+    const boot_step_t ok[] = { { "lock", 0, BOOT_F_CRITICAL, NULL }, { "fs", BOOT_DEP(0), 0, NULL } };
+    boot_step_t many[BOOT_STEPS_MAX + 1];
+    memset(many, 0, sizeof(many));
+    int bad = 0;
+    bad += boot_graph_init(&g, cycle, 3, 0);
+    bad += boot_graph_init(&g, unknown, 2, 0);
+    bad += boot_graph_init(&g, inverted, 2, 0);
+    bad += boot_graph_init(&g, many, BOOT_STEPS_MAX + 1, 0);
+    bad += !boot_graph_init(&g, ok, 2, 0);
+    if (bad) printf("check: %d grafos mal clasificados\n", bad);
+    return bad;
+}
+
+static int check_random(int iters, int workers)
+{
+    static boot_step_t steps[BOOT_STEPS_MAX];
+    static char names[BOOT_STEPS_MAX][8];
+    g_scale = 1.0;
+    for (int it = 0; it < iters; ++it) {
+        int n = 1 + (int)rnd(BOOT_STEPS_MAX);
+        int ncrit = (int)rnd((uint32_t)n + 1);   // Los primeros ncrit son críticos
+        for (int i = 0; i < n; ++i) {
+            uint32_t deps = 0;
+            // Solo hacia atrás (sin ciclos): un crítico solo ve críticos
+            for (int d = 0; d < i; ++d) {
+                if (rnd(4) == 0) deps |= BOOT_DEP(d);
+            }
+            snprintf(names[i], sizeof(names[i]), "s%d", i);
+            steps[i] = (boot_step_t){ names[i], deps, (uint8_t)(i < ncrit ? BOOT_F_CRITICAL : 0), step_sleep };
+            g_step_us[i] = rnd(300);
+        }
+        // Barajar los índices para que el orden de declaración no sea topológico
+        int perm[BOOT_STEPS_MAX];
+        for (int i = 0; i < n; ++i) perm[i] = i;
+        for (int i = n - 1; i > 0; --i) {
+            int j = (int)rnd((uint32_t)i + 1), t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+        }
+        boot_step_t shuf[BOOT_STEPS_MAX];
+        int64_t dur[BOOT_STEPS_MAX];
+        for (int i = 0; i < n; ++i) {
+            shuf[perm[i]] = steps[i];
+            uint32_t deps = 0;
+            for (int d = 0; d < n; ++d) if (steps[i].deps & BOOT_DEP(d)) deps |= BOOT_DEP(perm[d]);
+            shuf[perm[i]].deps = deps;
+            dur[perm[i]] = g_step_us[i];
+        }
+        memcpy(steps, shuf, sizeof(shuf[0]) * (size_t)n);
+        memcpy(g_step_us, dur, sizeof(dur[0]) * (size_t)n);
+        memset(g_runs, 0, sizeof(g_runs));
+
+        if (!boot_graph_init(&g_graph, steps, (size_t)n, mono_us())) {
+            printf("check: grafo válido rechazado (it %d)\n", it);
+            return 1;
+        }
+        run_graph(workers);
+        if (!boot_graph_finished(&g_graph)) {
+            printf("check: grafo sin terminar (it %d)\n", it);
+            return 1;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (g_runs[i] != 1) {
+                printf("check: %s ejecutado %d veces (it %d)\n", steps[i].name, g_runs[i], it);
+                return 1;
+            }
+            for (int d = 0; d < n; ++d) {
+                if ((steps[i].deps & BOOT_DEP(d)) && g_graph.marks[i].start_us < g_graph.marks[d].end_us) {
+                    printf("check: %s empezó antes de acabar %s (it %d)\n", steps[i].name, steps[d].name, it);
+                    return 1;
+                }
+            }
+            if ((steps[i].flags & BOOT_F_CRITICAL) && g_graph.marks[i].worker != 0) {
+                printf("check: crítico %s fuera del hilo principal (it %d)\n", steps[i].name, it);
+                return 1;
+            }
+        }
+    }
+    printf("check: %d grafos aleatorios con %d trabajadores, orden y unicidad correctos\n", iters, workers);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 2) Simulación del arranque del firmware
+// ---------------------------------------------------------------------------
+
+// Mismo grafo que BOOT_STEPS en main/main.c (duraciones en us)
+enum {
+    BOOT_NVS = 0, BOOT_LOCK, BOOT_CORE, BOOT_DOOR, BOOT_CONTROL,
+    BOOT_POT, BOOT_RFID, BOOT_LCD, BOOT_NET, BOOT_FS, BOOT_POLICY, BOOT_MQTT, BOOT_COUNT
+};
+
+static const boot_step_t k_fw[BOOT_COUNT] = {
+    [BOOT_NVS]     = { "nvs",     0,                                         BOOT_F_CRITICAL, step_sleep },
+    [BOOT_LOCK]    = { "lock",    BOOT_DEP(BOOT_NVS),                        BOOT_F_CRITICAL, step_sleep },
+    [BOOT_CORE]    = { "core",    0,                                         BOOT_F_CRITICAL, step_sleep },
+    [BOOT_DOOR]    = { "door",    BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),  BOOT_F_CRITICAL, step_sleep },
+    [BOOT_CONTROL] = { "control", BOOT_DEP(BOOT_LOCK) | BOOT_DEP(BOOT_DOOR), BOOT_F_CRITICAL, step_sleep },
+    [BOOT_POT]     = { "pot",     BOOT_DEP(BOOT_NVS),                        0, step_sleep },
+    [BOOT_RFID]    = { "rfid",    BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),  0, step_sleep },
+    [BOOT_LCD]     = { "lcd",     BOOT_DEP(BOOT_NVS) | BOOT_DEP(BOOT_CORE),  0, step_sleep },
+    [BOOT_NET]     = { "net",     BOOT_DEP(BOOT_NVS),                        0, step_sleep },
+    [BOOT_FS]      = { "fs",      0,                                         0, step_sleep },
+    [BOOT_POLICY]  = { "policy",  BOOT_DEP(BOOT_FS) | BOOT_DEP(BOOT_CONTROL), 0, step_sleep },
+    [BOOT_MQTT]    = { "mqtt",    BOOT_DEP(BOOT_NET) | BOOT_DEP(BOOT_POLICY), 0, step_sleep },
+};
+
+static const int64_t k_fw_us[BOOT_COUNT] = {
+    [BOOT_NVS] = 12000, [BOOT_LOCK] = 300, [BOOT_CORE] = 400, [BOOT_DOOR] = 600, [BOOT_CONTROL] = 900,
+    [BOOT_NET] = 180000, [BOOT_FS] = 60000, [BOOT_POLICY] = 25000, [BOOT_MQTT] = 4000,
+    [BOOT_LCD] = 2850000,   // 120 ms + secuencia de init + patrón de diagnóstico (2,7 s)
+    [BOOT_POT] = 500, [BOOT_RFID] = 300,
+};
+#define FS_FORMAT_US 9000000   // Formateo de la partición en el primer arranque
+
+// Orden de app_main antes del grafo: la puerta quedaba lista al final
+static const int k_serial_order[] = {
+    BOOT_NVS, BOOT_NET, BOOT_MQTT, BOOT_CORE, BOOT_LOCK, BOOT_FS, BOOT_POLICY,
+    BOOT_DOOR, BOOT_POT, BOOT_LCD, BOOT_CONTROL, BOOT_RFID,
+};
+
+static int simulate(int workers, bool format)
+{
+    memcpy(g_step_us, k_fw_us, sizeof(k_fw_us));
+    if (format) g_step_us[BOOT_FS] = FS_FORMAT_US;
+    int64_t serial_door = 0;
+    for (size_t k = 0; k < sizeof(k_serial_order) / sizeof(k_serial_order[0]); ++k) {
+        serial_door += g_step_us[k_serial_order[k]];
+        if (k_serial_order[k] == BOOT_CONTROL) break;
+    }
+    memset(g_runs, 0, sizeof(g_runs));
+    if (!boot_graph_init(&g_graph, k_fw, BOOT_COUNT, mono_us())) {
+        printf("sim: grafo del firmware inválido\n");
+        return 1;
+    }
+    run_graph(workers);
+
+    char buf[2048];
+    boot_graph_report(&g_graph, buf, sizeof(buf));
+    double s = g_scale;
+    printf("sim: %d trabajadores, escala %.2f%s\n", workers, s, format ? ", SPIFFS formateando" : "");
+    for (int i = 0; i < BOOT_COUNT; ++i) {
+        const boot_mark_t *m = &g_graph.marks[i];
+        printf("  %-8s w%u %9.1f .. %9.1f ms%s\n", k_fw[i].name, (unsigned)m->worker,
+               (m->start_us - g_graph.t0_us) / s / 1000.0, (m->end_us - g_graph.t0_us) / s / 1000.0,
+               (k_fw[i].flags & BOOT_F_CRITICAL) ? "  [crítico]" : "");
+    }
+    int64_t crit = boot_graph_span_us(&g_graph, BOOT_F_CRITICAL);
+    printf("  puerta lista: %.1f ms (antes, en serie: %.1f ms)\n", crit / s / 1000.0, serial_door / 1000.0);
+    printf("  todo listo:   %.1f ms (suma en serie: %.1f ms)\n",
+           boot_graph_span_us(&g_graph, 0) / s / 1000.0, boot_graph_serial_us(&g_graph) / s / 1000.0);
+    printf("  informe: %s\n", buf);
+    return crit / s > 100000 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int iters = 0, workers = 2;
+    bool format = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--check") && i + 1 < argc) iters = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--workers") && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--scale") && i + 1 < argc) g_scale = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--format")) format = true;
+        else {
+            fprintf(stderr, "uso: %s [--check N] [--workers N] [--scale F] [--format]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (workers < 1 || workers > 16 || g_scale <= 0) return 2;
+
+    if (check_invalid()) return 1;
+    double scale = g_scale;
+    if (iters > 0 && check_random(iters, workers)) return 1;
+    g_scale = scale;
+    return simulate(workers, format);
+}
@@ -0,0 +1,452 @@
+/*
+ * cfg_reload: prueba en host de la configuración de ejecución
+ * (main/app_config.c) con un backend en memoria en lugar de NVS.
+ *
+ * 1. Esquema: arranque con NVS vacía (todo de fábrica), con valores
+ *    guardados, con un valor fuera de rango y con un campo ausente;
+ *    parches inválidos o con claves desconocidas no tocan nada.
+ * 2. Coste: carga de arranque (todas las claves presentes), parche JSON
+ *    completo (parseo + escritura + publicación) y lectura fijada
+ *    (cfg_acquire + campo + cfg_release).
+ * 3. Recarga en caliente: N lectores (pthreads) leen la instantánea sin
+ *    cerrojos mientras un escritor publica cambios; cada instantánea tiene
+ *    todos sus campos derivados del mismo k, así que un lector que viera
+ *    una reescrita mientras la tenía fijada lo detecta. Con --hold-us
+ *    algunos lectores retienen la instantánea (tarea expulsada) y el
+ *    escritor debe esquivarla o responder BUSY.
+ *    Mide la latencia publicación -> primer lector que ve la generación.
+ *
+ * Compilar: make -C tools cfg_reload   (binario en tools/build/)
+ * Ejemplo:  tools/build/cfg_reload --readers 8 --seconds 2 --nvs-us 3000 --hold-us 5000
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_config.h"
+#include "tool_util.h"
+
+static int g_readers = 4;
+static double g_seconds = 2.0;
+static long g_period_us = 200;   // Intervalo entre cambios
+static long g_hold_us = 0;       // Retención ocasional de un lector
+static long g_nvs_us = 0;        // Coste simulado de cada commit en flash
+
+static void sleep_us(long us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+// ---------------------------------------------------------------------------
+// Backend en memoria (imita nvs_get_* / nvs_set_* / nvs_commit)
+
+#define MEM_KEYS 64
+
+typedef struct {
+    char key[16];
+    bool is_str;
+    int32_t i32;
+    char str[128];
+} mem_entry_t;
+
+typedef struct {
+    mem_entry_t e[MEM_KEYS];
+    int n;
+    long writes;
+    long commits;
+} mem_nvs_t;
+
+static mem_entry_t *mem_find(mem_nvs_t *m, const char *key, bool create)
+{
+    for (int i = 0; i < m->n; ++i) {
+        if (strcmp(m->e[i].key, key) == 0) return &m->e[i];
+    }
+    if (!create || m->n == MEM_KEYS) return NULL;
+    mem_entry_t *e = &m->e[m->n++];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    return e;
+}
+
+static bool mem_get_i32(void *ctx, const char *key, int32_t *out)
+{
+    mem_entry_t *e = mem_find(ctx, key, false);
+    if (!e || e->is_str) return false;
+    *out = e->i32;
+    return true;
+}
+
+static bool mem_set_i32(void *ctx, const char *key, int32_t v)
+{
+    mem_entry_t *e = mem_find(ctx, key, true);
+    if (!e) return false;
+    e->is_str = false;
+    e->i32 = v;
+    ((mem_nvs_t *)ctx)->writes++;
+    return true;
+}
+
+static bool mem_get_str(void *ctx, const char *key, char *out, size_t cap)
+{
+    mem_entry_t *e = mem_find(ctx, key, false);
+    if (!e || !e->is_str || strlen(e->str) >= cap) return false;
+    strcpy(out, e->str);
+    return true;
+}
+
+static bool mem_set_str(void *ctx, const char *key, const char *v)
+{
+    mem_entry_t *e = mem_find(ctx, key, true);
+    if (!e || strlen(v) >= sizeof(e->str)) return false;
+    e->is_str = true;
+    strcpy(e->str, v);
+    ((mem_nvs_t *)ctx)->writes++;
+    return true;
+}
+
+static bool mem_commit(void *ctx)
+{
+    ((mem_nvs_t *)ctx)->commits++;
+    if (g_nvs_us) sleep_us(g_nvs_us);
+    return true;
+}
+
+static mem_nvs_t g_nvs;
+static const cfg_backend_t g_be = {
+    .ctx = &g_nvs,
+    .get_i32 = mem_get_i32, .set_i32 = mem_set_i32,
+    .get_str = mem_get_str, .set_str = mem_set_str,
+    .commit = mem_commit,
+};
+
+// ---------------------------------------------------------------------------
+
+static app_cfg_t factory(void)
+{
+    app_cfg_t c;
+    memset(&c, 0, sizeof(c));
+    strcpy(c.wifi_ssid, "factory-ssid");
+    strcpy(c.wifi_pass, "factory-pass");
+    strcpy(c.mqtt_uri, "mqtt://192.168.3.213:1883");
+    strcpy(c.combo, "364");
+    c.unlock_max_ms = 10000;
+    c.relock_ms = 1000;
+    c.pot_settle_ms = 2000;
+    c.lcd_idle_ms = 5000;
+    c.twin_min_ms = 100;
+    c.power = 1;
+    c.pins = (cfg_pins_t){ .lock = 25, .door = 33, .buzzer = 26, .led_status = 14, .led_green = 12,
+                           .led_red = 27, .pot = 34, .i2c_sda = 21, .i2c_scl = 22, .rfid_cs = 5,
+                           .rfid_sck = 18, .rfid_mosi = 23, .rfid_miso = 19, .rfid_rst = 13 };
+    return c;
+}
+
+// Reloj fijo para las pruebas de un solo hilo (solo sella published_us)
+static int64_t fake_now(void)
+{
+    return 0;
+}
+
+// Copia de la vigente (pruebas de un solo hilo)
+static app_cfg_t snap(cfg_store_t *s)
+{
+    const app_cfg_t *c = cfg_acquire(s);
+    app_cfg_t copy = *c;
+    cfg_release(s, c);
+    return copy;
+}
+
+static void schema_checks(void)
+{
+    static cfg_store_t s;
+    app_cfg_t def = factory();
+    cfg_load_report_t rep;
+
+    memset(&g_nvs, 0, sizeof(g_nvs));
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.stored_schema == 0 && rep.defaulted == cfg_field_count, "NVS vacía: todo de fábrica");
+    check(snap(&s).unlock_max_ms == 10000 && snap(&s).gen == 1, "NVS vacía: instantánea inicial");
+
+    uint64_t changed;
+    char err[96];
+    const char *patch = "{\"combo\":\"1234\",\"unlock_max_ms\":8000,\"pin_lock\":4}";
+    cfg_err_t e = cfg_update_json(&s, patch, strlen(patch), &changed, err, sizeof(err));
+    check(e == CFG_OK && snap(&s).unlock_max_ms == 8000 && !strcmp(snap(&s).combo, "1234"),
+          "parche válido aplicado");
+    check(cfg_changed_with_flag(changed, CFG_F_REBOOT), "cambio de pin marcado como reinicio");
+    check(snap(&s).gen == 2, "parche: generación nueva");
+
+    long writes = g_nvs.writes;
+    const char *bad[] = {
+        "{\"unlock_max_ms\":5}", "{\"combo\":\"12a\"}", "{\"nope\":1}", "{\"relock_ms\":\"100\"}",
+        "{\"unlock_max_ms\":1e12}", "[1,2]", "{",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        e = cfg_update_json(&s, bad[i], strlen(bad[i]), &changed, err, sizeof(err));
+        check(e == CFG_ERR_PARSE && err[0], "parche inválido rechazado");
+    }
+    check(g_nvs.writes == writes && snap(&s).gen == 2, "parches inválidos no tocan NVS ni la instantánea");
+    e = cfg_update_json(&s, "{\"relock_ms\":1000}", 18, &changed, err, sizeof(err));
+    check(e == CFG_OK && changed == 0 && snap(&s).gen == 2, "parche sin cambios no publica");
+
+    // Rearranque: lo guardado gana a fábrica
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.stored_schema == CFG_SCHEMA_VERSION && rep.loaded == 3, "rearranque: 3 claves leídas");
+    check(snap(&s).unlock_max_ms == 8000 && snap(&s).pins.lock == 4, "rearranque: valores guardados");
+
+    // Valor fuera de rango en NVS (otra versión, corrupción): se ignora
+    mem_set_i32(&g_nvs, "relock_ms", 5);
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.rejected == 1 && snap(&s).relock_ms == 1000, "valor fuera de rango: de fábrica");
+
+    // NVS de esquema 1: twin_min_ms (esquema 2) no se lee aunque exista la clave
+    mem_set_i32(&g_nvs, "schema", 1);
+    mem_set_i32(&g_nvs, "twin_min_ms", 500);
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.stored_schema == 1 && snap(&s).twin_min_ms == 100 && snap(&s).unlock_max_ms == 8000,
+          "esquema 1: campo nuevo de fábrica, el resto guardado");
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.stored_schema == CFG_SCHEMA_VERSION, "esquema 1: versión reescrita");
+
+    // NVS de esquema 2: el perfil de energía (esquema 3) arranca de fábrica
+    mem_set_i32(&g_nvs, "schema", 2);
+    mem_set_i32(&g_nvs, "power", 2);
+    cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    check(rep.stored_schema == 2 && snap(&s).power == 1 && snap(&s).unlock_max_ms == 8000,
+          "esquema 2: power de fábrica, el resto guardado");
+
+    // Lectores que retienen las dos instantáneas anteriores: BUSY sin tocar NVS
+    const app_cfg_t *held[CFG_SNAPSHOTS];
+    int n_held = 0;
+    int busy = 0;
+    for (int k = 0; k < CFG_SNAPSHOTS; ++k) {
+        held[n_held++] = cfg_acquire(&s);
+        char p[48];
+        int n = snprintf(p, sizeof(p), "{\"lcd_idle_ms\":%d}", 2000 + k);
+        writes = g_nvs.writes;
+        e = cfg_update_json(&s, p, (size_t)n, &changed, err, sizeof(err));
+        if (e == CFG_ERR_BUSY) {
+            busy++;
+            check(g_nvs.writes == writes, "BUSY no escribe en NVS");
+        }
+    }
+    check(busy == 1 && s.busy == 1, "todas las anteriores fijadas: BUSY");
+    while (n_held) cfg_release(&s, held[--n_held]);
+    e = cfg_update_json(&s, "{\"lcd_idle_ms\":9000}", 20, &changed, err, sizeof(err));
+    check(e == CFG_OK, "al soltar los lectores se vuelve a aceptar");
+}
+
+static void cost_bench(void)
+{
+    static cfg_store_t s;
+    app_cfg_t def = factory();
+    long saved_nvs_us = g_nvs_us;
+    g_nvs_us = 0;
+    // Todas las claves guardadas (todas distintas de fábrica): peor caso de arranque
+    memset(&g_nvs, 0, sizeof(g_nvs));
+    cfg_boot(&s, &def, &g_be, fake_now, NULL);
+    const char *full =
+        "{\"wifi_ssid\":\"lab\",\"wifi_pass\":\"secret\",\"mqtt_uri\":\"mqtt://10.0.0.2:1883\","
+        "\"combo\":\"987\",\"unlock_max_ms\":9000,\"relock_ms\":900,\"pot_settle_ms\":1900,"
+        "\"lcd_idle_ms\":4000,\"pin_lock\":4,\"pin_door\":32,\"pin_buzzer\":2,\"pin_led_st\":15,"
+        "\"pin_led_ok\":16,\"pin_led_err\":17,\"pin_pot\":35,\"pin_i2c_sda\":0,\"pin_i2c_scl\":1,"
+        "\"pin_rfid_cs\":3,\"pin_rfid_sck\":6,\"pin_rfid_mosi\":7,\"pin_rfid_miso\":8,\"pin_rfid_rst\":9,"
+        "\"twin_min_ms\":250,\"power\":2}";
+    cfg_update_json(&s, full, strlen(full), NULL, NULL, 0);
+
+    const int N = 20000;
+    cfg_load_report_t rep;
+    int64_t t0 = mono_us();
+    for (int i = 0; i < N; ++i) cfg_boot(&s, &def, &g_be, fake_now, &rep);
+    double boot_us = (double)(mono_us() - t0) / N;
+    check(rep.loaded == cfg_field_count, "arranque: todas las claves leídas");
+
+    char p[64];
+    t0 = mono_us();
+    for (int i = 0; i < N; ++i) {
+        int n = snprintf(p, sizeof(p), "{\"unlock_max_ms\":%d,\"combo\":\"%03d\"}", 1000 + i % 1000, i % 1000);
+        cfg_update_json(&s, p, (size_t)n, NULL, NULL, 0);
+    }
+    double upd_us = (double)(mono_us() - t0) / N;
+
+    const long R = 50000000;
+    uint64_t acc = 0;
+    t0 = mono_us();
+    for (long i = 0; i < R; ++i) {
+        const app_cfg_t *c = cfg_acquire(&s);
+        acc += (uint64_t)c->unlock_max_ms;
+        cfg_release(&s, c);
+    }
+    double rd_ns = (double)(mono_us() - t0) * 1000.0 / R;
+
+    printf("coste (%zu campos, %zu bytes por instantánea):\n", cfg_field_count, sizeof(app_cfg_t));
+    printf("  carga de arranque  %.2f us (todas las claves en el backend)\n", boot_us);
+    printf("  parche JSON        %.2f us (parseo + escritura + publicación, sin coste de flash)\n", upd_us);
+    printf("  lectura            %.2f ns (cfg_acquire + campo + cfg_release; acc=%llu)\n", rd_ns, (unsigned long long)(acc & 1));
+    g_nvs_us = saved_nvs_us;
+}
+
+// ---------------------------------------------------------------------------
+// Recarga en caliente con lectores concurrentes
+
+static cfg_store_t g_live;
+static atomic_bool g_run;
+static int64_t *g_pub_us;                 // Instante de publicación por generación
+static _Atomic int64_t *g_seen_us;        // Primer lector que la vio
+static uint32_t g_max_gen;
+
+typedef struct {
+    long reads;
+    long torn;
+    long backwards;
+} reader_t;
+
+static bool snapshot_consistent(const app_cfg_t *c)
+{
+    int k = c->unlock_max_ms - 1000;
+    char combo[8];
+    snprintf(combo, sizeof(combo), "%03d", k % 1000);
+    return c->relock_ms - 100 == k && c->pot_settle_ms - 1000 == k && c->lcd_idle_ms - 1000 == k &&
+           strcmp(c->combo, combo) == 0;
+}
+
+static void *reader(void *arg)
+{
+    reader_t *r = arg;
+    uint32_t last = 0;
+    while (atomic_load_explicit(&g_run, memory_order_relaxed)) {
+        const app_cfg_t *c = cfg_acquire(&g_live);
+        uint32_t gen = c->gen;
+        bool ok = snapshot_consistent(c);
+        if (g_hold_us && r->reads % 4096 == 0) {
+            sleep_us(g_hold_us);
+            ok = ok && snapshot_consistent(c);
+        }
+        if (c->gen != gen || !ok) r->torn++;
+        cfg_release(&g_live, c);
+        if (gen < last) r->backwards++;
+        if (gen != last && gen <= g_max_gen) {
+            int64_t t = mono_us(), z = 0;
+            atomic_compare_exchange_strong(&g_seen_us[gen], &z, t);
+        }
+        last = gen;
+        r->reads++;
+    }
+    return NULL;
+}
+
+static void reload_run(void)
+{
+    app_cfg_t def = factory();
+    def.unlock_max_ms = 1000; def.relock_ms = 100; def.pot_settle_ms = 1000; def.lcd_idle_ms = 1000;
+    strcpy(def.combo, "000");
+    memset(&g_nvs, 0, sizeof(g_nvs));
+    cfg_boot(&g_live, &def, &g_be, mono_us, NULL);
+
+    long period = g_period_us;
+    g_max_gen = (uint32_t)(g_seconds * 1e6 / period) + 8;
+    g_pub_us = calloc(g_max_gen + 1, sizeof(int64_t));
+    g_seen_us = calloc(g_max_gen + 1, sizeof(*g_seen_us));
+
+    reader_t rd[64];
+    pthread_t th[64];
+    memset(rd, 0, sizeof(rd));
+    atomic_store(&g_run, true);
+    for (int i = 0; i < g_readers; ++i) pthread_create(&th[i], NULL, reader, &rd[i]);
+
+    long ok = 0, busy = 0;
+    double upd_sum = 0, upd_max = 0;
+    int64_t end = mono_us() + (int64_t)(g_seconds * 1e6);
+    for (int k = 1; mono_us() < end; ++k) {
+        char p[160];
+        int v = k % 1000;
+        int n = snprintf(p, sizeof(p),
+                         "{\"unlock_max_ms\":%d,\"relock_ms\":%d,\"pot_settle_ms\":%d,\"lcd_idle_ms\":%d,\"combo\":\"%03d\"}",
+                         1000 + v, 100 + v, 1000 + v, 1000 + v, v);
+        int64_t t0 = mono_us();
+        cfg_err_t e = cfg_update_json(&g_live, p, (size_t)n, NULL, NULL, 0);
+        double dt = (double)(mono_us() - t0);
+        if (e == CFG_OK) {
+            app_cfg_t c = snap(&g_live);
+            if (c.gen <= g_max_gen) g_pub_us[c.gen] = c.published_us;
+            ok++;
+            upd_sum += dt;
+            if (dt > upd_max) upd_max = dt;
+        } else if (e == CFG_ERR_BUSY) {
+            busy++;
+        }
+        sleep_us(period);
+    }
+    atomic_store(&g_run, false);
+    long reads = 0, torn = 0, backwards = 0;
+    for (int i = 0; i < g_readers; ++i) {
+        pthread_join(th[i], NULL);
+        reads += rd[i].reads;
+        torn += rd[i].torn;
+        backwards += rd[i].backwards;
+    }
+
+    int64_t *vis = malloc(sizeof(int64_t) * (g_max_gen + 1));
+    long nv = 0;
+    for (uint32_t g = 2; g <= g_max_gen; ++g) {
+        int64_t seen = atomic_load(&g_seen_us[g]);
+        if (g_pub_us[g] && seen) vis[nv++] = seen - g_pub_us[g];
+    }
+    qsort(vis, (size_t)nv, sizeof(int64_t), cmp_i64);
+
+    check(torn == 0, "lector vio una instantánea inconsistente");
+    check(backwards == 0, "lector vio retroceder la generación");
+    printf("recarga: %d lectores, %.1f s, periodo %ld us, retención %ld us, commit simulado %ld us\n",
+           g_readers, g_seconds, period, g_hold_us, g_nvs_us);
+    printf("  publicadas=%ld busy=%ld  parche medio=%.1f us máx=%.1f us\n",
+           ok, busy, ok ? upd_sum / ok : 0.0, upd_max);
+    printf("  lecturas=%ld (%.1f M/s por lector) inconsistentes=%ld retrocesos=%ld\n", reads,
+           reads / g_seconds / 1e6 / g_readers, torn, backwards);
+    if (nv) {
+        printf("  publicación -> visible: n=%ld p50=%lld us p99=%lld us máx=%lld us\n", nv,
+               (long long)vis[nv / 2], (long long)vis[(long)(nv * 0.99)], (long long)vis[nv - 1]);
+    }
+    free(vis);
+    free(g_pub_us);
+    free(g_seen_us);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "uso: cfg_reload [opciones]\n"
+        "  --readers N     hilos lectores (4)\n"
+        "  --seconds S     duración de la prueba de recarga (2)\n"
+        "  --period-us N   intervalo entre cambios (200)\n"
+        "  --hold-us N     cada 4096 lecturas, retener la instantánea N us (0)\n"
+        "  --nvs-us N      coste simulado de cada nvs_commit (0)\n");
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!v) { usage(); return 2; }
+        if (!strcmp(a, "--readers")) g_readers = atoi(v);
+        else if (!strcmp(a, "--seconds")) g_seconds = strtod(v, NULL);
+        else if (!strcmp(a, "--period-us")) g_period_us = atol(v);
+        else if (!strcmp(a, "--hold-us")) g_hold_us = atol(v);
+        else if (!strcmp(a, "--nvs-us")) g_nvs_us = atol(v);
+        else { usage(); return 2; }
+        ++i;
+    }
+    if (g_readers < 1 || g_readers > 64 || g_seconds <= 0 || g_period_us < 1) { usage(); return 2; }
+
+    schema_checks();
+    cost_bench();
+    reload_run();
+    printf("%s\n", g_fail ? "FALLO" : "OK");
+    return g_fail;
+}
@@ -0,0 +1,788 @@
+/*
+ * cmd_rtt: acuses por etapas de las órdenes remotas (main/cmd_ack.c) y
+ * latencia de ida y vuelta vista por el cliente que las envía.
+ *
+ * El cliente publica {"action":"open","id":"rtt-N","user":"rtt"} en
+ * iot/commands, escucha iot/commands/ack y mide, por etapa (received,
+ * authorized, waiting_door, actuated, relocked...), el tiempo desde que
+ * envió la orden hasta que llega el acuse (p50/p90/p99/máx). También
+ * resume dt_us, el tiempo medido en el dispositivo desde "received", que
+ * separa la red del trabajo de control_task.
+ *
+ * Sin --broker: simulación de eventos discretos del dispositivo con el
+ * código real de main/ (cmd_ack, cred_queue, access_fsm) y el mismo
+ * recorrido que main.c: handler MQTT -> cola de credenciales ->
+ * control_task -> anillo de acuses -> DL_ACK -> broker -> cliente, con
+ * latencias de red y tiempos de servicio configurables.
+ *  1) Escenarios: puerta cerrada, puerta abierta (waiting_door), id
+ *     repetido (duplicate, una sola ejecución), orden sin apertura
+ *     (rejected), ráfaga que desborda el carril remoto (dropped) y más
+ *     órdenes sin re-bloqueo de las que caben en la tabla (expired).
+ *  2) Barrido de carga (--rates): percentiles por etapa y comprobaciones
+ *     (orden de etapas, seq sin huecos, ninguna orden sin respuesta).
+ *
+ * Con --broker host:port: cliente MQTT 3.1.1 mínimo (sockets POSIX, QoS 1)
+ * contra un broker local y el dispositivo real, con la misma tabla.
+ *
+ * Compilar: make -C tools cmd_rtt   (binario en tools/build/)
+ * Ejemplos: tools/build/cmd_rtt --rates 1,5,20,50
+ *           tools/build/cmd_rtt --broker 127.0.0.1:1883 -n 200 --rate 5
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "access_fsm.h"
+#include "cJSON.h"
+#include "cmd_ack.h"
+#include "cred_queue.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define CMD_TOPIC     "iot/commands"
+#define ACK_TOPIC     "iot/commands/ack"   // Igual que CMD_ACK_TOPIC en main.c
+#define UNLOCK_MAX_MS 10000                // Valores de fábrica de main.c
+#define RELOCK_MS     1000
+
+// rand() de la libc, sembrado con srand() por tasa (no g_rng)
+static double rand_u(void)
+{
+    return (rand() + 1.0) / ((double)RAND_MAX + 2.0);
+}
+
+static int64_t rand_exp_us(double mean_us)
+{
+    return (int64_t)(-log(rand_u()) * mean_us);
+}
+
+// ---- Lado del cliente: lo que se envió y los acuses recibidos ----
+typedef struct {
+    int64_t sent_us;
+    int64_t rtt_us[CMD_ST_COUNT];    // Llegada de cada etapa - envío (-1: no llegó)
+    int64_t dt_us[CMD_ST_COUNT];
+    uint8_t last;                    // Última etapa vista
+    bool out_of_order;
+} cmd_rec_t;
+
+typedef struct {
+    const char *prefix;
+    cmd_rec_t *rec;
+    int n;
+    uint32_t last_seq;
+    uint32_t seq_gaps;
+    uint32_t acks;
+    uint32_t unknown;
+} client_t;
+
+static void client_init(client_t *c, const char *prefix, int n)
+{
+    memset(c, 0, sizeof(*c));
+    c->prefix = prefix;
+    c->n = n;
+    c->rec = calloc((size_t)n, sizeof(cmd_rec_t));
+    for (int i = 0; i < n; ++i) {
+        for (int s = 0; s < CMD_ST_COUNT; ++s) c->rec[i].rtt_us[s] = -1;
+    }
+}
+
+static void client_free(client_t *c)
+{
+    free(c->rec);
+}
+
+static void client_cmd_json(const client_t *c, int i, const char *action, char *buf, size_t cap)
+{
+    snprintf(buf, cap, "{\"action\":\"%s\",\"id\":\"%s-%d\",\"user\":\"rtt\"}", action, c->prefix, i);
+}
+
+// Orden en que las etapas pueden llegar; duplicate va aparte
+static int stage_rank(cmd_stage_t s)
+{
+    return s == CMD_ST_DUPLICATE ? -1 : (int)s;
+}
+
+static void client_ack(client_t *c, const char *json, size_t len, int64_t now_us)
+{
+    cJSON *j = cJSON_ParseWithLength(json, len);
+    cJSON *id = cJSON_GetObjectItem(j, "id"), *stage = cJSON_GetObjectItem(j, "stage");
+    cJSON *seq = cJSON_GetObjectItem(j, "seq"), *dt = cJSON_GetObjectItem(j, "dt_us");
+    size_t pl = strlen(c->prefix);
+    int s = cJSON_IsString(stage) ? cmd_stage_index(stage->valuestring) : -1;
+    if (!cJSON_IsString(id) || strncmp(id->valuestring, c->prefix, pl) != 0 || id->valuestring[pl] != '-' ||
+        s < 0 || !cJSON_IsNumber(seq)) {
+        c->unknown++;
+        cJSON_Delete(j);
+        return;
+    }
+    int i = atoi(id->valuestring + pl + 1);
+    uint32_t sq = (uint32_t)seq->valuedouble;
+    if (c->last_seq && sq != c->last_seq + 1) c->seq_gaps++;
+    c->last_seq = sq;
+    c->acks++;
+    if (i >= 0 && i < c->n) {
+        cmd_rec_t *r = &c->rec[i];
+        if (r->rtt_us[s] < 0) {
+            r->rtt_us[s] = now_us - r->sent_us;
+            r->dt_us[s] = cJSON_IsNumber(dt) ? (int64_t)dt->valuedouble : 0;
+        }
+        if (stage_rank((cmd_stage_t)s) >= 0) {
+            if (stage_rank((cmd_stage_t)s) < (int)r->last) r->out_of_order = true;
+            r->last = (uint8_t)s;
+        }
+    } else {
+        c->unknown++;
+    }
+    cJSON_Delete(j);
+}
+
+static void client_report(const client_t *c)
+{
+    static const cmd_stage_t order[] = {
+        CMD_ST_RECEIVED, CMD_ST_PENDING, CMD_ST_AUTHORIZED, CMD_ST_WAITING_DOOR, CMD_ST_ACTUATED,
+        CMD_ST_RELOCKED, CMD_ST_DENIED, CMD_ST_DROPPED, CMD_ST_REJECTED, CMD_ST_EXPIRED, CMD_ST_DUPLICATE,
+    };
+    int64_t *v = malloc(sizeof(int64_t) * (size_t)c->n), *d = malloc(sizeof(int64_t) * (size_t)c->n);
+    printf("  %-13s %6s %9s %9s %9s %9s %12s\n", "etapa", "n", "p50 ms", "p90 ms", "p99 ms", "máx ms", "disp p50 ms");
+    for (size_t k = 0; k < sizeof(order) / sizeof(order[0]); ++k) {
+        int n = 0;
+        for (int i = 0; i < c->n; ++i) {
+            if (c->rec[i].rtt_us[order[k]] < 0) continue;
+            v[n] = c->rec[i].rtt_us[order[k]];
+            d[n++] = c->rec[i].dt_us[order[k]];
+        }
+        if (!n) continue;
+        qsort(v, (size_t)n, sizeof(int64_t), cmp_i64);
+        qsort(d, (size_t)n, sizeof(int64_t), cmp_i64);
+        printf("  %-13s %6d %9.1f %9.1f %9.1f %9.1f %12.1f\n", cmd_stage_name(order[k]), n,
+               pct_ms(v, n, 0.50), pct_ms(v, n, 0.90), pct_ms(v, n, 0.99), v[n - 1] / 1000.0, pct_ms(d, n, 0.50));
+    }
+    free(v);
+    free(d);
+}
+
+// Toda orden tiene respuesta: received, y después una decisión o un final
+static int client_unanswered(const client_t *c)
+{
+    int n = 0;
+    for (int i = 0; i < c->n; ++i) {
+        const cmd_rec_t *r = &c->rec[i];
+        bool decided = false;
+        for (int s = CMD_ST_PENDING; s < CMD_ST_COUNT; ++s) decided |= r->rtt_us[s] >= 0;
+        if (r->rtt_us[CMD_ST_RECEIVED] < 0 || !decided) n++;
+    }
+    return n;
+}
+
+static int client_out_of_order(const client_t *c)
+{
+    int n = 0;
+    for (int i = 0; i < c->n; ++i) n += c->rec[i].out_of_order;
+    return n;
+}
+
+// ===================== Simulación del dispositivo =====================
+
+typedef enum {
+    EV_CLIENT_SEND = 0,   // arg: orden; el mensaje viaja al broker y al dispositivo
+    EV_DEV_RX,            // Llega al handler MQTT del dispositivo
+    EV_CTRL,              // control_task consume una credencial
+    EV_TIMER,             // arg: 0 relock, 1 unlock_max; gen: armado vigente
+    EV_DOOR,              // arg: 1 cerrada
+    EV_ACK_FLUSH,         // DL_ACK vence en la tarea esp_timer
+    EV_ACK_ARRIVE,        // arg: índice del acuse guardado
+} ev_kind_t;
+
+typedef struct {
+    int64_t t;
+    uint32_t ord;         // Desempate FIFO
+    uint8_t kind;
+    int arg;
+    uint32_t gen;
+} ev_t;
+
+typedef struct {
+    ev_t *h;
+    int n, cap;
+    uint32_t ord;
+} evq_t;
+
+static void evq_push(evq_t *q, int64_t t, ev_kind_t kind, int arg, uint32_t gen)
+{
+    if (q->n == q->cap) {
+        q->cap = q->cap ? 2 * q->cap : 256;
+        q->h = realloc(q->h, sizeof(ev_t) * (size_t)q->cap);
+    }
+    ev_t e = { t, q->ord++, (uint8_t)kind, arg, gen };
+    int i = q->n++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (q->h[p].t < e.t || (q->h[p].t == e.t && q->h[p].ord < e.ord)) break;
+        q->h[i] = q->h[p];
+        i = p;
+    }
+    q->h[i] = e;
+}
+
+static bool before(const ev_t *a, const ev_t *b)
+{
+    return a->t < b->t || (a->t == b->t && a->ord < b->ord);
+}
+
+static ev_t evq_pop(evq_t *q)
+{
+    ev_t top = q->h[0], last = q->h[--q->n];
+    int i = 0;
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        const ev_t *best = &last;
+        if (l < q->n && before(&q->h[l], best)) { m = l; best = &q->h[l]; }
+        if (r < q->n && before(&q->h[r], best)) m = r;
+        if (m == i) break;
+        q->h[i] = q->h[m];
+        i = m;
+    }
+    if (q->n) q->h[i] = last;
+    return top;
+}
+
+typedef struct {
+    double net_mean_us;   // Broker <-> cada extremo: 1 ms fijo + exponencial
+    int64_t rx_svc_us;    // Handler MQTT por orden (parseo JSON, registro)
+    int64_t ctrl_svc_us;  // control_task por credencial (política, FSM, relé)
+    int64_t flush_us;     // Vencimiento de DL_ACK en esp_timer
+    int64_t tx_svc_us;    // Cliente MQTT del dispositivo por acuse
+    double walk_p;        // Probabilidad de que alguien cruce tras abrir
+} sim_cfg_t;
+
+typedef struct {
+    sim_cfg_t cfg;
+    evq_t q;
+    client_t cl;
+    char (*cmd_json)[96];            // Mensaje de cada orden
+    char (*acks)[CMD_ACK_MSG_MAX];   // Acuses en vuelo hacia el cliente
+    int nacks, acks_cap;
+    // Dispositivo
+    cmd_tracker_t cmd;
+    cred_queue_t cq;
+    access_fsm_t fsm;
+    bool door_closed;
+    uint32_t timer_gen[2];
+    int64_t mqtt_free_us, ctrl_free_us, tx_free_us, to_client_us;
+    bool ctrl_busy;
+    uint32_t grants, executed;
+} sim_t;
+
+static int64_t net_us(const sim_t *s)
+{
+    return 1000 + rand_exp_us(s->cfg.net_mean_us);
+}
+
+static void sim_kick(sim_t *s, int64_t now, bool kick)
+{
+    if (kick) evq_push(&s->q, now + s->cfg.flush_us, EV_ACK_FLUSH, 0, 0);
+}
+
+// Acuses que dependen de la cerradura, como ctrl_step() en main.c
+static void sim_step(sim_t *s, int64_t now, access_event_t aev)
+{
+    bool kick = false;
+    uint8_t act = access_fsm_step(&s->fsm, aev);
+    if (act & ACCESS_ACT_CANCEL_RELOCK) s->timer_gen[0]++;
+    if (act & ACCESS_ACT_CANCEL_UNLOCK_MAX) s->timer_gen[1]++;
+    if (act & ACCESS_ACT_ARM_RELOCK) evq_push(&s->q, now + MS(RELOCK_MS), EV_TIMER, 0, ++s->timer_gen[0]);
+    if (act & ACCESS_ACT_ARM_UNLOCK_MAX) evq_push(&s->q, now + MS(UNLOCK_MAX_MS), EV_TIMER, 1, ++s->timer_gen[1]);
+    if ((act & ACCESS_ACT_UNLOCK) && s->door_closed && rand_u() < s->cfg.walk_p) {
+        // Alguien cruza: abre al rato y cierra unos segundos después
+        int64_t open = now + MS(800) + rand_exp_us(MS(700));
+        evq_push(&s->q, open, EV_DOOR, 0, 0);
+        evq_push(&s->q, open + MS(1500) + rand_exp_us(MS(1500)), EV_DOOR, 1, 0);
+    }
+    if (s->fsm.state == ACCESS_GRANTED_WAIT_CLOSE) {
+        cmd_advance(&s->cmd, 0, CMD_ST_BIT(CMD_ST_AUTHORIZED), CMD_ST_WAITING_DOOR, now, &kick);
+    }
+    if (!access_state_is_locked(s->fsm.state)) {
+        cmd_advance(&s->cmd, 0, CMD_ST_BIT(CMD_ST_AUTHORIZED) | CMD_ST_BIT(CMD_ST_WAITING_DOOR), CMD_ST_ACTUATED, now, &kick);
+    }
+    if (act & ACCESS_ACT_LOCK) cmd_advance(&s->cmd, 0, CMD_ST_BIT(CMD_ST_ACTUATED), CMD_ST_RELOCKED, now, &kick);
+    sim_kick(s, now, kick);
+}
+
+// Handler MQTT de iot/commands, como en main.c
+static void sim_dev_rx(sim_t *s, int64_t now, const char *json)
+{
+    bool kick = false, unlock = false;
+    int cmd = 0;
+    cJSON *j = cJSON_Parse(json);
+    cJSON *action = cJSON_GetObjectItem(j, "action"), *jid = cJSON_GetObjectItem(j, "id");
+    if (cJSON_IsString(action) && strcmp(action->valuestring, "open") == 0) unlock = true;
+    if (jid) cmd = cJSON_IsString(jid) ? cmd_receive(&s->cmd, jid->valuestring, 0, now, &kick) : -1;
+    if (cmd > 0 && unlock) {
+        cred_rec_t rec = { .method = CRED_REMOTE, .cmd = (uint16_t)cmd, .ts_us = now };
+        uint32_t seq;
+        cred_push_t r = cred_queue_push(&s->cq, &rec, &seq);
+        if (r == CRED_PUSH_DROPPED) cmd_stage(&s->cmd, cmd, CMD_ST_DROPPED, now, &kick);
+        if (r == CRED_PUSH_QUEUED_BELL) evq_push(&s->q, now < s->ctrl_free_us ? s->ctrl_free_us : now, EV_CTRL, 0, 0);
+    } else if (cmd > 0) {
+        cmd_stage(&s->cmd, cmd, CMD_ST_REJECTED, now, &kick);
+    }
+    cJSON_Delete(j);
+    sim_kick(s, now, kick);
+}
+
+// Una credencial por evento; el timbre se rearma al vaciar la cola
+static void sim_ctrl(sim_t *s, int64_t now)
+{
+    cred_rec_t rec;
+    if (!cred_queue_pop(&s->cq, &rec)) return;
+    bool kick = false;
+    s->ctrl_free_us = now + s->cfg.ctrl_svc_us;
+    int64_t done = s->ctrl_free_us;
+    // Remoto: la política lo permite y salta la fusión (regla por defecto)
+    cmd_stage(&s->cmd, rec.cmd, CMD_ST_AUTHORIZED, done, &kick);
+    sim_kick(s, done, kick);
+    s->grants++;
+    sim_step(s, done, ACCESS_EV_GRANT);
+    evq_push(&s->q, done, EV_CTRL, 0, 0);
+}
+
+static void sim_ack_flush(sim_t *s, int64_t now)
+{
+    cmd_ack_t a;
+    while (cmd_ack_pop(&s->cmd, &a)) {
+        if (s->nacks == s->acks_cap) {
+            s->acks_cap = s->acks_cap ? 2 * s->acks_cap : 1024;
+            s->acks = realloc(s->acks, sizeof(*s->acks) * (size_t)s->acks_cap);
+        }
+        cmd_ack_format(&a, s->acks[s->nacks], CMD_ACK_MSG_MAX);
+        // Una conexión TCP: los acuses llegan en el orden en que salen
+        s->tx_free_us = (s->tx_free_us > now ? s->tx_free_us : now) + s->cfg.tx_svc_us;
+        int64_t at = s->tx_free_us + net_us(s) + net_us(s);
+        if (at < s->to_client_us) at = s->to_client_us;
+        s->to_client_us = at;
+        evq_push(&s->q, at, EV_ACK_ARRIVE, s->nacks++, 0);
+    }
+}
+
+static void sim_init(sim_t *s, const sim_cfg_t *cfg, const char *prefix, int n)
+{
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    client_init(&s->cl, prefix, n);
+    s->cmd_json = calloc((size_t)n, sizeof(*s->cmd_json));
+    cmd_init(&s->cmd);
+    cred_queue_init(&s->cq);
+    s->door_closed = true;
+    access_fsm_init(&s->fsm, true);
+}
+
+static void sim_free(sim_t *s)
+{
+    client_free(&s->cl);
+    free(s->cmd_json);
+    free(s->acks);
+    free(s->q.h);
+}
+
+// Orden i enviada en t con la acción dada (se puede repetir el mismo i)
+static void sim_send(sim_t *s, int i, int64_t t, const char *action)
+{
+    client_cmd_json(&s->cl, i, action, s->cmd_json[i], sizeof(s->cmd_json[i]));
+    evq_push(&s->q, t, EV_CLIENT_SEND, i, 0);
+}
+
+static void sim_run(sim_t *s, int64_t until)
+{
+    while (s->q.n && s->q.h[0].t <= until) {
+        ev_t e = evq_pop(&s->q);
+        switch ((ev_kind_t)e.kind) {
+        case EV_CLIENT_SEND:
+            if (s->cl.rec[e.arg].sent_us == 0) s->cl.rec[e.arg].sent_us = e.t;
+            evq_push(&s->q, e.t + net_us(s) + net_us(s), EV_DEV_RX, e.arg, 0);
+            break;
+        case EV_DEV_RX: {
+            // El handler atiende de uno en uno
+            int64_t t = (e.t > s->mqtt_free_us ? e.t : s->mqtt_free_us) + s->cfg.rx_svc_us;
+            s->mqtt_free_us = t;
+            sim_dev_rx(s, t, s->cmd_json[e.arg]);
+            break;
+        }
+        case EV_CTRL:
+            if (e.t < s->ctrl_free_us) evq_push(&s->q, s->ctrl_free_us, EV_CTRL, 0, 0);
+            else sim_ctrl(s, e.t);
+            break;
+        case EV_TIMER:
+            if (e.gen != s->timer_gen[e.arg]) break;  // Cancelado o rearmado
+            sim_step(s, e.t, e.arg == 0 ? ACCESS_EV_RELOCK_DUE : ACCESS_EV_UNLOCK_MAX_DUE);
+            break;
+        case EV_DOOR:
+            s->door_closed = e.arg;
+            sim_step(s, e.t, e.arg ? ACCESS_EV_DOOR_CLOSED : ACCESS_EV_DOOR_OPEN);
+            break;
+        case EV_ACK_FLUSH:
+            sim_ack_flush(s, e.t);
+            break;
+        case EV_ACK_ARRIVE:
+            client_ack(&s->cl, s->acks[e.arg], strlen(s->acks[e.arg]), e.t);
+            break;
+        }
+    }
+}
+
+static const sim_cfg_t k_sim_default = {
+    .net_mean_us = 3000, .rx_svc_us = 400, .ctrl_svc_us = 1500,
+    .flush_us = 100, .tx_svc_us = 150, .walk_p = 0.5,
+};
+
+static bool got(const sim_t *s, int i, cmd_stage_t st)
+{
+    return s->cl.rec[i].rtt_us[st] >= 0;
+}
+
+static void scenarios(void)
+{
+    sim_cfg_t cfg = k_sim_default;
+    cfg.walk_p = 0;
+    sim_t s;
+
+    // Puerta cerrada: todas las etapas, en orden, y re-bloqueo por tiempo máximo
+    sim_init(&s, &cfg, "a", 1);
+    sim_send(&s, 0, MS(10), "open");
+    sim_run(&s, MS(UNLOCK_MAX_MS + 1000));
+    check(got(&s, 0, CMD_ST_RECEIVED) && got(&s, 0, CMD_ST_AUTHORIZED) && got(&s, 0, CMD_ST_ACTUATED) &&
+          got(&s, 0, CMD_ST_RELOCKED), "puerta cerrada: received, authorized, actuated, relocked");
+    check(!got(&s, 0, CMD_ST_WAITING_DOOR), "puerta cerrada: sin waiting_door");
+    check(s.cl.rec[0].dt_us[CMD_ST_RELOCKED] >= MS(UNLOCK_MAX_MS), "relocked tras unlock_max_ms");
+    check(client_out_of_order(&s.cl) == 0 && s.cl.seq_gaps == 0, "puerta cerrada: orden y seq");
+    sim_free(&s);
+
+    // Puerta abierta: espera al cierre, actúa al cerrar y re-bloquea tras relock_ms
+    sim_init(&s, &cfg, "b", 1);
+    s.door_closed = false;
+    access_fsm_init(&s.fsm, false);
+    sim_send(&s, 0, MS(10), "open");
+    evq_push(&s.q, MS(2000), EV_DOOR, 1, 0);
+    sim_run(&s, MS(1500));
+    check(got(&s, 0, CMD_ST_WAITING_DOOR) && !got(&s, 0, CMD_ST_ACTUATED), "puerta abierta: waiting_door, sin actuar");
+    sim_run(&s, MS(2500));
+    check(got(&s, 0, CMD_ST_ACTUATED) && s.cl.rec[0].dt_us[CMD_ST_ACTUATED] >= MS(1900),
+          "puerta abierta: actuated al cerrar");
+    sim_run(&s, MS(UNLOCK_MAX_MS + 3000));
+    check(got(&s, 0, CMD_ST_RELOCKED), "puerta abierta: relocked");
+    sim_free(&s);
+
+    // Id repetido (redelivery): duplicate y una sola ejecución
+    sim_init(&s, &cfg, "c", 1);
+    sim_send(&s, 0, MS(10), "open");
+    sim_send(&s, 0, MS(60), "open");
+    sim_run(&s, MS(500));
+    check(got(&s, 0, CMD_ST_DUPLICATE) && s.grants == 1, "id repetido: duplicate, una concesión");
+    sim_free(&s);
+
+    // Orden sin apertura
+    sim_init(&s, &cfg, "d", 1);
+    sim_send(&s, 0, MS(10), "close");
+    sim_run(&s, MS(500));
+    check(got(&s, 0, CMD_ST_REJECTED) && s.grants == 0, "sin apertura: rejected");
+    sim_free(&s);
+
+    // Ráfaga de 12 en 1 ms: el carril remoto (4) desborda
+    cfg.net_mean_us = 0;
+    sim_init(&s, &cfg, "e", 12);
+    for (int i = 0; i < 12; ++i) sim_send(&s, i, MS(10) + i * 80, "open");
+    sim_run(&s, MS(UNLOCK_MAX_MS + 1000));
+    int dropped = 0, actuated = 0;
+    for (int i = 0; i < 12; ++i) {
+        dropped += got(&s, i, CMD_ST_DROPPED);
+        actuated += got(&s, i, CMD_ST_ACTUATED);
+    }
+    printf("ráfaga de 12: %d actuated, %d dropped, %u concesiones\n", actuated, dropped, (unsigned)s.grants);
+    check(dropped > 0 && dropped + (int)s.grants == 12 && actuated == (int)s.grants,
+          "ráfaga: cada orden concedida (y actuada) o descartada");
+    check(client_unanswered(&s.cl) == 0 && s.cl.seq_gaps == 0, "ráfaga: todas con respuesta, seq sin huecos");
+    sim_free(&s);
+
+    // 10 órdenes sin re-bloqueo entre medias: la tabla (8) desaloja las más antiguas
+    sim_init(&s, &cfg, "f", CMD_TRACK_MAX + 2);
+    for (int i = 0; i < CMD_TRACK_MAX + 2; ++i) sim_send(&s, i, MS(10 + 50 * i), "open");
+    sim_run(&s, MS(UNLOCK_MAX_MS + 2000));
+    int expired = 0, relocked = 0;
+    for (int i = 0; i < CMD_TRACK_MAX + 2; ++i) {
+        expired += got(&s, i, CMD_ST_EXPIRED);
+        relocked += got(&s, i, CMD_ST_RELOCKED);
+    }
+    check(expired == 2 && got(&s, 0, CMD_ST_EXPIRED) && got(&s, 1, CMD_ST_EXPIRED) && relocked == CMD_TRACK_MAX,
+          "tabla llena: expired las 2 más antiguas, relocked el resto");
+    sim_free(&s);
+}
+
+static void load(const double *rates, int nrates, int n, unsigned seed)
+{
+    for (int k = 0; k < nrates; ++k) {
+        srand(seed + (unsigned)k);
+        sim_t s;
+        sim_init(&s, &k_sim_default, "rtt", n);
+        int64_t t = MS(10);
+        for (int i = 0; i < n; ++i) {
+            sim_send(&s, i, t, "open");
+            t += rand_exp_us(1e6 / rates[k]);
+        }
+        sim_run(&s, t + MS(UNLOCK_MAX_MS + 10000));
+        printf("carga %.1f órdenes/s, %d órdenes (%u concedidas, anillo máx %u, %u acuses perdidos):\n",
+               rates[k], n, (unsigned)s.grants, (unsigned)s.cmd.st.ring_high_water, (unsigned)s.cmd.st.acks_lost);
+        client_report(&s.cl);
+        char what[96];
+        snprintf(what, sizeof(what), "carga %.1f/s: toda orden con respuesta, en orden y sin huecos", rates[k]);
+        check(client_unanswered(&s.cl) == 0 && client_out_of_order(&s.cl) == 0 && s.cl.seq_gaps == 0 &&
+              s.cl.unknown == 0, what);
+        sim_free(&s);
+    }
+}
+
+// ===================== Cliente MQTT 3.1.1 mínimo =====================
+
+static bool send_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n) {
+        ssize_t w = send(fd, p, n, 0);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Paquete: cabecera fija + longitud variable + cuerpo
+static bool mqtt_send(int fd, uint8_t type, const uint8_t *body, size_t len)
+{
+    uint8_t hdr[5];
+    size_t h = 0;
+    hdr[h++] = type;
+    size_t x = len;
+    do {
+        uint8_t b = x % 128;
+        x /= 128;
+        hdr[h++] = b | (x ? 0x80 : 0);
+    } while (x);
+    return send_all(fd, hdr, h) && send_all(fd, body, len);
+}
+
+static size_t put_str(uint8_t *p, const char *s)
+{
+    size_t n = strlen(s);
+    p[0] = (uint8_t)(n >> 8);
+    p[1] = (uint8_t)n;
+    memcpy(p + 2, s, n);
+    return n + 2;
+}
+
+// Lee paquetes completos del búfer de recepción; devuelve los bytes consumidos
+typedef struct {
+    int fd;
+    uint8_t rx[8192];
+    size_t rx_len;
+    uint16_t next_pid;
+    bool connected, subscribed;
+    uint32_t puback_pending;
+} mqtt_t;
+
+static bool mqtt_handle(mqtt_t *m, client_t *c, uint8_t type, const uint8_t *b, size_t len)
+{
+    switch (type >> 4) {
+    case 2:   // CONNACK
+        m->connected = len >= 2 && b[1] == 0;
+        return m->connected;
+    case 9:   // SUBACK
+        m->subscribed = len >= 3 && b[2] != 0x80;
+        return m->subscribed;
+    case 4:   // PUBACK
+        if (m->puback_pending) m->puback_pending--;
+        return true;
+    case 3: { // PUBLISH
+        int qos = (type >> 1) & 3;
+        if (len < 2) return false;
+        size_t tl = (size_t)b[0] << 8 | b[1], off = 2 + tl;
+        uint16_t pid = 0;
+        if (qos) {
+            if (off + 2 > len) return false;
+            pid = (uint16_t)(b[off] << 8 | b[off + 1]);
+            off += 2;
+        }
+        if (off > len) return false;
+        if (tl == strlen(ACK_TOPIC) && memcmp(b + 2, ACK_TOPIC, tl) == 0) {
+            client_ack(c, (const char *)b + off, len - off, mono_us());
+        }
+        if (qos == 1) {
+            uint8_t ack[2] = { (uint8_t)(pid >> 8), (uint8_t)pid };
+            return mqtt_send(m->fd, 0x40, ack, 2);
+        }
+        return true;
+    }
+    default:
+        return true;
+    }
+}
+
+static bool mqtt_poll(mqtt_t *m, client_t *c, int timeout_ms)
+{
+    struct pollfd p = { .fd = m->fd, .events = POLLIN };
+    int r = poll(&p, 1, timeout_ms);
+    if (r < 0) return errno == EINTR;
+    if (r == 0) return true;
+    ssize_t n = recv(m->fd, m->rx + m->rx_len, sizeof(m->rx) - m->rx_len, 0);
+    if (n <= 0) return false;
+    m->rx_len += (size_t)n;
+    for (;;) {
+        size_t len = 0, i = 1;
+        int mul = 1;
+        for (;; ++i) {
+            if (i >= m->rx_len || i > 4) return i <= 4;
+            len += (size_t)(m->rx[i] & 0x7f) * (size_t)mul;
+            mul *= 128;
+            if (!(m->rx[i] & 0x80)) break;
+        }
+        size_t total = i + 1 + len;
+        if (total > sizeof(m->rx)) return false;
+        if (m->rx_len < total) return true;
+        if (!mqtt_handle(m, c, m->rx[0], m->rx + i + 1, len)) return false;
+        memmove(m->rx, m->rx + total, m->rx_len - total);
+        m->rx_len -= total;
+    }
+}
+
+static int tcp_connect(const char *hostport)
+{
+    char host[128];
+    snprintf(host, sizeof(host), "%s", hostport);
+    char *colon = strrchr(host, ':');
+    const char *port = "1883";
+    if (colon) {
+        *colon = '\0';
+        port = colon + 1;
+    }
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *a = res; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int broker_run(const char *hostport, int n, double rate, int wait_s)
+{
+    mqtt_t m = { .fd = tcp_connect(hostport), .next_pid = 1 };
+    if (m.fd < 0) {
+        fprintf(stderr, "cmd_rtt: no se pudo conectar a %s\n", hostport);
+        return 1;
+    }
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "rtt%ld", (long)getpid());
+    client_t c;
+    client_init(&c, prefix, n);
+
+    uint8_t buf[256];
+    size_t k = put_str(buf, "MQTT");
+    buf[k++] = 4;        // 3.1.1
+    buf[k++] = 0x02;     // Sesión limpia
+    buf[k++] = 0;
+    buf[k++] = 60;       // Keepalive
+    k += put_str(buf + k, prefix);
+    bool ok = mqtt_send(m.fd, 0x10, buf, k);
+    int64_t limit = mono_us() + MS(5000);
+    while (ok && !m.connected && mono_us() < limit) ok = mqtt_poll(&m, &c, 100);
+    k = 0;
+    buf[k++] = 0;
+    buf[k++] = 1;
+    k += put_str(buf + k, ACK_TOPIC);
+    buf[k++] = 1;        // QoS 1
+    ok = ok && m.connected && mqtt_send(m.fd, 0x82, buf, k);
+    while (ok && !m.subscribed && mono_us() < limit) ok = mqtt_poll(&m, &c, 100);
+    if (!ok || !m.subscribed) {
+        fprintf(stderr, "cmd_rtt: el broker no aceptó la conexión o la suscripción\n");
+        close(m.fd);
+        client_free(&c);
+        return 1;
+    }
+
+    srand((unsigned)getpid());
+    int64_t next = mono_us();
+    for (int i = 0; ok && i < n;) {
+        int64_t now = mono_us();
+        if (now >= next) {
+            char json[96];
+            client_cmd_json(&c, i, "open", json, sizeof(json));
+            k = put_str(buf, CMD_TOPIC);
+            buf[k++] = (uint8_t)(m.next_pid >> 8);
+            buf[k++] = (uint8_t)m.next_pid;
+            m.next_pid = m.next_pid == 0xffff ? 1 : m.next_pid + 1;
+            memcpy(buf + k, json, strlen(json));
+            k += strlen(json);
+            c.rec[i++].sent_us = mono_us();
+            ok = mqtt_send(m.fd, 0x32, buf, k);
+            m.puback_pending++;
+            next += rand_exp_us(1e6 / rate);
+            continue;
+        }
+        ok = mqtt_poll(&m, &c, (int)((next - now) / 1000) + 1);
+    }
+    limit = mono_us() + MS(wait_s * 1000);
+    while (ok && mono_us() < limit) ok = mqtt_poll(&m, &c, 100);
+    uint8_t disc = 0;
+    mqtt_send(m.fd, 0xe0, &disc, 0);
+    close(m.fd);
+
+    printf("broker %s: %d órdenes a %.1f/s, %u acuses (%u huecos de seq, %u ajenos)\n",
+           hostport, n, rate, (unsigned)c.acks, (unsigned)c.seq_gaps, (unsigned)c.unknown);
+    client_report(&c);
+    int unanswered = client_unanswered(&c);
+    if (unanswered) printf("  %d órdenes sin respuesta completa\n", unanswered);
+    client_free(&c);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *broker = NULL;
+    double rates[8] = { 1, 5, 20, 50 };
+    int nrates = 4, n = 0, wait_s = 15;
+    double rate = 5;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--broker") && i + 1 < argc) broker = argv[++i];
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rate") && i + 1 < argc) rate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--wait") && i + 1 < argc) wait_s = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = arg_seed(argv[++i]);
+        else if (!strcmp(argv[i], "--rates") && i + 1 < argc) {
+            nrates = 0;
+            for (char *p = argv[++i]; *p && nrates < 8; ++p) {
+                rates[nrates++] = strtod(p, &p);
+                if (*p != ',') break;
+            }
+        } else {
+            fprintf(stderr, "uso: %s [--rates R1,R2,...] [-n N] [--seed S]\n"
+                            "     %s --broker host:port [-n N] [--rate R] [--wait S]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (broker) return broker_run(broker, n > 0 ? n : 200, rate > 0 ? rate : 5, wait_s);
+
+    scenarios();
+    load(rates, nrates, n > 0 ? n : 2000, seed);
+    if (!g_fail) printf("cmd_rtt: ok\n");
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200809L
+#include "tool_util.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+uint64_t rng_step(uint64_t *s)
+{
+    *s ^= *s << 13; *s ^= *s >> 7; *s ^= *s << 17;
+    return *s;
+}
+
+double rnd_u_r(uint64_t *s)
+{
+    return (double)(rng_step(s) >> 11) / (double)(1ull << 53);
+}
+
+double rnd_u(void)
+{
+    return rnd_u_r(&g_rng);
+}
+
+int64_t rnd_us(int64_t lo, int64_t hi)
+{
+    return lo + (int64_t)(rnd_u() * (double)(hi - lo));
+}
+
+double urand(void)
+{
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return ((g_rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0) + 1e-12;
+}
+
+int64_t exp_us(double mean_us)
+{
+    return (int64_t)(-log(urand()) * mean_us);
+}
+
+void rng_mix_seed(const char *v)
+{
+    g_rng ^= (uint64_t)strtoull(v, NULL, 10) * 0x2545F4914F6CDD1Dull;
+}
+
+unsigned arg_seed(const char *v)
+{
+    return (unsigned)strtoul(v, NULL, 10);
+}
+
+int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+double pct_ms(const int64_t *v, int n, double p)
+{
+    int k = (int)ceil(p * n) - 1;
+    return v[k < 0 ? 0 : k] / 1000.0;
+}
+
+int g_fail = 0;
+
+void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("  FALLO: %s\n", what);
+        g_fail = 1;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Utilidades comunes de las herramientas de host: generadores
+// pseudoaleatorios reproducibles, reloj monótono, percentiles, la semilla
+// de la línea de órdenes y las comprobaciones. Cada herramienta usa un único generador sobre
+// g_rng, así que para la misma semilla la secuencia no depende de qué
+// herramienta la consuma.
+
+// Estado compartido de los generadores; nunca debe valer 0
+extern uint64_t g_rng;
+
+// xorshift64 (13, 7, 17) sobre *s: siguiente estado. Para hilos con estado propio
+uint64_t rng_step(uint64_t *s);
+// Uniforme en [0, 1) con xorshift64 sobre *s
+double rnd_u_r(uint64_t *s);
+// Uniforme en [0, 1) con xorshift64 sobre g_rng
+double rnd_u(void);
+// Entero uniforme en [lo, hi) en us
+int64_t rnd_us(int64_t lo, int64_t hi);
+
+// xorshift64* (12, 25, 27) sobre g_rng: uniforme en (0, 1], apto para log()
+double urand(void);
+// Exponencial de media mean_us (con urand())
+int64_t exp_us(double mean_us);
+
+// Mezcla en g_rng la semilla decimal de --seed (pot_replay, door_bounce, sched_sim)
+void rng_mix_seed(const char *v);
+// Valor decimal de --seed; 0 si no es un número
+unsigned arg_seed(const char *v);
+
+// Reloj monótono en us
+int64_t mono_us(void);
+
+// Comparador de qsort para int64_t ascendente
+int cmp_i64(const void *a, const void *b);
+// Percentil p (0..1) de v ordenado (n > 0), en ms desde us
+double pct_ms(const int64_t *v, int n, double p);
+
+// Distinto de 0 tras algún fallo de comprobación: el código de salida
+extern int g_fail;
+// Si !ok, "  FALLO: what" en stdout y anota el fallo en g_fail
+void check(bool ok, const char *what);
@@ -0,0 +1,300 @@
+/*
+ * cred_stress: prueba de estrés en host de la cola de credenciales
+ * (main/cred_queue.c) con productores concurrentes (pthreads).
+ *
+ * Reproduce el esquema del firmware: cada productor (RFID, combinación o
+ * remoto) encola bajo un mutex (portMUX en main.c) y, si cred_queue_push
+ * pide timbre, publica un aviso en una cola de control acotada que imita
+ * g_ctrl_q. Un consumidor (control_task) espera avisos y vacía la cola.
+ * Comprueba al terminar:
+ *   - FIFO por productor: cada productor numera sus registros en el id.
+ *   - Contabilidad: encolados + descartados = intentos; consumidos =
+ *     encolados; contadores de cred_queue coinciden con los de los hilos.
+ *   - Secuencias: consumidas y descartadas son disjuntas y cubren 1..N.
+ *   - Timbre: tras parar los productores la cola queda vacía sin sondeo
+ *     (con --bell-fail se pierden avisos y un "timer" periódico despierta
+ *     al consumidor, como los eventos de puerta/plazo en el firmware).
+ * Informa además de la latencia de cola por carril (p50/p99/máx).
+ *
+ * Compilar: make -C tools cred_stress   (binario en tools/build/)
+ * Ejemplo:  tools/build/cred_stress --producers 6 --per 200000 --consumer-us 2
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cred_queue.h"
+#include "tool_util.h"
+
+#define CTRL_QUEUE_LEN 16   // Igual que main/main.c
+
+static cred_queue_t g_q;
+static pthread_mutex_t g_q_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+// Cola de control: solo cuenta avisos pendientes (acotada como g_ctrl_q)
+static pthread_mutex_t g_ctrl_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_ctrl_cv = PTHREAD_COND_INITIALIZER;
+static int g_ctrl_pending = 0;
+static bool g_stop = false;
+
+static int g_producers = 4;
+static long g_per = 100000;
+static long g_consumer_us = 0;
+static double g_bell_fail = 0.0;
+
+typedef struct {
+    int idx;
+    cred_method_t method;
+    uint64_t rng;
+    long queued;
+    long dropped;
+    long bells;
+    long bells_lost;
+    uint32_t *drop_seq;      // Secuencias descartadas (para la cobertura)
+} producer_t;
+
+static producer_t *g_prod;
+
+// Consumidor
+static uint32_t *g_last_ctr;     // Último contador visto por productor
+static uint8_t *g_seen;          // Secuencias consumidas
+static long g_consumed = 0;
+static long g_wakeups = 0;
+static long g_order_errors = 0;
+static int64_t *g_lat[CRED_LANE_COUNT];
+static long g_lat_n[CRED_LANE_COUNT];
+static uint32_t g_total;
+
+static bool ctrl_post(uint64_t *rng)
+{
+    if (g_bell_fail > 0.0 && rnd_u_r(rng) < g_bell_fail) return false;
+    pthread_mutex_lock(&g_ctrl_mtx);
+    bool ok = g_ctrl_pending < CTRL_QUEUE_LEN;
+    if (ok) {
+        g_ctrl_pending++;
+        pthread_cond_signal(&g_ctrl_cv);
+    }
+    pthread_mutex_unlock(&g_ctrl_mtx);
+    return ok;
+}
+
+static void *producer(void *arg)
+{
+    producer_t *p = arg;
+    for (long n = 0; n < g_per; ++n) {
+        cred_rec_t rec = { .method = (uint8_t)p->method, .id_len = 8, .ts_us = mono_us() };
+        uint32_t ctr = (uint32_t)n + 1;
+        memcpy(rec.id, &p->idx, 4);
+        memcpy(rec.id + 4, &ctr, 4);
+        uint32_t seq;
+        pthread_mutex_lock(&g_q_mtx);
+        cred_push_t r = cred_queue_push(&g_q, &rec, &seq);
+        pthread_mutex_unlock(&g_q_mtx);
+        if (r == CRED_PUSH_DROPPED) {
+            p->drop_seq[p->dropped++] = seq;
+        } else {
+            p->queued++;
+            if (r == CRED_PUSH_QUEUED_BELL) {
+                p->bells++;
+                if (!ctrl_post(&p->rng)) {
+                    p->bells_lost++;
+                    pthread_mutex_lock(&g_q_mtx);
+                    cred_queue_bell_lost(&g_q);
+                    pthread_mutex_unlock(&g_q_mtx);
+                }
+            }
+        }
+        // Ráfagas: a veces cede la CPU para variar el entrelazado
+        if (rnd_u_r(&p->rng) < 0.05) nanosleep(&(struct timespec){ 0, 0 }, NULL);
+    }
+    return NULL;
+}
+
+static void consume_one(const cred_rec_t *rec)
+{
+    int idx;
+    uint32_t ctr;
+    memcpy(&idx, rec->id, 4);
+    memcpy(&ctr, rec->id + 4, 4);
+    if (idx < 0 || idx >= g_producers || ctr <= g_last_ctr[idx]) {
+        g_order_errors++;
+    } else {
+        g_last_ctr[idx] = ctr;
+    }
+    if (rec->seq == 0 || rec->seq > g_total || g_seen[rec->seq]) g_order_errors++;
+    else g_seen[rec->seq] = 1;
+    cred_lane_t l = cred_lane_for((cred_method_t)rec->method);
+    g_lat[l][g_lat_n[l]++] = mono_us() - rec->ts_us;
+    g_consumed++;
+    if (g_consumer_us > 0) {
+        struct timespec ts = { 0, g_consumer_us * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void *consumer(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_ctrl_mtx);
+        while (g_ctrl_pending == 0 && !g_stop) pthread_cond_wait(&g_ctrl_cv, &g_ctrl_mtx);
+        if (g_ctrl_pending == 0 && g_stop) {
+            pthread_mutex_unlock(&g_ctrl_mtx);
+            break;
+        }
+        g_ctrl_pending--;
+        pthread_mutex_unlock(&g_ctrl_mtx);
+        g_wakeups++;
+        for (;;) {
+            cred_rec_t rec;
+            pthread_mutex_lock(&g_q_mtx);
+            bool got = cred_queue_pop(&g_q, &rec);
+            pthread_mutex_unlock(&g_q_mtx);
+            if (!got) break;
+            consume_one(&rec);
+        }
+    }
+    return NULL;
+}
+
+// Sustituto de los eventos de puerta/plazo: despierta al consumidor cada ms
+static volatile bool g_timer_run = true;
+static void *timer_thread(void *arg)
+{
+    (void)arg;
+    while (g_timer_run) {
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+        pthread_mutex_lock(&g_ctrl_mtx);
+        if (g_ctrl_pending < CTRL_QUEUE_LEN) {
+            g_ctrl_pending++;
+            pthread_cond_signal(&g_ctrl_cv);
+        }
+        pthread_mutex_unlock(&g_ctrl_mtx);
+    }
+    return NULL;
+}
+
+static void print_lat(const char *name, int64_t *v, long n)
+{
+    if (n == 0) {
+        printf("  %-7s sin registros\n", name);
+        return;
+    }
+    qsort(v, (size_t)n, sizeof(int64_t), cmp_i64);
+    printf("  %-7s n=%-9ld p50=%lld us  p99=%lld us  máx=%lld us\n", name, n,
+           (long long)v[n / 2], (long long)v[(long)(n * 0.99)], (long long)v[n - 1]);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "uso: cred_stress [opciones]\n"
+        "  --producers N    hilos productores (4; el primero es remoto)\n"
+        "  --per N          registros por productor (100000)\n"
+        "  --consumer-us N  coste por registro en el consumidor (0)\n"
+        "  --bell-fail P    probabilidad de perder un aviso (0)\n");
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!v) { usage(); return 2; }
+        if (!strcmp(a, "--producers")) g_producers = atoi(v);
+        else if (!strcmp(a, "--per")) g_per = atol(v);
+        else if (!strcmp(a, "--consumer-us")) g_consumer_us = atol(v);
+        else if (!strcmp(a, "--bell-fail")) g_bell_fail = strtod(v, NULL);
+        else { usage(); return 2; }
+        ++i;
+    }
+    if (g_producers < 1 || g_producers > 64 || g_per < 1) { usage(); return 2; }
+
+    cred_queue_init(&g_q);
+    g_total = (uint32_t)(g_producers * g_per);
+    g_prod = calloc((size_t)g_producers, sizeof(producer_t));
+    g_last_ctr = calloc((size_t)g_producers, sizeof(uint32_t));
+    g_seen = calloc((size_t)g_total + 1, 1);
+    for (int l = 0; l < CRED_LANE_COUNT; ++l) g_lat[l] = malloc(sizeof(int64_t) * g_total);
+
+    pthread_t cons, tmr, th[64];
+    pthread_create(&cons, NULL, consumer, NULL);
+    if (g_bell_fail > 0.0) pthread_create(&tmr, NULL, timer_thread, NULL);
+    int64_t t0 = mono_us();
+    for (int i = 0; i < g_producers; ++i) {
+        producer_t *p = &g_prod[i];
+        p->idx = i;
+        p->method = (i == 0) ? CRED_REMOTE : (i % 2 ? CRED_RFID : CRED_COMBO);
+        p->rng = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+        p->drop_seq = malloc(sizeof(uint32_t) * (size_t)g_per);
+        pthread_create(&th[i], NULL, producer, p);
+    }
+    for (int i = 0; i < g_producers; ++i) pthread_join(th[i], NULL);
+    int64_t t_prod = mono_us() - t0;
+
+    // Sin más productores, los avisos ya emitidos deben bastar para vaciar la cola
+    long queued = 0, dropped = 0, bells = 0, bells_lost = 0;
+    for (int i = 0; i < g_producers; ++i) {
+        queued += g_prod[i].queued;
+        dropped += g_prod[i].dropped;
+        bells += g_prod[i].bells;
+        bells_lost += g_prod[i].bells_lost;
+    }
+    for (int w = 0; w < 2000; ++w) {
+        pthread_mutex_lock(&g_q_mtx);
+        uint32_t pend = cred_queue_pending(&g_q);
+        long popped = (long)g_q.st.popped[0] + g_q.st.popped[1];
+        pthread_mutex_unlock(&g_q_mtx);
+        if (pend == 0 && popped == queued) break;
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+    }
+    g_timer_run = false;
+    if (g_bell_fail > 0.0) pthread_join(tmr, NULL);
+    pthread_mutex_lock(&g_ctrl_mtx);
+    g_stop = true;
+    pthread_cond_signal(&g_ctrl_cv);
+    pthread_mutex_unlock(&g_ctrl_mtx);
+    pthread_join(cons, NULL);
+
+    int fail = 0;
+    cred_queue_stats_t st = g_q.st;
+    long st_pushed = (long)st.pushed[0] + st.pushed[1];
+    long st_popped = (long)st.popped[0] + st.popped[1];
+    long st_over = (long)st.overflow[0] + st.overflow[1];
+    if (queued + dropped != (long)g_total) { fprintf(stderr, "FALLO: intentos %ld != %u\n", queued + dropped, g_total); fail = 1; }
+    if (st_pushed != queued || st_over != dropped) { fprintf(stderr, "FALLO: contadores de la cola no cuadran\n"); fail = 1; }
+    if (g_consumed != queued || st_popped != queued) {
+        fprintf(stderr, "FALLO: consumidos %ld != encolados %ld (pendientes %u)\n",
+                g_consumed, queued, cred_queue_pending(&g_q));
+        fail = 1;
+    }
+    if (g_order_errors) { fprintf(stderr, "FALLO: %ld registros fuera de orden o duplicados\n", g_order_errors); fail = 1; }
+    for (int i = 0; i < g_producers && !fail; ++i) {
+        for (long k = 0; k < g_prod[i].dropped; ++k) {
+            uint32_t s = g_prod[i].drop_seq[k];
+            if (s == 0 || s > g_total || g_seen[s]) { fprintf(stderr, "FALLO: secuencia descartada %u inválida\n", s); fail = 1; break; }
+            g_seen[s] = 2;
+        }
+    }
+    for (uint32_t s = 1; s <= g_total && !fail; ++s) {
+        if (!g_seen[s]) { fprintf(stderr, "FALLO: secuencia %u sin rastro\n", s); fail = 1; }
+    }
+
+    printf("%s: %d productores x %ld, %.2f s, %.1f M push/s\n", fail ? "FALLO" : "OK",
+           g_producers, g_per, t_prod / 1e6, g_total / (double)t_prod);
+    printf("  encolados=%ld descartados=%ld (remoto %u, normal %u) máx. ocupación remoto=%u/%d normal=%u/%d\n",
+           queued, dropped, (unsigned)st.overflow[CRED_LANE_PRIO], (unsigned)st.overflow[CRED_LANE_NORMAL],
+           st.high_water[CRED_LANE_PRIO], CRED_QUEUE_PRIO_LEN, st.high_water[CRED_LANE_NORMAL], CRED_QUEUE_LEN);
+    printf("  avisos=%ld perdidos=%ld despertares=%ld (%.1f registros/despertar)\n",
+           bells, bells_lost, g_wakeups, g_wakeups ? (double)g_consumed / g_wakeups : 0.0);
+    printf("latencia en cola:\n");
+    print_lat("remoto", g_lat[CRED_LANE_PRIO], g_lat_n[CRED_LANE_PRIO]);
+    print_lat("normal", g_lat[CRED_LANE_NORMAL], g_lat_n[CRED_LANE_NORMAL]);
+    return fail;
+}
@@ -0,0 +1,230 @@
+/*
+ * door_bounce: compara en host el sondeo original del reed (gpio_get_level
+ * cada 50 ms, sin anti-rebote) con la ISR any-edge + ventana esp_timer que usa
+ * door_monitor_task, reutilizando la MISMA lógica (main/door_debounce.c).
+ *
+ * Se generan N eventos sobre una línea de tiempo:
+ *   - Aperturas/cierres reales: ráfaga de rebotes (intervalos 50 us..2 ms,
+ *     ancho total <= --bounce-ms) que termina en el nivel opuesto.
+ *   - Glitches (golpes/vibración, fracción --glitch-rate): ráfaga con número
+ *     par de flancos que vuelve al nivel de partida.
+ *
+ * Métricas por método: cambios reportados, transiciones falsas (reportadas
+ * que no corresponden a un cambio real), latencia primer flanco -> evento
+ * (p50/p99/máx) y despertares por hora.
+ *
+ * Compilar: make -C tools door_bounce   (binario en tools/build/)
+ * Ejemplo:  tools/build/door_bounce --n 20000 --seed 3 --glitch-rate 0.3
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "door_debounce.h"
+#include "tool_util.h"
+
+typedef struct {
+    int64_t t_us;
+    int level;
+} edge_t;
+
+typedef struct {
+    int64_t t_us;            // Primer flanco del evento
+    int64_t settle_us;       // Último flanco del evento
+    int target;              // Nivel final
+    bool real;               // false = glitch
+} event_t;
+
+typedef struct {
+    const char *label;
+    int reported;
+    int false_changes;
+    int missed;
+    uint64_t wakeups;
+    int64_t *lat;
+    int nlat;
+} result_t;
+
+static edge_t *g_edges;
+static int g_nedges;
+static event_t *g_events;
+static int g_nevents;
+static int g_level0 = 1;
+
+// Nivel del pin en t (último flanco <= t)
+static int level_at(int64_t t)
+{
+    int lo = 0, hi = g_nedges - 1, idx = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (g_edges[mid].t_us <= t) { idx = mid; lo = mid + 1; }
+        else hi = mid - 1;
+    }
+    return idx < 0 ? g_level0 : g_edges[idx].level;
+}
+
+static void generate(int n, double glitch_rate, int bounce_ms)
+{
+    g_edges = malloc(sizeof(edge_t) * (size_t)n * 32);
+    g_events = malloc(sizeof(event_t) * (size_t)n);
+    int level = g_level0;
+    int64_t t = 1000000;
+    for (int i = 0; i < n; ++i) {
+        t += rnd_us(300000, 5000000);
+        event_t *ev = &g_events[g_nevents++];
+        ev->t_us = t;
+        ev->real = rnd_u() >= glitch_rate;
+        int k = 1 + 2 * (int)(rnd_u() * 8);          // 1..15 flancos (impar)
+        if (!ev->real) k = 2 + 2 * (int)(rnd_u() * 4); // 2..8 flancos (par)
+        // Intervalo máximo tal que la ráfaga no exceda bounce_ms
+        int64_t gap_max = (int64_t)bounce_ms * 1000 / k;
+        if (gap_max > 2000) gap_max = 2000;
+        if (gap_max < 51) gap_max = 51;
+        int64_t te = t;
+        for (int e = 0; e < k; ++e) {
+            if (e > 0) te += rnd_us(50, gap_max);
+            level ^= 1;
+            g_edges[g_nedges++] = (edge_t){ te, level };
+        }
+        ev->settle_us = te;
+        ev->target = level;
+        t = te;
+    }
+}
+
+// Evento real al que pertenece un reporte en t (el último que empezó antes)
+static int event_index_at(int64_t t)
+{
+    int lo = 0, hi = g_nevents - 1, idx = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (g_events[mid].t_us <= t) { idx = mid; lo = mid + 1; }
+        else hi = mid - 1;
+    }
+    return idx;
+}
+
+// Contabiliza un cambio reportado en t con nivel 'level'
+static void report(result_t *r, bool *seen, int64_t t, int level)
+{
+    r->reported++;
+    int i = event_index_at(t);
+    if (i < 0 || !g_events[i].real || g_events[i].target != level || seen[i]) {
+        r->false_changes++;
+        return;
+    }
+    seen[i] = true;
+    r->lat[r->nlat++] = t - g_events[i].t_us;
+}
+
+static void finish(result_t *r, const bool *seen)
+{
+    for (int i = 0; i < g_nevents; ++i) {
+        if (g_events[i].real && !seen[i]) r->missed++;
+    }
+}
+
+static void run_poll(result_t *r, int poll_ms)
+{
+    bool *seen = calloc((size_t)g_nevents, 1);
+    int64_t period = (int64_t)poll_ms * 1000;
+    int64_t end = g_edges[g_nedges - 1].t_us + 1000000;
+    int last = g_level0;
+    for (int64_t t = rnd_us(0, period); t < end; t += period) {
+        r->wakeups++;
+        int lv = level_at(t);
+        if (lv != last) {
+            last = lv;
+            report(r, seen, t, lv);
+        }
+    }
+    finish(r, seen);
+    free(seen);
+}
+
+static void run_isr(result_t *r, int debounce_ms)
+{
+    bool *seen = calloc((size_t)g_nevents, 1);
+    door_debounce_t d;
+    door_debounce_init(&d, debounce_ms, g_level0);
+    int64_t deadline = 0;
+    for (int i = 0; i <= g_nedges; ++i) {
+        int64_t te = (i < g_nedges) ? g_edges[i].t_us : INT64_MAX;
+        if (deadline > 0 && deadline <= te) {
+            r->wakeups++; // callback del esp_timer
+            if (door_debounce_expire(&d, level_at(deadline), deadline)) {
+                report(r, seen, deadline, d.stable_level);
+            }
+            deadline = 0;
+        }
+        if (i == g_nedges) break;
+        r->wakeups++; // ISR
+        deadline = door_debounce_edge(&d, te);
+    }
+    finish(r, seen);
+    free(seen);
+}
+
+static void print_result(const result_t *r, int real_changes, double hours)
+{
+    qsort(r->lat, (size_t)r->nlat, sizeof(int64_t), cmp_i64);
+    printf("[%s] reportados=%d reales=%d falsos=%d perdidos=%d\n",
+           r->label, r->reported, real_changes, r->false_changes, r->missed);
+    if (r->nlat > 0) {
+        printf("[%s] latencia flanco->evento ms: p50=%.1f p99=%.1f max=%.1f\n", r->label,
+               r->lat[r->nlat / 2] / 1000.0, r->lat[(r->nlat * 99) / 100] / 1000.0,
+               r->lat[r->nlat - 1] / 1000.0);
+    }
+    printf("[%s] despertares/h=%.0f\n", r->label, (double)r->wakeups / hours);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "uso: door_bounce [opciones]\n"
+        "  --n N             eventos simulados (10000)\n"
+        "  --seed N          semilla\n"
+        "  --debounce-ms N   DEBOUNCE_MS (%d)\n"
+        "  --poll-ms N       periodo del sondeo original (50)\n"
+        "  --bounce-ms N     ancho máximo de la ráfaga de rebotes (10)\n"
+        "  --glitch-rate F   fracción de eventos sin cambio neto (0.2)\n", DOOR_DEBOUNCE_MS);
+}
+
+int main(int argc, char **argv)
+{
+    int n = 10000, debounce_ms = DOOR_DEBOUNCE_MS, poll_ms = 50, bounce_ms = 10;
+    double glitch_rate = 0.2;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!v) { usage(); return 2; }
+        if (!strcmp(a, "--n")) n = atoi(v);
+        else if (!strcmp(a, "--seed")) rng_mix_seed(v);
+        else if (!strcmp(a, "--debounce-ms")) debounce_ms = atoi(v);
+        else if (!strcmp(a, "--poll-ms")) poll_ms = atoi(v);
+        else if (!strcmp(a, "--bounce-ms")) bounce_ms = atoi(v);
+        else if (!strcmp(a, "--glitch-rate")) glitch_rate = strtod(v, NULL);
+        else { usage(); return 2; }
+        ++i;
+    }
+    if (n <= 0 || bounce_ms <= 0) { usage(); return 2; }
+
+    generate(n, glitch_rate, bounce_ms);
+    int real_changes = 0;
+    for (int i = 0; i < g_nevents; ++i) real_changes += g_events[i].real;
+    double hours = (double)(g_edges[g_nedges - 1].t_us + 1000000) / 3.6e9;
+
+    result_t poll = { .label = "poll", .lat = malloc(sizeof(int64_t) * (size_t)g_nedges) };
+    result_t isr = { .label = "isr", .lat = malloc(sizeof(int64_t) * (size_t)g_nedges) };
+    run_poll(&poll, poll_ms);
+    run_isr(&isr, debounce_ms);
+    print_result(&poll, real_changes, hours);
+    print_result(&isr, real_changes, hours);
+
+    free(poll.lat);
+    free(isr.lat);
+    free(g_edges);
+    free(g_events);
+    return 0;
+}
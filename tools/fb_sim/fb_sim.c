@@ -0,0 +1,326 @@
+/*
+ * fb_sim: comprueba en host el secuenciador de feedback (main/feedback.c).
+ *
+ * 1) Reglas (siempre): reloj virtual, sin hilos.
+ *    - Cada patrón reproduce su tabla de pasos con sus duraciones y acaba en
+ *      reposo (buzzer y LED apagados).
+ *    - Un pip durante el "combinación incorrecta" se descarta; un error lo
+ *      interrumpe; el mismo patrón pedido otra vez vuelve a empezar.
+ *    - Pedidos atendidos juntos: gana el de mayor prioridad.
+ *
+ * 2) Estrés (--producers N --seconds S): N hilos piden patrones al azar
+ *    como rfid_task/pot_task/control_task, y un consumidor imita la tarea de
+ *    esp_timer (despertador + plazo del paso). Mide cuánto tarda cada
+ *    fb_post() del lado del productor frente a lo que bloqueaban los
+ *    antiguos beep_*()/led_show_denied() (duración del patrón), y cuadra
+ *    pedidos = fundidos + iniciados + descartados. Falla si algún pedido
+ *    tarda más que el paso más corto de cualquier patrón (30 ms).
+ *
+ * Compilar: make -C tools fb_sim   (binario en tools/build/)
+ * Ejemplo:  tools/build/fb_sim --producers 3 --seconds 3 --gap-us 0
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "feedback.h"
+#include "tool_util.h"
+
+#define EXPECT(c, ...) do { if (!(c)) { printf("rules: "); printf(__VA_ARGS__); printf("\n"); g_fail = 1; } } while (0)
+
+// ---------------------------------------------------------------------------
+// 1) Reglas con reloj virtual
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    fb_seq_t s;
+    int64_t t;               // ms virtuales
+    int64_t deadline;        // -1 = sin plazo
+    fb_out_t out;
+} vsim_t;
+
+static void v_init(vsim_t *v)
+{
+    memset(v, 0, sizeof(*v));
+    fb_init(&v->s);
+    v->deadline = -1;
+}
+
+static void v_apply(vsim_t *v, const fb_out_t *o)
+{
+    v->out = *o;
+    v->deadline = o->hold_ms ? v->t + o->hold_ms : -1;
+}
+
+static void v_post(vsim_t *v, fb_pattern_t id)
+{
+    fb_out_t o;
+    fb_request(&v->s, id);
+    if (fb_service(&v->s, &o)) v_apply(v, &o);
+}
+
+// Avanza hasta t_end procesando vencimientos de paso
+static void v_run_until(vsim_t *v, int64_t t_end)
+{
+    while (v->deadline >= 0 && v->deadline <= t_end) {
+        v->t = v->deadline;
+        fb_out_t o;
+        fb_step_expired(&v->s, &o);
+        v_apply(v, &o);
+    }
+    v->t = t_end;
+}
+
+static void check_rules(void)
+{
+    // Cada patrón: pasos en orden y reposo al final
+    for (int p = 0; p < FB_COUNT; ++p) {
+        vsim_t v;
+        v_init(&v);
+        v_post(&v, (fb_pattern_t)p);
+        const fb_pattern_def_t *d = &fb_patterns[p];
+        int64_t t = 0;
+        for (int i = 0; i < d->steps; ++i) {
+            EXPECT(v.out.duty == d->step[i].duty && v.out.leds == d->step[i].leds,
+                   "%s paso %d: salida %u/%u", d->name, i, v.out.duty, v.out.leds);
+            t += d->step[i].ms;
+            v_run_until(&v, t - 1);
+            EXPECT(v.s.cur == p, "%s acabó antes de tiempo (t=%lld)", d->name, (long long)t);
+            v_run_until(&v, t);
+        }
+        EXPECT(v.out.duty == 0 && v.out.leds == 0 && v.out.hold_ms == 0 && v.s.cur == -1,
+               "%s no vuelve a reposo", d->name);
+        EXPECT((uint32_t)t == fb_pattern_ms((fb_pattern_t)p), "%s: duración %lld", d->name, (long long)t);
+        EXPECT(v.s.completed == 1, "%s: completed=%u", d->name, v.s.completed);
+    }
+
+    // Prioridad menor durante uno en curso: se descarta
+    vsim_t v;
+    v_init(&v);
+    v_post(&v, FB_BAD_COMBO);
+    v_run_until(&v, 50);
+    v_post(&v, FB_TICK);
+    EXPECT(v.s.cur == FB_BAD_COMBO && v.s.dropped == 1, "tick no descartado durante bad_combo");
+    // Mayor prioridad: interrumpe
+    v_post(&v, FB_ERROR);
+    EXPECT(v.s.cur == FB_ERROR && v.s.preempted == 1 && v.out.duty == fb_patterns[FB_ERROR].step[0].duty,
+           "error no interrumpe bad_combo");
+    v_run_until(&v, 50 + fb_pattern_ms(FB_ERROR));
+    EXPECT(v.s.cur == -1 && v.out.leds == 0, "tras el error el LED rojo sigue encendido");
+
+    // Mismo patrón: vuelve a empezar desde el primer paso
+    v_init(&v);
+    v_post(&v, FB_OK);
+    v_run_until(&v, 100);
+    EXPECT(v.s.step == 1, "ok: paso %u a los 100 ms", v.s.step);
+    v_post(&v, FB_OK);
+    EXPECT(v.s.cur == FB_OK && v.s.step == 0 && v.s.played[FB_OK] == 2, "ok no reinicia");
+
+    // Varios pendientes a la vez: el de mayor prioridad, el resto descartado
+    v_init(&v);
+    fb_request(&v.s, FB_TICK);
+    fb_request(&v.s, FB_DENIED);
+    fb_request(&v.s, FB_OK);
+    EXPECT(!fb_request(&v.s, FB_TICK), "pedido repetido no fundido");
+    fb_out_t o;
+    EXPECT(fb_service(&v.s, &o) && v.s.cur == FB_DENIED && v.s.dropped == 2,
+           "pendientes: cur=%d dropped=%u", v.s.cur, v.s.dropped);
+    EXPECT(!fb_service(&v.s, &o), "servicio sin pendientes inicia algo");
+
+    if (!g_fail) printf("rules: %d patrones, prioridad, interrupción y fusión correctas\n", FB_COUNT);
+}
+
+// ---------------------------------------------------------------------------
+// 2) Estrés con hilos
+// ---------------------------------------------------------------------------
+
+static fb_seq_t g_seq;
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cv = PTHREAD_COND_INITIALIZER;
+static bool g_kick = false;          // esp_timer_start_once(g_fb_kick, 0)
+static volatile bool g_stop = false;
+static long g_gap_us = 50000;
+static double g_seconds = 2.0;
+
+typedef struct {
+    uint64_t rng;
+    long posts;
+    int64_t *lat_ns;
+    long lat_cap;
+    int64_t max_ns;
+    uint64_t legacy_ms;          // Lo que habrían dormido los beep_*() antiguos
+} prod_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Igual que fb_post() en main.c: pedir y, si es nuevo, despertar
+static void post(fb_pattern_t id)
+{
+    if (fb_request(&g_seq, id)) {
+        pthread_mutex_lock(&g_mu);
+        g_kick = true;
+        pthread_cond_signal(&g_cv);
+        pthread_mutex_unlock(&g_mu);
+    }
+}
+
+static void *producer(void *arg)
+{
+    prod_t *p = arg;
+    while (!g_stop) {
+        // Mezcla parecida al uso real: muchos pips, algún OK/denegado, pocos errores
+        uint64_t r = rng_step(&p->rng) % 100;
+        fb_pattern_t id = r < 70 ? FB_TICK : r < 82 ? FB_OK : r < 90 ? FB_DENIED : r < 97 ? FB_BAD_COMBO : FB_ERROR;
+        int64_t t0 = now_ns();
+        post(id);
+        int64_t dt = now_ns() - t0;
+        if (p->posts < p->lat_cap) p->lat_ns[p->posts] = dt;
+        if (dt > p->max_ns) p->max_ns = dt;
+        p->posts++;
+        p->legacy_ms += fb_pattern_ms(id);
+        long gap = g_gap_us ? (long)(rng_step(&p->rng) % (uint64_t)(2 * g_gap_us)) : 0;
+        if (gap) nanosleep(&(struct timespec){ gap / 1000000, (gap % 1000000) * 1000 }, NULL);
+    }
+    return NULL;
+}
+
+// Tarea de esp_timer: despertador inmediato + plazo del paso en curso
+static void *consumer(void *arg)
+{
+    (void)arg;
+    int64_t deadline = -1;   // us
+    pthread_mutex_lock(&g_mu);
+    for (;;) {
+        if (!g_kick) {
+            if (g_stop && deadline < 0 && !atomic_load(&g_seq.pending)) break;
+            if (deadline >= 0) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                int64_t wait = deadline - mono_us();
+                if (wait > 0) {
+                    int64_t ns = ts.tv_nsec + (wait % 1000000) * 1000;
+                    ts.tv_sec += wait / 1000000 + ns / 1000000000;
+                    ts.tv_nsec = ns % 1000000000;
+                    pthread_cond_timedwait(&g_cv, &g_mu, &ts);
+                }
+            } else {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += 10 * 1000000;
+                if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+                pthread_cond_timedwait(&g_cv, &g_mu, &ts);
+            }
+        }
+        bool kick = g_kick;
+        g_kick = false;
+        pthread_mutex_unlock(&g_mu);
+
+        fb_out_t o;
+        if (kick && fb_service(&g_seq, &o)) deadline = mono_us() + o.hold_ms * 1000;
+        if (deadline >= 0 && mono_us() >= deadline) {
+            fb_step_expired(&g_seq, &o);
+            deadline = o.hold_ms ? mono_us() + o.hold_ms * 1000 : -1;
+        }
+        pthread_mutex_lock(&g_mu);
+    }
+    pthread_mutex_unlock(&g_mu);
+    return NULL;
+}
+
+static int stress(int producers)
+{
+    fb_init(&g_seq);
+    prod_t *p = calloc((size_t)producers, sizeof(*p));
+    pthread_t *th = calloc((size_t)producers, sizeof(*th));
+    pthread_t cons;
+    for (int i = 0; i < producers; ++i) {
+        p[i].rng = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+        p[i].lat_cap = 2000000;
+        p[i].lat_ns = malloc(sizeof(int64_t) * (size_t)p[i].lat_cap);
+    }
+    pthread_create(&cons, NULL, consumer, NULL);
+    for (int i = 0; i < producers; ++i) pthread_create(&th[i], NULL, producer, &p[i]);
+    nanosleep(&(struct timespec){ (time_t)g_seconds, (long)((g_seconds - (time_t)g_seconds) * 1e9) }, NULL);
+    g_stop = true;
+    for (int i = 0; i < producers; ++i) pthread_join(th[i], NULL);
+    pthread_mutex_lock(&g_mu);
+    g_kick = true;   // Atender lo que quede pendiente
+    pthread_cond_signal(&g_cv);
+    pthread_mutex_unlock(&g_mu);
+    pthread_join(cons, NULL);
+
+    long posts = 0, n = 0;
+    int64_t max_ns = 0;
+    uint64_t legacy_ms = 0;
+    for (int i = 0; i < producers; ++i) {
+        posts += p[i].posts;
+        n += p[i].posts < p[i].lat_cap ? p[i].posts : p[i].lat_cap;
+        if (p[i].max_ns > max_ns) max_ns = p[i].max_ns;
+        legacy_ms += p[i].legacy_ms;
+    }
+    int64_t *all = malloc(sizeof(int64_t) * (size_t)(n ? n : 1));
+    long k = 0;
+    for (int i = 0; i < producers; ++i) {
+        long m = p[i].posts < p[i].lat_cap ? p[i].posts : p[i].lat_cap;
+        memcpy(all + k, p[i].lat_ns, sizeof(int64_t) * (size_t)m);
+        k += m;
+    }
+    qsort(all, (size_t)n, sizeof(int64_t), cmp_i64);
+
+    uint32_t played = 0;
+    for (int i = 0; i < FB_COUNT; ++i) played += g_seq.played[i];
+    long accounted = (long)atomic_load(&g_seq.coalesced) + (long)played + (long)g_seq.dropped;
+    printf("stress: %d productores, %.1f s, %ld pedidos (%.0f/s)\n", producers, g_seconds, posts, posts / g_seconds);
+    printf("  fb_post: p50=%lld ns p99=%lld ns p99.9=%lld ns máx=%lld ns\n",
+           n ? (long long)all[n / 2] : 0LL, n ? (long long)all[(long)(n * 0.99)] : 0LL,
+           n ? (long long)all[(long)(n * 0.999)] : 0LL, (long long)max_ns);
+    printf("  antes (beep_*/led_show_denied bloqueantes): %.1f ms de media por pedido, %.1f s en total\n",
+           posts ? (double)legacy_ms / posts : 0.0, legacy_ms / 1000.0);
+    printf("  iniciados=%u (completos %u, interrumpidos %u) descartados=%u fundidos=%u\n",
+           played, g_seq.completed, g_seq.preempted, g_seq.dropped, (unsigned)atomic_load(&g_seq.coalesced));
+    int rc = 0;
+    if (accounted != posts) {
+        printf("  ERROR: pedidos=%ld pero fundidos+iniciados+descartados=%ld\n", posts, accounted);
+        rc = 1;
+    }
+    if (played != g_seq.completed + g_seq.preempted) {
+        printf("  ERROR: iniciados=%u != completos+interrumpidos=%u\n", played, g_seq.completed + g_seq.preempted);
+        rc = 1;
+    }
+    if (max_ns >= 30 * 1000000LL) {
+        printf("  ERROR: un productor esperó %lld us (>= paso más corto)\n", (long long)(max_ns / 1000));
+        rc = 1;
+    }
+    for (int i = 0; i < producers; ++i) free(p[i].lat_ns);
+    free(all);
+    free(p);
+    free(th);
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    int producers = 3;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--producers") && i + 1 < argc) producers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) g_seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--gap-us") && i + 1 < argc) g_gap_us = atol(argv[++i]);
+        else {
+            fprintf(stderr, "uso: %s [--producers N] [--seconds S] [--gap-us US]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (producers < 1 || producers > 64 || g_seconds <= 0) return 2;
+    check_rules();
+    if (g_fail) return 1;
+    return stress(producers);
+}
@@ -0,0 +1,256 @@
+/*
+ * fusion_check: pruebas en host del motor de fusión de credenciales
+ * (main/cred_fusion.c) con flujos sintéticos.
+ *
+ * 1) Escenarios: secuencias guionizadas con el resultado esperado de cada
+ *    credencial (tarjeta y código separados por segundos, factor caducado,
+ *    misma tarjeta dos veces en dos personas, remoto en bypass...).
+ * 2) Aleatorio (--random N): flujos de N credenciales por regla con
+ *    intervalos aleatorios alrededor de la ventana, comparados paso a paso
+ *    con un modelo de referencia que recorre todo el historial.
+ * 3) Rendimiento: ns por credencial ofrecida (expulsión incluida).
+ *
+ * Compilar: make -C tools fusion_check   (binario en tools/build/)
+ * Ejemplo:  tools/build/fusion_check --random 2000000
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cred_fusion.h"
+#include "tool_util.h"
+
+#define S(x) ((int64_t)(x) * 1000000)   // Segundos -> us
+
+static cred_rec_t rec_of(cred_method_t m, int card)
+{
+    cred_rec_t r = { .method = (uint8_t)m };
+    if (m == CRED_RFID) {
+        r.id_len = 4;
+        r.id[0] = 0xEA; r.id[3] = (uint8_t)card;
+    }
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// 1) Escenarios
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int64_t t;
+    cred_method_t m;
+    int card;
+    fusion_result_t want;
+} step_t;
+
+typedef struct {
+    const char *name;
+    fusion_rule_t rule;
+    uint8_t bypass;
+    int64_t window;
+    step_t steps[8];
+    int n;
+} scenario_t;
+
+#define P FUSION_PENDING
+#define G FUSION_GRANT
+#define BYP_REMOTE (1u << CRED_REMOTE)
+
+static const scenario_t k_scen[] = {
+    { "tarjeta y luego código (AND)", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(12), CRED_COMBO, 0, G } }, 2 },
+    { "código y luego tarjeta (AND)", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_COMBO, 0, P }, { S(5), CRED_RFID, 1, G } }, 2 },
+    { "tarjeta caducada (AND)", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(30), CRED_COMBO, 0, P }, { S(31), CRED_RFID, 1, G } }, 3 },
+    { "factor gastado no se reutiliza (AND)", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(1), CRED_COMBO, 0, G }, { S(2), CRED_COMBO, 0, P } }, 3 },
+    { "dos tarjetas no son RFID+PIN", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(1), CRED_RFID, 2, P } }, 2 },
+    { "remoto en bypass (AND)", FUSION_RULE_RFID_PIN, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(1), CRED_REMOTE, 0, G }, { S(2), CRED_COMBO, 0, G } }, 3 },
+    { "OR concede cada credencial", FUSION_RULE_ANY, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, G }, { S(0), CRED_COMBO, 0, G } }, 2 },
+    { "2-de-3 con remoto como factor", FUSION_RULE_2_OF_3, 0, S(30),
+      { { S(0), CRED_REMOTE, 0, P }, { S(10), CRED_REMOTE, 0, P }, { S(20), CRED_RFID, 1, G } }, 3 },
+    { "2-de-3 mismo método no basta", FUSION_RULE_2_OF_3, 0, S(30),
+      { { S(0), CRED_COMBO, 0, P }, { S(1), CRED_COMBO, 0, P }, { S(40), CRED_RFID, 1, P },
+        { S(41), CRED_COMBO, 0, G } }, 4 },
+    { "dos personas: misma tarjeta dos veces", FUSION_RULE_DUAL_PERSON, BYP_REMOTE, S(30),
+      { { S(0), CRED_RFID, 1, P }, { S(2), CRED_RFID, 1, P }, { S(3), CRED_COMBO, 0, P },
+        { S(4), CRED_RFID, 2, G } }, 4 },
+    { "dos personas fuera de ventana", FUSION_RULE_DUAL_PERSON, BYP_REMOTE, S(10),
+      { { S(0), CRED_RFID, 1, P }, { S(10), CRED_RFID, 2, P }, { S(11), CRED_RFID, 1, G } }, 3 },
+};
+
+static void run_scenarios(void)
+{
+    int n = (int)(sizeof(k_scen) / sizeof(k_scen[0]));
+    for (int i = 0; i < n; ++i) {
+        const scenario_t *sc = &k_scen[i];
+        fusion_cfg_t cfg = { .rule = sc->rule, .window_us = sc->window, .bypass_mask = sc->bypass };
+        fusion_t f;
+        fusion_init(&f, &cfg);
+        bool ok = true;
+        for (int k = 0; k < sc->n; ++k) {
+            cred_rec_t r = rec_of(sc->steps[k].m, sc->steps[k].card);
+            fusion_result_t got = fusion_offer(&f, &r, sc->steps[k].t);
+            if (got != sc->steps[k].want) {
+                fprintf(stderr, "FALLO escenario \"%s\" paso %d: %s, esperado %s\n", sc->name, k,
+                        got == G ? "GRANT" : "PENDING", sc->steps[k].want == G ? "GRANT" : "PENDING");
+                ok = false;
+                g_fail = 1;
+                break;
+            }
+        }
+        printf("  [%s] %s\n", ok ? "ok" : "FALLO", sc->name);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 2) Comparación aleatoria con el modelo de referencia
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int64_t t;
+    cred_method_t m;
+    int card;
+    bool live;
+} ref_ent_t;
+
+// Vigentes en el modelo: vivas, dentro de la ventana y entre las FUSION_MAX últimas vivas
+static int ref_live(ref_ent_t *h, int n, int64_t now, int64_t win, int *idx)
+{
+    int c = 0;
+    for (int i = 0; i < n; ++i) {
+        if (h[i].live && h[i].t + win <= now) h[i].live = false;
+    }
+    for (int i = n - 1; i >= 0 && c < FUSION_MAX; --i) {
+        if (h[i].live) idx[c++] = i;
+    }
+    for (int i = 0; i < n; ++i) {
+        bool keep = false;
+        for (int k = 0; k < c; ++k) keep |= (idx[k] == i);
+        if (!keep) h[i].live = false;
+    }
+    return c;
+}
+
+static bool ref_rule(const ref_ent_t *h, const int *idx, int c, fusion_rule_t rule)
+{
+    int nm[CRED_METHOD_COUNT] = {0};
+    for (int k = 0; k < c; ++k) nm[h[idx[k]].m]++;
+    switch (rule) {
+    case FUSION_RULE_ANY:      return c > 0;
+    case FUSION_RULE_RFID_PIN: return nm[CRED_RFID] && nm[CRED_COMBO];
+    case FUSION_RULE_2_OF_3:   return (nm[0] > 0) + (nm[1] > 0) + (nm[2] > 0) >= 2;
+    case FUSION_RULE_DUAL_PERSON:
+        for (int a = 0; a < c; ++a)
+            for (int b = a + 1; b < c; ++b)
+                if (h[idx[a]].m == CRED_RFID && h[idx[b]].m == CRED_RFID &&
+                    h[idx[a]].card != h[idx[b]].card) return true;
+        return false;
+    default: return false;
+    }
+}
+
+static void run_random(long n_per_rule)
+{
+    const int64_t win = S(30);
+    ref_ent_t *h = malloc(sizeof(ref_ent_t) * (size_t)n_per_rule);
+    for (int rule = 0; rule < FUSION_RULE_COUNT && !g_fail; ++rule) {
+        for (int byp = 0; byp <= 1 && !g_fail; ++byp) {
+            fusion_cfg_t cfg = { .rule = (fusion_rule_t)rule, .window_us = win,
+                                 .bypass_mask = byp ? BYP_REMOTE : 0 };
+            fusion_t f;
+            fusion_init(&f, &cfg);
+            int64_t t = 0;
+            long grants = 0, n = 0, start = 0;
+            for (long i = 0; i < n_per_rule; ++i) {
+                // Intervalos: ráfagas (0-2 s) mezcladas con pausas cerca de la ventana
+                double p = rnd_u();
+                t += (p < 0.6) ? (int64_t)(rnd_u() * S(2)) : (p < 0.9) ? (int64_t)(rnd_u() * S(45)) : 0;
+                cred_method_t m = (cred_method_t)(rnd_u() * CRED_METHOD_COUNT);
+                int card = 1 + (int)(rnd_u() * 3);
+                cred_rec_t r = rec_of(m, card);
+                fusion_result_t got = fusion_offer(&f, &r, t);
+
+                bool want;
+                int idx[FUSION_MAX];
+                if (cfg.bypass_mask & (1u << m)) {
+                    want = true;
+                } else {
+                    h[n++] = (ref_ent_t){ t, m, m == CRED_RFID ? card : 0, true };
+                    int c = ref_live(h + start, (int)(n - start), t, win, idx);
+                    for (int k = 0; k < c; ++k) idx[k] += (int)start;
+                    want = ref_rule(h, idx, c, cfg.rule);
+                    if (want) for (int k = 0; k < c; ++k) h[idx[k]].live = false;
+                    // Avanza el inicio del historial para mantener el modelo acotado
+                    while (start < n && !h[start].live) start++;
+                }
+                if ((got == G) != want) {
+                    fprintf(stderr, "FALLO aleatorio regla %s bypass=%d paso %ld: %s, esperado %s\n",
+                            fusion_rule_name((fusion_rule_t)rule), byp, i,
+                            got == G ? "GRANT" : "PENDING", want ? "GRANT" : "PENDING");
+                    g_fail = 1;
+                    break;
+                }
+                grants += want;
+            }
+            if (!g_fail) {
+                printf("  [ok] %-11s bypass=%-6s %ld credenciales, %ld concesiones, %u caducadas, %u desplazadas\n",
+                       fusion_rule_name((fusion_rule_t)rule), byp ? "remoto" : "no", n_per_rule, grants,
+                       (unsigned)f.st.expired, (unsigned)f.st.displaced);
+            }
+        }
+    }
+    free(h);
+}
+
+// ---------------------------------------------------------------------------
+// 3) Rendimiento
+// ---------------------------------------------------------------------------
+
+static void bench(long n)
+{
+    fusion_cfg_t cfg = { .rule = FUSION_RULE_DUAL_PERSON, .window_us = S(30), .bypass_mask = 0 };
+    fusion_t f;
+    fusion_init(&f, &cfg);
+    int64_t t = 0;
+    uint32_t grants = 0;
+    clock_t c0 = clock();
+    for (long i = 0; i < n; ++i) {
+        t += (int64_t)(g_rng & 0x3FFFFF);  // ~0-4 s entre credenciales
+        rng_step(&g_rng);
+        cred_rec_t r = rec_of((cred_method_t)(g_rng % CRED_METHOD_COUNT), (int)(g_rng >> 40) & 7);
+        grants += fusion_offer(&f, &r, t) == G;
+    }
+    double dt = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    printf("rendimiento: %.1f ns/credencial (regla %s, %u concesiones, %u caducadas)\n",
+           dt * 1e9 / n, fusion_rule_name(cfg.rule), (unsigned)grants, (unsigned)f.st.expired);
+}
+
+int main(int argc, char **argv)
+{
+    long random_n = 200000;
+    long bench_n = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--random") && i + 1 < argc) random_n = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc) bench_n = atol(argv[++i]);
+        else {
+            fprintf(stderr, "uso: fusion_check [--random N (200000)] [--bench N]\n");
+            return 2;
+        }
+    }
+    printf("escenarios:\n");
+    run_scenarios();
+    if (random_n > 0) {
+        printf("aleatorio contra modelo de referencia:\n");
+        run_random(random_n);
+    }
+    if (g_fail) return 1;
+    if (bench_n > 0) bench(bench_n);
+    return 0;
+}
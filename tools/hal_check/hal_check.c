@@ -0,0 +1,230 @@
+/*
+ * hal_check: pruebas en host de los dispositivos virtuales del backend Linux
+ * de la HAL (main/hal_vdev.c), los que alimentan al firmware con
+ * `idf.py --preview set-target linux`.
+ *
+ * 1) Guion de sensores: instantes absolutos y relativos, comentarios,
+ *    payloads MQTT con espacios y '#', y líneas erróneas.
+ * 2) MFRC522 virtual con la misma secuencia de registros que
+ *    main/mfrc522_min.c: SoftReset, VersionReg, REQA + anticolisión con
+ *    tarjeta, silencio sin ella, vaciado del FIFO y tarjeta que sobrevive
+ *    al SoftReset.
+ * 3) Almacén clave-valor: guardar y cargar de nuevo, tipos y límites.
+ *
+ * Compilar: make -C tools hal_check   (binario en tools/build/)
+ * Ejemplo:  tools/build/hal_check
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_vdev.h"
+#include "tool_util.h"
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { printf("  FALLO "); printf(__VA_ARGS__); printf("\n"); g_fail++; } \
+    } while (0)
+
+// ---- Guion ----
+
+static int parse(const char *text, int64_t prev, vdev_cmd_t *c, char *line, char *err)
+{
+    snprintf(line, VDEV_LINE_MAX, "%s", text);
+    return vdev_parse_line(line, prev, c, err, 96);
+}
+
+static void script_checks(void)
+{
+    char line[VDEV_LINE_MAX], err[96];
+    vdev_cmd_t c;
+    int f = g_fail;
+
+    CHECK(parse("", 0, &c, line, err) == 0, "línea vacía");
+    CHECK(parse("   # comentario\n", 0, &c, line, err) == 0, "comentario");
+
+    CHECK(parse("0 gpio 27 1", 0, &c, line, err) == 1 && c.op == VDEV_OP_GPIO &&
+          c.at_ms == 0 && c.pin == 27 && c.value == 1, "gpio absoluto");
+    CHECK(parse("+250 adc 34 4095  # tope\r\n", 1000, &c, line, err) == 1 && c.op == VDEV_OP_ADC &&
+          c.at_ms == 1250 && c.pin == 34 && c.value == 4095, "adc relativo con comentario");
+    CHECK(parse("500 card EAE8D284 300", 0, &c, line, err) == 1 && c.op == VDEV_OP_CARD && c.card_on &&
+          c.uid[0] == 0xEA && c.uid[3] == 0x84 && c.value == 300 && c.pin == -1, "tarjeta con duración");
+    CHECK(parse("600 card@17 EAE8D284", 0, &c, line, err) == 1 && c.op == VDEV_OP_CARD && c.card_on &&
+          c.pin == 17 && c.value == 0, "tarjeta en el lector con CS 17");
+    CHECK(parse("+0 card -", 500, &c, line, err) == 1 && c.op == VDEV_OP_CARD && !c.card_on &&
+          c.at_ms == 500, "retirar tarjeta");
+    CHECK(parse("9000 mqtt iot/cmd {\"cmd\": \"unlock\", \"tag\": \"#1\"}\n", 0, &c, line, err) == 1 &&
+          c.op == VDEV_OP_MQTT && strcmp(c.topic, "iot/cmd") == 0 &&
+          strcmp(c.payload, "{\"cmd\": \"unlock\", \"tag\": \"#1\"}") == 0, "mqtt con espacios y '#'");
+    CHECK(parse("1 mqtt iot/ping", 0, &c, line, err) == 1 && c.payload[0] == '\0', "mqtt sin payload");
+    CHECK(parse("20000 exit", 0, &c, line, err) == 1 && c.op == VDEV_OP_EXIT && c.value == 0, "exit");
+    CHECK(parse("20000 exit 3", 0, &c, line, err) == 1 && c.value == 3, "exit con código");
+
+    static const char *bad[] = {
+        "-5 gpio 1 1", "x gpio 1 1", "10", "10 gpio 40 1", "10 gpio 4 2", "10 adc 34 4096",
+        "10 gpio 4 1 9", "10 card EAE8D2", "10 card EAE8D2ZZ", "10 card EAE8D284 0",
+        "10 card@ EAE8D284", "10 card@x EAE8D284", "10 card@40 -", "10 mqtt", "10 exit 256", "10 beep",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        err[0] = '\0';
+        CHECK(parse(bad[i], 0, &c, line, err) == -1 && err[0], "aceptada: \"%s\"", bad[i]);
+    }
+    printf("guion: %s\n", g_fail == f ? "ok" : "FALLA");
+}
+
+// ---- MFRC522: accesos como los de mfrc522_min.c ----
+
+#define CommandReg      0x01
+#define ComIrqReg       0x04
+#define ErrorReg        0x06
+#define FIFODataReg     0x09
+#define FIFOLevelReg    0x0A
+#define BitFramingReg   0x0D
+#define CollReg         0x0E
+#define TModeReg        0x2A
+#define VersionReg      0x37
+
+static void wr(vdev_rc522_t *d, uint8_t reg, uint8_t v)
+{
+    uint8_t tx[2] = { (uint8_t)((reg << 1) & 0x7E), v };
+    vdev_rc522_xfer(d, tx, NULL, 2);
+}
+
+static uint8_t rd(vdev_rc522_t *d, uint8_t reg)
+{
+    uint8_t tx[2] = { (uint8_t)(((reg << 1) & 0x7E) | 0x80), 0 };
+    uint8_t rx[2] = { 0 };
+    vdev_rc522_xfer(d, tx, rx, 2);
+    return rx[1];
+}
+
+// _transceive de mfrc522_min.c; el sondeo de ComIrqReg basta una vez
+static bool transceive(vdev_rc522_t *d, const uint8_t *tx, size_t n, uint8_t *rx, size_t *rx_len, uint8_t framing)
+{
+    wr(d, CommandReg, 0x00);
+    wr(d, ComIrqReg, 0x7F);
+    wr(d, FIFOLevelReg, rd(d, FIFOLevelReg) | 0x80);
+    wr(d, BitFramingReg, framing);
+    for (size_t i = 0; i < n; ++i) wr(d, FIFODataReg, tx[i]);
+    wr(d, CommandReg, 0x0C);
+    wr(d, BitFramingReg, rd(d, BitFramingReg) | 0x80);
+    if (!(rd(d, ComIrqReg) & 0x30)) return false;
+    wr(d, BitFramingReg, rd(d, BitFramingReg) & 0x7F);
+    if (rd(d, ErrorReg) & 0x13) return false;
+    uint8_t level = rd(d, FIFOLevelReg);
+    if (level == 0) return false;
+    size_t m = *rx_len < level ? *rx_len : level;
+    for (size_t i = 0; i < m; ++i) rx[i] = rd(d, FIFODataReg);
+    *rx_len = m;
+    return true;
+}
+
+static bool read_uid(vdev_rc522_t *d, uint8_t *uid4)
+{
+    uint8_t reqa = 0x26, atqa[2];
+    size_t n = sizeof(atqa);
+    wr(d, CollReg, 0x80);
+    if (!transceive(d, &reqa, 1, atqa, &n, 0x07)) return false;
+    uint8_t sel[2] = { 0x93, 0x20 }, r[5];
+    n = sizeof(r);
+    wr(d, CollReg, 0x80);
+    if (!transceive(d, sel, 2, r, &n, 0x00) || n < 5) return false;
+    if ((r[0] ^ r[1] ^ r[2] ^ r[3]) != r[4]) return false;
+    memcpy(uid4, r, 4);
+    return true;
+}
+
+static void rc522_checks(void)
+{
+    static const uint8_t card[4] = { 0xEA, 0xE8, 0xD2, 0x84 };
+    vdev_rc522_t d;
+    memset(&d, 0, sizeof(d));
+    vdev_rc522_init(&d);
+    int f = g_fail;
+    uint8_t uid[4];
+
+    wr(&d, CommandReg, 0x0F);
+    wr(&d, TModeReg, 0x8D);
+    CHECK(rd(&d, TModeReg) == 0x8D, "registro de configuración");
+    CHECK(rd(&d, VersionReg) == VDEV_RC522_VERSION, "VersionReg 0x%02X", rd(&d, VersionReg));
+    wr(&d, VersionReg, 0x00);
+    CHECK(rd(&d, VersionReg) == VDEV_RC522_VERSION, "VersionReg escribible");
+
+    CHECK(!read_uid(&d, uid) && d.answers == 0, "lectura sin tarjeta");
+    CHECK(rd(&d, ComIrqReg) & 0x01, "sin TimerIRq sin tarjeta");
+
+    vdev_rc522_card(&d, card);
+    CHECK(read_uid(&d, uid) && memcmp(uid, card, 4) == 0, "UID leído");
+    CHECK(d.frames == 3 && d.answers == 2, "tramas %u, respuestas %u", d.frames, d.answers);
+
+    // Restos en el FIFO: la siguiente transacción los vacía antes de enviar
+    wr(&d, FIFODataReg, 0xAA);
+    wr(&d, FIFODataReg, 0xBB);
+    CHECK(rd(&d, FIFOLevelReg) == 2, "nivel del FIFO");
+    CHECK(read_uid(&d, uid) && memcmp(uid, card, 4) == 0, "UID tras restos en el FIFO");
+
+    wr(&d, CommandReg, 0x0F);
+    CHECK(rd(&d, TModeReg) == 0x00 && rd(&d, FIFOLevelReg) == 0, "SoftReset no limpia");
+    CHECK(read_uid(&d, uid) && memcmp(uid, card, 4) == 0, "tarjeta perdida tras SoftReset");
+
+    vdev_rc522_card(&d, NULL);
+    CHECK(!read_uid(&d, uid), "tarjeta retirada sigue respondiendo");
+    printf("mfrc522 virtual: %s (%u tramas, %u respondidas)\n", g_fail == f ? "ok" : "FALLA", d.frames, d.answers);
+}
+
+// ---- Clave-valor ----
+
+static void kv_checks(void)
+{
+    static vdev_kv_t kv, back;
+    memset(&kv, 0, sizeof(kv));
+    int f = g_fail;
+    char s[VDEV_KV_STR_MAX + 1];
+    int32_t v;
+
+    CHECK(vdev_kv_set_i32(&kv, "cfg_ver", 7), "set_i32");
+    CHECK(vdev_kv_set_i32(&kv, "neg", -123456), "set_i32 negativo");
+    CHECK(vdev_kv_set_str(&kv, "wifi_ssid", "Casa de Ana 5G"), "set_str con espacios");
+    CHECK(vdev_kv_set_str(&kv, "empty", ""), "set_str vacío");
+    CHECK(vdev_kv_set_i32(&kv, "cfg_ver", 8) && kv.n == 4, "sobrescribir no añade");
+    CHECK(!vdev_kv_set_str(&kv, "bad", "dos\nlíneas"), "salto de línea aceptado");
+    CHECK(!vdev_kv_set_i32(&kv, "clave_de_16_char", 1), "clave de 16 caracteres aceptada");
+    CHECK(!vdev_kv_set_i32(&kv, "con espacio", 1), "clave con espacio aceptada");
+    CHECK(!vdev_kv_get_str(&kv, "cfg_ver", s, sizeof(s)), "tipo cruzado");
+    CHECK(!vdev_kv_get_str(&kv, "wifi_ssid", s, 4), "cadena truncada");
+
+    FILE *fp = tmpfile();
+    if (!fp) { perror("tmpfile"); g_fail++; return; }
+    CHECK(vdev_kv_save(&kv, fp), "guardar");
+    fputs("basura sin formato\ni roto 12x\n", fp);
+    rewind(fp);
+    memset(&back, 0xA5, sizeof(back));
+    int n = vdev_kv_load(&back, fp);
+    fclose(fp);
+    CHECK(n == 4 && back.n == 4, "cargadas %d claves", n);
+    CHECK(vdev_kv_get_i32(&back, "cfg_ver", &v) && v == 8, "cfg_ver");
+    CHECK(vdev_kv_get_i32(&back, "neg", &v) && v == -123456, "neg");
+    CHECK(vdev_kv_get_str(&back, "wifi_ssid", s, sizeof(s)) && strcmp(s, "Casa de Ana 5G") == 0, "wifi_ssid");
+    CHECK(vdev_kv_get_str(&back, "empty", s, sizeof(s)) && s[0] == '\0', "empty");
+    CHECK(!vdev_kv_get_i32(&back, "roto", &v), "línea mal formada cargada");
+
+    for (int i = back.n; i < VDEV_KV_MAX; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        vdev_kv_set_i32(&back, key, i);
+    }
+    CHECK(back.n == VDEV_KV_MAX && !vdev_kv_set_i32(&back, "otra", 1), "almacén lleno");
+    printf("clave-valor: %s\n", g_fail == f ? "ok" : "FALLA");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        fprintf(stderr, "uso: %s\n", argv[0]);
+        return 2;
+    }
+    script_checks();
+    rc522_checks();
+    kv_checks();
+    return g_fail ? 1 : 0;
+}
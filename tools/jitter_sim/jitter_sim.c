@@ -0,0 +1,380 @@
+/*
+ * jitter_sim: retraso de despertar de las tareas del firmware con y sin el
+ * plan de tareas (main/task_plan.h), bajo carga de red sintética.
+ *
+ * Modelo de los dos núcleos del ESP32 con el planificador de ESP-IDF:
+ * prioridades fijas con expropiación, cada núcleo ejecuta la tarea lista de
+ * más prioridad que le está permitida (fijada a él o sin afinidad) y las
+ * esperas vencen en los ticks de 10 ms. Tareas y costes de CPU:
+ *   wifi (23, núcleo 0)  150 us por paquete   -> lwip (18) 400 us -> mqtt (5) 300 us
+ *   esp_timer (22, núcleo 0) 50 us por evento de puerta o plazo -> control
+ *   netload (18) CPU ocupada --busy-us de cada 50 ms, como JITTER_BENCH
+ *   control 1000 us por evento (--rate por segundo) -> lcd 2000 us
+ *   pot cada 120 ms 300 us; rfid 150 ms tras cada sondeo de 1500 us
+ * La red llega en ráfagas (--bursts por segundo de --burst paquetes).
+ *
+ * Dos disposiciones:
+ *   antes  todas sin afinidad salvo WiFi y esp_timer; control 7, pot 5,
+ *          rfid 4, lcd 3 (las prioridades "a mano" anteriores)
+ *   plan   lwIP y netload en el núcleo 0; la aplicación en el 1 con
+ *          las prioridades de task_plan_assign() sobre la tabla de main.c;
+ *          MQTT sin afinidad con su prioridad 5
+ * Retraso (jitter.h): periódicas, desde el tick en que vence la espera hasta
+ * que la tarea ejecuta; por eventos, desde la publicación.
+ *
+ * --check comprueba task_plan_assign() (plazos iguales, banda llena) y
+ * jitter.c (percentiles, origen del tick); devuelve 1 ante un fallo.
+ *
+ * Compilar: make -C tools jitter_sim   (binario en tools/build/)
+ * Ejemplos: tools/build/jitter_sim
+ *           tools/build/jitter_sim --minutes 60 --bursts 40 --busy-us 15000
+ *           tools/build/jitter_sim --check
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jitter.h"
+#include "task_plan.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define TICK_US 10000
+
+// ---- Tareas ----
+typedef enum { T_WIFI = 0, T_TIMER, T_LWIP, T_NETLOAD, T_MQTT, T_CONTROL, T_POT, T_RFID, T_LCD, T_COUNT } task_t;
+
+typedef struct {
+    int64_t release, work;
+    bool started;
+} job_t;
+
+#define JOBS_MAX 256
+
+typedef struct {
+    const char *name;
+    int prio;
+    int core;                  // -1: sin afinidad
+    job_t q[JOBS_MAX];         // Trabajos pendientes (FIFO)
+    int head, n;
+    int running_on;            // Núcleo que la ejecuta (-1: ninguno)
+    int last_core;
+    int64_t period_us;         // Periódicas: espera tras cada trabajo (0: por eventos)
+    int64_t cost_us;
+    jitter_t jit;
+    uint32_t dropped;
+} sim_task_t;
+
+typedef struct {
+    int64_t minutes;
+    double bursts, rate;
+    int burst;
+    int64_t busy_us;
+} load_t;
+
+typedef struct {
+    sim_task_t t[T_COUNT];
+    int run[2];                // Tarea en cada núcleo (-1: IDLE)
+    int64_t now;
+    int64_t next_burst, next_cred, next_busy;
+} sim_t;
+
+static void job_push(sim_t *s, task_t id, int64_t release, int64_t work)
+{
+    sim_task_t *t = &s->t[id];
+    if (t->n == JOBS_MAX) { t->dropped++; return; }
+    t->q[(t->head + t->n++) % JOBS_MAX] = (job_t){ release, work, false };
+}
+
+// Tick en que vence una espera de ticks iniciada en t (vTaskDelay)
+static int64_t wake_tick(int64_t t, int64_t ticks)
+{
+    return (t / TICK_US + ticks) * TICK_US;
+}
+
+// Trabajo terminado: encadena el siguiente de la tubería
+static void job_done(sim_t *s, task_t id)
+{
+    sim_task_t *t = &s->t[id];
+    t->head = (t->head + 1) % JOBS_MAX;
+    t->n--;
+    switch (id) {
+    case T_WIFI:    job_push(s, T_LWIP, s->now, 400); break;
+    case T_LWIP:    if (urand() < 0.5) job_push(s, T_MQTT, s->now, 300); break;
+    case T_TIMER:   job_push(s, T_CONTROL, s->now, 1000); break;
+    case T_CONTROL: job_push(s, T_LCD, s->now, 2000); break;
+    case T_POT:
+    case T_RFID:
+        job_push(s, id, wake_tick(s->now, t->period_us / TICK_US), t->cost_us);
+        break;
+    default: break;
+    }
+}
+
+// Orden de reparto: más prioridad primero; a igualdad, la que ya corría
+// (una tarea no expulsa a otra de su misma prioridad)
+static bool goes_first(const sim_t *s, int a, int b, const bool *was)
+{
+    return s->t[a].prio > s->t[b].prio || (s->t[a].prio == s->t[b].prio && was[a] && !was[b]);
+}
+
+// Reparto: por prioridad, cada tarea lista al núcleo permitido libre
+// (preferencia por el último en que corrió)
+static void dispatch(sim_t *s)
+{
+    int order[T_COUNT], n = 0;
+    bool was[T_COUNT];
+    for (int i = 0; i < T_COUNT; ++i) {
+        was[i] = s->t[i].running_on >= 0;
+        s->t[i].running_on = -1;
+        if (s->t[i].n && s->t[i].q[s->t[i].head].release <= s->now) order[n++] = i;
+    }
+    for (int i = 1; i < n; ++i) {
+        for (int j = i; j > 0 && goes_first(s, order[j], order[j - 1], was); --j) {
+            int x = order[j]; order[j] = order[j - 1]; order[j - 1] = x;
+        }
+    }
+    bool used[2] = { false, false };
+    for (int k = 0; k < n; ++k) {
+        sim_task_t *t = &s->t[order[k]];
+        int c = -1;
+        if (t->core >= 0) c = used[t->core] ? -1 : t->core;
+        else if (!used[t->last_core]) c = t->last_core;
+        else if (!used[1 - t->last_core]) c = 1 - t->last_core;
+        if (c < 0) continue;
+        used[c] = true;
+        t->running_on = c;
+        t->last_core = c;
+        job_t *j = &t->q[t->head];
+        if (!j->started) {
+            j->started = true;
+            jitter_add(&t->jit, s->now - j->release);
+        }
+    }
+    for (int c = 0; c < 2; ++c) s->run[c] = -1;
+    for (int i = 0; i < T_COUNT; ++i) {
+        if (s->t[i].running_on >= 0) s->run[s->t[i].running_on] = i;
+    }
+}
+
+static int64_t next_release(const sim_t *s)
+{
+    int64_t m = INT64_MAX;
+    for (int i = 0; i < T_COUNT; ++i) {
+        const sim_task_t *t = &s->t[i];
+        if (t->n && t->running_on < 0 && t->q[t->head].release > s->now && t->q[t->head].release < m) m = t->q[t->head].release;
+    }
+    return m;
+}
+
+static void sim_run(sim_t *s, const load_t *ld)
+{
+    int64_t end = MS(60000) * ld->minutes;
+    s->next_burst = exp_us(1e6 / ld->bursts);
+    s->next_cred = exp_us(1e6 / ld->rate);
+    s->next_busy = MS(50);
+    job_push(s, T_POT, MS(3), s->t[T_POT].cost_us);
+    job_push(s, T_RFID, MS(7), s->t[T_RFID].cost_us);
+    dispatch(s);
+    while (s->now < end) {
+        int64_t next = next_release(s);
+        if (s->next_burst < next) next = s->next_burst;
+        if (s->next_cred < next) next = s->next_cred;
+        if (ld->busy_us && s->next_busy < next) next = s->next_busy;
+        for (int c = 0; c < 2; ++c) {
+            if (s->run[c] < 0) continue;
+            const sim_task_t *t = &s->t[s->run[c]];
+            int64_t fin = s->now + t->q[t->head].work;
+            if (fin < next) next = fin;
+        }
+        int64_t dt = next - s->now;
+        s->now = next;
+        for (int c = 0; c < 2; ++c) {
+            if (s->run[c] < 0) continue;
+            sim_task_t *t = &s->t[s->run[c]];
+            t->q[t->head].work -= dt;
+            if (t->q[t->head].work <= 0) job_done(s, (task_t)s->run[c]);
+        }
+        if (s->now >= s->next_burst) {
+            for (int k = 0; k < ld->burst; ++k) job_push(s, T_WIFI, s->now + 200 * k, 150);
+            s->next_burst = s->now + exp_us(1e6 / ld->bursts);
+        }
+        if (s->now >= s->next_cred) {
+            job_push(s, T_TIMER, s->now, 50);
+            s->next_cred = s->now + exp_us(1e6 / ld->rate);
+        }
+        if (ld->busy_us && s->now >= s->next_busy) {
+            job_push(s, T_NETLOAD, s->now, ld->busy_us);
+            s->next_busy += MS(50);
+        }
+        dispatch(s);
+    }
+}
+
+// ---- Disposiciones ----
+
+// Tabla de main.c (g_tasks): el plan deriva las prioridades de los plazos
+static task_spec_t g_plan[] = {
+    { .name = "control", .deadline_ms = 20,   .core = TASK_CORE_APP, .stack = 4096 },
+    { .name = "pot",     .deadline_ms = 120,  .core = TASK_CORE_APP, .stack = 4096 },
+    { .name = "rfid",    .deadline_ms = 150,  .core = TASK_CORE_APP, .stack = 4096 },
+    { .name = "lcd",     .deadline_ms = 250,  .core = TASK_CORE_APP, .stack = 3072 },
+    { .name = "prof",    .deadline_ms = 1000, .core = TASK_CORE_ANY, .stack = 4096 },
+    { .name = "boot",    .deadline_ms = 1000, .core = TASK_CORE_ANY, .stack = 4096 },
+};
+#define PLAN_N ((int)(sizeof(g_plan) / sizeof(g_plan[0])))
+
+static void sim_init(sim_t *s, bool plan)
+{
+    memset(s, 0, sizeof(*s));
+    static const struct { const char *name; int prio, core; } BEFORE[T_COUNT] = {
+        [T_WIFI] = { "wifi", 23, 0 },     [T_TIMER] = { "esp_timer", 22, 0 }, [T_LWIP] = { "lwip", 18, -1 },
+        [T_NETLOAD] = { "netload", 18, -1 }, [T_MQTT] = { "mqtt", 5, -1 }, [T_CONTROL] = { "control", 7, -1 },
+        [T_POT] = { "pot", 5, -1 },       [T_RFID] = { "rfid", 4, -1 },      [T_LCD] = { "lcd", 3, -1 },
+    };
+    for (int i = 0; i < T_COUNT; ++i) {
+        sim_task_t *t = &s->t[i];
+        t->name = BEFORE[i].name;
+        t->prio = BEFORE[i].prio;
+        t->core = BEFORE[i].core;
+        t->last_core = i % 2;
+        jitter_init(&t->jit);
+    }
+    s->t[T_POT].period_us = MS(120);
+    s->t[T_POT].cost_us = 300;
+    s->t[T_RFID].period_us = MS(150);
+    s->t[T_RFID].cost_us = 1500;
+    if (!plan) return;
+    // MQTT sigue sin afinidad (sdkconfig.defaults): fijado al 0 esperaba a WiFi,
+    // lwIP y netload; en el 1, con prioridad 5, solo compite con rfid y lcd
+    s->t[T_LWIP].core = s->t[T_NETLOAD].core = TASK_CORE_NET;
+    static const task_t APP[] = { T_CONTROL, T_POT, T_RFID, T_LCD };
+    for (size_t k = 0; k < sizeof(APP) / sizeof(APP[0]); ++k) {
+        const task_spec_t *p = &g_plan[task_plan_find(g_plan, PLAN_N, s->t[APP[k]].name)];
+        s->t[APP[k]].prio = p->prio;
+        s->t[APP[k]].core = p->core;
+    }
+}
+
+static void print_row(const char *name, const jitter_t *a, const jitter_t *b)
+{
+    printf("  %-9s %8.2f %8.2f %8.2f   %8.2f %8.2f %8.2f\n", name, jitter_pct_us(a, 0.50) / 1000.0,
+           jitter_pct_us(a, 0.99) / 1000.0, a->max_us / 1000.0, jitter_pct_us(b, 0.50) / 1000.0,
+           jitter_pct_us(b, 0.99) / 1000.0, b->max_us / 1000.0);
+}
+
+static int run_bench(const load_t *ld, unsigned seed)
+{
+    static sim_t before, plan;
+    g_rng = 0x9E3779B97F4A7C15ULL ^ seed;
+    sim_init(&before, false);
+    sim_run(&before, ld);
+    g_rng = 0x9E3779B97F4A7C15ULL ^ seed;
+    sim_init(&plan, true);
+    sim_run(&plan, ld);
+
+    printf("jitter_sim: %lld min, %.0f ráfagas/s de %d paquetes, netload %lld us cada 50 ms, %.1f eventos/s\n",
+           (long long)ld->minutes, ld->bursts, ld->burst, (long long)ld->busy_us, ld->rate);
+    printf("  prioridades del plan:");
+    for (int i = 0; i < PLAN_N; ++i) printf(" %s %u%s", g_plan[i].name, g_plan[i].prio, i + 1 < PLAN_N ? "," : "\n");
+    printf("  %-9s %26s   %26s\n", "retraso", "antes (ms) p50/p99/máx", "plan (ms) p50/p99/máx");
+    static const task_t SHOWN[] = { T_CONTROL, T_POT, T_RFID, T_LCD, T_LWIP, T_MQTT };
+    for (size_t k = 0; k < sizeof(SHOWN) / sizeof(SHOWN[0]); ++k) {
+        print_row(before.t[SHOWN[k]].name, &before.t[SHOWN[k]].jit, &plan.t[SHOWN[k]].jit);
+    }
+    for (int i = 0; i < T_COUNT; ++i) {
+        check(!before.t[i].dropped && !plan.t[i].dropped, "cola de trabajos desbordada (carga imposible)");
+    }
+    // En el plan, la aplicación no espera nunca a la red: solo a sí misma
+    int64_t app_max = 1000 + 2000 + 300 + 1500;
+    check(plan.t[T_CONTROL].jit.max_us <= app_max, "control espera más que el trabajo de la aplicación en el plan");
+    check(jitter_pct_us(&plan.t[T_CONTROL].jit, 0.99) <= jitter_pct_us(&before.t[T_CONTROL].jit, 0.99),
+          "el plan empeora el p99 de control");
+    check(jitter_pct_us(&plan.t[T_MQTT].jit, 0.99) <= jitter_pct_us(&before.t[T_MQTT].jit, 0.99),
+          "el plan empeora el p99 de MQTT");
+    return g_fail;
+}
+
+// ---- Comprobaciones ----
+
+static void run_checks(void)
+{
+    printf("task_plan_assign:\n");
+    check(task_plan_assign(g_plan, PLAN_N, 3, 7), "la tabla de main.c no cabe en 3..7");
+    static const uint8_t WANT[] = { 7, 6, 5, 4, 3, 3 };
+    for (int i = 0; i < PLAN_N; ++i) check(g_plan[i].prio == WANT[i], "prioridad de la tabla de main.c");
+    task_spec_t tie[] = { { .name = "a", .deadline_ms = 50 }, { .name = "b", .deadline_ms = 10 },
+                          { .name = "c", .deadline_ms = 50 }, { .name = "d", .deadline_ms = 10 },
+                          { .name = "e", .deadline_ms = 90 } };
+    check(task_plan_assign(tie, 5, 1, 3), "tres plazos distintos caben en 1..3");
+    check(tie[1].prio == 3 && tie[3].prio == 3 && tie[0].prio == 2 && tie[2].prio == 2 && tie[4].prio == 1,
+          "plazos iguales comparten prioridad");
+    tie[4].prio = 99;
+    check(!task_plan_assign(tie, 5, 2, 3), "tres plazos no caben en dos niveles");
+    check(tie[4].prio == 99, "sin sitio, las prioridades quedan sin tocar");
+    check(task_plan_find(tie, 5, "d") == 3 && task_plan_find(tie, 5, "z") == -1, "task_plan_find");
+
+    printf("jitter:\n");
+    jitter_t j;
+    jitter_init(&j);
+    check(jitter_pct_us(&j, 0.99) == 0, "sin muestras, percentil 0");
+    for (int i = 0; i < 99; ++i) jitter_add(&j, 30);
+    jitter_add(&j, 7000);
+    check(jitter_pct_us(&j, 0.50) == 50 && jitter_pct_us(&j, 0.99) == 50, "percentiles por cubo");
+    check(jitter_pct_us(&j, 1.0) == 7000 && j.max_us == 7000, "el último percentil es el máximo");
+    char buf[128];
+    check(jitter_json(&j, buf, sizeof(buf)) > 0 && strstr(buf, "\"p99_us\":50"), "jitter_json");
+    check(jitter_json(&j, buf, 10) == 0, "jitter_json sin sitio");
+    // Tick con desfase de 3217 us; el primer despertar llega 900 us tarde
+    jitter_init(&j);
+    const int64_t phase = 3217;
+    jitter_wake(&j, 10 * TICK_US + phase + 900, 10, TICK_US);
+    for (uint32_t k = 11; k < 1000; ++k) jitter_wake(&j, (int64_t)k * TICK_US + phase + (k % 10 == 0 ? 4000 : 0), k, TICK_US);
+    check(j.offset_us == phase, "origen del tick: el despertar más temprano");
+    check(j.max_us == 4000, "retraso medido desde el tick");
+    check(j.hist[0] >= 890, "despertares puntuales en el primer cubo");
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones]\n"
+            "  --minutes M      duración virtual (10)\n"
+            "  --bursts N       ráfagas de red por segundo (20)\n"
+            "  --burst K        paquetes por ráfaga (8)\n"
+            "  --busy-us US     netload: CPU ocupada cada 50 ms, 0 sin ella (8000, NETLOAD_BUSY_US)\n"
+            "  --rate N         eventos de puerta o credencial por segundo (2)\n"
+            "  --seed S         semilla (1)\n"
+            "  --check          pruebas de task_plan y jitter\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    load_t ld = { .minutes = 10, .bursts = 20, .burst = 8, .busy_us = 8000, .rate = 2 };
+    unsigned seed = 1;
+    bool only_check = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--check")) { only_check = true; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--minutes")) ld.minutes = atoi(v);
+        else if (!strcmp(a, "--bursts")) ld.bursts = atof(v);
+        else if (!strcmp(a, "--burst")) ld.burst = atoi(v);
+        else if (!strcmp(a, "--busy-us")) ld.busy_us = atoi(v);
+        else if (!strcmp(a, "--rate")) ld.rate = atof(v);
+        else if (!strcmp(a, "--seed")) seed = arg_seed(v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (ld.minutes < 1 || ld.bursts <= 0 || ld.burst < 1 || ld.busy_us < 0 || ld.busy_us >= MS(50) || ld.rate <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    run_checks();
+    if (only_check) return g_fail;
+    return run_bench(&ld, seed);
+}
@@ -0,0 +1,208 @@
+/*
+ * lcd_bench: coste en bus I2C de las transiciones típicas del LCD1602
+ * (bienvenida -> progreso de combinación -> concedido -> LOCKING -> ...),
+ * con tres drivers:
+ *   - antes: cada mensaje era lcd_clear() (0x01 + 0x02 con 3 + 2 ms de
+ *     espera) y 2 x (cursor + 16 caracteres), byte a byte;
+ *   - diff: solo lo que difiere de la sombra (main/lcd_frame.c), aún byte
+ *     a byte;
+ *   - lotes: el diff empaquetado por main/lcd_xfer.c en una sola escritura.
+ *
+ * Modelo del driver byte a byte (lcd_write_byte a I2C_FREQ_HZ = 50 kHz):
+ *   - Cada byte del HD44780 son 2 nibbles; cada nibble, 3 transacciones
+ *     I2C de 1 byte (dato, EN=1, EN=0): START + dirección + dato + STOP.
+ *   - Esperas activas: 5 + 50 + 100 us por nibble y 200 us por byte.
+ *   - Las esperas de lcd_clear() se cuentan por su valor nominal.
+ * Con lotes no hay esperas activas: una transacción con los bytes que da
+ * lcd_xfer (esperas incluidas como relleno) durante la que lcd_task duerme.
+ * Los bytes son los del cable (dirección incluida).
+ *
+ * Compilar: make -C tools lcd_bench   (binario en tools/build/)
+ * Ejemplo:  tools/build/lcd_bench
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lcd_frame.h"
+#include "lcd_xfer.h"
+
+#define I2C_FREQ_HZ        50000
+#define NIBBLE_TXNS        3
+#define NIBBLE_SPIN_US     (5 + 50 + 100)
+#define BYTE_SPIN_US       200
+#define CLEAR_SLEEP_US     3000
+#define HOME_SLEEP_US      2000
+
+typedef struct {
+    unsigned ops;            // Bytes para el HD44780 (instrucción o dato)
+    unsigned txns;           // Transacciones I2C
+    unsigned wire_bytes;     // Bytes en el cable
+    double bus_us;           // Tiempo de bus
+    double spin_us;          // Esperas activas (CPU ocupada)
+    double sleep_us;         // Esperas con vTaskDelay
+} cost_t;
+
+static double txn_us(unsigned payload)
+{
+    // START + (dirección + payload) x 9 bits + STOP
+    return (1 + 9.0 * (1 + payload) + 1) * 1e6 / I2C_FREQ_HZ;
+}
+
+static void cost_op_legacy(cost_t *c, const lcd_op_t *op)
+{
+    c->ops++;
+    c->txns += 2 * NIBBLE_TXNS;
+    c->wire_bytes += 2 * NIBBLE_TXNS * 2;
+    c->bus_us += 2 * NIBBLE_TXNS * txn_us(1);
+    c->spin_us += 2 * NIBBLE_SPIN_US + BYTE_SPIN_US;
+    if (op->kind == LCD_OP_CMD && op->val == LCD_CMD_CLEAR) c->sleep_us += CLEAR_SLEEP_US;
+    if (op->kind == LCD_OP_CMD && op->val == LCD_CMD_HOME) c->sleep_us += HOME_SLEEP_US;
+}
+
+// Lo mismo en una transferencia de lcd_xfer (variante 0)
+static void cost_batched(cost_t *c, const lcd_op_t *ops, size_t n)
+{
+    static lcd_xfer_t x;
+    lcd_xfer_init(&x, &lcd_pinmaps[0], I2C_FREQ_HZ);
+    while (n > 0) {
+        size_t k = lcd_xfer_ops(&x, ops, n);
+        c->ops += (unsigned)k;
+        c->txns++;
+        c->wire_bytes += x.len + 1u;
+        c->bus_us += lcd_xfer_bus_us(&x);
+        lcd_xfer_reset(&x);
+        ops += k;
+        n -= k;
+    }
+}
+
+static void cost_add(cost_t *t, const cost_t *c)
+{
+    t->ops += c->ops; t->txns += c->txns; t->wire_bytes += c->wire_bytes;
+    t->bus_us += c->bus_us; t->spin_us += c->spin_us; t->sleep_us += c->sleep_us;
+}
+
+static double cost_ms(const cost_t *c)
+{
+    return (c->bus_us + c->spin_us + c->sleep_us) / 1000.0;
+}
+
+// Lo que hacía lcd_task antes: clear + home, cursor y 16 caracteres por fila
+static size_t legacy_ops(const char frame[LCD_ROWS][LCD_COLS], lcd_op_t *ops)
+{
+    size_t n = 0;
+    ops[n++] = (lcd_op_t){ LCD_OP_CMD, LCD_CMD_CLEAR };
+    ops[n++] = (lcd_op_t){ LCD_OP_CMD, LCD_CMD_HOME };
+    for (int r = 0; r < LCD_ROWS; ++r) {
+        ops[n++] = (lcd_op_t){ LCD_OP_CMD, (uint8_t)(LCD_CMD_SET_DDRAM | lcd_ddram_addr(0, (uint8_t)r)) };
+        for (int c = 0; c < LCD_COLS; ++c) ops[n++] = (lcd_op_t){ LCD_OP_DATA, (uint8_t)frame[r][c] };
+    }
+    return n;
+}
+
+typedef struct {
+    const char *l1, *l2;
+} msg_t;
+
+// Secuencia típica: combinación correcta de 3 dígitos, acceso, bloqueo
+static const msg_t k_msgs[] = {
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+    { "CURRENT PASS:",  "3 # #" },
+    { "CURRENT PASS:",  "3 6 #" },
+    { "CURRENT PASS:",  "3 6 4" },
+    { "ACCESS GRANTED!", "WELCOME HOME" },
+    { "LOCKING...",     "" },
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+    { "ACCESS DENIED!", "" },
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+};
+#define N_MSGS (sizeof(k_msgs) / sizeof(k_msgs[0]))
+
+// Aplica las operaciones a una pantalla simulada (comprobación del diff)
+static void apply_ops(char screen[LCD_ROWS][LCD_COLS], const lcd_op_t *ops, size_t n)
+{
+    int addr = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ops[i].kind == LCD_OP_CMD) {
+            if (ops[i].val & LCD_CMD_SET_DDRAM) addr = ops[i].val & 0x7F;
+            else if (ops[i].val == LCD_CMD_CLEAR) { memset(screen, ' ', LCD_ROWS * LCD_COLS); addr = 0; }
+            else if (ops[i].val == LCD_CMD_HOME) addr = 0;
+            continue;
+        }
+        int row = addr >= 0x40, col = addr - (row ? 0x40 : 0);
+        if (col >= 0 && col < LCD_COLS) screen[row][col] = (char)ops[i].val;
+        addr++;
+    }
+}
+
+static void print_row(const char *name, const cost_t *c, size_t k)
+{
+    printf("%-34s", name);
+    for (size_t i = 0; i < k; ++i) printf(" | %3u / %4u / %6.1f", c[i].ops, c[i].wire_bytes, cost_ms(&c[i]));
+    printf("\n");
+}
+
+int main(void)
+{
+    lcd_shadow_t sh;
+    lcd_shadow_reset(&sh);
+    char screen[LCD_ROWS][LCD_COLS];
+    memset(screen, ' ', sizeof(screen));
+    cost_t tot[3] = { 0 };
+    int rc = 0;
+
+    printf("ops HD44780 / bytes I2C / ms por actualización\n");
+    printf("%-35s | %-19s | %-19s | %-19s\n", "transición", "antes", "diff", "diff + lotes");
+    for (size_t m = 0; m < N_MSGS; ++m) {
+        char frame[LCD_ROWS][LCD_COLS];
+        lcd_frame_from_lines(frame, k_msgs[m].l1, k_msgs[m].l2);
+        lcd_op_t ops[64];
+        cost_t c[3] = { 0 };
+        size_t n = legacy_ops(frame, ops);
+        for (size_t i = 0; i < n; ++i) cost_op_legacy(&c[0], &ops[i]);
+        n = lcd_frame_diff(&sh, frame, ops, LCD_OPS_MAX);
+        for (size_t i = 0; i < n; ++i) cost_op_legacy(&c[1], &ops[i]);
+        cost_batched(&c[2], ops, n);
+        apply_ops(screen, ops, n);
+        if (memcmp(screen, frame, sizeof(screen)) != 0) {
+            printf("ERROR: la pantalla no coincide con el cuadro %zu\n", m);
+            rc = 1;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (ops[i].kind == LCD_OP_CMD && !(ops[i].val & LCD_CMD_SET_DDRAM)) {
+                printf("ERROR: el render diferencial emitió la instrucción 0x%02X\n", ops[i].val);
+                rc = 1;
+            }
+        }
+        if (c[2].ops != c[1].ops || c[2].txns != 1) {
+            printf("ERROR: el cuadro %zu no salió en una sola transferencia\n", m);
+            rc = 1;
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "%.16s / %.16s", k_msgs[m].l1, k_msgs[m].l2);
+        print_row(name, c, 3);
+        for (int k = 0; k < 3; ++k) cost_add(&tot[k], &c[k]);
+    }
+    print_row("total", tot, 3);
+    printf("\npor actualización (ms)        antes    diff   diff + lotes\n");
+    printf("  tiempo total             %7.1f %7.1f %7.1f\n",
+           cost_ms(&tot[0]) / N_MSGS, cost_ms(&tot[1]) / N_MSGS, cost_ms(&tot[2]) / N_MSGS);
+    printf("  CPU en espera activa     %7.1f %7.1f %7.1f\n",
+           tot[0].spin_us / 1000.0 / N_MSGS, tot[1].spin_us / 1000.0 / N_MSGS, tot[2].spin_us / 1000.0 / N_MSGS);
+    printf("  transacciones I2C        %7.1f %7.1f %7.1f\n",
+           (double)tot[0].txns / N_MSGS, (double)tot[1].txns / N_MSGS, (double)tot[2].txns / N_MSGS);
+
+    // Inicialización de lcd_init(): 4 nibbles + 0x28/0x0C/0x06 + clear + home
+    static lcd_xfer_t x;
+    lcd_xfer_init(&x, &lcd_pinmaps[0], I2C_FREQ_HZ);
+    if (!lcd_xfer_hd44780_init(&x)) {
+        printf("ERROR: la inicialización no cabe en LCD_XFER_MAX\n");
+        rc = 1;
+    }
+    double init_old_spin = 4 * (NIBBLE_SPIN_US) + 5 * (2 * NIBBLE_SPIN_US + BYTE_SPIN_US);
+    printf("\ninicialización: antes %u transacciones y %.1f ms de espera activa;"
+           " lotes 1 transacción de %u bytes, %.1f ms de bus, 0 ms de espera activa\n",
+           4 * NIBBLE_TXNS + 5 * 2 * NIBBLE_TXNS, init_old_spin / 1000.0, x.len + 1u, lcd_xfer_bus_us(&x) / 1000.0);
+    return rc;
+}
@@ -0,0 +1,172 @@
+#include "hd44780_emu.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define US(x) ((int64_t)(x) * 1000)
+
+#define POWER_ON_NS      US(40000)
+#define EN_MIN_WIDTH_NS  450
+
+static void violation(hd44780_emu_t *e, const char *fmt, ...)
+{
+    e->violations++;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = snprintf(e->last_violation, sizeof(e->last_violation), "t=%.3f ms: ", e->now_ns / 1e6);
+    vsnprintf(e->last_violation + n, sizeof(e->last_violation) - (size_t)n, fmt, ap);
+    va_end(ap);
+}
+
+void emu_init(hd44780_emu_t *e, uint8_t addr, const lcd_pinmap_t *wiring, uint32_t i2c_hz)
+{
+    memset(e, 0, sizeof(*e));
+    e->addr = addr;
+    e->wiring = wiring;
+    e->bit_ns = (int64_t)(1000000000LL / i2c_hz);
+    e->out = 0xFF;           // El PCF8574 arranca con todas las salidas en alto
+    memset(e->ddram, ' ', sizeof(e->ddram));
+    e->inc = true;
+}
+
+static void ac_step(hd44780_emu_t *e)
+{
+    // 2 líneas: 0x00..0x27 y 0x40..0x67, saltando de una a otra
+    if (e->inc) {
+        e->ac = e->ac == 0x27 ? 0x40 : e->ac == 0x67 ? 0x00 : (uint8_t)(e->ac + 1);
+    } else {
+        e->ac = e->ac == 0x40 ? 0x27 : e->ac == 0x00 ? 0x67 : (uint8_t)(e->ac - 1);
+    }
+}
+
+static void execute(hd44780_emu_t *e, bool rs, uint8_t v)
+{
+    if (e->now_ns < POWER_ON_NS) violation(e, "instrucción 0x%02X antes de 40 ms de alimentación", v);
+    else if (e->now_ns < e->busy_until_ns) {
+        violation(e, "%s 0x%02X con el controlador ocupado (faltan %lld ns)", rs ? "dato" : "instrucción", v,
+                  (long long)(e->busy_until_ns - e->now_ns));
+    }
+    int64_t exec = US(37);
+    if (rs) {
+        e->chars++;
+        if (!e->cgram) e->ddram[e->ac & 0x7F] = v;
+        ac_step(e);
+        exec = US(41);
+    } else {
+        e->instrs++;
+        if (v & 0x80) {
+            e->ac = v & 0x7F;
+            e->cgram = false;
+        } else if (v & 0x40) {
+            e->cgram = true;
+        } else if (v & 0x20) {
+            if (!e->four_bit) {
+                // En 8 bits las líneas D0..D3 no están conectadas: N/F se ignoran
+                exec = e->init_sets == 0 ? US(4100) : e->init_sets == 1 ? US(100) : US(37);
+                e->init_sets++;
+                if (!(v & 0x10)) {
+                    e->four_bit = true;
+                    e->half = false;
+                }
+            } else if (v & 0x10) {
+                e->four_bit = false;
+            } else {
+                e->two_lines = (v & 0x08) != 0;
+            }
+        } else if (v & 0x10) {
+            // Desplazamiento de cursor/pantalla: no lo usa el driver
+        } else if (v & 0x08) {
+            e->display_on = (v & 0x04) != 0;
+        } else if (v & 0x04) {
+            e->inc = (v & 0x02) != 0;
+        } else if (v & 0x02) {
+            e->ac = 0;
+            e->cgram = false;
+            exec = US(1520);
+        } else if (v & 0x01) {
+            memset(e->ddram, ' ', sizeof(e->ddram));
+            e->ac = 0;
+            e->cgram = false;
+            e->inc = true;
+            exec = US(1520);
+        }
+    }
+    e->busy_until_ns = e->now_ns + exec;
+}
+
+static uint8_t decode_nibble(const lcd_pinmap_t *w, uint8_t out)
+{
+    uint8_t n = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (out & w->d[i]) n |= (uint8_t)(1u << i);
+    }
+    return n;
+}
+
+// Salidas del PCF8574 tras el ACK de un byte
+static void pcf_set(hd44780_emu_t *e, uint8_t v)
+{
+    const lcd_pinmap_t *w = e->wiring;
+    uint8_t old = e->out;
+    e->out = v;
+    bool en_old = old & w->en, en_new = v & w->en;
+    if (!en_old && en_new) {
+        e->en_rise_ns = e->now_ns;
+        return;
+    }
+    if (!(en_old && !en_new)) return;
+
+    if (old & w->rw) return;   // Lectura (p. ej. salidas en alto al encender): se ignora
+    if (e->now_ns - e->en_rise_ns < EN_MIN_WIDTH_NS) violation(e, "pulso de EN de %lld ns", (long long)(e->now_ns - e->en_rise_ns));
+    if ((old & ~w->en) != (v & ~w->en)) violation(e, "datos cambian al bajar EN (0x%02X -> 0x%02X)", old, v);
+
+    bool rs = (old & w->rs) != 0;
+    uint8_t nib = decode_nibble(w, old);
+    if (!e->four_bit) {
+        execute(e, rs, (uint8_t)(nib << 4));
+    } else if (!e->half) {
+        e->hi = nib;
+        e->hi_rs = rs;
+        e->half = true;
+    } else {
+        e->half = false;
+        if (rs != e->hi_rs) violation(e, "RS distinto entre los dos nibbles");
+        execute(e, rs, (uint8_t)(e->hi << 4 | nib));
+    }
+}
+
+bool emu_i2c_write(hd44780_emu_t *e, uint8_t addr, const uint8_t *buf, size_t len)
+{
+    e->txns++;
+    e->now_ns += e->bit_ns;            // START
+    e->now_ns += 9 * e->bit_ns;        // Dirección + ACK/NACK
+    if (addr != e->addr) {
+        e->nacks++;
+        e->now_ns += e->bit_ns;        // STOP
+        return false;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        e->now_ns += 9 * e->bit_ns;
+        e->bytes++;
+        pcf_set(e, buf[i]);
+    }
+    e->now_ns += e->bit_ns;            // STOP
+    return true;
+}
+
+void emu_idle_us(hd44780_emu_t *e, uint32_t us)
+{
+    e->now_ns += US(us);
+}
+
+void emu_screen(const hd44780_emu_t *e, char out[EMU_ROWS][EMU_COLS + 1])
+{
+    for (int r = 0; r < EMU_ROWS; ++r) {
+        bool visible = e->display_on && (r == 0 || e->two_lines);
+        for (int c = 0; c < EMU_COLS; ++c) {
+            uint8_t ch = e->ddram[(r ? 0x40 : 0x00) + c];
+            out[r][c] = visible ? (char)(ch >= 0x20 && ch < 0x7F ? ch : '?') : ' ';
+        }
+        out[r][EMU_COLS] = '\0';
+    }
+}
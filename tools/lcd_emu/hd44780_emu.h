@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lcd_xfer.h"
+
+// Emulador de bus I2C con un PCF8574 y un HD44780 detrás (módulo LCD1602
+// "mochila I2C"). Reloj virtual en ns que avanza con cada bit del bus:
+// cada byte del PCF8574 cambia sus salidas tras el ACK y el HD44780 captura
+// en el flanco de bajada de EN según el cableado de la placa (una de las
+// variantes de lcd_pinmaps, que puede no ser la que cree el driver).
+//
+// Modelo del HD44780:
+//  - Arranca en 8 bits; el modo 4 bits se entra con un function set 0x2x.
+//  - DDRAM de 80 posiciones (0x00..0x27 y 0x40..0x67), contador de
+//    direcciones con incremento/decremento, clear, home, display on/off,
+//    1 o 2 líneas, escritura en CGRAM (se descarta).
+//  - Tiempos: 40 ms tras la alimentación, 4,1 ms y 100 us tras los dos
+//    primeros 0x30, 1,52 ms para clear/home, 37 us para el resto (+4 us
+//    los datos).
+// Violaciones que se señalan (y se cuentan): instrucción con el
+// controlador ocupado o antes de los 40 ms, pulso de EN < 450 ns y datos
+// que cambian en el mismo flanco que baja EN.
+
+#define EMU_ROWS  2
+#define EMU_COLS  16
+
+typedef struct {
+    // Placa
+    uint8_t addr;
+    const lcd_pinmap_t *wiring;
+    int64_t bit_ns;
+    // Reloj
+    int64_t now_ns;
+    // PCF8574
+    uint8_t out;
+    int64_t en_rise_ns;
+    // HD44780
+    bool four_bit;
+    bool half;               // Nibble alto recibido, falta el bajo
+    uint8_t hi;
+    bool hi_rs;
+    int init_sets;           // Function set en 8 bits recibidos
+    int64_t busy_until_ns;
+    uint8_t ddram[0x80];
+    uint8_t ac;
+    bool cgram;
+    bool inc;
+    bool display_on;
+    bool two_lines;
+    // Estadística
+    uint32_t txns;
+    uint32_t bytes;
+    uint32_t nacks;
+    uint32_t instrs;
+    uint32_t chars;
+    uint32_t violations;
+    char last_violation[96];
+} hd44780_emu_t;
+
+// Placa en addr con el cableado dado, recién alimentada en t = 0
+void emu_init(hd44780_emu_t *e, uint8_t addr, const lcd_pinmap_t *wiring, uint32_t i2c_hz);
+// Una transacción de escritura; false (NACK) si addr no es la de la placa
+bool emu_i2c_write(hd44780_emu_t *e, uint8_t addr, const uint8_t *buf, size_t len);
+// Bus en reposo (vTaskDelay del firmware)
+void emu_idle_us(hd44780_emu_t *e, uint32_t us);
+// Lo que se ve: 2 x 16 caracteres más '\0' por fila
+void emu_screen(const hd44780_emu_t *e, char out[EMU_ROWS][EMU_COLS + 1]);
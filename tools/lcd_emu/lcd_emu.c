@@ -0,0 +1,319 @@
+/*
+ * lcd_emu: el driver del LCD (main/lcd_drv.c + lcd_xfer.c + lcd_frame.c)
+ * compilado para Linux sobre un bus I2C emulado con un PCF8574 y un
+ * HD44780 (hd44780_emu.c) que decodifica los bytes del expansor, mantiene
+ * la DDRAM y señala violaciones de tiempo.
+ *
+ * 1) Pruebas: para las 6 variantes de cableado y 50/100/400 kHz, init en
+ *    4 bits, patrón de diagnóstico y la secuencia típica de mensajes con
+ *    la pantalla comprobada tras cada paso y sin violaciones; variantes
+ *    equivocadas que no deben mostrar el texto; el auto-probe completo
+ *    (0x27/0x3F x 6 variantes) sobre cada placa; y flujos incorrectos a
+ *    propósito que el emulador debe detectar.
+ * 2) Banco: transacciones, bytes y tiempo de bus por cuadro, en lote (una
+ *    escritura por cuadro) frente a byte a byte como el driver antiguo.
+ *
+ * Compilar: make -C tools lcd_emu   (binario en tools/build/)
+ * Ejemplo:  tools/build/lcd_emu -v
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hd44780_emu.h"
+#include "lcd_drv.h"
+#include "tool_util.h"
+
+#define LCD_ADDR      0x27
+#define POWER_UP_MS   120     // vTaskDelay de lcd_init()
+
+static bool g_verbose = false;
+
+typedef struct {
+    hd44780_emu_t *emu;
+    bool per_byte;           // Una transacción por byte (driver antiguo)
+} bus_t;
+
+static bool bus_write(void *ctx, uint8_t addr, const uint8_t *buf, size_t len)
+{
+    bus_t *b = ctx;
+    if (!b->per_byte) return emu_i2c_write(b->emu, addr, buf, len);
+    bool ok = true;
+    for (size_t i = 0; i < len && ok; ++i) ok = emu_i2c_write(b->emu, addr, &buf[i], 1);
+    return ok;
+}
+
+typedef struct {
+    const char *l1, *l2;
+} msg_t;
+
+// Secuencia típica (la misma que tools/lcd_bench)
+static const msg_t k_msgs[] = {
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+    { "CURRENT PASS:",  "3 # #" },
+    { "CURRENT PASS:",  "3 6 #" },
+    { "CURRENT PASS:",  "3 6 4" },
+    { "ACCESS GRANTED!", "WELCOME HOME" },
+    { "LOCKING...",     "" },
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+    { "ACCESS DENIED!", "OUT OF SCHEDULE" },
+    { "WELCOME, INPUT", "PASSWORD OR RFID" },
+};
+#define N_MSGS (sizeof(k_msgs) / sizeof(k_msgs[0]))
+
+static bool screen_is(const hd44780_emu_t *e, const char *l1, const char *l2)
+{
+    char want[LCD_ROWS][LCD_COLS], got[EMU_ROWS][EMU_COLS + 1];
+    lcd_frame_from_lines(want, l1, l2);
+    emu_screen(e, got);
+    return memcmp(got[0], want[0], LCD_COLS) == 0 && memcmp(got[1], want[1], LCD_COLS) == 0;
+}
+
+static void check_screen(const hd44780_emu_t *e, const char *ctx, const char *l1, const char *l2)
+{
+    if (screen_is(e, l1, l2)) return;
+    char got[EMU_ROWS][EMU_COLS + 1];
+    emu_screen(e, got);
+    printf("  FALLO %s: pantalla \"%s\" / \"%s\", esperado \"%s\" / \"%s\"\n", ctx, got[0], got[1], l1, l2);
+    g_fail++;
+}
+
+static void check_clean(const hd44780_emu_t *e, const char *ctx)
+{
+    if (e->violations == 0) return;
+    printf("  FALLO %s: %u violaciones (última: %s)\n", ctx, e->violations, e->last_violation);
+    g_fail++;
+}
+
+// ---------------------------------------------------------------------------
+// 1) Pruebas
+// ---------------------------------------------------------------------------
+
+static void test_driver(int wiring, uint32_t hz)
+{
+    char ctx[64];
+    snprintf(ctx, sizeof(ctx), "variante %d a %u kHz", wiring, (unsigned)(hz / 1000));
+    hd44780_emu_t e;
+    emu_init(&e, LCD_ADDR, &lcd_pinmaps[wiring], hz);
+    bus_t bus = { &e, false };
+    lcd_port_t port = { bus_write, &bus };
+    lcd_drv_t d;
+
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    lcd_drv_setup(&d, &port, LCD_ADDR, wiring, hz);
+    if (!lcd_drv_init(&d) || !e.four_bit || !e.two_lines || !e.display_on) {
+        printf("  FALLO %s: init (4 bits %d, 2 líneas %d, display %d)\n", ctx, e.four_bit, e.two_lines, e.display_on);
+        g_fail++;
+    }
+    check_screen(&e, ctx, "", "");
+
+    // Patrón de diagnóstico de lcd_debug_pattern()
+    lcd_drv_show_raw(&d, "ADDR27 VAR0 OK", "ABCDEFGHIJKLMN");
+    check_screen(&e, ctx, "ADDR27 VAR0 OK", "ABCDEFGHIJKLMN");
+    emu_idle_us(&e, 1200 * 1000);
+    lcd_drv_show_raw(&d, "0123456789.,:?", "RF=READY POT=OK");
+    check_screen(&e, ctx, "0123456789.,:?", "RF=READY POT=OK");
+    emu_idle_us(&e, 1500 * 1000);
+
+    // Render diferencial, mensajes seguidos sin pausas entre medias
+    for (size_t m = 0; m < N_MSGS; ++m) {
+        lcd_drv_render(&d, k_msgs[m].l1, k_msgs[m].l2);
+        check_screen(&e, ctx, k_msgs[m].l1, k_msgs[m].l2);
+    }
+    check_clean(&e, ctx);
+    if (d.errors) { printf("  FALLO %s: %u escrituras fallidas\n", ctx, d.errors); g_fail++; }
+}
+
+// El emulador distingue variantes: con el mapeo equivocado no sale el texto
+static void test_wrong_variant(int wiring, int variant)
+{
+    hd44780_emu_t e;
+    emu_init(&e, LCD_ADDR, &lcd_pinmaps[wiring], 50000);
+    bus_t bus = { &e, false };
+    lcd_port_t port = { bus_write, &bus };
+    lcd_drv_t d;
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    lcd_drv_setup(&d, &port, LCD_ADDR, variant, 50000);
+    lcd_drv_init(&d);
+    lcd_drv_render(&d, "HELLO 1602", "");
+    if (screen_is(&e, "HELLO 1602", "")) {
+        printf("  FALLO placa %d con driver en variante %d: muestra el texto\n", wiring, variant);
+        g_fail++;
+    }
+}
+
+// lcd_autoprobe_run(): 0x27 y 0x3F x 6 variantes, 1,5 s entre pasos
+static void test_autoprobe(int wiring)
+{
+    char ctx[64];
+    snprintf(ctx, sizeof(ctx), "auto-probe sobre placa variante %d", wiring);
+    hd44780_emu_t e;
+    emu_init(&e, LCD_ADDR, &lcd_pinmaps[wiring], 50000);
+    bus_t bus = { &e, false };
+    lcd_port_t port = { bus_write, &bus };
+    lcd_drv_t probe;
+    emu_idle_us(&e, 100 * 1000);
+    const uint8_t addrs[] = { 0x27, 0x3F };
+    int hits = 0;
+    for (size_t ai = 0; ai < sizeof(addrs); ++ai) {
+        for (int v = 0; v < LCD_PINMAP_VARIANTS; ++v) {
+            uint32_t viol = e.violations;
+            bool ok = lcd_drv_probe_show(&probe, &port, addrs[ai], v, 50000);
+            char l1[LCD_COLS + 1];
+            snprintf(l1, sizeof(l1), "ADDR %02X VAR %d", addrs[ai], v);
+            bool shows = screen_is(&e, l1, "HELLO 1602");
+            if (addrs[ai] == LCD_ADDR && v == wiring) {
+                check_screen(&e, ctx, l1, "HELLO 1602");
+                if (e.violations != viol) {
+                    printf("  FALLO %s: violaciones en el paso correcto (%s)\n", ctx, e.last_violation);
+                    g_fail++;
+                }
+            } else if (shows) {
+                printf("  FALLO %s: 0x%02X variante %d también muestra su texto\n", ctx, addrs[ai], v);
+                g_fail++;
+            }
+            if (ok != (addrs[ai] == LCD_ADDR)) {
+                printf("  FALLO %s: 0x%02X %s\n", ctx, addrs[ai], ok ? "respondió" : "no respondió");
+                g_fail++;
+            }
+            hits += shows;
+            emu_idle_us(&e, 1500 * 1000);
+        }
+    }
+    if (hits != 1) { printf("  FALLO %s: %d pasos legibles\n", ctx, hits); g_fail++; }
+
+    // Después, el arranque normal con la variante buena
+    lcd_drv_t d;
+    lcd_drv_setup(&d, &port, LCD_ADDR, wiring, 50000);
+    lcd_drv_init(&d);
+    lcd_drv_render(&d, k_msgs[0].l1, k_msgs[0].l2);
+    check_screen(&e, ctx, k_msgs[0].l1, k_msgs[0].l2);
+    if (g_verbose) printf("  %s: %u NACK, %u violaciones en pasos con mapeo equivocado\n", ctx, e.nacks, e.violations);
+}
+
+// Flujos incorrectos a propósito: el emulador tiene que verlos
+static void test_detects(void)
+{
+    hd44780_emu_t e;
+    lcd_xfer_t x;
+    const lcd_pinmap_t *pm = &lcd_pinmaps[0];
+
+    // Init sin esperar los 40 ms de alimentación
+    emu_init(&e, LCD_ADDR, pm, 50000);
+    lcd_xfer_init(&x, pm, 50000);
+    lcd_xfer_hd44780_init(&x);
+    emu_i2c_write(&e, LCD_ADDR, x.buf, x.len);
+    if (e.violations == 0) { printf("  FALLO no detecta init antes de 40 ms\n"); g_fail++; }
+
+    // 0x30 tres veces seguidas, sin los 4,1 ms
+    emu_init(&e, LCD_ADDR, pm, 50000);
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    lcd_xfer_init(&x, pm, 50000);
+    for (int i = 0; i < 3; ++i) lcd_xfer_nibble(&x, 0x30, false);
+    emu_i2c_write(&e, LCD_ADDR, x.buf, x.len);
+    if (e.violations == 0) { printf("  FALLO no detecta init sin esperas\n"); g_fail++; }
+
+    // Clear y un dato justo detrás (sin los 1,52 ms de relleno)
+    emu_init(&e, LCD_ADDR, pm, 50000);
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    lcd_xfer_init(&x, pm, 50000);
+    lcd_xfer_hd44780_init(&x);
+    lcd_xfer_nibble(&x, LCD_CMD_CLEAR & 0xF0, false);
+    lcd_xfer_nibble(&x, (uint8_t)(LCD_CMD_CLEAR << 4), false);
+    lcd_xfer_data(&x, 'A');
+    emu_i2c_write(&e, LCD_ADDR, x.buf, x.len);
+    if (e.violations != 1) { printf("  FALLO dato tras clear: %u violaciones, esperada 1\n", e.violations); g_fail++; }
+
+    // Datos que cambian en el mismo byte que baja EN
+    emu_init(&e, LCD_ADDR, pm, 50000);
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    uint8_t bad[] = { 0x38, 0x3C, 0x28 };
+    emu_i2c_write(&e, LCD_ADDR, bad, sizeof(bad));
+    if (e.violations == 0) { printf("  FALLO no detecta datos cambiando con EN\n"); g_fail++; }
+}
+
+// ---------------------------------------------------------------------------
+// 2) Banco: transacciones por cuadro
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t txns, bytes;
+    int64_t ns;
+} span_t;
+
+static void run_sequence(bool per_byte, span_t *init, span_t per_msg[N_MSGS], size_t ops[N_MSGS])
+{
+    hd44780_emu_t e;
+    emu_init(&e, LCD_ADDR, &lcd_pinmaps[0], 50000);
+    bus_t bus = { &e, per_byte };
+    lcd_port_t port = { bus_write, &bus };
+    lcd_drv_t d;
+    emu_idle_us(&e, POWER_UP_MS * 1000);
+    lcd_drv_setup(&d, &port, LCD_ADDR, 0, 50000);
+
+    span_t s0 = { e.txns, e.bytes, e.now_ns };
+    lcd_drv_init(&d);
+    *init = (span_t){ e.txns - s0.txns, e.bytes - s0.bytes, e.now_ns - s0.ns };
+    for (size_t m = 0; m < N_MSGS; ++m) {
+        s0 = (span_t){ e.txns, e.bytes, e.now_ns };
+        ops[m] = lcd_drv_render(&d, k_msgs[m].l1, k_msgs[m].l2);
+        per_msg[m] = (span_t){ e.txns - s0.txns, e.bytes - s0.bytes, e.now_ns - s0.ns };
+        check_screen(&e, per_byte ? "banco byte a byte" : "banco en lote", k_msgs[m].l1, k_msgs[m].l2);
+    }
+    check_clean(&e, per_byte ? "banco byte a byte" : "banco en lote");
+}
+
+static void bench(void)
+{
+    span_t init_b, init_l, batch[N_MSGS], legacy[N_MSGS];
+    size_t ops[N_MSGS];
+    run_sequence(false, &init_b, batch, ops);
+    run_sequence(true, &init_l, legacy, ops);
+
+    printf("\ntransacciones / bytes I2C / ms de bus por cuadro (variante 0, 50 kHz)\n");
+    printf("%-35s | %3s | %-22s | %-22s\n", "cuadro", "ops", "byte a byte", "en lote");
+    span_t tb = { 0 }, tl = { 0 };
+    for (size_t m = 0; m < N_MSGS; ++m) {
+        char name[48];
+        snprintf(name, sizeof(name), "%.16s / %.16s", k_msgs[m].l1, k_msgs[m].l2);
+        printf("%-34s | %3zu | %4u / %4u / %6.1f | %4u / %4u / %6.1f\n", name, ops[m],
+               legacy[m].txns, legacy[m].bytes, legacy[m].ns / 1e6, batch[m].txns, batch[m].bytes, batch[m].ns / 1e6);
+        tl.txns += legacy[m].txns; tl.bytes += legacy[m].bytes; tl.ns += legacy[m].ns;
+        tb.txns += batch[m].txns; tb.bytes += batch[m].bytes; tb.ns += batch[m].ns;
+    }
+    printf("%-34s |     | %4u / %4u / %6.1f | %4u / %4u / %6.1f\n", "inicialización",
+           init_l.txns, init_l.bytes, init_l.ns / 1e6, init_b.txns, init_b.bytes, init_b.ns / 1e6);
+    printf("por cuadro: byte a byte %.1f transacciones y %.1f ms de bus; en lote %.1f y %.1f ms\n",
+           (double)tl.txns / N_MSGS, tl.ns / 1e6 / N_MSGS, (double)tb.txns / N_MSGS, tb.ns / 1e6 / N_MSGS);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-v")) g_verbose = true;
+        else {
+            fprintf(stderr, "uso: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    const uint32_t hz[] = { 50000, 100000, 400000 };
+    for (size_t h = 0; h < sizeof(hz) / sizeof(hz[0]); ++h) {
+        for (int w = 0; w < LCD_PINMAP_VARIANTS; ++w) test_driver(w, hz[h]);
+    }
+    printf("driver: 6 variantes x 3 frecuencias: %s\n", g_fail ? "FALLAN" : "ok");
+    int f0 = g_fail;
+    for (int w = 0; w < LCD_PINMAP_VARIANTS; ++w) {
+        for (int v = 0; v < LCD_PINMAP_VARIANTS; ++v) {
+            if (v != w) test_wrong_variant(w, v);
+        }
+    }
+    printf("variantes equivocadas: %s\n", g_fail != f0 ? "FALLAN" : "ok");
+    f0 = g_fail;
+    for (int w = 0; w < LCD_PINMAP_VARIANTS; ++w) test_autoprobe(w);
+    printf("auto-probe: %s\n", g_fail != f0 ? "FALLA" : "ok");
+    f0 = g_fail;
+    test_detects();
+    printf("detección de violaciones: %s\n", g_fail != f0 ? "FALLA" : "ok");
+    bench();
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * lcd_queue_check: pruebas en host de la cola de peticiones del LCD
+ * (main/lcd_queue.c) con el mismo uso que hace main.c.
+ *
+ * 1) Escenarios con reloj virtual: bienvenida de fondo, progreso que se
+ *    sustituye, "ACCESS DENIED!" que el progreso no pisa antes de su
+ *    mínimo, LOCKING... que tapa el resultado y vuelve a la bienvenida,
+ *    caducidad por inactividad, cola llena.
+ * 2) Traza de una hora (--accesses N por hora, aleatorios): despertares del
+ *    compositor frente al sondeo fijo de 100 ms, y cuántos resultados
+ *    habrían quedado pisados antes de LCD_RESULT_MIN_MS con el buffer único.
+ *
+ * Compilar: make -C tools lcd_queue_check   (binario en tools/build/)
+ * Ejemplo:  tools/build/lcd_queue_check --accesses 60
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcd_queue.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+
+// Igual que main.c
+enum { LCD_KEY_IDLE = 0, LCD_KEY_PROGRESS, LCD_KEY_RESULT };
+#define LCD_PRIO_IDLE      0
+#define LCD_PRIO_MSG       1
+#define LCD_PRIO_LOCKING   2
+#define LCD_IDLE_MS        5000
+#define LCD_LOCKING_MS     1000
+#define LCD_RESULT_MIN_MS  1500
+
+// Compositor simulado: despierta al publicar (si hace falta) y en su plazo
+typedef struct {
+    lcd_queue_t q;
+    int64_t deadline;
+    uint32_t shown_seq;
+    char l1[LCD_COLS + 1];
+    uint32_t wakes, renders;
+} sim_t;
+
+static void sim_compose(sim_t *s, int64_t t)
+{
+    s->wakes++;
+    int64_t next;
+    const lcd_req_t *top = lcd_queue_compose(&s->q, t, &next);
+    if (top && top->seq != s->shown_seq) {
+        s->shown_seq = top->seq;
+        snprintf(s->l1, sizeof(s->l1), "%s", top->l1);
+        s->renders++;
+    }
+    s->deadline = next;
+}
+
+static void sim_advance(sim_t *s, int64_t t)
+{
+    while (s->deadline <= t) sim_compose(s, s->deadline);
+}
+
+static void sim_init(sim_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    lcd_queue_init(&s->q);
+    s->deadline = LCD_QUEUE_NEVER;
+    lcd_queue_post(&s->q, LCD_KEY_IDLE, LCD_PRIO_IDLE, 0, 0, "WELCOME, INPUT", "PASSWORD OR RFID", 0);
+    sim_compose(s, 0);
+}
+
+static void post(sim_t *s, int64_t t, uint8_t key, uint8_t prio, uint32_t min_ms, uint32_t ttl_ms, const char *l1)
+{
+    sim_advance(s, t);
+    if (lcd_queue_post(&s->q, key, prio, min_ms, ttl_ms, l1, "", t)) sim_compose(s, t);
+}
+
+static void progress(sim_t *s, int64_t t, const char *digits)
+{
+    post(s, t, LCD_KEY_PROGRESS, LCD_PRIO_MSG, 0, LCD_IDLE_MS, digits);
+}
+
+static void result(sim_t *s, int64_t t, const char *l1)
+{
+    post(s, t, LCD_KEY_RESULT, LCD_PRIO_MSG, LCD_RESULT_MIN_MS, LCD_IDLE_MS, l1);
+}
+
+static void locking(sim_t *s, int64_t t)
+{
+    sim_advance(s, t);
+    if (lcd_queue_cancel(&s->q, LCD_KEY_PROGRESS)) sim_compose(s, t);
+    post(s, t, LCD_KEY_RESULT, LCD_PRIO_LOCKING, LCD_LOCKING_MS, LCD_LOCKING_MS, "LOCKING...");
+}
+
+static void expect(sim_t *s, const char *scen, int64_t t, const char *l1)
+{
+    sim_advance(s, t);
+    if (strcmp(s->l1, l1) != 0) {
+        printf("  FALLO %s: t=%lld ms muestra \"%s\", esperado \"%s\"\n", scen, (long long)(t / 1000), s->l1, l1);
+        g_fail++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 1) Escenarios
+// ---------------------------------------------------------------------------
+
+static void scenarios(void)
+{
+    sim_t s;
+    const char *n;
+
+    n = "bienvenida de fondo";
+    sim_init(&s);
+    expect(&s, n, 0, "WELCOME, INPUT");
+    if (s.deadline != LCD_QUEUE_NEVER) { printf("  FALLO %s: plazo armado sin nada que caduque\n", n); g_fail++; }
+
+    n = "progreso sustituye al instante";
+    sim_init(&s);
+    progress(&s, MS(0), "3 # #");
+    progress(&s, MS(100), "3 6 #");
+    expect(&s, n, MS(100), "3 6 #");
+
+    n = "denegado no lo pisa el progreso";
+    sim_init(&s);
+    progress(&s, MS(0), "3 6 #");
+    progress(&s, MS(1000), "3 6 9");
+    lcd_queue_cancel(&s.q, LCD_KEY_PROGRESS);
+    result(&s, MS(1000), "ACCESS DENIED!");
+    progress(&s, MS(1100), "1 # #");
+    expect(&s, n, MS(1100), "ACCESS DENIED!");
+    expect(&s, n, MS(2499), "ACCESS DENIED!");
+    expect(&s, n, MS(2500), "1 # #");
+
+    n = "LOCKING tapa el resultado y vuelve a la bienvenida";
+    sim_init(&s);
+    progress(&s, MS(0), "3 6 4");
+    result(&s, MS(10), "ACCESS GRANTED!");
+    expect(&s, n, MS(10), "ACCESS GRANTED!");
+    locking(&s, MS(300));
+    expect(&s, n, MS(300), "LOCKING...");
+    expect(&s, n, MS(1299), "LOCKING...");
+    expect(&s, n, MS(1300), "WELCOME, INPUT");
+
+    n = "inactividad";
+    sim_init(&s);
+    progress(&s, MS(0), "3 # #");
+    expect(&s, n, MS(4999), "3 # #");
+    expect(&s, n, MS(5000), "WELCOME, INPUT");
+
+    n = "menor prioridad no despierta";
+    sim_init(&s);
+    locking(&s, MS(0));
+    uint32_t w = s.wakes;
+    progress(&s, MS(100), "5 # #");
+    if (s.wakes != w) { printf("  FALLO %s: despertó con una petición oculta\n", n); g_fail++; }
+    expect(&s, n, MS(1000), "5 # #");
+
+    n = "cola llena";
+    sim_init(&s);
+    for (int k = 1; k < LCD_QUEUE_MAX; ++k) post(&s, MS(k), (uint8_t)(10 + k), 1, 0, 60000, "X");
+    if (lcd_queue_post(&s.q, 20, 1, 0, 0, "Y", "", MS(10))) {
+        printf("  FALLO %s: aceptada sin sitio y sin ser mejor\n", n); g_fail++;
+    }
+    post(&s, MS(11), 21, 3, 0, 0, "Z");
+    expect(&s, n, MS(11), "Z");
+    if (s.q.evicted != 1) { printf("  FALLO %s: %u expulsiones\n", n, s.q.evicted); g_fail++; }
+
+    printf("escenarios: %s\n", g_fail ? "FALLAN" : "ok");
+}
+
+// ---------------------------------------------------------------------------
+// 2) Traza de una hora
+// ---------------------------------------------------------------------------
+
+static void trace(int accesses, unsigned seed)
+{
+    srand(seed);
+    sim_t s;
+    sim_init(&s);
+    uint32_t clobbered_legacy = 0, clobbered = 0;
+    int64_t hour = MS(3600 * 1000);
+    int64_t gap = hour / (accesses + 1);
+    for (int a = 0; a < accesses; ++a) {
+        int64_t t = gap * (a + 1) + MS(rand() % 2000);
+        bool bad = rand() % 4 == 0;
+        progress(&s, t, "1 # #");
+        progress(&s, t + MS(1500), "1 2 #");
+        progress(&s, t + MS(3000), "1 2 3");
+        if (bad) {
+            lcd_queue_cancel(&s.q, LCD_KEY_PROGRESS);
+            result(&s, t + MS(3000), "ACCESS DENIED!");
+            // Reintento inmediato: con el buffer único el progreso lo pisaba
+            progress(&s, t + MS(3100), "4 # #");
+            clobbered_legacy++;
+            expect(&s, "traza", t + MS(3100), "ACCESS DENIED!");
+            if (strcmp(s.l1, "ACCESS DENIED!") != 0) clobbered++;
+        } else {
+            result(&s, t + MS(3000), "ACCESS GRANTED!");
+            locking(&s, t + MS(9000));
+        }
+    }
+    sim_advance(&s, hour);
+    printf("traza 1 h, %d accesos: %u despertares del compositor (sondeo 100 ms: %lld), %u renders\n",
+           accesses, s.wakes, (long long)(hour / MS(100)), s.renders);
+    printf("  resultados pisados antes de %d ms: buffer único %u, cola %u\n",
+           LCD_RESULT_MIN_MS, clobbered_legacy, clobbered);
+    printf("  cola: %u publicadas, %u sustituidas, %u caducadas, %u quitadas antes del mínimo\n",
+           s.q.posted, s.q.replaced, s.q.expired, s.q.preempted);
+}
+
+int main(int argc, char **argv)
+{
+    int accesses = 30;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--accesses") && i + 1 < argc) accesses = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = arg_seed(argv[++i]);
+        else {
+            fprintf(stderr, "uso: %s [--accesses N] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    scenarios();
+    trace(accesses, seed);
+    return g_fail ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * policy_bench: compila en host una política sintética (main/access_policy.c)
+ * y mide decisiones por segundo frente a evaluar recorriendo el árbol JSON.
+ *
+ * Genera --rules reglas de grupo (allow y ~10 % deny, con días, horarios,
+ * puertas y cruces de medianoche), --creds tarjetas con grupos y un 5 % con
+ * horario personal, y 12 festivos. Después:
+ *   1) Compila y muestra tiempo y tamaño de la tabla.
+ *   2) Comprueba --verify consultas aleatorias contra un evaluador de
+ *      referencia que recorre el JSON (mismo significado, otra
+ *      implementación); devuelve 1 ante la primera discrepancia.
+ *   3) Mide decisiones/s de la tabla compilada y del recorrido del JSON.
+ *
+ * Compilar: make -C tools policy_bench   (binario en tools/build/)
+ * Ejemplo:  tools/build/policy_bench --rules 10000 --creds 10000
+ */
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "access_policy.h"
+#include "cJSON.h"
+#include "tool_util.h"
+
+static uint32_t rnd32(void)
+{
+    return (uint32_t)(rng_step(&g_rng) >> 32);
+}
+
+static int rnd_n(int n) { return (int)(rnd32() % (uint32_t)n); }
+
+// ---------------------------------------------------------------------------
+// Generador de políticas
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} sbuf_t;
+
+static void sb_printf(sbuf_t *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void sb_printf(sbuf_t *b, const char *fmt, ...)
+{
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->buf + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < b->cap - b->len) {
+            b->len += (size_t)n;
+            return;
+        }
+        b->cap = b->cap ? b->cap * 2 : 4096;
+        b->buf = realloc(b->buf, b->cap);
+    }
+}
+
+static const char *k_days[] = { "mon-fri", "sat,sun", "all", "mon,wed,fri", "tue-thu", "hol", "fri-mon", "sun" };
+
+static void gen_span(sbuf_t *b)
+{
+    int from = rnd_n(96) * 15 + (rnd_n(4) == 0 ? rnd_n(15) : 0);
+    int len = 15 * (1 + rnd_n(40));
+    int to = (from + len) % 1440;
+    sb_printf(b, "\"days\":\"%s\",\"from\":\"%02d:%02d\",\"to\":\"%02d:%02d\"",
+              k_days[rnd_n(8)], from / 60, from % 60, to / 60, to % 60);
+}
+
+static char *gen_policy(int n_rules, int n_creds, uint32_t *uids)
+{
+    sbuf_t b = {0};
+    sb_printf(&b, "{\"version\":1,\"mode\":\"or\",\"groups\":[");
+    for (int g = 0; g < POLICY_MAX_GROUPS; ++g) sb_printf(&b, "%s\"g%d\"", g ? "," : "", g);
+    sb_printf(&b, "],\"combo\":[\"g0\"],\"remote\":[\"g1\"],\"holidays\":[");
+    for (int h = 0; h < 12; ++h) sb_printf(&b, "%s\"2026-%02d-%02d\"", h ? "," : "", h + 1, 1 + rnd_n(28));
+    sb_printf(&b, "],\"rules\":[");
+    for (int i = 0; i < n_rules; ++i) {
+        sb_printf(&b, "%s{\"groups\":[\"g%d\"", i ? "," : "", rnd_n(POLICY_MAX_GROUPS));
+        if (rnd_n(3) == 0) sb_printf(&b, ",\"g%d\"", rnd_n(POLICY_MAX_GROUPS));
+        sb_printf(&b, "],");
+        gen_span(&b);
+        if (rnd_n(3) == 0) sb_printf(&b, ",\"doors\":[%d]", rnd_n(POLICY_MAX_DOORS));
+        if (rnd_n(10) == 0) sb_printf(&b, ",\"effect\":\"deny\"");
+        sb_printf(&b, "}");
+    }
+    sb_printf(&b, "],\"credentials\":[");
+    for (int i = 0; i < n_creds; ++i) {
+        uids[i] = 0x10000000u + (uint32_t)i * 2654435761u % 0xE0000000u;
+        sb_printf(&b, "%s{\"uid\":\"%08X\",\"groups\":[\"g%d\"]", i ? "," : "", uids[i], rnd_n(POLICY_MAX_GROUPS));
+        if (rnd_n(20) == 0) {
+            // Horarios personales a partir de 40 plantillas (se deduplican)
+            uint64_t save = g_rng;
+            g_rng = 0x1234567ull * (uint64_t)(1 + rnd_n(40));
+            sb_printf(&b, ",\"rules\":[{");
+            gen_span(&b);
+            sb_printf(&b, "}]");
+            g_rng = save;
+        }
+        sb_printf(&b, "}");
+    }
+    sb_printf(&b, "]}");
+    return b.buf;
+}
+
+// ---------------------------------------------------------------------------
+// Evaluador de referencia: recorre el árbol JSON en cada decisión
+// ---------------------------------------------------------------------------
+
+static int ref_day(const char *s)
+{
+    static const char *n[] = { "mon", "tue", "wed", "thu", "fri", "sat", "sun", "hol" };
+    for (int i = 0; i < 8; ++i) if (strncmp(s, n[i], 3) == 0) return i;
+    return -1;
+}
+
+static bool ref_day_in(const char *days, int d)
+{
+    if (strcmp(days, "all") == 0) return true;
+    for (const char *s = days; *s; ) {
+        int a = ref_day(s), b = a;
+        s += 3;
+        if (*s == '-') { b = ref_day(s + 1); s += 4; }
+        if (d == a) return true;
+        if (a != b && d < 7 && a < 7 && b < 7) {
+            for (int x = a; x != b; x = (x + 1) % 7) if ((x + 1) % 7 == d) return true;
+        }
+        if (*s == ',') s++;
+    }
+    return false;
+}
+
+static int ref_min(const cJSON *j, int dflt)
+{
+    if (!j) return dflt;
+    int h, m;
+    sscanf(j->valuestring, "%d:%d", &h, &m);
+    return h * 60 + m;
+}
+
+static bool ref_door_in(const cJSON *rule, int door)
+{
+    const cJSON *jd = cJSON_GetObjectItem(rule, "doors");
+    if (!jd) return true;
+    const cJSON *d;
+    cJSON_ArrayForEach(d, jd) if (d->valueint == door) return true;
+    return false;
+}
+
+// ¿El tramo de la regla cubre la franja (tipo de día, índice en el día)?
+static bool ref_covers(const cJSON *rule, int dtype, int s)
+{
+    const char *days = cJSON_GetObjectItem(rule, "days")->valuestring;
+    int s0 = ref_min(cJSON_GetObjectItem(rule, "from"), 0) / POLICY_SLOT_MIN;
+    int s1 = (ref_min(cJSON_GetObjectItem(rule, "to"), 1440) + POLICY_SLOT_MIN - 1) / POLICY_SLOT_MIN;
+    if (s0 < s1) return ref_day_in(days, dtype) && s >= s0 && s < s1;
+    if (s0 == s1) return false;
+    if (ref_day_in(days, dtype) && s >= s0) return true;
+    // Parte tras la medianoche: pertenece al día anterior (el festivo a sí mismo)
+    int prev = (dtype == POLICY_DAY_HOL) ? dtype : (dtype + 6) % 7;
+    return ref_day_in(days, prev) && s < s1;
+}
+
+static bool ref_group_in(const cJSON *rule, const char *g)
+{
+    const cJSON *x;
+    cJSON_ArrayForEach(x, cJSON_GetObjectItem(rule, "groups")) if (strcmp(x->valuestring, g) == 0) return true;
+    return false;
+}
+
+static bool ref_decide(const cJSON *root, uint32_t uid, int door, int slot)
+{
+    const cJSON *cred = NULL, *c;
+    char want[9];
+    snprintf(want, sizeof(want), "%08X", uid);
+    cJSON_ArrayForEach(c, cJSON_GetObjectItem(root, "credentials")) {
+        if (strcmp(cJSON_GetObjectItem(c, "uid")->valuestring, want) == 0) { cred = c; break; }
+    }
+    if (!cred) return false;
+    int dtype = slot / POLICY_SLOTS_PER_DAY, s = slot % POLICY_SLOTS_PER_DAY;
+    const cJSON *g;
+    cJSON_ArrayForEach(g, cJSON_GetObjectItem(cred, "groups")) {
+        bool allow = false, deny = false;
+        const cJSON *r;
+        cJSON_ArrayForEach(r, cJSON_GetObjectItem(root, "rules")) {
+            if (!ref_group_in(r, g->valuestring) || !ref_door_in(r, door) || !ref_covers(r, dtype, s)) continue;
+            const cJSON *e = cJSON_GetObjectItem(r, "effect");
+            if (e && strcmp(e->valuestring, "deny") == 0) deny = true;
+            else allow = true;
+        }
+        if (allow && !deny) return true;
+    }
+    const cJSON *r;
+    cJSON_ArrayForEach(r, cJSON_GetObjectItem(cred, "rules")) {
+        if (ref_door_in(r, door) && ref_covers(r, dtype, s)) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+
+static double now_s(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    int n_rules = 10000, n_creds = 10000;
+    long verify = 2000, queries = 20000000;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (v && !strcmp(a, "--rules")) n_rules = atoi(v);
+        else if (v && !strcmp(a, "--creds")) n_creds = atoi(v);
+        else if (v && !strcmp(a, "--verify")) verify = atol(v);
+        else if (v && !strcmp(a, "--queries")) queries = atol(v);
+        else {
+            fprintf(stderr, "uso: policy_bench [--rules N (10000)] [--creds N (10000)] "
+                            "[--verify N (2000)] [--queries N]\n");
+            return 2;
+        }
+        ++i;
+    }
+    if (n_rules < 0 || n_creds < 1) return 2;
+
+    uint32_t *uids = malloc(sizeof(uint32_t) * (size_t)n_creds);
+    char *json = gen_policy(n_rules, n_creds, uids);
+    size_t json_len = strlen(json);
+
+    double t0 = now_s();
+    char err[96];
+    policy_t *p = policy_compile(json, json_len, err, sizeof(err));
+    double t_compile = now_s() - t0;
+    if (!p) {
+        fprintf(stderr, "FALLO compilando: %s\n", err);
+        return 1;
+    }
+    printf("política: %u reglas, %u tarjetas, %u horarios personales, JSON %zu KB\n",
+           (unsigned)p->n_rules, (unsigned)p->n_creds, (unsigned)p->n_sched, json_len / 1024);
+    printf("compilada en %.1f ms, tabla %zu KB\n", t_compile * 1e3, policy_size(p) / 1024);
+
+    cJSON *root = cJSON_Parse(json);
+    // Consultas: 90 % tarjetas conocidas, el resto desconocidas
+    long nq = queries > verify ? queries : verify;
+    uint32_t *q_uid = malloc(sizeof(uint32_t) * (size_t)nq);
+    uint16_t *q_slot = malloc(sizeof(uint16_t) * (size_t)nq);
+    uint8_t *q_door = malloc((size_t)nq);
+    for (long i = 0; i < nq; ++i) {
+        q_uid[i] = rnd_n(10) ? uids[rnd_n(n_creds)] : rnd32() | 1u;
+        q_slot[i] = (uint16_t)rnd_n(POLICY_SLOTS);
+        q_door[i] = (uint8_t)rnd_n(POLICY_MAX_DOORS);
+    }
+
+    long allowed = 0;
+    for (long i = 0; i < verify; ++i) {
+        uint8_t id[4] = { (uint8_t)(q_uid[i] >> 24), (uint8_t)(q_uid[i] >> 16), (uint8_t)(q_uid[i] >> 8), (uint8_t)q_uid[i] };
+        bool got = policy_decide(p, q_door[i], CRED_RFID, id, 4, q_slot[i]) == POLICY_ALLOW;
+        bool want = ref_decide(root, q_uid[i], q_door[i], q_slot[i]);
+        if (got != want) {
+            fprintf(stderr, "FALLO: uid %08X puerta %d franja %d: tabla=%d referencia=%d\n",
+                    q_uid[i], q_door[i], q_slot[i], got, want);
+            return 1;
+        }
+        allowed += got;
+    }
+    if (verify > 0) printf("verificación: %ld consultas coinciden con la referencia (%ld permitidas)\n", verify, allowed);
+
+    t0 = now_s();
+    uint32_t acc = 0;
+    for (long i = 0; i < queries; ++i) {
+        uint8_t id[4] = { (uint8_t)(q_uid[i] >> 24), (uint8_t)(q_uid[i] >> 16), (uint8_t)(q_uid[i] >> 8), (uint8_t)q_uid[i] };
+        acc += policy_decide(p, q_door[i], CRED_RFID, id, 4, q_slot[i]) == POLICY_ALLOW;
+    }
+    double t_tab = now_s() - t0;
+
+    long nref = 300;
+    t0 = now_s();
+    for (long i = 0; i < nref; ++i) acc += ref_decide(root, q_uid[i], q_door[i], q_slot[i]);
+    double t_ref = now_s() - t0;
+
+    printf("[tabla] %.1f M decisiones/s (%.0f ns/decisión)\n", queries / t_tab / 1e6, t_tab * 1e9 / queries);
+    printf("[json]  %.0f decisiones/s (%.0f us/decisión), %.0fx más lento (acc=%u)\n",
+           nref / t_ref, t_ref * 1e6 / nref, (t_ref / nref) / (t_tab / queries), (unsigned)acc);
+
+    cJSON_Delete(root);
+    policy_free(p);
+    free(json);
+    return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * power_sim: consumo medio y latencia añadida de cada perfil de energía
+ * (main/power_prof.h) con el tráfico de una puerta.
+ *
+ * Línea de tiempo de lo que mantiene despierta la CPU:
+ *   rfid   un barrido cada rfid_ms: 15 ms por lector (REQA hasta TimerIRq),
+ *          +1 ms si el lector sale de soft power-down
+ *   pot    una lectura de 0,3 ms cada pot_idle_ms, o cada 120 ms durante una
+ *          combinación (--combos por hora, 12 s cada una)
+ *   radio  3 ms por beacon escuchado (cada DTIM o cada n beacons); con la
+ *          radio siempre encendida la CPU no duerme nunca
+ *   acceso control 1 ms + LCD 3 ms + envío MQTT 2 ms por tarjeta u orden
+ *          remota (--swipes y --remotes por hora) y por cada cierre
+ * Tickless idle: un hueco entre actividades de al menos 3 ticks (30 ms,
+ * CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP) se duerme en sueño ligero salvo
+ * 1 ms de entrada y salida; los huecos menores, CPU ociosa a la frecuencia
+ * mínima. A la máxima solo con un cerrojo de DFS: la radio despierta (beacon,
+ * envío MQTT; siempre con la radio encendida) y la decisión de control_task
+ * (hal_pm_busy); el barrido RFID, el potenciómetro y el LCD van a la mínima.
+ * Con las fracciones dormida y a la máxima, power_est_ma() da la corriente
+ * media (la misma función que usa el firmware para iot/power).
+ *
+ * Latencia hasta que control_task tiene la credencial (Monte Carlo):
+ *   tarjeta  presentación -> siguiente barrido del lector de la puerta 0
+ *            (+ arranque del lector, + lectura a la frecuencia mínima)
+ *   remoto   llegada al AP -> siguiente beacon escuchado (el AP la retiene)
+ *   reed     flanco -> ISR (+ salida del sueño ligero si dormía)
+ *
+ * Compilar: make -C tools power_sim   (binario en tools/build/)
+ * Ejemplos: tools/build/power_sim
+ *           tools/build/power_sim --doors 4 --swipes 300 --battery-mah 10000
+ *           tools/build/power_sim --check
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "power_prof.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define IDLE_BEFORE_SLEEP_US MS(30)   // 3 ticks de 10 ms
+#define SLEEP_OVERHEAD_US    1000     // Entrada + salida del sueño ligero
+#define SLEEP_EXIT_US        1000     // Salida: PLL, caché de flash (ESP32)
+#define READER_WAKE_US       1000     // Oscilador del MFRC522 tras soft power-down
+#define READER_POLL_US       15000
+#define POT_SAMPLE_US        300
+#define POT_ACTIVE_MS        120
+#define COMBO_US             MS(12000)
+#define ACCESS_US            6000
+#define ACCESS_FMAX_US       3000     // Con cerrojo: control 1 ms + envío MQTT 2 ms
+#define BEACON_AWAKE_US      ((int64_t)(POWER_MS_BEACON * 1000))
+#define BEACON_US            ((int64_t)(POWER_MS_BEACON_TU * 1000))
+#define READ_CPU_US_240      300      // anticolisión + cred_post a 240 MHz
+#define LAT_SAMPLES          20000
+
+typedef struct {
+    double hours;
+    int doors;
+    double swipes, remotes, combos;   // Por hora
+    double battery_mah;
+    int dtim;                          // Periodo DTIM del AP (beacons)
+} load_t;
+
+// ---- Línea de tiempo ----
+typedef struct {
+    int64_t start, end;
+} span_t;
+
+typedef struct {
+    span_t *v;
+    size_t n, cap;
+} spans_t;
+
+static void span_add(spans_t *s, int64_t start, int64_t dur)
+{
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(span_t));
+        if (!s->v) { perror("realloc"); exit(1); }
+    }
+    s->v[s->n++] = (span_t){ start, start + dur };
+}
+
+static int span_cmp(const void *a, const void *b)
+{
+    int64_t x = ((const span_t *)a)->start, y = ((const span_t *)b)->start;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double sleep_frac;
+    double busy_frac;                  // A la frecuencia máxima
+    double wakeups_s;
+    double ma;
+    double card_p50, card_p99, remote_p50, remote_p99, reed_p99;   // ms
+} result_t;
+
+// Intervalo entre beacons escuchados (0: radio siempre encendida)
+static int64_t listen_us(const power_prof_t *p, const load_t *ld)
+{
+    if (p->wifi_listen < 0) return 0;
+    int n = p->wifi_listen > 0 ? p->wifi_listen : ld->dtim;
+    return BEACON_US * n;
+}
+
+static int64_t reader_us(const power_prof_t *p)
+{
+    return READER_POLL_US + (p->rfid_sleep ? READER_WAKE_US : 0);
+}
+
+// s: todo lo que mantiene despierta la CPU; fmax: lo que la sube a la máxima
+static void build_timeline(const power_prof_t *p, const load_t *ld, spans_t *s, spans_t *fmax)
+{
+    int64_t end = (int64_t)(ld->hours * 3600e6);
+    s->n = fmax->n = 0;
+    for (int64_t t = 0; t < end; t += MS(p->rfid_ms)) span_add(s, t, ld->doors * reader_us(p));
+    int64_t lis = listen_us(p, ld);
+    if (lis) {
+        // Fase arbitraria respecto al barrido
+        for (int64_t t = 37000; t < end; t += lis) {
+            span_add(s, t, BEACON_AWAKE_US);
+            span_add(fmax, t, BEACON_AWAKE_US);
+        }
+    }
+    // Potenciómetro: en reposo al ritmo del perfil, rápido durante una combinación
+    int64_t combo_at = ld->combos > 0 ? exp_us(3600e6 / ld->combos) : end;
+    for (int64_t t = 5000; t < end;) {
+        span_add(s, t, POT_SAMPLE_US);
+        bool active = t >= combo_at && t < combo_at + COMBO_US;
+        if (t >= combo_at + COMBO_US) combo_at = t + exp_us(3600e6 / ld->combos);
+        t += MS(active ? POT_ACTIVE_MS : p->pot_idle_ms);
+    }
+    // Accesos: la credencial, la apertura y el cierre (cada uno con su trabajo)
+    double rate = ld->swipes + ld->remotes;
+    if (rate > 0) {
+        for (int64_t t = exp_us(3600e6 / rate); t < end; t += exp_us(3600e6 / rate)) {
+            for (int k = 0; k < 3; ++k) {
+                int64_t at = t + (k == 0 ? 0 : k == 1 ? MS(1500) : MS(6000));
+                span_add(s, at, ACCESS_US);
+                span_add(fmax, at, ACCESS_FMAX_US);
+            }
+        }
+    }
+    qsort(s->v, s->n, sizeof(span_t), span_cmp);
+    qsort(fmax->v, fmax->n, sizeof(span_t), span_cmp);
+}
+
+// Tiempo cubierto por la unión de los intervalos (ordenados)
+static int64_t span_cover(const spans_t *s)
+{
+    int64_t cover = 0, busy_end = 0;
+    for (size_t i = 0; i < s->n; ++i) {
+        int64_t from = s->v[i].start > busy_end ? s->v[i].start : busy_end;
+        if (s->v[i].end > from) cover += s->v[i].end - from;
+        if (s->v[i].end > busy_end) busy_end = s->v[i].end;
+    }
+    return cover;
+}
+
+// Huecos de la línea de tiempo: dormidos si el perfil lo permite y caben
+static void account_sleep(const power_prof_t *p, const spans_t *s, double hours, result_t *r)
+{
+    int64_t end = (int64_t)(hours * 3600e6), slept = 0, busy_end = 0;
+    uint64_t wakeups = 0;
+    bool can_sleep = p->light_sleep && p->wifi_listen >= 0;
+    for (size_t i = 0; i < s->n; ++i) {
+        int64_t gap = s->v[i].start - busy_end;
+        if (can_sleep && gap >= IDLE_BEFORE_SLEEP_US) {
+            slept += gap - SLEEP_OVERHEAD_US;
+            wakeups++;
+        }
+        if (s->v[i].end > busy_end) busy_end = s->v[i].end;
+    }
+    r->sleep_frac = (double)slept / end;
+    r->wakeups_s = wakeups / (hours * 3600);
+}
+
+static void account_fmax(const power_prof_t *p, const spans_t *fmax, double hours, result_t *r)
+{
+    // Con la radio siempre encendida su cerrojo no se suelta nunca
+    r->busy_frac = p->wifi_listen < 0 ? 1.0 - r->sleep_frac : (double)span_cover(fmax) / (hours * 3600e6);
+}
+
+static int dbl_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(double *v, int n, double p)
+{
+    qsort(v, n, sizeof(double), dbl_cmp);
+    int i = (int)(p * n);
+    return v[i < n ? i : n - 1];
+}
+
+static void latencies(const power_prof_t *p, const load_t *ld, result_t *r)
+{
+    static double card[LAT_SAMPLES], remote[LAT_SAMPLES], reed[LAT_SAMPLES];
+    int64_t period = MS(p->rfid_ms), lis = listen_us(p, ld);
+    // La lectura de la tarjeta corre a la frecuencia mínima (sin cerrojo de DFS)
+    double read_us = READ_CPU_US_240 * 240.0 / p->cpu_min_mhz;
+    for (int i = 0; i < LAT_SAMPLES; ++i) {
+        double phase = urand() * period;
+        card[i] = (period - phase + (p->rfid_sleep ? READER_WAKE_US : 0) + READER_POLL_US / 10.0 + read_us) / 1000;
+        remote[i] = lis ? urand() * lis / 1000.0 : 0;
+        bool asleep = urand() < r->sleep_frac;
+        reed[i] = asleep ? SLEEP_EXIT_US / 1000.0 : 0.01;
+    }
+    r->card_p50 = pct(card, LAT_SAMPLES, 0.50);
+    r->card_p99 = pct(card, LAT_SAMPLES, 0.99);
+    r->remote_p50 = pct(remote, LAT_SAMPLES, 0.50);
+    r->remote_p99 = pct(remote, LAT_SAMPLES, 0.99);
+    r->reed_p99 = pct(reed, LAT_SAMPLES, 0.99);
+}
+
+static result_t run_profile(const power_prof_t *p, const load_t *ld, unsigned seed)
+{
+    static spans_t s, fmax;
+    result_t r = { 0 };
+    g_rng = 0x9E3779B97F4A7C15ULL * (seed + 1);
+    build_timeline(p, ld, &s, &fmax);
+    account_sleep(p, &s, ld->hours, &r);
+    account_fmax(p, &fmax, ld->hours, &r);
+    r.ma = power_est_ma(p, r.sleep_frac, r.busy_frac, ld->doors);
+    latencies(p, ld, &r);
+    return r;
+}
+
+static int run_bench(const load_t *ld, unsigned seed)
+{
+    result_t res[POWER_PROF_COUNT];
+    printf("power_sim: %.0f h, %d puerta(s), %.0f tarjetas/h, %.0f órdenes/h, %.0f combinaciones/h, DTIM %d\n",
+           ld->hours, ld->doors, ld->swipes, ld->remotes, ld->combos, ld->dtim);
+    printf("  %-9s %9s %8s %8s %9s %7s %10s   %-17s %-17s %s\n", "perfil", "CPU MHz", "sueño", "a máx", "desp./s",
+           "mA", "autonomía", "tarjeta p50/p99", "remoto p50/p99", "reed p99 (ms)");
+    for (int i = 0; i < POWER_PROF_COUNT; ++i) {
+        const power_prof_t *p = &power_profiles[i];
+        result_t *r = &res[i];
+        *r = run_profile(p, ld, seed);
+        char mhz[16];
+        snprintf(mhz, sizeof(mhz), "%u-%u", p->cpu_min_mhz, p->cpu_max_mhz);
+        double hours = ld->battery_mah / r->ma;
+        printf("  %-9s %9s %6.1f%% %6.1f%% %9.1f %7.1f %7.1f d   %7.1f %7.1f   %7.1f %7.1f   %.2f\n", p->name,
+               mhz, r->sleep_frac * 100, r->busy_frac * 100, r->wakeups_s, r->ma, hours / 24, r->card_p50,
+               r->card_p99, r->remote_p50, r->remote_p99, r->reed_p99);
+    }
+    const result_t *perf = &res[POWER_PERF];
+    for (int i = 1; i < POWER_PROF_COUNT; ++i) {
+        const result_t *r = &res[i];
+        printf("  %-9s frente a perf: -%.0f%% de corriente, tarjeta p99 %+.1f ms, remoto p99 %+.1f ms\n",
+               power_profiles[i].name, 100 * (1 - r->ma / perf->ma), r->card_p99 - perf->card_p99,
+               r->remote_p99 - perf->remote_p99);
+    }
+    check(res[POWER_BATTERY].ma < res[POWER_BALANCED].ma && res[POWER_BALANCED].ma < perf->ma,
+          "los perfiles no ordenan el consumo");
+    check(perf->sleep_frac == 0, "perf no debe dormir");
+    // El perfil equilibrado no debe retrasar la tarjeta más de un barrido extra
+    check(res[POWER_BALANCED].card_p99 <= perf->card_p99 + 5, "balanced retrasa la tarjeta");
+    return g_fail;
+}
+
+// ---- Comprobaciones ----
+
+static void run_checks(void)
+{
+    printf("power_prof:\n");
+    for (int i = 0; i < POWER_PROF_COUNT; ++i) {
+        const power_prof_t *p = &power_profiles[i];
+        check(power_prof_find(p->name) == i, "power_prof_find");
+        check(p->cpu_min_mhz <= p->cpu_max_mhz, "frecuencia mínima por encima de la máxima");
+        check(!p->light_sleep || p->wifi_listen >= 0, "sueño ligero con la radio siempre encendida");
+        check(p->rfid_ms >= 150 && p->rfid_ms <= 1000, "barrido RFID fuera de 150..1000 ms");
+        check(p->pot_idle_ms >= POT_ACTIVE_MS, "potenciómetro en reposo más rápido que activo");
+        check(p->rfid_ms * 1000 > 4 * reader_us(p), "cuatro lectores no caben en un barrido");
+    }
+    check(power_prof_find("turbo") == -1, "perfil desconocido");
+    const power_prof_t *perf = &power_profiles[POWER_PERF];
+    check(fabs(power_est_ma(perf, 0, 1, 1) - (power_cpu_ma(240) + POWER_MA_RADIO_RX + POWER_MA_READER_ON)) < 1e-9,
+          "perf: CPU, radio y lector encendidos");
+    const power_prof_t *bat = &power_profiles[POWER_BATTERY];
+    check(power_est_ma(bat, 1.0, 0, 0) < power_est_ma(bat, 0.5, 0, 0), "dormir más consume menos");
+    check(power_est_ma(bat, 2.0, 0, 0) == power_est_ma(bat, 1.0, 0, 0), "fracción de sueño acotada");
+    check(fabs(power_est_ma(bat, 0.5, 0.2, 0) - power_est_ma(bat, 0.5, 0, 0) -
+               0.2 * (power_cpu_ma(bat->cpu_max_mhz) - power_cpu_ma(bat->cpu_min_mhz))) < 1e-9,
+          "el trabajo se cobra a la frecuencia máxima");
+    check(power_est_ma(bat, 0.8, 0.5, 0) == power_est_ma(bat, 0.8, 0.2, 0), "trabajo acotado por el tiempo despierto");
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones]\n"
+            "  --hours H          duración virtual (24)\n"
+            "  --doors N          lectores en el bus (1, DOOR_COUNT)\n"
+            "  --swipes N         tarjetas por hora (60)\n"
+            "  --remotes N        órdenes remotas por hora (6)\n"
+            "  --combos N         combinaciones por hora (2)\n"
+            "  --dtim N           periodo DTIM del AP en beacons (1)\n"
+            "  --battery-mah MAH  capacidad para la autonomía (2600)\n"
+            "  --seed S           semilla (1)\n"
+            "  --check            pruebas de power_prof\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    load_t ld = { .hours = 24, .doors = 1, .swipes = 60, .remotes = 6, .combos = 2, .battery_mah = 2600, .dtim = 1 };
+    unsigned seed = 1;
+    bool only_check = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--check")) { only_check = true; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--hours")) ld.hours = atof(v);
+        else if (!strcmp(a, "--doors")) ld.doors = atoi(v);
+        else if (!strcmp(a, "--swipes")) ld.swipes = atof(v);
+        else if (!strcmp(a, "--remotes")) ld.remotes = atof(v);
+        else if (!strcmp(a, "--combos")) ld.combos = atof(v);
+        else if (!strcmp(a, "--dtim")) ld.dtim = atoi(v);
+        else if (!strcmp(a, "--battery-mah")) ld.battery_mah = atof(v);
+        else if (!strcmp(a, "--seed")) seed = arg_seed(v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (ld.hours <= 0 || ld.doors < 1 || ld.doors > 4 || ld.swipes < 0 || ld.remotes < 0 || ld.combos < 0 ||
+        ld.dtim < 1 || ld.battery_mah <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    run_checks();
+    if (only_check) return g_fail;
+    return run_bench(&ld, seed);
+}
@@ -0,0 +1,527 @@
+/*
+ * prof_sym: resuelve contra el ELF los volcados del perfilado del firmware
+ * (main/prof.h, PROF_TOPIC o consola) y los resume:
+ *   - CPU media de cada tarea en todas las ventanas (100 = un núcleo)
+ *   - espera y retención de g_log_mutex y g_lcd_mutex (histogramas sumados)
+ *   - funciones más muestreadas por núcleo: cada PC se asigna al símbolo de
+ *     texto que lo contiene según `nm -S -n` (sin depurar el ELF)
+ *
+ * La entrada es texto con un volcado JSON por línea: la salida de
+ * mosquitto_sub o el registro de idf.py monitor (se toma desde el primer '{'
+ * de las líneas con "pcs"); el resto de líneas se ignora.
+ *
+ * Compilar: make -C tools prof_sym   (binario en tools/build/)
+ * Ejemplos: mosquitto_sub -t iot/prof -C 6 > prof.txt
+ *           tools/build/prof_sym --elf build/projectv1.elf prof.txt
+ *           idf.py monitor | tee mon.txt; tools/build/prof_sym --elf build/projectv1.elf --lines 5 mon.txt
+ *           xtensa-esp32-elf-nm -S -n build/projectv1.elf > syms.txt; tools/build/prof_sym --syms syms.txt prof.txt
+ *           tools/build/prof_sym --check
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "prof.h"
+#include "tool_util.h"
+
+#define MAX_CORES 2
+#define MAX_TASKS 48
+#define MAX_LOCKS 4
+#define MAX_ADDRS 4096
+
+// ---- Símbolos (salida de nm -S -n o nm -n) ----
+typedef struct {
+    uint32_t addr, size;      // size 0: hasta el siguiente símbolo
+    char *name;
+} sym_t;
+
+static sym_t *g_syms;
+static size_t g_nsyms, g_syms_cap;
+
+static int sym_cmp(const void *a, const void *b)
+{
+    uint32_t x = ((const sym_t *)a)->addr, y = ((const sym_t *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+// "400d1234 00000020 T nombre" o "400d1234 T nombre"; solo símbolos de texto
+static void syms_add_line(const char *line)
+{
+    char a[32], b[32], c[256], d[256];
+    unsigned long addr, size = 0;
+    char type;
+    const char *name;
+    int k = sscanf(line, "%31s %31s %255s %255s", a, b, c, d);
+    if (k == 4 && strlen(c) == 1) {
+        addr = strtoul(a, NULL, 16);
+        size = strtoul(b, NULL, 16);
+        type = c[0];
+        name = d;
+    } else if (k == 3 && strlen(b) == 1) {
+        addr = strtoul(a, NULL, 16);
+        type = b[0];
+        name = c;
+    } else {
+        return;
+    }
+    if (type != 'T' && type != 't' && type != 'W' && type != 'w') return;
+    if (g_nsyms == g_syms_cap) {
+        g_syms_cap = g_syms_cap ? g_syms_cap * 2 : 1024;
+        g_syms = realloc(g_syms, g_syms_cap * sizeof(sym_t));
+        if (!g_syms) { perror("realloc"); exit(1); }
+    }
+    g_syms[g_nsyms++] = (sym_t){ (uint32_t)addr, (uint32_t)size, strdup(name) };
+}
+
+static void syms_sort(void)
+{
+    qsort(g_syms, g_nsyms, sizeof(sym_t), sym_cmp);
+}
+
+static bool syms_load(FILE *f)
+{
+    char line[512];
+    size_t before = g_nsyms;
+    while (fgets(line, sizeof(line), f)) syms_add_line(line);
+    syms_sort();
+    return g_nsyms > before;
+}
+
+// Índice del símbolo que contiene pc; -1 si ninguno
+static long sym_find(uint32_t pc)
+{
+    size_t lo = 0, hi = g_nsyms;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (g_syms[mid].addr <= pc) lo = mid + 1;
+        else hi = mid;
+    }
+    if (!lo) return -1;
+    const sym_t *s = &g_syms[lo - 1];
+    if (s->size ? pc >= s->addr + s->size : (lo == g_nsyms)) return -1;
+    return (long)(lo - 1);
+}
+
+// ---- Acumulado de todos los volcados ----
+typedef struct {
+    char name[24];
+    int core, prio;
+    double cpu_us;            // cpu_pct × ventana
+    unsigned stack_min;
+} task_acc_t;
+
+typedef struct {
+    char name[24];
+    prof_lock_t l;
+} lock_acc_t;
+
+typedef struct {
+    uint32_t pc;
+    uint32_t count[MAX_CORES];
+} addr_acc_t;
+
+typedef struct {
+    int dumps;
+    double window_ms;
+    uint32_t samples[MAX_CORES], lost[MAX_CORES], listed[MAX_CORES];
+    task_acc_t task[MAX_TASKS];
+    int ntask;
+    lock_acc_t lock[MAX_LOCKS];
+    int nlock;
+    addr_acc_t addr[MAX_ADDRS];
+    int naddr;
+} acc_t;
+
+static void hist_from_json(prof_hist_t *h, const cJSON *j)
+{
+    const cJSON *hist = cJSON_GetObjectItem(j, "hist");
+    const cJSON *n = cJSON_GetObjectItem(j, "n"), *mean = cJSON_GetObjectItem(j, "mean_us");
+    const cJSON *max = cJSON_GetObjectItem(j, "max_us");
+    int b = 0;
+    for (const cJSON *v = hist ? hist->child : NULL; v && b < PROF_HIST_BUCKETS; v = v->next, ++b) {
+        h->hist[b] += (uint32_t)v->valuedouble;
+    }
+    uint32_t cnt = cJSON_IsNumber(n) ? (uint32_t)n->valuedouble : 0;
+    h->n += cnt;
+    h->sum_us += (uint64_t)cnt * (cJSON_IsNumber(mean) ? (uint64_t)mean->valuedouble : 0);
+    if (cJSON_IsNumber(max) && max->valuedouble > h->max_us) h->max_us = (uint32_t)max->valuedouble;
+}
+
+static void acc_pc(acc_t *a, uint32_t pc, int core, uint32_t count)
+{
+    for (int i = 0; i < a->naddr; ++i) {
+        if (a->addr[i].pc == pc) {
+            a->addr[i].count[core] += count;
+            return;
+        }
+    }
+    if (a->naddr == MAX_ADDRS) return;
+    addr_acc_t *e = &a->addr[a->naddr++];
+    memset(e, 0, sizeof(*e));
+    e->pc = pc;
+    e->count[core] = count;
+}
+
+// Un volcado; false si no lo es
+static bool acc_dump(acc_t *a, const char *text)
+{
+    cJSON *root = cJSON_Parse(text);
+    if (!root) return false;
+    const cJSON *pcs = cJSON_GetObjectItem(root, "pcs"), *win = cJSON_GetObjectItem(root, "window_ms");
+    if (!cJSON_IsArray(pcs) || !cJSON_IsNumber(win)) {
+        cJSON_Delete(root);
+        return false;
+    }
+    a->dumps++;
+    a->window_ms += win->valuedouble;
+    const cJSON *t;
+    cJSON_ArrayForEach(t, cJSON_GetObjectItem(root, "tasks")) {
+        const cJSON *name = cJSON_GetObjectItem(t, "name");
+        if (!cJSON_IsString(name)) continue;
+        task_acc_t *e = NULL;
+        for (int i = 0; i < a->ntask && !e; ++i) {
+            if (!strcmp(a->task[i].name, name->valuestring)) e = &a->task[i];
+        }
+        if (!e) {
+            if (a->ntask == MAX_TASKS) continue;
+            e = &a->task[a->ntask++];
+            memset(e, 0, sizeof(*e));
+            snprintf(e->name, sizeof(e->name), "%s", name->valuestring);
+            e->stack_min = UINT32_MAX;
+        }
+        const cJSON *v;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "core"))) e->core = (int)v->valuedouble;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "prio"))) e->prio = (int)v->valuedouble;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "cpu_pct"))) e->cpu_us += v->valuedouble * win->valuedouble;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "stack_free")) && v->valuedouble < e->stack_min) {
+            e->stack_min = (unsigned)v->valuedouble;
+        }
+    }
+    const cJSON *locks = cJSON_GetObjectItem(root, "locks");
+    for (const cJSON *l = locks ? locks->child : NULL; l; l = l->next) {
+        lock_acc_t *e = NULL;
+        for (int i = 0; i < a->nlock && !e; ++i) {
+            if (!strcmp(a->lock[i].name, l->string)) e = &a->lock[i];
+        }
+        if (!e) {
+            if (a->nlock == MAX_LOCKS) continue;
+            e = &a->lock[a->nlock++];
+            memset(e, 0, sizeof(*e));
+            snprintf(e->name, sizeof(e->name), "%s", l->string);
+        }
+        const cJSON *c = cJSON_GetObjectItem(l, "contended");
+        if (cJSON_IsNumber(c)) e->l.contended += (uint32_t)c->valuedouble;
+        hist_from_json(&e->l.wait, cJSON_GetObjectItem(l, "wait"));
+        hist_from_json(&e->l.hold, cJSON_GetObjectItem(l, "hold"));
+    }
+    cJSON_ArrayForEach(t, pcs) {
+        const cJSON *core = cJSON_GetObjectItem(t, "core");
+        int c = cJSON_IsNumber(core) ? (int)core->valuedouble : 0;
+        if (c < 0 || c >= MAX_CORES) continue;
+        const cJSON *v;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "samples"))) a->samples[c] += (uint32_t)v->valuedouble;
+        if (cJSON_IsNumber(v = cJSON_GetObjectItem(t, "lost"))) a->lost[c] += (uint32_t)v->valuedouble;
+        const cJSON *e;
+        cJSON_ArrayForEach(e, cJSON_GetObjectItem(t, "top")) {
+            const cJSON *pc = cJSON_GetArrayItem(e, 0), *cnt = cJSON_GetArrayItem(e, 1);
+            if (!cJSON_IsString(pc) || !cJSON_IsNumber(cnt)) continue;
+            acc_pc(a, (uint32_t)strtoul(pc->valuestring, NULL, 16), c, (uint32_t)cnt->valuedouble);
+            a->listed[c] += (uint32_t)cnt->valuedouble;
+        }
+    }
+    cJSON_Delete(root);
+    return true;
+}
+
+static int acc_read(acc_t *a, FILE *f)
+{
+    static char line[65536];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *brace = strchr(line, '{');
+        if (brace && strstr(brace, "\"pcs\"") && acc_dump(a, brace)) n++;
+    }
+    return n;
+}
+
+// ---- Funciones ----
+typedef struct {
+    long sym;                 // -1: sin símbolo (pc)
+    uint32_t pc;
+    uint32_t count[MAX_CORES];
+} func_t;
+
+static int func_cmp(const void *x, const void *y)
+{
+    const func_t *a = x, *b = y;
+    uint32_t ta = a->count[0] + a->count[1], tb = b->count[0] + b->count[1];
+    return (ta < tb) - (ta > tb);
+}
+
+static int addr_cmp(const void *x, const void *y)
+{
+    const addr_acc_t *a = x, *b = y;
+    uint32_t ta = a->count[0] + a->count[1], tb = b->count[0] + b->count[1];
+    return (ta < tb) - (ta > tb);
+}
+
+// Agrupa los PCs por símbolo; devuelve el número de funciones en out
+static int funcs_build(const acc_t *a, func_t *out)
+{
+    int n = 0;
+    for (int i = 0; i < a->naddr; ++i) {
+        long s = sym_find(a->addr[i].pc);
+        func_t *f = NULL;
+        for (int k = 0; k < n && !f; ++k) {
+            if (s >= 0 ? out[k].sym == s : (out[k].sym < 0 && out[k].pc == a->addr[i].pc)) f = &out[k];
+        }
+        if (!f) {
+            f = &out[n++];
+            memset(f, 0, sizeof(*f));
+            f->sym = s;
+            f->pc = s >= 0 ? g_syms[s].addr : a->addr[i].pc;
+        }
+        for (int c = 0; c < MAX_CORES; ++c) f->count[c] += a->addr[i].count[c];
+    }
+    qsort(out, n, sizeof(func_t), func_cmp);
+    return n;
+}
+
+static void print_report(acc_t *a, int top, int lines, const char *elf, const char *addr2line)
+{
+    uint32_t total = a->samples[0] + a->samples[1];
+    printf("prof_sym: %d volcado(s), %.1f s; muestras: núcleo 0 %u (%u perdidas), núcleo 1 %u (%u perdidas)\n",
+           a->dumps, a->window_ms / 1000, (unsigned)a->samples[0], (unsigned)a->lost[0], (unsigned)a->samples[1],
+           (unsigned)a->lost[1]);
+
+    printf("\nTareas (CPU media, 100 = un núcleo entero):\n");
+    printf("  %-16s %6s %5s %8s %11s\n", "tarea", "núcleo", "prio", "CPU %", "pila libre");
+    for (int i = 0; i < a->ntask; ++i) {
+        const task_acc_t *t = &a->task[i];
+        char core[8];
+        snprintf(core, sizeof(core), "%s", t->core < 0 ? "-" : (t->core ? "1" : "0"));
+        printf("  %-16s %6s %5d %8.2f %11u\n", t->name, core, t->prio, a->window_ms > 0 ? t->cpu_us / a->window_ms : 0,
+               t->stack_min);
+    }
+
+    printf("\nMutex (us, percentiles con la resolución de un cubo de potencia de 2):\n");
+    for (int i = 0; i < a->nlock; ++i) {
+        const prof_lock_t *l = &a->lock[i].l;
+        printf("  %-12s tomas %u, %u con espera | espera p50 %u p99 %u máx %u | retención p50 %u p99 %u máx %u\n",
+               a->lock[i].name, (unsigned)l->wait.n, (unsigned)l->contended, (unsigned)prof_hist_pct_us(&l->wait, 0.5),
+               (unsigned)prof_hist_pct_us(&l->wait, 0.99), (unsigned)l->wait.max_us,
+               (unsigned)prof_hist_pct_us(&l->hold, 0.5), (unsigned)prof_hist_pct_us(&l->hold, 0.99),
+               (unsigned)l->hold.max_us);
+    }
+
+    static func_t funcs[MAX_ADDRS];
+    int nf = funcs_build(a, funcs);
+    printf("\nFunciones (%% de las muestras de ambos núcleos):\n");
+    printf("  %6s %8s %8s %8s  %s\n", "%", "total", "núcleo 0", "núcleo 1", "función");
+    for (int i = 0; i < nf && i < top; ++i) {
+        const func_t *f = &funcs[i];
+        uint32_t n = f->count[0] + f->count[1];
+        char name[300];
+        if (f->sym >= 0) snprintf(name, sizeof(name), "%s", g_syms[f->sym].name);
+        else snprintf(name, sizeof(name), "?? 0x%08x", (unsigned)f->pc);
+        printf("  %6.2f %8u %8u %8u  %s\n", total ? 100.0 * n / total : 0, (unsigned)n, (unsigned)f->count[0],
+               (unsigned)f->count[1], name);
+    }
+    uint32_t rest = total - a->lost[0] - a->lost[1] - a->listed[0] - a->listed[1];
+    if (rest) printf("  %6.2f %8u %8s %8s  (PCs fuera de los más frecuentes de cada volcado)\n", 100.0 * rest / total,
+                     (unsigned)rest, "", "");
+
+    if (lines > 0 && elf) {
+        // Línea de código de los PCs más frecuentes (addr2line sobre el ELF)
+        qsort(a->addr, a->naddr, sizeof(addr_acc_t), addr_cmp);
+        char cmd[4096];
+        int n = snprintf(cmd, sizeof(cmd), "%s -pfiaC -e '%s'", addr2line, elf);
+        for (int i = 0; i < a->naddr && i < lines && n < (int)sizeof(cmd) - 16; ++i) {
+            n += snprintf(cmd + n, sizeof(cmd) - n, " 0x%08x", (unsigned)a->addr[i].pc);
+        }
+        printf("\nPCs más frecuentes (%s):\n", addr2line);
+        fflush(stdout);
+        if (system(cmd) != 0) fprintf(stderr, "prof_sym: falló: %s\n", cmd);
+    }
+}
+
+// ---- Comprobaciones ----
+
+static void run_checks(void)
+{
+    printf("prof:\n");
+    prof_hist_t h = { 0 };
+    prof_hist_add(&h, 0);
+    prof_hist_add(&h, 1);
+    prof_hist_add(&h, 3);
+    prof_hist_add(&h, -5);
+    check(h.hist[0] == 2 && h.hist[1] == 1 && h.hist[2] == 1, "cubos de potencia de 2");
+    for (int i = 0; i < 96; ++i) prof_hist_add(&h, 100);
+    check(prof_hist_pct_us(&h, 0.5) == 100, "p50 acotado por el máximo");
+    prof_hist_add(&h, 5000000);
+    check(h.hist[PROF_HIST_BUCKETS - 1] == 1 && h.max_us == 5000000, "último cubo");
+    check(prof_hist_pct_us(&h, 0.999) == 5000000, "percentil en el último cubo");
+
+    prof_lock_t l = { 0 };
+    prof_lock_giving(&l, 50);
+    check(l.hold.n == 0, "suelta sin toma medida");
+    prof_lock_taken(&l, 100, 130, true);
+    prof_lock_reset(&l);
+    check(l.wait.n == 0 && l.held_at_us == 130, "reset conserva la toma en curso");
+    prof_lock_giving(&l, 1130);
+    check(l.hold.n == 1 && l.hold.max_us == 1000, "retención");
+    char buf[1024];
+    check(prof_lock_json(&l, buf, sizeof(buf)) > 0, "prof_lock_json");
+    check(prof_lock_json(&l, buf, 20) == 0, "prof_lock_json sin sitio");
+
+    static prof_pcs_t t;
+    prof_pcs_reset(&t);
+    for (uint32_t i = 0; i < 1000; ++i) prof_pcs_add(&t, 0x400d0000 + (i % 10) * 4);
+    for (uint32_t i = 0; i < 5; ++i) prof_pcs_add(&t, 0x400d1000);
+    check(t.samples == 1005 && t.used == 11 && t.lost == 0, "tabla de PCs");
+    prof_pcs_add(&t, 0);
+    check(t.lost == 1, "PC nulo perdido");
+    prof_pcs_reset(&t);
+    uint32_t ok = 0;
+    for (uint32_t i = 0; i < 2 * PROF_PC_SLOTS; ++i) ok += prof_pcs_add(&t, 0x40080000 + i * 3);
+    check(t.used <= PROF_PC_SLOTS && ok == t.used && t.lost == 2 * PROF_PC_SLOTS - ok, "tabla llena");
+    check(t.used >= PROF_PC_SLOTS * 3 / 4, "ocupación con sondeo lineal");
+    prof_pcs_reset(&t);
+    for (uint32_t i = 0; i < 50; ++i) {
+        for (uint32_t k = 0; k <= i; ++k) prof_pcs_add(&t, 0x400d2000 + i * 2);
+    }
+    check(prof_pcs_top(&t, 3) == 3 && t.count[0] == 50 && t.count[1] == 49 && t.count[2] == 48, "top ordenado");
+
+    printf("prof_sym:\n");
+    // Volcado de ida y vuelta: prof.c genera, acc_dump lee
+    static const char *SYMS =
+        "400d0000 00000040 T app_main\n"
+        "400d0040 00000020 t lcd_render\n"
+        "40080000 T idle_loop\n"
+        "40080100 W weak_fn\n"
+        "3ffb0000 00000100 D g_data\n"
+        "         U undefined_fn\n";
+    const char *p = SYMS;
+    while (*p) {
+        char line[128];
+        size_t n = strcspn(p, "\n");
+        snprintf(line, sizeof(line), "%.*s", (int)n, p);
+        syms_add_line(line);
+        p += n + (p[n] == '\n');
+    }
+    syms_sort();
+    check(g_nsyms == 4, "solo símbolos de texto");
+    check(sym_find(0x400d0010) >= 0 && !strcmp(g_syms[sym_find(0x400d0010)].name, "app_main"), "dentro de app_main");
+    check(!strcmp(g_syms[sym_find(0x400d0044)].name, "lcd_render"), "símbolo local");
+    check(sym_find(0x400d0060) == -1, "fuera de tamaño");
+    check(!strcmp(g_syms[sym_find(0x40080010)].name, "idle_loop"), "sin tamaño: hasta el siguiente");
+    check(sym_find(0x40070000) == -1, "antes del primero");
+    check(!strcmp(g_syms[sym_find(0x40090000)].name, "weak_fn"), "débil sin tamaño");
+    check(sym_find(0x400e0000) == -1, "tras el último");
+
+    prof_pcs_reset(&t);
+    for (int i = 0; i < 70; ++i) prof_pcs_add(&t, 0x400d0004);
+    for (int i = 0; i < 20; ++i) prof_pcs_add(&t, 0x400d0008);
+    for (int i = 0; i < 10; ++i) prof_pcs_add(&t, 0x400d0050);
+    prof_pcs_add(&t, 0x50000000);
+    char pcs0[512], lk[1024];
+    check(prof_pcs_json(&t, 0, 2, pcs0, sizeof(pcs0)) > 0, "prof_pcs_json");
+    check(prof_lock_json(&l, lk, sizeof(lk)) > 0, "prof_lock_json");
+    static char dump[4096];
+    snprintf(dump, sizeof(dump),
+             "I (1234) ACCESS: PROF {\"device_id\":\"x\",\"window_ms\":10000,\"hz\":997,\"tasks\":["
+             "{\"name\":\"control\",\"core\":1,\"prio\":7,\"cpu_pct\":2.5,\"stack_free\":1200}],"
+             "\"locks\":{\"g_log_mutex\":%s},\"pcs\":[%s]}\x1b[0m\n",
+             lk, pcs0);
+    static acc_t a;
+    memset(&a, 0, sizeof(a));
+    FILE *f = fmemopen(dump, strlen(dump), "r");
+    check(f && acc_read(&a, f) == 1, "volcado en una línea de registro");
+    if (f) fclose(f);
+    check(acc_dump(&a, dump + strcspn(dump, "{")) && a.dumps == 2, "segundo volcado");
+    check(a.samples[0] == 202 && a.listed[0] == 180, "muestras y PCs listados");
+    check(a.ntask == 1 && a.task[0].cpu_us == 2 * 2.5 * 10000 && a.task[0].stack_min == 1200, "tareas");
+    check(a.nlock == 1 && a.lock[0].l.hold.n == 2 && a.lock[0].l.hold.max_us == 1000, "mutex sumados");
+    static func_t fn[MAX_ADDRS];
+    int nf = funcs_build(&a, fn);
+    check(nf == 1 && fn[0].count[0] == 180 && !strcmp(g_syms[fn[0].sym].name, "app_main"), "funciones agrupadas");
+    check(!acc_dump(&a, "{\"window_ms\":1}") && !acc_dump(&a, "no es json"), "líneas que no son volcados");
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones] [volcados.txt ...]   (sin archivos: entrada estándar)\n"
+            "  --elf ELF          símbolos con nm sobre el ELF del firmware\n"
+            "  --syms ARCHIVO     símbolos ya extraídos (salida de nm -S -n)\n"
+            "  --nm NM            nm a usar (xtensa-esp32-elf-nm)\n"
+            "  --top N            funciones a mostrar (25)\n"
+            "  --lines N          línea de código de los N PCs más frecuentes (con --elf)\n"
+            "  --addr2line A2L    addr2line a usar (xtensa-esp32-elf-addr2line)\n"
+            "  --check            pruebas de prof y del resolvedor\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *elf = NULL, *syms = NULL, *nm = "xtensa-esp32-elf-nm", *a2l = "xtensa-esp32-elf-addr2line";
+    int top = 25, lines = 0, nfiles = 0;
+    const char *files[64];
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--check")) {
+            run_checks();
+            return g_fail;
+        }
+        if (a[0] != '-' || !a[1]) {
+            if (nfiles < 64) files[nfiles++] = a;
+            continue;
+        }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--elf")) elf = v;
+        else if (!strcmp(a, "--syms")) syms = v;
+        else if (!strcmp(a, "--nm")) nm = v;
+        else if (!strcmp(a, "--top")) top = atoi(v);
+        else if (!strcmp(a, "--lines")) lines = atoi(v);
+        else if (!strcmp(a, "--addr2line")) a2l = v;
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (top < 1) { usage(argv[0]); return 2; }
+
+    if (syms) {
+        FILE *f = fopen(syms, "r");
+        if (!f || !syms_load(f)) { fprintf(stderr, "prof_sym: sin símbolos en %s\n", syms); return 1; }
+        fclose(f);
+    } else if (elf) {
+        char cmd[1024];
+        snprintf(cmd, sizeof(cmd), "%s -S -n --defined-only '%s'", nm, elf);
+        FILE *f = popen(cmd, "r");
+        bool ok = f && syms_load(f);
+        if (f) pclose(f);
+        if (!ok) { fprintf(stderr, "prof_sym: sin símbolos de %s (¿está %s en el PATH?)\n", elf, nm); return 1; }
+    } else {
+        fprintf(stderr, "prof_sym: sin --elf ni --syms los PCs quedan sin resolver\n");
+    }
+
+    static acc_t acc;
+    int dumps = 0;
+    if (!nfiles) dumps = acc_read(&acc, stdin);
+    for (int i = 0; i < nfiles; ++i) {
+        FILE *f = fopen(files[i], "r");
+        if (!f) { perror(files[i]); return 1; }
+        dumps += acc_read(&acc, f);
+        fclose(f);
+    }
+    if (!dumps) {
+        fprintf(stderr, "prof_sym: ningún volcado (líneas JSON con \"pcs\")\n");
+        return 1;
+    }
+    print_report(&acc, top, lines, elf, a2l);
+    return 0;
+}
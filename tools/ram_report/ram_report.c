@@ -0,0 +1,478 @@
+/*
+ * ram_report: RAM estática del firmware por subsistema, a partir del mapa
+ * del enlazador (build/projectv1.map, GNU ld):
+ *   - totales de DRAM (.dram0.data, .dram0.bss, .noinit), IRAM y RTC
+ *   - DRAM por componente de ESP-IDF (la biblioteca libX.a de cada objeto)
+ *   - DRAM por subsistema del firmware: cada archivo de main/ y, dentro de
+ *     main.c, el prefijo de cada variable (s_stack_control -> "stack",
+ *     g_prof_pcs -> "prof"); ESP-IDF compila con -fdata-sections, así que
+ *     cada variable tiene su sección en el mapa
+ *   - las mayores variables
+ * Lo ejecuta la compilación del firmware tras enlazar (CMakeLists.txt de la
+ * raíz); las pilas y TCB estáticos de las tareas permanentes, las colas y
+ * los mutex estáticos aparecen aquí en vez de en el montículo.
+ *
+ * Compilar: make -C tools ram_report   (binario en tools/build/)
+ * Ejemplos: tools/build/ram_report build/projectv1.map
+ *           tools/build/ram_report --top 30 --all build/projectv1.map
+ *           tools/build/ram_report --check
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tool_util.h"
+
+// ---- Regiones ----
+typedef enum { REG_DATA = 0, REG_BSS, REG_NOINIT, REG_IRAM, REG_RTC, REG_COUNT, REG_NONE = -1 } region_t;
+
+// Por sección de salida; las de flash (texto y rodata) no cuentan
+static region_t region_of(const char *out)
+{
+    if (!strcmp(out, ".dram0.data")) return REG_DATA;
+    if (!strcmp(out, ".dram0.bss")) return REG_BSS;
+    if (!strcmp(out, ".noinit") || !strcmp(out, ".dram0.noinit")) return REG_NOINIT;
+    if (!strncmp(out, ".iram0.", 7)) return REG_IRAM;
+    if (!strncmp(out, ".rtc.", 5) || !strncmp(out, ".rtc_", 5)) return REG_RTC;
+    return REG_NONE;
+}
+
+static bool region_dram(region_t r)
+{
+    return r == REG_DATA || r == REG_BSS || r == REG_NOINIT;
+}
+
+// ---- Acumuladores por clave ----
+typedef struct {
+    char *key;
+    uint64_t bytes[REG_COUNT];
+} entry_t;
+
+typedef struct {
+    entry_t *e;
+    size_t n, cap;
+} table_t;
+
+static entry_t *table_get(table_t *t, const char *key)
+{
+    for (size_t i = 0; i < t->n; ++i) {
+        if (!strcmp(t->e[i].key, key)) return &t->e[i];
+    }
+    if (t->n == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        entry_t *e = realloc(t->e, cap * sizeof(*e));
+        if (!e) return NULL;
+        t->e = e;
+        t->cap = cap;
+    }
+    entry_t *e = &t->e[t->n++];
+    memset(e, 0, sizeof(*e));
+    e->key = strdup(key);
+    return e->key ? e : NULL;
+}
+
+static void table_add(table_t *t, const char *key, region_t r, uint64_t bytes)
+{
+    entry_t *e = table_get(t, key);
+    if (e) e->bytes[r] += bytes;
+}
+
+static uint64_t entry_dram(const entry_t *e)
+{
+    return e->bytes[REG_DATA] + e->bytes[REG_BSS] + e->bytes[REG_NOINIT];
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    uint64_t x = entry_dram(a), y = entry_dram(b);
+    if (x != y) return x < y ? 1 : -1;
+    return strcmp(((const entry_t *)a)->key, ((const entry_t *)b)->key);
+}
+
+static void table_free(table_t *t)
+{
+    for (size_t i = 0; i < t->n; ++i) free(t->e[i].key);
+    free(t->e);
+    memset(t, 0, sizeof(*t));
+}
+
+typedef struct {
+    uint64_t total[REG_COUNT];
+    table_t comp;             // Por componente (libX.a)
+    table_t subsys;           // Archivos de main/ y prefijos de main.c
+    table_t syms;             // Variable (sección de entrada) y objeto
+    bool seen_map;            // Se encontró "Linker script and memory map"
+} report_t;
+
+// ---- Clasificación de una sección de entrada ----
+
+// "esp-idf/main/libmain.a(prof.c.obj)" -> comp "main", obj "prof.c";
+// "/x/libc.a(lib_a-memcpy.o)" -> "c", "lib_a-memcpy.o"; "foo.o" -> "foo.o", "foo.o"
+static void split_file(const char *file, char *comp, size_t ccap, char *obj, size_t ocap)
+{
+    const char *paren = strchr(file, '(');
+    const char *end = paren ? paren : file + strlen(file);
+    const char *base = end;
+    while (base > file && base[-1] != '/' && base[-1] != '\\') base--;
+    size_t len = (size_t)(end - base);
+    if (paren && len > 5 && !strncmp(base, "lib", 3) && !strncmp(end - 2, ".a", 2)) {
+        base += 3;
+        len -= 5;
+    }
+    snprintf(comp, ccap, "%.*s", (int)len, base);
+    if (paren) {
+        const char *close = strchr(paren, ')');
+        size_t olen = close ? (size_t)(close - paren - 1) : strlen(paren + 1);
+        if (olen > 4 && !strncmp(paren + 1 + olen - 4, ".obj", 4)) olen -= 4;
+        snprintf(obj, ocap, "%.*s", (int)olen, paren + 1);
+    } else {
+        snprintf(obj, ocap, "%.*s", (int)len, base);
+    }
+}
+
+// ".bss.s_stack_control" -> "s_stack_control"; ".data" / "COMMON" -> ""
+static const char *section_symbol(const char *sec)
+{
+    static const char *const PFX[] = { ".dram1.", ".bss.", ".data.", ".sbss.", ".sdata.", ".noinit.", ".rodata." };
+    for (size_t i = 0; i < sizeof(PFX) / sizeof(PFX[0]); ++i) {
+        size_t n = strlen(PFX[i]);
+        if (!strncmp(sec, PFX[i], n)) {
+            // .dram1.N.nombre (DRAM_ATTR): el contador va delante
+            const char *s = sec + n;
+            while (!strcmp(PFX[i], ".dram1.") && *s >= '0' && *s <= '9') s++;
+            return *s == '.' ? s + 1 : s;
+        }
+    }
+    return "";
+}
+
+// Subsistema de una variable de main.c: su primera palabra sin g_ / s_
+// (s_stack_control -> "stack"); los locales estáticos llevan sufijo ".N"
+static void symbol_subsys(const char *sym, char *out, size_t cap)
+{
+    if ((sym[0] == 'g' || sym[0] == 's') && sym[1] == '_') sym += 2;
+    size_t n = strcspn(sym, "_.");
+    if (!n) {
+        snprintf(out, cap, "(otros)");
+        return;
+    }
+    snprintf(out, cap, "%.*s", (int)n, sym);
+}
+
+static void report_input(report_t *r, region_t reg, const char *sec, uint64_t size, const char *file)
+{
+    if (reg == REG_NONE || !size) return;
+    r->total[reg] += size;
+    if (!region_dram(reg)) return;
+    if (!file || !*file) {
+        table_add(&r->comp, "(relleno)", reg, size);
+        return;
+    }
+    char comp[128], obj[128], key[300];
+    split_file(file, comp, sizeof(comp), obj, sizeof(obj));
+    table_add(&r->comp, comp, reg, size);
+    const char *sym = section_symbol(sec);
+    if (!strcmp(comp, "main")) {
+        if (!strcmp(obj, "main.c") && *sym) {
+            char sub[64];
+            symbol_subsys(sym, sub, sizeof(sub));
+            snprintf(key, sizeof(key), "main.c:%s", sub);
+        } else {
+            snprintf(key, sizeof(key), "%s", obj);
+        }
+        table_add(&r->subsys, key, reg, size);
+    }
+    snprintf(key, sizeof(key), "%s (%s:%s)", *sym ? sym : sec, comp, obj);
+    table_add(&r->syms, key, reg, size);
+}
+
+// ---- Lectura del mapa ----
+
+static bool parse_hex(const char *tok, uint64_t *v)
+{
+    if (strncmp(tok, "0x", 2)) return false;
+    char *end;
+    *v = strtoull(tok, &end, 16);
+    return end != tok + 2 && !*end;
+}
+
+// Tras "Linker script and memory map": cabeceras de salida en la columna 0;
+// secciones de entrada con un espacio (" .bss.x 0x... 0x... archivo", o el
+// nombre solo y el resto en la línea siguiente si es largo); patrones
+// " *(...)" y símbolos sueltos se saltan
+static bool report_read(report_t *r, FILE *f)
+{
+    static char line[4096];
+    char out[128] = "", pending[512] = "";
+    region_t reg = REG_NONE;
+    bool in_map = false;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!in_map) {
+            in_map = !strncmp(line, "Linker script and memory map", 28);
+            continue;
+        }
+        if (!line[0]) continue;
+        char *tok[4] = { 0 };
+        int nt = 0;
+        char copy[4096];
+        snprintf(copy, sizeof(copy), "%s", line);
+        for (char *s = strtok(copy, " \t"); s && nt < 4; s = strtok(NULL, " \t")) tok[nt++] = s;
+        if (!nt) continue;
+        if (line[0] != ' ') {
+            // Cabecera de sección de salida (o LOAD, OUTPUT...)
+            if (tok[0][0] == '.') {
+                snprintf(out, sizeof(out), "%s", tok[0]);
+                reg = region_of(out);
+            } else {
+                out[0] = '\0';
+                reg = REG_NONE;
+            }
+            pending[0] = '\0';
+            continue;
+        }
+        uint64_t addr, size;
+        if (line[1] != ' ') {
+            // Sección de entrada
+            pending[0] = '\0';
+            if (tok[0][0] == '*' && strcmp(tok[0], "*fill*")) continue;   // Patrón del guion
+            if (nt == 1) {
+                snprintf(pending, sizeof(pending), "%s", tok[0]);
+                continue;
+            }
+            if (nt >= 3 && parse_hex(tok[1], &addr) && parse_hex(tok[2], &size)) {
+                const char *file = nt >= 4 ? line + (tok[3] - copy) : NULL;
+                report_input(r, reg, tok[0], size, file);
+            }
+            continue;
+        }
+        // Continuación de un nombre largo: "   0x... 0x... archivo"
+        if (pending[0] && nt >= 2 && parse_hex(tok[0], &addr) && parse_hex(tok[1], &size)) {
+            const char *file = nt >= 3 ? line + (tok[2] - copy) : NULL;
+            report_input(r, reg, pending, size, file);
+        }
+        pending[0] = '\0';
+    }
+    r->seen_map = in_map;
+    return in_map;
+}
+
+static void report_free(report_t *r)
+{
+    table_free(&r->comp);
+    table_free(&r->subsys);
+    table_free(&r->syms);
+}
+
+// ---- Informe ----
+
+static void print_table(const char *title, table_t *t, size_t top)
+{
+    qsort(t->e, t->n, sizeof(t->e[0]), entry_cmp);
+    printf("\n%s\n", title);
+    printf("  %-44s %8s %8s %8s %8s\n", "", "total", ".data", ".bss", "noinit");
+    uint64_t rest = 0;
+    size_t rest_n = 0;
+    for (size_t i = 0; i < t->n; ++i) {
+        const entry_t *e = &t->e[i];
+        if (!entry_dram(e)) continue;
+        if (top && i >= top) {
+            rest += entry_dram(e);
+            rest_n++;
+            continue;
+        }
+        printf("  %-44.44s %8llu %8llu %8llu %8llu\n", e->key, (unsigned long long)entry_dram(e),
+               (unsigned long long)e->bytes[REG_DATA], (unsigned long long)e->bytes[REG_BSS],
+               (unsigned long long)e->bytes[REG_NOINIT]);
+    }
+    if (rest_n) printf("  %-44s %8llu  (%zu más)\n", "resto", (unsigned long long)rest, rest_n);
+}
+
+static void print_report(report_t *r, size_t top, bool all)
+{
+    uint64_t dram = r->total[REG_DATA] + r->total[REG_BSS] + r->total[REG_NOINIT];
+    printf("RAM estática: DRAM %llu B (.data %llu, .bss %llu, noinit %llu); IRAM %llu B; RTC %llu B\n",
+           (unsigned long long)dram, (unsigned long long)r->total[REG_DATA], (unsigned long long)r->total[REG_BSS],
+           (unsigned long long)r->total[REG_NOINIT], (unsigned long long)r->total[REG_IRAM],
+           (unsigned long long)r->total[REG_RTC]);
+    print_table("DRAM por componente:", &r->comp, all ? 0 : top);
+    print_table("DRAM del firmware (main/: archivo, o main.c:prefijo de la variable):", &r->subsys, 0);
+    print_table("Mayores variables:", &r->syms, top);
+}
+
+// ---- Comprobaciones ----
+
+static const char SAMPLE_MAP[] =
+    "Archive member included to satisfy reference by file (symbol)\n"
+    "\n"
+    "esp-idf/main/libmain.a(prof.c.obj)  esp-idf/main/libmain.a(main.c.obj) (prof_hist_add)\n"
+    "\n"
+    "Memory Configuration\n"
+    "\n"
+    "Name             Origin             Length             Attributes\n"
+    "dram0_0_seg      0x3ffb0000         0x2c200            RW\n"
+    "\n"
+    "Linker script and memory map\n"
+    "\n"
+    "LOAD esp-idf/main/libmain.a\n"
+    "\n"
+    ".flash.rodata   0x3f400020     0x1000\n"
+    " .rodata.str1.4 0x3f400020      0x800 esp-idf/main/libmain.a(main.c.obj)\n"
+    "\n"
+    ".dram0.data     0x3ffb0000      0x120\n"
+    "                0x3ffb0000                _data_start = ABSOLUTE (.)\n"
+    " *(.data .data.*)\n"
+    " .data.g_power_id\n"
+    "                0x3ffb0000        0x1 esp-idf/main/libmain.a(main.c.obj)\n"
+    " *fill*         0x3ffb0001        0x3 \n"
+    " .data          0x3ffb0004       0x1c esp-idf/freertos/libfreertos.a(tasks.c.obj)\n"
+    " .dram1.3.s_wifi_cfg\n"
+    "                0x3ffb0020      0x100 esp-idf/esp_wifi/libesp_wifi.a(wifi_init.c.obj)\n"
+    "\n"
+    ".noinit         0x3ffb0120        0x8\n"
+    " .noinit.s_reset_reason\n"
+    "                0x3ffb0120        0x8 esp-idf/esp_system/libesp_system.a(reset.c.obj)\n"
+    "\n"
+    ".dram0.bss      0x3ffb0128     0x4a40\n"
+    " .bss.s_stack_control\n"
+    "                0x3ffb0128     0x1000 esp-idf/main/libmain.a(main.c.obj)\n"
+    " .bss.s_stack_lcd\n"
+    "                0x3ffb1128      0xc00 esp-idf/main/libmain.a(main.c.obj)\n"
+    " .bss.s_task_tcb\n"
+    "                0x3ffb1d28      0x2a0 esp-idf/main/libmain.a(main.c.obj)\n"
+    " .bss.g_prof_pcs\n"
+    "                0x3ffb1fc8     0x1000 esp-idf/main/libmain.a(main.c.obj)\n"
+    " .bss.pcs.2     0x3ffb2fc8      0x400 esp-idf/main/libmain.a(main.c.obj)\n"
+    " .bss.s_table   0x3ffb33c8      0x200 esp-idf/main/libmain.a(prof.c.obj)\n"
+    " .bss.empty     0x3ffb35c8        0x0 esp-idf/main/libmain.a(main.c.obj)\n"
+    " COMMON         0x3ffb35c8      0x100 /opt/xtensa/lib/libc.a(lib_a-impure.o)\n"
+    " .bss.pxCurrentTCBs\n"
+    "                0x3ffb36c8        0x8 esp-idf/freertos/libfreertos.a(tasks.c.obj)\n"
+    "\n"
+    ".iram0.text     0x40080000     0x2000\n"
+    " .iram1.0       0x40080000     0x2000 esp-idf/freertos/libfreertos.a(port.c.obj)\n"
+    "\n"
+    ".rtc.data       0x50000000       0x10\n"
+    " .rtc.data      0x50000000       0x10 esp-idf/esp_system/libesp_system.a(sleep.c.obj)\n"
+    "\n"
+    ".flash.text     0x400d0020     0x9000\n"
+    " .text.app_main 0x400d0020      0x200 esp-idf/main/libmain.a(main.c.obj)\n";
+
+static uint64_t key_dram(table_t *t, const char *key)
+{
+    for (size_t i = 0; i < t->n; ++i) {
+        if (!strcmp(t->e[i].key, key)) return entry_dram(&t->e[i]);
+    }
+    return 0;
+}
+
+static void run_checks(void)
+{
+    printf("nombres:\n");
+    char comp[64], obj[64], sub[32];
+    split_file("esp-idf/main/libmain.a(main.c.obj)", comp, sizeof(comp), obj, sizeof(obj));
+    check(!strcmp(comp, "main") && !strcmp(obj, "main.c"), "componente y objeto de ESP-IDF");
+    split_file("/opt/xtensa/lib/libc.a(lib_a-impure.o)", comp, sizeof(comp), obj, sizeof(obj));
+    check(!strcmp(comp, "c") && !strcmp(obj, "lib_a-impure.o"), "biblioteca de la toolchain");
+    split_file("build/foo.o", comp, sizeof(comp), obj, sizeof(obj));
+    check(!strcmp(comp, "foo.o") && !strcmp(obj, "foo.o"), "objeto suelto");
+    check(!strcmp(section_symbol(".bss.s_stack_control"), "s_stack_control"), "variable de .bss");
+    check(!strcmp(section_symbol(".dram1.3.s_wifi_cfg"), "s_wifi_cfg"), "variable DRAM_ATTR");
+    check(!strcmp(section_symbol("COMMON"), "") && !strcmp(section_symbol(".data"), ""), "sección sin variable");
+    symbol_subsys("s_stack_control", sub, sizeof(sub));
+    check(!strcmp(sub, "stack"), "prefijo s_");
+    symbol_subsys("g_prof_pcs", sub, sizeof(sub));
+    check(!strcmp(sub, "prof"), "prefijo g_");
+    symbol_subsys("pcs.2", sub, sizeof(sub));
+    check(!strcmp(sub, "pcs"), "local estático");
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+
+    printf("mapa:\n");
+    report_t r = { 0 };
+    FILE *f = tmpfile();
+    if (f) {
+        fputs(SAMPLE_MAP, f);
+        rewind(f);
+        check(report_read(&r, f), "cabecera del mapa");
+        fclose(f);
+    }
+    check(r.total[REG_DATA] == 0x120, ".data (con relleno)");
+    check(r.total[REG_NOINIT] == 0x8, "noinit");
+    check(r.total[REG_BSS] == 0x1000 + 0xc00 + 0x2a0 + 0x1000 + 0x400 + 0x200 + 0x100 + 0x8, ".bss (sin tamaño 0)");
+    check(r.total[REG_IRAM] == 0x2000 && r.total[REG_RTC] == 0x10, "IRAM y RTC");
+    check(key_dram(&r.comp, "main") == 0x1 + 0x1000 + 0xc00 + 0x2a0 + 0x1000 + 0x400 + 0x200, "componente main");
+    check(key_dram(&r.comp, "freertos") == 0x1c + 0x8 && key_dram(&r.comp, "c") == 0x100, "otros componentes");
+    check(key_dram(&r.comp, "(relleno)") == 0x3, "relleno aparte");
+    check(key_dram(&r.subsys, "main.c:stack") == 0x1c00 && key_dram(&r.subsys, "main.c:task") == 0x2a0,
+          "pilas y TCB de main.c");
+    check(key_dram(&r.subsys, "main.c:prof") == 0x1000 && key_dram(&r.subsys, "main.c:pcs") == 0x400,
+          "prefijos de main.c");
+    check(key_dram(&r.subsys, "prof.c") == 0x200 && key_dram(&r.subsys, "main.c:power") == 0x1, "otros archivos de main");
+    check(key_dram(&r.syms, "s_stack_control (main:main.c)") == 0x1000, "variable con su objeto");
+    check(key_dram(&r.syms, "app_main (main:main.c)") == 0, "sin texto de flash");
+    report_free(&r);
+
+    report_t none = { 0 };
+    f = tmpfile();
+    if (f) {
+        fputs("no es un mapa\n", f);
+        rewind(f);
+        check(!report_read(&none, f), "archivo que no es un mapa");
+        fclose(f);
+    }
+    report_free(&none);
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones] MAPA   (build/projectv1.map)\n"
+            "  --top N            componentes y variables a mostrar (15)\n"
+            "  --all              todos los componentes\n"
+            "  --check            pruebas del lector con un mapa de ejemplo\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *map = NULL;
+    long top = 15;
+    bool all = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--check")) {
+            run_checks();
+            return g_fail;
+        }
+        if (!strcmp(a, "--all")) {
+            all = true;
+            continue;
+        }
+        if (a[0] != '-') {
+            map = a;
+            continue;
+        }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--top")) top = atol(v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (!map || top < 1) { usage(argv[0]); return 2; }
+
+    FILE *f = fopen(map, "r");
+    if (!f) { perror(map); return 1; }
+    static report_t r;
+    bool ok = report_read(&r, f);
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "ram_report: %s no es un mapa de GNU ld\n", map);
+        return 1;
+    }
+    print_report(&r, (size_t)top, all);
+    report_free(&r);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * sched_sim: verifica en host el conjunto de plazos (main/deadline.c) y
+ * compara despertares por hora entre el sondeo original y sched.c.
+ *
+ * 1) Comprobación (--check N): N operaciones aleatorias de armar/rearmar/
+ *    cancelar/extraer contra un modelo de referencia; los vencidos deben
+ *    salir ordenados por (plazo, orden de armado) y coincidir con el modelo.
+ *    Devuelve 1 ante la primera discrepancia.
+ *
+ * 2) Simulación (--hours H, --period S): ciclos de acceso con la misma
+ *    lógica de plazos que door_monitor_task y lcd_task (re-bloqueo 1 s tras
+ *    cerrar, desbloqueo máximo 10 s, LOCKING 1 s, inactividad LCD 5 s).
+ *      - Sondeo: door_monitor cada 50 ms + lcd_task cada 100 ms, error de
+ *        disparo hasta un periodo.
+ *      - sched: un despertar de la tarea dueña por plazo vencido o evento.
+ *
+ * Compilar: make -C tools sched_sim   (binario en tools/build/)
+ * Ejemplo:  tools/build/sched_sim --check 1000000 --hours 24 --period 300
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deadline.h"
+#include "tool_util.h"
+
+// Mismos valores que main/main.c
+#define UNLOCK_MAX_OPEN_TIME_MS   10000
+#define RELOCK_DELAY_MS           1000
+#define LCD_IDLE_TIMEOUT_MS       5000
+#define LCD_LOCKING_MS            1000
+#define DOOR_POLL_MS              50
+#define LCD_POLL_MS               100
+
+enum { DL_RELOCK = 0, DL_UNLOCK_MAX, DL_LCD_LOCKING, DL_LCD_IDLE, DL_COUNT };
+static const char *k_dl_name[DL_COUNT] = { "relock", "unlock_max", "lcd_locking", "lcd_idle" };
+
+// ---------------------------------------------------------------------------
+// 1) Comprobación contra modelo de referencia
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    bool armed;
+    int64_t at;
+    uint64_t seq;
+} ref_t;
+
+static int ref_first(const ref_t *r, int64_t now)
+{
+    int best = -1;
+    for (int i = 0; i < DEADLINE_MAX; ++i) {
+        if (!r[i].armed || r[i].at > now) continue;
+        if (best < 0 || r[i].at < r[best].at || (r[i].at == r[best].at && r[i].seq < r[best].seq)) best = i;
+    }
+    return best;
+}
+
+static int run_check(long ops)
+{
+    deadline_set_t s;
+    deadline_set_init(&s);
+    ref_t ref[DEADLINE_MAX] = {0};
+    uint64_t seq = 0;
+    int64_t now = 0;
+    // Plazos en una rejilla gruesa para forzar empates frecuentes
+    for (long n = 0; n < ops; ++n) {
+        double p = rnd_u();
+        int id = (int)(rnd_u() * DEADLINE_MAX);
+        if (p < 0.45) {
+            int64_t at = now + 1000 * (int64_t)(rnd_u() * 8);
+            deadline_arm(&s, id, at);
+            ref[id] = (ref_t){ true, at, ++seq };
+        } else if (p < 0.6) {
+            deadline_cancel(&s, id);
+            ref[id].armed = false;
+        } else {
+            now += 1000 * (int64_t)(rnd_u() * 3);
+            int64_t prev_at = INT64_MIN;
+            for (;;) {
+                int got = deadline_pop_expired(&s, now);
+                int want = ref_first(ref, now);
+                if (got != want) {
+                    fprintf(stderr, "check: op %ld t=%lld: pop=%d esperado=%d\n", n, (long long)now, got, want);
+                    return 1;
+                }
+                if (got < 0) break;
+                if (ref[got].at < prev_at) {
+                    fprintf(stderr, "check: op %ld: orden no monótono\n", n);
+                    return 1;
+                }
+                prev_at = ref[got].at;
+                ref[got].armed = false;
+            }
+        }
+        for (int i = 0; i < DEADLINE_MAX; ++i) {
+            if (deadline_is_armed(&s, i) != ref[i].armed) {
+                fprintf(stderr, "check: op %ld: id %d armado=%d esperado=%d\n", n, i,
+                        deadline_is_armed(&s, i), ref[i].armed);
+                return 1;
+            }
+        }
+    }
+    printf("check OK: %ld operaciones\n", ops);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 2) Simulación de despertares
+// ---------------------------------------------------------------------------
+
+typedef enum { EV_UNLOCK, EV_DOOR_OPEN, EV_DOOR_CLOSE } ext_kind_t;
+
+typedef struct {
+    int64_t t;
+    ext_kind_t kind;
+} ext_t;
+
+typedef struct {
+    deadline_set_t dl;
+    bool unlocked;
+    bool pending_relock;
+    bool door_closed;
+    uint64_t task_wakeups;
+    uint64_t fired[DL_COUNT];
+} model_t;
+
+static void model_lock(model_t *m, int64_t now)
+{
+    if (!m->door_closed) return;
+    m->unlocked = false;
+    m->pending_relock = false;
+    deadline_arm(&m->dl, DL_LCD_IDLE, now + LCD_IDLE_TIMEOUT_MS * 1000LL);
+    deadline_cancel(&m->dl, DL_RELOCK);
+    deadline_cancel(&m->dl, DL_UNLOCK_MAX);
+    deadline_arm(&m->dl, DL_LCD_LOCKING, now + LCD_LOCKING_MS * 1000LL);
+    m->task_wakeups++; // lcd_task redibuja "LOCKING..."
+}
+
+static void model_external(model_t *m, const ext_t *e)
+{
+    m->task_wakeups++; // control_task / door_monitor_task atienden el evento
+    switch (e->kind) {
+    case EV_UNLOCK:
+        m->unlocked = true;
+        m->pending_relock = true;
+        deadline_arm(&m->dl, DL_UNLOCK_MAX, e->t + UNLOCK_MAX_OPEN_TIME_MS * 1000LL);
+        deadline_arm(&m->dl, DL_LCD_IDLE, e->t + LCD_IDLE_TIMEOUT_MS * 1000LL);
+        m->task_wakeups++; // lcd_task: "ACCESS GRANTED!"
+        break;
+    case EV_DOOR_OPEN:
+        m->door_closed = false;
+        deadline_cancel(&m->dl, DL_RELOCK);
+        break;
+    case EV_DOOR_CLOSE:
+        m->door_closed = true;
+        if (m->pending_relock) deadline_arm(&m->dl, DL_RELOCK, e->t + RELOCK_DELAY_MS * 1000LL);
+        break;
+    }
+}
+
+static void model_deadline(model_t *m, int id, int64_t now)
+{
+    m->fired[id]++;
+    m->task_wakeups++;
+    switch (id) {
+    case DL_RELOCK:
+        if (m->pending_relock) model_lock(m, now);
+        break;
+    case DL_UNLOCK_MAX:
+        if (!m->unlocked) break;
+        if (m->door_closed) model_lock(m, now);
+        else deadline_arm(&m->dl, DL_UNLOCK_MAX, now + UNLOCK_MAX_OPEN_TIME_MS * 1000LL);
+        break;
+    default:
+        break; // LCD: lcd_show_idle (ya contado el despertar)
+    }
+}
+
+static int cmp_ext(const void *a, const void *b)
+{
+    int64_t x = ((const ext_t *)a)->t, y = ((const ext_t *)b)->t;
+    return (x > y) - (x < y);
+}
+
+static void run_sim(double hours, double period_s)
+{
+    int64_t end = (int64_t)(hours * 3.6e9);
+    int cap = (int)(hours * 3600.0 / period_s * 2.0) * 3 + 16;
+    ext_t *ext = malloc(sizeof(ext_t) * (size_t)cap);
+    int n = 0;
+    // Ciclos de acceso: unlock; 90 % abre en 1-4 s y cierra 2-15 s después
+    for (int64_t t = rnd_us(0, (int64_t)(period_s * 2e6)); t < end && n + 3 <= cap;
+         t += rnd_us((int64_t)(period_s * 0.2e6), (int64_t)(period_s * 1.8e6))) {
+        ext[n++] = (ext_t){ t, EV_UNLOCK };
+        if (rnd_u() < 0.9) {
+            int64_t to = t + rnd_us(1000000, 4000000);
+            ext[n++] = (ext_t){ to, EV_DOOR_OPEN };
+            ext[n++] = (ext_t){ to + rnd_us(2000000, 15000000), EV_DOOR_CLOSE };
+        }
+    }
+    qsort(ext, (size_t)n, sizeof(ext_t), cmp_ext);
+
+    model_t m = { .door_closed = true };
+    deadline_set_init(&m.dl);
+    int i = 0;
+    for (;;) {
+        int64_t t_dl;
+        bool has_dl = deadline_next(&m.dl, &t_dl);
+        int64_t t_ext = (i < n) ? ext[i].t : INT64_MAX;
+        if (!has_dl && i >= n) break;
+        if (has_dl && t_dl <= t_ext) {
+            if (t_dl > end) break;
+            int id;
+            while ((id = deadline_pop_expired(&m.dl, t_dl)) >= 0) model_deadline(&m, id, t_dl);
+        } else {
+            if (t_ext > end) break;
+            model_external(&m, &ext[i++]);
+        }
+    }
+
+    double polls_h = 3600.0 * (1000.0 / DOOR_POLL_MS + 1000.0 / LCD_POLL_MS);
+    uint64_t fired = 0;
+    for (int k = 0; k < DL_COUNT; ++k) fired += m.fired[k];
+    printf("simulación: %.1f h, %d eventos externos, %llu plazos vencidos\n",
+           hours, n, (unsigned long long)fired);
+    for (int k = 0; k < DL_COUNT; ++k) {
+        printf("  %-12s %8.1f/h\n", k_dl_name[k], (double)m.fired[k] / hours);
+    }
+    printf("[poll]  despertares/h=%.0f  error de disparo medio=%.0f ms (máx %d ms)\n",
+           polls_h, (DOOR_POLL_MS / 2.0 + LCD_POLL_MS / 2.0) / 2.0, LCD_POLL_MS);
+    printf("[sched] despertares/h=%.0f  error de disparo = resolución de esp_timer\n",
+           (double)m.task_wakeups / hours);
+    free(ext);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "uso: sched_sim [opciones]\n"
+        "  --check N    operaciones aleatorias contra el modelo (200000; 0 = omitir)\n"
+        "  --hours H    horas simuladas (1)\n"
+        "  --period S   segundos medios entre accesos (120)\n"
+        "  --seed N     semilla\n");
+}
+
+int main(int argc, char **argv)
+{
+    long check = 200000;
+    double hours = 1.0, period_s = 120.0;
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!v) { usage(); return 2; }
+        if (!strcmp(a, "--check")) check = atol(v);
+        else if (!strcmp(a, "--hours")) hours = strtod(v, NULL);
+        else if (!strcmp(a, "--period")) period_s = strtod(v, NULL);
+        else if (!strcmp(a, "--seed")) rng_mix_seed(v);
+        else { usage(); return 2; }
+        ++i;
+    }
+    if (hours <= 0.0 || period_s <= 0.0) { usage(); return 2; }
+
+    if (check > 0 && run_check(check) != 0) return 1;
+    run_sim(hours, period_s);
+    return 0;
+}
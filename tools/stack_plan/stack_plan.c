@@ -0,0 +1,281 @@
+/*
+ * stack_plan: dimensiona las pilas de las tareas permanentes del firmware a
+ * partir de los informes de pila (STACK_TOPIC, main.c stack_report()):
+ *   - pico de cada tarea: el mayor de todos los informes (varias pasadas del
+ *     escenario STACK_STRESS, o {"stack":true} tras días de uso real)
+ *   - tamaño propuesto con task_plan_stack() (main/task_plan.h): pico +
+ *     margen, múltiplo de 256 bytes
+ *   - RAM que se recupera (o falta) respecto a los tamaños vigentes
+ * Con --write regenera main/stack_sizes.h; las tareas sin medida conservan
+ * su tamaño.
+ *
+ * La entrada es texto con un informe JSON por línea: la salida de
+ * mosquitto_sub (se toma desde el primer '{' de las líneas con "peak"); el
+ * resto de líneas se ignora.
+ *
+ * Compilar: make -C tools stack_plan   (binario en tools/build/)
+ * Ejemplos: mosquitto_sub -t iot/stack -C 3 > stack.txt
+ *           tools/build/stack_plan stack.txt
+ *           tools/build/stack_plan --write main/stack_sizes.h stack.txt
+ *           tools/build/stack_plan --margin 40 --min 768 stack.txt
+ *           tools/build/stack_plan --check
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "task_plan.h"
+#include "tool_util.h"
+
+#define MAX_TASKS 16
+
+// ---- Informes ----
+typedef struct {
+    char name[16];
+    uint32_t size;            // Tamaño vigente (el del último informe)
+    uint32_t peak;            // Mayor pico visto; 0: sin medida
+    uint32_t reports;         // Informes con pico
+} task_acc_t;
+
+typedef struct {
+    task_acc_t task[MAX_TASKS];
+    int ntask;
+    int reports;
+    uint32_t heap_min;        // Menor mínimo libre del montículo visto (0: ninguno)
+} acc_t;
+
+static task_acc_t *acc_task(acc_t *a, const char *name)
+{
+    for (int i = 0; i < a->ntask; ++i) {
+        if (!strcmp(a->task[i].name, name)) return &a->task[i];
+    }
+    if (a->ntask == MAX_TASKS) return NULL;
+    task_acc_t *t = &a->task[a->ntask++];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    return t;
+}
+
+// {"tasks":{"control":{"size":4096,"peak":2310,"plan":3072},..},"heap":{"min_free":..}}
+static bool acc_report(acc_t *a, const char *text)
+{
+    cJSON *root = cJSON_Parse(text);
+    cJSON *tasks = root ? cJSON_GetObjectItem(root, "tasks") : NULL;
+    if (!cJSON_IsObject(tasks)) {
+        cJSON_Delete(root);
+        return false;
+    }
+    const cJSON *t;
+    cJSON_ArrayForEach(t, tasks) {
+        cJSON *size = cJSON_GetObjectItem(t, "size"), *peak = cJSON_GetObjectItem(t, "peak");
+        if (!t->string || !cJSON_IsNumber(size) || !cJSON_IsNumber(peak)) continue;
+        task_acc_t *ta = acc_task(a, t->string);
+        if (!ta) continue;
+        ta->size = (uint32_t)size->valuedouble;
+        if (peak->valuedouble > 0) {
+            ta->reports++;
+            if ((uint32_t)peak->valuedouble > ta->peak) ta->peak = (uint32_t)peak->valuedouble;
+        }
+    }
+    cJSON *heap = cJSON_GetObjectItem(root, "heap");
+    cJSON *min_free = heap ? cJSON_GetObjectItem(heap, "min_free") : NULL;
+    if (cJSON_IsNumber(min_free) && min_free->valuedouble > 0) {
+        uint32_t m = (uint32_t)min_free->valuedouble;
+        if (!a->heap_min || m < a->heap_min) a->heap_min = m;
+    }
+    a->reports++;
+    cJSON_Delete(root);
+    return true;
+}
+
+static int acc_read(acc_t *a, FILE *f)
+{
+    static char line[8192];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *brace = strchr(line, '{');
+        if (brace && strstr(brace, "\"peak\"") && acc_report(a, brace)) n++;
+    }
+    return n;
+}
+
+// Tamaño propuesto; el vigente si la tarea no tiene medida
+static uint32_t plan_size(const task_acc_t *t, uint32_t margin_pct, uint32_t min_margin)
+{
+    uint32_t plan = task_plan_stack(t->peak, margin_pct, min_margin);
+    return plan ? plan : t->size;
+}
+
+static void print_report(const acc_t *a, uint32_t margin_pct, uint32_t min_margin)
+{
+    printf("%d informes; margen %u %% (al menos %u B), múltiplo de %d B\n\n", a->reports, (unsigned)margin_pct,
+           (unsigned)min_margin, TASK_STACK_ALIGN);
+    printf("%-10s %9s %8s %6s %8s %8s\n", "tarea", "tamaño", "pico", "uso", "plan", "dif.");
+    long size_b = 0, plan_b = 0;
+    for (int i = 0; i < a->ntask; ++i) {
+        const task_acc_t *t = &a->task[i];
+        uint32_t plan = plan_size(t, margin_pct, min_margin);
+        size_b += t->size;
+        plan_b += plan;
+        if (!t->peak) {
+            printf("%-10s %8u %8s %6s %8u %8s  (sin medida)\n", t->name, (unsigned)t->size, "-", "-", (unsigned)plan, "0");
+            continue;
+        }
+        printf("%-10s %8u %8u %5.0f%% %8u %+8ld%s\n", t->name, (unsigned)t->size, (unsigned)t->peak,
+               t->size ? 100.0 * t->peak / t->size : 0.0, (unsigned)plan, (long)plan - (long)t->size,
+               plan > t->size ? "  ¡pila justa!" : "");
+    }
+    printf("\nTotal: %ld B vigentes, %ld B con el plan: %ld B %s\n", size_b, plan_b,
+           labs(size_b - plan_b), size_b >= plan_b ? "recuperados" : "más");
+    if (a->heap_min) printf("Montículo: mínimo libre visto %u B\n", (unsigned)a->heap_min);
+}
+
+// main/stack_sizes.h con los tamaños del plan
+static void write_header(FILE *f, const acc_t *a, uint32_t margin_pct, uint32_t min_margin)
+{
+    fprintf(f,
+            "#pragma once\n\n"
+            "// Pilas de las tareas permanentes, en bytes (en ESP-IDF StackType_t es un\n"
+            "// byte). Las dimensionan los arrays estáticos de main.c y el plan de tareas.\n"
+            "//\n"
+            "// Lo regenera tools/stack_plan a partir de los informes de STACK_TOPIC\n"
+            "// (STACK_STRESS 1 en main.c): pico medido + TASK_STACK_MARGIN_PCT %%, al menos\n"
+            "// TASK_STACK_MARGIN_MIN bytes, múltiplo de TASK_STACK_ALIGN (task_plan.h).\n"
+            "// No editar a mano: regenerar y anotar aquí el informe de origen.\n"
+            "//\n"
+            "// Origen: %d informes; margen %u %%, al menos %u B.\n"
+            "//          pico (B)  tamaño (B)\n",
+            a->reports, (unsigned)margin_pct, (unsigned)min_margin);
+    for (int i = 0; i < a->ntask; ++i) {
+        const task_acc_t *t = &a->task[i];
+        char peak[16] = "-";
+        if (t->peak) snprintf(peak, sizeof(peak), "%u", (unsigned)t->peak);
+        fprintf(f, "// %-8s %8s %11u\n", t->name, peak, (unsigned)plan_size(t, margin_pct, min_margin));
+    }
+    fprintf(f, "\n");
+    for (int i = 0; i < a->ntask; ++i) {
+        const task_acc_t *t = &a->task[i];
+        char macro[32];
+        int n = snprintf(macro, sizeof(macro), "STACK_");
+        for (const char *c = t->name; *c && n < (int)sizeof(macro) - 1; ++c) macro[n++] = (char)toupper((unsigned char)*c);
+        macro[n] = '\0';
+        fprintf(f, "#define %-13s %u\n", macro, (unsigned)plan_size(t, margin_pct, min_margin));
+    }
+}
+
+// ---- Comprobaciones ----
+
+static void run_checks(void)
+{
+    printf("task_plan_stack:\n");
+    check(task_plan_stack(0, 25, 512) == 0, "sin medida");
+    check(task_plan_stack(100, 25, 512) == 768, "margen mínimo");
+    check(task_plan_stack(2304, 25, 512) == 3072, "margen porcentual redondeado");
+    check(task_plan_stack(2048, 25, 512) == 2560, "múltiplo exacto");
+    check(task_plan_stack(2049, 25, 512) % TASK_STACK_ALIGN == 0, "alineado");
+    check(task_plan_stack(4000, 0, 0) == 4096, "sin margen");
+    check(task_plan_stack(UINT32_MAX, 25, 512) % TASK_STACK_ALIGN == 0, "sin desbordar");
+    for (uint32_t p = 1; p < 20000; p += 37) {
+        uint32_t s = task_plan_stack(p, TASK_STACK_MARGIN_PCT, TASK_STACK_MARGIN_MIN);
+        if (s < p + TASK_STACK_MARGIN_MIN || s < p + p / 4 || s - (p + (p / 4 > 512 ? p / 4 : 512)) >= 256) {
+            check(false, "pico + margen, menos de 256 B de más");
+            break;
+        }
+    }
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+
+    printf("informes:\n");
+    static acc_t a;
+    check(acc_report(&a, "{\"device_id\":\"x\",\"why\":\"stress\",\"tasks\":{\"control\":{\"size\":4096,\"peak\":2310,"
+                         "\"plan\":3072},\"pot\":{\"size\":4096,\"peak\":1500,\"plan\":2048},\"lcd\":{\"size\":3072,"
+                         "\"peak\":0,\"plan\":0}},\"heap\":{\"free\":90000,\"min_free\":70000,\"largest\":60000}}"),
+          "informe válido");
+    check(acc_report(&a, "{\"tasks\":{\"control\":{\"size\":4096,\"peak\":2600},\"pot\":{\"size\":4096,\"peak\":1400}},"
+                         "\"heap\":{\"min_free\":65000}}"),
+          "segundo informe");
+    check(!acc_report(&a, "{\"window_ms\":1}") && !acc_report(&a, "no es json"), "líneas que no son informes");
+    check(a.reports == 2 && a.ntask == 3, "tareas acumuladas");
+    check(a.task[0].peak == 2600 && a.task[1].peak == 1500 && a.task[2].peak == 0, "mayor pico");
+    check(a.heap_min == 65000, "menor mínimo del montículo");
+    check(plan_size(&a.task[0], 25, 512) == 3328 && plan_size(&a.task[2], 25, 512) == 3072, "plan y sin medida");
+
+    FILE *f = tmpfile();
+    char hdr[2048] = "";
+    if (f) {
+        write_header(f, &a, 25, 512);
+        rewind(f);
+        size_t n = fread(hdr, 1, sizeof(hdr) - 1, f);
+        hdr[n] = '\0';
+        fclose(f);
+    }
+    check(strstr(hdr, "#pragma once") && strstr(hdr, "#define STACK_CONTROL 3328\n") &&
+              strstr(hdr, "#define STACK_POT     2048\n") && strstr(hdr, "#define STACK_LCD     3072\n"),
+          "cabecera generada");
+    check(strstr(hdr, "// control      2600        3328\n") && strstr(hdr, "// lcd             -        3072\n"),
+          "tabla de origen");
+    printf("  %s\n", g_fail ? "con fallos" : "ok");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "uso: %s [opciones] [informes.txt ...]   (sin archivos: entrada estándar)\n"
+            "  --margin PCT       margen sobre el pico (%d)\n"
+            "  --min BYTES        margen mínimo (%d)\n"
+            "  --write ARCHIVO    regenera la cabecera de tamaños (main/stack_sizes.h)\n"
+            "  --check            pruebas de task_plan_stack y del lector\n",
+            argv0, TASK_STACK_MARGIN_PCT, TASK_STACK_MARGIN_MIN);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = NULL;
+    long margin_pct = TASK_STACK_MARGIN_PCT, min_margin = TASK_STACK_MARGIN_MIN;
+    int nfiles = 0;
+    const char *files[64];
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--check")) {
+            run_checks();
+            return g_fail;
+        }
+        if (a[0] != '-' || !a[1]) {
+            if (nfiles < 64) files[nfiles++] = a;
+            continue;
+        }
+        if (!v) { usage(argv[0]); return 2; }
+        if (!strcmp(a, "--margin")) margin_pct = atol(v);
+        else if (!strcmp(a, "--min")) min_margin = atol(v);
+        else if (!strcmp(a, "--write")) out = v;
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (margin_pct < 0 || margin_pct > 400 || min_margin < 0 || min_margin > 65536) { usage(argv[0]); return 2; }
+
+    static acc_t acc;
+    int reports = 0;
+    if (!nfiles) reports = acc_read(&acc, stdin);
+    for (int i = 0; i < nfiles; ++i) {
+        FILE *f = fopen(files[i], "r");
+        if (!f) { perror(files[i]); return 1; }
+        reports += acc_read(&acc, f);
+        fclose(f);
+    }
+    if (!reports) {
+        fprintf(stderr, "stack_plan: ningún informe (líneas JSON con \"peak\")\n");
+        return 1;
+    }
+    print_report(&acc, (uint32_t)margin_pct, (uint32_t)min_margin);
+    if (out) {
+        FILE *f = fopen(out, "w");
+        if (!f) { perror(out); return 1; }
+        write_header(f, &acc, (uint32_t)margin_pct, (uint32_t)min_margin);
+        fclose(f);
+        printf("Escrito %s: recompilar el firmware\n", out);
+    }
+    return 0;
+}
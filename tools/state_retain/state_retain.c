@@ -0,0 +1,312 @@
+/*
+ * state_retain: pruebas en host del documento de estado retenido
+ * (main/state_doc.c sobre main/twin_state.c) contra un broker de prueba en
+ * memoria con la semántica MQTT que importa aquí: un mensaje retenido por
+ * topic, que el broker entrega al suscribirse y sustituye con cada
+ * publicación retenida; un reinicio del broker sin persistencia lo pierde.
+ *
+ * 1) Escenarios: primer documento inmediato, ráfaga agrupada con el estado
+ *    final publicado, rev consecutivo, campos no autoritativos (dígito) que
+ *    no publican, reinicio del broker y republicación al reconectar.
+ * 2) Traza de una hora (--accesses N por hora) con suscriptores que llegan
+ *    en instantes aleatorios (--subs N): cada uno recibe el estado al
+ *    suscribirse y se compara con el del dispositivo; sin retención
+ *    (iot/telemetry) habría esperado al siguiente evento.
+ *
+ * Compilar: make -C tools state_retain   (binario en tools/build/)
+ * Ejemplo:  tools/build/state_retain --accesses 60 --subs 500
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "access_fsm.h"
+#include "cJSON.h"
+#include "state_doc.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define STEP_MS      10
+#define LATENCY_MS   20
+#define STATE_MIN_MS 1000    // Igual que main.c
+#define DEVICE       "access_control_01"
+
+// ---- Broker de prueba: un topic, un retenido ----
+typedef struct {
+    bool has_retained;
+    char retained[STATE_DOC_MAX];
+    int64_t in_flight_at;    // Publicación en camino (INT64_MAX: ninguna)
+    char in_flight[STATE_DOC_MAX];
+    uint32_t publishes;
+    uint32_t bytes;
+} broker_t;
+
+// Lo que un suscriptor sabe tras suscribirse
+typedef struct {
+    bool got;
+    int32_t val[TWIN_F_COUNT];
+    uint32_t rev;
+    int version;
+} doc_view_t;
+
+static bool doc_parse(const char *doc, doc_view_t *out)
+{
+    cJSON *root = cJSON_Parse(doc);
+    if (!root) return false;
+    cJSON *state = cJSON_GetObjectItem(root, "state");
+    out->got = true;
+    out->version = (int)cJSON_GetObjectItem(root, "v")->valuedouble;
+    out->rev = (uint32_t)cJSON_GetObjectItem(root, "rev")->valuedouble;
+    out->val[TWIN_F_STATE] = -1;
+    for (int s = 0; s < ACCESS_STATE_COUNT; ++s) {
+        if (cJSON_IsString(state) && !strcmp(state->valuestring, access_state_name((access_state_t)s))) {
+            out->val[TWIN_F_STATE] = s;
+        }
+    }
+    out->val[TWIN_F_LOCKED] = cJSON_IsTrue(cJSON_GetObjectItem(root, "locked"));
+    out->val[TWIN_F_DOOR] = !strcmp(cJSON_GetObjectItem(root, "door")->valuestring, "closed");
+    out->val[TWIN_F_RELOCK] = cJSON_IsTrue(cJSON_GetObjectItem(root, "relock_pending"));
+    out->val[TWIN_F_POLICY] = (int32_t)cJSON_GetObjectItem(root, "policy")->valuedouble;
+    cJSON_Delete(root);
+    return true;
+}
+
+static doc_view_t broker_subscribe(const broker_t *b)
+{
+    doc_view_t v = { 0 };
+    if (b->has_retained) check(doc_parse(b->retained, &v), "retenido no es JSON");
+    return v;
+}
+
+// ---- Dispositivo: igual que main.c (twin_update + state_deadline_cb) ----
+typedef struct {
+    twin_state_t doc;
+    int64_t due;
+    int64_t last_pub;
+    int64_t min_gap;         // Menor separación entre documentos
+    uint32_t last_rev;
+    bool connected;
+    broker_t broker;
+} device_t;
+
+static void dev_init(device_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    twin_init(&d->doc, STATE_MIN_MS, 0);
+    d->due = INT64_MAX;
+    d->last_pub = INT64_MIN / 2;
+    d->min_gap = INT64_MAX;
+    d->connected = true;
+    d->broker.in_flight_at = INT64_MAX;
+}
+
+static void dev_set(device_t *d, int64_t now, twin_field_t f, int32_t v)
+{
+    int64_t due;
+    if (!(STATE_DOC_FIELDS & (1u << f))) return;
+    if (twin_set(&d->doc, f, v, now, &due)) d->due = due;
+}
+
+static void dev_state(device_t *d, int64_t now, access_state_t st)
+{
+    dev_set(d, now, TWIN_F_STATE, st);
+    dev_set(d, now, TWIN_F_LOCKED, access_state_is_locked(st));
+    dev_set(d, now, TWIN_F_DOOR, access_state_door_closed(st));
+    dev_set(d, now, TWIN_F_RELOCK, st == ACCESS_RELOCK_PENDING);
+}
+
+static void dev_connect(device_t *d, int64_t now)
+{
+    int64_t due;
+    d->connected = true;
+    if (twin_request_snapshot(&d->doc, now, &due)) d->due = due;
+}
+
+static void dev_advance(device_t *d, int64_t now)
+{
+    broker_t *b = &d->broker;
+    if (b->in_flight_at <= now) {
+        b->in_flight_at = INT64_MAX;
+        memcpy(b->retained, b->in_flight, sizeof(b->retained));
+        b->has_retained = true;
+    }
+    if (d->due > now) return;
+    twin_msg_t m;
+    if (!twin_take(&d->doc, now, &m, &d->due)) return;
+    char buf[STATE_DOC_MAX];
+    size_t n = state_doc_format(&m, DEVICE, now / 1000000, buf, sizeof(buf));
+    check(n > 0, "documento no cabe en STATE_DOC_MAX");
+    check(m.seq == d->last_rev + 1, "rev consecutivo");
+    d->last_rev = m.seq;
+    if (now - d->last_pub < d->min_gap) d->min_gap = now - d->last_pub;
+    d->last_pub = now;
+    if (!d->connected) return;   // Se pierde; al reconectar se republica
+    b->publishes++;
+    b->bytes += (uint32_t)n;
+    b->in_flight_at = now + MS(LATENCY_MS);
+    memcpy(b->in_flight, buf, n + 1);
+}
+
+static bool view_matches(const doc_view_t *v, const device_t *d)
+{
+    if (!v->got) return false;
+    for (int f = 0; f < TWIN_F_COUNT; ++f) {
+        if ((STATE_DOC_FIELDS & (1u << f)) && v->val[f] != d->doc.val[f]) return false;
+    }
+    return true;
+}
+
+static void run_until(device_t *d, int64_t *now, int64_t until)
+{
+    for (; *now < until; *now += MS(STEP_MS)) dev_advance(d, *now);
+}
+
+// ---- Escenarios ----
+static void scenarios(void)
+{
+    static device_t d;
+    int64_t now = 0;
+    dev_init(&d);
+    dev_connect(&d, now);
+    dev_state(&d, now, ACCESS_LOCKED_CLOSED);
+    dev_set(&d, now, TWIN_F_POLICY, 3);
+    run_until(&d, &now, MS(100));
+    doc_view_t v = broker_subscribe(&d.broker);
+    check(v.got && v.version == STATE_DOC_VERSION && v.rev == 1, "arranque: documento v1 rev 1");
+    check(view_matches(&v, &d) && d.broker.publishes == 1, "arranque: estado completo en un mensaje");
+
+    // Primer cambio tras silencio: inmediato
+    now = MS(5000);
+    dev_state(&d, now, ACCESS_UNLOCKED_CLOSED);
+    run_until(&d, &now, MS(5100));
+    v = broker_subscribe(&d.broker);
+    check(view_matches(&v, &d) && v.rev == 2, "cambio tras silencio: publicado al instante");
+
+    // Ráfaga abrir/cerrar/abrir en 300 ms: un documento más, con el final
+    dev_state(&d, now, ACCESS_UNLOCKED_OPEN);
+    run_until(&d, &now, MS(5200));
+    dev_state(&d, now, ACCESS_RELOCK_PENDING);
+    run_until(&d, &now, MS(5300));
+    dev_state(&d, now, ACCESS_UNLOCKED_OPEN);
+    run_until(&d, &now, MS(5800));
+    check(d.broker.publishes == 2, "ráfaga: nada antes de STATE_MIN_MS");
+    run_until(&d, &now, MS(6200));
+    v = broker_subscribe(&d.broker);
+    check(d.broker.publishes == 3 && v.rev == 3 && view_matches(&v, &d), "ráfaga: un documento con el estado final");
+    check(d.min_gap >= MS(STATE_MIN_MS), "ráfaga: ritmo máximo respetado");
+
+    // El dígito y el progreso de la combinación no son autoritativos
+    dev_set(&d, now, TWIN_F_DIGIT, 7);
+    dev_set(&d, now, TWIN_F_COMBO, 2);
+    run_until(&d, &now, MS(9000));
+    check(d.broker.publishes == 3, "dígito/combinación: sin documento");
+
+    // Broker reiniciado sin persistencia: el retenido se pierde hasta reconectar
+    d.broker.has_retained = false;
+    d.connected = false;
+    dev_state(&d, now, ACCESS_RELOCK_PENDING);
+    run_until(&d, &now, MS(9500));
+    check(!broker_subscribe(&d.broker).got, "broker reiniciado: sin retenido");
+    dev_connect(&d, now);
+    run_until(&d, &now, MS(10100));   // Respeta el ritmo desde el documento perdido
+    v = broker_subscribe(&d.broker);
+    check(view_matches(&v, &d) && v.rev == 5, "reconexión: documento republicado");
+
+    char buf[STATE_DOC_MAX];
+    twin_msg_t worst = { .seq = UINT32_MAX, .kind = TWIN_MSG_SNAPSHOT };
+    worst.val[TWIN_F_STATE] = ACCESS_GRANTED_WAIT_CLOSE;
+    worst.val[TWIN_F_POLICY] = INT32_MIN;
+    check(state_doc_format(&worst, DEVICE, INT64_MAX, buf, sizeof(buf)) > 0, "documento más largo cabe");
+}
+
+// ---- Traza de una hora ----
+static void trace(int accesses, int subs, unsigned seed)
+{
+    srand(seed);
+    const int64_t hour = MS(3600 * 1000);
+    static device_t d;
+    dev_init(&d);
+
+    // Eventos: acceso con la puerta abierta unos segundos; a veces alguien
+    // entra y vuelve a abrir antes del re-bloqueo (ráfaga)
+    typedef struct { int64_t at; int st; } sev_t;
+    sev_t *ev = malloc(sizeof(*ev) * (size_t)(accesses * 6 + 8));
+    int nev = 0;
+    for (int a = 0; a < accesses; ++a) {
+        int64_t t = hour / accesses * a + MS(rand() % 20000);
+        ev[nev++] = (sev_t){ t, ACCESS_UNLOCKED_CLOSED };
+        ev[nev++] = (sev_t){ t + MS(2000 + rand() % 3000), ACCESS_UNLOCKED_OPEN };
+        int64_t close = t + MS(8000 + rand() % 4000);
+        ev[nev++] = (sev_t){ close, ACCESS_RELOCK_PENDING };
+        if (rand() % 3 == 0) {
+            ev[nev++] = (sev_t){ close + MS(300), ACCESS_UNLOCKED_OPEN };
+            close += MS(2500);
+            ev[nev++] = (sev_t){ close, ACCESS_RELOCK_PENDING };
+        }
+        ev[nev++] = (sev_t){ close + MS(1000), ACCESS_LOCKED_CLOSED };
+    }
+
+    int64_t *sub_at = malloc(sizeof(*sub_at) * (size_t)subs);
+    for (int i = 0; i < subs; ++i) sub_at[i] = MS(5000) + (int64_t)((double)rand() / RAND_MAX * (double)(hour - MS(10000)));
+    for (int i = 1; i < subs; ++i) {
+        for (int j = i; j > 0 && sub_at[j - 1] > sub_at[j]; --j) {
+            int64_t tmp = sub_at[j]; sub_at[j] = sub_at[j - 1]; sub_at[j - 1] = tmp;
+        }
+    }
+
+    int64_t now = 0;
+    dev_connect(&d, now);
+    dev_state(&d, now, ACCESS_LOCKED_CLOSED);
+    dev_set(&d, now, TWIN_F_POLICY, 3);
+    int e = 0, s = 0, fresh = 0, stale = 0, empty = 0, changes = 0;
+    int64_t last_change = 0, wait_sum = 0;
+    for (; now < hour; now += MS(STEP_MS)) {
+        for (; e < nev && ev[e].at <= now; ++e) {
+            if (d.doc.val[TWIN_F_STATE] != ev[e].st) changes++, last_change = now;
+            dev_state(&d, now, (access_state_t)ev[e].st);
+        }
+        dev_advance(&d, now);
+        for (; s < subs && sub_at[s] <= now; ++s) {
+            doc_view_t v = broker_subscribe(&d.broker);
+            if (!v.got) empty++;
+            else if (view_matches(&v, &d)) fresh++;
+            else {
+                stale++;
+                // Solo puede ir atrasado dentro de la ventana de agrupación
+                check(now - last_change <= MS(STATE_MIN_MS + LATENCY_MS + STEP_MS), "suscriptor: retenido atrasado");
+            }
+            // Sin retención: esperar al siguiente evento de iot/telemetry
+            int k = e;
+            wait_sum += (k < nev ? ev[k].at : hour) - now;
+        }
+    }
+    printf("traza 1 h, %d accesos, %d cambios de estado: %u documentos retenidos, %u bytes (separación mín %lld ms)\n",
+           accesses, changes, d.broker.publishes, d.broker.bytes, (long long)(d.min_gap / 1000));
+    printf("  %d suscriptores: %d con el estado vigente al suscribirse, %d dentro de la ventana de %d ms, %d sin retenido\n",
+           subs, fresh, stale, STATE_MIN_MS, empty);
+    printf("  sin retención habrían esperado de media %.1f s al siguiente evento\n", subs ? wait_sum / 1e6 / subs : 0.0);
+    check(empty == 0, "traza: siempre hay retenido");
+    check(d.min_gap >= MS(STATE_MIN_MS), "traza: ritmo máximo respetado");
+    free(ev);
+    free(sub_at);
+}
+
+int main(int argc, char **argv)
+{
+    int accesses = 30, subs = 200;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--accesses") && i + 1 < argc) accesses = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--subs") && i + 1 < argc) subs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = arg_seed(argv[++i]);
+        else {
+            fprintf(stderr, "uso: %s [--accesses N] [--subs N] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    scenarios();
+    trace(accesses, subs, seed);
+    if (!g_fail) printf("state_retain: ok\n");
+    return g_fail ? 1 : 0;
+}
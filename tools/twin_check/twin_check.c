@@ -0,0 +1,392 @@
+/*
+ * twin_check: pruebas en host de la réplica de estado para el gemelo
+ * digital (main/twin_state.c), con el mismo uso que hace main.c.
+ *
+ * 1) Escenarios: instantánea inicial, cambios agrupados en un cuadro,
+ *    cambio revertido dentro del cuadro, ritmo máximo, petición de
+ *    resincronización, un delta perdido que el gemelo detecta por seq en
+ *    el siguiente mensaje y otro que solo revela el heartbeat.
+ * 2) Traza de una hora (--accesses N por hora, --loss P % de mensajes
+ *    perdidos): el gemelo se reconstruye solo con los mensajes (cJSON, como
+ *    haría Unity) y pide instantánea al ver un salto. Compara bytes con
+ *    publicar el estado completo en cada ciclo de pot_task (120 ms) y mide
+ *    cuánto tiempo difiere el gemelo del dispositivo.
+ *
+ * Compilar: make -C tools twin_check   (binario en tools/build/)
+ * Ejemplo:  tools/build/twin_check --accesses 60 --loss 2 --rate 100 --heartbeat 10000
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "twin_state.h"
+#include "tool_util.h"
+
+#define MS(x) ((int64_t)(x) * 1000)
+#define STEP_MS     10       // Resolución de la simulación
+#define LATENCY_MS  20       // Broker de por medio, en cada sentido
+#define POT_TICK_MS 120      // Ciclo de pot_task
+
+// ---- Gemelo: solo ve los mensajes ----
+typedef struct {
+    int32_t val[TWIN_F_COUNT];
+    uint32_t seq;
+    bool synced;             // Tiene una instantánea y ningún salto después
+    uint32_t gaps;
+    uint32_t applied;
+} twin_view_t;
+
+// Aplica un mensaje; devuelve true si hay que pedir instantánea
+static bool view_apply(twin_view_t *v, const char *msg)
+{
+    cJSON *root = cJSON_Parse(msg);
+    if (!root) {
+        check(false, "mensaje no es JSON");
+        return true;
+    }
+    uint32_t seq = (uint32_t)cJSON_GetObjectItem(root, "seq")->valuedouble;
+    cJSON *snap = cJSON_GetObjectItem(root, "snap");
+    cJSON *d = snap ? snap : cJSON_GetObjectItem(root, "d");
+    bool resync = false;
+    if (!snap && !d) {
+        // Heartbeat: el último seq enviado debe ser el último aplicado
+        if (v->synced && seq != v->seq) v->gaps++;
+        if (!v->synced || seq != v->seq) {
+            v->synced = false;
+            resync = true;
+        }
+        cJSON_Delete(root);
+        return resync;
+    }
+    if (!snap && (!v->synced || seq != v->seq + 1)) {
+        // Salto: el delta no es aplicable sobre lo que tenemos
+        if (v->synced) v->gaps++;
+        v->synced = false;
+        resync = true;
+    } else {
+        for (cJSON *it = d ? d->child : NULL; it; it = it->next) {
+            int f = twin_field_index(it->string);
+            check(f >= 0, "campo desconocido");
+            if (f >= 0) v->val[f] = (int32_t)it->valuedouble;
+        }
+        if (snap) v->synced = true;
+        v->applied++;
+    }
+    v->seq = seq;
+    cJSON_Delete(root);
+    return resync;
+}
+
+// ---- Dispositivo + canal con retardo y pérdidas ----
+#define CHAN_MAX 64
+
+typedef struct {
+    int64_t at;
+    char msg[TWIN_MSG_MAX];
+} chan_msg_t;
+
+typedef struct {
+    twin_state_t t;
+    int64_t due;             // Plazo DL_TWIN (INT64_MAX: desarmado)
+    chan_msg_t chan[CHAN_MAX];
+    int chan_n;
+    int64_t resync_at;       // Petición del gemelo en vuelo
+    twin_view_t view;
+    unsigned loss_pct;
+    uint32_t sent, lost, bytes;
+} sim_t;
+
+static void sim_init(sim_t *s, uint32_t rate_ms, uint32_t heartbeat_ms, unsigned loss_pct)
+{
+    memset(s, 0, sizeof(*s));
+    twin_init(&s->t, rate_ms, heartbeat_ms);
+    s->due = INT64_MAX;
+    s->resync_at = INT64_MAX;
+    s->loss_pct = loss_pct;
+}
+
+static void sim_set(sim_t *s, int64_t now, twin_field_t f, int32_t v)
+{
+    int64_t due;
+    if (twin_set(&s->t, f, v, now, &due)) s->due = due;
+}
+
+static void sim_connect(sim_t *s, int64_t now)
+{
+    int64_t due;
+    if (twin_request_snapshot(&s->t, now, &due)) s->due = due;
+}
+
+static void sim_advance(sim_t *s, int64_t now)
+{
+    if (s->due <= now) {
+        twin_msg_t m;
+        if (twin_take(&s->t, now, &m, &s->due)) {
+            char buf[TWIN_MSG_MAX];
+            size_t n = twin_format(&m, buf, sizeof(buf));
+            check(n > 0, "mensaje no cabe en TWIN_MSG_MAX");
+            s->sent++;
+            s->bytes += (uint32_t)n;
+            if ((unsigned)(rand() % 100) < s->loss_pct) {
+                s->lost++;
+            } else if (s->chan_n < CHAN_MAX) {
+                s->chan[s->chan_n].at = now + MS(LATENCY_MS);
+                memcpy(s->chan[s->chan_n].msg, buf, n + 1);
+                s->chan_n++;
+            }
+        }
+    }
+    int k = 0;
+    for (int i = 0; i < s->chan_n; ++i) {
+        if (s->chan[i].at <= now) {
+            if (view_apply(&s->view, s->chan[i].msg) && s->resync_at == INT64_MAX) {
+                s->resync_at = now + MS(LATENCY_MS);
+            }
+        } else {
+            s->chan[k++] = s->chan[i];
+        }
+    }
+    s->chan_n = k;
+    if (s->resync_at <= now) {
+        s->resync_at = INT64_MAX;
+        sim_connect(s, now);
+    }
+}
+
+static bool sim_consistent(const sim_t *s)
+{
+    return s->view.synced && memcmp(s->view.val, s->t.val, sizeof(s->t.val)) == 0;
+}
+
+// ---- Escenarios ----
+static bool twin_take_(twin_state_t *t, int64_t now, twin_msg_t *m)
+{
+    int64_t next;
+    return twin_take(t, now, m, &next);
+}
+
+static void scenarios(void)
+{
+    twin_state_t t;
+    twin_msg_t m;
+    char buf[TWIN_MSG_MAX];
+    int64_t due;
+
+    twin_init(&t, 100, 0);
+    check(twin_request_snapshot(&t, 0, &due) && due == 0, "conexión: envío inmediato");
+    check(twin_take_(&t, 0, &m) && m.kind == TWIN_MSG_SNAPSHOT && m.seq == 1, "conexión: instantánea seq 1");
+    check(m.mask == (1u << TWIN_F_COUNT) - 1, "instantánea: todos los campos");
+    size_t n = twin_format(&m, buf, sizeof(buf));
+    check(n > 0 && strstr(buf, "\"snap\":{\"st\":0,") != NULL, "instantánea: formato");
+
+    // Tres cambios en el mismo cuadro: un delta al cumplirse el intervalo
+    check(twin_set(&t, TWIN_F_DIGIT, 3, MS(10), &due) && due == MS(100), "cuadro: primer cambio programa");
+    check(!twin_set(&t, TWIN_F_COMBO, 1, MS(20), &due), "cuadro: segundo cambio se suma");
+    check(!twin_set(&t, TWIN_F_DIGIT, 4, MS(30), &due), "cuadro: mismo campo se sustituye");
+    check(twin_take_(&t, MS(100), &m) && m.kind == TWIN_MSG_DELTA && m.seq == 2, "cuadro: delta seq 2");
+    n = twin_format(&m, buf, sizeof(buf));
+    check(n > 0 && strcmp(buf, "{\"seq\":2,\"d\":{\"combo\":1,\"digit\":4}}") == 0, "cuadro: solo lo cambiado");
+    check(t.st.coalesced == 2, "cuadro: 2 cambios absorbidos");
+
+    // Valor repetido: nada
+    check(!twin_set(&t, TWIN_F_DIGIT, 4, MS(300), &due), "sin cambio: no programa");
+    // Ida y vuelta dentro del cuadro: no se envía ni gasta seq
+    check(twin_set(&t, TWIN_F_DIGIT, 5, MS(300), &due) && due == MS(300), "tras silencio: envío inmediato");
+    twin_set(&t, TWIN_F_DIGIT, 4, MS(301), &due);
+    check(!twin_take_(&t, MS(300), &m) && t.seq == 2, "revertido: sin mensaje");
+
+    // Ritmo máximo: el siguiente cuadro espera al intervalo desde el último envío
+    twin_set(&t, TWIN_F_LOCKED, 1, MS(310), &due);
+    twin_take_(&t, due, &m);
+    check(twin_set(&t, TWIN_F_LOCKED, 0, MS(320), &due) && due == MS(410), "ritmo: espera al intervalo");
+    twin_set_rate(&t, 500);
+    twin_take_(&t, due, &m);
+    check(twin_set(&t, TWIN_F_LOCKED, 1, MS(420), &due) && due == MS(910), "ritmo: configurable");
+
+    // Resincronización pedida con un delta ya programado: sale la instantánea
+    check(!twin_request_snapshot(&t, MS(500), &due), "resync: aprovecha el envío programado");
+    check(twin_take_(&t, MS(910), &m) && m.kind == TWIN_MSG_SNAPSHOT && m.val[TWIN_F_LOCKED] == 1, "resync: instantánea al día");
+
+    // Delta perdido: el gemelo ve el salto, pide instantánea y converge
+    sim_t s;
+    sim_init(&s, 100, 0, 0);
+    int64_t now = 0;
+    sim_connect(&s, now);
+    for (; now < MS(200); now += MS(STEP_MS)) sim_advance(&s, now);
+    check(sim_consistent(&s), "pérdida: sincronizado al conectar");
+    s.loss_pct = 100;
+    sim_set(&s, now, TWIN_F_DOOR, 1);
+    for (; now < MS(400); now += MS(STEP_MS)) sim_advance(&s, now);
+    s.loss_pct = 0;
+    check(!sim_consistent(&s), "pérdida: el gemelo se queda atrás");
+    sim_set(&s, now, TWIN_F_DIGIT, 7);
+    for (; now < MS(800); now += MS(STEP_MS)) sim_advance(&s, now);
+    check(s.view.gaps == 1 && s.t.st.resyncs == 2, "pérdida: salto detectado y resync pedido");
+    check(sim_consistent(&s), "pérdida: converge tras la instantánea");
+
+    // Último delta perdido y después silencio: lo revela el heartbeat
+    sim_init(&s, 100, 2000, 0);
+    now = 0;
+    sim_connect(&s, now);
+    for (; now < MS(200); now += MS(STEP_MS)) sim_advance(&s, now);
+    s.loss_pct = 100;
+    sim_set(&s, now, TWIN_F_RELOCK, 1);
+    for (; now < MS(400); now += MS(STEP_MS)) sim_advance(&s, now);
+    s.loss_pct = 0;
+    for (; now < MS(2200); now += MS(STEP_MS)) sim_advance(&s, now);
+    check(!sim_consistent(&s) && s.t.st.heartbeats == 0, "heartbeat: aún no toca");
+    for (; now < MS(2600); now += MS(STEP_MS)) sim_advance(&s, now);
+    check(s.t.st.heartbeats == 1 && s.view.gaps == 1, "heartbeat: revela el delta perdido");
+    check(sim_consistent(&s), "heartbeat: converge tras la instantánea");
+    twin_msg_t hb = { .seq = 7, .kind = TWIN_MSG_HEARTBEAT };
+    check(twin_format(&hb, buf, sizeof(buf)) == 9 && strcmp(buf, "{\"seq\":7}") == 0, "heartbeat: formato");
+}
+
+// ---- Traza de una hora ----
+// Igual que access_fsm.h
+enum { ST_LOCKED_CLOSED = 0, ST_LOCKED_OPEN, ST_GRANTED_WAIT_CLOSE, ST_UNLOCKED_CLOSED,
+       ST_UNLOCKED_OPEN, ST_RELOCK_PENDING };
+
+typedef struct {
+    int64_t at;
+    int8_t f;
+    int32_t v;
+} ev_t;
+
+static int ev_cmp(const void *a, const void *b)
+{
+    const ev_t *x = a, *y = b;
+    return x->at < y->at ? -1 : x->at > y->at;
+}
+
+static ev_t *g_ev;
+static int g_nev, g_cap;
+
+static void ev_add(int64_t at, twin_field_t f, int32_t v)
+{
+    if (g_nev == g_cap) {
+        g_cap = g_cap ? 2 * g_cap : 1024;
+        g_ev = realloc(g_ev, (size_t)g_cap * sizeof(*g_ev));
+    }
+    g_ev[g_nev++] = (ev_t){ at, (int8_t)f, v };
+}
+
+static void ev_state(int64_t at, int st)
+{
+    ev_add(at, TWIN_F_STATE, st);
+    ev_add(at, TWIN_F_LOCKED, st <= ST_GRANTED_WAIT_CLOSE);
+    ev_add(at, TWIN_F_DOOR, st == ST_LOCKED_CLOSED || st == ST_UNLOCKED_CLOSED || st == ST_RELOCK_PENDING);
+    ev_add(at, TWIN_F_RELOCK, st == ST_RELOCK_PENDING);
+}
+
+// Giro del potenciómetro de un dígito a otro, un paso por ciclo y algún
+// parpadeo en las fronteras entre dígitos
+static int64_t ev_turn(int64_t at, int from, int to)
+{
+    int d = from;
+    while (d != to) {
+        d += to > d ? 1 : -1;
+        at += MS(POT_TICK_MS);
+        ev_add(at, TWIN_F_DIGIT, d);
+        if (rand() % 4 == 0) {
+            ev_add(at + MS(POT_TICK_MS) / 2, TWIN_F_DIGIT, d - (to > from ? 1 : -1));
+            ev_add(at + MS(POT_TICK_MS), TWIN_F_DIGIT, d);
+            at += MS(POT_TICK_MS);
+        }
+    }
+    return at;
+}
+
+static void trace(int accesses, unsigned loss_pct, uint32_t rate_ms, uint32_t hb_ms, unsigned seed)
+{
+    srand(seed);
+    const int64_t hour = MS(3600 * 1000);
+    g_nev = 0;
+    ev_state(0, ST_LOCKED_CLOSED);
+    ev_add(0, TWIN_F_COMBO_LEN, 3);
+    ev_add(0, TWIN_F_POLICY, 3);
+    int digit = 0;
+    for (int a = 0; a < accesses; ++a) {
+        int64_t t = (hour - MS(30000)) / accesses * a + MS(rand() % 10000);
+        static const int combo[3] = { 3, 6, 4 };
+        bool bad = rand() % 5 == 0;
+        for (int k = 0; k < 3; ++k) {
+            int want = bad && k == 2 ? 1 : combo[k];
+            t = ev_turn(t, digit, want) + MS(1200);   // Mantener hasta capturar
+            digit = want;
+            ev_add(t, TWIN_F_COMBO, k + 1);
+        }
+        if (bad) {
+            ev_add(t, TWIN_F_COMBO, 0);
+            continue;
+        }
+        ev_state(t + MS(50), ST_UNLOCKED_CLOSED);
+        ev_state(t + MS(3000), ST_UNLOCKED_OPEN);
+        ev_state(t + MS(8000), ST_RELOCK_PENDING);
+        ev_state(t + MS(9000), ST_LOCKED_CLOSED);
+        ev_add(t + MS(9000), TWIN_F_COMBO, 0);
+    }
+    qsort(g_ev, (size_t)g_nev, sizeof(*g_ev), ev_cmp);
+
+    sim_t s;
+    sim_init(&s, rate_ms, hb_ms, loss_pct);
+    sim_connect(&s, 0);
+    int e = 0;
+    uint32_t changes = 0;
+    int64_t stale = 0, stale_run = 0, stale_max = 0;
+    for (int64_t now = 0; now < hour; now += MS(STEP_MS)) {
+        for (; e < g_nev && g_ev[e].at <= now; ++e) {
+            if (s.t.val[g_ev[e].f] != g_ev[e].v) changes++;
+            sim_set(&s, now, (twin_field_t)g_ev[e].f, g_ev[e].v);
+        }
+        sim_advance(&s, now);
+        if (sim_consistent(&s)) {
+            stale_run = 0;
+        } else {
+            stale += MS(STEP_MS);
+            stale_run += MS(STEP_MS);
+            if (stale_run > stale_max) stale_max = stale_run;
+        }
+    }
+
+    // Referencia: instantánea completa en cada ciclo de pot_task
+    twin_msg_t full = { .seq = 99999, .kind = TWIN_MSG_SNAPSHOT, .mask = (1u << TWIN_F_COUNT) - 1 };
+    memcpy(full.val, s.t.val, sizeof(full.val));
+    char buf[TWIN_MSG_MAX];
+    uint64_t ticks = (uint64_t)(hour / MS(POT_TICK_MS));
+    uint64_t full_bytes = ticks * twin_format(&full, buf, sizeof(buf));
+
+    printf("traza 1 h, %d accesos, %u%% perdidos, cuadro %u ms, heartbeat %u ms: %u cambios de campo\n",
+           accesses, loss_pct, (unsigned)rate_ms, (unsigned)hb_ms, changes);
+    printf("  deltas: %u mensajes (%u perdidos), %u bytes; %u instantáneas, %u deltas con %u campos, %u heartbeats\n",
+           s.sent, s.lost, s.bytes, s.t.st.snapshots, s.t.st.deltas, s.t.st.fields, s.t.st.heartbeats);
+    printf("  estado completo cada %d ms: %llu mensajes, %llu bytes (x%.0f)\n", POT_TICK_MS,
+           (unsigned long long)ticks, (unsigned long long)full_bytes, (double)full_bytes / s.bytes);
+    printf("  gemelo distinto del dispositivo: %.1f s en total, máx %lld ms seguidos; %u saltos, %u resync\n",
+           stale / 1e6, (long long)(stale_max / 1000), s.view.gaps, s.t.st.resyncs);
+    check(sim_consistent(&s), "traza: gemelo al día al final");
+}
+
+int main(int argc, char **argv)
+{
+    int accesses = 30;
+    unsigned loss = 0, seed = 1;
+    uint32_t rate = 100, hb = 10000;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--accesses") && i + 1 < argc) accesses = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--loss") && i + 1 < argc) loss = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rate") && i + 1 < argc) rate = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--heartbeat") && i + 1 < argc) hb = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = arg_seed(argv[++i]);
+        else {
+            fprintf(stderr, "uso: %s [--accesses N] [--loss P] [--rate MS] [--heartbeat MS] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    scenarios();
+    trace(accesses, loss, rate, hb, seed);
+    if (!g_fail) printf("twin_check: ok\n");
+    return g_fail ? 1 : 0;
+}